@@ -43,6 +43,10 @@
   #include <inttypes.h>
 #endif /* HAVE_INTTYPES_H */
 
+#ifdef HAVE_LIMITS_H
+  #include <limits.h>
+#endif /* HAVE_LIMITS_H */
+
 #ifdef HAVE_STDLIB_H
   #include <stdlib.h>
 #endif /* HAVE_STDLIB_H */
@@ -55,6 +59,18 @@
   #include <ctype.h>
 #endif /* HAVE_CTYPE_H */
 
+#ifdef HAVE_UNISTD_H
+  #include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#ifdef HAVE_FCNTL_H
+  #include <fcntl.h>
+#endif /* HAVE_FCNTL_H */
+
+#ifdef HAVE_SYS_MMAN_H
+  #include <sys/mman.h>
+#endif /* HAVE_SYS_MMAN_H */
+
 #include <bltAlloc.h>
 #include "bltMath.h"
 #include <bltHash.h>
@@ -142,8 +158,14 @@
 
 /* Column flag. */
 #define TABLE_COLUMN_PRIMARY_KEY        (1<<0)
+#define TABLE_COLUMN_MAPPED             (1<<1)  /* Data and bitmap point
+                                                 * into a mapped
+                                                 * snapshot. */
 
 #define REINDEX                         (1<<21)
+#define REINDEX_HOLES                   (1<<22) /* The row map has holes
+                                                 * counted by a tree. See
+                                                 * AddRowHole. */
 
 typedef struct _BLT_TABLE_VALUE Value;
 
@@ -160,11 +182,13 @@ typedef struct {
 
 typedef struct _BLT_TABLE Table;
 typedef struct _BLT_TABLE_TAGS Tags;
+typedef struct _BLT_TABLE_TAG_SET TagSet;
 typedef struct _BLT_TABLE_TRACE Trace;
 typedef struct _BLT_TABLE_NOTIFIER Notifier;
 
+/* Column type names, indexed by BLT_TABLE_COLUMN_TYPE. */
 static const char *valueTypes[] = {
-    "string", "double", "long", "time", "boolean", "blob", 
+    "string", "double", "long", "int64", "time", "boolean", "blob", 
 };
 
 /*
@@ -177,16 +201,17 @@ static const char *valueTypes[] = {
  *      and stored by clients of a table.  Tags can also be shared between
  *      clients of the same table.
  *      
- *      Both rowTable and columnTable are hash tables keyed by the physical
- *      row or column location in the table respectively.  This is not the
- *      same as the client's view (the order of rows or columns as seen by
- *      the client).  This is so that clients (which may have different
- *      views) can share tags without sharing the same view.
+ *      Row tags are bitmaps of the row offsets (the physical location of
+ *      the row in the table), one per tag.  Column tags are hash tables
+ *      keyed by the column location.  Neither is the same as the client's
+ *      view (the order of rows or columns as seen by the client).  This is
+ *      so that clients (which may have different views) can share tags
+ *      without sharing the same view.
  */
 struct _BLT_TABLE_TAGS {
-    struct _Blt_Tags rowTags;           /* Table of row indices.  Each
-                                         * entry is itself a hash table of
-                                         * tag names. */
+    Blt_HashTable rowTags;              /* Table of row tags.  Each entry
+                                         * is a bitmap of the offsets of
+                                         * the rows having the tag. */
     struct _Blt_Tags columnTags;        /* Table of column indices.  Each
                                          * entry is itself a hash table of
                                          * tag names. */
@@ -197,6 +222,49 @@ struct _BLT_TABLE_TAGS {
                                          * freed. */
 };
 
+/*
+ * _BLT_TABLE_TAG_SET --
+ *
+ *      Compressed bitmap of the row offsets having a tag.  Offsets are
+ *      split into chunks of TAG_CHUNK_SIZE rows keyed by their high bits.
+ *      Only chunks with tagged rows are stored.  A chunk with
+ *      TAG_ARRAY_MAX or fewer members is a sorted array of the low bits
+ *      of their offsets.  Fuller chunks are converted into a plain
+ *      bitmap.  Members are visited in offset order, which is the order
+ *      the rows are stored in the table.
+ */
+#define TAG_CHUNK_BITS          16
+#define TAG_CHUNK_SIZE          (1 << TAG_CHUNK_BITS)
+#define TAG_CHUNK_MASK          (TAG_CHUNK_SIZE - 1)
+#define TAG_BITMAP_WORDS        (TAG_CHUNK_SIZE / 64)
+#define TAG_ARRAY_MAX           4096    /* An array of this many members
+                                         * is the same size as a
+                                         * bitmap. */
+
+typedef struct {
+    long key;                           /* High bits of the offsets in
+                                         * this chunk. */
+    long numMembers;                    /* # of offsets in the chunk. */
+    long numAllocated;                  /* Length of the array below. */
+    uint16_t *array;                    /* Sorted low bits of the
+                                         * offsets. NULL if the chunk is a
+                                         * bitmap. */
+    uint64_t *bits;                     /* Bitmap of the low bits.  NULL
+                                         * if the chunk is an array. */
+} TagChunk;
+
+struct _BLT_TABLE_TAG_SET {
+    long numMembers;                    /* # of rows having the tag. */
+    long numChunks;                     /* # of chunks in use. */
+    long numAllocated;                  /* Length of the chunk array. */
+    TagChunk *chunks;                   /* Chunks ordered by key. */
+    Blt_Chain chain;                    /* If non-NULL, the list of tagged
+                                         * rows handed out by
+                                         * blt_table_get_tagged_rows.
+                                         * Freed whenever the set
+                                         * changes. */
+};
+
 typedef struct {
     Blt_HashTable clientTable;          /* Tracks all table clients. */
     unsigned int nextId;
@@ -209,14 +277,195 @@ typedef struct _BLT_TABLE_CORE TableObject;
 typedef struct _BLT_TABLE_ROWS Rows;
 typedef struct _BLT_TABLE_COLUMNS Columns;
 
+/*
+ * ColumnView --
+ *
+ *      A client's view of a double column's array (see
+ *      blt_table_create_view).
+ */
+typedef struct _BLT_TABLE_VIEW {
+    Table *tablePtr;                    /* Client that created the view. */
+    Column *colPtr;                  /* Column viewed. */
+    BLT_TABLE_VIEW_PROC *proc;          /* Called when the array is moved,
+                                         * changed, or the view deleted. */
+    ClientData clientData;
+    Blt_ChainLink link;                 /* Link in the column's list of
+                                         * views. */
+    unsigned int flags;
+} ColumnView;
+
+#define VIEW_SYNCING            (1<<0)  /* The client is syncing its
+                                         * changes to the column. */
+
 typedef struct {
     BLT_TABLE_ROW row;
     BLT_TABLE_COLUMN column;
 } RowColumnKey;
 
+/*
+ * ColumnIndex --
+ *
+ *      Ordered index of a column.  See "Ordered column indexes" below.
+ */
+typedef struct _BLT_TABLE_COLUMN_INDEX {
+    unsigned int flags;                 /* See definitions below. */
+    long numRows;                       /* # of rows in the index. */
+    long numAllocated;                  /* Length of the rows array. */
+    Row **rows;                         /* Rows ordered by value. */
+} ColumnIndex;
+
+#define INDEX_DIRTY             (1<<0)  /* Index must be rebuilt. */
+#define INDEX_UNIQUE            (1<<1)  /* Values of the column must be
+                                         * unique. */
+
+/*
+ * String columns may be dictionary encoded.  Each distinct string is then
+ * stored once, in the column's dictionary, and each cell holds just the
+ * code of its string.  Codes are 1, 2, or 4 bytes wide, widening as the
+ * dictionary grows.  Code 0 marks an empty cell.  Strings stay in the
+ * dictionary until the column's values are freed, so a code never
+ * changes meaning.
+ */
+typedef struct _BLT_TABLE_DICTIONARY {
+    Blt_HashTable codeTable;            /* Maps strings to codes. */
+    const char **strings;               /* Strings indexed by code.  The
+                                         * strings are the keys of
+                                         * codeTable. */
+    unsigned int *lengths;              /* Lengths of the strings. */
+    long numCodes;                      /* # of codes in use, including
+                                         * the empty code. */
+    long numAllocated;                  /* Length of the strings and
+                                         * lengths arrays. */
+    int width;                          /* Size of a code in bytes. */
+    long *ranks;                        /* If non-NULL, the position of
+                                         * each string in sorted order,
+                                         * indexed by code. */
+    int rankMode;                       /* String comparison used for the
+                                         * ranks. */
+} Dictionary;
+
+#define DICTIONARY_INIT_SIZE    64
+
+/*
+ * ColumnShare --
+ *
+ *      Columns may share their storage (vector, data, bitmap, strings,
+ *      dictionary, and codes) when a column or table is duplicated.  The
+ *      storage is indexed by row offset, so the columns must be in tables
+ *      whose rows are laid out the same.  Before a column changes its
+ *      storage it's given a copy of its own.  Resizing or packing the row
+ *      storage of a table also makes its columns copy their storage.
+ *
+ *      Generated strings of numeric values are still cached.  They are
+ *      the same for all the columns sharing the storage.
+ */
+typedef struct _BLT_TABLE_COLUMN_SHARE {
+    int refCount;                       /* # of columns sharing the
+                                         * storage. */
+} ColumnShare;
+
+/*
+ * ColumnStats --
+ *
+ *      Cached statistics of the values of a column: the number of values,
+ *      their sum, the rows holding the minimum and maximum values, and a
+ *      HyperLogLog sketch estimating the number of distinct values.  The
+ *      statistics are computed the first time they are requested and
+ *      then updated as each cell is set or unset.  The limits are only
+ *      recomputed if the cell that held the minimum or maximum is
+ *      overwritten or unset.  Removed values can't be taken out of the
+ *      sketch, so the distinct count may include them until the
+ *      statistics are next recomputed.
+ */
+#define STATS_HLL_BITS          10      /* # of hash bits selecting a
+                                         * register. */
+#define STATS_HLL_REGISTERS     (1 << STATS_HLL_BITS)
+
+#define STATS_LIMITS_DIRTY      (1<<0)  /* The minimum or maximum value was
+                                         * removed. Rescan the column. */
+
+typedef struct _BLT_TABLE_STATS_CACHE {
+    unsigned int flags;
+    long numValues;                     /* # of non-empty cells. */
+    double sum;                         /* Sum of numeric values. */
+    Row *minRowPtr, *maxRowPtr;         /* Rows holding the limits. */
+    unsigned char registers[STATS_HLL_REGISTERS];
+} ColumnStats;
+
+/*
+ * TableBatch --
+ *
+ *      Changes recorded while a batch of updates is open.  Write, create,
+ *      and unset events aren't traced cell by cell.  Instead the changed
+ *      rows and columns are recorded, and each trace is fired once when
+ *      the outermost batch ends.  Notifications that rows or columns have
+ *      moved are held likewise.
+ *
+ *      Batches are stacked: a trace procedure fired as a batch ends may
+ *      itself open a new batch.  Rows and columns deleted meanwhile are
+ *      marked (their hash value is cleared) in every batch on the stack.
+ */
+typedef struct _BLT_TABLE_BATCH {
+    int depth;                          /* # of open batches.  Zero when
+                                         * the batch is being flushed. */
+    unsigned int flags;                 /* Trace events recorded. */
+    unsigned int rowNotifyFlags;        /* Row and column move
+                                         * notifications held. */
+    unsigned int colNotifyFlags;
+    Blt_HashTable rowTable;             /* Changed rows.  The value is
+                                         * NULL if the row was deleted. */
+    Blt_HashTable columnTable;          /* Changed columns. */
+    int allRows;                        /* Indicates that a column was
+                                         * changed in every row, so the
+                                         * rows aren't recorded. */
+    Row *lastRowPtr;                    /* Last row and column recorded.
+                                         * Saves a hash lookup when
+                                         * setting consecutive cells. */
+    Column *lastColPtr;
+    struct _BLT_TABLE_BATCH *nextPtr;   /* Batch being flushed when this
+                                         * one was opened. */
+} TableBatch;
+
 static Tcl_InterpDeleteProc TableInterpDeleteProc;
 static void DestroyClient(Table *tablePtr);
 static void NotifyClients(Table *tablePtr, BLT_TABLE_NOTIFY_EVENT *eventPtr);
+static void FreeBatch(TableBatch *batchPtr);
+static void RecordBatchEvent(TableBatch *batchPtr, Row *rowPtr, 
+        Column *colPtr, unsigned int flags);
+static int ResizeDenseStorage(Column *colPtr, size_t oldSize, size_t newSize);
+static int UnmapColumn(TableObject *corePtr, Column *colPtr);
+static void UnshareColumn(TableObject *corePtr, Column *colPtr);
+static void AddStatsValue(Table *tablePtr, Row *rowPtr, Column *colPtr);
+static void RemoveStatsValue(Table *tablePtr, Row *rowPtr, Column *colPtr);
+static void FreeColumnStats(Column *colPtr);
+static void NotifyColumnViews(Table *tablePtr, Column *colPtr, 
+        unsigned int flags);
+static void DestroyColumnViews(Table *tablePtr, Column *colPtr, 
+        long numValues);
+static void RefreshColumnViews(Table *tablePtr, Blt_Chain newRows);
+static void ResetRowMap(Rows *rowsPtr);
+static void PushFreeOffset(Rows *rowsPtr, long offset);
+static long PopFreeOffset(Rows *rowsPtr);
+static void AddRowHole(Rows *rowsPtr, long slot);
+static void ClearRowHoles(Rows *rowsPtr);
+static long CountRowHoles(Rows *rowsPtr, long slot);
+static long FindRowSlot(Rows *rowsPtr, long index);
+static void DecodeDenseDatum(BLT_TABLE_COLUMN_TYPE type, 
+        const unsigned char *p, Value *valuePtr);
+static int LoadDenseValues(Tcl_Interp *interp, Table *tablePtr, 
+        Column *colPtr, size_t numRows, Row **rows, 
+        const unsigned char *bitmap, const unsigned char *values, 
+        size_t width, int isContiguous, int clearEmpty);
+static void UnlinkRowKeys(Table *tablePtr, Row *rowPtr, Column *colPtr);
+static void LinkRowKeys(Table *tablePtr, Row *rowPtr, Column *colPtr);
+static void InvalidateKeys(Table *tablePtr, Column *colPtr);
+static void RemoveIndexRow(Column *colPtr, Row *rowPtr);
+static void InsertIndexRow(Column *colPtr, Row *rowPtr);
+static void InvalidateIndex(Column *colPtr);
+static void FreeIndex(Column *colPtr);
+static ColumnIndex *GetIndex(TableObject *corePtr, Column *colPtr);
+static int CheckUniqueValue(Tcl_Interp *interp, Table *tablePtr, 
+        Row *rowPtr, Column *colPtr, Value *valuePtr);
 
 static void
 UnsetRowLabel(Rows *rowsPtr, Row *rowPtr)
@@ -520,18 +769,44 @@ ExtendRows(Table *tablePtr, size_t numExtraRows, Blt_Chain chain)
     size_t i, oldSize, oldUsed;
 
     rowsPtr = &tablePtr->corePtr->rows;
+    if (rowsPtr->flags & REINDEX) {
+        /* New rows are added at the end of the map. */
+        ResetRowMap(rowsPtr);
+    }
     oldSize = rowsPtr->numAllocated;
     oldUsed = rowsPtr->numUsed;
 
+    if (tablePtr->corePtr->mapAddr != NULL) {
+        Column *colPtr;
+
+        /* New rows fall outside of the mapped column blocks. */
+        for (colPtr = tablePtr->corePtr->columns.headPtr; colPtr != NULL;
+             colPtr = colPtr->nextPtr) {
+            if ((colPtr->flags & TABLE_COLUMN_MAPPED) &&
+                (!UnmapColumn(tablePtr->corePtr, colPtr))) {
+                return FALSE;
+            }
+        }
+    }
+
     /* If we are going to exceed the current number of allocated rows,
      * re-allocate a bigger row map and column vectors. */
     if ((numExtraRows + rowsPtr->numUsed) > rowsPtr->numAllocated) {
         size_t newSize;
-        Row **map;
+        Row **map, **offsets;
         Column *colPtr;
     
         newSize = GetMapSize(rowsPtr->numAllocated, numExtraRows);
 
+        /* Shared storage is sized to the rows of the tables sharing it,
+         * so copy it before the number of allocated rows changes. */
+        for (colPtr = tablePtr->corePtr->columns.headPtr; colPtr != NULL;
+             colPtr = colPtr->nextPtr) {
+            if (colPtr->sharePtr != NULL) {
+                UnshareColumn(tablePtr->corePtr, colPtr);
+            }
+        }
+
         /* Resize the row map. */
         if (rowsPtr->map == NULL) {
             map = Blt_Malloc(sizeof(Row *) * newSize);
@@ -542,19 +817,48 @@ ExtendRows(Table *tablePtr, size_t numExtraRows, Blt_Chain chain)
             return FALSE;
         }
         rowsPtr->map = map;
+        /* And the offset-to-row map. */
+        if (rowsPtr->offsets == NULL) {
+            offsets = Blt_Malloc(sizeof(Row *) * newSize);
+        } else {
+            offsets = Blt_Realloc(rowsPtr->offsets, sizeof(Row *) * newSize);
+        }
+        if (offsets == NULL) {
+            return FALSE;
+        }
+        memset(offsets + oldSize, 0, sizeof(Row *) * (newSize - oldSize));
+        rowsPtr->offsets = offsets;
         rowsPtr->numAllocated = newSize;
 
-        /* Resize the individual column vectors.  */
+        /* Resize the individual column vectors. */
         for (colPtr = tablePtr->corePtr->columns.headPtr; colPtr != NULL;
              colPtr = colPtr->nextPtr) {
             if (colPtr->vector != NULL) {
                 Value *vector;
-                
+
                 vector = Blt_Realloc(colPtr->vector, newSize * sizeof(Value));
                 memset(vector + oldSize, 0, (newSize-oldSize) * sizeof(Value));
                 colPtr->vector = vector;
             }
-        }        
+            if (colPtr->codes != NULL) {
+                char *codes;
+                int width;
+
+                width = colPtr->dictPtr->width;
+                codes = Blt_Realloc(colPtr->codes, newSize * width);
+                if (codes == NULL) {
+                    return FALSE;
+                }
+                memset(codes + oldSize * width, 0, 
+                       (newSize - oldSize) * width);
+                colPtr->codes = codes;
+            }
+            if (colPtr->data != NULL) {
+                if (!ResizeDenseStorage(colPtr, oldSize, newSize)) {
+                    return FALSE;
+                }
+            }
+        }
     }
 
     /* Fill in the new slots in the map in with actual row structures.
@@ -566,17 +870,14 @@ ExtendRows(Table *tablePtr, size_t numExtraRows, Blt_Chain chain)
 
         rowPtr = NewRow(rowsPtr);
         offset = nextIndex = i + oldUsed;
-        if (Blt_Chain_GetLength(rowsPtr->freeList) > 0) {
-            Blt_ChainLink link;
-            
-            link = Blt_Chain_FirstLink(rowsPtr->freeList);
-            offset = (uintptr_t)Blt_Chain_GetValue(link);
-            Blt_Chain_DeleteLink(rowsPtr->freeList, link);
+        if (rowsPtr->firstFree < rowsPtr->lastFree) {
+            offset = PopFreeOffset(rowsPtr);
         }
         if (chain != NULL) {
             Blt_Chain_Append(chain, rowPtr);
         }
         rowsPtr->map[nextIndex] = rowPtr;
+        rowsPtr->offsets[offset] = rowPtr;
         rowPtr->offset = offset;
     }
     return TRUE;
@@ -633,6 +934,188 @@ ExtendColumns(Table *tablePtr, size_t numExtraColumns, Blt_Chain chain)
  *      
  *---------------------------------------------------------------------------
  */
+/*
+ *---------------------------------------------------------------------------
+ *
+ * PushFreeOffset --
+ *
+ *      Adds the storage offset of a deleted row to the tail of the free
+ *      queue.  The queue is a flat array: consumed entries at
+ *      the head are reclaimed when the array needs to grow.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+PushFreeOffset(Rows *rowsPtr, long offset)
+{
+    if (rowsPtr->lastFree >= rowsPtr->freeSize) {
+        long numFree;
+
+        numFree = rowsPtr->lastFree - rowsPtr->firstFree;
+        if ((rowsPtr->firstFree > 0) && (numFree < rowsPtr->freeSize / 2)) {
+            /* Slide the pending offsets down to the front. */
+            memmove(rowsPtr->freeOffsets, 
+                    rowsPtr->freeOffsets + rowsPtr->firstFree,
+                    numFree * sizeof(long));
+        } else {
+            long newSize;
+            long *offsets;
+
+            newSize = (rowsPtr->freeSize == 0) ? 64 : rowsPtr->freeSize * 2;
+            offsets = Blt_Malloc(newSize * sizeof(long));
+            if (offsets == NULL) {
+                return;                 /* Offset is leaked, not reused. */
+            }
+            if (numFree > 0) {
+                memcpy(offsets, rowsPtr->freeOffsets + rowsPtr->firstFree,
+                       numFree * sizeof(long));
+            }
+            if (rowsPtr->freeOffsets != NULL) {
+                Blt_Free(rowsPtr->freeOffsets);
+            }
+            rowsPtr->freeOffsets = offsets;
+            rowsPtr->freeSize = newSize;
+        }
+        rowsPtr->firstFree = 0;
+        rowsPtr->lastFree = numFree;
+    }
+    rowsPtr->freeOffsets[rowsPtr->lastFree] = offset;
+    rowsPtr->lastFree++;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * PopFreeOffset --
+ *
+ *      Removes the oldest offset from the free queue.
+ *
+ * Results:
+ *      Returns the offset or -1 if the queue is empty.
+ *
+ *---------------------------------------------------------------------------
+ */
+static long
+PopFreeOffset(Rows *rowsPtr)
+{
+    long offset;
+
+    if (rowsPtr->firstFree >= rowsPtr->lastFree) {
+        return -1;
+    }
+    offset = rowsPtr->freeOffsets[rowsPtr->firstFree];
+    rowsPtr->firstFree++;
+    if (rowsPtr->firstFree == rowsPtr->lastFree) {
+        rowsPtr->firstFree = rowsPtr->lastFree = 0;
+    }
+    return offset;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * AddRowHole --
+ *
+ *      Records that the given slot of the row map no longer holds a row.
+ *      The holes are counted in a binary indexed (Fenwick) tree, so the
+ *      index of a row and the row at an index can be found in O(log n)
+ *      time without renumbering the remaining rows after each deletion.
+ *      The tree is discarded the next time the map is rebuilt.
+ *
+ *      The tree is only started when the map is exact.  If it can't be
+ *      allocated, the map is simply left to be rebuilt as before.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+AddRowHole(Rows *rowsPtr, long slot)
+{
+    long i;
+
+    if ((rowsPtr->flags & (REINDEX|REINDEX_HOLES)) == 0) {
+        /* The map is exact: start counting holes from here. */
+        rowsPtr->numSlots = rowsPtr->numUsed;
+        rowsPtr->holes = Blt_Calloc(rowsPtr->numSlots + 1, sizeof(long));
+        if (rowsPtr->holes != NULL) {
+            rowsPtr->flags |= REINDEX_HOLES;
+        }
+    }
+    if ((rowsPtr->flags & REINDEX_HOLES) == 0) {
+        return;
+    }
+    for (i = slot + 1; i <= rowsPtr->numSlots; i += (i & -i)) {
+        rowsPtr->holes[i]++;
+    }
+}
+
+static void
+ClearRowHoles(Rows *rowsPtr)
+{
+    if (rowsPtr->holes != NULL) {
+        Blt_Free(rowsPtr->holes);
+        rowsPtr->holes = NULL;
+    }
+    rowsPtr->numSlots = 0;
+    rowsPtr->flags &= ~REINDEX_HOLES;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CountRowHoles --
+ *
+ *      Returns the number of holes in the row map before the given slot.
+ *
+ *---------------------------------------------------------------------------
+ */
+static long
+CountRowHoles(Rows *rowsPtr, long slot)
+{
+    long i, count;
+
+    count = 0;
+    for (i = slot; i > 0; i -= (i & -i)) {
+        count += rowsPtr->holes[i];
+    }
+    return count;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FindRowSlot --
+ *
+ *      Returns the slot in the row map of the row at the given index,
+ *      skipping over the holes left by deleted rows.
+ *
+ *---------------------------------------------------------------------------
+ */
+static long
+FindRowSlot(Rows *rowsPtr, long index)
+{
+    long pos, step, numLive;
+
+    numLive = index + 1;                /* # of live rows to pass over. */
+    pos = 0;
+    for (step = 1; (step << 1) <= rowsPtr->numSlots; step <<= 1) {
+        /* Empty */
+    }
+    for (/*empty*/; step > 0; step >>= 1) {
+        long next, live;
+
+        next = pos + step;
+        if (next > rowsPtr->numSlots) {
+            continue;
+        }
+        live = step - rowsPtr->holes[next];
+        if (live < numLive) {
+            pos = next;
+            numLive -= live;
+        }
+    }
+    return pos;                         /* Slot is 0-based. */
+}
+
 static void
 ResetRowMap(Rows *rowsPtr)
 {
@@ -648,6 +1131,7 @@ ResetRowMap(Rows *rowsPtr)
         count++;
     }
     assert(count == rowsPtr->numUsed);
+    ClearRowHoles(rowsPtr);
     rowsPtr->flags &= ~REINDEX;
 }
 
@@ -687,6 +1171,12 @@ blt_table_row(BLT_TABLE table, long index)
 
     assert(index >= 0);
     rowsPtr = blt_table_rows(table);
+    if (rowsPtr->flags & REINDEX_HOLES) {
+        if (index >= rowsPtr->numUsed) {
+            return NULL;
+        }
+        return rowsPtr->map[FindRowSlot(rowsPtr, index)];
+    }
     if (rowsPtr->flags & REINDEX) {
         ResetRowMap(rowsPtr);
     }
@@ -712,6 +1202,9 @@ blt_table_row_index(Table *tablePtr, Row *rowPtr)
     Rows *rowsPtr;
 
     rowsPtr = &tablePtr->corePtr->rows;
+    if (rowsPtr->flags & REINDEX_HOLES) {
+        return rowPtr->index - CountRowHoles(rowsPtr, rowPtr->index);
+    }
     if (rowsPtr->flags & REINDEX) {
         ResetRowMap(rowsPtr);
     }
@@ -809,9 +1302,218 @@ IsEmptyValue(Value *valuePtr)
     return ((valuePtr == NULL) || (valuePtr->string == NULL));
 }
 
+/*
+ * Numeric columns (double, time, long, int64, and boolean) don't store
+ * their cells as Value structures.  The native values are kept in one
+ * contiguous array and a bitmap marks which cells hold a value.  The
+ * string representation of a value is generated only when it's asked for,
+ * and then cached.  The string isn't generated if the value was set from
+ * a string in a different form (such as "0x10" or "1e3").  That string is
+ * kept so that it's returned just as before.
+ */
+#define DenseBitmapSize(n)      (((n) + 7) / 8)
+#define DenseIsSet(c, o)        ((c)->nonEmpty[(o) >> 3] & (1 << ((o) & 7)))
+#define DenseSet(c, o)          ((c)->nonEmpty[(o) >> 3] |= (1 << ((o) & 7)))
+#define DenseClear(c, o)        ((c)->nonEmpty[(o) >> 3] &= ~(1 << ((o) & 7)))
+
+#define DENSE_STRING_LENGTH     200     /* Big enough to hold any
+                                         * generated string. */
+
+static INLINE int
+IsDenseColumn(Column *colPtr)
+{
+    switch (colPtr->type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+    case TABLE_COLUMN_TYPE_LONG:
+    case TABLE_COLUMN_TYPE_INT64:
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static size_t
+DenseValueSize(BLT_TABLE_COLUMN_TYPE type)
+{
+    switch (type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+        return sizeof(double);
+    case TABLE_COLUMN_TYPE_INT64:
+        return sizeof(int64_t);
+    case TABLE_COLUMN_TYPE_LONG:
+        return sizeof(long);
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        return sizeof(int);
+    default:
+        return 0;
+    }
+}
+
+static INLINE long
+GetCode(Column *colPtr, long offset)
+{
+    if (colPtr->codes == NULL) {
+        return 0;
+    }
+    switch (colPtr->dictPtr->width) {
+    case 1:
+        return ((uint8_t *)colPtr->codes)[offset];
+    case 2:
+        return ((uint16_t *)colPtr->codes)[offset];
+    default:
+        return ((uint32_t *)colPtr->codes)[offset];
+    }
+}
+
+static INLINE void
+SetCode(Column *colPtr, long offset, long code)
+{
+    switch (colPtr->dictPtr->width) {
+    case 1:
+        ((uint8_t *)colPtr->codes)[offset] = (uint8_t)code;
+        break;
+    case 2:
+        ((uint16_t *)colPtr->codes)[offset] = (uint16_t)code;
+        break;
+    default:
+        ((uint32_t *)colPtr->codes)[offset] = (uint32_t)code;
+        break;
+    }
+}
+
+static Dictionary *
+NewDictionary(void)
+{
+    Dictionary *dictPtr;
+
+    dictPtr = Blt_AssertCalloc(1, sizeof(Dictionary));
+    Blt_InitHashTable(&dictPtr->codeTable, BLT_STRING_KEYS);
+    dictPtr->numAllocated = DICTIONARY_INIT_SIZE;
+    dictPtr->strings = Blt_AssertMalloc(DICTIONARY_INIT_SIZE * 
+                                        sizeof(char *));
+    dictPtr->lengths = Blt_AssertMalloc(DICTIONARY_INIT_SIZE * 
+                                        sizeof(unsigned int));
+    dictPtr->strings[0] = NULL;
+    dictPtr->lengths[0] = 0;
+    dictPtr->numCodes = 1;
+    dictPtr->width = 1;
+    return dictPtr;
+}
+
+static void
+FreeDictionary(Dictionary *dictPtr)
+{
+    Blt_DeleteHashTable(&dictPtr->codeTable);
+    Blt_Free(dictPtr->strings);
+    Blt_Free(dictPtr->lengths);
+    if (dictPtr->ranks != NULL) {
+        Blt_Free(dictPtr->ranks);
+    }
+    Blt_Free(dictPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * WidenCodes --
+ *
+ *      Converts the codes of the column to the given (larger) width.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+WidenCodes(Rows *rowsPtr, Column *colPtr, int width)
+{
+    if (colPtr->codes != NULL) {
+        void *codes;
+        long i;
+
+        codes = Blt_AssertMalloc(rowsPtr->numAllocated * width);
+        for (i = 0; i < rowsPtr->numAllocated; i++) {
+            if (width == 2) {
+                ((uint16_t *)codes)[i] = (uint16_t)GetCode(colPtr, i);
+            } else {
+                ((uint32_t *)codes)[i] = (uint32_t)GetCode(colPtr, i);
+            }
+        }
+        Blt_Free(colPtr->codes);
+        colPtr->codes = codes;
+    }
+    colPtr->dictPtr->width = width;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetDictionaryCode --
+ *
+ *      Returns the code of the string in the column's dictionary.  The
+ *      string is added to the dictionary if it's not already there.
+ *
+ *---------------------------------------------------------------------------
+ */
+static long
+GetDictionaryCode(Rows *rowsPtr, Column *colPtr, const char *string, 
+                  unsigned int length)
+{
+    Dictionary *dictPtr;
+    Blt_HashEntry *hPtr;
+    int isNew;
+    long code;
+
+    dictPtr = colPtr->dictPtr;
+    hPtr = Blt_CreateHashEntry(&dictPtr->codeTable, string, &isNew);
+    if (!isNew) {
+        return (long)(intptr_t)Blt_GetHashValue(hPtr);
+    }
+    if (dictPtr->numCodes >= dictPtr->numAllocated) {
+        dictPtr->numAllocated += dictPtr->numAllocated;
+        dictPtr->strings = Blt_AssertRealloc(dictPtr->strings, 
+                dictPtr->numAllocated * sizeof(char *));
+        dictPtr->lengths = Blt_AssertRealloc(dictPtr->lengths, 
+                dictPtr->numAllocated * sizeof(unsigned int));
+    }
+    code = dictPtr->numCodes;
+    dictPtr->numCodes++;
+    dictPtr->strings[code] = Blt_GetHashKey(&dictPtr->codeTable, hPtr);
+    dictPtr->lengths[code] = length;
+    Blt_SetHashValue(hPtr, (ClientData)(intptr_t)code);
+    if (dictPtr->ranks != NULL) {
+        Blt_Free(dictPtr->ranks);       /* Ranks are out of date. */
+        dictPtr->ranks = NULL;
+    }
+    if ((dictPtr->width == 1) && (code > 0xFF)) {
+        WidenCodes(rowsPtr, colPtr, 2);
+    } else if ((dictPtr->width == 2) && (code > 0xFFFF)) {
+        WidenCodes(rowsPtr, colPtr, 4);
+    }
+    return code;
+}
+
+static INLINE int
+AllocCodes(Table *tablePtr, Column *colPtr)
+{
+    Rows *rowsPtr;
+
+    rowsPtr = &tablePtr->corePtr->rows;
+    assert(rowsPtr->numAllocated > 0);
+    colPtr->codes = Blt_Calloc(rowsPtr->numAllocated, colPtr->dictPtr->width);
+    return (colPtr->codes != NULL);
+}
+
 static INLINE int
 IsEmpty(Row *rowPtr, Column *colPtr)
 {
+    if (IsDenseColumn(colPtr)) {
+        return ((colPtr->nonEmpty == NULL) || 
+                (!DenseIsSet(colPtr, rowPtr->offset)));
+    }
+    if (colPtr->dictPtr != NULL) {
+        return (GetCode(colPtr, rowPtr->offset) == 0);
+    }
     if (colPtr->vector != NULL) {
         Value *valuePtr;
 
@@ -851,5689 +1553,14180 @@ GetValue(Table *tablePtr, Row *rowPtr, Column *colPtr)
     return colPtr->vector + rowPtr->offset;
 }
 
-static Tcl_Obj *
-GetObjFromValue(BLT_TABLE_COLUMN_TYPE type, Value *valuePtr)
+static int
+AllocDenseStorage(Table *tablePtr, Column *colPtr)
 {
-    Tcl_Obj *objPtr;
-
-    assert(!IsEmptyValue(valuePtr));
-    objPtr = NULL;                      /* Suppress compiler warning. */
-    assert(type != TABLE_COLUMN_TYPE_UNKNOWN);
-    switch (type) {
-    case TABLE_COLUMN_TYPE_BLOB:
-        objPtr = Tcl_NewByteArrayObj(GetValueBytes(valuePtr),
-                                     GetValueLength(valuePtr));
-        break;
-    case TABLE_COLUMN_TYPE_TIME:        /* time */
-    case TABLE_COLUMN_TYPE_DOUBLE:      /* double */
-        objPtr = Tcl_NewDoubleObj(valuePtr->datum.d);
-        break;
-    case TABLE_COLUMN_TYPE_INT64:        /* long */
-        objPtr = Blt_NewInt64Obj(valuePtr->datum.i64);
-        break;
-    case TABLE_COLUMN_TYPE_LONG:        /* long */
-        objPtr = Blt_NewLongObj(valuePtr->datum.l);
-        break;
-    case TABLE_COLUMN_TYPE_BOOLEAN:      /* boolean */
-        objPtr = Tcl_NewBooleanObj((int)valuePtr->datum.i);
-        break;
-    default:
-    case TABLE_COLUMN_TYPE_STRING:      /* string */
-        objPtr = Tcl_NewStringObj(GetValueString(valuePtr),
-                                  GetValueLength(valuePtr));
-        break;
-    }
-    return objPtr;
-}
+    size_t numAllocated;
+
+    numAllocated = tablePtr->corePtr->rows.numAllocated;
+    assert(numAllocated > 0);
+    colPtr->data = Blt_Calloc(numAllocated, DenseValueSize(colPtr->type));
+    colPtr->nonEmpty = Blt_Calloc(DenseBitmapSize(numAllocated), 
+                                  sizeof(unsigned char));
+    if ((colPtr->data == NULL) || (colPtr->nonEmpty == NULL)) {
+        if (colPtr->data != NULL) {
+            Blt_Free(colPtr->data);
+        }
+        if (colPtr->nonEmpty != NULL) {
+            Blt_Free(colPtr->nonEmpty);
+        }
+        colPtr->data = NULL;
+        colPtr->nonEmpty = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
 
 static int
-SetValueFromObj(Tcl_Interp *interp, BLT_TABLE_COLUMN_TYPE type, 
-                Tcl_Obj *objPtr, Value *valuePtr)
+ResizeDenseStorage(Column *colPtr, size_t oldSize, size_t newSize)
 {
-    int length;
-    const char *s;
+    void *data;
+    unsigned char *nonEmpty;
+    size_t oldBytes, newBytes;
 
-    if (objPtr == NULL) {
-        return TCL_OK;
+    data = Blt_Realloc(colPtr->data, newSize * DenseValueSize(colPtr->type));
+    if (data == NULL) {
+        return FALSE;
     }
-    ResetValue(valuePtr);
-    switch (type) {
-    case TABLE_COLUMN_TYPE_TIME:        /* time */
-        if (Blt_GetTimeFromObj(interp, objPtr, &valuePtr->datum.d) != TCL_OK) {
-            return TCL_ERROR;
-        }
-        break;
-
-    case TABLE_COLUMN_TYPE_BOOLEAN:     /* boolean */
-        { 
-            int i;
-            
-            if (Tcl_GetBooleanFromObj(interp, objPtr, &i) != TCL_OK) {
-                return TCL_ERROR;
-            }
-            valuePtr->datum.i = i;
-        }
-        break;
-
-    case TABLE_COLUMN_TYPE_DOUBLE:      /* double */
-        if (Blt_GetDoubleFromObj(interp, objPtr, &valuePtr->datum.d)!=TCL_OK) {
-            return TCL_ERROR;
-        }
-        break;
+    colPtr->data = data;
+    oldBytes = DenseBitmapSize(oldSize);
+    newBytes = DenseBitmapSize(newSize);
+    nonEmpty = Blt_Realloc(colPtr->nonEmpty, newBytes);
+    if (nonEmpty == NULL) {
+        return FALSE;
+    }
+    if (newBytes > oldBytes) {
+        memset(nonEmpty + oldBytes, 0, newBytes - oldBytes);
+    }
+    colPtr->nonEmpty = nonEmpty;
+    if (colPtr->strings != NULL) {
+        char **strings;
 
-    case TABLE_COLUMN_TYPE_INT64:        /* int64 */
-        if (Blt_GetInt64FromObj(interp, objPtr, &valuePtr->datum.i64)!=TCL_OK) {
-            return TCL_ERROR;
+        strings = Blt_Realloc(colPtr->strings, newSize * sizeof(char *));
+        if (strings == NULL) {
+            return FALSE;
         }
-        break;
-
-    case TABLE_COLUMN_TYPE_LONG:        /* long */
-        if (Blt_GetLongFromObj(interp, objPtr, &valuePtr->datum.l) != TCL_OK) {
-            return TCL_ERROR;
+        if (newSize > oldSize) {
+            memset(strings + oldSize, 0, (newSize - oldSize) * sizeof(char *));
         }
-        break;
-    default:
-        break;
-    }
-    s = Tcl_GetStringFromObj(objPtr, &length);
-    if (length >= TABLE_VALUE_LENGTH) {
-        valuePtr->string = Blt_Strndup(s, length);
-        valuePtr->length = length;
-    } else {
-        strncpy(valuePtr->store, s, length);
-        valuePtr->store[length] = '\0';
-        valuePtr->string = TABLE_VALUE_STORE;
-        valuePtr->length = length;
+        colPtr->strings = strings;
     }
-    return TCL_OK;
+    return TRUE;
 }
 
-
-static int
-SetValueFromString(Tcl_Interp *interp, BLT_TABLE_COLUMN_TYPE type, 
-                   const char *s, int length, Value *valuePtr)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FreeColumnValues --
+ *
+ *      Releases the values stored in the column, whatever the storage
+ *      used by the column.  Storage still shared with other columns is
+ *      left to them.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+FreeColumnValues(Rows *rowsPtr, Column *colPtr)
 {
-    double d;
-    long l;
-    Tcl_Obj *objPtr;
-
-    if (length < 0) {
-        length = strlen(s);
-    }
-    objPtr = NULL;
-    if ((type != TABLE_COLUMN_TYPE_STRING) &&
-        (type != TABLE_COLUMN_TYPE_BLOB)) {
-
-        /* For the non-string types, make a copy of the string as a
-         * Tcl_Obj.  This will give us a canonical string representation
-         * and also verify that the string is valid.  */
-        objPtr = Tcl_NewStringObj(s, length);
-        Tcl_IncrRefCount(objPtr);
-        
-        switch (type) {
-        case TABLE_COLUMN_TYPE_TIME:    
-            if (Blt_GetTimeFromObj(interp, objPtr, &d) != TCL_OK) {
-                Tcl_DecrRefCount(objPtr);
-                return TCL_ERROR;
-            }
-            valuePtr->datum.d = d;      /* double */
-            break;
-            
-        case TABLE_COLUMN_TYPE_DOUBLE:  
-            if (Blt_GetDoubleFromObj(interp, objPtr, &d) != TCL_OK) {
-                Tcl_DecrRefCount(objPtr);
-                return TCL_ERROR;
-            }
-            valuePtr->datum.d = d;      /* double */
-            break;
-
-        case TABLE_COLUMN_TYPE_LONG:    
-            if (Blt_GetLongFromObj(interp, objPtr, &l) != TCL_OK) {
-                Tcl_DecrRefCount(objPtr);
-                return TCL_ERROR;
-            }
-            valuePtr->datum.l = l;      /* long */
-            break;
+    Row *rowPtr;
 
-        case TABLE_COLUMN_TYPE_INT64:    
-            {
-                int64_t i;
-                
-                if (Blt_GetInt64FromObj(interp, objPtr, &i) != TCL_OK) {
-                    Tcl_DecrRefCount(objPtr);
-                    return TCL_ERROR;
-                }
-                valuePtr->datum.i64 = i;      /* long */
-            }
-            break;
+    FreeColumnStats(colPtr);
+    if (colPtr->sharePtr != NULL) {
+        ColumnShare *sharePtr;
 
-        case TABLE_COLUMN_TYPE_BOOLEAN: 
-            {
-                int ival;
-                
-                if (Tcl_GetBooleanFromObj(interp, objPtr, &ival) != TCL_OK) {
-                    Tcl_DecrRefCount(objPtr);
-                    return TCL_ERROR;
-                }
-                valuePtr->datum.i = ival; /* boolean */
+        sharePtr = colPtr->sharePtr;
+        colPtr->sharePtr = NULL;
+        if (sharePtr->refCount > 1) {
+            sharePtr->refCount--;
+            colPtr->vector = NULL;
+            colPtr->data = NULL;
+            colPtr->nonEmpty = NULL;
+            colPtr->strings = NULL;
+            colPtr->codes = NULL;
+            colPtr->dictPtr = NULL;
+            return;
+        }
+        Blt_Free(sharePtr);             /* Last user: free the storage. */
+    }
+    if (colPtr->vector != NULL) {
+        for (rowPtr = rowsPtr->headPtr; rowPtr != NULL; 
+             rowPtr = rowPtr->nextPtr) {
+            assert(rowPtr->offset < rowsPtr->numAllocated);
+            ResetValue(colPtr->vector + rowPtr->offset);
+        }
+        Blt_Free(colPtr->vector);
+        colPtr->vector = NULL;
+    }
+    if (colPtr->codes != NULL) {
+        Blt_Free(colPtr->codes);
+        colPtr->codes = NULL;
+    }
+    if (colPtr->dictPtr != NULL) {
+        FreeDictionary(colPtr->dictPtr);
+        colPtr->dictPtr = NULL;
+    }
+    if (colPtr->strings != NULL) {
+        for (rowPtr = rowsPtr->headPtr; rowPtr != NULL; 
+             rowPtr = rowPtr->nextPtr) {
+            if (colPtr->strings[rowPtr->offset] != NULL) {
+                Blt_Free(colPtr->strings[rowPtr->offset]);
             }
-            break;
-        default:
-            break;
         }
-        s = Tcl_GetStringFromObj(objPtr, &length);
-    }        
-
-    ResetValue(valuePtr);
-    if (length >= TABLE_VALUE_LENGTH) {
-        valuePtr->string = Blt_Strndup(s, length);
-        valuePtr->length = length;
-    } else {
-        strncpy(valuePtr->store, s, length);
-        valuePtr->store[length] = '\0';
-        valuePtr->string = TABLE_VALUE_STORE;
-        valuePtr->length = length;
+        Blt_Free(colPtr->strings);
+        colPtr->strings = NULL;
     }
-    if (objPtr != NULL) {
-        Tcl_DecrRefCount(objPtr);
+    if (colPtr->flags & TABLE_COLUMN_MAPPED) {
+        /* The storage belongs to the mapped snapshot. */
+        colPtr->flags &= ~TABLE_COLUMN_MAPPED;
+        colPtr->data = NULL;
+        colPtr->nonEmpty = NULL;
+    }
+    if (colPtr->data != NULL) {
+        Blt_Free(colPtr->data);
+        colPtr->data = NULL;
+    }
+    if (colPtr->nonEmpty != NULL) {
+        Blt_Free(colPtr->nonEmpty);
+        colPtr->nonEmpty = NULL;
     }
-    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * NewTableObject --
+ * UnmapColumn --
  *
- *      Creates and initializes a new table object. 
+ *      Copies the values of a column that point into a mapped snapshot
+ *      into its own storage.  This is done when the column storage needs
+ *      to be resized or rearranged.  Changing a cell in place doesn't
+ *      need this: the snapshot is mapped copy-on-write.
  *
  * Results:
- *      Returns a pointer to the new object is successful, NULL otherwise.
- *      If a table object can't be generated, interp->result will contain
- *      an error message.
+ *      Returns TRUE if the storage could be allocated, FALSE otherwise.
  *
- * -------------------------------------------------------------------------- 
+ *---------------------------------------------------------------------------
  */
-static TableObject *
-NewTableObject(void)
+static int
+UnmapColumn(TableObject *corePtr, Column *colPtr)
 {
-    TableObject *corePtr;
-
-    corePtr = Blt_Calloc(1, sizeof(TableObject));
-    if (corePtr == NULL) {
-        return NULL;
+    void *data;
+    unsigned char *nonEmpty;
+    size_t size;
+
+    size = DenseValueSize(colPtr->type);
+    data = Blt_Calloc(corePtr->rows.numAllocated, size);
+    nonEmpty = Blt_Calloc(DenseBitmapSize(corePtr->rows.numAllocated), 
+                          sizeof(unsigned char));
+    if ((data == NULL) || (nonEmpty == NULL)) {
+        if (data != NULL) {
+            Blt_Free(data);
+        }
+        if (nonEmpty != NULL) {
+            Blt_Free(nonEmpty);
+        }
+        return FALSE;
     }
-    corePtr->clients = Blt_Chain_Create();
-
-    Blt_InitHashTableWithPool(&corePtr->columns.labelTable, BLT_STRING_KEYS);
-    Blt_InitHashTableWithPool(&corePtr->rows.labelTable, BLT_STRING_KEYS);
-    corePtr->columns.pool = Blt_Pool_Create(BLT_FIXED_SIZE_ITEMS);
-    corePtr->columns.nextColumnId = 1;
-    corePtr->rows.freeList = Blt_Chain_Create();
-    corePtr->rows.pool = Blt_Pool_Create(BLT_FIXED_SIZE_ITEMS);
-    corePtr->rows.nextRowId = 1;
-    return corePtr;
+    memcpy(data, colPtr->data, corePtr->numMappedRows * size);
+    memcpy(nonEmpty, colPtr->nonEmpty, 
+           DenseBitmapSize(corePtr->numMappedRows));
+    colPtr->data = data;
+    colPtr->nonEmpty = nonEmpty;
+    colPtr->flags &= ~TABLE_COLUMN_MAPPED;
+    return TRUE;
 }
 
-static void
-DestroyTraces(Table *tablePtr)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CopyDictionary --
+ *
+ *      Returns a copy of the dictionary.  The strings keep their codes.
+ *
+ *---------------------------------------------------------------------------
+ */
+static Dictionary *
+CopyDictionary(Dictionary *srcPtr)
 {
-    Blt_HashEntry *hPtr;
-    Blt_HashSearch iter;
-
-    for (hPtr = Blt_FirstHashEntry(&tablePtr->traces, &iter); hPtr != NULL; 
-         hPtr = Blt_NextHashEntry(&iter)) {
-        Trace *tracePtr;
+    Dictionary *dictPtr;
+    long code;
+
+    dictPtr = Blt_AssertCalloc(1, sizeof(Dictionary));
+    Blt_InitHashTable(&dictPtr->codeTable, BLT_STRING_KEYS);
+    dictPtr->numAllocated = srcPtr->numAllocated;
+    dictPtr->strings = Blt_AssertMalloc(dictPtr->numAllocated * 
+                                        sizeof(char *));
+    dictPtr->lengths = Blt_AssertMalloc(dictPtr->numAllocated * 
+                                        sizeof(unsigned int));
+    memcpy(dictPtr->lengths, srcPtr->lengths, 
+           srcPtr->numCodes * sizeof(unsigned int));
+    dictPtr->strings[0] = NULL;
+    for (code = 1; code < srcPtr->numCodes; code++) {
+        Blt_HashEntry *hPtr;
+        int isNew;
 
-        tracePtr = Blt_GetHashValue(hPtr);
-        blt_table_delete_trace(tablePtr, tracePtr);
+        hPtr = Blt_CreateHashEntry(&dictPtr->codeTable, srcPtr->strings[code],
+                &isNew);
+        Blt_SetHashValue(hPtr, (ClientData)(intptr_t)code);
+        dictPtr->strings[code] = Blt_GetHashKey(&dictPtr->codeTable, hPtr);
     }
-    Blt_Chain_Destroy(tablePtr->readTraces);
-    Blt_Chain_Destroy(tablePtr->writeTraces);
-    Blt_DeleteHashTable(&tablePtr->traces);
+    dictPtr->numCodes = srcPtr->numCodes;
+    dictPtr->width = srcPtr->width;
+    return dictPtr;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * DoTrace --
- *
- *      Fires a trace set by a client of the table object.  Trace
- *      procedures should return a standard TCL result.
- *
- *         TCL_OK       procedure executed successfully.
- *         TCL_ERROR    procedure failed.
- *         TCL_BREAK    don't execute any further trace procedures.
- *         TCL_CONTINUE treat like TCL_OK.
- *
- *      A trace procedure can in turn trigger more traces.  Traces are
- *      prohibited from recursively reentering their own trace procedures.
- *      A hash table in the trace structure tracks the cells currently
- *      actively traced.  If a cell is already being traced, the trace
- *      procedure is not called and TCL_OK is blindly returned.
+ * UnshareColumn --
  *
- * Results:
- *      Returns the result of trace procedure.  If the trace is already
- *      active, then TCL_OK is returned.
- *
- * Side Effects:
- *      Traces on the table location may be fired.
+ *      Gives the column its own copy of storage it shares with other
+ *      columns.  This is done before the column's storage is changed.  If
+ *      the other columns have already made copies of their own, the
+ *      storage simply becomes the column's.
  *
  *---------------------------------------------------------------------------
  */
-static int
-DoTrace(Trace *tracePtr, BLT_TABLE_TRACE_EVENT *eventPtr)
+static void
+UnshareColumn(TableObject *corePtr, Column *colPtr)
 {
-    int result;
+    ColumnShare *sharePtr;
+    Rows *rowsPtr;
+    Row *rowPtr;
+    size_t numAllocated;
 
-    /* 
-     * Check for individual traces on a cell.  Each trace has a hash table
-     * that tracks what cells are actively being traced. This is to prevent
-     * traces from triggering recursive callbacks.
-     */
-    Tcl_Preserve(tracePtr);
-    tracePtr->flags |= TABLE_TRACE_ACTIVE;
-    result = (*tracePtr->proc)(tracePtr->clientData, eventPtr);
-    tracePtr->flags &= ~TABLE_TRACE_ACTIVE;
-    Tcl_Release(tracePtr);
+    sharePtr = colPtr->sharePtr;
+    colPtr->sharePtr = NULL;
+    if (sharePtr->refCount == 1) {
+        Blt_Free(sharePtr);
+        return;
+    }
+    sharePtr->refCount--;
+    rowsPtr = &corePtr->rows;
+    numAllocated = rowsPtr->numAllocated;
+    if (colPtr->vector != NULL) {
+        Value *vector;
 
-    if (result == TCL_ERROR) {
-        Blt_Warn("error in trace callback: %s\n", 
-                 Tcl_GetString(Tcl_GetObjResult(eventPtr->interp)));
-        Tcl_BackgroundError(eventPtr->interp);
+        vector = Blt_AssertMalloc(numAllocated * sizeof(Value));
+        memcpy(vector, colPtr->vector, numAllocated * sizeof(Value));
+        for (rowPtr = rowsPtr->headPtr; rowPtr != NULL; 
+             rowPtr = rowPtr->nextPtr) {
+            Value *valuePtr;
+
+            valuePtr = vector + rowPtr->offset;
+            if ((valuePtr->string != NULL) && 
+                (valuePtr->string != TABLE_VALUE_STORE)) {
+                char *string;
+
+                string = Blt_AssertMalloc(valuePtr->length + 1);
+                memcpy(string, valuePtr->string, valuePtr->length);
+                string[valuePtr->length] = '\0';
+                valuePtr->string = string;
+            }
+        }
+        colPtr->vector = vector;
+    }
+    if (colPtr->data != NULL) {
+        void *data;
+        unsigned char *nonEmpty;
+        size_t size;
+
+        size = DenseValueSize(colPtr->type);
+        data = Blt_AssertMalloc(numAllocated * size);
+        memcpy(data, colPtr->data, numAllocated * size);
+        nonEmpty = Blt_AssertMalloc(DenseBitmapSize(numAllocated));
+        memcpy(nonEmpty, colPtr->nonEmpty, DenseBitmapSize(numAllocated));
+        colPtr->data = data;
+        colPtr->nonEmpty = nonEmpty;
+    }
+    if (colPtr->strings != NULL) {
+        char **strings;
+
+        strings = Blt_AssertCalloc(numAllocated, sizeof(char *));
+        for (rowPtr = rowsPtr->headPtr; rowPtr != NULL; 
+             rowPtr = rowPtr->nextPtr) {
+            if (colPtr->strings[rowPtr->offset] != NULL) {
+                strings[rowPtr->offset] = 
+                    (char *)Blt_AssertStrdup(colPtr->strings[rowPtr->offset]);
+            }
+        }
+        colPtr->strings = strings;
+    }
+    if (colPtr->dictPtr != NULL) {
+        colPtr->dictPtr = CopyDictionary(colPtr->dictPtr);
+    }
+    if (colPtr->codes != NULL) {
+        void *codes;
+
+        codes = Blt_AssertMalloc(numAllocated * colPtr->dictPtr->width);
+        memcpy(codes, colPtr->codes, numAllocated * colPtr->dictPtr->width);
+        colPtr->codes = codes;
     }
-    return result;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * TraceIdleProc --
+ * ReleaseMapping --
  *
- *      Used to invoke a table trace handler routines at some idle point.
- *      This routine is called from the TCL event loop.  Errors generated
- *      by the event handler routines are backgrounded.
- *      
- * Results:
- *      None.
+ *      Unmaps the snapshot file backing the table object.  All columns
+ *      must already have been detached from the mapping.
  *
  *---------------------------------------------------------------------------
  */
 static void
-TraceIdleProc(ClientData clientData)
+ReleaseMapping(TableObject *corePtr)
 {
-    Trace *tracePtr = clientData;
+    if (corePtr->mapAddr != NULL) {
+#ifdef HAVE_SYS_MMAN_H
+        munmap(corePtr->mapAddr, corePtr->mapSize);
+#endif  /* HAVE_SYS_MMAN_H */
+        corePtr->mapAddr = NULL;
+        corePtr->mapSize = corePtr->numMappedRows = 0;
+    }
+}
 
-    tracePtr->flags &= ~TABLE_TRACE_PENDING;
+static INLINE void
+GetDenseDatum(Column *colPtr, long offset, Value *valuePtr)
+{
+    switch (colPtr->type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+        valuePtr->datum.d = ((double *)colPtr->data)[offset];
+        break;
+    case TABLE_COLUMN_TYPE_INT64:
+        valuePtr->datum.i64 = ((int64_t *)colPtr->data)[offset];
+        break;
+    case TABLE_COLUMN_TYPE_LONG:
+        valuePtr->datum.l = ((long *)colPtr->data)[offset];
+        break;
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        valuePtr->datum.l = ((int *)colPtr->data)[offset];
+        break;
+    default:
+        break;
+    }
+}
 
-    /* Protect the notifier in case it's deleted by the callback. */
-    Tcl_Preserve(tracePtr);
-    DoTrace(tracePtr, &tracePtr->event);
-    Tcl_Release(tracePtr);
+static INLINE void
+SetDenseDatum(Column *colPtr, long offset, Value *valuePtr)
+{
+    switch (colPtr->type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+        ((double *)colPtr->data)[offset] = valuePtr->datum.d;
+        break;
+    case TABLE_COLUMN_TYPE_INT64:
+        ((int64_t *)colPtr->data)[offset] = valuePtr->datum.i64;
+        break;
+    case TABLE_COLUMN_TYPE_LONG:
+        ((long *)colPtr->data)[offset] = valuePtr->datum.l;
+        break;
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        ((int *)colPtr->data)[offset] = (int)valuePtr->datum.l;
+        break;
+    default:
+        break;
+    }
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * NotifyIdleProc --
+ * FormatDatum --
  *
- *      Used to invoke event handler routines at some idle point.  This
- *      routine is called from the TCL event loop.  Errors generated by the
- *      event handler routines are backgrounded.
- *      
- * Results:
- *      None.
+ *      Generates the string representation of a numeric value.  This is
+ *      the same string that TCL generates for the number.
  *
  *---------------------------------------------------------------------------
  */
 static void
-NotifyIdleProc(ClientData clientData)
+FormatDatum(BLT_TABLE_COLUMN_TYPE type, Value *valuePtr, char *string)
 {
-    Notifier *notifierPtr = clientData;
-    int result;
-
-    notifierPtr->flags &= ~TABLE_NOTIFY_PENDING;
-
-    /* Protect the notifier in case it's deleted by the callback. */
-    Tcl_Preserve(notifierPtr);
-    notifierPtr->flags |= TABLE_NOTIFY_ACTIVE;
-    result = (*notifierPtr->proc)(notifierPtr->clientData, &notifierPtr->event);
-    notifierPtr->flags &= ~TABLE_NOTIFY_ACTIVE;
-    if (result == TCL_ERROR) {
-        Tcl_BackgroundError(notifierPtr->interp);
+    switch (type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+        Tcl_PrintDouble(NULL, valuePtr->datum.d, string);
+        break;
+    case TABLE_COLUMN_TYPE_INT64:
+        sprintf(string, "%" PRId64, valuePtr->datum.i64);
+        break;
+    case TABLE_COLUMN_TYPE_LONG:
+        sprintf(string, "%ld", valuePtr->datum.l);
+        break;
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        sprintf(string, "%d", (int)valuePtr->datum.l);
+        break;
+    default:
+        string[0] = '\0';
+        break;
     }
-    Tcl_Release(notifierPtr);
 }
 
-static void
-FreeNotifier(Notifier *notifierPtr) 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FormatDenseValue --
+ *
+ *      Returns the string representation of the numeric value at the
+ *      given offset, generating it into the buffer if it doesn't already
+ *      exist.  Nothing is cached, so the column isn't changed.
+ *
+ *---------------------------------------------------------------------------
+ */
+static const char *
+FormatDenseValue(Column *colPtr, long offset, char *buffer)
 {
-    if (notifierPtr->tag != NULL) {
-        Blt_Free(notifierPtr->tag);
-    }
-    if (notifierPtr->link != NULL){
-        Blt_Chain_DeleteLink(notifierPtr->chain, notifierPtr->link);
+    Value value;
+
+    if ((colPtr->strings != NULL) && (colPtr->strings[offset] != NULL)) {
+        return colPtr->strings[offset];
     }
-    Blt_Free(notifierPtr);
+    GetDenseDatum(colPtr, offset, &value);
+    FormatDatum(colPtr->type, &value, buffer);
+    return buffer;
 }
 
-static void
-DestroyNotifiers(Table *tablePtr, Blt_Chain chain)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetDenseString --
+ *
+ *      Returns the string representation of the numeric value at the
+ *      given offset.  The generated string is cached in the column until
+ *      the value changes.
+ *
+ *---------------------------------------------------------------------------
+ */
+static const char *
+GetDenseString(Table *tablePtr, Column *colPtr, long offset)
 {
-    Blt_ChainLink link;
-
-    for (link = Blt_Chain_FirstLink(chain); link != NULL; 
-         link = Blt_Chain_NextLink(link)) {
-        Notifier *notifierPtr;
+    if (colPtr->strings == NULL) {
+        colPtr->strings = Blt_AssertCalloc(
+                tablePtr->corePtr->rows.numAllocated, sizeof(char *));
+    }
+    if (colPtr->strings[offset] == NULL) {
+        Value value;
+        char string[DENSE_STRING_LENGTH];
 
-        notifierPtr = Blt_Chain_GetValue(link);
-        notifierPtr->link = NULL;
-        blt_table_delete_notifier(tablePtr, notifierPtr);
+        GetDenseDatum(colPtr, offset, &value);
+        FormatDatum(colPtr->type, &value, string);
+        colPtr->strings[offset] = (char *)Blt_AssertStrdup(string);
     }
-    Blt_Chain_Destroy(chain);
+    return colPtr->strings[offset];
 }
 
-
-static void
-FreeRows(TableObject *corePtr)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetCellString --
+ *
+ *      Returns the string representation of a non-empty cell.
+ *
+ *---------------------------------------------------------------------------
+ */
+static INLINE const char *
+GetStoredString(Row *rowPtr, Column *colPtr, unsigned int *lengthPtr)
 {
-    Blt_HashEntry *hPtr;
-    Blt_HashSearch iter;
-    Rows *rowsPtr;
+    Value *valuePtr;
 
-    rowsPtr = &corePtr->rows;
-    for (hPtr = Blt_FirstHashEntry(&rowsPtr->labelTable, &iter); hPtr != NULL;
-         hPtr = Blt_NextHashEntry(&iter)) {
-        Blt_HashTable *tablePtr;
-        
-        tablePtr = Blt_GetHashValue(hPtr);
-        Blt_DeleteHashTable(tablePtr);
-        Blt_Free(tablePtr);
-    }
-    Blt_DeleteHashTable(&rowsPtr->labelTable);
-    Blt_Pool_Destroy(rowsPtr->pool);
-    if (rowsPtr->freeList != NULL) {
-        Blt_Chain_Destroy(rowsPtr->freeList);
-    }
-    if (rowsPtr->map != NULL) {
-        Blt_Free(rowsPtr->map);
-        rowsPtr->map = NULL;
+    if (colPtr->dictPtr != NULL) {
+        long code;
+
+        code = GetCode(colPtr, rowPtr->offset);
+        *lengthPtr = colPtr->dictPtr->lengths[code];
+        return colPtr->dictPtr->strings[code];
     }
-    rowsPtr->numAllocated = rowsPtr->numUsed = 0;
+    valuePtr = colPtr->vector + rowPtr->offset;
+    *lengthPtr = GetValueLength(valuePtr);
+    return GetValueString(valuePtr);
 }
 
-static void
-FreeColumns(TableObject *corePtr)
+static const char *
+GetCellString(Table *tablePtr, Row *rowPtr, Column *colPtr, 
+              unsigned int *lengthPtr)
 {
-    Blt_HashEntry *hPtr;
-    Blt_HashSearch iter;
-    Column *colPtr;
-    Columns *columnsPtr;
-
-    columnsPtr = &corePtr->columns;
-    for (colPtr = columnsPtr->headPtr; colPtr != NULL; 
-         colPtr = colPtr->nextPtr) {
-        if (colPtr->vector != NULL) {
-            Row *rowPtr;
+    const char *string;
 
-            for (rowPtr = corePtr->rows.headPtr; rowPtr != NULL;
-                 rowPtr = rowPtr->nextPtr) {
-                assert(rowPtr->offset < corePtr->rows.numAllocated);
-                ResetValue(colPtr->vector + rowPtr->offset);
-            }
-            Blt_Free(colPtr->vector);
-            colPtr->vector = NULL;
-        }
-    }
-    for (hPtr = Blt_FirstHashEntry(&columnsPtr->labelTable, &iter); 
-         hPtr != NULL; hPtr = Blt_NextHashEntry(&iter)) {
-        Blt_HashTable *tablePtr;
-        
-        tablePtr = Blt_GetHashValue(hPtr);
-        Blt_DeleteHashTable(tablePtr);
-        Blt_Free(tablePtr);
-    }
-    Blt_DeleteHashTable(&columnsPtr->labelTable);
-    if (columnsPtr->pool != NULL) {
-        Blt_Pool_Destroy(columnsPtr->pool);
-    }
-    if (columnsPtr->map != NULL) {
-        Blt_Free(columnsPtr->map);
-        columnsPtr->map = NULL;
+    if (IsDenseColumn(colPtr)) {
+        string = GetDenseString(tablePtr, colPtr, rowPtr->offset);
+        *lengthPtr = strlen(string);
+    } else {
+        string = GetStoredString(rowPtr, colPtr, lengthPtr);
     }
-    columnsPtr->numAllocated = columnsPtr->numUsed = 0;
+    return string;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * DestroyTableObject --
- *
- *      Destroys the table object.  This is the final clean up of the
- *      object.  The object's entry is removed from the hash table of
- *      tables.
+ * GetCellDatum --
  *
- * Results: 
- *      None.
+ *      Loads the internal representation of a non-empty cell into the
+ *      value.
  *
- * -------------------------------------------------------------------------- 
+ *---------------------------------------------------------------------------
  */
-static void
-DestroyTableObject(TableObject *corePtr)
+static INLINE void
+GetCellDatum(Row *rowPtr, Column *colPtr, Value *valuePtr)
 {
-    corePtr->flags |= TABLE_DESTROYED;
-
-    assert(Blt_Chain_GetLength(corePtr->clients) == 0);
-    Blt_Chain_Destroy(corePtr->clients);
-
-    FreeColumns(corePtr);
-    FreeRows(corePtr);
-    Blt_Free(corePtr);
+    if (IsDenseColumn(colPtr)) {
+        GetDenseDatum(colPtr, rowPtr->offset, valuePtr);
+    } else {
+        valuePtr->datum = colPtr->vector[rowPtr->offset].datum;
+    }
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * TableInterpDeleteProc --
+ * StoreValue --
  *
- *      This is called when the interpreter hosting the table object is
- *      deleted from the interpreter.
+ *      Stores the value in the cell, replacing the old value.  The value
+ *      (and its string) is consumed: the caller must not reset it.  For
+ *      numeric columns, a NULL string means to generate the string when
+ *      needed.  The string is also dropped if it's the same as the
+ *      generated one.
  *
  * Results:
- *      None.
- *
- * Side effects:
- *      Destroys all remaining tables and removes the hash table used to
- *      register table names.
+ *      Returns a standard TCL result.  An error is returned only if the
+ *      column storage can't be allocated.
  *
  *---------------------------------------------------------------------------
  */
-/* ARGSUSED */
-static void
-TableInterpDeleteProc(ClientData clientData, Tcl_Interp *interp)
+static int
+StoreValue(Table *tablePtr, Row *rowPtr, Column *colPtr, Value *valuePtr)
 {
-    InterpData *dataPtr;
-    Blt_HashEntry *hPtr;
-    Blt_HashSearch cursor;
-    
-    dataPtr = clientData;
-    for (hPtr = Blt_FirstHashEntry(&dataPtr->clientTable, &cursor);
-         hPtr != NULL; hPtr = Blt_NextHashEntry(&cursor)) {
-        Blt_Chain chain;
-        Blt_ChainLink link, next;
+    long offset;
 
-        chain = Blt_GetHashValue(hPtr);
-        for (link = Blt_Chain_FirstLink(chain); link != NULL; link = next) {
-            Table *tablePtr;
+    if (colPtr->sharePtr != NULL) {
+        UnshareColumn(tablePtr->corePtr, colPtr);
+    }
+    if (colPtr->dictPtr != NULL) {
+        long code;
 
-            next = Blt_Chain_NextLink(link);
-            tablePtr = Blt_Chain_GetValue(link);
-            tablePtr->link2 = NULL;
-            /* Don't destroy the client here. Let the client code close the
-             * table. */
+        if ((colPtr->codes == NULL) && (!AllocCodes(tablePtr, colPtr))) {
+            ResetValue(valuePtr);
+            return TCL_ERROR;
         }
-        Blt_Chain_Destroy(chain);
+        code = GetDictionaryCode(&tablePtr->corePtr->rows, colPtr, 
+                GetValueString(valuePtr), GetValueLength(valuePtr));
+        SetCode(colPtr, rowPtr->offset, code);
+        ResetValue(valuePtr);
+        return TCL_OK;
     }
-    Blt_DeleteHashTable(&dataPtr->clientTable);
-    Tcl_DeleteAssocData(interp, TABLE_THREAD_KEY);
-    Blt_Free(dataPtr);
+    if (!IsDenseColumn(colPtr)) {
+        Value *destPtr;
+
+        destPtr = GetValue(tablePtr, rowPtr, colPtr);
+        if (destPtr == NULL) {
+            ResetValue(valuePtr);
+            return TCL_ERROR;
+        }
+        if (destPtr != valuePtr) {
+            ResetValue(destPtr);
+            *destPtr = *valuePtr;
+        }
+        return TCL_OK;
+    }
+    if ((colPtr->data == NULL) && (!AllocDenseStorage(tablePtr, colPtr))) {
+        ResetValue(valuePtr);
+        return TCL_ERROR;
+    }
+    offset = rowPtr->offset;
+    SetDenseDatum(colPtr, offset, valuePtr);
+    DenseSet(colPtr, offset);
+    if ((colPtr->strings != NULL) && (colPtr->strings[offset] != NULL)) {
+        Blt_Free(colPtr->strings[offset]);
+        colPtr->strings[offset] = NULL;
+    }
+    if (valuePtr->string != NULL) {
+        char string[DENSE_STRING_LENGTH];
+
+        FormatDatum(colPtr->type, valuePtr, string);
+        if (strcmp(GetValueString(valuePtr), string) != 0) {
+            /* Keep the string the value was set from. */
+            if (colPtr->strings == NULL) {
+                colPtr->strings = Blt_AssertCalloc(
+                        tablePtr->corePtr->rows.numAllocated, sizeof(char *));
+            }
+            if (valuePtr->string == TABLE_VALUE_STORE) {
+                colPtr->strings[offset] = (char *)Blt_AssertStrdup(valuePtr->store);
+            } else {
+                colPtr->strings[offset] = (char *)valuePtr->string;
+                valuePtr->string = NULL;
+            }
+        }
+        ResetValue(valuePtr);
+    }
+    return TCL_OK;
 }
 
 /*
- *---------------------------------------------------------------------------
- *
- * GetInterpData --
- *
- *      Creates or retrieves data associated with tuple data objects for a
- *      particular interpreter.
+ * Type guessing for imports.
  *
- * Results:
- *      Returns a pointer to the tuple interpreter data.
- *
- * -------------------------------------------------------------------------- 
+ * The types a string can be converted to are kept as a bit mask.  A
+ * column's type is the narrowest type in the mask shared by all its
+ * values.  Integers are only accepted in plain decimal form (no leading
+ * zeros), so that identifiers such as zip codes stay strings.
  */
-static InterpData *
-GetInterpData(Tcl_Interp *interp)
-{
-    Tcl_InterpDeleteProc *proc;
-    InterpData *dataPtr;
-
-    dataPtr = (InterpData *)
-        Tcl_GetAssocData(interp, TABLE_THREAD_KEY, &proc);
-    if (dataPtr == NULL) {
-        dataPtr = Blt_AssertMalloc(sizeof(InterpData));
-        dataPtr->interp = interp;
-        Tcl_SetAssocData(interp, TABLE_THREAD_KEY, TableInterpDeleteProc, 
-                dataPtr);
-        Blt_InitHashTable(&dataPtr->clientTable, BLT_STRING_KEYS);
-    }
-    return dataPtr;
-}
-
-
-const char *
-blt_table_column_type_to_name(BLT_TABLE_COLUMN_TYPE type)
-{
-    return valueTypes[type];
-}
+#define GUESS_BOOLEAN   (1<<0)
+#define GUESS_LONG      (1<<1)
+#define GUESS_INT64     (1<<2)
+#define GUESS_DOUBLE    (1<<3)
+#define GUESS_TIME      (1<<4)
+#define GUESS_ALL       (GUESS_BOOLEAN | GUESS_LONG | GUESS_INT64 | \
+                         GUESS_DOUBLE | GUESS_TIME)
+
+/* Time formats tried when guessing, most specific first. */
+static const char *guessTimePatterns[] = {
+    "%Y-%m-%dT%H:%M:%S.%f%z",
+    "%Y-%m-%dT%H:%M:%S%z",
+    "%Y-%m-%dT%H:%M:%S.%f",
+    "%Y-%m-%dT%H:%M:%S",
+    "%Y-%m-%d %H:%M:%S.%f",
+    "%Y-%m-%d %H:%M:%S",
+    "%Y-%m-%d %H:%M",
+    "%Y-%m-%d",
+    "%Y/%m/%d %H:%M:%S",
+    "%Y/%m/%d",
+    "%m/%d/%Y %H:%M:%S",
+    "%m/%d/%Y",
+    "%d %b %Y",
+};
+static int numGuessTimePatterns = sizeof(guessTimePatterns) / sizeof(char *);
+static Blt_TimeFormat guessTimeFormats[sizeof(guessTimePatterns) / 
+                                       sizeof(char *)];
+TCL_DECLARE_MUTEX(guessMutex)
 
 /*
  *---------------------------------------------------------------------------
  *
- * NewTags --
+ * GuessNumber --
+ *
+ *      Returns the numeric types the string can be converted to.  Only
+ *      plain decimal numbers, optionally surrounded by spaces, are
+ *      accepted.
  *
  *---------------------------------------------------------------------------
  */
-static BLT_TABLE_TAGS
-NewTags(void)
+static unsigned int
+GuessNumber(const char *s, const char *send)
 {
-    Tags *tagsPtr;
+    const char *digits;
+    uint64_t value;
+    int isNegative, numDigits;
+
+    while ((s < send) && (isspace(UCHAR(*s)))) {
+        s++;
+    }
+    while ((send > s) && (isspace(UCHAR(*(send - 1))))) {
+        send--;
+    }
+    isNegative = FALSE;
+    if ((s < send) && ((*s == '-') || (*s == '+'))) {
+        isNegative = (*s == '-');
+        s++;
+    }
+    digits = s;
+    value = 0;
+    while ((s < send) && (isdigit(UCHAR(*s)))) {
+        if ((s - digits) < 19) {
+            value = (value * 10) + (*s - '0');
+        }
+        s++;
+    }
+    numDigits = s - digits;
+    if (s == send) {
+        uint64_t limit;
+        unsigned int mask;
 
-    tagsPtr = Blt_Malloc(sizeof(Tags));
-    if (tagsPtr != NULL) {
-        Blt_Tags_Init(&tagsPtr->rowTags);
-        Blt_Tags_Init(&tagsPtr->columnTags);
-        tagsPtr->refCount = 1;
+        if ((numDigits == 0) || ((numDigits > 1) && (*digits == '0'))) {
+            return 0;                   /* Leading zeros. */
+        }
+        if (numDigits > 19) {
+            return GUESS_DOUBLE;
+        }
+        mask = GUESS_DOUBLE;
+        limit = (uint64_t)INT64_MAX + isNegative;
+        if (value <= limit) {
+            mask |= GUESS_INT64;
+            limit = (uint64_t)LONG_MAX + isNegative;
+            if (value <= limit) {
+                mask |= GUESS_LONG;
+            }
+        }
+        return mask;
     }
-    return tagsPtr;
-}
+    if ((numDigits > 1) && (*digits == '0') && (*s != '.') &&
+        (*s != 'e') && (*s != 'E')) {
+        return 0;
+    }
+    if (*s == '.') {
+        const char *frac;
 
-static void
-InitTags(Table *tablePtr)
-{
-    tablePtr->tags = NewTags();
-    tablePtr->rowTags = &tablePtr->tags->rowTags;
-    tablePtr->columnTags = &tablePtr->tags->columnTags;
-}
+        frac = ++s;
+        while ((s < send) && (isdigit(UCHAR(*s)))) {
+            s++;
+        }
+        if ((numDigits == 0) && (s == frac)) {
+            return 0;                   /* No digits at all. */
+        }
+    } else if (numDigits == 0) {
+        return 0;
+    }
+    if ((s < send) && ((*s == 'e') || (*s == 'E'))) {
+        const char *exp;
 
-/*
- *---------------------------------------------------------------------------
- *
- * ShareTags --
- *
- *---------------------------------------------------------------------------
- */
-static void
-ShareTags(Table *srcPtr, Table *destPtr)
-{
-    srcPtr->tags->refCount++;
-    if (destPtr->tags != NULL) {
-        blt_table_release_tags(destPtr);
+        s++;
+        if ((s < send) && ((*s == '-') || (*s == '+'))) {
+            s++;
+        }
+        exp = s;
+        while ((s < send) && (isdigit(UCHAR(*s)))) {
+            s++;
+        }
+        if (s == exp) {
+            return 0;
+        }
     }
-    destPtr->tags = srcPtr->tags;
-    destPtr->rowTags = &destPtr->tags->rowTags;
-    destPtr->columnTags = &destPtr->tags->columnTags;
+    return (s == send) ? GUESS_DOUBLE : 0;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * FindClientInNamespace --
+ * ScanPlainNumber --
  *
- *      Searches for a table client in a given namespace.
+ *      Converts a plain decimal number directly into the value's datum.
+ *      This is the common case when loading numeric columns, and avoids
+ *      creating a Tcl_Obj for each value.
  *
  * Results:
- *      Returns a pointer to the table client if found, otherwise NULL.
+ *      Returns TRUE if the string was converted.  Otherwise the general
+ *      conversion must be used.
  *
  *---------------------------------------------------------------------------
  */
-static Table *
-FindClientInNamespace(InterpData *dataPtr, Blt_ObjectName *namePtr)
+static int
+ScanPlainNumber(BLT_TABLE_COLUMN_TYPE type, const char *s, int length, 
+                Value *valuePtr)
 {
-    Blt_HashEntry *hPtr;
-    Tcl_DString ds;
-    const char *qualName;
+    char buf[TCL_DOUBLE_SPACE * 2];
+    unsigned int mask;
 
-    qualName = Blt_MakeQualifiedName(namePtr, &ds);
-    hPtr = Blt_FindHashEntry(&dataPtr->clientTable, qualName);
-    Tcl_DStringFree(&ds);
-    if (hPtr != NULL) {
-        Blt_Chain chain;
-        Blt_ChainLink link;
-
-        chain = Blt_GetHashValue(hPtr);
-        link = Blt_Chain_FirstLink(chain);
-        if (link != NULL) {
-            return Blt_Chain_GetValue(link);
+    if (length >= (int)sizeof(buf)) {
+        return FALSE;
+    }
+    mask = GuessNumber(s, s + length);
+    memcpy(buf, s, length);
+    buf[length] = '\0';
+    switch (type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+        if ((mask & GUESS_DOUBLE) == 0) {
+            return FALSE;
+        }
+        valuePtr->datum.d = strtod(buf, NULL);
+        break;
+    case TABLE_COLUMN_TYPE_LONG:
+        if ((mask & GUESS_LONG) == 0) {
+            return FALSE;
+        }
+        valuePtr->datum.l = strtol(buf, NULL, 10);
+        break;
+    case TABLE_COLUMN_TYPE_INT64:
+        if ((mask & GUESS_INT64) == 0) {
+            return FALSE;
         }
+        valuePtr->datum.i64 = strtoll(buf, NULL, 10);
+        break;
+    default:
+        return FALSE;
     }
-    return NULL;
+    return TRUE;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * GetTable --
- *
- *      Searches for the table client associated by the name given.
+ * PutValue --
  *
- * Results:
- *      Returns a pointer to the table client if found, otherwise NULL.
+ *      Stores the value in the cell.  If the column is a primary key or
+ *      is indexed, the row is moved in the key tables or index to its new
+ *      value.  It's an error if the column has a unique index and another
+ *      row already has the value.  The value is then freed and an error
+ *      message is left in interp, if it isn't NULL.
  *
  *---------------------------------------------------------------------------
  */
-static BLT_TABLE
-GetTable(InterpData *dataPtr, const char *name, unsigned int flags)
+static int
+PutValue(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr, Column *colPtr, 
+         Value *valuePtr)
 {
-    Blt_ObjectName objName;
-    BLT_TABLE table;
-    Tcl_Interp *interp;
+    int result;
 
-    table = NULL;
-    interp = dataPtr->interp;
-    if (!Blt_ParseObjectName(interp, name, &objName, BLT_NO_DEFAULT_NS)) {
-        return NULL;
+    if ((colPtr->indexPtr != NULL) && 
+        (colPtr->indexPtr->flags & INDEX_UNIQUE) &&
+        (CheckUniqueValue(interp, tablePtr, rowPtr, colPtr, valuePtr) 
+         != TCL_OK)) {
+        ResetValue(valuePtr);
+        return TCL_ERROR;
     }
-    if (objName.nsPtr != NULL) { 
-        table = FindClientInNamespace(dataPtr, &objName);
-    } else { 
-        if (flags & NS_SEARCH_CURRENT) {
-            /* Look first in the current namespace. */
-            objName.nsPtr = Tcl_GetCurrentNamespace(interp);
-            table = FindClientInNamespace(dataPtr, &objName);
-        }
-        if ((table == NULL) && (flags & NS_SEARCH_GLOBAL)) {
-            objName.nsPtr = Tcl_GetGlobalNamespace(interp);
-            table = FindClientInNamespace(dataPtr, &objName);
-        }
+    if (colPtr->statsPtr != NULL) {
+        RemoveStatsValue(tablePtr, rowPtr, colPtr);
     }
-    return table;
-}
-
-static void
-DestroyClient(Table *tablePtr)
-{
-    if (tablePtr->magic != TABLE_MAGIC) {
-        Blt_Warn("invalid table object token %p\n", tablePtr);
-        return;
+    if (((colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) == 0) && 
+        (colPtr->indexPtr == NULL)) {
+        result = StoreValue(tablePtr, rowPtr, colPtr, valuePtr);
+        goto done;
     }
-    /* Remove any traces that were set by this client. */
-    DestroyTraces(tablePtr);
-    /* Also remove all event handlers created by this client. */
-    DestroyNotifiers(tablePtr, tablePtr->rowNotifiers);
-    DestroyNotifiers(tablePtr, tablePtr->columnNotifiers);
-    blt_table_unset_keys(tablePtr);
-    if (tablePtr->tags != NULL) {
-        blt_table_release_tags(tablePtr);
+    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
+        UnlinkRowKeys(tablePtr, rowPtr, colPtr);
     }
-    if ((tablePtr->corePtr != NULL) && (tablePtr->link != NULL)) {
-        TableObject *corePtr;
-
-        corePtr = tablePtr->corePtr;
-        /* Remove the client from the server's list */
-        Blt_Chain_DeleteLink(corePtr->clients, tablePtr->link);
-        if (Blt_Chain_GetLength(corePtr->clients) == 0) {
-            DestroyTableObject(corePtr);
+    if (colPtr->indexPtr != NULL) {
+        RemoveIndexRow(colPtr, rowPtr);
+    }
+    result = StoreValue(tablePtr, rowPtr, colPtr, valuePtr);
+    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
+        LinkRowKeys(tablePtr, rowPtr, colPtr);
+    }
+    if (colPtr->indexPtr != NULL) {
+        InsertIndexRow(colPtr, rowPtr);
+    }
+ done:
+    if (colPtr->statsPtr != NULL) {
+        if (result == TCL_OK) {
+            AddStatsValue(tablePtr, rowPtr, colPtr);
+        } else {
+            FreeColumnStats(colPtr);
         }
     }
-    tablePtr->magic = 0;
-    Blt_Free(tablePtr);
+    return result;
 }
 
-/*
- *---------------------------------------------------------------------------
- *
- * NewTable --
- *
- *      Creates a new table client.  Clients shared a tuple data object.
- *      They individually manage traces and events on tuple objects.
- *      Returns a pointer to the malloc'ed structure.  This is passed to
- *      the client as a tuple token.
- *      
- * Results:
- *      A pointer to a Table is returned.  If one can't be allocated, NULL
- *      is returned.
- *
- *---------------------------------------------------------------------------
- */
-static Table *
-NewTable(
-    InterpData *dataPtr, 
-    TableObject *corePtr,               /* Table object serving this
-                                         * client. */
-    const char *qualName)               /* Full namespace qualified name of
-                                         * table. A table by this name may
-                                         * already exist. */
+static Tcl_Obj *
+GetObjFromValue(BLT_TABLE_COLUMN_TYPE type, Value *valuePtr)
 {
-    Blt_Chain chain;                    /* List of clients using the same
-                                         * name. */
-    Table *tablePtr;
-    int isNew;
+    Tcl_Obj *objPtr;
 
-    tablePtr = Blt_Calloc(1, sizeof(Table));
-    if (tablePtr == NULL) {
-        return NULL;
-    }
-    tablePtr->magic = TABLE_MAGIC;
-    tablePtr->interp = dataPtr->interp;
-    /* Add client to table object's list of clients. */
-    tablePtr->link = Blt_Chain_Append(corePtr->clients, tablePtr);
-
-    /* Create a new set of tags. */
-    InitTags(tablePtr);
-
-    tablePtr->clientTablePtr = &dataPtr->clientTable;
-    /* Table names are not unique.  More than one client may open the same
-     * table.  The name remains in use so long as one client is still using
-     * the table. This is so other clients can refer to the table, even
-     * though the original client that created the data no longer
-     * exists. */
-    tablePtr->hPtr = Blt_CreateHashEntry(&dataPtr->clientTable, qualName, 
-        &isNew);
-    if (isNew) {
-        chain = Blt_Chain_Create();
-        Blt_SetHashValue(tablePtr->hPtr, chain);
-    } else {
-        chain = Blt_GetHashValue(tablePtr->hPtr);
+    assert(!IsEmptyValue(valuePtr));
+    objPtr = NULL;                      /* Suppress compiler warning. */
+    assert(type != TABLE_COLUMN_TYPE_UNKNOWN);
+    switch (type) {
+    case TABLE_COLUMN_TYPE_BLOB:
+        objPtr = Tcl_NewByteArrayObj(GetValueBytes(valuePtr),
+                                     GetValueLength(valuePtr));
+        break;
+    case TABLE_COLUMN_TYPE_TIME:        /* time */
+    case TABLE_COLUMN_TYPE_DOUBLE:      /* double */
+        objPtr = Tcl_NewDoubleObj(valuePtr->datum.d);
+        break;
+    case TABLE_COLUMN_TYPE_INT64:        /* long */
+        objPtr = Blt_NewInt64Obj(valuePtr->datum.i64);
+        break;
+    case TABLE_COLUMN_TYPE_LONG:        /* long */
+        objPtr = Blt_NewLongObj(valuePtr->datum.l);
+        break;
+    case TABLE_COLUMN_TYPE_BOOLEAN:      /* boolean */
+        objPtr = Tcl_NewBooleanObj((int)valuePtr->datum.l);
+        break;
+    default:
+    case TABLE_COLUMN_TYPE_STRING:      /* string */
+        objPtr = Tcl_NewStringObj(GetValueString(valuePtr),
+                                  GetValueLength(valuePtr));
+        break;
     }
-    tablePtr->name = Blt_GetHashKey(&dataPtr->clientTable, tablePtr->hPtr);
-    tablePtr->link2 = Blt_Chain_Append(chain, tablePtr);
-    tablePtr->rowNotifiers = Blt_Chain_Create();
-    tablePtr->columnNotifiers = Blt_Chain_Create();
-    tablePtr->readTraces = Blt_Chain_Create();
-    tablePtr->writeTraces = Blt_Chain_Create();
-    Blt_InitHashTable(&tablePtr->notifiers, BLT_ONE_WORD_KEYS);
-    Blt_InitHashTable(&tablePtr->traces, BLT_ONE_WORD_KEYS);
-
-    tablePtr->corePtr = corePtr;
-    return tablePtr;
+    return objPtr;
 }
 
-static Blt_HashTable *
-GetColumnLabelTable(Columns *columnsPtr, const char *label)
+static Tcl_Obj *
+GetObjFromCell(Table *tablePtr, Row *rowPtr, Column *colPtr)
 {
-    Blt_HashEntry *hPtr;
-
-    hPtr = Blt_FindHashEntry(&columnsPtr->labelTable, label);
-    if (hPtr != NULL) {
-        return Blt_GetHashValue(hPtr);
-    }
-    return NULL;
-}
+    Value value;
 
-static Blt_HashTable *
-GetRowLabelTable(Rows *rowsPtr, const char *label)
-{
-    Blt_HashEntry *hPtr;
+    if (colPtr->dictPtr != NULL) {
+        const char *string;
+        unsigned int length;
 
-    hPtr = Blt_FindHashEntry(&rowsPtr->labelTable, label);
-    if (hPtr != NULL) {
-        return Blt_GetHashValue(hPtr);
+        string = GetStoredString(rowPtr, colPtr, &length);
+        return Tcl_NewStringObj(string, length);
+    }
+    if (!IsDenseColumn(colPtr)) {
+        return GetObjFromValue(colPtr->type, 
+                               GetValue(tablePtr, rowPtr, colPtr));
+    }
+    GetDenseDatum(colPtr, rowPtr->offset, &value);
+    switch (colPtr->type) {
+    case TABLE_COLUMN_TYPE_INT64:
+        return Blt_NewInt64Obj(value.datum.i64);
+    case TABLE_COLUMN_TYPE_LONG:
+        return Blt_NewLongObj(value.datum.l);
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        return Tcl_NewBooleanObj((int)value.datum.l);
+    default:
+        return Tcl_NewDoubleObj(value.datum.d);
     }
-    return NULL;
 }
 
-static Row *
-FindRowLabel(Rows *rowsPtr, const char *label)
+static int
+SetValueFromObj(Tcl_Interp *interp, Column *colPtr, 
+                BLT_TABLE_COLUMN_TYPE type, Tcl_Obj *objPtr, Value *valuePtr)
 {
-    Blt_HashTable *tablePtr;
+    int length;
+    const char *s;
 
-    tablePtr = GetRowLabelTable(rowsPtr, label);
-    if (tablePtr != NULL) {
-        Blt_HashEntry *hPtr;
-        Blt_HashSearch iter;
+    if (objPtr == NULL) {
+        return TCL_OK;
+    }
+    ResetValue(valuePtr);
+    switch (type) {
+    case TABLE_COLUMN_TYPE_TIME:        /* time */
+        /* Try the column's time format before the general parser.  The
+         * general parser also handles numeric seconds. */
+        s = Tcl_GetStringFromObj(objPtr, &length);
+        if ((colPtr != NULL) && (colPtr->timeFmtPtr != NULL) &&
+            (Blt_ParseTimeWithFormat(NULL, colPtr->timeFmtPtr, s, length,
+                &valuePtr->datum.d) == TCL_OK)) {
+            break;
+        }
+        if (Blt_GetTimeFromObj(interp, objPtr, &valuePtr->datum.d) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        break;
 
-        hPtr = Blt_FirstHashEntry(tablePtr, &iter);
-        if (hPtr != NULL) {
-            return Blt_GetHashValue(hPtr);
+    case TABLE_COLUMN_TYPE_BOOLEAN:     /* boolean */
+        { 
+            int i;
+            
+            if (Tcl_GetBooleanFromObj(interp, objPtr, &i) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            valuePtr->datum.l = i;
         }
-    }
-    return NULL;
-}
+        break;
 
-static Column *
-FindColumnLabel(Columns *columnsPtr, const char *label)
-{
-    Blt_HashTable *tablePtr;
+    case TABLE_COLUMN_TYPE_DOUBLE:      /* double */
+        if (Blt_GetDoubleFromObj(interp, objPtr, &valuePtr->datum.d)!=TCL_OK) {
+            return TCL_ERROR;
+        }
+        break;
 
-    tablePtr = GetColumnLabelTable(columnsPtr, label);
-    if (tablePtr != NULL) {
-        Blt_HashEntry *hPtr;
-        Blt_HashSearch iter;
+    case TABLE_COLUMN_TYPE_INT64:        /* int64 */
+        if (Blt_GetInt64FromObj(interp, objPtr, &valuePtr->datum.i64)!=TCL_OK) {
+            return TCL_ERROR;
+        }
+        break;
 
-        hPtr = Blt_FirstHashEntry(tablePtr, &iter);
-        if (hPtr != NULL) {
-            return Blt_GetHashValue(hPtr);
+    case TABLE_COLUMN_TYPE_LONG:        /* long */
+        if (Blt_GetLongFromObj(interp, objPtr, &valuePtr->datum.l) != TCL_OK) {
+            return TCL_ERROR;
         }
+        break;
+    default:
+        break;
     }
-    return NULL;
+    if ((objPtr->bytes == NULL) && (DenseValueSize(type) > 0)) {
+        /* A pure number.  Don't bother generating its string
+         * representation: numeric columns generate the same string on
+         * demand. */
+        return TCL_OK;
+    }
+    s = Tcl_GetStringFromObj(objPtr, &length);
+    if (length >= TABLE_VALUE_LENGTH) {
+        valuePtr->string = Blt_Strndup(s, length);
+        valuePtr->length = length;
+    } else {
+        strncpy(valuePtr->store, s, length);
+        valuePtr->store[length] = '\0';
+        valuePtr->string = TABLE_VALUE_STORE;
+        valuePtr->length = length;
+    }
+    return TCL_OK;
 }
 
+
 static int
-SetColumnType(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
-              BLT_TABLE_COLUMN_TYPE type)
+SetValueFromString(Tcl_Interp *interp, Column *colPtr, 
+                   BLT_TABLE_COLUMN_TYPE type, const char *s, int length,
+                   Value *valuePtr)
 {
-    Row *rowPtr;
+    double d;
+    long l;
+    Tcl_Obj *objPtr;
 
-    if (type == colPtr->type) {
-        return TCL_OK;                  /* Already the requested type. */
+    if (length < 0) {
+        length = strlen(s);
     }
-    /* First test that every value in the column can be converted. */
-    for (rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL; 
-         rowPtr = rowPtr->nextPtr) {
-        if (!IsEmpty(rowPtr, colPtr)) {
-            Value value;
-            Value *valuePtr;
+    objPtr = NULL;
+    if ((type == TABLE_COLUMN_TYPE_TIME) && (colPtr != NULL) &&
+        (colPtr->timeFmtPtr != NULL) &&
+        (Blt_ParseTimeWithFormat(NULL, colPtr->timeFmtPtr, s, length, &d)
+         == TCL_OK)) {
+        /* Fixed-field parse of the column's time format.  The string is
+         * kept as is. */
+        valuePtr->datum.d = d;
+    } else if (((type == TABLE_COLUMN_TYPE_DOUBLE) || 
+                (type == TABLE_COLUMN_TYPE_LONG) ||
+                (type == TABLE_COLUMN_TYPE_INT64)) && 
+               (ScanPlainNumber(type, s, length, valuePtr))) {
+        /* Plain decimal number, converted without a Tcl_Obj.  The string
+         * is kept as is. */
+    } else if ((type != TABLE_COLUMN_TYPE_STRING) &&
+        (type != TABLE_COLUMN_TYPE_BLOB)) {
 
-            valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-            memset(&value, 0, sizeof(Value));
-            if (SetValueFromString(interp, type, GetValueString(valuePtr),
-                        GetValueLength(valuePtr), &value) != TCL_OK) {
+        /* For the non-string types, make a copy of the string as a
+         * Tcl_Obj.  This will give us a canonical string representation
+         * and also verify that the string is valid.  */
+        objPtr = Tcl_NewStringObj(s, length);
+        Tcl_IncrRefCount(objPtr);
+        
+        switch (type) {
+        case TABLE_COLUMN_TYPE_TIME:    
+            if (Blt_GetTimeFromObj(interp, objPtr, &d) != TCL_OK) {
+                Tcl_DecrRefCount(objPtr);
                 return TCL_ERROR;
             }
-            ResetValue(&value);
-        }
-    }
-    /* Now replace the column with the converted the values. */
-    for (rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL; 
-         rowPtr = rowPtr->nextPtr) {
-        if (!IsEmpty(rowPtr, colPtr)) {
-            Value *valuePtr;
+            valuePtr->datum.d = d;      /* double */
+            break;
+            
+        case TABLE_COLUMN_TYPE_DOUBLE:  
+            if (Blt_GetDoubleFromObj(interp, objPtr, &d) != TCL_OK) {
+                Tcl_DecrRefCount(objPtr);
+                return TCL_ERROR;
+            }
+            valuePtr->datum.d = d;      /* double */
+            break;
 
-            valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-            if (SetValueFromString(interp, type, GetValueString(valuePtr),
-                 GetValueLength(valuePtr), valuePtr) != TCL_OK) {
+        case TABLE_COLUMN_TYPE_LONG:    
+            if (Blt_GetLongFromObj(interp, objPtr, &l) != TCL_OK) {
+                Tcl_DecrRefCount(objPtr);
                 return TCL_ERROR;
             }
+            valuePtr->datum.l = l;      /* long */
+            break;
+
+        case TABLE_COLUMN_TYPE_INT64:    
+            {
+                int64_t i;
+                
+                if (Blt_GetInt64FromObj(interp, objPtr, &i) != TCL_OK) {
+                    Tcl_DecrRefCount(objPtr);
+                    return TCL_ERROR;
+                }
+                valuePtr->datum.i64 = i;      /* long */
+            }
+            break;
+
+        case TABLE_COLUMN_TYPE_BOOLEAN: 
+            {
+                int ival;
+                
+                if (Tcl_GetBooleanFromObj(interp, objPtr, &ival) != TCL_OK) {
+                    Tcl_DecrRefCount(objPtr);
+                    return TCL_ERROR;
+                }
+                valuePtr->datum.l = ival; /* boolean */
+            }
+            break;
+        default:
+            break;
         }
+        s = Tcl_GetStringFromObj(objPtr, &length);
+    }        
+
+    ResetValue(valuePtr);
+    if (length >= TABLE_VALUE_LENGTH) {
+        valuePtr->string = Blt_Strndup(s, length);
+        valuePtr->length = length;
+    } else {
+        strncpy(valuePtr->store, s, length);
+        valuePtr->store[length] = '\0';
+        valuePtr->string = TABLE_VALUE_STORE;
+        valuePtr->length = length;
+    }
+    if (objPtr != NULL) {
+        Tcl_DecrRefCount(objPtr);
     }
-    colPtr->type = type;
     return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * UnsetValue --
+ * PutNumber --
  *
- *      Removes the value from the selected row, column location in the
- *      table.  The row, column location must be within the actual table
- *      limits, but it's okay if there isn't a value there to remove.
- *
- * Results:
- *      None.
- *
- * Side Effects:
- *      The objPtr representing the value is released.
+ *      Stores a number of the given type in the cell.  If the column is
+ *      of a different type (such as a string column), the number is
+ *      converted through its string representation.
  *
  *---------------------------------------------------------------------------
  */
-static void
-UnsetValue(Table *tablePtr, Row *rowPtr, Column *colPtr)
+static int
+PutNumber(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr, Column *colPtr,
+          BLT_TABLE_COLUMN_TYPE type, Value *valuePtr)
 {
-    Value *valuePtr;
-
-    if (colPtr->vector == NULL) {
-        return;
-    }
-    valuePtr = colPtr->vector + rowPtr->offset;
-    if (!IsEmptyValue(valuePtr)) {
-        /* Indicate the keytables need to be regenerated. */
-        if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
-            tablePtr->flags |= TABLE_KEYS_DIRTY;
+    char string[DENSE_STRING_LENGTH];
+    Value value;
+
+    if (colPtr->type == type) {
+        valuePtr->string = NULL;
+        if (!IsDenseColumn(colPtr)) {
+            FormatDatum(type, valuePtr, string);
+            valuePtr->length = strlen(string);
+            if (valuePtr->length >= TABLE_VALUE_LENGTH) {
+                valuePtr->string = Blt_AssertStrdup(string);
+            } else {
+                strcpy(valuePtr->store, string);
+                valuePtr->string = TABLE_VALUE_STORE;
+            }
         }
+        return PutValue(interp, tablePtr, rowPtr, colPtr, valuePtr);
     }
-    ResetValue(valuePtr);
+    FormatDatum(type, valuePtr, string);
+    memset(&value, 0, sizeof(Value));
+    if (SetValueFromString(interp, colPtr, colPtr->type, string, 
+                           strlen(string), &value) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    return PutValue(interp, tablePtr, rowPtr, colPtr, &value);
 }
 
-static void
-UnsetRowValues(Table *tablePtr, Row *rowPtr)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * NewTableObject --
+ *
+ *      Creates and initializes a new table object. 
+ *
+ * Results:
+ *      Returns a pointer to the new object is successful, NULL otherwise.
+ *      If a table object can't be generated, interp->result will contain
+ *      an error message.
+ *
+ * -------------------------------------------------------------------------- 
+ */
+static TableObject *
+NewTableObject(void)
 {
-    Column *colPtr;
+    TableObject *corePtr;
 
-    for (colPtr = tablePtr->corePtr->columns.headPtr; colPtr != NULL;
-         colPtr = colPtr->nextPtr) {
-        if (colPtr->vector != NULL) {
-            UnsetValue(tablePtr, rowPtr, colPtr);
-        }
+    corePtr = Blt_Calloc(1, sizeof(TableObject));
+    if (corePtr == NULL) {
+        return NULL;
     }
-}
+    corePtr->clients = Blt_Chain_Create();
 
-static void
-DeleteRow(Rows *rowsPtr, Row *rowPtr)
-{
-    /* If there is a label is associated with the row, free it. */
-    if (rowPtr->label != NULL) {
-        UnsetRowLabel(rowsPtr, rowPtr);
-    }
-    /* Unlink the row from the list of rows. */
-    if (rowsPtr->headPtr == rowPtr) {
-        rowsPtr->headPtr = rowPtr->nextPtr;
-    }
-    if (rowsPtr->tailPtr == rowPtr) {
-        rowsPtr->tailPtr = rowPtr->prevPtr;
-    }
-    if (rowPtr->nextPtr != NULL) {
-        rowPtr->nextPtr->prevPtr = rowPtr->prevPtr;
-    }
-    if (rowPtr->prevPtr != NULL) {
-        rowPtr->prevPtr->nextPtr = rowPtr->nextPtr;
-    }
-    /* Mark the map entry as empty. */
-    rowsPtr->map[rowPtr->index] = NULL;
-    rowsPtr->flags |= REINDEX;
-    if (rowsPtr->freeList != NULL) {
-        /* We don't delete row storage, just add the row offset back onto
-         * the free list. */
-        Blt_Chain_Append(rowsPtr->freeList,
-                         (ClientData)(uintptr_t)rowPtr->offset);
-    }
-    /* Finally free the row itself. */
-    Blt_Pool_FreeItem(rowsPtr->pool, rowPtr);
-    rowsPtr->numUsed--;
+    Blt_InitHashTableWithPool(&corePtr->columns.labelTable, BLT_STRING_KEYS);
+    Blt_InitHashTableWithPool(&corePtr->rows.labelTable, BLT_STRING_KEYS);
+    corePtr->columns.pool = Blt_Pool_Create(BLT_FIXED_SIZE_ITEMS);
+    corePtr->columns.nextColumnId = 1;
+    corePtr->rows.pool = Blt_Pool_Create(BLT_FIXED_SIZE_ITEMS);
+    corePtr->rows.nextRowId = 1;
+    return corePtr;
 }
 
 static void
-DeleteColumn(Table *tablePtr, Column *colPtr)
+DestroyTraces(Table *tablePtr)
 {
-    Columns *columnsPtr;
+    Blt_HashEntry *hPtr;
+    Blt_HashSearch iter;
 
-    columnsPtr = &tablePtr->corePtr->columns;
-    /* If there is a label is associated with the column, free it. */
-    if (colPtr->label != NULL) {
-        UnsetColumnLabel(columnsPtr, colPtr);
-    }
-    if (columnsPtr->headPtr == colPtr) {
-        columnsPtr->headPtr = colPtr->nextPtr;
-    }
-    if (columnsPtr->tailPtr == colPtr) {
-        columnsPtr->tailPtr = colPtr->prevPtr;
-    }
-    if (colPtr->nextPtr != NULL) {
-        colPtr->nextPtr->prevPtr = colPtr->prevPtr;
-    }
-    if (colPtr->prevPtr != NULL) {
-        colPtr->prevPtr->nextPtr = colPtr->nextPtr;
-    }
-    colPtr->prevPtr = colPtr->nextPtr = NULL;
-    columnsPtr->map[colPtr->index] = NULL;
-    columnsPtr->flags |= REINDEX;
-    if (colPtr->vector != NULL) {
-        Row *rowPtr;
+    for (hPtr = Blt_FirstHashEntry(&tablePtr->traces, &iter); hPtr != NULL; 
+         hPtr = Blt_NextHashEntry(&iter)) {
+        Trace *tracePtr;
 
-        for (rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL;
-             rowPtr = rowPtr->nextPtr) {
-            ResetValue(colPtr->vector + rowPtr->offset);
-        }
-        Blt_Free(colPtr->vector);
-        colPtr->vector = NULL;
+        tracePtr = Blt_GetHashValue(hPtr);
+        blt_table_delete_trace(tablePtr, tracePtr);
     }
-    /* Finally free the column. */
-    Blt_Pool_FreeItem(columnsPtr->pool, colPtr);
-    columnsPtr->numUsed--;
+    Blt_Chain_Destroy(tablePtr->readTraces);
+    Blt_Chain_Destroy(tablePtr->writeTraces);
+    Blt_DeleteHashTable(&tablePtr->traces);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * ClearRowNotifiers --
+ * DoTrace --
  *
- *      Removes all event handlers set for the designated row.  Note that
- *      this doesn't remove handlers triggered by row or column tags.  Row
- *      and column event notifiers are stored in a chain.
+ *      Fires a trace set by a client of the table object.  Trace
+ *      procedures should return a standard TCL result.
+ *
+ *         TCL_OK       procedure executed successfully.
+ *         TCL_ERROR    procedure failed.
+ *         TCL_BREAK    don't execute any further trace procedures.
+ *         TCL_CONTINUE treat like TCL_OK.
+ *
+ *      A trace procedure can in turn trigger more traces.  Traces are
+ *      prohibited from recursively reentering their own trace procedures.
+ *      A hash table in the trace structure tracks the cells currently
+ *      actively traced.  If a cell is already being traced, the trace
+ *      procedure is not called and TCL_OK is blindly returned.
+ *
+ * Results:
+ *      Returns the result of trace procedure.  If the trace is already
+ *      active, then TCL_OK is returned.
+ *
+ * Side Effects:
+ *      Traces on the table location may be fired.
  *
  *---------------------------------------------------------------------------
  */
-static void
-ClearRowNotifiers(Table *tablePtr, Row *rowPtr)
+static int
+DoTrace(Trace *tracePtr, BLT_TABLE_TRACE_EVENT *eventPtr)
 {
-    Blt_ChainLink link, next;
+    int result;
 
-    for (link = Blt_Chain_FirstLink(tablePtr->rowNotifiers); link != NULL;
-         link = next) {
-        Notifier *notifierPtr;
+    /* 
+     * Check for individual traces on a cell.  Each trace has a hash table
+     * that tracks what cells are actively being traced. This is to prevent
+     * traces from triggering recursive callbacks.
+     */
+    Tcl_Preserve(tracePtr);
+    tracePtr->flags |= TABLE_TRACE_ACTIVE;
+    result = (*tracePtr->proc)(tracePtr->clientData, eventPtr);
+    tracePtr->flags &= ~TABLE_TRACE_ACTIVE;
+    Tcl_Release(tracePtr);
 
-        next = Blt_Chain_NextLink(link);
-        notifierPtr = Blt_Chain_GetValue(link);
-        if (notifierPtr->row == rowPtr) {
-            blt_table_delete_notifier(tablePtr, notifierPtr);
-        }
+    if (result == TCL_ERROR) {
+        Blt_Warn("error in trace callback: %s\n", 
+                 Tcl_GetString(Tcl_GetObjResult(eventPtr->interp)));
+        Tcl_BackgroundError(eventPtr->interp);
     }
+    return result;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * ClearColumnNotifiers --
+ * TraceIdleProc --
  *
- *      Removes all event handlers set for the designated row.  Note that
- *      this doesn't remove handlers triggered by row or column tags.  Row
- *      and column event notifiers are stored in a chain.
+ *      Used to invoke a table trace handler routines at some idle point.
+ *      This routine is called from the TCL event loop.  Errors generated
+ *      by the event handler routines are backgrounded.
+ *      
+ * Results:
+ *      None.
  *
  *---------------------------------------------------------------------------
  */
 static void
-ClearColumnNotifiers(Table *tablePtr, Column *colPtr)
+TraceIdleProc(ClientData clientData)
 {
-    Blt_ChainLink link, next;
+    Trace *tracePtr = clientData;
 
-    for (link = Blt_Chain_FirstLink(tablePtr->columnNotifiers); link != NULL; 
-        link = next) {
-        Notifier *notifierPtr;
+    tracePtr->flags &= ~TABLE_TRACE_PENDING;
 
-        next = Blt_Chain_NextLink(link);
-        notifierPtr = Blt_Chain_GetValue(link);
-        if (notifierPtr->column == colPtr) {
-            blt_table_delete_notifier(tablePtr, notifierPtr);
-        }
-    }
+    /* Protect the notifier in case it's deleted by the callback. */
+    Tcl_Preserve(tracePtr);
+    DoTrace(tracePtr, &tracePtr->event);
+    Tcl_Release(tracePtr);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * DoNotify --
- *
- *      Traverses the client's list of event callbacks and checks if one
- *      matches the given event.  A client may trigger an action that
- *      causes the itself to be notified again.  This can be prevented by
- *      setting the TABLE_NOTIFY_FOREIGN_ONLY bit in the event handler.
- *
- *      If a matching handler is found, a callback may be called either
- *      immediately or at the next idle time depending upon the
- *      TABLE_NOTIFY_WHENIDLE bit.
+ * NotifyIdleProc --
  *
- *      Since a handler routine may trigger yet another call to itself,
- *      callbacks are ignored while the event handler is executing.
+ *      Used to invoke event handler routines at some idle point.  This
+ *      routine is called from the TCL event loop.  Errors generated by the
+ *      event handler routines are backgrounded.
  *      
+ * Results:
+ *      None.
+ *
  *---------------------------------------------------------------------------
  */
 static void
-DoNotify(Table *tablePtr, Blt_Chain notifiers, 
-         BLT_TABLE_NOTIFY_EVENT *eventPtr)
+NotifyIdleProc(ClientData clientData)
 {
-    Blt_ChainLink link;
-    unsigned int eventMask;
+    Notifier *notifierPtr = clientData;
+    int result;
 
-    /* Check the client table for matching notifiers.  Issue callbacks
-     * indicating that the structure of the table has changed.  */
-    eventMask = eventPtr->type & TABLE_NOTIFY_MASK;
-    for (link = Blt_Chain_FirstLink(notifiers); link != NULL; 
-         link = Blt_Chain_NextLink(link)) {
-        Notifier *notifierPtr;
-        int match;
+    notifierPtr->flags &= ~TABLE_NOTIFY_PENDING;
 
-        notifierPtr = Blt_Chain_GetValue(link);
-        if ((notifierPtr->flags & eventMask) == 0) {
-            continue;                   /* Event type doesn't match */
-        }
-        if ((eventPtr->self) && 
-            (notifierPtr->flags & TABLE_NOTIFY_FOREIGN_ONLY)) {
-            continue;                   /* Don't notify yourself. */
-        }
-        if (notifierPtr->flags & TABLE_NOTIFY_ACTIVE) {
-            continue;                   /* Ignore callbacks that are
-                                         * generated inside of a notify
-                                         * handler routine. */
-        }
-        match = FALSE;
-        if (notifierPtr->tag != NULL) {
-            if (notifierPtr->flags & TABLE_NOTIFY_ROW) {
-                if (blt_table_row_has_tag(tablePtr, eventPtr->row, 
-                        notifierPtr->tag)) {
-                    match++;
-                }
-            } else {
-                if (blt_table_column_has_tag(tablePtr, eventPtr->column, 
-                        notifierPtr->tag)) {
-                    match++;
-                }
-            }
-        } else if ((notifierPtr->flags & TABLE_NOTIFY_ROW) && 
-                   ((notifierPtr->row == NULL) || 
-                    (notifierPtr->row == eventPtr->row))) {
-            match++;                    /* Offsets match. */
-        } else if ((notifierPtr->flags & TABLE_NOTIFY_COLUMN) && 
-                   ((notifierPtr->column == NULL) ||
-                    (notifierPtr->column == eventPtr->column))) {
-            match++;                    /* Offsets match. */
-        }
-        if (!match) {
-            continue;                   /* Row or column doesn't match. */
-        }
-        if (notifierPtr->flags & TABLE_NOTIFY_WHENIDLE) {
-            if ((notifierPtr->flags & TABLE_NOTIFY_PENDING) == 0) {
-                notifierPtr->flags |= TABLE_NOTIFY_PENDING;
-                notifierPtr->event = *eventPtr;
-                Tcl_DoWhenIdle(NotifyIdleProc, notifierPtr);
-            }
-        } else {
-            notifierPtr->event = *eventPtr;
-            NotifyIdleProc(notifierPtr);
-        }
+    /* Protect the notifier in case it's deleted by the callback. */
+    Tcl_Preserve(notifierPtr);
+    notifierPtr->flags |= TABLE_NOTIFY_ACTIVE;
+    result = (*notifierPtr->proc)(notifierPtr->clientData, &notifierPtr->event);
+    notifierPtr->flags &= ~TABLE_NOTIFY_ACTIVE;
+    if (result == TCL_ERROR) {
+        Tcl_BackgroundError(notifierPtr->interp);
     }
+    Tcl_Release(notifierPtr);
 }
 
+static void
+FreeNotifier(Notifier *notifierPtr) 
+{
+    if (notifierPtr->tag != NULL) {
+        Blt_Free(notifierPtr->tag);
+    }
+    if (notifierPtr->link != NULL){
+        Blt_Chain_DeleteLink(notifierPtr->chain, notifierPtr->link);
+    }
+    Blt_Free(notifierPtr);
+}
 
 static void
-InitNotifyEvent(Table *tablePtr, BLT_TABLE_NOTIFY_EVENT *eventPtr)
+DestroyNotifiers(Table *tablePtr, Blt_Chain chain)
 {
-    memset(eventPtr, 0, sizeof(BLT_TABLE_NOTIFY_EVENT));
-    eventPtr->table = tablePtr;
-    eventPtr->interp = tablePtr->interp;
+    Blt_ChainLink link;
+
+    for (link = Blt_Chain_FirstLink(chain); link != NULL; 
+         link = Blt_Chain_NextLink(link)) {
+        Notifier *notifierPtr;
+
+        notifierPtr = Blt_Chain_GetValue(link);
+        notifierPtr->link = NULL;
+        blt_table_delete_notifier(tablePtr, notifierPtr);
+    }
+    Blt_Chain_Destroy(chain);
 }
 
-/*
- *---------------------------------------------------------------------------
- *
- * NotifyClients --
- *
- *      Traverses the list of event callbacks and checks if one matches the
- *      given event.  A client may trigger an action that causes the table
- *      object to notify it.  This can be prevented by setting the
- *      TABLE_NOTIFY_FOREIGN_ONLY bit in the event handler.
- *
- *      If a matching handler is found, a callback may be called either
- *      immediately or at the next idle time depending upon the
- *      TABLE_NOTIFY_WHENIDLE bit.
- *
- *      Since a handler routine may trigger yet another call to itself,
- *      callbacks are ignored while the event handler is executing.
- *      
- *---------------------------------------------------------------------------
- */
+
 static void
-NotifyClients(Table *tablePtr, BLT_TABLE_NOTIFY_EVENT *eventPtr)
+FreeRows(TableObject *corePtr)
 {
-    Blt_ChainLink link, next;
-    
-    for (link = Blt_Chain_FirstLink(tablePtr->corePtr->clients); link != NULL; 
-         link = next) {
-        Table *clientPtr;
-        Blt_Chain chain;
+    Blt_HashEntry *hPtr;
+    Blt_HashSearch iter;
+    Rows *rowsPtr;
+
+    rowsPtr = &corePtr->rows;
+    for (hPtr = Blt_FirstHashEntry(&rowsPtr->labelTable, &iter); hPtr != NULL;
+         hPtr = Blt_NextHashEntry(&iter)) {
+        Blt_HashTable *tablePtr;
         
-        next = Blt_Chain_NextLink(link);
-        clientPtr = Blt_Chain_GetValue(link);
-        eventPtr->self = (clientPtr == tablePtr);
-        chain = (eventPtr->type & TABLE_NOTIFY_COLUMN) ?
-            clientPtr->columnNotifiers : clientPtr->rowNotifiers;
-        if (Blt_Chain_GetLength(chain) > 0) {
-            DoNotify(clientPtr, chain, eventPtr);
+        tablePtr = Blt_GetHashValue(hPtr);
+        Blt_DeleteHashTable(tablePtr);
+        Blt_Free(tablePtr);
+    }
+    Blt_DeleteHashTable(&rowsPtr->labelTable);
+    Blt_Pool_Destroy(rowsPtr->pool);
+    if (rowsPtr->freeOffsets != NULL) {
+        Blt_Free(rowsPtr->freeOffsets);
+        rowsPtr->freeOffsets = NULL;
+    }
+    rowsPtr->firstFree = rowsPtr->lastFree = rowsPtr->freeSize = 0;
+    ClearRowHoles(rowsPtr);
+    if (rowsPtr->map != NULL) {
+        Blt_Free(rowsPtr->map);
+        rowsPtr->map = NULL;
+    }
+    if (rowsPtr->offsets != NULL) {
+        Blt_Free(rowsPtr->offsets);
+        rowsPtr->offsets = NULL;
+    }
+    rowsPtr->numAllocated = rowsPtr->numUsed = 0;
+}
+
+static void
+FreeColumns(TableObject *corePtr)
+{
+    Blt_HashEntry *hPtr;
+    Blt_HashSearch iter;
+    Column *colPtr;
+    Columns *columnsPtr;
+
+    columnsPtr = &corePtr->columns;
+    for (colPtr = columnsPtr->headPtr; colPtr != NULL; 
+         colPtr = colPtr->nextPtr) {
+        DestroyColumnViews(NULL, colPtr, corePtr->rows.numUsed);
+        FreeColumnValues(&corePtr->rows, colPtr);
+        if (colPtr->indexPtr != NULL) {
+            FreeIndex(colPtr);
+        }
+        if (colPtr->timeFmtPtr != NULL) {
+            Blt_FreeTimeFormat(colPtr->timeFmtPtr);
         }
     }
+    for (hPtr = Blt_FirstHashEntry(&columnsPtr->labelTable, &iter); 
+         hPtr != NULL; hPtr = Blt_NextHashEntry(&iter)) {
+        Blt_HashTable *tablePtr;
+        
+        tablePtr = Blt_GetHashValue(hPtr);
+        Blt_DeleteHashTable(tablePtr);
+        Blt_Free(tablePtr);
+    }
+    Blt_DeleteHashTable(&columnsPtr->labelTable);
+    if (columnsPtr->pool != NULL) {
+        Blt_Pool_Destroy(columnsPtr->pool);
+    }
+    if (columnsPtr->map != NULL) {
+        Blt_Free(columnsPtr->map);
+        columnsPtr->map = NULL;
+    }
+    columnsPtr->numAllocated = columnsPtr->numUsed = 0;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * NotifyColumnChanged --
+ * DestroyTableObject --
  *
- *      Traverses the list of event callbacks and checks if one matches the
- *      given event.  A client may trigger an action that causes the table
- *      object to notify it.  This can be prevented by setting the
- *      TABLE_NOTIFY_FOREIGN_ONLY bit in the event handler.
+ *      Destroys the table object.  This is the final clean up of the
+ *      object.  The object's entry is removed from the hash table of
+ *      tables.
  *
- *      If a matching handler is found, a callback may be called either
- *      immediately or at the next idle time depending upon the
- *      TABLE_NOTIFY_WHENIDLE bit.
+ * Results: 
+ *      None.
  *
- *      Since a handler routine may trigger yet another call to itself,
- *      callbacks are ignored while the event handler is executing.
- *      
- *---------------------------------------------------------------------------
+ * -------------------------------------------------------------------------- 
  */
 static void
-NotifyColumnChanged(Table *tablePtr, Column *colPtr, unsigned int flags)
+DestroyTableObject(TableObject *corePtr)
 {
-    BLT_TABLE_NOTIFY_EVENT event;
+    corePtr->flags |= TABLE_DESTROYED;
 
-    InitNotifyEvent(tablePtr, &event);
-    event.type = flags | TABLE_NOTIFY_COLUMN;
-    event.column = colPtr;
-    NotifyClients(tablePtr, &event);
+    assert(Blt_Chain_GetLength(corePtr->clients) == 0);
+    Blt_Chain_Destroy(corePtr->clients);
+
+    FreeColumns(corePtr);
+    FreeRows(corePtr);
+    ReleaseMapping(corePtr);
+    while (corePtr->batchPtr != NULL) {
+        TableBatch *batchPtr;
+
+        batchPtr = corePtr->batchPtr;
+        corePtr->batchPtr = batchPtr->nextPtr;
+        FreeBatch(batchPtr);
+    }
+    Blt_Free(corePtr);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * NotifyRowChanged --
+ * TableInterpDeleteProc --
  *
- *      Traverses the list of event callbacks and checks if one matches the
- *      given event.  A client may trigger an action that causes the table
- *      object to notify it.  This can be prevented by setting the
- *      TABLE_NOTIFY_FOREIGN_ONLY bit in the event handler.
+ *      This is called when the interpreter hosting the table object is
+ *      deleted from the interpreter.
  *
- *      If a matching handler is found, a callback may be called either
- *      immediately or at the next idle time depending upon the
- *      TABLE_NOTIFY_WHENIDLE bit.
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Destroys all remaining tables and removes the hash table used to
+ *      register table names.
  *
- *      Since a handler routine may trigger yet another call to itself,
- *      callbacks are ignored while the event handler is executing.
- *      
  *---------------------------------------------------------------------------
  */
+/* ARGSUSED */
 static void
-NotifyRowChanged(Table *tablePtr, Row *rowPtr, unsigned int flags)
+TableInterpDeleteProc(ClientData clientData, Tcl_Interp *interp)
 {
-    BLT_TABLE_NOTIFY_EVENT event;
+    InterpData *dataPtr;
+    Blt_HashEntry *hPtr;
+    Blt_HashSearch cursor;
+    
+    dataPtr = clientData;
+    for (hPtr = Blt_FirstHashEntry(&dataPtr->clientTable, &cursor);
+         hPtr != NULL; hPtr = Blt_NextHashEntry(&cursor)) {
+        Blt_Chain chain;
+        Blt_ChainLink link, next;
 
-    InitNotifyEvent(tablePtr, &event);
-    event.type = flags | TABLE_NOTIFY_ROW;
-    event.row = rowPtr;
-    NotifyClients(tablePtr, &event);
+        chain = Blt_GetHashValue(hPtr);
+        for (link = Blt_Chain_FirstLink(chain); link != NULL; link = next) {
+            Table *tablePtr;
+
+            next = Blt_Chain_NextLink(link);
+            tablePtr = Blt_Chain_GetValue(link);
+            tablePtr->link2 = NULL;
+            /* Don't destroy the client here. Let the client code close the
+             * table. */
+        }
+        Blt_Chain_Destroy(chain);
+    }
+    Blt_DeleteHashTable(&dataPtr->clientTable);
+    Tcl_DeleteAssocData(interp, TABLE_THREAD_KEY);
+    Blt_Free(dataPtr);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_clear_row_traces --
+ * GetInterpData --
  *
- *      Removes all traces set for this row.  Note that this doesn't remove
- *      traces set for specific cells (row,column).  Row traces are stored
- *      in a chain, which in turn is held in a hash table, keyed by the
- *      row.
+ *      Creates or retrieves data associated with tuple data objects for a
+ *      particular interpreter.
  *
- *---------------------------------------------------------------------------
- */
-void
-blt_table_clear_row_traces(Table *tablePtr, Row *rowPtr)
+ * Results:
+ *      Returns a pointer to the tuple interpreter data.
+ *
+ * -------------------------------------------------------------------------- 
+ */
+static InterpData *
+GetInterpData(Tcl_Interp *interp)
 {
-    Blt_ChainLink link, next;
-
-    for (link = Blt_Chain_FirstLink(tablePtr->readTraces); link != NULL; 
-         link = next) {
-        Trace *tracePtr;
+    Tcl_InterpDeleteProc *proc;
+    InterpData *dataPtr;
 
-        next = Blt_Chain_NextLink(link);
-        tracePtr = Blt_Chain_GetValue(link);
-        if (tracePtr->row == rowPtr) {
-            blt_table_delete_trace(tablePtr, tracePtr);
-        }
+    dataPtr = (InterpData *)
+        Tcl_GetAssocData(interp, TABLE_THREAD_KEY, &proc);
+    if (dataPtr == NULL) {
+        dataPtr = Blt_AssertMalloc(sizeof(InterpData));
+        dataPtr->interp = interp;
+        Tcl_SetAssocData(interp, TABLE_THREAD_KEY, TableInterpDeleteProc, 
+                dataPtr);
+        Blt_InitHashTable(&dataPtr->clientTable, BLT_STRING_KEYS);
     }
-    for (link = Blt_Chain_FirstLink(tablePtr->writeTraces); link != NULL; 
-         link = next) {
-        Trace *tracePtr;
+    return dataPtr;
+}
 
-        next = Blt_Chain_NextLink(link);
-        tracePtr = Blt_Chain_GetValue(link);
-        if (tracePtr->row == rowPtr) {
-            blt_table_delete_trace(tablePtr, tracePtr);
-        }
-    }
+
+const char *
+blt_table_column_type_to_name(BLT_TABLE_COLUMN_TYPE type)
+{
+    return valueTypes[type];
 }
 
+/*
+ * Row tag sets --
+ *
+ *      Each row tag is a TagSet: a compressed bitmap of the offsets of the
+ *      rows having the tag.  Offsets are stable for the life of a row
+ *      (only blt_table_pack renumbers them, and it remaps the tags), so
+ *      the sets are shared by clients whatever their view.  The row of an
+ *      offset is found through the offsets array of the row map.
+ */
+
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_clear_column_traces --
+ * NewTagSet --
  *
- *      Removes all traces set for this column.  Note that this doesn't
- *      remove traces set for specific cells (row,column).  Column traces
- *      are stored in a chain, which in turn is held in a hash table, keyed
- *      by the column.
+ *      Creates a new empty set of tagged rows.
  *
  *---------------------------------------------------------------------------
  */
-void
-blt_table_clear_column_traces(Table *tablePtr, BLT_TABLE_COLUMN column)
+static TagSet *
+NewTagSet(void)
 {
-    Blt_ChainLink link, next;
-
-    for (link = Blt_Chain_FirstLink(tablePtr->readTraces); link != NULL; 
-         link = next) {
-        Trace *tracePtr;
-
-        next = Blt_Chain_NextLink(link);
-        tracePtr = Blt_Chain_GetValue(link);
-        if (tracePtr->column == column) {
-            blt_table_delete_trace(tablePtr, tracePtr);
-        }
-    }
-    for (link = Blt_Chain_FirstLink(tablePtr->writeTraces); link != NULL; 
-         link = next) {
-        Trace *tracePtr;
-
-        next = Blt_Chain_NextLink(link);
-        tracePtr = Blt_Chain_GetValue(link);
-        if (tracePtr->column == column) {
-            blt_table_delete_trace(tablePtr, tracePtr);
-        }
-    }
+    return Blt_AssertCalloc(1, sizeof(TagSet));
 }
 
-
 /*
  *---------------------------------------------------------------------------
  *
- * CallClientTraces --
- *
- *      Examines the traces set for a specific client of the table object
- *      and fires any matching traces.
- *
- *      Traces match on row and column tag and indices and flags.
- *      Traces can match on
- *           flag               type of trace (read, write, unset, create)
- *           row index
- *           column index
- *           row tag
- *           column tag
- *
- *      If the TABLE_TRACE_FOREIGN_ONLY is set in the handler, it means to
- *      ignore actions that are initiated by that client of the object.
- *      Only actions by other clients are handled.
- *
- * Results:
- *      Always returns TCL_OK.
+ * FreeTagSet --
  *
- * Side Effects:
- *      Traces on the tuple table location may be fired.
+ *      Frees the set of tagged rows and its chunks.
  *
  *---------------------------------------------------------------------------
  */
 static void
-CallClientTraces(Table *tablePtr, Table *clientPtr, Row *rowPtr, Column *colPtr,
-                 unsigned int flags)
+FreeTagSet(TagSet *setPtr)
 {
-    Blt_Chain chain;
-    Blt_ChainLink link, next;
-    BLT_TABLE_TRACE_EVENT event;
-
-    /* Initialize trace event information. */
-    event.table = clientPtr;
-    event.row = rowPtr;
-    event.column = colPtr;
-    event.interp = clientPtr->interp;
-    if (tablePtr == clientPtr) {
-        flags |= TABLE_TRACE_SELF;
-    }
-    event.mask = flags;
-    if (flags & TABLE_TRACE_READS) {
-        chain = clientPtr->readTraces;
-    } else {
-        chain = clientPtr->writeTraces;
-    }
-    for (link = Blt_Chain_FirstLink(chain); link != NULL; link = next) {
-        Trace *tracePtr;
-        int match;
+    long i;
 
-        next = Blt_Chain_NextLink(link);
-        tracePtr = Blt_Chain_GetValue(link);
+    for (i = 0; i < setPtr->numChunks; i++) {
+        TagChunk *chunkPtr;
 
-        if ((tracePtr->flags & flags) == 0) {
-            continue;                   /* Doesn't match trace flags. */
-        }
-        if (tracePtr->flags & TABLE_TRACE_ACTIVE) {
-            continue;                   /* Ignore callbacks that were
-                                         * triggered from the active trace
-                                         * handler routine. */
-        }
-        match = 0;
-        if (tracePtr->colTag != NULL) {
-            if (blt_table_column_has_tag(clientPtr, colPtr, 
-                        tracePtr->colTag)) {
-                match++;
-            }
-        } else if ((tracePtr->column == colPtr) || (tracePtr->column == NULL)) {
-            match++;
-        }
-        if (tracePtr->rowTag != NULL) {
-            if (blt_table_row_has_tag(clientPtr, rowPtr, tracePtr->rowTag)) {
-                match++;
-            }
-        } else if ((tracePtr->row == rowPtr) || (tracePtr->row == NULL)) {
-            match++;
-        }
-        if (match < 2) {
-            continue;                   /* Must match both row and
-                                         * column.  */
+        chunkPtr = setPtr->chunks + i;
+        if (chunkPtr->array != NULL) {
+            Blt_Free(chunkPtr->array);
         }
-        if (tracePtr->flags & TABLE_TRACE_WHENIDLE) {
-            if ((tracePtr->flags & TABLE_TRACE_PENDING) == 0) {
-                tracePtr->flags |= TABLE_TRACE_PENDING;
-                tracePtr->event = event;
-                Tcl_DoWhenIdle(TraceIdleProc, tracePtr);
-            }
-        } else {
-            if (DoTrace(tracePtr, &event) == TCL_BREAK) {
-                return;                 /* Don't complete traces on
-                                         * break. */
-            }
+        if (chunkPtr->bits != NULL) {
+            Blt_Free(chunkPtr->bits);
         }
     }
+    if (setPtr->chunks != NULL) {
+        Blt_Free(setPtr->chunks);
+    }
+    if (setPtr->chain != NULL) {
+        Blt_Chain_Destroy(setPtr->chain);
+    }
+    Blt_Free(setPtr);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * CallTraces --
- *
- *      Examines the traces set for each client of the table object and
- *      fires any matching traces.
- *
- *      Traces match on row and column indices and flags.
- *      The order is 
- *        1. column traces.
- *        2. row traces.
- *        3. cell (row,column) traces.
- *
- *      If no matching criteria is specified (no tag, key, or tuple
- *      address) then only the bit flag has to match.
+ * SearchTagChunks --
  *
- *      If the TABLE_TRACE_FOREIGN_ONLY is set in the handler, it means to
- *      ignore actions that are initiated by that client of the object.
- *      Only actions by other clients are handled.
+ *      Searches for the chunk with the given key.
  *
  * Results:
- *      Always returns TCL_OK.
- *
- * Side Effects:
- *      Traces on the tuple table location may be fired.
+ *      Returns the position of the first chunk whose key is greater than
+ *      or equal to the given key.  *foundPtr* is set to indicate if the
+ *      chunk at that position has the key.
  *
  *---------------------------------------------------------------------------
  */
-static void
-CallTraces(Table *tablePtr, Row *rowPtr, Column *colPtr, unsigned int flags)
+static long
+SearchTagChunks(TagSet *setPtr, long key, int *foundPtr)
 {
-    Blt_ChainLink link, next;
+    long low, high;
 
-    for (link = Blt_Chain_FirstLink(tablePtr->corePtr->clients); link != NULL; 
-         link = next) {
-        Table *clientPtr;
+    low = 0, high = setPtr->numChunks;
+    while (low < high) {
+        long mid;
 
-        next = Blt_Chain_NextLink(link);
-        clientPtr = Blt_Chain_GetValue(link);
-        CallClientTraces(tablePtr, clientPtr, rowPtr, colPtr, flags);
+        mid = (low + high) >> 1;
+        if (setPtr->chunks[mid].key < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
     }
+    *foundPtr = ((low < setPtr->numChunks) && 
+                 (setPtr->chunks[low].key == key));
+    return low;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SearchTagArray --
+ *
+ *      Returns the position of the first member of the array chunk that
+ *      is greater than or equal to the given low bits.
+ *
+ *---------------------------------------------------------------------------
+ */
+static long
+SearchTagArray(TagChunk *chunkPtr, unsigned int bits)
+{
+    long low, high;
 
-typedef struct {
-    BLT_TABLE table;
-    BLT_TABLE_SORT_ORDER *order;
-    size_t numColumns;
-    unsigned int flags;
-} TableSortData;
-
-
-static TableSortData sortData;
+    low = 0, high = chunkPtr->numMembers;
+    while (low < high) {
+        long mid;
 
-static int
-CompareDictionaryStrings(ClientData clientData, Column *colPtr, Row *rowPtr1, 
-                         Row *rowPtr2)
-{
-    Value *valuePtr1, *valuePtr2;
-    
-    valuePtr1 = valuePtr2 = NULL;
-    if (colPtr->vector != NULL) {
-        valuePtr1 = colPtr->vector + rowPtr1->offset;
-        if (IsEmptyValue(valuePtr1)) {
-            valuePtr1 = NULL;
-        }
-        valuePtr2 = colPtr->vector + rowPtr2->offset;
-        if (IsEmptyValue(valuePtr2)) {
-            valuePtr2 = NULL;
-        }
-    }
-    if (IsEmptyValue(valuePtr1)) {
-        if (IsEmptyValue(valuePtr2)) {
-            return 0;
+        mid = (low + high) >> 1;
+        if (chunkPtr->array[mid] < bits) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
-        return 1;
-    } else if (IsEmptyValue(valuePtr2)) {
-        return -1;
     }
-    assert(valuePtr1 != NULL);
-    assert(valuePtr2 != NULL);
-    return Blt_DictionaryCompare(GetValueString(valuePtr1),
-                                 GetValueString(valuePtr2));
+    return low;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TagSetContains --
+ *
+ *      Indicates if the row offset is in the set.
+ *
+ *---------------------------------------------------------------------------
+ */
 static int
-CompareAsciiStrings(ClientData clientData, Column *colPtr, Row *rowPtr1, 
-                    Row *rowPtr2)
+TagSetContains(TagSet *setPtr, long offset)
 {
-    Value *valuePtr1, *valuePtr2;
+    TagChunk *chunkPtr;
+    long i;
+    unsigned int bits;
+    int found;
 
-    valuePtr1 = valuePtr2 = NULL;
-    if (colPtr->vector != NULL) {
-        valuePtr1 = colPtr->vector + rowPtr1->offset;
-        if (IsEmptyValue(valuePtr1)) {
-            valuePtr1 = NULL;
-        }
-        valuePtr2 = colPtr->vector + rowPtr2->offset;
-        if (IsEmptyValue(valuePtr2)) {
-            valuePtr2 = NULL;
-        }
+    i = SearchTagChunks(setPtr, offset >> TAG_CHUNK_BITS, &found);
+    if (!found) {
+        return FALSE;
     }
-    if (IsEmptyValue(valuePtr1)) {
-        if (IsEmptyValue(valuePtr2)) {
-            return 0;
-        }
-        return 1;
-    } else if (IsEmptyValue(valuePtr2)) {
-        return -1;
+    chunkPtr = setPtr->chunks + i;
+    bits = offset & TAG_CHUNK_MASK;
+    if (chunkPtr->bits != NULL) {
+        return (chunkPtr->bits[bits >> 6] >> (bits & 63)) & 1;
     }
-    return strcmp(GetValueString(valuePtr1), GetValueString(valuePtr2));
+    i = SearchTagArray(chunkPtr, bits);
+    return ((i < chunkPtr->numMembers) && (chunkPtr->array[i] == bits));
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TagSetAdd --
+ *
+ *      Adds the row offset to the set.  A new chunk is created if
+ *      needed.  When an array chunk is full, it's converted into a
+ *      bitmap.
+ *
+ * Results:
+ *      Returns TRUE if the offset was added, FALSE if it was already in
+ *      the set.
+ *
+ *---------------------------------------------------------------------------
+ */
 static int
-CompareAsciiStringsIgnoreCase(ClientData clientData, Column *colPtr,
-                              Row *rowPtr1, Row *rowPtr2)
+TagSetAdd(TagSet *setPtr, long offset)
 {
-    Value *valuePtr1, *valuePtr2;
+    TagChunk *chunkPtr;
+    long i, key;
+    unsigned int bits;
+    int found;
+
+    key = offset >> TAG_CHUNK_BITS;
+    bits = offset & TAG_CHUNK_MASK;
+    i = SearchTagChunks(setPtr, key, &found);
+    if (!found) {
+        if (setPtr->numChunks == setPtr->numAllocated) {
+            setPtr->numAllocated = (setPtr->numAllocated == 0) ? 4 :
+                setPtr->numAllocated * 2;
+            setPtr->chunks = Blt_AssertRealloc(setPtr->chunks, 
+                setPtr->numAllocated * sizeof(TagChunk));
+        }
+        memmove(setPtr->chunks + i + 1, setPtr->chunks + i, 
+                (setPtr->numChunks - i) * sizeof(TagChunk));
+        setPtr->numChunks++;
+        chunkPtr = setPtr->chunks + i;
+        memset(chunkPtr, 0, sizeof(TagChunk));
+        chunkPtr->key = key;
+    } 
+    chunkPtr = setPtr->chunks + i;
+    if (chunkPtr->bits == NULL) {
+        long j;
 
-    valuePtr1 = valuePtr2 = NULL;
-    if (colPtr->vector != NULL) {
-        valuePtr1 = colPtr->vector + rowPtr1->offset;
-        if (IsEmptyValue(valuePtr1)) {
-            valuePtr1 = NULL;
+        j = SearchTagArray(chunkPtr, bits);
+        if ((j < chunkPtr->numMembers) && (chunkPtr->array[j] == bits)) {
+            return FALSE;
         }
-        valuePtr2 = colPtr->vector + rowPtr2->offset;
-        if (IsEmptyValue(valuePtr2)) {
-            valuePtr2 = NULL;
+        if (chunkPtr->numMembers < TAG_ARRAY_MAX) {
+            if (chunkPtr->numMembers == chunkPtr->numAllocated) {
+                chunkPtr->numAllocated = (chunkPtr->numAllocated == 0) ? 4 :
+                    chunkPtr->numAllocated * 2;
+                chunkPtr->array = Blt_AssertRealloc(chunkPtr->array, 
+                        chunkPtr->numAllocated * sizeof(uint16_t));
+            }
+            memmove(chunkPtr->array + j + 1, chunkPtr->array + j, 
+                    (chunkPtr->numMembers - j) * sizeof(uint16_t));
+            chunkPtr->array[j] = bits;
+            goto done;
         }
-    }
-    if (IsEmptyValue(valuePtr1)) {
-        if (IsEmptyValue(valuePtr2)) {
-            return 0;
+        /* The array is full. Convert the chunk into a bitmap. */
+        chunkPtr->bits = Blt_AssertCalloc(TAG_BITMAP_WORDS, sizeof(uint64_t));
+        for (j = 0; j < chunkPtr->numMembers; j++) {
+            unsigned int b;
+
+            b = chunkPtr->array[j];
+            chunkPtr->bits[b >> 6] |= ((uint64_t)1 << (b & 63));
         }
-        return 1;
-    } else if (IsEmptyValue(valuePtr2)) {
-        return -1;
+        Blt_Free(chunkPtr->array);
+        chunkPtr->array = NULL;
+        chunkPtr->numAllocated = 0;
+    }
+    if (chunkPtr->bits[bits >> 6] & ((uint64_t)1 << (bits & 63))) {
+        return FALSE;
+    }
+    chunkPtr->bits[bits >> 6] |= ((uint64_t)1 << (bits & 63));
+ done:
+    chunkPtr->numMembers++;
+    setPtr->numMembers++;
+    if (setPtr->chain != NULL) {
+        Blt_Chain_Destroy(setPtr->chain);
+        setPtr->chain = NULL;
     }
-    return strcasecmp(GetValueString(valuePtr1), GetValueString(valuePtr2));
+    return TRUE;
 }
 
-static int
-CompareInt64s(ClientData clientData, Column *colPtr, Row *rowPtr1, 
-              Row *rowPtr2)
-{
-    Value *valuePtr1, *valuePtr2;
-
-    valuePtr1 = valuePtr2 = NULL;
-    if (colPtr->vector != NULL) {
-        valuePtr1 = colPtr->vector + rowPtr1->offset;
-        if (IsEmptyValue(valuePtr1)) {
-            valuePtr1 = NULL;
-        }
-        valuePtr2 = colPtr->vector + rowPtr2->offset;
-        if (IsEmptyValue(valuePtr2)) {
-            valuePtr2 = NULL;
-        }
-    }
-    if (IsEmptyValue(valuePtr1)) {
-        if (IsEmptyValue(valuePtr2)) {
-            return 0;
-        }
-        return 1;
-    } else if (IsEmptyValue(valuePtr2)) {
-        return -1;
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TagSetRemove --
+ *
+ *      Removes the row offset from the set.  Empty chunks are freed and
+ *      a bitmap chunk that has become sparse is converted back into an
+ *      array.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+TagSetRemove(TagSet *setPtr, long offset)
+{
+    TagChunk *chunkPtr;
+    long i;
+    unsigned int bits;
+    int found;
+
+    i = SearchTagChunks(setPtr, offset >> TAG_CHUNK_BITS, &found);
+    if (!found) {
+        return;
     }
-    return valuePtr1->datum.i64 - valuePtr2->datum.i64;
-}
+    chunkPtr = setPtr->chunks + i;
+    bits = offset & TAG_CHUNK_MASK;
+    if (chunkPtr->bits != NULL) {
+        uint64_t mask;
 
-static int
-CompareLongs(ClientData clientData, Column *colPtr, Row *rowPtr1, 
-             Row *rowPtr2)
-{
-    Value *valuePtr1, *valuePtr2;
+        mask = (uint64_t)1 << (bits & 63);
+        if ((chunkPtr->bits[bits >> 6] & mask) == 0) {
+            return;
+        }
+        chunkPtr->bits[bits >> 6] &= ~mask;
+        chunkPtr->numMembers--;
+        /* Convert back to an array when the chunk is half the size of a
+         * full array, so that alternately adding and removing a row
+         * doesn't convert the chunk back and forth. */
+        if (chunkPtr->numMembers <= (TAG_ARRAY_MAX / 2)) {
+            long j, count;
+
+            chunkPtr->numAllocated = TAG_ARRAY_MAX / 2;
+            chunkPtr->array = Blt_AssertMalloc(chunkPtr->numAllocated * 
+                                               sizeof(uint16_t));
+            count = 0;
+            for (j = 0; j < TAG_CHUNK_SIZE; j++) {
+                if (chunkPtr->bits[j >> 6] & ((uint64_t)1 << (j & 63))) {
+                    chunkPtr->array[count] = (uint16_t)j;
+                    count++;
+                }
+            }
+            assert(count == chunkPtr->numMembers);
+            Blt_Free(chunkPtr->bits);
+            chunkPtr->bits = NULL;
+        }
+    } else {
+        long j;
 
-    valuePtr1 = valuePtr2 = NULL;
-    if (colPtr->vector != NULL) {
-        valuePtr1 = colPtr->vector + rowPtr1->offset;
-        if (IsEmptyValue(valuePtr1)) {
-            valuePtr1 = NULL;
+        j = SearchTagArray(chunkPtr, bits);
+        if ((j >= chunkPtr->numMembers) || (chunkPtr->array[j] != bits)) {
+            return;
         }
-        valuePtr2 = colPtr->vector + rowPtr2->offset;
-        if (IsEmptyValue(valuePtr2)) {
-            valuePtr2 = NULL;
+        chunkPtr->numMembers--;
+        memmove(chunkPtr->array + j, chunkPtr->array + j + 1, 
+                (chunkPtr->numMembers - j) * sizeof(uint16_t));
+    }
+    setPtr->numMembers--;
+    if (chunkPtr->numMembers == 0) {
+        if (chunkPtr->array != NULL) {
+            Blt_Free(chunkPtr->array);
         }
+        setPtr->numChunks--;
+        memmove(setPtr->chunks + i, setPtr->chunks + i + 1, 
+                (setPtr->numChunks - i) * sizeof(TagChunk));
     }
-    if (IsEmptyValue(valuePtr1)) {
-        if (IsEmptyValue(valuePtr2)) {
-            return 0;
-        }
-        return 1;
-    } else if (IsEmptyValue(valuePtr2)) {
-        return -1;
+    if (setPtr->chain != NULL) {
+        Blt_Chain_Destroy(setPtr->chain);
+        setPtr->chain = NULL;
     }
-    return valuePtr1->datum.l - valuePtr2->datum.l;
 }
 
-static int
-CompareDoubles(ClientData clientData, Column *colPtr, Row *rowPtr1, 
-                    Row *rowPtr2)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TagSetNext --
+ *
+ *      Searches for the first row offset in the set that is greater than
+ *      or equal to the given offset.
+ *
+ * Results:
+ *      Returns the offset found, or -1 if there are no more members.
+ *
+ *---------------------------------------------------------------------------
+ */
+static long
+TagSetNext(TagSet *setPtr, long offset)
 {
-    Value *valuePtr1, *valuePtr2;
+    long i, key;
+    int found;
+
+    key = offset >> TAG_CHUNK_BITS;
+    for (i = SearchTagChunks(setPtr, key, &found); i < setPtr->numChunks; 
+         i++) {
+        TagChunk *chunkPtr;
+        unsigned int bits;
+
+        chunkPtr = setPtr->chunks + i;
+        bits = (chunkPtr->key == key) ? (offset & TAG_CHUNK_MASK) : 0;
+        if (chunkPtr->bits != NULL) {
+            long word;
+            uint64_t w;
+
+            word = bits >> 6;
+            w = chunkPtr->bits[word] & (~(uint64_t)0 << (bits & 63));
+            while (w == 0) {
+                word++;
+                if (word == TAG_BITMAP_WORDS) {
+                    break;
+                }
+                w = chunkPtr->bits[word];
+            }
+            if (w != 0) {
+                long b;
 
+                for (b = 0; (w & 0xFF) == 0; b += 8) {
+                    w >>= 8;
+                }
+                for (/*empty*/; (w & 1) == 0; b++) {
+                    w >>= 1;
+                }
+                return (chunkPtr->key << TAG_CHUNK_BITS) | (word << 6) | b;
+            }
+        } else {
+            long j;
 
-    valuePtr1 = valuePtr2 = NULL;
-    if (colPtr->vector != NULL) {
-        valuePtr1 = colPtr->vector + rowPtr1->offset;
-        if (IsEmptyValue(valuePtr1)) {
-            valuePtr1 = NULL;
-        }
-        valuePtr2 = colPtr->vector + rowPtr2->offset;
-        if (IsEmptyValue(valuePtr2)) {
-            valuePtr2 = NULL;
+            j = SearchTagArray(chunkPtr, bits);
+            if (j < chunkPtr->numMembers) {
+                return (chunkPtr->key << TAG_CHUNK_BITS) | chunkPtr->array[j];
+            }
         }
     }
-    if (IsEmptyValue(valuePtr1)) {
-        if (IsEmptyValue(valuePtr2)) {
-            return 0;
+    return -1;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * NextTaggedRow --
+ *
+ *      Returns the first row in the set whose offset is greater than or
+ *      equal to the given offset.  *offsetPtr* is set to the offset
+ *      following the row.
+ *
+ *---------------------------------------------------------------------------
+ */
+static Row *
+NextTaggedRow(Rows *rowsPtr, TagSet *setPtr, long *offsetPtr)
+{
+    long offset;
+
+    for (offset = TagSetNext(setPtr, *offsetPtr); offset >= 0; 
+         offset = TagSetNext(setPtr, offset + 1)) {
+        if ((offset < rowsPtr->numAllocated) && 
+            (rowsPtr->offsets[offset] != NULL)) {
+            *offsetPtr = offset + 1;
+            return rowsPtr->offsets[offset];
         }
-        return 1;
-    } else if (IsEmptyValue(valuePtr2)) {
-        return -1;
     }
-    if (valuePtr1->datum.d < valuePtr2->datum.d) {
-        return -1;
-    } else if (valuePtr1->datum.d > valuePtr2->datum.d) {
-        return 1;
+    *offsetPtr = -1;
+    return NULL;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ResetRowTags --
+ *
+ *      Frees all the row tags in the table of tags.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+ResetRowTags(Blt_HashTable *tablePtr)
+{
+    Blt_HashEntry *hPtr;
+    Blt_HashSearch iter;
+
+    for (hPtr = Blt_FirstHashEntry(tablePtr, &iter); hPtr != NULL;
+         hPtr = Blt_NextHashEntry(&iter)) {
+        FreeTagSet(Blt_GetHashValue(hPtr));
     }
-    return 0;
+    Blt_DeleteHashTable(tablePtr);
 }
 
-static int
-CompareRows(void *a, void *b)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ClearTagsFromRow --
+ *
+ *      Removes the row from every row tag of every client of the table.
+ *      This is done before the row is deleted, since its offset will be
+ *      reused by a new row.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+ClearTagsFromRow(Table *tablePtr, Row *rowPtr)
 {
-    Row *rowPtr1, *rowPtr2;
-    size_t i;
-    int result;
+    Blt_ChainLink link;
 
-    rowPtr1 = *(Row **)a;
-    rowPtr2 = *(Row **)b;
-    for (i = 0; i < sortData.numColumns; i++) {
-        BLT_TABLE_SORT_ORDER *sp;
+    for (link = Blt_Chain_FirstLink(tablePtr->corePtr->clients); link != NULL;
+         link = Blt_Chain_NextLink(link)) {
+        Table *clientPtr;
+        Blt_HashEntry *hPtr;
+        Blt_HashSearch iter;
 
-        sp = sortData.order + i;
-        result = (*sp->cmpProc)(sp->clientData, sp->column, rowPtr1, rowPtr2);
-        if (result != 0) {
-            return (sortData.flags & TABLE_SORT_DECREASING) ? -result : result;
+        clientPtr = Blt_Chain_GetValue(link);
+        if (clientPtr->rowTags == NULL) {
+            continue;
+        }
+        for (hPtr = Blt_FirstHashEntry(clientPtr->rowTags, &iter); 
+             hPtr != NULL; hPtr = Blt_NextHashEntry(&iter)) {
+            TagSet *setPtr;
+
+            setPtr = Blt_GetHashValue(hPtr);
+            TagSetRemove(setPtr, rowPtr->offset);
         }
     }
-    result = rowPtr1->index - rowPtr2->index;
-    return (sortData.flags & TABLE_SORT_DECREASING) ? -result : result;
 }
 
-
-BLT_TABLE_COMPARE_PROC *
-blt_table_get_compare_proc(Table *tablePtr, Column *colPtr, unsigned int flags)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RemapRowTags --
+ *
+ *      Renumbers the row tags of every client of the table after the row
+ *      storage has been packed.  *newOffsets* maps the old offset of
+ *      each row to its new offset.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+RemapRowTags(Table *tablePtr, long *newOffsets)
 {
-    BLT_TABLE_COMPARE_PROC *proc;
-
-    if ((flags & TABLE_SORT_TYPE_MASK) == TABLE_SORT_AUTO) {
-        switch (colPtr->type) {
-        case TABLE_COLUMN_TYPE_INT64:
-            proc = CompareInt64s;
-            break;
+    Blt_ChainLink link;
+    Blt_HashTable seen;
 
-        case TABLE_COLUMN_TYPE_LONG:
-        case TABLE_COLUMN_TYPE_BOOLEAN:
-            proc = CompareLongs;
-            break;
+    /* Clients may share tags. Only remap each table of tags once. */
+    Blt_InitHashTable(&seen, BLT_ONE_WORD_KEYS);
+    for (link = Blt_Chain_FirstLink(tablePtr->corePtr->clients); link != NULL;
+         link = Blt_Chain_NextLink(link)) {
+        Table *clientPtr;
+        Blt_HashEntry *hPtr;
+        Blt_HashSearch iter;
+        int isNew;
 
-        case TABLE_COLUMN_TYPE_TIME:
-        case TABLE_COLUMN_TYPE_DOUBLE:
-            proc = CompareDoubles;
-            break;
-        case TABLE_COLUMN_TYPE_STRING:
-        default:
-            proc = CompareDictionaryStrings;
-            break;
+        clientPtr = Blt_Chain_GetValue(link);
+        if (clientPtr->rowTags == NULL) {
+            continue;
         }
-    } else {
-        switch (flags & TABLE_SORT_TYPE_MASK) {
-        case TABLE_SORT_DICTIONARY:
-            proc = CompareDictionaryStrings;
-            break;
-        default:
-        case TABLE_SORT_ASCII:
-            if (flags & TABLE_SORT_IGNORECASE) {
-                proc = CompareAsciiStringsIgnoreCase;
-            } else {
-                proc = CompareAsciiStrings;
+        Blt_CreateHashEntry(&seen, (char *)clientPtr->rowTags, &isNew);
+        if (!isNew) {
+            continue;
+        }
+        for (hPtr = Blt_FirstHashEntry(clientPtr->rowTags, &iter); 
+             hPtr != NULL; hPtr = Blt_NextHashEntry(&iter)) {
+            TagSet *oldPtr, *newPtr;
+            long offset;
+
+            oldPtr = Blt_GetHashValue(hPtr);
+            newPtr = NewTagSet();
+            for (offset = TagSetNext(oldPtr, 0); offset >= 0; 
+                 offset = TagSetNext(oldPtr, offset + 1)) {
+                if (newOffsets[offset] >= 0) {
+                    TagSetAdd(newPtr, newOffsets[offset]);
+                }
             }
-            break;
+            FreeTagSet(oldPtr);
+            Blt_SetHashValue(hPtr, newPtr);
         }
     }
-    return proc;
+    Blt_DeleteHashTable(&seen);
 }
 
-static Row **
-SortRows(Rows *rowsPtr, QSortCompareProc *proc)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * NewTags --
+ *
+ *---------------------------------------------------------------------------
+ */
+static BLT_TABLE_TAGS
+NewTags(void)
 {
-    size_t i;
-    Row **map;
+    Tags *tagsPtr;
 
-    /* Make a copy of the current row map. */
-    map = Blt_Malloc(sizeof(Row *) * rowsPtr->numAllocated);
-    if (map == NULL) {
-        return NULL;
-    }
-    for (i = 0; i < rowsPtr->numAllocated; i++) {
-        map[i] = rowsPtr->map[i];
+    tagsPtr = Blt_Malloc(sizeof(Tags));
+    if (tagsPtr != NULL) {
+        Blt_InitHashTable(&tagsPtr->rowTags, BLT_STRING_KEYS);
+        Blt_Tags_Init(&tagsPtr->columnTags);
+        tagsPtr->refCount = 1;
     }
-    /* Sort the map and return it. */
-    qsort((char *)map, rowsPtr->numUsed, sizeof(Row *), proc);
-    return map;
+    return tagsPtr;
 }
 
 static void
-ReplaceRowMap(Rows *rowsPtr, Row **map)
+InitTags(Table *tablePtr)
 {
-    size_t i;
-
-    if (rowsPtr->numUsed == 0) {
-        return;
-    }
-    /* Rethread list according to the map. */
-    for (i = 0; i < rowsPtr->numUsed; i++) {
-        Row *rowPtr;
-        Row *prevPtr, *nextPtr;
-
-        prevPtr = (i > 0) ? map[i-1] : NULL;
-        nextPtr = ((i+i) < rowsPtr->numUsed) ? map[i+1] : NULL;
-        rowPtr = map[i];
-        rowPtr->prevPtr = prevPtr;
-        rowPtr->nextPtr = nextPtr;
-        rowPtr->index = i;
-    }
-    rowsPtr->headPtr = map[0];
-    rowsPtr->tailPtr = map[rowsPtr->numUsed-1];
-    if (rowsPtr->map != NULL) {
-        Blt_Free(rowsPtr->map);
-    }
-    rowsPtr->map = map;
+    tablePtr->tags = NewTags();
+    tablePtr->rowTags = &tablePtr->tags->rowTags;
+    tablePtr->columnTags = &tablePtr->tags->columnTags;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ShareTags --
+ *
+ *---------------------------------------------------------------------------
+ */
 static void
-ReplaceColumnMap(Columns *columnsPtr, Column **map)
+ShareTags(Table *srcPtr, Table *destPtr)
 {
-    size_t i;
-    Column *prevPtr;
-    Column *colPtr;
-
-    if (columnsPtr->numUsed == 0) {
-        return;
-    }
-    /* Rethread column list according to the map. */
-    prevPtr = NULL;
-    for (i = 0; i < (columnsPtr->numUsed - 1); i++) {
-        colPtr = map[i];
-        colPtr->index = i;
-        colPtr->nextPtr = map[i + 1];
-        colPtr->prevPtr = prevPtr;
-        prevPtr =  map[i];
-    }
-    colPtr = map[i];
-    colPtr->nextPtr = NULL;
-    colPtr->prevPtr = prevPtr;
-    columnsPtr->headPtr = map[0];
-    columnsPtr->tailPtr = colPtr;
-    if (columnsPtr->map != NULL) {
-        Blt_Free(columnsPtr->map);
+    srcPtr->tags->refCount++;
+    if (destPtr->tags != NULL) {
+        blt_table_release_tags(destPtr);
     }
-    columnsPtr->map = map;
+    destPtr->tags = srcPtr->tags;
+    destPtr->rowTags = &destPtr->tags->rowTags;
+    destPtr->columnTags = &destPtr->tags->columnTags;
 }
 
-static int
-MoveRows(Rows *rowsPtr, Row *destPtr, Row *firstPtr, Row *lastPtr, int after)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FindClientInNamespace --
+ *
+ *      Searches for a table client in a given namespace.
+ *
+ * Results:
+ *      Returns a pointer to the table client if found, otherwise NULL.
+ *
+ *---------------------------------------------------------------------------
+ */
+static Table *
+FindClientInNamespace(InterpData *dataPtr, Blt_ObjectName *namePtr)
+{
+    Blt_HashEntry *hPtr;
+    Tcl_DString ds;
+    const char *qualName;
+
+    qualName = Blt_MakeQualifiedName(namePtr, &ds);
+    hPtr = Blt_FindHashEntry(&dataPtr->clientTable, qualName);
+    Tcl_DStringFree(&ds);
+    if (hPtr != NULL) {
+        Blt_Chain chain;
+        Blt_ChainLink link;
+
+        chain = Blt_GetHashValue(hPtr);
+        link = Blt_Chain_FirstLink(chain);
+        if (link != NULL) {
+            return Blt_Chain_GetValue(link);
+        }
+    }
+    return NULL;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetTable --
+ *
+ *      Searches for the table client associated by the name given.
+ *
+ * Results:
+ *      Returns a pointer to the table client if found, otherwise NULL.
+ *
+ *---------------------------------------------------------------------------
+ */
+static BLT_TABLE
+GetTable(InterpData *dataPtr, const char *name, unsigned int flags)
+{
+    Blt_ObjectName objName;
+    BLT_TABLE table;
+    Tcl_Interp *interp;
+
+    table = NULL;
+    interp = dataPtr->interp;
+    if (!Blt_ParseObjectName(interp, name, &objName, BLT_NO_DEFAULT_NS)) {
+        return NULL;
+    }
+    if (objName.nsPtr != NULL) { 
+        table = FindClientInNamespace(dataPtr, &objName);
+    } else { 
+        if (flags & NS_SEARCH_CURRENT) {
+            /* Look first in the current namespace. */
+            objName.nsPtr = Tcl_GetCurrentNamespace(interp);
+            table = FindClientInNamespace(dataPtr, &objName);
+        }
+        if ((table == NULL) && (flags & NS_SEARCH_GLOBAL)) {
+            objName.nsPtr = Tcl_GetGlobalNamespace(interp);
+            table = FindClientInNamespace(dataPtr, &objName);
+        }
+    }
+    return table;
+}
+
+static void
+DestroyClient(Table *tablePtr)
+{
+    if (tablePtr->magic != TABLE_MAGIC) {
+        Blt_Warn("invalid table object token %p\n", tablePtr);
+        return;
+    }
+    /* End any batches left open by this client, so that the recorded
+     * events are still delivered. */
+    while (tablePtr->batchDepth > 0) {
+        blt_table_end_batch(tablePtr);
+    }
+    /* Remove any traces that were set by this client. */
+    DestroyTraces(tablePtr);
+    /* Also remove all event handlers created by this client. */
+    DestroyNotifiers(tablePtr, tablePtr->rowNotifiers);
+    DestroyNotifiers(tablePtr, tablePtr->columnNotifiers);
+    blt_table_unset_keys(tablePtr);
+    if (tablePtr->tags != NULL) {
+        blt_table_release_tags(tablePtr);
+    }
+    if (tablePtr->corePtr != NULL) {
+        Column *colPtr;
+
+        /* And the column views it created. */
+        for (colPtr = tablePtr->corePtr->columns.headPtr; colPtr != NULL;
+             colPtr = colPtr->nextPtr) {
+            DestroyColumnViews(tablePtr, colPtr, 
+                               tablePtr->corePtr->rows.numUsed);
+        }
+    }
+    if ((tablePtr->corePtr != NULL) && (tablePtr->link != NULL)) {
+        TableObject *corePtr;
+
+        corePtr = tablePtr->corePtr;
+        /* Remove the client from the server's list */
+        Blt_Chain_DeleteLink(corePtr->clients, tablePtr->link);
+        if (Blt_Chain_GetLength(corePtr->clients) == 0) {
+            DestroyTableObject(corePtr);
+        }
+    }
+    tablePtr->magic = 0;
+    Blt_Free(tablePtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * NewTable --
+ *
+ *      Creates a new table client.  Clients shared a tuple data object.
+ *      They individually manage traces and events on tuple objects.
+ *      Returns a pointer to the malloc'ed structure.  This is passed to
+ *      the client as a tuple token.
+ *      
+ * Results:
+ *      A pointer to a Table is returned.  If one can't be allocated, NULL
+ *      is returned.
+ *
+ *---------------------------------------------------------------------------
+ */
+static Table *
+NewTable(
+    InterpData *dataPtr, 
+    TableObject *corePtr,               /* Table object serving this
+                                         * client. */
+    const char *qualName)               /* Full namespace qualified name of
+                                         * table. A table by this name may
+                                         * already exist. */
+{
+    Blt_Chain chain;                    /* List of clients using the same
+                                         * name. */
+    Table *tablePtr;
+    int isNew;
+
+    tablePtr = Blt_Calloc(1, sizeof(Table));
+    if (tablePtr == NULL) {
+        return NULL;
+    }
+    tablePtr->magic = TABLE_MAGIC;
+    tablePtr->interp = dataPtr->interp;
+    /* Add client to table object's list of clients. */
+    tablePtr->link = Blt_Chain_Append(corePtr->clients, tablePtr);
+
+    /* Create a new set of tags. */
+    InitTags(tablePtr);
+
+    tablePtr->clientTablePtr = &dataPtr->clientTable;
+    /* Table names are not unique.  More than one client may open the same
+     * table.  The name remains in use so long as one client is still using
+     * the table. This is so other clients can refer to the table, even
+     * though the original client that created the data no longer
+     * exists. */
+    tablePtr->hPtr = Blt_CreateHashEntry(&dataPtr->clientTable, qualName, 
+        &isNew);
+    if (isNew) {
+        chain = Blt_Chain_Create();
+        Blt_SetHashValue(tablePtr->hPtr, chain);
+    } else {
+        chain = Blt_GetHashValue(tablePtr->hPtr);
+    }
+    tablePtr->name = Blt_GetHashKey(&dataPtr->clientTable, tablePtr->hPtr);
+    tablePtr->link2 = Blt_Chain_Append(chain, tablePtr);
+    tablePtr->rowNotifiers = Blt_Chain_Create();
+    tablePtr->columnNotifiers = Blt_Chain_Create();
+    tablePtr->readTraces = Blt_Chain_Create();
+    tablePtr->writeTraces = Blt_Chain_Create();
+    Blt_InitHashTable(&tablePtr->notifiers, BLT_ONE_WORD_KEYS);
+    Blt_InitHashTable(&tablePtr->traces, BLT_ONE_WORD_KEYS);
+
+    tablePtr->corePtr = corePtr;
+    return tablePtr;
+}
+
+static Blt_HashTable *
+GetColumnLabelTable(Columns *columnsPtr, const char *label)
+{
+    Blt_HashEntry *hPtr;
+
+    hPtr = Blt_FindHashEntry(&columnsPtr->labelTable, label);
+    if (hPtr != NULL) {
+        return Blt_GetHashValue(hPtr);
+    }
+    return NULL;
+}
+
+static Blt_HashTable *
+GetRowLabelTable(Rows *rowsPtr, const char *label)
+{
+    Blt_HashEntry *hPtr;
+
+    hPtr = Blt_FindHashEntry(&rowsPtr->labelTable, label);
+    if (hPtr != NULL) {
+        return Blt_GetHashValue(hPtr);
+    }
+    return NULL;
+}
+
+static Row *
+FindRowLabel(Rows *rowsPtr, const char *label)
+{
+    Blt_HashTable *tablePtr;
+
+    tablePtr = GetRowLabelTable(rowsPtr, label);
+    if (tablePtr != NULL) {
+        Blt_HashEntry *hPtr;
+        Blt_HashSearch iter;
+
+        hPtr = Blt_FirstHashEntry(tablePtr, &iter);
+        if (hPtr != NULL) {
+            return Blt_GetHashValue(hPtr);
+        }
+    }
+    return NULL;
+}
+
+static Column *
+FindColumnLabel(Columns *columnsPtr, const char *label)
+{
+    Blt_HashTable *tablePtr;
+
+    tablePtr = GetColumnLabelTable(columnsPtr, label);
+    if (tablePtr != NULL) {
+        Blt_HashEntry *hPtr;
+        Blt_HashSearch iter;
+
+        hPtr = Blt_FirstHashEntry(tablePtr, &iter);
+        if (hPtr != NULL) {
+            return Blt_GetHashValue(hPtr);
+        }
+    }
+    return NULL;
+}
+
+static int
+SetColumnType(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
+              BLT_TABLE_COLUMN_TYPE type)
+{
+    Row *rowPtr;
+    Column old;
+    int result;
+
+    if (type == colPtr->type) {
+        return TCL_OK;                  /* Already the requested type. */
+    }
+    /* First test that every value in the column can be converted. */
+    for (rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL; 
+         rowPtr = rowPtr->nextPtr) {
+        if (!IsEmpty(rowPtr, colPtr)) {
+            Value value;
+            const char *string;
+            unsigned int length;
+
+            string = GetCellString(tablePtr, rowPtr, colPtr, &length);
+            memset(&value, 0, sizeof(Value));
+            if (SetValueFromString(interp, colPtr, type, string, length, 
+                                   &value) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            ResetValue(&value);
+        }
+    }
+    /* 
+     * Now replace the column with the converted the values.  The storage
+     * used may differ between types, so the values are moved into new
+     * storage.  Key tables hash the values by type and indexes compare
+     * them by type, so they must be regenerated.
+     */
+    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
+        InvalidateKeys(tablePtr, colPtr);
+    }
+    if (colPtr->indexPtr != NULL) {
+        InvalidateIndex(colPtr);
+    }
+    /* Views of the column can't follow it to the new storage. */
+    DestroyColumnViews(NULL, colPtr, tablePtr->corePtr->rows.numUsed);
+    old = *colPtr;
+    colPtr->sharePtr = NULL;            /* Released with the old values. */
+    colPtr->statsPtr = NULL;
+    colPtr->vector = NULL;
+    colPtr->data = NULL;
+    colPtr->nonEmpty = NULL;
+    colPtr->strings = NULL;
+    colPtr->codes = NULL;
+    colPtr->dictPtr = NULL;             /* The new type isn't encoded. */
+    colPtr->flags &= ~TABLE_COLUMN_MAPPED;
+    colPtr->type = type;
+    result = TCL_OK;
+    for (rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL; 
+         rowPtr = rowPtr->nextPtr) {
+        if (!IsEmpty(rowPtr, &old)) {
+            Value value;
+            const char *string;
+            unsigned int length;
+
+            string = GetCellString(tablePtr, rowPtr, &old, &length);
+            memset(&value, 0, sizeof(Value));
+            result = SetValueFromString(interp, colPtr, type, string, 
+                                        length, &value);
+            if (result == TCL_OK) {
+                result = PutValue(interp, tablePtr, rowPtr, colPtr, &value);
+            }
+            if (result != TCL_OK) {
+                break;
+            }
+        }
+    }
+    FreeColumnValues(&tablePtr->corePtr->rows, &old);
+    return result;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * UnsetValue --
+ *
+ *      Removes the value from the selected row, column location in the
+ *      table.  The row, column location must be within the actual table
+ *      limits, but it's okay if there isn't a value there to remove.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      The objPtr representing the value is released.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+UnsetValue(Table *tablePtr, Row *rowPtr, Column *colPtr)
+{
+    if (colPtr->statsPtr != NULL) {
+        RemoveStatsValue(tablePtr, rowPtr, colPtr);
+    }
+    if ((colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) && 
+        (!IsEmpty(rowPtr, colPtr))) {
+        /* The row no longer has all its keys. */
+        UnlinkRowKeys(tablePtr, rowPtr, colPtr);
+    }
+    if (colPtr->indexPtr != NULL) {
+        RemoveIndexRow(colPtr, rowPtr);
+    }
+    if ((colPtr->sharePtr != NULL) && (!IsEmpty(rowPtr, colPtr))) {
+        UnshareColumn(tablePtr->corePtr, colPtr);
+    }
+    if (colPtr->vector != NULL) {
+        ResetValue(colPtr->vector + rowPtr->offset);
+    }
+    if (colPtr->codes != NULL) {
+        SetCode(colPtr, rowPtr->offset, 0);
+    }
+    if (colPtr->nonEmpty != NULL) {
+        long offset;
+
+        offset = rowPtr->offset;
+        DenseClear(colPtr, offset);
+        if ((colPtr->strings != NULL) && (colPtr->strings[offset] != NULL)) {
+            Blt_Free(colPtr->strings[offset]);
+            colPtr->strings[offset] = NULL;
+        }
+        if (colPtr->views != NULL) {
+            ((double *)colPtr->data)[offset] = Blt_NaN();
+        }
+    }
+}
+
+static void
+UnsetRowValues(Table *tablePtr, Row *rowPtr)
+{
+    Column *colPtr;
+
+    for (colPtr = tablePtr->corePtr->columns.headPtr; colPtr != NULL;
+         colPtr = colPtr->nextPtr) {
+        UnsetValue(tablePtr, rowPtr, colPtr);
+    }
+}
+
+static void
+DeleteRow(Rows *rowsPtr, Row *rowPtr)
+{
+    /* If there is a label is associated with the row, free it. */
+    if (rowPtr->label != NULL) {
+        UnsetRowLabel(rowsPtr, rowPtr);
+    }
+    /* Unlink the row from the list of rows. */
+    if (rowsPtr->headPtr == rowPtr) {
+        rowsPtr->headPtr = rowPtr->nextPtr;
+    }
+    if (rowsPtr->tailPtr == rowPtr) {
+        rowsPtr->tailPtr = rowPtr->prevPtr;
+    }
+    if (rowPtr->nextPtr != NULL) {
+        rowPtr->nextPtr->prevPtr = rowPtr->prevPtr;
+    }
+    if (rowPtr->prevPtr != NULL) {
+        rowPtr->prevPtr->nextPtr = rowPtr->nextPtr;
+    }
+    /* Mark the map entries as empty.  The other rows aren't renumbered
+     * until their indices are needed. */
+    rowsPtr->map[rowPtr->index] = NULL;
+    rowsPtr->offsets[rowPtr->offset] = NULL;
+    AddRowHole(rowsPtr, rowPtr->index);
+    rowsPtr->flags |= REINDEX;
+    /* We don't delete row storage, just add the row offset back onto
+     * the free queue. */
+    PushFreeOffset(rowsPtr, rowPtr->offset);
+    /* Finally free the row itself. */
+    Blt_Pool_FreeItem(rowsPtr->pool, rowPtr);
+    rowsPtr->numUsed--;
+}
+
+static void
+DeleteColumn(Table *tablePtr, Column *colPtr)
+{
+    Columns *columnsPtr;
+
+    columnsPtr = &tablePtr->corePtr->columns;
+    /* If there is a label is associated with the column, free it. */
+    if (colPtr->label != NULL) {
+        UnsetColumnLabel(columnsPtr, colPtr);
+    }
+    if (columnsPtr->headPtr == colPtr) {
+        columnsPtr->headPtr = colPtr->nextPtr;
+    }
+    if (columnsPtr->tailPtr == colPtr) {
+        columnsPtr->tailPtr = colPtr->prevPtr;
+    }
+    if (colPtr->nextPtr != NULL) {
+        colPtr->nextPtr->prevPtr = colPtr->prevPtr;
+    }
+    if (colPtr->prevPtr != NULL) {
+        colPtr->prevPtr->nextPtr = colPtr->nextPtr;
+    }
+    colPtr->prevPtr = colPtr->nextPtr = NULL;
+    columnsPtr->map[colPtr->index] = NULL;
+    columnsPtr->flags |= REINDEX;
+    DestroyColumnViews(NULL, colPtr, tablePtr->corePtr->rows.numUsed);
+    FreeColumnValues(&tablePtr->corePtr->rows, colPtr);
+    if (colPtr->indexPtr != NULL) {
+        FreeIndex(colPtr);
+    }
+    if (colPtr->timeFmtPtr != NULL) {
+        Blt_FreeTimeFormat(colPtr->timeFmtPtr);
+    }
+    /* Finally free the column. */
+    Blt_Pool_FreeItem(columnsPtr->pool, colPtr);
+    columnsPtr->numUsed--;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ClearRowNotifiers --
+ *
+ *      Removes all event handlers set for the designated row.  Note that
+ *      this doesn't remove handlers triggered by row or column tags.  Row
+ *      and column event notifiers are stored in a chain.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+ClearRowNotifiers(Table *tablePtr, Row *rowPtr)
+{
+    Blt_ChainLink link, next;
+
+    for (link = Blt_Chain_FirstLink(tablePtr->rowNotifiers); link != NULL;
+         link = next) {
+        Notifier *notifierPtr;
+
+        next = Blt_Chain_NextLink(link);
+        notifierPtr = Blt_Chain_GetValue(link);
+        if (notifierPtr->row == rowPtr) {
+            blt_table_delete_notifier(tablePtr, notifierPtr);
+        }
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ClearColumnNotifiers --
+ *
+ *      Removes all event handlers set for the designated row.  Note that
+ *      this doesn't remove handlers triggered by row or column tags.  Row
+ *      and column event notifiers are stored in a chain.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+ClearColumnNotifiers(Table *tablePtr, Column *colPtr)
+{
+    Blt_ChainLink link, next;
+
+    for (link = Blt_Chain_FirstLink(tablePtr->columnNotifiers); link != NULL; 
+        link = next) {
+        Notifier *notifierPtr;
+
+        next = Blt_Chain_NextLink(link);
+        notifierPtr = Blt_Chain_GetValue(link);
+        if (notifierPtr->column == colPtr) {
+            blt_table_delete_notifier(tablePtr, notifierPtr);
+        }
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * DoNotify --
+ *
+ *      Traverses the client's list of event callbacks and checks if one
+ *      matches the given event.  A client may trigger an action that
+ *      causes the itself to be notified again.  This can be prevented by
+ *      setting the TABLE_NOTIFY_FOREIGN_ONLY bit in the event handler.
+ *
+ *      If a matching handler is found, a callback may be called either
+ *      immediately or at the next idle time depending upon the
+ *      TABLE_NOTIFY_WHENIDLE bit.
+ *
+ *      Since a handler routine may trigger yet another call to itself,
+ *      callbacks are ignored while the event handler is executing.
+ *      
+ *---------------------------------------------------------------------------
+ */
+static void
+DoNotify(Table *tablePtr, Blt_Chain notifiers, 
+         BLT_TABLE_NOTIFY_EVENT *eventPtr)
+{
+    Blt_ChainLink link;
+    unsigned int eventMask;
+
+    /* Check the client table for matching notifiers.  Issue callbacks
+     * indicating that the structure of the table has changed.  */
+    eventMask = eventPtr->type & TABLE_NOTIFY_MASK;
+    for (link = Blt_Chain_FirstLink(notifiers); link != NULL; 
+         link = Blt_Chain_NextLink(link)) {
+        Notifier *notifierPtr;
+        int match;
+
+        notifierPtr = Blt_Chain_GetValue(link);
+        if ((notifierPtr->flags & eventMask) == 0) {
+            continue;                   /* Event type doesn't match */
+        }
+        if ((eventPtr->self) && 
+            (notifierPtr->flags & TABLE_NOTIFY_FOREIGN_ONLY)) {
+            continue;                   /* Don't notify yourself. */
+        }
+        if (notifierPtr->flags & TABLE_NOTIFY_ACTIVE) {
+            continue;                   /* Ignore callbacks that are
+                                         * generated inside of a notify
+                                         * handler routine. */
+        }
+        match = FALSE;
+        if (notifierPtr->tag != NULL) {
+            if (notifierPtr->flags & TABLE_NOTIFY_ROW) {
+                if (blt_table_row_has_tag(tablePtr, eventPtr->row, 
+                        notifierPtr->tag)) {
+                    match++;
+                }
+            } else {
+                if (blt_table_column_has_tag(tablePtr, eventPtr->column, 
+                        notifierPtr->tag)) {
+                    match++;
+                }
+            }
+        } else if ((notifierPtr->flags & TABLE_NOTIFY_ROW) && 
+                   ((notifierPtr->row == NULL) || 
+                    (notifierPtr->row == eventPtr->row))) {
+            match++;                    /* Offsets match. */
+        } else if ((notifierPtr->flags & TABLE_NOTIFY_COLUMN) && 
+                   ((notifierPtr->column == NULL) ||
+                    (notifierPtr->column == eventPtr->column))) {
+            match++;                    /* Offsets match. */
+        }
+        if (!match) {
+            continue;                   /* Row or column doesn't match. */
+        }
+        if (notifierPtr->flags & TABLE_NOTIFY_WHENIDLE) {
+            if ((notifierPtr->flags & TABLE_NOTIFY_PENDING) == 0) {
+                notifierPtr->flags |= TABLE_NOTIFY_PENDING;
+                notifierPtr->event = *eventPtr;
+                Tcl_DoWhenIdle(NotifyIdleProc, notifierPtr);
+            }
+        } else {
+            notifierPtr->event = *eventPtr;
+            NotifyIdleProc(notifierPtr);
+        }
+    }
+}
+
+
+static void
+InitNotifyEvent(Table *tablePtr, BLT_TABLE_NOTIFY_EVENT *eventPtr)
+{
+    memset(eventPtr, 0, sizeof(BLT_TABLE_NOTIFY_EVENT));
+    eventPtr->table = tablePtr;
+    eventPtr->interp = tablePtr->interp;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * NotifyClients --
+ *
+ *      Traverses the list of event callbacks and checks if one matches the
+ *      given event.  A client may trigger an action that causes the table
+ *      object to notify it.  This can be prevented by setting the
+ *      TABLE_NOTIFY_FOREIGN_ONLY bit in the event handler.
+ *
+ *      If a matching handler is found, a callback may be called either
+ *      immediately or at the next idle time depending upon the
+ *      TABLE_NOTIFY_WHENIDLE bit.
+ *
+ *      Since a handler routine may trigger yet another call to itself,
+ *      callbacks are ignored while the event handler is executing.
+ *      
+ *---------------------------------------------------------------------------
+ */
+static void
+NotifyClients(Table *tablePtr, BLT_TABLE_NOTIFY_EVENT *eventPtr)
+{
+    Blt_ChainLink link, next;
+    
+    for (link = Blt_Chain_FirstLink(tablePtr->corePtr->clients); link != NULL; 
+         link = next) {
+        Table *clientPtr;
+        Blt_Chain chain;
+        
+        next = Blt_Chain_NextLink(link);
+        clientPtr = Blt_Chain_GetValue(link);
+        eventPtr->self = (clientPtr == tablePtr);
+        chain = (eventPtr->type & TABLE_NOTIFY_COLUMN) ?
+            clientPtr->columnNotifiers : clientPtr->rowNotifiers;
+        if (Blt_Chain_GetLength(chain) > 0) {
+            DoNotify(clientPtr, chain, eventPtr);
+        }
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * NotifyColumnChanged --
+ *
+ *      Traverses the list of event callbacks and checks if one matches the
+ *      given event.  A client may trigger an action that causes the table
+ *      object to notify it.  This can be prevented by setting the
+ *      TABLE_NOTIFY_FOREIGN_ONLY bit in the event handler.
+ *
+ *      If a matching handler is found, a callback may be called either
+ *      immediately or at the next idle time depending upon the
+ *      TABLE_NOTIFY_WHENIDLE bit.
+ *
+ *      Since a handler routine may trigger yet another call to itself,
+ *      callbacks are ignored while the event handler is executing.
+ *      
+ *---------------------------------------------------------------------------
+ */
+static void
+NotifyColumnChanged(Table *tablePtr, Column *colPtr, unsigned int flags)
+{
+    BLT_TABLE_NOTIFY_EVENT event;
+    TableBatch *batchPtr;
+
+    batchPtr = tablePtr->corePtr->batchPtr;
+    if ((colPtr == NULL) && (batchPtr != NULL) && (batchPtr->depth > 0)) {
+        batchPtr->colNotifyFlags |= flags;
+        return;                         /* Held until the batch ends. */
+    }
+    InitNotifyEvent(tablePtr, &event);
+    event.type = flags | TABLE_NOTIFY_COLUMN;
+    event.column = colPtr;
+    NotifyClients(tablePtr, &event);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * NotifyRowChanged --
+ *
+ *      Traverses the list of event callbacks and checks if one matches the
+ *      given event.  A client may trigger an action that causes the table
+ *      object to notify it.  This can be prevented by setting the
+ *      TABLE_NOTIFY_FOREIGN_ONLY bit in the event handler.
+ *
+ *      If a matching handler is found, a callback may be called either
+ *      immediately or at the next idle time depending upon the
+ *      TABLE_NOTIFY_WHENIDLE bit.
+ *
+ *      Since a handler routine may trigger yet another call to itself,
+ *      callbacks are ignored while the event handler is executing.
+ *      
+ *---------------------------------------------------------------------------
+ */
+static void
+NotifyRowChanged(Table *tablePtr, Row *rowPtr, unsigned int flags)
+{
+    BLT_TABLE_NOTIFY_EVENT event;
+    TableBatch *batchPtr;
+
+    batchPtr = tablePtr->corePtr->batchPtr;
+    if ((rowPtr == NULL) && (batchPtr != NULL) && (batchPtr->depth > 0)) {
+        batchPtr->rowNotifyFlags |= flags;
+        return;                         /* Held until the batch ends. */
+    }
+    InitNotifyEvent(tablePtr, &event);
+    event.type = flags | TABLE_NOTIFY_ROW;
+    event.row = rowPtr;
+    NotifyClients(tablePtr, &event);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_clear_row_traces --
+ *
+ *      Removes all traces set for this row.  Note that this doesn't remove
+ *      traces set for specific cells (row,column).  Row traces are stored
+ *      in a chain, which in turn is held in a hash table, keyed by the
+ *      row.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_clear_row_traces(Table *tablePtr, Row *rowPtr)
+{
+    Blt_ChainLink link, next;
+
+    for (link = Blt_Chain_FirstLink(tablePtr->readTraces); link != NULL; 
+         link = next) {
+        Trace *tracePtr;
+
+        next = Blt_Chain_NextLink(link);
+        tracePtr = Blt_Chain_GetValue(link);
+        if (tracePtr->row == rowPtr) {
+            blt_table_delete_trace(tablePtr, tracePtr);
+        }
+    }
+    for (link = Blt_Chain_FirstLink(tablePtr->writeTraces); link != NULL; 
+         link = next) {
+        Trace *tracePtr;
+
+        next = Blt_Chain_NextLink(link);
+        tracePtr = Blt_Chain_GetValue(link);
+        if (tracePtr->row == rowPtr) {
+            blt_table_delete_trace(tablePtr, tracePtr);
+        }
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_clear_column_traces --
+ *
+ *      Removes all traces set for this column.  Note that this doesn't
+ *      remove traces set for specific cells (row,column).  Column traces
+ *      are stored in a chain, which in turn is held in a hash table, keyed
+ *      by the column.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_clear_column_traces(Table *tablePtr, BLT_TABLE_COLUMN column)
+{
+    Blt_ChainLink link, next;
+
+    for (link = Blt_Chain_FirstLink(tablePtr->readTraces); link != NULL; 
+         link = next) {
+        Trace *tracePtr;
+
+        next = Blt_Chain_NextLink(link);
+        tracePtr = Blt_Chain_GetValue(link);
+        if (tracePtr->column == column) {
+            blt_table_delete_trace(tablePtr, tracePtr);
+        }
+    }
+    for (link = Blt_Chain_FirstLink(tablePtr->writeTraces); link != NULL; 
+         link = next) {
+        Trace *tracePtr;
+
+        next = Blt_Chain_NextLink(link);
+        tracePtr = Blt_Chain_GetValue(link);
+        if (tracePtr->column == column) {
+            blt_table_delete_trace(tablePtr, tracePtr);
+        }
+    }
+}
+
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CallClientTraces --
+ *
+ *      Examines the traces set for a specific client of the table object
+ *      and fires any matching traces.
+ *
+ *      Traces match on row and column tag and indices and flags.
+ *      Traces can match on
+ *           flag               type of trace (read, write, unset, create)
+ *           row index
+ *           column index
+ *           row tag
+ *           column tag
+ *
+ *      If the TABLE_TRACE_FOREIGN_ONLY is set in the handler, it means to
+ *      ignore actions that are initiated by that client of the object.
+ *      Only actions by other clients are handled.
+ *
+ * Results:
+ *      Always returns TCL_OK.
+ *
+ * Side Effects:
+ *      Traces on the tuple table location may be fired.
+ *
+ *---------------------------------------------------------------------------
+ */
+static INLINE int
+TraceMatchesRow(Table *clientPtr, Trace *tracePtr, Row *rowPtr)
+{
+    if (tracePtr->rowTag != NULL) {
+        return blt_table_row_has_tag(clientPtr, rowPtr, tracePtr->rowTag);
+    } 
+    return ((tracePtr->row == rowPtr) || (tracePtr->row == NULL));
+}
+
+static INLINE int
+TraceMatchesColumn(Table *clientPtr, Trace *tracePtr, Column *colPtr)
+{
+    if (tracePtr->colTag != NULL) {
+        return blt_table_column_has_tag(clientPtr, colPtr, tracePtr->colTag);
+    } 
+    return ((tracePtr->column == colPtr) || (tracePtr->column == NULL));
+}
+
+static void
+CallClientTraces(Table *tablePtr, Table *clientPtr, Row *rowPtr, Column *colPtr,
+                 unsigned int flags)
+{
+    Blt_Chain chain;
+    Blt_ChainLink link, next;
+    BLT_TABLE_TRACE_EVENT event;
+    unsigned int eachCell;
+
+    /* If set, a batch is open and only traces that want every cell are
+     * fired.  The others fire when the batch ends. */
+    eachCell = (flags & TABLE_TRACE_EACH_CELL);
+    flags &= ~TABLE_TRACE_EACH_CELL;
+
+    /* Initialize trace event information. */
+    event.table = clientPtr;
+    event.row = event.lastRow = rowPtr;
+    event.column = event.lastColumn = colPtr;
+    event.interp = clientPtr->interp;
+    if (tablePtr == clientPtr) {
+        flags |= TABLE_TRACE_SELF;
+    }
+    event.mask = flags;
+    if (flags & TABLE_TRACE_READS) {
+        chain = clientPtr->readTraces;
+    } else {
+        chain = clientPtr->writeTraces;
+    }
+    for (link = Blt_Chain_FirstLink(chain); link != NULL; link = next) {
+        Trace *tracePtr;
+
+        next = Blt_Chain_NextLink(link);
+        tracePtr = Blt_Chain_GetValue(link);
+
+        if ((tracePtr->flags & flags) == 0) {
+            continue;                   /* Doesn't match trace flags. */
+        }
+        if ((eachCell) && ((tracePtr->flags & TABLE_TRACE_EACH_CELL) == 0)) {
+            continue;                   /* Fired when the batch ends. */
+        }
+        if (tracePtr->flags & TABLE_TRACE_ACTIVE) {
+            continue;                   /* Ignore callbacks that were
+                                         * triggered from the active trace
+                                         * handler routine. */
+        }
+        if ((!TraceMatchesColumn(clientPtr, tracePtr, colPtr)) ||
+            (!TraceMatchesRow(clientPtr, tracePtr, rowPtr))) {
+            continue;                   /* Must match both row and
+                                         * column.  */
+        }
+        if (tracePtr->flags & TABLE_TRACE_WHENIDLE) {
+            if ((tracePtr->flags & TABLE_TRACE_PENDING) == 0) {
+                tracePtr->flags |= TABLE_TRACE_PENDING;
+                tracePtr->event = event;
+                Tcl_DoWhenIdle(TraceIdleProc, tracePtr);
+            }
+        } else {
+            if (DoTrace(tracePtr, &event) == TCL_BREAK) {
+                return;                 /* Don't complete traces on
+                                         * break. */
+            }
+        }
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CallTraces --
+ *
+ *      Examines the traces set for each client of the table object and
+ *      fires any matching traces.
+ *
+ *      Traces match on row and column indices and flags.
+ *      The order is 
+ *        1. column traces.
+ *        2. row traces.
+ *        3. cell (row,column) traces.
+ *
+ *      If no matching criteria is specified (no tag, key, or tuple
+ *      address) then only the bit flag has to match.
+ *
+ *      If the TABLE_TRACE_FOREIGN_ONLY is set in the handler, it means to
+ *      ignore actions that are initiated by that client of the object.
+ *      Only actions by other clients are handled.
+ *
+ * Results:
+ *      Always returns TCL_OK.
+ *
+ * Side Effects:
+ *      Traces on the tuple table location may be fired.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+CallTraces(Table *tablePtr, Row *rowPtr, Column *colPtr, unsigned int flags)
+{
+    Blt_ChainLink link, next;
+    TableBatch *batchPtr;
+
+    if ((colPtr != NULL) && (colPtr->views != NULL) &&
+        (flags & (TABLE_TRACE_WRITES | TABLE_TRACE_UNSETS))) {
+        NotifyColumnViews(tablePtr, colPtr, TABLE_VIEW_CHANGED);
+    }
+    batchPtr = tablePtr->corePtr->batchPtr;
+    if ((batchPtr != NULL) && (batchPtr->depth > 0) && 
+        ((flags & TABLE_TRACE_READS) == 0)) {
+        RecordBatchEvent(batchPtr, rowPtr, colPtr, flags);
+        flags |= TABLE_TRACE_EACH_CELL;
+    }
+    for (link = Blt_Chain_FirstLink(tablePtr->corePtr->clients); link != NULL; 
+         link = next) {
+        Table *clientPtr;
+
+        next = Blt_Chain_NextLink(link);
+        clientPtr = Blt_Chain_GetValue(link);
+        CallClientTraces(tablePtr, clientPtr, rowPtr, colPtr, flags);
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CallCellTraces --
+ *
+ *      Fires the traces that want every cell for a change already
+ *      recorded in the open batch by RecordBatchColumn.  The other traces
+ *      fire when the batch ends.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+CallCellTraces(Table *tablePtr, Row *rowPtr, Column *colPtr, 
+               unsigned int flags)
+{
+    Blt_ChainLink link, next;
+
+    if ((colPtr->views != NULL) &&
+        (flags & (TABLE_TRACE_WRITES | TABLE_TRACE_UNSETS))) {
+        NotifyColumnViews(tablePtr, colPtr, TABLE_VIEW_CHANGED);
+    }
+    for (link = Blt_Chain_FirstLink(tablePtr->corePtr->clients); link != NULL; 
+         link = next) {
+        next = Blt_Chain_NextLink(link);
+        CallClientTraces(tablePtr, Blt_Chain_GetValue(link), rowPtr, colPtr,
+                flags | TABLE_TRACE_EACH_CELL);
+    }
+}
+
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * Batches --
+ *
+ *      While a batch is open, write, create, and unset events only record
+ *      the changed rows and columns.  When the outermost batch ends, each
+ *      matching trace is fired once, with an event spanning the first to
+ *      last changed row and column (in the order of the table) that the
+ *      trace matches.  Traces with the TABLE_TRACE_EACH_CELL flag are
+ *      still fired for each cell.
+ *
+ *---------------------------------------------------------------------------
+ */
+static TableBatch *
+NewBatch(void)
+{
+    TableBatch *batchPtr;
+
+    batchPtr = Blt_AssertCalloc(1, sizeof(TableBatch));
+    Blt_InitHashTable(&batchPtr->rowTable, BLT_ONE_WORD_KEYS);
+    Blt_InitHashTable(&batchPtr->columnTable, BLT_ONE_WORD_KEYS);
+    return batchPtr;
+}
+
+static void
+FreeBatch(TableBatch *batchPtr)
+{
+    Blt_DeleteHashTable(&batchPtr->rowTable);
+    Blt_DeleteHashTable(&batchPtr->columnTable);
+    Blt_Free(batchPtr);
+}
+
+static void
+RecordBatchEvent(TableBatch *batchPtr, Row *rowPtr, Column *colPtr, 
+                 unsigned int flags)
+{
+    Blt_HashEntry *hPtr;
+    int isNew;
+
+    batchPtr->flags |= flags;
+    if (rowPtr != batchPtr->lastRowPtr) {
+        hPtr = Blt_CreateHashEntry(&batchPtr->rowTable, rowPtr, &isNew);
+        Blt_SetHashValue(hPtr, rowPtr);
+        batchPtr->lastRowPtr = rowPtr;
+    }
+    if (colPtr != batchPtr->lastColPtr) {
+        hPtr = Blt_CreateHashEntry(&batchPtr->columnTable, colPtr, &isNew);
+        Blt_SetHashValue(hPtr, colPtr);
+        batchPtr->lastColPtr = colPtr;
+    }
+}
+
+/* 
+ * Records that every row of the column changed.  This saves recording
+ * each row when a whole column is rewritten.
+ */
+static void
+RecordBatchColumn(TableBatch *batchPtr, Column *colPtr, unsigned int flags)
+{
+    Blt_HashEntry *hPtr;
+    int isNew;
+
+    batchPtr->flags |= flags;
+    batchPtr->allRows = TRUE;
+    hPtr = Blt_CreateHashEntry(&batchPtr->columnTable, colPtr, &isNew);
+    Blt_SetHashValue(hPtr, colPtr);
+}
+
+/* 
+ * Marks a deleted row or column in all the batches.  Entries are cleared
+ * rather than removed since a batch may be in the middle of being
+ * flushed.
+ */
+static void
+ForgetBatchRow(TableObject *corePtr, Row *rowPtr)
+{
+    TableBatch *batchPtr;
+
+    for (batchPtr = corePtr->batchPtr; batchPtr != NULL; 
+         batchPtr = batchPtr->nextPtr) {
+        Blt_HashEntry *hPtr;
+
+        hPtr = Blt_FindHashEntry(&batchPtr->rowTable, rowPtr);
+        if (hPtr != NULL) {
+            Blt_SetHashValue(hPtr, NULL);
+        }
+        if (batchPtr->lastRowPtr == rowPtr) {
+            batchPtr->lastRowPtr = NULL;
+        }
+    }
+}
+
+static void
+ForgetBatchColumn(TableObject *corePtr, Column *colPtr)
+{
+    TableBatch *batchPtr;
+
+    for (batchPtr = corePtr->batchPtr; batchPtr != NULL; 
+         batchPtr = batchPtr->nextPtr) {
+        Blt_HashEntry *hPtr;
+
+        hPtr = Blt_FindHashEntry(&batchPtr->columnTable, colPtr);
+        if (hPtr != NULL) {
+            Blt_SetHashValue(hPtr, NULL);
+        }
+        if (batchPtr->lastColPtr == colPtr) {
+            batchPtr->lastColPtr = NULL;
+        }
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CallBatchTraces --
+ *
+ *      Fires the write, create, and unset traces of a client once for the
+ *      changes recorded by the batch.  
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+CallBatchTraces(Table *tablePtr, Table *clientPtr, TableBatch *batchPtr)
+{
+    Blt_ChainLink link, next;
+    BLT_TABLE_TRACE_EVENT event;
+
+    event.table = clientPtr;
+    event.interp = clientPtr->interp;
+    event.mask = batchPtr->flags | TABLE_TRACE_BATCH;
+    if (tablePtr == clientPtr) {
+        event.mask |= TABLE_TRACE_SELF;
+    }
+    for (link = Blt_Chain_FirstLink(clientPtr->writeTraces); link != NULL; 
+         link = next) {
+        Trace *tracePtr;
+        Blt_HashEntry *hPtr;
+        Blt_HashSearch iter;
+        long first, last;
+
+        next = Blt_Chain_NextLink(link);
+        tracePtr = Blt_Chain_GetValue(link);
+        if ((tracePtr->flags & batchPtr->flags) == 0) {
+            continue;                   /* Doesn't match trace flags. */
+        }
+        if (tracePtr->flags & (TABLE_TRACE_ACTIVE | TABLE_TRACE_EACH_CELL)) {
+            continue;                   /* Already fired for each cell. */
+        }
+        event.row = event.lastRow = NULL;
+        first = last = -1;
+        if (batchPtr->allRows) {
+            Row *rowPtr;
+
+            /* Every row changed: the span is the first to last row that
+             * the trace matches. */
+            for (rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL;
+                 rowPtr = rowPtr->nextPtr) {
+                if (TraceMatchesRow(clientPtr, tracePtr, rowPtr)) {
+                    event.row = rowPtr;
+                    break;
+                }
+            }
+            for (rowPtr = tablePtr->corePtr->rows.tailPtr; rowPtr != NULL;
+                 rowPtr = rowPtr->prevPtr) {
+                if (TraceMatchesRow(clientPtr, tracePtr, rowPtr)) {
+                    event.lastRow = rowPtr;
+                    break;
+                }
+            }
+        }
+        for (hPtr = (batchPtr->allRows) ? NULL :
+                 Blt_FirstHashEntry(&batchPtr->rowTable, &iter); 
+             hPtr != NULL; hPtr = Blt_NextHashEntry(&iter)) {
+            Row *rowPtr;
+            long index;
+
+            rowPtr = Blt_GetHashValue(hPtr);
+            if ((rowPtr == NULL) || 
+                (!TraceMatchesRow(clientPtr, tracePtr, rowPtr))) {
+                continue;
+            }
+            index = blt_table_row_index(clientPtr, rowPtr);
+            if ((first < 0) || (index < first)) {
+                first = index;
+                event.row = rowPtr;
+            }
+            if (index > last) {
+                last = index;
+                event.lastRow = rowPtr;
+            }
+        }
+        if (event.row == NULL) {
+            continue;                   /* No matching rows changed. */
+        }
+        event.column = event.lastColumn = NULL;
+        first = last = -1;
+        for (hPtr = Blt_FirstHashEntry(&batchPtr->columnTable, &iter); 
+             hPtr != NULL; hPtr = Blt_NextHashEntry(&iter)) {
+            Column *colPtr;
+            long index;
+
+            colPtr = Blt_GetHashValue(hPtr);
+            if ((colPtr == NULL) || 
+                (!TraceMatchesColumn(clientPtr, tracePtr, colPtr))) {
+                continue;
+            }
+            index = blt_table_column_index(clientPtr, colPtr);
+            if ((first < 0) || (index < first)) {
+                first = index;
+                event.column = colPtr;
+            }
+            if (index > last) {
+                last = index;
+                event.lastColumn = colPtr;
+            }
+        }
+        if (event.column == NULL) {
+            continue;                   /* No matching columns changed. */
+        }
+        if (tracePtr->flags & TABLE_TRACE_WHENIDLE) {
+            if ((tracePtr->flags & TABLE_TRACE_PENDING) == 0) {
+                tracePtr->flags |= TABLE_TRACE_PENDING;
+                tracePtr->event = event;
+                Tcl_DoWhenIdle(TraceIdleProc, tracePtr);
+            }
+        } else {
+            if (DoTrace(tracePtr, &event) == TCL_BREAK) {
+                return;                 /* Don't complete traces on
+                                         * break. */
+            }
+        }
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CompareEmpty --
+ *
+ *      Orders empty cells after the non-empty ones.
+ *
+ * Results:
+ *      Returns -1, 0, or 1 if either cell is empty, 2 otherwise.
+ *
+ *---------------------------------------------------------------------------
+ */
+static INLINE int
+CompareEmpty(Column *colPtr, Row *rowPtr1, Row *rowPtr2)
+{
+    int isEmpty1, isEmpty2;
+
+    isEmpty1 = IsEmpty(rowPtr1, colPtr);
+    isEmpty2 = IsEmpty(rowPtr2, colPtr);
+    if (isEmpty1) {
+        return (isEmpty2) ? 0 : 1;
+    } else if (isEmpty2) {
+        return -1;
+    }
+    return 2;
+}
+
+static INLINE const char *
+FormatCellString(Row *rowPtr, Column *colPtr, char *buffer)
+{
+    unsigned int length;
+
+    if (IsDenseColumn(colPtr)) {
+        return FormatDenseValue(colPtr, rowPtr->offset, buffer);
+    }
+    return GetStoredString(rowPtr, colPtr, &length);
+}
+
+static int
+CompareDictionaryStrings(ClientData clientData, Column *colPtr, Row *rowPtr1, 
+                         Row *rowPtr2)
+{
+    char buf1[DENSE_STRING_LENGTH], buf2[DENSE_STRING_LENGTH];
+    int result;
+
+    result = CompareEmpty(colPtr, rowPtr1, rowPtr2);
+    if (result != 2) {
+        return result;
+    }
+    return Blt_DictionaryCompare(FormatCellString(rowPtr1, colPtr, buf1),
+                                 FormatCellString(rowPtr2, colPtr, buf2));
+}
+
+static int
+CompareAsciiStrings(ClientData clientData, Column *colPtr, Row *rowPtr1, 
+                    Row *rowPtr2)
+{
+    char buf1[DENSE_STRING_LENGTH], buf2[DENSE_STRING_LENGTH];
+    int result;
+
+    result = CompareEmpty(colPtr, rowPtr1, rowPtr2);
+    if (result != 2) {
+        return result;
+    }
+    return strcmp(FormatCellString(rowPtr1, colPtr, buf1),
+                  FormatCellString(rowPtr2, colPtr, buf2));
+}
+
+static int
+CompareAsciiStringsIgnoreCase(ClientData clientData, Column *colPtr,
+                              Row *rowPtr1, Row *rowPtr2)
+{
+    char buf1[DENSE_STRING_LENGTH], buf2[DENSE_STRING_LENGTH];
+    int result;
+
+    result = CompareEmpty(colPtr, rowPtr1, rowPtr2);
+    if (result != 2) {
+        return result;
+    }
+    return strcasecmp(FormatCellString(rowPtr1, colPtr, buf1),
+                      FormatCellString(rowPtr2, colPtr, buf2));
+}
+
+static int
+CompareInt64s(ClientData clientData, Column *colPtr, Row *rowPtr1, 
+              Row *rowPtr2)
+{
+    Value value1, value2;
+    int result;
+
+    result = CompareEmpty(colPtr, rowPtr1, rowPtr2);
+    if (result != 2) {
+        return result;
+    }
+    GetCellDatum(rowPtr1, colPtr, &value1);
+    GetCellDatum(rowPtr2, colPtr, &value2);
+    if (value1.datum.i64 < value2.datum.i64) {
+        return -1;
+    } else if (value1.datum.i64 > value2.datum.i64) {
+        return 1;
+    }
+    return 0;
+}
+
+static int
+CompareLongs(ClientData clientData, Column *colPtr, Row *rowPtr1, 
+             Row *rowPtr2)
+{
+    Value value1, value2;
+    int result;
+
+    result = CompareEmpty(colPtr, rowPtr1, rowPtr2);
+    if (result != 2) {
+        return result;
+    }
+    GetCellDatum(rowPtr1, colPtr, &value1);
+    GetCellDatum(rowPtr2, colPtr, &value2);
+    if (value1.datum.l < value2.datum.l) {
+        return -1;
+    } else if (value1.datum.l > value2.datum.l) {
+        return 1;
+    }
+    return 0;
+}
+
+static int
+CompareDoubles(ClientData clientData, Column *colPtr, Row *rowPtr1, 
+                    Row *rowPtr2)
+{
+    Value value1, value2;
+    int result;
+
+    result = CompareEmpty(colPtr, rowPtr1, rowPtr2);
+    if (result != 2) {
+        return result;
+    }
+    GetCellDatum(rowPtr1, colPtr, &value1);
+    GetCellDatum(rowPtr2, colPtr, &value2);
+    if (value1.datum.d < value2.datum.d) {
+        return -1;
+    } else if (value1.datum.d > value2.datum.d) {
+        return 1;
+    }
+    return 0;
+}
+
+BLT_TABLE_COMPARE_PROC *
+blt_table_get_compare_proc(Table *tablePtr, Column *colPtr, unsigned int flags)
+{
+    BLT_TABLE_COMPARE_PROC *proc;
+
+    if ((flags & TABLE_SORT_TYPE_MASK) == TABLE_SORT_AUTO) {
+        switch (colPtr->type) {
+        case TABLE_COLUMN_TYPE_INT64:
+            proc = CompareInt64s;
+            break;
+
+        case TABLE_COLUMN_TYPE_LONG:
+        case TABLE_COLUMN_TYPE_BOOLEAN:
+            proc = CompareLongs;
+            break;
+
+        case TABLE_COLUMN_TYPE_TIME:
+        case TABLE_COLUMN_TYPE_DOUBLE:
+            proc = CompareDoubles;
+            break;
+        case TABLE_COLUMN_TYPE_STRING:
+        default:
+            proc = CompareDictionaryStrings;
+            break;
+        }
+    } else {
+        switch (flags & TABLE_SORT_TYPE_MASK) {
+        case TABLE_SORT_DICTIONARY:
+            proc = CompareDictionaryStrings;
+            break;
+        default:
+        case TABLE_SORT_ASCII:
+            if (flags & TABLE_SORT_IGNORECASE) {
+                proc = CompareAsciiStringsIgnoreCase;
+            } else {
+                proc = CompareAsciiStrings;
+            }
+            break;
+        }
+    }
+    return proc;
+}
+
+/*
+ * Sort engine --
+ *
+ *      Rows are sorted by first pulling the keys of each sort column into
+ *      flat, typed arrays.  The first key is also folded into a 64-bit
+ *      integer that is stored alongside the row's position in a compact
+ *      sort item.  Most comparisons are decided by that integer alone,
+ *      without dispatching through the column's compare procedure or
+ *      chasing the row's value.  A single numeric key is radix sorted.
+ *      Anything else is merge sorted, with large inputs split across
+ *      worker threads.  Ties are broken by row index, so the order is the
+ *      same no matter which algorithm is used.
+ *
+ *      The sort order is kept in the table client and the keys in a
+ *      SortEngine allocated for the duration of the sort, so different
+ *      tables can be sorted at the same time.
+ */
+#define SORT_KEY_DOUBLE         0
+#define SORT_KEY_INT64          1
+#define SORT_KEY_STRING         2
+#define SORT_KEY_PROC           3       /* Compare procedure isn't one of
+                                         * ours, so call it. */
+
+#define SORT_STRING_ASCII       0
+#define SORT_STRING_NOCASE      1
+#define SORT_STRING_DICTIONARY  2
+#define SORT_STRING_DICTIONARY_ASCII 3  /* Dictionary comparison of
+                                         * strings known to be all
+                                         * ASCII. */
+
+#define SORT_PREFIX_LENGTH      7       /* # of leading bytes of a string
+                                         * key packed into its prefix. */
+#define SORT_MIN_THREAD_ROWS    (1<<16) /* Minimum # of rows for each
+                                         * worker thread. */
+#define SORT_MAX_THREADS        8
+#define SORT_INSERTION_LENGTH   16      /* Runs shorter than this are
+                                         * insertion sorted. */
+
+typedef struct {
+    int type;                           /* Type of key: see above. */
+    int mode;                           /* String comparison mode. */
+    unsigned char *empty;               /* Array indicating if the value
+                                         * at the position is empty. */
+    double *doubles;                    /* Keys for SORT_KEY_DOUBLE. */
+    int64_t *int64s;                    /* Keys for SORT_KEY_INT64. */
+    const char **strings;               /* Keys for SORT_KEY_STRING. */
+    BLT_TABLE_SORT_ORDER *sp;
+} SortKey;
+
+typedef struct {
+    uint64_t key;                       /* First sort key, folded into
+                                         * an integer. See MakeSortItems. */
+    size_t pos;                         /* Position of the row in the
+                                         * input. */
+} SortItem;
+
+typedef struct {
+    Table *tablePtr;
+    Row **rows;                         /* Rows to be sorted. Keys are
+                                         * indexed by position in this
+                                         * array. */
+    size_t numRows;
+    SortKey *keys;                      /* Array of sort keys, one for
+                                         * each column in the sort
+                                         * order. */
+    size_t numKeys;
+    unsigned int flags;
+} SortEngine;
+
+typedef struct {
+    SortEngine *sortPtr;
+    SortItem *items, *tmp;
+    size_t first, last;
+} SortWorker;
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * MakeSortPrefix --
+ *
+ *      Packs the leading bytes of the string into a 64-bit integer so that
+ *      most comparisons can be decided without looking at the strings.
+ *      Dictionary comparisons ignore case and compare runs of digits
+ *      numerically, so for them the prefix stops at the first digit or
+ *      non-ASCII character.  The low byte records how many of the packed
+ *      bytes are valid.
+ *
+ *---------------------------------------------------------------------------
+ */
+static uint64_t
+MakeSortPrefix(const char *string, int mode)
+{
+    const unsigned char *p;
+    uint64_t prefix;
+    int i, numValid;
+
+    prefix = 0;
+    numValid = SORT_PREFIX_LENGTH;
+    p = (const unsigned char *)string;
+    for (i = 0; i < SORT_PREFIX_LENGTH; i++) {
+        unsigned int c;
+
+        c = *p;
+        if (mode >= SORT_STRING_DICTIONARY) {
+            if ((isdigit(c)) || (c >= 0x80)) {
+                numValid = i;
+                break;
+            }
+            c = tolower(c);
+        } else if (mode == SORT_STRING_NOCASE) {
+            c = tolower(c);
+        }
+        prefix |= (uint64_t)c << (8 * (SORT_PREFIX_LENGTH - i));
+        if (c == '\0') {
+            break;                      /* The terminating null is also a
+                                         * valid byte. */
+        }
+        p++;
+    }
+    return prefix | numValid;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CompareSortPrefixes --
+ *
+ *      Compares two string prefixes made by MakeSortPrefix.  The first
+ *      byte that differs decides the order if it lies within the valid
+ *      bytes of both prefixes.
+ *
+ * Results:
+ *      Returns -1 or 1 if the prefixes decide the order, 0 if the strings
+ *      themselves must be compared.
+ *
+ *---------------------------------------------------------------------------
+ */
+static INLINE int
+CompareSortPrefixes(uint64_t p1, uint64_t p2)
+{
+    uint64_t diff;
+    int k, numValid;
+
+    diff = (p1 ^ p2) >> 8;
+    if (diff == 0) {
+        return 0;
+    }
+    numValid = MIN(p1 & 0xFF, p2 & 0xFF);
+    for (k = 0; k < numValid; k++) {
+        if ((diff >> (8 * (SORT_PREFIX_LENGTH - 1 - k))) != 0) {
+            return (p1 < p2) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * DictionaryCompareAscii --
+ *
+ *      Same as Blt_DictionaryCompare, but for strings that are known to
+ *      contain only ASCII characters.  This avoids converting each
+ *      character to Unicode.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+DictionaryCompareAscii(const char *left, const char *right)
+{
+    int diff, zeros;
+    int secondaryDiff = 0;
+
+    for (;;) {
+        if ((isdigit(UCHAR(*right))) && (isdigit(UCHAR(*left)))) { 
+            /* Compare embedded numbers as numbers.  A number with more
+             * leading zeros sorts later, but only as a secondary
+             * choice. */
+            zeros = 0;
+            while ((*right == '0') && (isdigit(UCHAR(right[1])))) {
+                right++;
+                zeros--;
+            }
+            while ((*left == '0') && (isdigit(UCHAR(left[1])))) {
+                left++;
+                zeros++;
+            }
+            if (secondaryDiff == 0) {
+                secondaryDiff = zeros;
+            }
+            diff = 0;
+            for (;;) {
+                if (diff == 0) {
+                    diff = UCHAR(*left) - UCHAR(*right);
+                }
+                right++;
+                left++;
+                /* Ignore commas in numbers. */
+                if (*left == ',') {
+                    left++;
+                }
+                if (*right == ',') {
+                    right++;
+                }
+                if (!isdigit(UCHAR(*right))) {
+                    if (isdigit(UCHAR(*left))) {
+                        return 1;
+                    } 
+                    if (diff != 0) {
+                        return diff;
+                    }
+                    break;
+                } else if (!isdigit(UCHAR(*left))) {
+                    return -1;
+                }
+            }
+            continue;
+        }
+        if ((*left == '\0') || (*right == '\0')) {
+            diff = UCHAR(*left) - UCHAR(*right);
+            break;
+        }
+        diff = tolower(UCHAR(*left)) - tolower(UCHAR(*right));
+        if (diff) {
+            return diff;
+        } 
+        if (secondaryDiff == 0) {
+            if ((isupper(UCHAR(*left))) && (islower(UCHAR(*right)))) {
+                secondaryDiff = -1;
+            } else if ((isupper(UCHAR(*right))) && (islower(UCHAR(*left)))) {
+                secondaryDiff = 1;
+            }
+        }
+        left++;
+        right++;
+    }
+    if (diff == 0) {
+        diff = secondaryDiff;
+    }
+    return diff;
+}
+
+static int
+CompareStrings(int mode, const char *s1, const char *s2)
+{
+    switch (mode) {
+    case SORT_STRING_DICTIONARY_ASCII:
+        return DictionaryCompareAscii(s1, s2);
+    case SORT_STRING_DICTIONARY:
+        return Blt_DictionaryCompare(s1, s2);
+    case SORT_STRING_NOCASE:
+        return strcasecmp(s1, s2);
+    default:
+        return strcmp(s1, s2);
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ComparePositions --
+ *
+ *      Compares the rows at the two positions of the input, starting with
+ *      the given sort key.  Empty values sort after non-empty ones.  Rows
+ *      with identical keys are ordered by their current index.
+ *
+ * Results:
+ *      Returns a negative number if the row at i comes first, a positive
+ *      number if the row at j does.  The sense of the result is not yet
+ *      reversed for decreasing sorts.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ComparePositions(SortEngine *sortPtr, size_t k, size_t i, size_t j)
+{
+    long result;
+
+    result = 0;
+    for (/*empty*/; k < sortPtr->numKeys; k++) {
+        SortKey *keyPtr;
+
+        keyPtr = sortPtr->keys + k;
+        if (keyPtr->type == SORT_KEY_PROC) {
+            BLT_TABLE_SORT_ORDER *sp;
+
+            sp = keyPtr->sp;
+            result = (*sp->cmpProc)(sp->clientData, sp->column, 
+                sortPtr->rows[i], sortPtr->rows[j]);
+        } else if (keyPtr->empty[i]) {
+            result = (keyPtr->empty[j]) ? 0 : 1;
+        } else if (keyPtr->empty[j]) {
+            result = -1;
+        } else if (keyPtr->type == SORT_KEY_DOUBLE) {
+            if (keyPtr->doubles[i] < keyPtr->doubles[j]) {
+                result = -1;
+            } else if (keyPtr->doubles[i] > keyPtr->doubles[j]) {
+                result = 1;
+            }
+        } else if (keyPtr->type == SORT_KEY_INT64) {
+            if (keyPtr->int64s[i] < keyPtr->int64s[j]) {
+                result = -1;
+            } else if (keyPtr->int64s[i] > keyPtr->int64s[j]) {
+                result = 1;
+            }
+        } else {
+            result = CompareStrings(keyPtr->mode, keyPtr->strings[i], 
+                                    keyPtr->strings[j]);
+        }
+        if (result != 0) {
+            return (result < 0) ? -1 : 1;
+        }
+    }
+    result = sortPtr->rows[i]->index - sortPtr->rows[j]->index;
+    return (result < 0) ? -1 : (result > 0);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CompareItems --
+ *
+ *      Compares two sort items.  The folded first key is tried first.
+ *      Only if it can't decide the order are the extracted keys used.
+ *
+ *---------------------------------------------------------------------------
+ */
+static INLINE int
+CompareItems(SortEngine *sortPtr, SortItem *a, SortItem *b)
+{
+    SortKey *keyPtr;
+    int result;
+
+    keyPtr = sortPtr->keys;
+    result = 0;
+    switch (keyPtr->type) {
+    case SORT_KEY_DOUBLE:
+    case SORT_KEY_INT64:
+        if (a->key != b->key) {
+            result = (a->key < b->key) ? -1 : 1;
+        } else {
+            result = ComparePositions(sortPtr, 1, a->pos, b->pos);
+        }
+        break;
+    case SORT_KEY_STRING:
+        result = CompareSortPrefixes(a->key, b->key);
+        if ((result == 0) && (!keyPtr->empty[a->pos])) {
+            result = CompareStrings(keyPtr->mode, keyPtr->strings[a->pos],
+                                    keyPtr->strings[b->pos]);
+        }
+        if (result == 0) {
+            result = ComparePositions(sortPtr, 1, a->pos, b->pos);
+        }
+        break;
+    default:
+        result = ComparePositions(sortPtr, 0, a->pos, b->pos);
+        break;
+    }
+    return (sortPtr->flags & TABLE_SORT_DECREASING) ? -result : result;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetDictionaryRanks --
+ *
+ *      Returns the position of each string of the dictionary in sorted
+ *      order, indexed by code.  Strings that compare equal get the same
+ *      rank.  The ranks are kept until a string is added to the
+ *      dictionary or they're needed for a different comparison.
+ *
+ *---------------------------------------------------------------------------
+ */
+typedef struct {
+    const char *string;
+    long code;
+    int mode;
+} RankItem;
+
+static int
+CompareRankItems(const void *a, const void *b)
+{
+    const RankItem *item1 = a;
+    const RankItem *item2 = b;
+
+    return CompareStrings(item1->mode, item1->string, item2->string);
+}
+
+static long *
+GetDictionaryRanks(Dictionary *dictPtr, int mode)
+{
+    RankItem *items;
+    long i, numItems, rank;
+
+    if ((dictPtr->ranks != NULL) && (dictPtr->rankMode == mode)) {
+        return dictPtr->ranks;
+    }
+    if (dictPtr->ranks == NULL) {
+        dictPtr->ranks = Blt_AssertMalloc(dictPtr->numCodes * sizeof(long));
+    }
+    numItems = dictPtr->numCodes - 1;   /* Skip the empty code. */
+    items = Blt_AssertMalloc((numItems + 1) * sizeof(RankItem));
+    for (i = 0; i < numItems; i++) {
+        items[i].string = dictPtr->strings[i + 1];
+        items[i].code = i + 1;
+        items[i].mode = mode;
+    }
+    qsort(items, numItems, sizeof(RankItem), CompareRankItems);
+    rank = 0;
+    for (i = 0; i < numItems; i++) {
+        if ((i > 0) && 
+            (CompareStrings(mode, items[i - 1].string, items[i].string) != 0)) {
+            rank++;
+        }
+        dictPtr->ranks[items[i].code] = rank;
+    }
+    dictPtr->ranks[0] = 0;
+    dictPtr->rankMode = mode;
+    Blt_Free(items);
+    return dictPtr->ranks;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ExtractSortKeys --
+ *
+ *      Pulls the sort keys for the rows to be sorted out of each column in
+ *      the sort order.  The type of key is picked from the compare
+ *      procedure set by blt_table_sort_init.
+ *
+ * Results:
+ *      Returns 1 if any key must be compared by calling its compare
+ *      procedure, 0 otherwise.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ExtractSortKeys(SortEngine *sortPtr, BLT_TABLE_SORT_ORDER *order)
+{
+    size_t i, k;
+    int needProcs;
+
+    needProcs = FALSE;
+    for (k = 0; k < sortPtr->numKeys; k++) {
+        BLT_TABLE_SORT_ORDER *sp;
+        Column *colPtr;
+        SortKey *keyPtr;
+        long *ranks;
+
+        sp = order + k;
+        keyPtr = sortPtr->keys + k;
+        keyPtr->sp = sp;
+        colPtr = sp->column;
+        if (sp->cmpProc == CompareDoubles) {
+            keyPtr->type = SORT_KEY_DOUBLE;
+        } else if ((sp->cmpProc == CompareInt64s) || 
+                   (sp->cmpProc == CompareLongs)) {
+            keyPtr->type = SORT_KEY_INT64;
+        } else if (sp->cmpProc == CompareDictionaryStrings) {
+            keyPtr->type = SORT_KEY_STRING;
+            keyPtr->mode = SORT_STRING_DICTIONARY;
+        } else if (sp->cmpProc == CompareAsciiStrings) {
+            keyPtr->type = SORT_KEY_STRING;
+            keyPtr->mode = SORT_STRING_ASCII;
+        } else if (sp->cmpProc == CompareAsciiStringsIgnoreCase) {
+            keyPtr->type = SORT_KEY_STRING;
+            keyPtr->mode = SORT_STRING_NOCASE;
+        } else {
+            keyPtr->type = SORT_KEY_PROC;
+            needProcs = TRUE;
+            continue;
+        }
+        ranks = NULL;
+        if ((keyPtr->type == SORT_KEY_STRING) && (colPtr->dictPtr != NULL)) {
+            /* Compare the ranks of the strings in the column's dictionary
+             * instead of the strings themselves. */
+            ranks = GetDictionaryRanks(colPtr->dictPtr, keyPtr->mode);
+            keyPtr->type = SORT_KEY_INT64;
+        }
+        keyPtr->empty = Blt_AssertMalloc(sortPtr->numRows);
+        switch (keyPtr->type) {
+        case SORT_KEY_DOUBLE:
+            keyPtr->doubles = Blt_AssertMalloc(sortPtr->numRows * 
+                                               sizeof(double));
+            break;
+        case SORT_KEY_INT64:
+            keyPtr->int64s = Blt_AssertMalloc(sortPtr->numRows * 
+                                              sizeof(int64_t));
+            break;
+        case SORT_KEY_STRING:
+            keyPtr->strings = Blt_AssertMalloc(sortPtr->numRows * 
+                                               sizeof(char *));
+            break;
+        }
+        for (i = 0; i < sortPtr->numRows; i++) {
+            Row *rowPtr;
+            Value value;
+            unsigned int length;
+
+            rowPtr = sortPtr->rows[i];
+            keyPtr->empty[i] = IsEmpty(rowPtr, colPtr);
+            if (keyPtr->empty[i]) {
+                value.datum.i64 = 0;
+                value.datum.d = 0.0;
+            } else if (ranks != NULL) {
+                value.datum.i64 = ranks[GetCode(colPtr, rowPtr->offset)];
+            } else if (keyPtr->type != SORT_KEY_STRING) {
+                GetCellDatum(rowPtr, colPtr, &value);
+            }
+            switch (keyPtr->type) {
+            case SORT_KEY_DOUBLE:
+                keyPtr->doubles[i] = value.datum.d;
+                break;
+            case SORT_KEY_INT64:
+                if (keyPtr->empty[i]) {
+                    keyPtr->int64s[i] = 0;
+                } else if (sp->cmpProc == CompareLongs) {
+                    keyPtr->int64s[i] = value.datum.l;
+                } else {
+                    keyPtr->int64s[i] = value.datum.i64;
+                }
+                break;
+            case SORT_KEY_STRING:
+                keyPtr->strings[i] = (keyPtr->empty[i]) ? NULL :
+                    GetCellString(sortPtr->tablePtr, rowPtr, colPtr, &length);
+                break;
+            }
+        }
+        if ((keyPtr->type == SORT_KEY_STRING) &&
+            (keyPtr->mode == SORT_STRING_DICTIONARY)) {
+            int isAscii;
+
+            isAscii = TRUE;
+            for (i = 0; (isAscii) && (i < sortPtr->numRows); i++) {
+                const unsigned char *p;
+
+                if (keyPtr->empty[i]) {
+                    continue;
+                }
+                for (p = (const unsigned char *)keyPtr->strings[i]; *p != '\0';
+                     p++) {
+                    if (*p >= 0x80) {
+                        isAscii = FALSE;
+                        break;
+                    }
+                }
+            }
+            if (isAscii) {
+                keyPtr->mode = SORT_STRING_DICTIONARY_ASCII;
+            }
+        }
+    }
+    return needProcs;
+}
+
+static void
+FreeSortKeys(SortEngine *sortPtr)
+{
+    size_t k;
+
+    for (k = 0; k < sortPtr->numKeys; k++) {
+        SortKey *keyPtr;
+
+        keyPtr = sortPtr->keys + k;
+        if (keyPtr->empty != NULL) {
+            Blt_Free(keyPtr->empty);
+        }
+        if (keyPtr->doubles != NULL) {
+            Blt_Free(keyPtr->doubles);
+        }
+        if (keyPtr->int64s != NULL) {
+            Blt_Free(keyPtr->int64s);
+        }
+        if (keyPtr->strings != NULL) {
+            Blt_Free(keyPtr->strings);
+        }
+    }
+    Blt_Free(sortPtr->keys);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * MakeSortItems --
+ *
+ *      Fills the array of sort items, folding the first sort key of each
+ *      row into an unsigned integer.  Doubles and integers are mapped so
+ *      that the integers order the same way as the numbers.  Strings are
+ *      mapped to their prefix.  Rows whose first key is empty are placed
+ *      at the end of the array, in input order.
+ *
+ * Results:
+ *      Returns the number of rows with a non-empty first key.
+ *
+ *---------------------------------------------------------------------------
+ */
+static size_t
+MakeSortItems(SortEngine *sortPtr, SortItem *items)
+{
+    SortKey *keyPtr;
+    size_t i, n, numEmpty;
+
+    keyPtr = sortPtr->keys;
+    n = numEmpty = 0;
+    for (i = 0; i < sortPtr->numRows; i++) {
+        SortItem *itemPtr;
+        uint64_t u;
+
+        if ((keyPtr->type != SORT_KEY_PROC) && (keyPtr->empty[i])) {
+            numEmpty++;
+            itemPtr = items + sortPtr->numRows - numEmpty;
+            itemPtr->key = 0;
+            itemPtr->pos = i;
+            continue;
+        }
+        switch (keyPtr->type) {
+        case SORT_KEY_DOUBLE:
+            {
+                union {
+                    double d;
+                    uint64_t u;
+                } x;
+                
+                x.d = keyPtr->doubles[i];
+                if (x.d == 0.0) {
+                    x.d = 0.0;          /* -0.0 and 0.0 are equal. */
+                }
+                u = (x.u & ((uint64_t)1 << 63)) ? ~x.u : 
+                    (x.u | ((uint64_t)1 << 63));
+            }
+            break;
+        case SORT_KEY_INT64:
+            u = (uint64_t)keyPtr->int64s[i] ^ ((uint64_t)1 << 63);
+            break;
+        case SORT_KEY_STRING:
+            u = MakeSortPrefix(keyPtr->strings[i], keyPtr->mode);
+            break;
+        default:
+            u = 0;
+            break;
+        }
+        items[n].key = u;
+        items[n].pos = i;
+        n++;
+    }
+    /* Empty rows were stored backwards at the end.  Flip them. */
+    for (i = 0; i < numEmpty / 2; i++) {
+        SortItem tmp;
+
+        tmp = items[n + i];
+        items[n + i] = items[sortPtr->numRows - 1 - i];
+        items[sortPtr->numRows - 1 - i] = tmp;
+    }
+    return n;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RadixSortItems --
+ *
+ *      Sorts the items on their folded key with a least-significant-digit
+ *      radix sort, one byte per pass.  Passes where every key has the
+ *      same byte are skipped.  The sort is stable.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+RadixSortItems(SortItem *items, SortItem *tmp, size_t numItems)
+{
+    SortItem *src, *dest;
+    int pass;
+
+    src = items, dest = tmp;
+    for (pass = 0; pass < 8; pass++) {
+        size_t counts[256];
+        size_t i;
+        int shift, c;
+        SortItem *p;
+
+        shift = pass * 8;
+        memset(counts, 0, sizeof(counts));
+        for (i = 0; i < numItems; i++) {
+            counts[(src[i].key >> shift) & 0xFF]++;
+        }
+        if (counts[(src[0].key >> shift) & 0xFF] == numItems) {
+            continue;                   /* All keys have the same byte. */
+        }
+        for (i = 0, c = 0; c < 256; c++) {
+            size_t count;
+
+            count = counts[c];
+            counts[c] = i;
+            i += count;
+        }
+        for (i = 0; i < numItems; i++) {
+            dest[counts[(src[i].key >> shift) & 0xFF]++] = src[i];
+        }
+        p = src, src = dest, dest = p;
+    }
+    if (src != items) {
+        memcpy(items, src, numItems * sizeof(SortItem));
+    }
+}
+
+static void
+MergeRuns(SortEngine *sortPtr, SortItem *src, SortItem *dest, size_t first,
+          size_t mid, size_t last)
+{
+    size_t a, b, k;
+
+    a = first, b = mid, k = first;
+    while ((a < mid) && (b < last)) {
+        if (CompareItems(sortPtr, src + b, src + a) < 0) {
+            dest[k++] = src[b++];
+        } else {
+            dest[k++] = src[a++];
+        }
+    }
+    while (a < mid) {
+        dest[k++] = src[a++];
+    }
+    while (b < last) {
+        dest[k++] = src[b++];
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * MergeSortItems --
+ *
+ *      Sorts the items from first up to, but not including, last with a
+ *      bottom-up merge sort.  Short runs are first insertion sorted.  The
+ *      tmp array must be as large as the items array.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+MergeSortItems(SortEngine *sortPtr, SortItem *items, SortItem *tmp, 
+               size_t first, size_t last)
+{
+    size_t i, width;
+    SortItem *src, *dest;
+
+    for (i = first; i < last; i += SORT_INSERTION_LENGTH) {
+        size_t j, end;
+
+        end = MIN(i + SORT_INSERTION_LENGTH, last);
+        for (j = i + 1; j < end; j++) {
+            SortItem x;
+            size_t k;
+
+            x = items[j];
+            for (k = j; (k > i) && 
+                     (CompareItems(sortPtr, items + k - 1, &x) > 0); k--) {
+                items[k] = items[k - 1];
+            }
+            items[k] = x;
+        }
+    }
+    src = items, dest = tmp;
+    for (width = SORT_INSERTION_LENGTH; width < (last - first); width *= 2) {
+        SortItem *p;
+
+        for (i = first; i < last; i += 2 * width) {
+            MergeRuns(sortPtr, src, dest, i, MIN(i + width, last), 
+                      MIN(i + 2 * width, last));
+        }
+        p = src, src = dest, dest = p;
+    }
+    if (src != items) {
+        memcpy(items + first, src + first, (last - first) * sizeof(SortItem));
+    }
+}
+
+static Tcl_ThreadCreateType
+SortWorkerProc(ClientData clientData)
+{
+    SortWorker *workerPtr = clientData;
+
+    MergeSortItems(workerPtr->sortPtr, workerPtr->items, workerPtr->tmp,
+                   workerPtr->first, workerPtr->last);
+    TCL_THREAD_CREATE_RETURN;
+}
+
+static int
+GetNumSortThreads(size_t numItems, int needProcs)
+{
+    long numCpus;
+
+    /* Compare procedures that aren't ours may not be thread-safe. */
+    if ((needProcs) || (numItems < (2 * SORT_MIN_THREAD_ROWS))) {
+        return 1;
+    }
+    numCpus = 1;
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+    numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif  /* HAVE_UNISTD_H && _SC_NPROCESSORS_ONLN */
+    if (numCpus > SORT_MAX_THREADS) {
+        numCpus = SORT_MAX_THREADS;
+    }
+    if (numCpus > (long)(numItems / SORT_MIN_THREAD_ROWS)) {
+        numCpus = numItems / SORT_MIN_THREAD_ROWS;
+    }
+    return (numCpus < 1) ? 1 : (int)numCpus;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SortItems --
+ *
+ *      Merge sorts the items.  Large arrays are split into equal parts,
+ *      each sorted in its own thread, and then merged.  If a thread can't
+ *      be created (for example, Tcl was built without thread support), its
+ *      part is sorted here instead.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+SortItems(SortEngine *sortPtr, SortItem *items, SortItem *tmp, 
+          size_t numItems, int numThreads)
+{
+    SortWorker workers[SORT_MAX_THREADS];
+    Tcl_ThreadId ids[SORT_MAX_THREADS];
+    int created[SORT_MAX_THREADS];
+    size_t bounds[SORT_MAX_THREADS + 1];
+    SortItem *src, *dest;
+    int i, numParts;
+
+    if (numThreads <= 1) {
+        MergeSortItems(sortPtr, items, tmp, 0, numItems);
+        return;
+    }
+    for (i = 0; i <= numThreads; i++) {
+        bounds[i] = (numItems * i) / numThreads;
+    }
+    for (i = 0; i < numThreads; i++) {
+        SortWorker *workerPtr;
+
+        workerPtr = workers + i;
+        workerPtr->sortPtr = sortPtr;
+        workerPtr->items = items;
+        workerPtr->tmp = tmp;
+        workerPtr->first = bounds[i];
+        workerPtr->last = bounds[i + 1];
+        created[i] = (i > 0) && 
+            (Tcl_CreateThread(ids + i, SortWorkerProc, workerPtr, 
+                TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) == TCL_OK);
+    }
+    for (i = 0; i < numThreads; i++) {
+        if (!created[i]) {
+            MergeSortItems(sortPtr, items, tmp, bounds[i], bounds[i + 1]);
+        }
+    }
+    for (i = 0; i < numThreads; i++) {
+        if (created[i]) {
+            int dummy;
+
+            Tcl_JoinThread(ids[i], &dummy);
+        }
+    }
+    /* Merge adjacent parts until only one is left. */
+    src = items, dest = tmp;
+    for (numParts = numThreads; numParts > 1; numParts = (numParts + 1) / 2) {
+        SortItem *p;
+        int j;
+
+        for (i = 0, j = 0; i < numParts; i += 2, j++) {
+            size_t first;
+
+            first = bounds[i];
+            MergeRuns(sortPtr, src, dest, first, bounds[MIN(i + 1, numParts)],
+                      bounds[MIN(i + 2, numParts)]);
+            bounds[j] = first;
+        }
+        bounds[j] = numItems;
+        p = src, src = dest, dest = p;
+    }
+    if (src != items) {
+        memcpy(items, src, numItems * sizeof(SortItem));
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SortRows --
+ *
+ *      Sorts the array of rows in place, according to the sort order
+ *      previously set by blt_table_sort_init.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+SortRows(Table *tablePtr, Row **rows, size_t numRows)
+{
+    SortEngine engine;
+    SortItem *items, *tmp;
+    Row **sorted;
+    size_t i, numFilled;
+    int needProcs, numThreads;
+
+    if ((numRows < 2) || (tablePtr->numSortColumns == 0)) {
+        return;
+    }
+    engine.tablePtr = tablePtr;
+    engine.rows = rows;
+    engine.numRows = numRows;
+    engine.numKeys = tablePtr->numSortColumns;
+    engine.flags = tablePtr->sortFlags;
+    engine.keys = Blt_AssertCalloc(engine.numKeys, sizeof(SortKey));
+    needProcs = ExtractSortKeys(&engine, tablePtr->sortOrder);
+
+    items = Blt_AssertMalloc(numRows * sizeof(SortItem));
+    tmp = Blt_AssertMalloc(numRows * sizeof(SortItem));
+    numFilled = MakeSortItems(&engine, items);
+    if ((engine.numKeys == 1) && (engine.keys[0].type != SORT_KEY_STRING) &&
+        (engine.keys[0].type != SORT_KEY_PROC)) {
+        int inOrder;
+
+        /* The radix sort relies on the input being in index order to
+         * break ties. */
+        inOrder = TRUE;
+        for (i = 1; i < numRows; i++) {
+            if (rows[i - 1]->index >= rows[i]->index) {
+                inOrder = FALSE;
+                break;
+            }
+        }
+        if ((inOrder) && (numFilled > 0)) {
+            RadixSortItems(items, tmp, numFilled);
+            if (engine.flags & TABLE_SORT_DECREASING) {
+                size_t j;
+
+                for (i = 0, j = numRows - 1; i < j; i++, j--) {
+                    SortItem x;
+
+                    x = items[i], items[i] = items[j], items[j] = x;
+                }
+            }
+            goto done;
+        }
+    }
+    /* Sort the rows with and without a first key separately. */
+    numThreads = GetNumSortThreads(numRows, needProcs);
+    SortItems(&engine, items, tmp, numFilled, numThreads);
+    SortItems(&engine, items + numFilled, tmp + numFilled, 
+              numRows - numFilled, numThreads);
+    if ((engine.flags & TABLE_SORT_DECREASING) && (numFilled < numRows)) {
+        /* Empty values come first in decreasing order. */
+        memcpy(tmp, items + numFilled, 
+               (numRows - numFilled) * sizeof(SortItem));
+        memcpy(tmp + numRows - numFilled, items, numFilled * sizeof(SortItem));
+        memcpy(items, tmp, numRows * sizeof(SortItem));
+    }
+ done:
+    FreeSortKeys(&engine);
+    Blt_Free(tmp);
+
+    /* Reorder the rows according to the sorted items. */
+    sorted = Blt_AssertMalloc(numRows * sizeof(Row *));
+    for (i = 0; i < numRows; i++) {
+        sorted[i] = rows[items[i].pos];
+    }
+    memcpy(rows, sorted, numRows * sizeof(Row *));
+    Blt_Free(sorted);
+    Blt_Free(items);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SelectSortItems --
+ *
+ *      Selects the first limit items in sort order with a bounded heap.
+ *      The heap is a max-heap, so its root is the last of the items
+ *      selected so far.  Each remaining item only needs to be compared
+ *      with the root.  The cost is O(n log limit).
+ *
+ * Results:
+ *      Returns the number of items selected.  They are left in the heap
+ *      array, unsorted.
+ *
+ *---------------------------------------------------------------------------
+ */
+static size_t
+SelectSortItems(SortEngine *sortPtr, SortItem *items, size_t numItems, 
+                SortItem *heap, size_t limit)
+{
+    size_t i, n;
+
+    n = 0;
+    for (i = 0; i < numItems; i++) {
+        size_t k;
+
+        if (n < limit) {
+            /* Heap isn't full yet.  Sift the new item up. */
+            k = n++;
+            heap[k] = items[i];
+            while (k > 0) {
+                size_t parent;
+                SortItem x;
+
+                parent = (k - 1) / 2;
+                if (CompareItems(sortPtr, heap + parent, heap + k) >= 0) {
+                    break;
+                }
+                x = heap[parent], heap[parent] = heap[k], heap[k] = x;
+                k = parent;
+            }
+            continue;
+        }
+        if (CompareItems(sortPtr, items + i, heap) >= 0) {
+            continue;                   /* Sorts after every item kept. */
+        }
+        /* Replace the root and sift it down. */
+        heap[0] = items[i];
+        k = 0;
+        for (;;) {
+            size_t child;
+            SortItem x;
+
+            child = 2 * k + 1;
+            if (child >= n) {
+                break;
+            }
+            if (((child + 1) < n) && 
+                (CompareItems(sortPtr, heap + child + 1, heap + child) > 0)) {
+                child++;
+            }
+            if (CompareItems(sortPtr, heap + k, heap + child) >= 0) {
+                break;
+            }
+            x = heap[child], heap[child] = heap[k], heap[k] = x;
+            k = child;
+        }
+    }
+    return n;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * PartialSortRows --
+ *
+ *      Sorts only the first numSorted rows of the array.  They are the
+ *      same rows, in the same order, as the first numSorted rows from
+ *      SortRows.  The rest of the rows follow in their original order.
+ *      Rather than sorting all the rows, the rows are selected with a
+ *      bounded heap and only those are sorted.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+PartialSortRows(Table *tablePtr, Row **rows, size_t numRows, 
+                size_t numSorted)
+{
+    SortEngine engine;
+    SortItem *items, *heap, *tmp;
+    SortItem *groups[2];
+    size_t numItems[2];
+    Row **sorted;
+    unsigned char *selected;
+    size_t i, j, numFilled, numSelected;
+
+    if (numSorted >= numRows) {
+        SortRows(tablePtr, rows, numRows);
+        return;
+    }
+    if ((numSorted == 0) || (tablePtr->numSortColumns == 0)) {
+        return;
+    }
+    engine.tablePtr = tablePtr;
+    engine.rows = rows;
+    engine.numRows = numRows;
+    engine.numKeys = tablePtr->numSortColumns;
+    engine.flags = tablePtr->sortFlags;
+    engine.keys = Blt_AssertCalloc(engine.numKeys, sizeof(SortKey));
+    ExtractSortKeys(&engine, tablePtr->sortOrder);
+
+    items = Blt_AssertMalloc(numRows * sizeof(SortItem));
+    numFilled = MakeSortItems(&engine, items);
+    /* Rows with an empty first key sort last, or first in decreasing
+     * order.  Select from each group in turn. */
+    if (engine.flags & TABLE_SORT_DECREASING) {
+        groups[0] = items + numFilled, numItems[0] = numRows - numFilled;
+        groups[1] = items, numItems[1] = numFilled;
+    } else {
+        groups[0] = items, numItems[0] = numFilled;
+        groups[1] = items + numFilled, numItems[1] = numRows - numFilled;
+    }
+    heap = Blt_AssertMalloc(numSorted * sizeof(SortItem));
+    tmp = Blt_AssertMalloc(numSorted * sizeof(SortItem));
+    numSelected = 0;
+    for (i = 0; (i < 2) && (numSelected < numSorted); i++) {
+        size_t n;
+
+        n = SelectSortItems(&engine, groups[i], numItems[i], 
+                heap + numSelected, numSorted - numSelected);
+        MergeSortItems(&engine, heap + numSelected, tmp, 0, n);
+        numSelected += n;
+    }
+    FreeSortKeys(&engine);
+    Blt_Free(tmp);
+    Blt_Free(items);
+
+    /* Put the selected rows first, followed by the others. */
+    sorted = Blt_AssertMalloc(numRows * sizeof(Row *));
+    selected = Blt_AssertCalloc(numRows, sizeof(unsigned char));
+    for (i = 0; i < numSelected; i++) {
+        sorted[i] = rows[heap[i].pos];
+        selected[heap[i].pos] = TRUE;
+    }
+    for (i = 0, j = numSelected; i < numRows; i++) {
+        if (!selected[i]) {
+            sorted[j] = rows[i];
+            j++;
+        }
+    }
+    memcpy(rows, sorted, numRows * sizeof(Row *));
+    Blt_Free(selected);
+    Blt_Free(sorted);
+    Blt_Free(heap);
+}
+
+static void
+ReplaceRowMap(Rows *rowsPtr, Row **map)
+{
+    size_t i;
+
+    if (rowsPtr->numUsed == 0) {
+        return;
+    }
+    /* Rethread list according to the map. */
+    for (i = 0; i < rowsPtr->numUsed; i++) {
+        Row *rowPtr;
+        Row *prevPtr, *nextPtr;
+
+        prevPtr = (i > 0) ? map[i-1] : NULL;
+        nextPtr = ((i+1) < rowsPtr->numUsed) ? map[i+1] : NULL;
+        rowPtr = map[i];
+        rowPtr->prevPtr = prevPtr;
+        rowPtr->nextPtr = nextPtr;
+        rowPtr->index = i;
+    }
+    rowsPtr->headPtr = map[0];
+    rowsPtr->tailPtr = map[rowsPtr->numUsed-1];
+    if (rowsPtr->map != NULL) {
+        Blt_Free(rowsPtr->map);
+    }
+    /* Callers build maps of only the used rows.  New rows are added in
+     * place, so the map must span all the allocated rows. */
+    if (rowsPtr->numAllocated > rowsPtr->numUsed) {
+        map = Blt_AssertRealloc(map, rowsPtr->numAllocated * sizeof(Row *));
+        memset(map + rowsPtr->numUsed, 0, 
+               (rowsPtr->numAllocated - rowsPtr->numUsed) * sizeof(Row *));
+    }
+    rowsPtr->map = map;
+    ClearRowHoles(rowsPtr);
+    rowsPtr->flags &= ~REINDEX;
+}
+
+static void
+ReplaceColumnMap(Columns *columnsPtr, Column **map)
+{
+    size_t i;
+    Column *prevPtr;
+    Column *colPtr;
+
+    if (columnsPtr->numUsed == 0) {
+        return;
+    }
+    /* Rethread column list according to the map. */
+    prevPtr = NULL;
+    for (i = 0; i < (columnsPtr->numUsed - 1); i++) {
+        colPtr = map[i];
+        colPtr->index = i;
+        colPtr->nextPtr = map[i + 1];
+        colPtr->prevPtr = prevPtr;
+        prevPtr =  map[i];
+    }
+    colPtr = map[i];
+    colPtr->nextPtr = NULL;
+    colPtr->prevPtr = prevPtr;
+    columnsPtr->headPtr = map[0];
+    columnsPtr->tailPtr = colPtr;
+    if (columnsPtr->map != NULL) {
+        Blt_Free(columnsPtr->map);
+    }
+    columnsPtr->map = map;
+}
+
+static int
+MoveRows(Rows *rowsPtr, Row *destPtr, Row *firstPtr, Row *lastPtr, int after)
+{
+    if (rowsPtr->flags & REINDEX) {
+        ResetRowMap(rowsPtr);
+    }
+    /* Check is destination outside the range of rows to be moved. */
+    assert ((destPtr->index < firstPtr->index) ||
+            (destPtr->index > lastPtr->index));
+
+    /* Unlink the sub-list from the list of rows. */
+    if (rowsPtr->headPtr == firstPtr) {
+        rowsPtr->headPtr = lastPtr->nextPtr;
+        lastPtr->nextPtr->prevPtr = NULL;
+    }
+    if (rowsPtr->tailPtr == lastPtr) {
+        rowsPtr->tailPtr = lastPtr->prevPtr;
+        lastPtr->prevPtr->nextPtr = NULL;
+    }
+    if (lastPtr->nextPtr != NULL) {
+        lastPtr->nextPtr->prevPtr = firstPtr->prevPtr;
+    }
+    if (firstPtr->prevPtr != NULL) {
+        firstPtr->prevPtr->nextPtr = lastPtr->nextPtr;
+    }
+    firstPtr->prevPtr = lastPtr->nextPtr = NULL;
+    /* Now attach the detached list to the destination. */
+    if (after) {
+        if (destPtr->nextPtr == NULL) {
+            rowsPtr->tailPtr = lastPtr; /* Append to the end. */
+        } else {
+            destPtr->nextPtr->prevPtr = lastPtr;
+        }
+        firstPtr->prevPtr = destPtr;
+        lastPtr->nextPtr = destPtr->nextPtr;
+        destPtr->nextPtr = firstPtr;
+    } else {
+        if (destPtr->prevPtr == NULL) {
+            rowsPtr->headPtr = firstPtr; /* Prepend to the beginning. */
+        } else {
+            destPtr->prevPtr->nextPtr = firstPtr;
+        }
+        firstPtr->prevPtr = destPtr->prevPtr;
+        lastPtr->nextPtr = destPtr;
+        destPtr->prevPtr = lastPtr;
+    }
+    /* FIXME: You don't have to reset the entire map. */
+    ResetRowMap(rowsPtr);
+    return TRUE;
+}
+
+static int
+MoveColumns(Columns *columnsPtr, Column *destPtr, Column *firstPtr, 
+            Column *lastPtr, int after)
+{
+    if (columnsPtr->flags & REINDEX) {
+        ResetColumnMap(columnsPtr);
+    }
+    assert (firstPtr->index <= lastPtr->index);
+    /* Unlink the sub-list from the list of columns. */
+    if (columnsPtr->headPtr == firstPtr) {
+        columnsPtr->headPtr = lastPtr->nextPtr;
+        lastPtr->nextPtr->prevPtr = NULL;
+    } else {
+        firstPtr->prevPtr->nextPtr = lastPtr->nextPtr;
+    }
+    if (columnsPtr->tailPtr == lastPtr) {
+        columnsPtr->tailPtr = firstPtr->prevPtr;
+        firstPtr->prevPtr->nextPtr = NULL;
+    } else {
+        lastPtr->nextPtr->prevPtr = firstPtr->prevPtr;
+    }
+    firstPtr->prevPtr = lastPtr->nextPtr = NULL;
+
+    /* Now attach the detached list to the destination. */
+    if (after) { 
+        /* [a]->[dest]->[b] */
+        /*            [first]->[last] */
+        if (destPtr->nextPtr == NULL) {
+            assert(destPtr == columnsPtr->tailPtr);
+            columnsPtr->tailPtr = lastPtr; /* Append to the end. */
+        } else {
+            destPtr->nextPtr->prevPtr = lastPtr;
+        }
+        lastPtr->nextPtr = destPtr->nextPtr;
+        destPtr->nextPtr = firstPtr;
+        firstPtr->prevPtr = destPtr;
+    } else {
+        /*           [a]->[dest]->[b] */
+        /* [first]->[last] */
+        if (destPtr->prevPtr == NULL) {
+            columnsPtr->headPtr = firstPtr;
+        } else {
+            destPtr->prevPtr->nextPtr = firstPtr;
+        }
+        firstPtr->prevPtr = destPtr->prevPtr;
+        destPtr->prevPtr = lastPtr;
+        lastPtr->nextPtr = destPtr;
+    }
+    /* FIXME: You don't have to reset the entire map. */
+    ResetColumnMap(columnsPtr);
+    return TRUE;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ParseDumpRecord --
+ *
+ *      Gets the next full record in the dump string, returning the
+ *      record as a list. Blank lines and comments are ignored.
+ *
+ * Results: 
+ *      TCL_RETURN      The end of the string is reached.
+ *      TCL_ERROR       An error occurred and an error message 
+ *                      is left in the interpreter result.  
+ *      TCL_OK          The next record has been successfully parsed.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ParseDumpRecord(
+    Tcl_Interp *interp,
+    char **sp,                          /* (in/out) points to current
+                                         * location in in dump
+                                         * string. Updated after parsing
+                                         * record. */
+    RestoreData *restorePtr)
+{
+    char *entry, *eol;
+    char saved;
+    int result;
+
+    restorePtr->argc = 0;
+    entry = *sp;
+    /* Get first line, ignoring blank lines and comments. */
+    for (;;) {
+        char *first;
+
+        first = NULL;
+        restorePtr->numLines++;
+        /* Find the end of the first line. */
+        for (eol = entry; (*eol != '\n') && (*eol != '\0'); eol++) {
+            if ((first == NULL) && (!isspace(UCHAR(*eol)))) {
+                first = eol;    /* Track first non-whitespace
+                                 * character. */
+            }
+        }
+        if (first == NULL) {
+            if (*eol == '\0') {
+                return TCL_RETURN;
+            }
+        } else if (*first != '#') {
+            break;                      /* Not a comment or blank line. */
+        }
+        entry = eol + 1;
+    }
+    saved = *eol;
+    *eol = '\0';
+    while (!Tcl_CommandComplete(entry)) {
+        *eol = saved;
+        if (*eol == '\0') {
+            Tcl_AppendResult(interp, "incomplete dump record: \"", entry, 
+                "\"", (char *)NULL);
+            return TCL_ERROR;           /* Found EOF (incomplete entry) or
+                                         * error. */
+        }
+        /* Get the next line. */
+        for (eol = eol + 1; (*eol != '\n') && (*eol != '\0'); eol++) {
+            /*empty*/
+        }
+        restorePtr->numLines++;
+        saved = *eol;
+        *eol = '\0';
+    }
+    if (entry == eol) {
+        return TCL_RETURN;
+    }
+    result = Tcl_SplitList(interp, entry, &restorePtr->argc, &restorePtr->argv);
+    *eol = saved;
+    *sp = eol + 1;
+    return result;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ReadDumpRecord --
+ *
+ *      Reads the next full record from the given channel, returning the
+ *      record as a list. Blank lines and comments are ignored.
+ *
+ * Results: 
+ *      TCL_RETURN      The end of the file has been reached.
+ *      TCL_ERROR       A read error has occurred and an error message 
+ *                      is left in the interpreter result.  
+ *      TCL_OK          The next record has been successfully parsed.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ReadDumpRecord(Tcl_Interp *interp, Tcl_Channel channel, RestoreData *restorePtr)
+{
+    int result;
+    Tcl_DString ds;
+
+    Tcl_DStringInit(&ds);
+    /* Get first line, ignoring blank lines and comments. */
+    for (;;) {
+        const char *cp;
+        int numChars;
+
+        Tcl_DStringSetLength(&ds, 0);
+        numChars = Tcl_Gets(channel, &ds);
+        if (numChars < 0) {
+            if (Tcl_Eof(channel)) {
+                return TCL_RETURN;
+            }
+            return TCL_ERROR;
+        }
+        restorePtr->numLines++;
+        for (cp = Tcl_DStringValue(&ds); *cp != '\0'; cp++) {
+            if (!isspace(UCHAR(*cp))) {
+                break;
+            }
+        }
+        if ((*cp != '\0') && (*cp != '#')) {
+            break;              /* Not a comment or blank line. */
+        }
+    }
+
+    Tcl_DStringAppend(&ds, "\n", 1);
+    while (!Tcl_CommandComplete(Tcl_DStringValue(&ds))) {
+        int numChars;
+
+        /* Process additional lines if needed */
+        numChars = Tcl_Gets(channel, &ds);
+        if (numChars < 0) {
+            Tcl_AppendResult(interp, "error reading file: ", 
+                             Tcl_PosixError(interp), (char *)NULL);
+            Tcl_DStringFree(&ds);
+            return TCL_ERROR;           /* Found EOF (incomplete entry) or
+                                         * error. */
+        }
+        restorePtr->numLines++;
+        Tcl_DStringAppend(&ds, "\n", 1);
+    }
+    result = Tcl_SplitList(interp, Tcl_DStringValue(&ds), &restorePtr->argc, 
+                           &restorePtr->argv);
+    Tcl_DStringFree(&ds);
+    return result;
+}
+
+static void
+RestoreError(Tcl_Interp *interp, RestoreData *restorePtr)
+{
+    Tcl_DString ds;
+
+    Tcl_DStringInit(&ds);
+    Tcl_DStringGetResult(interp, &ds);
+    Tcl_AppendResult(interp, restorePtr->fileName, ":", 
+        Blt_Ltoa(restorePtr->numLines), ": error: ", Tcl_DStringValue(&ds), 
+        (char *)NULL);
+    Tcl_DStringFree(&ds);
+}
+
+static int
+RestoreHeader(Tcl_Interp *interp, BLT_TABLE table, RestoreData *restorePtr)
+{
+    long numCols, numRows, count;
+    int64_t time;
+
+    /* i rows columns ctime mtime */
+    if (restorePtr->argc != 5) {
+        RestoreError(interp, restorePtr);
+        Tcl_AppendResult(interp, "wrong # of elements in restore header.", 
+                (char *)NULL);
+        return TCL_ERROR;
+    }   
+    if (Blt_GetCount(interp, restorePtr->argv[1], COUNT_POS, &count)
+        != TCL_OK) {
+        RestoreError(interp, restorePtr);
+        return TCL_ERROR;
+    }
+    /* FIXME: What are you doing w/ numRows and numCols? */
+    numRows = count;
+    if (Blt_GetCount(interp, restorePtr->argv[2], COUNT_POS, &count)!=TCL_OK) {
+        RestoreError(interp, restorePtr);
+        return TCL_ERROR;
+    }
+    numCols = count;
+    if ((restorePtr->flags & TABLE_RESTORE_OVERWRITE) == 0) {
+        numRows += restorePtr->numRows;
+        numCols += restorePtr->numCols;
+    }
+    if (Blt_GetInt64(interp, restorePtr->argv[3], &time) != TCL_OK){
+        RestoreError(interp, restorePtr);
+        return TCL_ERROR;
+    }
+    restorePtr->ctime = time;
+    if (Blt_GetInt64(interp, restorePtr->argv[4], &time) != TCL_OK){
+        RestoreError(interp, restorePtr);
+        return TCL_ERROR;
+    }
+    restorePtr->mtime = time;
+    return TCL_OK;
+}
+
+static int
+RestoreColumn(Tcl_Interp *interp, BLT_TABLE table, RestoreData *restorePtr)
+{
+    long index;
+    Column *colPtr;
+    int type;
+    const char *label;
+    int isNew;
+    Blt_HashEntry *hPtr;
+
+    /* c index label type ?tagList? */
+    if ((restorePtr->argc < 4) || (restorePtr->argc > 5)) {
+        RestoreError(interp, restorePtr);
+        Tcl_AppendResult(interp, "wrong # elements in restore column entry", 
+                (char *)NULL);
+        return TCL_ERROR;
+    }   
+    if (Blt_GetLong(interp, restorePtr->argv[1], &index) != TCL_OK) {
+        RestoreError(interp, restorePtr);
+        return TCL_ERROR;
+    }
+    label = restorePtr->argv[2];
+    colPtr = blt_table_get_column_by_label(table, label);
+    if ((colPtr == NULL) || 
+        ((restorePtr->flags & TABLE_RESTORE_OVERWRITE) == 0)) {
+        colPtr = blt_table_create_column(interp, table, label);
+        if (colPtr == NULL) {
+            RestoreError(interp, restorePtr);
+            Tcl_AppendResult(interp, "can't append column \"", label, "\"",
+                             (char *)NULL);
+            return TCL_ERROR;
+        }
+    }
+    hPtr = Blt_CreateHashEntry(&restorePtr->colIndices,(intptr_t)index, &isNew);
+    Blt_SetHashValue(hPtr, colPtr);
+
+    type = blt_table_name_to_column_type(restorePtr->argv[3]);
+    if (type == TABLE_COLUMN_TYPE_UNKNOWN) {
+        RestoreError(interp, restorePtr);
+        Tcl_AppendResult(interp, "bad column type \"", restorePtr->argv[3], 
+                         "\"", (char *)NULL);
+        return TCL_ERROR;
+    }
+    if ((colPtr->type != type) &&
+        (blt_table_set_column_type(interp, table, colPtr, type) != TCL_OK)) {
+        RestoreError(interp, restorePtr);
+        return TCL_ERROR;
+    }
+    if ((restorePtr->argc == 5) && 
+        ((restorePtr->flags & TABLE_RESTORE_NO_TAGS) == 0)) {
+        int i, argc;
+        const char **argv;
+
+        if (Tcl_SplitList(interp, restorePtr->argv[4], &argc, &argv)!= TCL_OK) {
+            RestoreError(interp, restorePtr);
+            return TCL_ERROR;
+        }
+        
+        for (i = 0; i < argc; i++) {
+            if (blt_table_set_column_tag(interp, table, colPtr, argv[i]) 
+                != TCL_OK) {
+                Tcl_Free((char *)argv);
+                return TCL_ERROR;
+            }
+        }
+        Tcl_Free((char *)argv);
+    }
+    return TCL_OK;
+}
+
+static int
+RestoreRow(Tcl_Interp *interp, BLT_TABLE table, RestoreData *restorePtr)
+{
+    BLT_TABLE_ROW row;
+    Blt_HashEntry *hPtr;
+    const char *label;
+    int isNew;
+    long index;
+
+    /* r index label ?tagList? */
+    if ((restorePtr->argc < 3) || (restorePtr->argc > 4)) {
+        RestoreError(interp, restorePtr);
+        Tcl_AppendResult(interp, "wrong # of elements in restore row entry", 
+                         (char *)NULL);
+        return TCL_ERROR;
+    }   
+    if (Blt_GetLong(interp, restorePtr->argv[1], &index) != TCL_OK) {
+        RestoreError(interp, restorePtr);
+        return TCL_ERROR;
+    }
+    label = restorePtr->argv[2];
+    row = blt_table_get_row_by_label(table, label);
+    if ((row == NULL) || ((restorePtr->flags & TABLE_RESTORE_OVERWRITE) == 0)) {
+        row = blt_table_create_row(interp, table, label);
+        if (row == NULL) {
+            RestoreError(interp, restorePtr);
+            Tcl_AppendResult(interp, "can't append row \"", label, "\"",
+                     (char *)NULL);
+            return TCL_ERROR;
+        }
+    }
+    hPtr = Blt_CreateHashEntry(&restorePtr->rowIndices,(intptr_t)index, &isNew);
+    Blt_SetHashValue(hPtr, row);
+    if ((restorePtr->argc == 5) && 
+        ((restorePtr->flags & TABLE_RESTORE_NO_TAGS) == 0)) {
+        const char **argv;
+        int argc;
+        int i;
+
+        if (Tcl_SplitList(interp, restorePtr->argv[3], &argc, &argv)!= TCL_OK) {
+            RestoreError(interp, restorePtr);
+            return TCL_ERROR;
+        }
+        for (i = 0; i < argc; i++) {
+            if (blt_table_set_row_tag(interp, table, row, argv[i]) != TCL_OK) {
+                Tcl_Free((char *)argv);
+                return TCL_ERROR;
+            }
+        }
+        Tcl_Free((char *)argv);
+    }
+    return TCL_OK;
+}
+
+static int
+RestoreValue(Tcl_Interp *interp, BLT_TABLE table, RestoreData *restorePtr)
+{
+    Blt_HashEntry *hPtr;
+    int result;
+    Row *rowPtr;
+    Column *colPtr;
+    Value value;
+    long index;
+
+    /* d row column value */
+    if (restorePtr->argc != 4) {
+        RestoreError(interp, restorePtr);
+        Tcl_AppendResult(interp, "wrong # elements in restore data entry", 
+                (char *)NULL);
+        return TCL_ERROR;
+    }   
+    if (Blt_GetLong(interp, restorePtr->argv[1], &index) != TCL_OK) {
+        RestoreError(interp, restorePtr);
+        return TCL_ERROR;
+    }
+    hPtr = Blt_FindHashEntry(&restorePtr->rowIndices, (intptr_t)index);
+    if (hPtr == NULL) {
+        RestoreError(interp, restorePtr);
+        Tcl_AppendResult(interp, "bad row index \"", restorePtr->argv[1], "\"",
+                         (char *)NULL);
+        return TCL_ERROR;
+    }
+    rowPtr = Blt_GetHashValue(hPtr);
+    if (Blt_GetLong(interp, restorePtr->argv[2], &index) != TCL_OK) {
+        RestoreError(interp, restorePtr);
+        return TCL_ERROR;
+    }
+    hPtr = Blt_FindHashEntry(&restorePtr->colIndices, (intptr_t)index);
+    if (hPtr == NULL) {
+        RestoreError(interp, restorePtr);
+        Tcl_AppendResult(interp, "bad column index \"", restorePtr->argv[2], 
+                "\"", (char *)NULL);
+        return TCL_ERROR;
+    }
+    colPtr = Blt_GetHashValue(hPtr);
+    memset(&value, 0, sizeof(Value));
+    result = SetValueFromString(interp, colPtr, colPtr->type, 
+        restorePtr->argv[3], -1, &value);
+    if (result == TCL_OK) {
+        result = PutValue(interp, table, rowPtr, colPtr, &value);
+    }
+    if (result != TCL_OK) {
+        RestoreError(interp, restorePtr);
+    }
+    return result;
+}
+
+BLT_TABLE_ROW *
+blt_table_get_row_map(Table *tablePtr)  
+{
+    if (tablePtr->corePtr->rows.flags & REINDEX) {
+        ResetRowMap(&tablePtr->corePtr->rows);
+    }
+    return tablePtr->corePtr->rows.map;
+}
+
+BLT_TABLE_COLUMN *
+blt_table_get_column_map(Table *tablePtr)  
+{
+    if (tablePtr->corePtr->columns.flags & REINDEX) {
+        ResetColumnMap(&tablePtr->corePtr->columns);
+    }
+    return tablePtr->corePtr->columns.map;
+}
+
+Blt_Chain
+blt_table_get_row_tags(Table *tablePtr, Row *rowPtr)  
+{
+    Blt_Chain chain;
+    Blt_HashEntry *hPtr;
+    Blt_HashSearch iter;
+
+    chain = Blt_Chain_Create();
+    for (hPtr = Blt_FirstHashEntry(tablePtr->rowTags, &iter); hPtr != NULL;
+         hPtr = Blt_NextHashEntry(&iter)) {
+        if (TagSetContains(Blt_GetHashValue(hPtr), rowPtr->offset)) {
+            Blt_Chain_Append(chain, 
+                             Blt_GetHashKey(tablePtr->rowTags, hPtr));
+        }
+    }
+    return chain;
+}
+
+Blt_HashTable *
+blt_table_get_row_tag_table(Table *tablePtr)  
+{
+    return tablePtr->rowTags;
+}
+
+Blt_HashTable *
+blt_table_get_column_tag_table(Table *tablePtr)  
+{
+    return Blt_Tags_GetTable(tablePtr->columnTags);
+}
+
+Blt_Chain
+blt_table_get_column_tags(Table *tablePtr, Column *colPtr)  
+{
+    Blt_Chain chain;
+
+    chain = Blt_Chain_Create();
+    Blt_Tags_AppendTagsToChain(tablePtr->columnTags, colPtr, chain);
+    return chain;
+}
+
+Blt_Chain
+blt_table_get_tagged_columns(Table *tablePtr, const char *tag)  
+{
+    return Blt_Tags_GetItemList(tablePtr->columnTags, tag);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_get_tagged_rows --
+ *
+ *      Returns the list of rows having the tag, in the order they are
+ *      stored.  The list is built from the tag's bitmap on demand and
+ *      belongs to the tag: it's valid only until the tag is next changed.
+ *      Use blt_table_iterate_row_tag to visit the rows without building
+ *      the list.
+ *
+ * Results:
+ *      Returns the list of rows.  If the tag doesn't exist, NULL is
+ *      returned.
+ *
+ *---------------------------------------------------------------------------
+ */
+Blt_Chain
+blt_table_get_tagged_rows(Table *tablePtr, const char *tag)  
+{
+    Blt_HashEntry *hPtr;
+    TagSet *setPtr;
+
+    hPtr = Blt_FindHashEntry(tablePtr->rowTags, tag);
+    if (hPtr == NULL) {
+        return NULL;
+    }
+    setPtr = Blt_GetHashValue(hPtr);
+    if (setPtr->chain == NULL) {
+        Rows *rowsPtr;
+        Row *rowPtr;
+        long offset;
+
+        rowsPtr = &tablePtr->corePtr->rows;
+        setPtr->chain = Blt_Chain_Create();
+        offset = 0;
+        while ((rowPtr = NextTaggedRow(rowsPtr, setPtr, &offset)) != NULL) {
+            Blt_Chain_Append(setPtr->chain, rowPtr);
+        }
+    }
+    return setPtr->chain;
+}
+
+
+int 
+blt_table_same_object(Table *tablePtr1, Table *tablePtr2)  
+{
+    return tablePtr1->corePtr == tablePtr2->corePtr;
+}
+
+BLT_TABLE_ROW
+blt_table_get_row_by_index(Table *tablePtr, long index)  
+{
+    if (index < blt_table_num_rows(tablePtr)) {
+        return blt_table_row(tablePtr, index);
+    }
+    return NULL;
+}
+
+BLT_TABLE_COLUMN
+blt_table_get_column_by_index(Table *tablePtr, long index)  
+{
+    if (tablePtr->corePtr->columns.flags & REINDEX) {
+        ResetColumnMap(&tablePtr->corePtr->columns);
+    }
+    if (index < blt_table_num_columns(tablePtr)) {
+        return blt_table_column(tablePtr, index);
+    }
+    return NULL;
+}
+
+BLT_TABLE_ROWCOLUMN_SPEC
+blt_table_row_spec(BLT_TABLE table, Tcl_Obj *objPtr, const char **sp)
+{
+    const char *p;
+    const char *string;
+    long index;
+    char c;
+
+    string = Tcl_GetString(objPtr);
+    *sp = string;
+    c = string[0];
+    if (c == '@') {
+        *sp = string + 1;
+        return TABLE_SPEC_TAG;
+    } else if ((isdigit(UCHAR(c))) && 
+               (Blt_GetLongFromObj(NULL, objPtr, &index) == TCL_OK)) {
+        return TABLE_SPEC_INDEX;
+    } else if ((c == 'r') && (strncmp(string, "range:", 6) == 0)) {
+        *sp = string + 6;
+        return TABLE_SPEC_RANGE;
+    } else if ((c == 'i') && (strncmp(string, "index:", 6) == 0)) {
+        *sp = string + 6;
+        return TABLE_SPEC_INDEX;
+    } else if ((c == 'l') && (strncmp(string, "label:", 6) == 0)) {
+        *sp = string + 6;
+        return TABLE_SPEC_LABEL;
+    } else if ((c == 't') && (strncmp(string, "tag:", 4) == 0)) {
+        *sp = string + 4;
+        return TABLE_SPEC_TAG;
+    } else if (blt_table_get_row_by_label(table, string) != NULL) {
+        return TABLE_SPEC_LABEL;
+    }
+    p = strchr(string, '-');
+    if (p != NULL) {
+        Tcl_Obj *rangeObjPtr;
+        BLT_TABLE_ROW row;
+
+        rangeObjPtr = Tcl_NewStringObj(string, p - string);
+        row = blt_table_get_row((Tcl_Interp *)NULL, table, rangeObjPtr);
+        Tcl_DecrRefCount(rangeObjPtr);
+        if (row != NULL) {
+            rangeObjPtr = Tcl_NewStringObj(p + 1, -1);
+            row = blt_table_get_row((Tcl_Interp *)NULL, table, rangeObjPtr);
+            Tcl_DecrRefCount(rangeObjPtr);
+            if (row != NULL) {
+                return TABLE_SPEC_RANGE;
+            }
+        }
+    } 
+    return TABLE_SPEC_UNKNOWN;
+}
+
+BLT_TABLE_COLUMN
+blt_table_first_column(Table *tablePtr)  
+{
+    return tablePtr->corePtr->columns.headPtr;
+}
+
+BLT_TABLE_COLUMN
+blt_table_last_column(Table *tablePtr)  
+{
+    return tablePtr->corePtr->columns.tailPtr;
+}
+
+BLT_TABLE_COLUMN
+blt_table_next_column(Column *colPtr)  
+{
+    return colPtr->nextPtr;
+}
+
+BLT_TABLE_COLUMN
+blt_table_previous_column(Column *colPtr)  
+{
+    return colPtr->prevPtr;
+}
+
+BLT_TABLE_ROW
+blt_table_first_row(Table *tablePtr)  
+{
+    return tablePtr->corePtr->rows.headPtr;
+}
+
+BLT_TABLE_ROW
+blt_table_last_row(Table *tablePtr)  
+{
+    return tablePtr->corePtr->rows.tailPtr;
+}
+
+BLT_TABLE_ROW
+blt_table_next_row(Row *rowPtr)  
+{
+    return rowPtr->nextPtr;
+}
+
+BLT_TABLE_ROW
+blt_table_previous_row(Row *rowPtr)  
+{
+    return rowPtr->prevPtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_iterate_rows --
+ *
+ *      Returns the id of the first row derived from the given tag,
+ *      label or index represented in objPtr.  
+ *
+ * Results:
+ *      Returns the row location of the first item.  If no row 
+ *      can be found, then -1 is returned and an error message is
+ *      left in the interpreter.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_iterate_rows(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr, 
+                      BLT_TABLE_ITERATOR *iterPtr)
+{
+    const char *tag, *p;
+    long index;
+    BLT_TABLE_ROWCOLUMN_SPEC spec;
+    Rows *rowsPtr;
+    memset(iterPtr, 0, sizeof(BLT_TABLE_ITERATOR));
+    iterPtr->table = table;
+    iterPtr->type = TABLE_ITERATOR_INDEX;
+    iterPtr->link = NULL;
+    iterPtr->numEntries = 0;
+
+    spec = blt_table_row_spec(table, objPtr, &tag);
+    rowsPtr = blt_table_rows(table);
+    if ((rowsPtr->flags & (REINDEX|REINDEX_HOLES)) == REINDEX) {
+        ResetRowMap(rowsPtr);
+    }
+    switch (spec) {
+    case TABLE_SPEC_INDEX:
+        {
+            int result;
+
+            p = Tcl_GetString(objPtr);
+            if (p == tag) {
+                result = Blt_GetLongFromObj(NULL, objPtr, &index);
+            } else {
+                result = Blt_GetLong(NULL, (char *)tag, &index);
+            }
+            if (result != TCL_OK) {
+                if (interp != NULL) {
+                    Tcl_AppendResult(interp, "badly formed row index \"", tag, 
+                                     "\"", (char *)NULL);
+                }
+                return TCL_ERROR;
+            }
+            if (index >= blt_table_num_rows(table)) {
+                if (interp != NULL) {
+                    Tcl_AppendResult(interp, "bad row index \"", 
+                                     Tcl_GetString(objPtr), "\"", (char *)NULL);
+                }
+                return TCL_ERROR;
+            }               
+            iterPtr->firstPtr = iterPtr->lastPtr = blt_table_row(table, index);
+            if (iterPtr->firstPtr != NULL) {
+                iterPtr->numEntries = 1;
+            }
+            iterPtr->tag = tag;
+            return TCL_OK;
+        }
+        break;
+
+    case TABLE_SPEC_LABEL:
+        iterPtr->tablePtr = blt_table_row_get_label_table(table, tag);
+        if (iterPtr->tablePtr != NULL) {
+            iterPtr->type = TABLE_ITERATOR_LABEL;
+            iterPtr->tag = tag;
+            iterPtr->numEntries = iterPtr->tablePtr->numEntries;
+            return TCL_OK;
+        }
+        break;
+        
+    case TABLE_SPEC_TAG:
+        {
+            if (strcmp(tag, "all") == 0) {
+                Row *firstPtr, *lastPtr;
+                
+                iterPtr->type = TABLE_ITERATOR_ALL;
+                firstPtr = blt_table_first_row(table);
+                lastPtr = blt_table_last_row(table);
+                iterPtr->tag = tag;
+                iterPtr->numEntries = rowsPtr->numUsed;
+                iterPtr->firstPtr = firstPtr;
+                iterPtr->lastPtr = lastPtr;
+                return TCL_OK;
+            }
+            if (strcmp(tag, "end") == 0) {
+                iterPtr->tag = tag;
+                iterPtr->firstPtr = iterPtr->lastPtr = 
+                    blt_table_last_row(table);
+                if (iterPtr->firstPtr != NULL) {
+                    iterPtr->numEntries = 1;
+                }
+                return TCL_OK;
+            }
+            blt_table_iterate_row_tag(table, tag, iterPtr);
+        }
+        return TCL_OK;
+        
+    case TABLE_SPEC_RANGE:
+        {
+            Row *firstPtr, *lastPtr;
+            Tcl_Obj *rangeObjPtr;
+
+            p = strchr(tag, '-');
+            if (p == NULL) {
+                if (interp != NULL) {
+                    Tcl_AppendResult(interp, "bad range specification \"", tag, 
+                                     "\"", (char *)NULL);
+                }
+                return TCL_ERROR;
+            }
+            rangeObjPtr = Tcl_NewStringObj(tag, p - tag);
+            firstPtr = blt_table_get_row(interp, table, rangeObjPtr);
+            Tcl_DecrRefCount(rangeObjPtr);
+            if (firstPtr == NULL) {
+                return TCL_ERROR;
+            }
+            rangeObjPtr = Tcl_NewStringObj(p + 1, -1);
+            lastPtr = blt_table_get_row(interp, table, rangeObjPtr);
+            Tcl_DecrRefCount(rangeObjPtr);
+            if (lastPtr == NULL) {
+                return TCL_ERROR;
+            }
+            if (firstPtr->index > lastPtr->index) {
+                return TCL_OK;
+            }
+            iterPtr->firstPtr = firstPtr;
+            iterPtr->lastPtr = lastPtr;
+            iterPtr->type = TABLE_ITERATOR_RANGE;
+            iterPtr->table = table;
+            iterPtr->tag = tag;
+            iterPtr->numEntries = blt_table_row_index(table, lastPtr) - 
+                blt_table_row_index(table, firstPtr) + 1;
+        }
+        return TCL_OK;
+
+    default:
+        break;
+    }
+    if (interp != NULL) {
+        Tcl_AppendResult(interp, "unknown row specification \"", tag, 
+                         "\" in ", blt_table_name(table), (char *)NULL);
+    }
+    return TCL_ERROR;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_first_tagged_row --
+ *
+ *      Returns the id of the next row derived from the given tag.
+ *
+ * Results:
+ *      Returns the row location of the first item.  If no more rows
+ *      can be found, then -1 is returned.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_ROW
+blt_table_first_tagged_row(BLT_TABLE_ITERATOR *iterPtr)
+{
+    switch (iterPtr->type) {
+    case TABLE_ITERATOR_TAG:
+        iterPtr->nextOffset = 0;
+        return NextTaggedRow(blt_table_rows(iterPtr->table), 
+                iterPtr->tagSetPtr, &iterPtr->nextOffset);
+
+    case TABLE_ITERATOR_CHAIN:
+        /* iterPtr->link is already set by blt_table_row_iterator */
+        if (iterPtr->link != NULL) {
+            BLT_TABLE_ROW row;
+
+            row = Blt_Chain_GetValue(iterPtr->link);
+            iterPtr->link = Blt_Chain_NextLink(iterPtr->link);
+            return row;
+        }
+        break;
+    case TABLE_ITERATOR_LABEL:
+        {
+            Blt_HashEntry *hPtr;
+
+            hPtr = Blt_FirstHashEntry(iterPtr->tablePtr, &iterPtr->cursor);
+            if (hPtr == NULL) {
+                return NULL;
+            }
+            return Blt_GetHashValue(hPtr);
+        }
+        break;
+
+    default:
+        if (iterPtr->firstPtr != NULL) {
+            Row *rowPtr;
+
+            rowPtr = iterPtr->firstPtr;
+            if (rowPtr == iterPtr->lastPtr) {
+                iterPtr->nextPtr = NULL;
+            } else {
+                iterPtr->nextPtr = rowPtr->nextPtr;
+            }
+            return rowPtr;
+        } 
+    }
+    return NULL;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_next_tagged_row --
+ *
+ *      Returns the id of the next row derived from the given tag.
+ *
+ * Results:
+ *      Returns the row location of the first item.  If no more rows can be
+ *      found, then -1 is returned.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_ROW
+blt_table_next_tagged_row(BLT_TABLE_ITERATOR *iterPtr)
+{
+    switch (iterPtr->type) {
+    case TABLE_ITERATOR_TAG:
+        if (iterPtr->nextOffset < 0) {
+            return NULL;
+        }
+        return NextTaggedRow(blt_table_rows(iterPtr->table), 
+                iterPtr->tagSetPtr, &iterPtr->nextOffset);
+
+    case TABLE_ITERATOR_CHAIN:
+        if (iterPtr->link != NULL) {
+            BLT_TABLE_ROW row;
+            
+            row = Blt_Chain_GetValue(iterPtr->link);
+            iterPtr->link = Blt_Chain_NextLink(iterPtr->link);
+            return row;
+        }
+        break;
+    case TABLE_ITERATOR_LABEL:
+        {
+            Blt_HashEntry *hPtr;
+            
+            hPtr = Blt_NextHashEntry(&iterPtr->cursor); 
+            if (hPtr == NULL) {
+                return NULL;
+            }
+            return Blt_GetHashValue(hPtr);
+        }
+        break;
+    default:
+        if (iterPtr->nextPtr != NULL) {
+            Row *rowPtr;
+
+            rowPtr = iterPtr->nextPtr;
+            if (rowPtr == iterPtr->lastPtr) {
+                iterPtr->nextPtr = NULL;
+            } else {
+                iterPtr->nextPtr = rowPtr->nextPtr;
+            }
+            return rowPtr;
+        }       
+    }
+    return NULL;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_get_row --
+ *
+ *      Gets the row offset associated the given row index, tag, or label.
+ *      This routine is used when you want only one row index.  It's an
+ *      error if more than one row is specified (e.g. "all" tag or range
+ *      "1-4").  It's also an error if the row tag is empty (no rows are
+ *      currently tagged).
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_ROW
+blt_table_get_row(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr)
+{
+    BLT_TABLE_ITERATOR iter;
+    BLT_TABLE_ROW first, next;
+    
+    if (blt_table_iterate_rows(interp, table, objPtr, &iter) != TCL_OK) {
+        return NULL;
+    }
+    first = blt_table_first_tagged_row(&iter);
+    if (first == NULL) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "no rows specified by \"", 
+                             Tcl_GetString(objPtr), "\"", (char *)NULL);
+        }
+        return NULL;
+    }
+    next = blt_table_next_tagged_row(&iter);
+    if (next != NULL) {
+        if (interp != NULL) {
+            const char *tag;
+            
+            blt_table_row_spec(table, objPtr, &tag);
+            Tcl_AppendResult(interp, "multiple rows specified by \"", 
+                             tag, "\"", (char *)NULL);
+        }
+        return NULL;
+    }
+    return first;
+}
+
+BLT_TABLE_ROWCOLUMN_SPEC
+blt_table_column_spec(BLT_TABLE table, Tcl_Obj *objPtr, const char **sp)
+{
+    const char *p;
+    const char *string;
+    long index;
+    char c;
+
+    string = Tcl_GetString(objPtr);
+    *sp = string;
+    c = string[0];
+    if (c == '@') {
+        *sp = string + 1;
+        return TABLE_SPEC_TAG;
+    } else if ((isdigit(c)) &&
+               (Blt_GetLongFromObj(NULL, objPtr, &index) == TCL_OK)) {
+        return TABLE_SPEC_INDEX;
+    } else if ((c == 'r') && (strncmp(string, "range:", 6) == 0)) {
+        *sp = string + 6;
+        return TABLE_SPEC_RANGE;
+    } else if ((c == 'i') && (strncmp(string, "index:", 6) == 0)) {
+        *sp = string + 6;
+        return TABLE_SPEC_INDEX;
+    } else if ((c == 'l') && (strncmp(string, "label:", 6) == 0)) {
+        *sp = string + 6;
+        return TABLE_SPEC_LABEL;
+    } else if ((c == 't') && (strncmp(string, "tag:", 4) == 0)) {
+        *sp = string + 4;
+        return TABLE_SPEC_TAG;
+    } else if (blt_table_get_column_by_label(table, string) != NULL) {
+        return TABLE_SPEC_LABEL;
+    }
+    p = strchr(string, '-');
+    if (p != NULL) {
+        Tcl_Obj *objPtr;
+        BLT_TABLE_COLUMN col;
+
+        objPtr = Tcl_NewStringObj(string, p - string);
+        Tcl_IncrRefCount(objPtr);
+        col = blt_table_get_column(NULL, table, objPtr);
+        Tcl_DecrRefCount(objPtr);
+        if (col != NULL) {
+            objPtr = Tcl_NewStringObj(p + 1, -1);
+            col = blt_table_get_column(NULL, table, objPtr);
+            Tcl_DecrRefCount(objPtr);
+            if (col != NULL) {
+                return TABLE_SPEC_RANGE;
+            }
+        }
+    }
+    return TABLE_SPEC_UNKNOWN;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_iterate_columns --
+ *
+ *      Returns the id of the first column derived from the given tag,
+ *      label or index represented in objPtr.
+ *
+ * Results:
+ *      Returns the column location of the first item.  If no column can be
+ *      found, then -1 is returned and an error message is left in the
+ *      interpreter.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_iterate_columns(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr, 
+                         BLT_TABLE_ITERATOR *iterPtr)
+{
+    const char *tag, *p;
+    int result;
+    long index;
+    BLT_TABLE_ROWCOLUMN_SPEC spec;
+    Columns *columnsPtr;
+
+    columnsPtr = blt_table_columns(table);
+    if (columnsPtr->flags & REINDEX) {
+        ResetColumnMap(columnsPtr);
+    }
+    iterPtr->table = table;
+    iterPtr->type = TABLE_ITERATOR_INDEX;
+    iterPtr->link = NULL;
+    iterPtr->numEntries = 0;
+
+    spec = blt_table_column_spec(table, objPtr, &tag);
+    switch (spec) {
+    case TABLE_SPEC_INDEX:
+        p = Tcl_GetString(objPtr);
+        if (p == tag) {
+            result = Blt_GetLongFromObj(NULL, objPtr, &index);
+        } else {
+            result = Blt_GetLong(NULL, (const char *)tag, &index);
+        }
+        if (result != TCL_OK) {
+            if (interp != NULL) {
+                Tcl_AppendResult(interp, "badly formed column index \"", 
+                        tag, "\"", (char *)NULL);
+            }
+            return TCL_ERROR;
+        }
+        if ((index < 0) || (index >= blt_table_num_columns(table))) {
+            if (interp != NULL) {
+                Tcl_AppendResult(interp, "bad column index \"", 
+                        Tcl_GetString(objPtr), "\"", (char *)NULL);
+            }
+            return TCL_ERROR;
+        }               
+        iterPtr->firstPtr = iterPtr->lastPtr = blt_table_column(table, index);
+        if (iterPtr->firstPtr != NULL) {
+            iterPtr->numEntries = 1;
+        }
+        iterPtr->tag = tag;
+        return TCL_OK;
+
+    case TABLE_SPEC_LABEL:
+        iterPtr->tablePtr = blt_table_column_get_label_table(table, tag);
+        if (iterPtr->tablePtr != NULL) {
+            iterPtr->type = TABLE_ITERATOR_LABEL;
+            iterPtr->tag = tag;
+            iterPtr->numEntries = iterPtr->tablePtr->numEntries;
+            return TCL_OK;
+        }
+        break;
+        
+    case TABLE_SPEC_TAG:
+        {
+            Blt_Chain chain;
+
+            if (strcmp(tag, "all") == 0) {
+                Column *firstPtr, *lastPtr;
+
+                iterPtr->type = TABLE_ITERATOR_ALL;
+                iterPtr->tag = tag;
+                firstPtr = blt_table_first_column(table);
+                lastPtr = blt_table_last_column(table);
+                if (firstPtr != NULL) {
+                    iterPtr->numEntries = lastPtr->index - firstPtr->index + 1;
+                }
+                iterPtr->firstPtr = firstPtr;
+                iterPtr->lastPtr = lastPtr;
+                return TCL_OK;
+            }
+            if (strcmp(tag, "end") == 0) {
+                iterPtr->tag = tag;
+                iterPtr->firstPtr = iterPtr->lastPtr = 
+                    blt_table_last_column(table);
+                if (iterPtr->firstPtr != NULL) {
+                    iterPtr->numEntries = 1;
+                }
+                return TCL_OK;
+            }
+            
+            chain = blt_table_get_tagged_columns(iterPtr->table, tag);
+            if (chain != NULL) {
+                iterPtr->link = Blt_Chain_FirstLink(chain);
+                iterPtr->type = TABLE_ITERATOR_TAG;
+                iterPtr->tag = tag;
+                iterPtr->chain = NULL;  /* Don't free column tag chain.  */
+                iterPtr->numEntries = Blt_Chain_GetLength(chain);
+                return TCL_OK;
+            }
+        }
+        break;
+
+    case TABLE_SPEC_RANGE:
+        {
+            Column *firstPtr, *lastPtr;
+            Tcl_Obj *fromObjPtr, *toObjPtr;
+            
+            p = strchr(tag, '-');
+            if (p == NULL) {
+                if (interp != NULL) {
+                    Tcl_AppendResult(interp, "bad range specification \"", tag, 
+                                     "\"", (char *)NULL);
+                }
+                return TCL_ERROR;
+            }
+            fromObjPtr = Tcl_NewStringObj(tag, p - tag);
+            firstPtr = blt_table_get_column(interp, table, fromObjPtr);
+            Tcl_DecrRefCount(fromObjPtr);
+            if (firstPtr == NULL) {
+                return TCL_ERROR;
+            }
+            toObjPtr = Tcl_NewStringObj(p + 1, -1);
+            lastPtr = blt_table_get_column(interp, table, toObjPtr);
+            Tcl_DecrRefCount(toObjPtr);
+            if (lastPtr == NULL) {
+                return TCL_ERROR;
+            }
+            iterPtr->firstPtr = firstPtr;
+            iterPtr->lastPtr = lastPtr;
+            iterPtr->type  = TABLE_ITERATOR_RANGE;
+            iterPtr->tag = tag;
+            if (firstPtr != NULL) {
+                iterPtr->numEntries = lastPtr->index - firstPtr->index + 1;
+            }
+        }
+        return TCL_OK;
+
+    default:
+        break;
+    }
+    if (interp != NULL) {
+        Tcl_AppendResult(interp, "unknown column specification \"", 
+                         tag, "\" in ", blt_table_name(table),(char *)NULL);
+    }
+    return TCL_ERROR;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_first_tagged_column --
+ *
+ *      Returns the first column based upon given iterator.
+ *
+ * Results:
+ *      Returns the column location of the first item.  If no more columns
+ *      can be found, then -1 is returned.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_COLUMN
+blt_table_first_tagged_column(BLT_TABLE_ITERATOR *iterPtr)
+{
+    switch (iterPtr->type) {
+    case TABLE_ITERATOR_TAG:
+    case TABLE_ITERATOR_CHAIN:
+        /* iterPtr->link is already set by blt_table_column_iterator */
+        if (iterPtr->link != NULL) {
+            BLT_TABLE_COLUMN col;
+
+            col = Blt_Chain_GetValue(iterPtr->link);
+            iterPtr->link = Blt_Chain_NextLink(iterPtr->link);
+            return col;
+        }
+        break;
+    case TABLE_ITERATOR_LABEL:
+        {
+            Blt_HashEntry *hPtr;
+            
+            hPtr = Blt_FirstHashEntry(iterPtr->tablePtr, &iterPtr->cursor);
+            if (hPtr == NULL) {
+                return NULL;
+            }
+            return Blt_GetHashValue(hPtr);
+        }
+        break;
+    default:
+        if (iterPtr->firstPtr != NULL) {
+            Column *colPtr;
+
+            colPtr = iterPtr->firstPtr;
+            if (colPtr == iterPtr->lastPtr) {
+                iterPtr->nextPtr = NULL;
+            } else {
+                iterPtr->nextPtr = colPtr->nextPtr;
+            }
+            return colPtr;
+        } 
+        break;
+    }
+    return NULL;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_next_tagged_column --
+ *
+ *      Returns the column location of the next column using the given
+ *      iterator.
+ *
+ * Results:
+ *      Returns the column location of the next item.  If no more columns
+ *      can be found, then -1 is returned.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_COLUMN
+blt_table_next_tagged_column(BLT_TABLE_ITERATOR *iterPtr)
+{
+    switch (iterPtr->type) {
+    case TABLE_ITERATOR_TAG:
+    case TABLE_ITERATOR_CHAIN:
+        if (iterPtr->link != NULL) {
+            BLT_TABLE_COLUMN col;
+            
+            col = Blt_Chain_GetValue(iterPtr->link);
+            iterPtr->link = Blt_Chain_NextLink(iterPtr->link);
+            return col;
+        }
+        break;
+    case TABLE_ITERATOR_LABEL:
+        {
+            Blt_HashEntry *hPtr;
+
+            hPtr = Blt_NextHashEntry(&iterPtr->cursor); 
+            if (hPtr == NULL) {
+                return NULL;
+            }
+            return Blt_GetHashValue(hPtr);
+        }
+        break;
+    default:
+        if (iterPtr->nextPtr != NULL) {
+            Column *colPtr;
+
+            colPtr = iterPtr->nextPtr;
+            if (colPtr == iterPtr->lastPtr) {
+                iterPtr->nextPtr = NULL;
+            } else {
+                iterPtr->nextPtr = colPtr->nextPtr;
+            }
+            return colPtr;
+        }       
+        break;
+    }
+    return NULL;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_get_column --
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_COLUMN
+blt_table_get_column(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr)
+{
+    BLT_TABLE_ITERATOR iter;
+    BLT_TABLE_COLUMN first, next;
+
+    if (blt_table_iterate_columns(interp, table, objPtr, &iter) != TCL_OK) {
+        return NULL;
+    }
+    first = blt_table_first_tagged_column(&iter);
+    if (first == NULL) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "no columns specified by \"", 
+                Tcl_GetString(objPtr), "\"", (char *)NULL);
+        }
+        return NULL;
+    }
+    next = blt_table_next_tagged_column(&iter);
+    if (next != NULL) {
+        if (interp != NULL) {
+            const char *tag;
+            
+            blt_table_column_spec(table, objPtr, &tag);
+            Tcl_AppendResult(interp, "multiple columns specified by \"", 
+                tag, "\"", (char *)NULL);
+        }
+        return NULL;
+    }
+    return first;
+}
+
+
+int
+blt_table_list_columns(Tcl_Interp *interp, BLT_TABLE table, int objc, 
+                       Tcl_Obj *const *objv, Blt_Chain chain)
+{
+    Blt_ChainLink link;
+    Blt_HashTable cols;
+    int i;
+
+    Blt_InitHashTableWithPool(&cols, BLT_ONE_WORD_KEYS);
+    /* Initialize the hash table with the existing entries. */
+    for (link = Blt_Chain_FirstLink(chain); link != NULL; 
+         link = Blt_Chain_NextLink(link)) {
+        int isNew;
+        BLT_TABLE_COLUMN col;
+
+        col = Blt_Chain_GetValue(link);
+        Blt_CreateHashEntry(&cols, col, &isNew);
+    }
+    /* Collect the columns into a hash table. */
+    for (i = 0; i < objc; i++) {
+        BLT_TABLE_ITERATOR iter;
+        BLT_TABLE_COLUMN col;
+
+        if (blt_table_iterate_columns(interp, table, objv[i], &iter) 
+            != TCL_OK) {
+            Blt_DeleteHashTable(&cols);
+            return TCL_ERROR;
+        }
+        for (col = blt_table_first_tagged_column(&iter); col != NULL; 
+             col = blt_table_next_tagged_column(&iter)) {
+            int isNew;
+
+            Blt_CreateHashEntry(&cols, col, &isNew);
+            if (isNew) {
+                Blt_Chain_Append(chain, col);
+            }
+        }
+    }
+    Blt_DeleteHashTable(&cols);
+    return TCL_OK;
+}
+
+int
+blt_table_list_rows(Tcl_Interp *interp, BLT_TABLE table, int objc, 
+                    Tcl_Obj *const *objv, Blt_Chain chain)
+{
+    Blt_ChainLink link;
+    Blt_HashTable rows;
+    int i;
+
+    Blt_InitHashTableWithPool(&rows, BLT_ONE_WORD_KEYS);
+    /* Initialize the hash table with the existing entries. */
+    for (link = Blt_Chain_FirstLink(chain); link != NULL; 
+         link = Blt_Chain_NextLink(link)) {
+        int isNew;
+        BLT_TABLE_ROW row;
+
+        row = Blt_Chain_GetValue(link);
+        Blt_CreateHashEntry(&rows, row, &isNew);
+    }
+    for (i = 0; i < objc; i++) {
+        BLT_TABLE_ITERATOR iter;
+        BLT_TABLE_ROW row;
+
+        if (blt_table_iterate_rows(interp, table, objv[i], &iter) != TCL_OK){
+            Blt_DeleteHashTable(&rows);
+            return TCL_ERROR;
+        }
+        /* Append the new rows onto the chain. */
+        for (row = blt_table_first_tagged_row(&iter); row != NULL; 
+             row = blt_table_next_tagged_row(&iter)) {
+            int isNew;
+
+            Blt_CreateHashEntry(&rows, row, &isNew);
+            if (isNew) {
+                Blt_Chain_Append(chain, row);
+            }
+        }
+    }
+    Blt_DeleteHashTable(&rows);
+    return TCL_OK;
+}
+
+int
+blt_table_iterate_rows_objv(Tcl_Interp *interp, BLT_TABLE table, int objc, 
+                            Tcl_Obj *const *objv, BLT_TABLE_ITERATOR *iterPtr)
+{
+    Blt_Chain chain;
+
+    chain = Blt_Chain_Create();
+    if (blt_table_list_rows(interp, table, objc, objv, chain) != TCL_OK) {
+        Blt_Chain_Destroy(chain);
+        return TCL_ERROR;
+    }
+    iterPtr->type = TABLE_ITERATOR_CHAIN;
+    iterPtr->link = Blt_Chain_FirstLink(chain);
+    /* Indicate to free created chain. */
+    iterPtr->chain = chain;
+    iterPtr->numEntries = Blt_Chain_GetLength(chain);
+    iterPtr->tag = "";
+    return TCL_OK;
+}
+
+void
+blt_table_iterate_all_rows(BLT_TABLE table, BLT_TABLE_ITERATOR *iterPtr)
+{
+    Row *firstPtr, *lastPtr;
+    Rows *rowsPtr;
+    
+    rowsPtr = blt_table_rows(table);
+    if ((rowsPtr->flags & (REINDEX|REINDEX_HOLES)) == REINDEX) {
+        ResetRowMap(rowsPtr);
+    }
+
+    iterPtr->chain = NULL;
+    iterPtr->link = NULL;
+    iterPtr->numEntries = 0;
+    iterPtr->table = table;
+    iterPtr->tag = "all";
+    iterPtr->type = TABLE_ITERATOR_ALL;
+
+    firstPtr = blt_table_first_row(table);
+    lastPtr = blt_table_last_row(table);
+    iterPtr->numEntries = rowsPtr->numUsed;
+    iterPtr->firstPtr = firstPtr;
+    iterPtr->lastPtr = lastPtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_iterate_row_tag --
+ *
+ *      Initializes an iterator over the rows having the given tag.  The
+ *      rows are visited in the order they are stored in the table, read
+ *      directly from the tag's bitmap.  The reserved tags "all" and "end"
+ *      aren't handled here.
+ *
+ * Results:
+ *      Returns TCL_OK if the tag exists, TCL_ERROR otherwise.  If the
+ *      tag doesn't exist, the iterator is left empty.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_iterate_row_tag(BLT_TABLE table, const char *tag, 
+                          BLT_TABLE_ITERATOR *iterPtr)
+{
+    Blt_HashEntry *hPtr;
+    TagSet *setPtr;
+
+    memset(iterPtr, 0, sizeof(BLT_TABLE_ITERATOR));
+    iterPtr->table = table;
+    iterPtr->type = TABLE_ITERATOR_INDEX;
+    hPtr = Blt_FindHashEntry(table->rowTags, tag);
+    if (hPtr == NULL) {
+        return TCL_ERROR;
+    }
+    setPtr = Blt_GetHashValue(hPtr);
+    iterPtr->type = TABLE_ITERATOR_TAG;
+    iterPtr->tag = tag;
+    iterPtr->tagSetPtr = setPtr;
+    iterPtr->nextOffset = 0;
+    iterPtr->numEntries = setPtr->numMembers;
+    return TCL_OK;
+}
+
+int
+blt_table_iterate_columns_objv(Tcl_Interp *interp, BLT_TABLE table, int objc, 
+                               Tcl_Obj *const *objv,
+                               BLT_TABLE_ITERATOR *iterPtr)
+{
+    Blt_Chain chain;
+
+    chain = Blt_Chain_Create();
+    if (blt_table_list_columns(interp, table, objc, objv, chain) != TCL_OK) {
+        Blt_Chain_Destroy(chain);
+        return TCL_ERROR;
+    }
+    iterPtr->table = table;
+    iterPtr->type = TABLE_ITERATOR_CHAIN;
+    iterPtr->link = Blt_Chain_FirstLink(chain);    
+    /* Indicate to free created chain. */
+    iterPtr->chain = chain;
+    iterPtr->numEntries = Blt_Chain_GetLength(chain);
+    iterPtr->tag = "";
+    return TCL_OK;
+}
+
+void
+blt_table_iterate_all_columns(BLT_TABLE table, BLT_TABLE_ITERATOR *iterPtr)
+{
+    Column *firstPtr, *lastPtr;
+    Columns *columnsPtr;
+
+    columnsPtr = blt_table_columns(table);
+    if (columnsPtr->flags & REINDEX) { 
+        ResetColumnMap(columnsPtr);
+    }
+
+    iterPtr->chain = NULL;
+    iterPtr->link = NULL;
+    iterPtr->numEntries = 0;
+    iterPtr->table = table;
+    iterPtr->tag = "all";
+    iterPtr->type = TABLE_ITERATOR_ALL;
+
+    firstPtr = blt_table_first_column(table);
+    lastPtr = blt_table_last_column(table);
+    if (firstPtr != NULL) {
+        iterPtr->numEntries = lastPtr->index - firstPtr->index + 1;
+    } 
+    iterPtr->firstPtr = firstPtr;
+    iterPtr->lastPtr = lastPtr;
+}
+
+void
+blt_table_free_iterator_objv(BLT_TABLE_ITERATOR *iterPtr)
+{
+    if ((iterPtr->type == TABLE_ITERATOR_CHAIN) && (iterPtr->chain != NULL)) {
+        Blt_Chain_Destroy(iterPtr->chain);
+        iterPtr->chain = NULL;
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FreeTrace --
+ *
+ *      Memory is deallocated for the trace.
+ *
+ * Results:
+ *      None.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+FreeTrace(Trace *tracePtr)
+{
+    if (tracePtr->rowTag != NULL) {
+        Blt_Free(tracePtr->rowTag);
+    }
+    if (tracePtr->colTag != NULL) {
+        Blt_Free(tracePtr->colTag);
+    }
+    Blt_Free(tracePtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_delete_trace --
+ *
+ *      Deletes a trace.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      Memory is deallocated for the trace.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_delete_trace(Table *tablePtr, Trace *tracePtr)
+{
+    Blt_HashEntry *hPtr;
+
+    hPtr = Blt_FindHashEntry(&tablePtr->traces, tracePtr);
+    if (hPtr == NULL) {
+        return;                         /* Invalid trace token. */
+    }
+    Blt_DeleteHashEntry(&tablePtr->traces, hPtr);
+    if ((tracePtr->flags & TABLE_TRACE_DESTROYED) == 0) {
+        if (tracePtr->deleteProc != NULL) {
+            (*tracePtr->deleteProc)(tracePtr->clientData);
+        }
+        if (tracePtr->flags & TABLE_TRACE_PENDING) {
+            Tcl_CancelIdleCall(TraceIdleProc, tracePtr);
+        }
+        /* 
+         * This accomplishes two things.  
+         * 1) It doesn't let it anything match the trace and 
+         * 2) marks the trace as invalid. 
+         */
+        /* Take it out of the list so you can't use it anymore. */
+        if (tracePtr->readLink != NULL) {
+            Blt_Chain_DeleteLink(tablePtr->readTraces, tracePtr->readLink);
+            tracePtr->readLink = NULL;
+        }
+        if (tracePtr->writeLink != NULL) {
+            Blt_Chain_DeleteLink(tablePtr->writeTraces, tracePtr->writeLink);
+            tracePtr->writeLink = NULL;
+        }
+        tracePtr->flags = TABLE_TRACE_DESTROYED;        
+        Tcl_EventuallyFree(tracePtr, (Tcl_FreeProc *)FreeTrace);
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_begin_batch --
+ *
+ *      Opens a batch of updates.  Until the batch is ended, writes,
+ *      creates, and unsets of cells don't fire traces.  Only the rows and
+ *      columns changed are recorded.  Batches may be nested: the events
+ *      are delivered when the outermost batch ends.
+ *
+ *      Traces created with the TABLE_TRACE_EACH_CELL flag are still fired
+ *      for every cell.  Notifications that rows or columns were moved are
+ *      held until the batch ends.  Other notifications are delivered
+ *      immediately since clients need each created or deleted row and
+ *      column.
+ *
+ * Results:
+ *      None.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_begin_batch(Table *tablePtr)
+{
+    TableObject *corePtr;
+    TableBatch *batchPtr;
+
+    corePtr = tablePtr->corePtr;
+    batchPtr = corePtr->batchPtr;
+    if ((batchPtr == NULL) || (batchPtr->depth == 0)) {
+        /* Either there's no batch or the current one is being flushed.
+         * Start a new one. */
+        batchPtr = NewBatch();
+        batchPtr->nextPtr = corePtr->batchPtr;
+        corePtr->batchPtr = batchPtr;
+    }
+    batchPtr->depth++;
+    tablePtr->batchDepth++;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_end_batch --
+ *
+ *      Ends a batch of updates opened by blt_table_begin_batch.  If this
+ *      is the outermost batch, the traces of each client matching the
+ *      recorded changes are fired once.  The trace event holds the first
+ *      and last changed rows and columns.  Any move notifications held
+ *      are then delivered.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      Traces and notifiers may be fired.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_end_batch(Table *tablePtr)
+{
+    TableObject *corePtr;
+    TableBatch *batchPtr;
+
+    corePtr = tablePtr->corePtr;
+    batchPtr = corePtr->batchPtr;
+    if ((batchPtr == NULL) || (batchPtr->depth == 0) || 
+        (tablePtr->batchDepth == 0)) {
+        return;                         /* No batch opened by client. */
+    }
+    tablePtr->batchDepth--;
+    batchPtr->depth--;
+    if (batchPtr->depth > 0) {
+        return;
+    }
+    /* The batch stays on the stack while it's flushed, so that rows and
+     * columns deleted by trace procedures are marked. */
+    if (batchPtr->flags != 0) {
+        Blt_ChainLink link, next;
+
+        for (link = Blt_Chain_FirstLink(corePtr->clients); link != NULL; 
+             link = next) {
+            next = Blt_Chain_NextLink(link);
+            CallBatchTraces(tablePtr, Blt_Chain_GetValue(link), batchPtr);
+        }
+    }
+    if (corePtr->batchPtr == batchPtr) {
+        corePtr->batchPtr = batchPtr->nextPtr;
+    } else {
+        TableBatch *prevPtr;
+
+        /* A trace procedure opened a batch and left it open. */
+        for (prevPtr = corePtr->batchPtr; prevPtr->nextPtr != batchPtr;
+             prevPtr = prevPtr->nextPtr) {
+            /* empty */
+        }
+        prevPtr->nextPtr = batchPtr->nextPtr;
+    }
+    if (batchPtr->rowNotifyFlags != 0) {
+        NotifyRowChanged(tablePtr, NULL, batchPtr->rowNotifyFlags);
+    }
+    if (batchPtr->colNotifyFlags != 0) {
+        NotifyColumnChanged(tablePtr, NULL, batchPtr->colNotifyFlags);
+    }
+    FreeBatch(batchPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_create_trace --
+ *
+ *      Creates a trace for one or more rows/columns in the table based
+ *      upon the given criteria.  Whenever a matching action occurs in the
+ *      table object, the specified procedure is executed.
+ *
+ *      The trace may be put into 1 or 2 callback lists: one for read
+ *      traces and another for write, create, and/or unset traces.  This is
+ *      done to improve performance on reads.  We only examine the list of
+ *      read traces, which in most cases will me empty.
+ *
+ * Results:
+ *      Returns a token for the trace.
+ *
+ * Side Effects:
+ *      Memory is allocated for the trace.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_TRACE
+blt_table_create_trace(
+    Table *tablePtr,                    /* Table to be traced. */
+    Row *rowPtr, 
+    Column *colPtr,                     /* Row/column in table. */
+    const char *rowTag, 
+    const char *colTag,
+    unsigned int flags,                 /* Bit mask indicating what actions
+                                         * to trace. */
+    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
+                                         * trace. */
+    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
+    ClientData clientData)              /* One-word of data passed along
+                                         * when the callback is
+                                         * executed. */
+{
+    Blt_HashEntry *hPtr;
+    Trace *tracePtr;
+    int isNew;
+
+    tracePtr = Blt_Calloc(1, sizeof (Trace));
+    if (tracePtr == NULL) {
+        return NULL;
+    }
+    tracePtr->row = rowPtr;
+    tracePtr->column = colPtr;
+    if (rowTag != NULL) {
+        tracePtr->rowTag = Blt_AssertStrdup(rowTag);
+    }
+    if (colTag != NULL) {
+        tracePtr->colTag = Blt_AssertStrdup(colTag);
+    }
+    tracePtr->flags = flags;
+    tracePtr->proc = proc;
+    tracePtr->deleteProc = deleteProc;
+    tracePtr->clientData = clientData;
+    if (tracePtr->flags & TABLE_TRACE_READS) {
+        tracePtr->readLink = Blt_Chain_Append(tablePtr->readTraces, tracePtr);
+    }
+    if (tracePtr->flags & 
+        (TABLE_TRACE_WRITES | TABLE_TRACE_UNSETS | TABLE_TRACE_CREATES)) {
+        tracePtr->writeLink = Blt_Chain_Append(tablePtr->writeTraces, tracePtr);
+    }
+    hPtr = Blt_CreateHashEntry(&tablePtr->traces, tracePtr, &isNew);
+    Tcl_SetHashValue(hPtr, tracePtr);
+    assert(isNew);
+    tracePtr->table = tablePtr;
+    return tracePtr;
+}
+
+void
+blt_table_trace_column(
+    Table *tablePtr,                    /* Table to be traced. */
+    Column *colPtr,                     /* Cell in table. */
+    unsigned int flags,                 /* Bit mask indicating what actions
+                                         * to trace. */
+    BLT_TABLE_TRACE_PROC *proc,        /* Callback procedure for the
+                                        * trace. */
+    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
+    ClientData clientData)              /* One-word of data passed along
+                                         * when the callback is
+                                         * executed. */
+{
+    blt_table_create_trace(tablePtr, NULL, colPtr, NULL, NULL, flags,
+                           proc, deleteProc, clientData);
+}
+
+BLT_TABLE_TRACE
+blt_table_create_column_trace(
+    Table *tablePtr,                    /* Table to be traced. */
+    Column *colPtr,                     /* Cell in table. */
+    unsigned int flags,                 /* Bit mask indicating what actions
+                                         * to trace. */
+    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
+                                         * trace. */
+    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
+    ClientData clientData)              /* One-word of data passed along
+                                         * when the callback is
+                                         * executed. */
+{
+    return blt_table_create_trace(tablePtr, NULL, colPtr, NULL, NULL, flags,
+                proc, deleteProc, clientData);
+}
+
+BLT_TABLE_TRACE
+blt_table_create_column_tag_trace(
+    Table *tablePtr,                    /* Table to be traced. */
+    const char *colTag,                 /* Cell in table. */
+    unsigned int flags,                 /* Bit mask indicating what actions
+                                         * to trace. */
+    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
+                                         * trace. */
+    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
+    ClientData clientData)              /* One-word of data passed along
+                                         * when the callback is
+                                         * executed. */
+{
+    return blt_table_create_trace(tablePtr, NULL, NULL, NULL, colTag, flags,
+                proc, deleteProc, clientData);
+}
+
+void
+blt_table_trace_row(
+    Table *tablePtr,                    /* Table to be traced. */
+    Row *rowPtr,                        /* Cell in table. */
+    unsigned int flags,                 /* Bit mask indicating what actions
+                                         * to trace. */
+    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
+                                         * trace. */
+    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
+    ClientData clientData)              /* One-word of data passed along
+                                         * when the callback is
+                                         * executed. */
+{
+    blt_table_create_trace(tablePtr, 
+        rowPtr,                         /* Row */
+        (BLT_TABLE_COLUMN)NULL,         /* Column */
+        (const char *)NULL,             /* Row tag. */
+        (const char *)NULL,             /* Column tag. */
+        flags,                          /* Flags. */
+        proc,                           /* Callback procedure. */
+        deleteProc,                     /* Delete callback procedure. */
+        clientData);                    /* Data passed to callbacks. */
+}
+
+BLT_TABLE_TRACE
+blt_table_create_row_trace(
+    Table *tablePtr,                    /* Table to be traced. */
+    Row *rowPtr,                        /* Cell in table. */
+    unsigned int flags,                 /* Bit mask indicating what actions
+                                         * to trace. */
+    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
+                                         * trace. */
+    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
+    ClientData clientData)              /* One-word of data passed along
+                                         * when the callback is
+                                         * executed. */
+{
+    return blt_table_create_trace(tablePtr, 
+        rowPtr, 
+        (Column *)NULL, 
+        (const char *)NULL, 
+        (const char *)NULL, 
+        flags,
+        proc, 
+        deleteProc, 
+        clientData);
+}
+
+BLT_TABLE_TRACE
+blt_table_create_row_tag_trace(
+    Table *tablePtr,                    /* Table to be traced. */
+    const char *rowTag,                 /* Cell in table. */
+    unsigned int flags,                 /* Bit mask indicating what actions
+                                         * to trace. */
+    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
+                                         * trace. */
+    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
+    ClientData clientData)              /* One-word of data passed along
+                                         * when the callback is
+                                         * executed. */
+{
+    return blt_table_create_trace(tablePtr, NULL, NULL, rowTag, NULL, flags,
+                proc, deleteProc, clientData);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_release_tags --
+ *
+ *      Releases the tag table used by this client.  
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      If no client is using the table, then it is freed.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_release_tags(Table *tablePtr)
+{
+    Tags *tagsPtr;
+
+    tagsPtr = tablePtr->tags;
+    tagsPtr->refCount--;
+    if (tagsPtr->refCount <= 0) {
+        ResetRowTags(&tagsPtr->rowTags);
+        tablePtr->rowTags = NULL;
+        Blt_Tags_Reset(&tagsPtr->columnTags);
+        tablePtr->columnTags = NULL;
+        Blt_Free(tagsPtr);
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_tags_are_shared --
+ *
+ *      Returns whether the tag table is shared with another client.
+ *
+ * Results:
+ *      Returns TRUE if the current tag table is shared with another
+ *      client, FALSE otherwise.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_tags_are_shared(Table *tablePtr)
+{
+    return (tablePtr->tags->refCount > 1);
+}   
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_new_tags --
+ *
+ *      Releases the old tag table (if it exists) and creates a new empty
+ *      tag table.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      Possible frees memory for the old tag table (if no one else is
+ *      using it) and resets the pointers to the new tag tables.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_new_tags(Table *tablePtr)
+{
+    if (tablePtr->tags != NULL) {
+        blt_table_release_tags(tablePtr);
+    }
+    tablePtr->tags = NewTags();
+    tablePtr->rowTags = &tablePtr->tags->rowTags;
+    tablePtr->columnTags = &tablePtr->tags->columnTags;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_forget_row_tag --
+ *
+ *      Removes a tag from the row tag table.  Row tags are bitmaps of row
+ *      offsets contained in a hash table keyed by the tag name.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      The bitmap of the tag is freed.
+ *      
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_forget_row_tag(Tcl_Interp *interp, Table *tablePtr, const char *tag)
+{
+    Blt_HashEntry *hPtr;
+
+    if ((strcmp(tag, "all") == 0) || (strcmp(tag, "end") == 0)) {
+        return TCL_OK;                  /* Can't forget reserved tags. */
+    }
+    hPtr = Blt_FindHashEntry(tablePtr->rowTags, tag);
+    if (hPtr != NULL) {
+        FreeTagSet(Blt_GetHashValue(hPtr));
+        Blt_DeleteHashEntry(tablePtr->rowTags, hPtr);
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_forget_column_tag --
+ *
+ *      Removes a tag from the column tag table.  Column tags are contained
+ *      in hash tables keyed by the tag name.  Each table is in turn hashed
+ *      by the column offset in the column tag table.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      Entries for the given tag in the corresponding column in hash tables
+ *      may be removed.
+ *      
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_forget_column_tag(Tcl_Interp *interp, Table *tablePtr, 
+                            const char *tag)
+{
+    if ((strcmp(tag, "all") == 0) || (strcmp(tag, "end") == 0)) {
+        return TCL_OK;                  /* Can't forget reserved tags. */
+    }
+    Blt_Tags_ForgetTag(tablePtr->columnTags, tag);
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_row_tag --
+ *
+ *      Associates a tag with a given row.  Individual row tags are stored
+ *      as bitmaps of row offsets in a hash table keyed by the tag name.
+ *      If the row is NULL, this indicates to simply create the tag entry.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      A tag is stored for a particular row.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_set_row_tag(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr, 
+                    const char *tag)
+{
+    Blt_HashEntry *hPtr;
+    TagSet *setPtr;
+    char c;
+    int isNew;
+    long dummy;
+    
+    c = tag[0];
+    if (((c == 'a') && (strcmp(tag, "all") == 0)) ||
+        ((c == 'e') && (strcmp(tag, "end") == 0))) {
+        return TCL_OK;          /* Don't need to create reserved tags. */
+    }
+    if (c == '\0') {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "tag \"", tag, "\" can't be empty.", 
+                (char *)NULL);
+        }
+        return TCL_ERROR;
+    }
+    if (c == '-') {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "tag \"", tag, 
+                "\" can't start with a '-'.", (char *)NULL);
+        }
+        return TCL_ERROR;
+    }
+    if ((isdigit(c)) && Blt_GetLong(NULL, (char *)tag, &dummy) == TCL_OK) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "tag \"", tag, "\" can't be a number.",
+                             (char *)NULL);
+        }
+        return TCL_ERROR;
+    }
+    hPtr = Blt_CreateHashEntry(tablePtr->rowTags, tag, &isNew);
+    if (isNew) {
+        setPtr = NewTagSet();
+        Blt_SetHashValue(hPtr, setPtr);
+    } else {
+        setPtr = Blt_GetHashValue(hPtr);
+    }
+    if (rowPtr != NULL) {
+        TagSetAdd(setPtr, rowPtr->offset);
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_column_tag --
+ *
+ *      Associates a tag with a given column.  Individual column tags are
+ *      stored in hash tables keyed by the tag name.  Each table is in turn
+ *      stored in a hash table keyed by the column location.  If the column
+ *      is NULL, then this means to simply create the tag.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      A tag is stored for a particular column.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_set_column_tag(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
+                         const char *tag)
+{
+    long dummy;
+    char c;
+
+    c = tag[0];
+    if (((c == 'a') && (strcmp(tag, "all") == 0)) ||
+        ((c == 'e') && (strcmp(tag, "end") == 0))) {
+        return TCL_OK;                  /* Don't create reserved tags. */
+    }
+    if (c == '\0') {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "tag \"", tag, "\" can't be empty.", 
+                             (char *)NULL);
+        }
+        return TCL_ERROR;
+    }
+    if (c == '-') {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "tag \"", tag, 
+                "\" can't start with a '-'.", (char *)NULL);
+        }
+        return TCL_ERROR;
+    }
+    if ((isdigit(c)) &&(Blt_GetLong(NULL, (const char *)tag, &dummy)==TCL_OK)) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "tag \"", tag, "\" can't be a number.",
+                             (char *)NULL);
+        }
+        return TCL_ERROR;
+    }
+    if (colPtr == NULL) {
+        Blt_Tags_AddTag(tablePtr->columnTags, tag);
+    } else {
+        Blt_Tags_AddItemToTag(tablePtr->columnTags, tag, colPtr);
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_row_has_tag --
+ *
+ *      Checks if a tag is associated with the given row.  
+ *
+ * Results:
+ *      Returns TRUE if the tag is found, FALSE otherwise.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_row_has_tag(Table *tablePtr, Row *rowPtr, const char *tag)
+{
+    Blt_HashEntry *hPtr;
+    char c;
+
+    c = tag[0];
+    if ((c == 'a') && (strcmp(tag, "all") == 0)) {
+        return TRUE;            /* "all" tags matches every row. */
+    }
+    if ((c == 'e') && (strcmp(tag, "end") == 0)) {
+        return (blt_table_row_index(tablePtr, rowPtr)==
+                (blt_table_num_rows(tablePtr)-1));
+    }
+    hPtr = Blt_FindHashEntry(tablePtr->rowTags, tag);
+    if (hPtr == NULL) {
+        return FALSE;
+    }
+    return TagSetContains(Blt_GetHashValue(hPtr), rowPtr->offset);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_column_has_tag --
+ *
+ *      Checks if a tag is associated with the given column.  
+ *
+ * Results:
+ *      Returns TRUE if the tag is found, FALSE otherwise.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_column_has_tag(Table *tablePtr, Column *colPtr, const char *tag)
+{
+    char c;
+
+    c = tag[0];
+    if ((c == 'a') && (strcmp(tag, "all") == 0)) {
+        return TRUE;                    /* "all" tags matches every column. */
+    }
+    if ((c == 'e') && (strcmp(tag, "end") == 0)) {
+        return (colPtr == (Column *)tablePtr->corePtr->columns.tailPtr);
+    }
+    return Blt_Tags_ItemHasTag(tablePtr->columnTags, colPtr, tag);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_unset_row_tag --
+ *
+ *      Removes a tag from a given row.  
+ *
+ * Results:
+ *      A standard TCL result.  If an error occurred, TCL_ERROR is returned
+ *      and the interpreter result contains the error message.
+ *
+ * Side Effects:
+ *      The tag associated with the row is freed.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_unset_row_tag(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr, 
+                        const char *tag)
+{
+    Blt_HashEntry *hPtr;
+    char c;
+
+    c = tag[0];
+    if (((c == 'a') && (strcmp(tag, "all") == 0)) ||
+        ((c == 'e') && (strcmp(tag, "end") == 0))) {
+        return TCL_OK;                  /* Can't remove reserved tags. */
+    } 
+    hPtr = Blt_FindHashEntry(tablePtr->rowTags, tag);
+    if (hPtr != NULL) {
+        TagSetRemove(Blt_GetHashValue(hPtr), rowPtr->offset);
+    }
+    return TCL_OK;
+}    
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_unset_column_tag --
+ *
+ *      Removes a tag from a given column.  
+ *
+ * Results:
+ *      A standard TCL result.  If an error occurred, TCL_ERROR
+ *      is returned and the interpreter result contains the error
+ *      message.
+ *
+ * Side Effects:
+ *      The tag associated with the column is freed.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_unset_column_tag(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
+                         const char *tag)
+{
+    char c;
+
+    c = tag[0];
+    if (((c == 'a') && (strcmp(tag, "all") == 0)) ||
+        ((c == 'e') && (strcmp(tag, "end") == 0))) {
+        return TCL_OK;                  /* Can't remove reserved tags. */
+    } 
+    Blt_Tags_RemoveItemFromTag(tablePtr->columnTags, tag, colPtr);
+    return TCL_OK;
+}    
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_clear_row_tags --
+ *
+ *      Removes all tags for a given row.  
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      All tags associated with the row are freed.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_clear_row_tags(Table *tablePtr, Row *rowPtr)
+{
+    Blt_HashEntry *hPtr;
+    Blt_HashSearch iter;
+
+    for (hPtr = Blt_FirstHashEntry(tablePtr->rowTags, &iter); hPtr != NULL;
+         hPtr = Blt_NextHashEntry(&iter)) {
+        TagSetRemove(Blt_GetHashValue(hPtr), rowPtr->offset);
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_clear_column_tags --
+ *
+ *      Removes all tags for a given column.  
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      All tags associated with the column are freed.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_clear_column_tags(Table *tablePtr, Column *colPtr)
+{
+    Blt_Tags_ClearTagsFromItem(tablePtr->columnTags, colPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_get_value --
+ *
+ *      Gets a scalar Tcl_Obj value from the table at the designated
+ *      row, column location.  "Read" traces may be fired *before* the
+ *      value is retrieved.  If no value exists at that location,
+ *      *objPtrPtr is set to NULL.
+ *
+ * Results:
+ *      A standard TCL result.  Returns TCL_OK if successful accessing
+ *      the table location.  If an error occurs, TCL_ERROR is returned
+ *      and an error message is left in the interpreter.
+ *
+ * -------------------------------------------------------------------------- 
+ */
+BLT_TABLE_VALUE
+blt_table_get_value(Table *tablePtr, Row *rowPtr, Column *colPtr)
+{
+    Value *valuePtr;
+
+    if ((!IsDenseColumn(colPtr)) && (colPtr->dictPtr == NULL)) {
+        return GetValue(tablePtr, rowPtr, colPtr);
+    }
+    /* 
+     * Numeric and dictionary encoded columns don't store Value
+     * structures.  Load the value into the column's scratch value.  It's
+     * good until the next call for the same column.
+     */
+    valuePtr = &colPtr->scratch;
+    memset(valuePtr, 0, sizeof(Value));
+    if (colPtr->dictPtr != NULL) {
+        valuePtr->string = (char *)GetStoredString(rowPtr, colPtr, 
+                &valuePtr->length);
+    } else if (!IsEmpty(rowPtr, colPtr)) {
+        GetDenseDatum(colPtr, rowPtr->offset, valuePtr);
+        valuePtr->string = GetDenseString(tablePtr, colPtr, rowPtr->offset);
+        valuePtr->length = strlen(valuePtr->string);
+    }
+    return valuePtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_value --
+ *
+ *      Sets a scalar Tcl_Obj value in the table at the designated row and
+ *      column.  "Write" and possibly "create" or "unset" traces may be fired
+ *      *after* the value is set.  If valuePtr is NULL, this indicates to
+ *      unset the old value.
+ *
+ * Results:
+ *      A standard TCL result.  Returns TCL_OK if successful setting the value
+ *      at the table location.  If an error occurs, TCL_ERROR is returned and
+ *      an error message is left in the interpreter.
+ *
+ * -------------------------------------------------------------------------- 
+ */
+int
+blt_table_set_value(Table *tablePtr, Row *rowPtr, Column *colPtr, Value *newPtr)
+{
+    Value value;
+    int flags;
+
+    if ((IsDenseColumn(colPtr)) && (newPtr == &colPtr->scratch) &&
+        (!IsEmptyValue(newPtr)) && (colPtr->strings != NULL) &&
+        (newPtr->string == colPtr->strings[rowPtr->offset])) {
+        return TCL_OK;                  /* Value is from the same cell. */
+    }
+    if (colPtr->dictPtr != NULL) {
+        if ((newPtr == &colPtr->scratch) && (!IsEmptyValue(newPtr)) &&
+            (newPtr->string == colPtr->dictPtr->strings[
+                GetCode(colPtr, rowPtr->offset)])) {
+            return TCL_OK;
+        }
+    } else if ((!IsDenseColumn(colPtr)) && 
+        (newPtr == GetValue(tablePtr, rowPtr, colPtr))) {
+        return TCL_OK;
+    }
+    flags = TABLE_TRACE_WRITES;
+    if (IsEmptyValue(newPtr)) {         /* New value is empty. This is the
+                                         * same as unsetting the value. */
+        flags |= TABLE_TRACE_UNSETS;
+    } else if (IsEmpty(rowPtr, colPtr)) {
+        flags |= TABLE_TRACE_CREATES;   /* Old value was empty. */
+    } 
+    if (IsEmptyValue(newPtr)) {
+        UnsetValue(tablePtr, rowPtr, colPtr);
+    } else {
+        value = *newPtr;                /* Copy the value. */
+        if (newPtr->string != TABLE_VALUE_STORE) {
+            value.string = Blt_AssertStrdup(newPtr->string);
+        }
+        if (PutValue(tablePtr->interp, tablePtr, rowPtr, colPtr, &value) 
+            != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+    CallTraces(tablePtr, rowPtr, colPtr, flags);
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_get_obj --
+ *
+ *      Gets a scalar Tcl_Obj value from the table at the designated row,
+ *      column location.  "Read" traces may be fired *before* the value is
+ *      retrieved.  If no value exists at that location, the return value
+ *      is NULL.
+ *
+ * Results:
+ *      A standard TCL result.  Returns TCL_OK if successful accessing the
+ *      table location.  If an error occurs, TCL_ERROR is returned.
+ *
+ * -------------------------------------------------------------------------- 
+ */
+Tcl_Obj *
+blt_table_get_obj(Table *tablePtr, Row *rowPtr, Column *colPtr)
+{
+    CallTraces(tablePtr, rowPtr, colPtr, TABLE_TRACE_READS);
+    if (IsEmpty(rowPtr, colPtr)) {
+        return NULL;
+    }
+    return GetObjFromCell(tablePtr, rowPtr, colPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_obj --
+ *
+ *      Sets a scalar Tcl_Obj value in the table at the designated row and
+ *      column.  "Write" and possibly "create" or "unset" traces may be fired
+ *      *after* the value is set.  If valueObjPtr is NULL, this indicates to
+ *      unset the old value.
+ *
+ * Results:
+ *      A standard TCL result.  Returns TCL_OK if successful setting the value
+ *      at the table location.  If an error occurs, TCL_ERROR is returned and
+ *      an error message is left in the interpreter.
+ *
+ * -------------------------------------------------------------------------- 
+ */
+int
+blt_table_set_obj(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
+                  Column *colPtr, Tcl_Obj *objPtr)
+{
+    unsigned int flags;
+
+    flags = TABLE_TRACE_WRITES;
+    if (objPtr == NULL) {               /* New value is empty. This is the 
+                                         * same as unsetting the value. */
+        flags |= TABLE_TRACE_UNSETS;
+    } else {
+        Value value;
+
+        if (IsEmpty(rowPtr, colPtr)) {
+            flags |= TABLE_TRACE_CREATES;
+        } 
+        memset(&value, 0, sizeof(Value));
+        if ((SetValueFromObj(interp, colPtr, colPtr->type, objPtr, &value) 
+             != TCL_OK) || 
+            (PutValue(interp, tablePtr, rowPtr, colPtr, &value) != TCL_OK)) {
+            return TCL_ERROR;
+        }
+    }
+    CallTraces(tablePtr, rowPtr, colPtr, flags);
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_unset_value --
+ *
+ *      Unsets a scalar Tcl_Obj value in the table at the designated row,
+ *      column location.  It's okay is there is presently no value at the
+ *      location. Unset traces may be fired *before* the value is unset.
+ *
+ * Results:
+ *      A standard TCL result.  Returns TCL_OK if successful unsetting the
+ *      value at the table location.  If an error occurs, TCL_ERROR is
+ *      returned and an error message is left in the interpreter.
+ *
+ * -------------------------------------------------------------------------- 
+ */
+int
+blt_table_unset_value(Table *tablePtr, Row *rowPtr, Column *colPtr)
+{
+    if (!IsEmpty(rowPtr, colPtr)) {
+        CallTraces(tablePtr, rowPtr, colPtr, TABLE_TRACE_UNSETS);
+        UnsetValue(tablePtr, rowPtr, colPtr);
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_create --
+ *
+ *      Creates a table object by the designated name.  It's an error if a
+ *      table object already exists by that name.
+ *
+ * Results:
+ *      A standard TCL result.  If successful, a new table object is created
+ *      and TCL_OK is returned.  If an object already exists or the table
+ *      object can't be allocated, then TCL_ERROR is returned and an error
+ *      message is left in the interpreter.
+ *
+ * Side Effects:
+ *      A new table object is created.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_create(
+    Tcl_Interp *interp,                 /* Interpreter to report errors back
+                                         * to. */
+    const char *name,                   /* Name of tuple in namespace.  Object
+                                         * must not already exist. */
+    Table **tablePtrPtr)                /* (out) Client token of newly created
+                                         * table object.  Releasing the token
+                                         * will free the tuple.  If NULL, no
+                                         * token is generated. */
+{
+    InterpData *dataPtr;
+    TableObject *corePtr;
+    Blt_ObjectName objName;
+    Table *newClientPtr;
+    Tcl_DString ds;
+    const char *qualName;
+    char string[200];
+
+    dataPtr = GetInterpData(interp);
+    if (name != NULL) {
+        /* Check if a client by this name already exist in the current
+         * namespace. */
+        if (GetTable(dataPtr, name, NS_SEARCH_CURRENT) != NULL) {
+            Tcl_AppendResult(interp, "a table object \"", name,
+                "\" already exists", (char *)NULL);
+            return TCL_ERROR;
+        }
+    } else {
+        /* Generate a unique name in the current namespace. */
+        do  {
+            Blt_FmtString(string, 200, "datatable%d", dataPtr->nextId++);
+        } while (GetTable(dataPtr, name, NS_SEARCH_CURRENT) != NULL);
+        name = string;
+    } 
+    /* 
+     * Tear apart and put back together the namespace-qualified name of the
+     * object.  This is to ensure that naming is consistent.
+     */ 
+    if (!Blt_ParseObjectName(interp, name, &objName, 0)) {
+        return TCL_ERROR;
+    }
+    corePtr = NewTableObject();
+    if (corePtr == NULL) {
+        Tcl_AppendResult(interp, "can't allocate table object.", (char *)NULL);
+        Tcl_DStringFree(&ds);
+        return TCL_ERROR;
+    }
+    qualName = Blt_MakeQualifiedName(&objName, &ds);
+    newClientPtr = NewTable(dataPtr, corePtr, qualName);
+    Tcl_DStringFree(&ds);
+    if (newClientPtr == NULL) {
+        Tcl_AppendResult(interp, "can't allocate table token", (char *)NULL);
+        return TCL_ERROR;
+    }
+    
+    if (tablePtrPtr != NULL) {
+        *tablePtrPtr = newClientPtr;
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_open --
+ *
+ *      Allocates a token for the table object designated by name.  It's an
+ *      error if no table object exists by that name.  The token returned is
+ *      passed to various routines to manipulate the object.  Traces and event
+ *      notifications are also made through the token.
+ *
+ * Results:
+ *      A new token is returned representing the table object.  
+ *
+ * Side Effects:
+ *      If this is the remaining client, then the table object itself is
+ *      freed.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_open(
+    Tcl_Interp *interp,                 /* Interpreter to report errors back
+                                         * to. */
+    const char *name,                   /* Name of table object in
+                                         * namespace. */
+    Table **tablePtrPtr)
+{
+    Table *tablePtr, *newClientPtr;
+    InterpData *dataPtr;
+
+    dataPtr = GetInterpData(interp);
+    tablePtr = GetTable(dataPtr, name, NS_SEARCH_BOTH);
+    if ((tablePtr == NULL) || (tablePtr->corePtr == NULL)) {
+        Tcl_AppendResult(interp, "can't find a table object \"", name, "\"", 
+                (char *)NULL);
+        return TCL_ERROR;
+    }
+    newClientPtr = NewTable(dataPtr, tablePtr->corePtr, name);
+    if (newClientPtr == NULL) {
+        Tcl_AppendResult(interp, "can't allocate token for table \"", name, 
+                "\"", (char *)NULL);
+        return TCL_ERROR;
+    }
+    /* By default, share tags with an existing table. Clients can can
+     * blt_table_new_tags to get a new tags table. */
+    ShareTags(tablePtr, newClientPtr);
+    *tablePtrPtr = newClientPtr;
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_close --
+ *
+ *      Releases the tuple token, indicating this the client is no longer
+ *      using the object. The client is removed from the tuple object's client
+ *      list.  If this is the last client, then the object itself is destroyed
+ *      and memory is freed.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      If this is the remaining client, then the table object itself
+ *      is freed.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_close(Table *tablePtr)
+{
+    if (tablePtr->magic != TABLE_MAGIC) {
+        Blt_Warn("invalid table object token %p\n", tablePtr);
+        return;
+    }
+    if (tablePtr->link2 != NULL) {
+        Blt_Chain chain;
+
+        /* Remove the client from the list of clients using the table name.
+         * This is different from the table core. */
+        chain = Blt_GetHashValue(tablePtr->hPtr);
+        Blt_Chain_DeleteLink(chain, tablePtr->link2);
+        if (Blt_Chain_GetLength(chain) == 0) {
+            /* If no more clients are using this name, then remove it from the
+             * interpreter-specific hash table. */      
+            Blt_DeleteHashEntry(tablePtr->clientTablePtr, tablePtr->hPtr);
+        }
+    }
+    DestroyClient(tablePtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_exists --
+ *
+ *      Indicates if a table object by the given name exists in either the
+ *      current or global namespace.
+ *
+ * Results:
+ *      Returns 1 if a table object exists and 0 otherwise.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_exists(Tcl_Interp *interp, const char *name)
+{
+    InterpData *dataPtr;
+
+    dataPtr = GetInterpData(interp);
+    return (GetTable(dataPtr, name, NS_SEARCH_BOTH) != NULL);
+}
+
+static Notifier *
+CreateNotifier(Tcl_Interp *interp, Blt_Chain chain, unsigned int mask,
+               BLT_TABLE_NOTIFY_EVENT_PROC *proc, 
+               BLT_TABLE_NOTIFIER_DELETE_PROC *deleteProc, 
+               ClientData clientData)
+{
+    Notifier *notifierPtr;
+
+    notifierPtr = Blt_AssertMalloc(sizeof (Notifier));
+    notifierPtr->proc = proc;
+    notifierPtr->deleteProc = deleteProc;
+    notifierPtr->chain = chain;
+    notifierPtr->clientData = clientData;
+    notifierPtr->column = NULL;         /* All columns. */
+    notifierPtr->row = NULL;            /* All rows. */
+    notifierPtr->tag = NULL;            /* No tag. */
+    notifierPtr->flags = mask | TABLE_NOTIFY_COLUMN | TABLE_NOTIFY_ROW;
+    notifierPtr->interp = interp;
+    notifierPtr->link = Blt_Chain_Append(chain, notifierPtr);
+    return notifierPtr;
+}
+
+static Notifier *
+CreateNotifierForRows(Tcl_Interp *interp, Blt_Chain chain, unsigned int mask,
+                      Row *rowPtr, const char *tag, 
+                      BLT_TABLE_NOTIFY_EVENT_PROC *proc,
+                      BLT_TABLE_NOTIFIER_DELETE_PROC *deleteProc, 
+                      ClientData clientData)
+{
+    Notifier *notifierPtr;
+
+    notifierPtr = Blt_AssertMalloc(sizeof (Notifier));
+    notifierPtr->proc = proc;
+    notifierPtr->deleteProc = deleteProc;
+    notifierPtr->chain = chain;
+    notifierPtr->clientData = clientData;
+    notifierPtr->row = rowPtr;
+    notifierPtr->column = NULL;
+    notifierPtr->tag = (tag != NULL) ? Blt_AssertStrdup(tag) : NULL;
+    notifierPtr->flags = mask | TABLE_NOTIFY_ROW;
+    notifierPtr->interp = interp;
+    notifierPtr->link = Blt_Chain_Append(chain, notifierPtr);
+    return notifierPtr;
+}
+
+static Notifier *
+CreateNotifierForColumns(Tcl_Interp *interp, Blt_Chain chain, unsigned int mask,
+        Column *colPtr, const char *tag, BLT_TABLE_NOTIFY_EVENT_PROC *proc,
+        BLT_TABLE_NOTIFIER_DELETE_PROC *deleteProc, ClientData clientData)
+{
+    Notifier *notifierPtr;
+
+    notifierPtr = Blt_AssertMalloc(sizeof (Notifier));
+    notifierPtr->proc = proc;
+    notifierPtr->deleteProc = deleteProc;
+    notifierPtr->chain = chain;
+    notifierPtr->clientData = clientData;
+    notifierPtr->column = colPtr;
+    notifierPtr->row = NULL;
+    notifierPtr->tag = (tag != NULL) ? Blt_AssertStrdup(tag) : NULL;
+    notifierPtr->flags = mask | TABLE_NOTIFY_COLUMN;
+    notifierPtr->interp = interp;
+    notifierPtr->link = Blt_Chain_Append(chain, notifierPtr);
+    return notifierPtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_create_notifier --
+ *
+ *      Creates an event handler using the following three pieces of
+ *      information: 
+ *              1. C function pointer, 
+ *              2. one-word of data passed on each call, and 
+ *              3. event mask indicating which events are of interest.  
+ *      If an event already exists matching all of the above criteria,
+ *      it is repositioned on the end of the event handler list.  This
+ *      means that it will be the last to fire.
+ *
+ * Results:
+ *      Returns a pointer to the event handler.
+ *
+ * Side Effects:
+ *      Memory for the event handler is possibly allocated.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_NOTIFIER
+blt_table_create_notifier(Tcl_Interp *interp, Table *tablePtr, 
+                          unsigned int mask, BLT_TABLE_NOTIFY_EVENT_PROC *proc,
+                          BLT_TABLE_NOTIFIER_DELETE_PROC *deletedProc,
+                          ClientData clientData)
+{
+    return CreateNotifier(interp, tablePtr->columnNotifiers, mask,  proc, 
+                          deletedProc, clientData);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_create_column_notifier --
+ *
+ *      Creates an event handler using the following three pieces of
+ *      information: 
+ *              1. C function pointer, 
+ *              2. one-word of data passed on each call, and 
+ *              3. event mask indicating which events are of interest.  
+ *      If an event already exists matching all of the above criteria,
+ *      it is repositioned on the end of the event handler list.  This
+ *      means that it will be the last to fire.
+ *
+ * Results:
+ *      Returns a pointer to the event handler.
+ *
+ * Side Effects:
+ *      Memory for the event handler is possibly allocated.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_NOTIFIER
+blt_table_create_column_notifier(Tcl_Interp *interp, Table *tablePtr,
+                               BLT_TABLE_COLUMN col, unsigned int mask,
+                               BLT_TABLE_NOTIFY_EVENT_PROC *proc,
+                               BLT_TABLE_NOTIFIER_DELETE_PROC *deletedProc,
+                               ClientData clientData)
+{
+    return CreateNotifierForColumns(interp, tablePtr->columnNotifiers, mask, 
+                col, NULL, proc, deletedProc, clientData);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_create_column_tag_notifier --
+ *
+ *      Creates an event handler using the following three pieces of
+ *      information: 
+ *              1. C function pointer, 
+ *              2. one-word of data passed on each call, and 
+ *              3. event mask indicating which events are of interest.  
+ *      If an event already exists matching all of the above criteria,
+ *      it is repositioned on the end of the event handler list.  This
+ *      means that it will be the last to fire.
+ *
+ * Results:
+ *      Returns a pointer to the event handler.
+ *
+ * Side Effects:
+ *      Memory for the event handler is possibly allocated.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_NOTIFIER
+blt_table_create_column_tag_notifier(Tcl_Interp *interp, Table *tablePtr,
+                                  const char *tag, unsigned int mask,
+                                  BLT_TABLE_NOTIFY_EVENT_PROC *proc,
+                                  BLT_TABLE_NOTIFIER_DELETE_PROC *deletedProc,
+                                  ClientData clientData)
+{
+    return CreateNotifierForColumns(interp, tablePtr->columnNotifiers, mask, 
+        NULL, tag, proc, deletedProc, clientData);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_create_row_notifier --
+ *
+ *      Creates an event handler using the following three pieces of
+ *      information: 
+ *              1. C function pointer, 
+ *              2. one-word of data passed on each call, and 
+ *              3. event mask indicating which events are of interest.  
+ *      If an event already exists matching all of the above criteria,
+ *      it is repositioned on the end of the event handler list.  This
+ *      means that it will be the last to fire.
+ *
+ * Results:
+ *      Returns a pointer to the event handler.
+ *
+ * Side Effects:
+ *      Memory for the event handler is possibly allocated.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_NOTIFIER
+blt_table_create_row_notifier(Tcl_Interp *interp, Table *tablePtr, 
+                            BLT_TABLE_ROW row, unsigned int mask,
+                            BLT_TABLE_NOTIFY_EVENT_PROC *proc,
+                            BLT_TABLE_NOTIFIER_DELETE_PROC *deletedProc,
+                            ClientData clientData)
+{
+    return CreateNotifierForRows(interp, tablePtr->rowNotifiers, mask, row, 
+        NULL, proc, deletedProc, clientData);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_create_column_tag_notifier --
+ *
+ *      Creates an event handler using the following three pieces of
+ *      information: 
+ *              1. C function pointer, 
+ *              2. one-word of data passed on each call, and 
+ *              3. event mask indicating which events are of interest.  
+ *      If an event already exists matching all of the above criteria,
+ *      it is repositioned on the end of the event handler list.  This
+ *      means that it will be the last to fire.
+ *
+ * Results:
+ *      Returns a pointer to the event handler.
+ *
+ * Side Effects:
+ *      Memory for the event handler is possibly allocated.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_NOTIFIER
+blt_table_create_row_tag_notifier(Tcl_Interp *interp, Table *tablePtr,
+                               const  char *tag, unsigned int mask,
+                               BLT_TABLE_NOTIFY_EVENT_PROC *proc,
+                               BLT_TABLE_NOTIFIER_DELETE_PROC *deletedProc,
+                               ClientData clientData)
+{
+    return CreateNotifierForRows(interp, tablePtr->rowNotifiers, mask, NULL, 
+        tag, proc, deletedProc, clientData);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_delete_notifier --
+ *
+ *      Removes the event handler designated by following three pieces
+ *      of information: 
+ *         1. C function pointer, 
+ *         2. one-word of data passed on each call, and 
+ *         3. event mask indicating which events are of interest.
+ *
+ * Results:
+ *      Nothing.
+ *
+ * Side Effects:
+ *      Memory for the event handler is freed.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_delete_notifier(Table *tablePtr, Notifier *notifierPtr)
+{
+    /* Check if notifier is already being deleted. */
+    if ((notifierPtr->flags & TABLE_NOTIFY_DESTROYED) == 0) {
+        if (notifierPtr->deleteProc != NULL) {
+            (*notifierPtr->deleteProc)(notifierPtr->clientData);
+        }
+        if (notifierPtr->flags & TABLE_NOTIFY_PENDING) {
+            Tcl_CancelIdleCall(NotifyIdleProc, notifierPtr);
+        }
+        notifierPtr->flags = TABLE_NOTIFY_DESTROYED;
+        Tcl_EventuallyFree(notifierPtr, (Tcl_FreeProc *)FreeNotifier);
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_get_row_by_label --
+ *
+ *      Returns the offset of the row given its label.  If the row label is
+ *      invalid, then -1 is returned.
+ *
+ * Results:
+ *      Returns the offset of the row or -1 if not found.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_ROW
+blt_table_get_row_by_label(Table *tablePtr, const char *label)
+{
+    return FindRowLabel(&tablePtr->corePtr->rows, label);
+}
+
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_get_column_by_label --
+ *
+ *      Returns the offset of the column given its label.  If the column label
+ *      is invalid, then -1 is returned.
+ *
+ * Results:
+ *      Returns the offset of the column or -1 if not found.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_COLUMN
+blt_table_get_column_by_label(Table *tablePtr, const char *label)
+{
+    return FindColumnLabel(&tablePtr->corePtr->columns, label);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_column_get_label_table --
+ *
+ *      Returns the offset of the column given its label.  If the column label
+ *      is invalid, then -1 is returned.
+ *
+ * Results:
+ *      Returns the offset of the column or -1 if not found.
+ *
+ *---------------------------------------------------------------------------
+ */
+Blt_HashTable *
+blt_table_column_get_label_table(Table *tablePtr, const char *label)
+{
+    return GetColumnLabelTable(&tablePtr->corePtr->columns, label);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_row_get_label_table --
+ *
+ *      Returns the offset of the column given its label.  If the column label
+ *      is invalid, then -1 is returned.
+ *
+ * Results:
+ *      Returns the offset of the column or -1 if not found.
+ *
+ *---------------------------------------------------------------------------
+ */
+Blt_HashTable *
+blt_table_row_get_label_table(Table *tablePtr, const char *label)
+{
+    return GetRowLabelTable(&tablePtr->corePtr->rows, label);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_row_label --
+ *
+ *      Returns the label of the row.  If the row offset is invalid or the row
+ *      has no label, then NULL is returned.
+ *
+ * Results:
+ *      Returns the label of the row.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_set_row_label(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr, 
+                        const char *label)
+{
+    BLT_TABLE_NOTIFY_EVENT event;
+        
+    InitNotifyEvent(tablePtr, &event);
+    event.type = TABLE_NOTIFY_RELABEL;
+    event.row = rowPtr;
+    SetRowLabel(&tablePtr->corePtr->rows, rowPtr, label);
+    NotifyClients(tablePtr, &event);
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_column_label --
+ *
+ *      Sets the label of the column.  If the column offset is invalid, then
+ *      no label is set.
+ *
+ * Results:
+ *      None.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_set_column_label(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
+                           const char *label)
+{
+    BLT_TABLE_NOTIFY_EVENT event;
+
+    InitNotifyEvent(tablePtr, &event);
+    event.type = TABLE_NOTIFY_COLUMNS_RELABEL;
+    event.column = colPtr;
+    SetColumnLabel(&tablePtr->corePtr->columns, colPtr, label);
+    NotifyClients(tablePtr, &event);
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_column_type --
+ *
+ *      Sets the type of the given column.  
+ *
+ * Results:
+ *      None.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_set_column_type(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
+                          BLT_TABLE_COLUMN_TYPE type)
+{
+    if (type == colPtr->type) {
+        return TCL_OK;                  /* Already the requested type. */
+    }
+    return SetColumnType(interp, tablePtr, colPtr, type);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_column_time_format --
+ *
+ *      Sets the strptime-style pattern used to parse strings into time
+ *      values for the given column.  The pattern is compiled once, so
+ *      that strings following it are converted without the general
+ *      timestamp parser.  Strings that don't match are still given to
+ *      the general parser.  The format may be set on a column of any
+ *      type: it's used when the column is converted to a time column.
+ *      An empty or NULL pattern removes the format.
+ *
+ * Results:
+ *      A standard TCL result.  If the pattern is invalid, TCL_ERROR is
+ *      returned and an error message is left in the interpreter.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_set_column_time_format(Tcl_Interp *interp, Table *tablePtr, 
+                                 Column *colPtr, const char *pattern)
+{
+    Blt_TimeFormat fmtPtr;
+
+    fmtPtr = NULL;
+    if ((pattern != NULL) && (pattern[0] != '\0')) {
+        fmtPtr = Blt_CompileTimeFormat(interp, pattern);
+        if (fmtPtr == NULL) {
+            return TCL_ERROR;
+        }
+    }
+    if (colPtr->timeFmtPtr != NULL) {
+        Blt_FreeTimeFormat(colPtr->timeFmtPtr);
+    }
+    colPtr->timeFmtPtr = fmtPtr;
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_column_time_format --
+ *
+ *      Returns the time format pattern of the column or NULL if the column
+ *      has no time format.
+ *
+ *---------------------------------------------------------------------------
+ */
+const char *
+blt_table_column_time_format(Column *colPtr)
+{
+    if (colPtr->timeFmtPtr == NULL) {
+        return NULL;
+    }
+    return Blt_TimeFormatPattern(colPtr->timeFmtPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GuessTypes --
+ *
+ *      Returns the types the string can be converted to.  The time
+ *      formats it follows are returned via *formatsPtr*.
+ *
+ *---------------------------------------------------------------------------
+ */
+static unsigned int
+GuessTypes(const char *s, int length, unsigned int *formatsPtr)
+{
+    unsigned int mask;
+
+    mask = GuessNumber(s, s + length);
+    if (mask != 0) {
+        return mask;
+    }
+    if (((length == 4) && (strncasecmp(s, "true", 4) == 0)) ||
+        ((length == 5) && (strncasecmp(s, "false", 5) == 0)) ||
+        ((length == 3) && (strncasecmp(s, "yes", 3) == 0)) ||
+        ((length == 2) && (strncasecmp(s, "no", 2) == 0))) {
+        return GUESS_BOOLEAN;
+    }
+    *formatsPtr = 0;
+    if ((length > 0) && (isdigit(UCHAR(*s)))) {
+        int i;
+
+        for (i = 0; i < numGuessTimePatterns; i++) {
+            double d;
+
+            if (Blt_ParseTimeWithFormat(NULL, guessTimeFormats[i], s, length,
+                                        &d) == TCL_OK) {
+                *formatsPtr |= (1 << i);
+            }
+        }
+        if (*formatsPtr != 0) {
+            return GUESS_TIME;
+        }
+    }
+    return 0;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_init_type_guess --
+ *
+ *      Initializes the guess of the type of a column's values.  The time
+ *      formats used to recognize times are compiled the first time.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_init_type_guess(BLT_TABLE_TYPE_GUESS *guessPtr, Column *colPtr, 
+                          long sampleSize)
+{
+    Tcl_MutexLock(&guessMutex);
+    if (guessTimeFormats[0] == NULL) {
+        int i;
+
+        for (i = 0; i < numGuessTimePatterns; i++) {
+            guessTimeFormats[i] = Blt_CompileTimeFormat(NULL, 
+                guessTimePatterns[i]);
+        }
+    }
+    Tcl_MutexUnlock(&guessMutex);
+    guessPtr->column = colPtr;
+    guessPtr->sampleSize = sampleSize;
+    guessPtr->numValues = 0;
+    guessPtr->mask = GUESS_ALL;
+    guessPtr->timeFormats = (1 << numGuessTimePatterns) - 1;
+    guessPtr->isTyped = FALSE;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_guess_value --
+ *
+ *      Narrows the guess of the column's type by the given value.  Empty
+ *      strings are ignored.  Times may follow different formats.  The
+ *      formats followed by all the times are kept, unless there are none.
+ *      Then the column's time format is only used for some values, and
+ *      the rest are handled by the general time parser.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_guess_value(BLT_TABLE_TYPE_GUESS *guessPtr, const char *s, 
+                      int length)
+{
+    unsigned int formats;
+
+    if (length < 0) {
+        length = strlen(s);
+    }
+    if (length == 0) {
+        return;
+    }
+    guessPtr->numValues++;
+    if (guessPtr->mask == 0) {
+        return;
+    }
+    guessPtr->mask &= GuessTypes(s, length, &formats);
+    if (guessPtr->timeFormats & formats) {
+        guessPtr->timeFormats &= formats;
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_guessed_type --
+ *
+ *      Sets the type of the column from the values examined so far.  A
+ *      time column also gets the time format its values follow.  If no
+ *      values were examined, the column is left a string column.
+ *
+ * Results:
+ *      A standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_set_guessed_type(Tcl_Interp *interp, Table *tablePtr, 
+                           BLT_TABLE_TYPE_GUESS *guessPtr)
+{
+    BLT_TABLE_COLUMN_TYPE type;
+    unsigned int mask;
+
+    guessPtr->isTyped = TRUE;
+    mask = (guessPtr->numValues > 0) ? guessPtr->mask : 0;
+    if (mask & GUESS_BOOLEAN) {
+        type = TABLE_COLUMN_TYPE_BOOLEAN;
+    } else if (mask & GUESS_LONG) {
+        type = TABLE_COLUMN_TYPE_LONG;
+    } else if (mask & GUESS_INT64) {
+        type = TABLE_COLUMN_TYPE_INT64;
+    } else if (mask & GUESS_DOUBLE) {
+        type = TABLE_COLUMN_TYPE_DOUBLE;
+    } else if (mask & GUESS_TIME) {
+        int i;
+
+        for (i = 0; i < numGuessTimePatterns; i++) {
+            if (guessPtr->timeFormats & (1 << i)) {
+                break;
+            }
+        }
+        if (blt_table_set_column_time_format(interp, tablePtr, 
+                guessPtr->column, guessTimePatterns[i]) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        type = TABLE_COLUMN_TYPE_TIME;
+    } else {
+        type = TABLE_COLUMN_TYPE_STRING;
+    }
+    return blt_table_set_column_type(interp, tablePtr, guessPtr->column, type);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_guessed_value --
+ *
+ *      Sets the value of a cell in a column whose type is being guessed.
+ *      Until the column is typed, the value is stored as a string and
+ *      used to narrow the guess.  The column is typed once enough values
+ *      have been sampled.  Afterwards the value is converted as it's
+ *      stored.  If the value doesn't fit the column's type, the column is
+ *      widened (long to int64 or double, anything else to string).
+ *
+ * Results:
+ *      A standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_set_guessed_value(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
+                            BLT_TABLE_TYPE_GUESS *guessPtr, const char *s,
+                            int length)
+{
+    Column *colPtr;
+    BLT_TABLE_COLUMN_TYPE type;
+    unsigned int mask, formats;
+
+    colPtr = guessPtr->column;
+    if (!guessPtr->isTyped) {
+        blt_table_guess_value(guessPtr, s, length);
+        if (blt_table_set_string_rep(interp, tablePtr, rowPtr, colPtr, s, 
+                length) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if ((guessPtr->sampleSize > 0) && 
+            (guessPtr->numValues >= guessPtr->sampleSize)) {
+            return blt_table_set_guessed_type(interp, tablePtr, guessPtr);
+        }
+        return TCL_OK;
+    }
+    if (blt_table_set_string_rep(interp, tablePtr, rowPtr, colPtr, s, length)
+        == TCL_OK) {
+        return TCL_OK;
+    }
+    /* The value doesn't fit the column's type.  Widen the column. */
+    if (interp != NULL) {
+        Tcl_ResetResult(interp);
+    }
+    if (length < 0) {
+        length = strlen(s);
+    }
+    formats = 0;
+    mask = GuessTypes(s, length, &formats);
+    type = TABLE_COLUMN_TYPE_STRING;
+    if (colPtr->type == TABLE_COLUMN_TYPE_LONG) {
+        if (mask & GUESS_INT64) {
+            type = TABLE_COLUMN_TYPE_INT64;
+        } else if (mask & GUESS_DOUBLE) {
+            type = TABLE_COLUMN_TYPE_DOUBLE;
+        }
+    } else if ((colPtr->type == TABLE_COLUMN_TYPE_INT64) && 
+               (mask & GUESS_DOUBLE)) {
+        type = TABLE_COLUMN_TYPE_DOUBLE;
+    }
+    if ((type == TABLE_COLUMN_TYPE_STRING) && (colPtr->timeFmtPtr != NULL)) {
+        blt_table_set_column_time_format(interp, tablePtr, colPtr, NULL);
+    }
+    if (blt_table_set_column_type(interp, tablePtr, colPtr, type) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    return blt_table_set_string_rep(interp, tablePtr, rowPtr, colPtr, s, 
+                                    length);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_finish_type_guess --
+ *
+ *      Types the column, if it hasn't been already.  If listObjPtr isn't
+ *      NULL, the column label and its type are appended to the list.  For
+ *      time columns, the type is a list of "time" and the time format.
+ *
+ * Results:
+ *      A standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_finish_type_guess(Tcl_Interp *interp, Table *tablePtr, 
+                            BLT_TABLE_TYPE_GUESS *guessPtr, 
+                            Tcl_Obj *listObjPtr)
+{
+    Column *colPtr;
+    Tcl_Obj *objPtr;
+
+    colPtr = guessPtr->column;
+    if (colPtr == NULL) {
+        return TCL_OK;                  /* Column was never created. */
+    }
+    if ((!guessPtr->isTyped) &&
+        (blt_table_set_guessed_type(interp, tablePtr, guessPtr) != TCL_OK)) {
+        return TCL_ERROR;
+    }
+    if (listObjPtr == NULL) {
+        return TCL_OK;
+    }
+    Tcl_ListObjAppendElement(interp, listObjPtr, 
+        Tcl_NewStringObj(colPtr->label, -1));
+    objPtr = Tcl_NewStringObj(valueTypes[colPtr->type], -1);
+    if ((colPtr->type == TABLE_COLUMN_TYPE_TIME) && 
+        (colPtr->timeFmtPtr != NULL)) {
+        Tcl_Obj *objv[2];
+
+        objv[0] = objPtr;
+        objv[1] = Tcl_NewStringObj(Blt_TimeFormatPattern(colPtr->timeFmtPtr),
+                                   -1);
+        objPtr = Tcl_NewListObj(2, objv);
+    }
+    Tcl_ListObjAppendElement(interp, listObjPtr, objPtr);
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_set_column_encoding --
+ *
+ *      Sets how the values of the given column are stored.  Only string
+ *      columns can be dictionary encoded.  The current values of the
+ *      column are converted to the new encoding.  Changing the type of
+ *      the column removes its encoding.
+ *
+ * Results:
+ *      A standard TCL result.  If the column can't be encoded, TCL_ERROR
+ *      is returned and an error message is left in the interpreter.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_set_column_encoding(Tcl_Interp *interp, Table *tablePtr, 
+                              Column *colPtr, 
+                              BLT_TABLE_COLUMN_ENCODING encoding)
+{
+    Rows *rowsPtr;
+    Row *rowPtr;
+
+    if (encoding == blt_table_column_encoding(colPtr)) {
+        return TCL_OK;                  /* Already the requested encoding. */
+    }
+    if (colPtr->sharePtr != NULL) {
+        UnshareColumn(tablePtr->corePtr, colPtr);
+    }
+    rowsPtr = &tablePtr->corePtr->rows;
+    if (encoding == TABLE_COLUMN_ENCODING_DICTIONARY) {
+        if (colPtr->type != TABLE_COLUMN_TYPE_STRING) {
+            if (interp != NULL) {
+                Tcl_AppendResult(interp, "can't encode column \"", 
+                        colPtr->label, "\": only string columns can be ",
+                        "dictionary encoded", (char *)NULL);
+            }
+            return TCL_ERROR;
+        }
+        colPtr->dictPtr = NewDictionary();
+        if (colPtr->vector == NULL) {
+            return TCL_OK;              /* No values to convert. */
+        }
+        if (!AllocCodes(tablePtr, colPtr)) {
+            goto nomem;
+        }
+        for (rowPtr = rowsPtr->headPtr; rowPtr != NULL; 
+             rowPtr = rowPtr->nextPtr) {
+            Value *valuePtr;
+
+            valuePtr = colPtr->vector + rowPtr->offset;
+            if (!IsEmptyValue(valuePtr)) {
+                SetCode(colPtr, rowPtr->offset, GetDictionaryCode(rowsPtr,
+                        colPtr, GetValueString(valuePtr), 
+                        GetValueLength(valuePtr)));
+            }
+            ResetValue(valuePtr);
+        }
+        Blt_Free(colPtr->vector);
+        colPtr->vector = NULL;
+    } else {
+        Value *vector;
+
+        vector = NULL;
+        if (colPtr->codes != NULL) {
+            vector = Blt_Calloc(rowsPtr->numAllocated, sizeof(Value));
+            if (vector == NULL) {
+                goto nomem;
+            }
+            for (rowPtr = rowsPtr->headPtr; rowPtr != NULL; 
+                 rowPtr = rowPtr->nextPtr) {
+                const char *string;
+                unsigned int length;
+
+                string = GetStoredString(rowPtr, colPtr, &length);
+                if (string != NULL) {
+                    SetValueFromString(NULL, NULL, TABLE_COLUMN_TYPE_STRING, 
+                        string, length, vector + rowPtr->offset);
+                }
+            }
+            Blt_Free(colPtr->codes);
+            colPtr->codes = NULL;
+        }
+        FreeDictionary(colPtr->dictPtr);
+        colPtr->dictPtr = NULL;
+        colPtr->vector = vector;
+    }
+    return TCL_OK;
+ nomem:
+    if (interp != NULL) {
+        Tcl_AppendResult(interp, "can't allocate storage for column \"", 
+                colPtr->label, "\"", (char *)NULL);
+    }
+    FreeDictionary(colPtr->dictPtr);
+    colPtr->dictPtr = NULL;
+    return TCL_ERROR;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_dictionary_code --
+ *
+ *      Looks up the string in the dictionary of the given column.
+ *
+ * Results:
+ *      Returns the code of the string, or -1 if the column isn't
+ *      dictionary encoded or the string isn't in its dictionary.
+ *
+ *---------------------------------------------------------------------------
+ */
+long
+blt_table_dictionary_code(Column *colPtr, const char *string)
+{
+    Blt_HashEntry *hPtr;
+
+    if (colPtr->dictPtr == NULL) {
+        return -1;
+    }
+    hPtr = Blt_FindHashEntry(&colPtr->dictPtr->codeTable, string);
+    if (hPtr == NULL) {
+        return -1;
+    }
+    return (long)(intptr_t)Blt_GetHashValue(hPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_get_code --
+ *
+ *      Returns the dictionary code of the value at the given row and
+ *      column.  Cells with the same string have the same code.  Note that
+ *      this routine does not fire read traces.
+ *
+ * Results:
+ *      Returns the code, or 0 if the cell is empty or the column isn't
+ *      dictionary encoded.
+ *
+ *---------------------------------------------------------------------------
+ */
+long
+blt_table_get_code(Table *tablePtr, Row *rowPtr, Column *colPtr)
 {
-    if (rowsPtr->flags & REINDEX) {
-        ResetRowMap(rowsPtr);
+    if (colPtr->dictPtr == NULL) {
+        return 0;
     }
-    /* Check is destination outside the range of rows to be moved. */
-    assert ((destPtr->index < firstPtr->index) ||
-            (destPtr->index > lastPtr->index));
+    return GetCode(colPtr, rowPtr->offset);
+}
 
-    /* Unlink the sub-list from the list of rows. */
-    if (rowsPtr->headPtr == firstPtr) {
-        rowsPtr->headPtr = lastPtr->nextPtr;
-        lastPtr->nextPtr->prevPtr = NULL;
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_mirror_rows --
+ *
+ *      Replaces the rows of the destination table with new rows laid out
+ *      in storage like the rows of the source table.  The columns of the
+ *      source table can then be shared by blt_table_share_column.  The
+ *      destination table must not have any columns.
+ *
+ * Results:
+ *      A standard TCL result.  If the destination table has columns or
+ *      memory can't be allocated, TCL_ERROR is returned and an error
+ *      message is left in the interpreter.
+ *
+ * Side Effects:
+ *      Notifier events may be triggered, indicating rows have been
+ *      deleted and created.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_mirror_rows(Tcl_Interp *interp, Table *srcPtr, Table *dstPtr)
+{
+    Rows *srcRowsPtr, *dstRowsPtr;
+    Row *rowPtr, *nextPtr, *srcRowPtr;
+    long i, numAllocated;
+
+    if (srcPtr->corePtr == dstPtr->corePtr) {
+        return TCL_OK;                  /* Same storage. */
     }
-    if (rowsPtr->tailPtr == lastPtr) {
-        rowsPtr->tailPtr = lastPtr->prevPtr;
-        lastPtr->prevPtr->nextPtr = NULL;
+    if (dstPtr->corePtr->columns.numUsed > 0) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "can't mirror rows: table \"", 
+                dstPtr->name, "\" has columns", (char *)NULL);
+        }
+        return TCL_ERROR;
     }
-    if (lastPtr->nextPtr != NULL) {
-        lastPtr->nextPtr->prevPtr = firstPtr->prevPtr;
+    srcRowsPtr = &srcPtr->corePtr->rows;
+    dstRowsPtr = &dstPtr->corePtr->rows;
+    for (rowPtr = dstRowsPtr->headPtr; rowPtr != NULL; rowPtr = nextPtr) {
+        nextPtr = rowPtr->nextPtr;
+        blt_table_delete_row(dstPtr, rowPtr);
     }
-    if (firstPtr->prevPtr != NULL) {
-        firstPtr->prevPtr->nextPtr = lastPtr->nextPtr;
+    dstRowsPtr->firstFree = dstRowsPtr->lastFree = 0;
+    numAllocated = srcRowsPtr->numAllocated;
+    if (numAllocated == 0) {
+        return TCL_OK;                  /* No rows to mirror. */
     }
-    firstPtr->prevPtr = lastPtr->nextPtr = NULL;
-    /* Now attach the detached list to the destination. */
-    if (after) {
-        if (destPtr->nextPtr == NULL) {
-            rowsPtr->tailPtr = lastPtr; /* Append to the end. */
-        } else {
-            destPtr->nextPtr->prevPtr = lastPtr;
+    if (numAllocated != dstRowsPtr->numAllocated) {
+        Row **map, **offsets;
+
+        /* Shared storage must be the same size in both tables. */
+        map = Blt_Realloc(dstRowsPtr->map, sizeof(Row *) * numAllocated);
+        if (map == NULL) {
+            goto nomem;
         }
-        firstPtr->prevPtr = destPtr;
-        lastPtr->nextPtr = destPtr->nextPtr;
-        destPtr->nextPtr = firstPtr;
-    } else {
-        if (destPtr->prevPtr == NULL) {
-            rowsPtr->headPtr = firstPtr; /* Prepend to the beginning. */
-        } else {
-            destPtr->prevPtr->nextPtr = firstPtr;
+        dstRowsPtr->map = map;
+        offsets = Blt_Realloc(dstRowsPtr->offsets, 
+                              sizeof(Row *) * numAllocated);
+        if (offsets == NULL) {
+            goto nomem;
+        }
+        dstRowsPtr->offsets = offsets;
+        dstRowsPtr->numAllocated = numAllocated;
+    }
+    memset(dstRowsPtr->offsets, 0, sizeof(Row *) * numAllocated);
+    for (srcRowPtr = srcRowsPtr->headPtr; srcRowPtr != NULL; 
+         srcRowPtr = srcRowPtr->nextPtr) {
+        rowPtr = NewRow(dstRowsPtr);
+        rowPtr->offset = srcRowPtr->offset;
+        dstRowsPtr->map[rowPtr->index] = rowPtr;
+        dstRowsPtr->offsets[rowPtr->offset] = rowPtr;
+    }
+    ClearRowHoles(dstRowsPtr);
+    dstRowsPtr->flags &= ~REINDEX;
+    /* Unused offsets go on the free queue, to be used by new rows. */
+    for (i = 0; i < numAllocated; i++) {
+        if (dstRowsPtr->offsets[i] == NULL) {
+            PushFreeOffset(dstRowsPtr, i);
         }
-        firstPtr->prevPtr = destPtr->prevPtr;
-        lastPtr->nextPtr = destPtr;
-        destPtr->prevPtr = lastPtr;
     }
-    /* FIXME: You don't have to reset the entire map. */
-    ResetRowMap(rowsPtr);
-    return TRUE;
+    for (rowPtr = dstRowsPtr->headPtr; rowPtr != NULL; 
+         rowPtr = rowPtr->nextPtr) {
+        NotifyRowChanged(dstPtr, rowPtr, TABLE_NOTIFY_ROWS_CREATED);
+    }
+    return TCL_OK;
+ nomem:
+    if (interp != NULL) {
+        Tcl_AppendResult(interp, "can't mirror rows of \"", srcPtr->name,
+                "\": out of memory", (char *)NULL);
+    }
+    return TCL_ERROR;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SameRowLayout --
+ *
+ *      Indicates if the rows of both tables are in the same order and at
+ *      the same offsets in storage.
+ *
+ *---------------------------------------------------------------------------
+ */
 static int
-MoveColumns(Columns *columnsPtr, Column *destPtr, Column *firstPtr, 
-            Column *lastPtr, int after)
+SameRowLayout(Table *srcPtr, Table *dstPtr)
 {
-    if (columnsPtr->flags & REINDEX) {
-        ResetColumnMap(columnsPtr);
-    }
-    assert (firstPtr->index <= lastPtr->index);
-    /* Unlink the sub-list from the list of columns. */
-    if (columnsPtr->headPtr == firstPtr) {
-        columnsPtr->headPtr = lastPtr->nextPtr;
-        lastPtr->nextPtr->prevPtr = NULL;
-    } else {
-        firstPtr->prevPtr->nextPtr = lastPtr->nextPtr;
+    Rows *srcRowsPtr, *dstRowsPtr;
+    Row *srcRowPtr, *dstRowPtr;
+
+    if (srcPtr->corePtr == dstPtr->corePtr) {
+        return TRUE;
     }
-    if (columnsPtr->tailPtr == lastPtr) {
-        columnsPtr->tailPtr = firstPtr->prevPtr;
-        firstPtr->prevPtr->nextPtr = NULL;
-    } else {
-        lastPtr->nextPtr->prevPtr = firstPtr->prevPtr;
+    srcRowsPtr = &srcPtr->corePtr->rows;
+    dstRowsPtr = &dstPtr->corePtr->rows;
+    if ((srcRowsPtr->numUsed != dstRowsPtr->numUsed) ||
+        (srcRowsPtr->numAllocated != dstRowsPtr->numAllocated)) {
+        return FALSE;
     }
-    firstPtr->prevPtr = lastPtr->nextPtr = NULL;
-
-    /* Now attach the detached list to the destination. */
-    if (after) { 
-        /* [a]->[dest]->[b] */
-        /*            [first]->[last] */
-        if (destPtr->nextPtr == NULL) {
-            assert(destPtr == columnsPtr->tailPtr);
-            columnsPtr->tailPtr = lastPtr; /* Append to the end. */
-        } else {
-            destPtr->nextPtr->prevPtr = lastPtr;
-        }
-        lastPtr->nextPtr = destPtr->nextPtr;
-        destPtr->nextPtr = firstPtr;
-        firstPtr->prevPtr = destPtr;
-    } else {
-        /*           [a]->[dest]->[b] */
-        /* [first]->[last] */
-        if (destPtr->prevPtr == NULL) {
-            columnsPtr->headPtr = firstPtr;
-        } else {
-            destPtr->prevPtr->nextPtr = firstPtr;
+    for (srcRowPtr = srcRowsPtr->headPtr, dstRowPtr = dstRowsPtr->headPtr;
+         srcRowPtr != NULL; 
+         srcRowPtr = srcRowPtr->nextPtr, dstRowPtr = dstRowPtr->nextPtr) {
+        if (srcRowPtr->offset != dstRowPtr->offset) {
+            return FALSE;
         }
-        firstPtr->prevPtr = destPtr->prevPtr;
-        destPtr->prevPtr = lastPtr;
-        lastPtr->nextPtr = destPtr;
     }
-    /* FIXME: You don't have to reset the entire map. */
-    ResetColumnMap(columnsPtr);
     return TRUE;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * ParseDumpRecord --
+ * blt_table_share_column --
  *
- *      Gets the next full record in the dump string, returning the
- *      record as a list. Blank lines and comments are ignored.
+ *      Replaces the values of the destination column with those of the
+ *      source column, without copying them.  Both columns share the same
+ *      storage until either is changed (see ColumnShare).  The columns
+ *      may be in the same table, or in tables whose rows are laid out the
+ *      same (see blt_table_mirror_rows).  The destination column takes
+ *      the type and time format of the source column.  No traces are
+ *      fired.
  *
- * Results: 
- *      TCL_RETURN      The end of the string is reached.
- *      TCL_ERROR       An error occurred and an error message 
- *                      is left in the interpreter result.  
- *      TCL_OK          The next record has been successfully parsed.
+ * Results:
+ *      Returns TRUE if the storage is shared.  If the rows of the two
+ *      tables are laid out differently, FALSE is returned and nothing is
+ *      changed.  The values must then be copied.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_share_column(Table *srcPtr, Column *srcColPtr, Table *dstPtr, 
+                       Column *dstColPtr)
+{
+    if (srcColPtr == dstColPtr) {
+        return TRUE;
+    }
+    if (!SameRowLayout(srcPtr, dstPtr)) {
+        return FALSE;
+    }
+    if (srcColPtr->views != NULL) {
+        return FALSE;                   /* Viewed storage can't be shared. */
+    }
+    if ((srcColPtr->flags & TABLE_COLUMN_MAPPED) &&
+        (!UnmapColumn(srcPtr->corePtr, srcColPtr))) {
+        return FALSE;
+    }
+    if (blt_table_set_column_time_format(NULL, dstPtr, dstColPtr,
+                blt_table_column_time_format(srcColPtr)) != TCL_OK) {
+        return FALSE;
+    }
+    DestroyColumnViews(NULL, dstColPtr, dstPtr->corePtr->rows.numUsed);
+    FreeColumnValues(&dstPtr->corePtr->rows, dstColPtr);
+    if (dstColPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
+        InvalidateKeys(dstPtr, dstColPtr);
+    }
+    if (dstColPtr->indexPtr != NULL) {
+        dstColPtr->indexPtr->flags |= INDEX_DIRTY;
+    }
+    dstColPtr->type = srcColPtr->type;
+    if ((srcColPtr->vector == NULL) && (srcColPtr->data == NULL) &&
+        (srcColPtr->dictPtr == NULL)) {
+        return TRUE;                    /* No values to share. */
+    }
+    if ((srcColPtr->data != NULL) && (srcColPtr->strings == NULL)) {
+        /* Generated strings are cached in the shared array, so allocate
+         * it now. */
+        srcColPtr->strings = Blt_AssertCalloc(
+                srcPtr->corePtr->rows.numAllocated, sizeof(char *));
+    }
+    if (srcColPtr->sharePtr == NULL) {
+        srcColPtr->sharePtr = Blt_AssertCalloc(1, sizeof(ColumnShare));
+        srcColPtr->sharePtr->refCount = 1;
+    }
+    srcColPtr->sharePtr->refCount++;
+    dstColPtr->sharePtr = srcColPtr->sharePtr;
+    dstColPtr->vector = srcColPtr->vector;
+    dstColPtr->data = srcColPtr->data;
+    dstColPtr->nonEmpty = srcColPtr->nonEmpty;
+    dstColPtr->strings = srcColPtr->strings;
+    dstColPtr->dictPtr = srcColPtr->dictPtr;
+    dstColPtr->codes = srcColPtr->codes;
+    return TRUE;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * LoadTimeStrings --
+ *
+ *      Converts a block of time strings to seconds and loads them into
+ *      the time column.  Strings that don't match the column's time
+ *      format, if it has one, are handed to the general parser.
  *
  *---------------------------------------------------------------------------
  */
 static int
-ParseDumpRecord(
-    Tcl_Interp *interp,
-    char **sp,                          /* (in/out) points to current
-                                         * location in in dump
-                                         * string. Updated after parsing
-                                         * record. */
-    RestoreData *restorePtr)
+LoadTimeStrings(Tcl_Interp *interp, Table *tablePtr, Column *colPtr,
+                size_t numRows, Row **rows, const unsigned char *bitmap,
+                const void *values, const int64_t *offsets)
 {
-    char *entry, *eol;
-    char saved;
+    Tcl_DString ds;
+    double *seconds;
+    size_t i;
     int result;
 
-    restorePtr->argc = 0;
-    entry = *sp;
-    /* Get first line, ignoring blank lines and comments. */
-    for (;;) {
-        char *first;
+    seconds = Blt_Malloc(numRows * sizeof(double));
+    if (seconds == NULL) {
+        Tcl_AppendResult(interp, "can't allocate ", Blt_Ltoa(numRows), 
+                " time values", (char *)NULL);
+        return TCL_ERROR;
+    }
+    Tcl_DStringInit(&ds);
+    result = TCL_OK;
+    for (i = 0; i < numRows; i++) {
+        const char *string;
+        int length;
 
-        first = NULL;
-        restorePtr->numLines++;
-        /* Find the end of the first line. */
-        for (eol = entry; (*eol != '\n') && (*eol != '\0'); eol++) {
-            if ((first == NULL) && (!isspace(UCHAR(*eol)))) {
-                first = eol;    /* Track first non-whitespace
-                                 * character. */
-            }
+        if ((bitmap[i >> 3] & (1 << (i & 7))) == 0) {
+            seconds[i] = 0.0;
+            continue;
         }
-        if (first == NULL) {
-            if (*eol == '\0') {
-                return TCL_RETURN;
+        string = (const char *)values + offsets[i];
+        length = (int)(offsets[i + 1] - offsets[i]);
+        if ((colPtr->timeFmtPtr != NULL) &&
+            (Blt_ParseTimeWithFormat(NULL, colPtr->timeFmtPtr, string, 
+                length, seconds + i) == TCL_OK)) {
+            continue;
+        }
+        Tcl_DStringSetLength(&ds, 0);
+        Tcl_DStringAppend(&ds, string, length);
+        result = Blt_GetTime(interp, Tcl_DStringValue(&ds), seconds + i);
+        if (result != TCL_OK) {
+            break;
+        }
+    }
+    Tcl_DStringFree(&ds);
+    if (result == TCL_OK) {
+        result = blt_table_load_column(interp, tablePtr, colPtr, numRows, 
+                rows, bitmap, seconds, sizeof(double), NULL);
+    }
+    Blt_Free(seconds);
+    return result;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_load_column --
+ *
+ *      Loads a block of values into a column.  The bitmap has a bit for
+ *      each row (least significant bit first) that is set if the cell
+ *      has a value.  Cells whose bit is clear are emptied.  For numeric
+ *      columns, values holds a fixed-width value per row: 8 bytes for
+ *      doubles, times, and integers (long integers are passed as 64-bit
+ *      integers), 4 bytes for booleans.  For string and blob columns,
+ *      values holds the concatenated bytes and offsets holds numRows + 1
+ *      ascending offsets into it.  The caller must check the offsets lie
+ *      within the values.  Time columns may also be loaded from strings
+ *      this way (width is ignored).  They are converted as a block, using
+ *      the column's time format if it has one.
+ *
+ *      If the rows are consecutive in the table and the column has no
+ *      keys or index, numeric values are copied in a single block.  No
+ *      traces are fired.
+ *
+ * Results:
+ *      A standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_load_column(Tcl_Interp *interp, Table *tablePtr, Column *colPtr,
+                      size_t numRows, Row **rows, const unsigned char *bitmap,
+                      const void *values, size_t width, const int64_t *offsets)
+{
+    size_t i;
+
+    if (numRows == 0) {
+        return TCL_OK;
+    }
+    if ((colPtr->type == TABLE_COLUMN_TYPE_TIME) && (offsets != NULL)) {
+        return LoadTimeStrings(interp, tablePtr, colPtr, numRows, rows, 
+                bitmap, values, offsets);
+    }
+    if (IsDenseColumn(colPtr)) {
+        size_t needed;
+
+        needed = (colPtr->type == TABLE_COLUMN_TYPE_BOOLEAN) ? 4 : 8;
+        if (width != needed) {
+            Tcl_AppendResult(interp, "wrong value width ", Blt_Ltoa(width),
+                " for column \"", colPtr->label, "\": should be ",
+                Blt_Ltoa(needed), (char *)NULL);
+            return TCL_ERROR;
+        }
+    } else if (offsets == NULL) {
+        Tcl_AppendResult(interp, "no offsets given for column \"", 
+                colPtr->label, "\"", (char *)NULL);
+        return TCL_ERROR;
+    }
+    if (colPtr->sharePtr != NULL) {
+        UnshareColumn(tablePtr->corePtr, colPtr);
+    }
+    FreeColumnStats(colPtr);
+    if ((IsDenseColumn(colPtr)) && (colPtr->indexPtr == NULL) &&
+        (colPtr->views == NULL) &&
+        ((colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) == 0)) {
+        int isContiguous;
+
+        isContiguous = TRUE;
+        for (i = 1; i < numRows; i++) {
+            if (rows[i]->offset != (rows[0]->offset + (long)i)) {
+                isContiguous = FALSE;
+                break;
             }
-        } else if (*first != '#') {
-            break;                      /* Not a comment or blank line. */
         }
-        entry = eol + 1;
+        return LoadDenseValues(interp, tablePtr, colPtr, numRows, rows, 
+                bitmap, values, width, isContiguous, TRUE);
     }
-    saved = *eol;
-    *eol = '\0';
-    while (!Tcl_CommandComplete(entry)) {
-        *eol = saved;
-        if (*eol == '\0') {
-            Tcl_AppendResult(interp, "incomplete dump record: \"", entry, 
-                "\"", (char *)NULL);
-            return TCL_ERROR;           /* Found EOF (incomplete entry) or
-                                         * error. */
+    for (i = 0; i < numRows; i++) {
+        Value value;
+        int result;
+
+        if ((bitmap[i >> 3] & (1 << (i & 7))) == 0) {
+            if (!IsEmpty(rows[i], colPtr)) {
+                UnsetValue(tablePtr, rows[i], colPtr);
+            }
+            continue;
         }
-        /* Get the next line. */
-        for (eol = eol + 1; (*eol != '\n') && (*eol != '\0'); eol++) {
-            /*empty*/
+        memset(&value, 0, sizeof(Value));
+        if (IsDenseColumn(colPtr)) {
+            DecodeDenseDatum(colPtr->type, 
+                (const unsigned char *)values + i * width, &value);
+        } else if (SetValueFromString(interp, colPtr, colPtr->type, 
+                (const char *)values + offsets[i], 
+                (int)(offsets[i + 1] - offsets[i]), &value) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        result = PutValue(interp, tablePtr, rows[i], colPtr, &value);
+        if (result != TCL_OK) {
+            return TCL_ERROR;
         }
-        restorePtr->numLines++;
-        saved = *eol;
-        *eol = '\0';
     }
-    if (entry == eol) {
-        return TCL_RETURN;
+    if (colPtr->views != NULL) {
+        NotifyColumnViews(tablePtr, colPtr, TABLE_VIEW_CHANGED);
     }
-    result = Tcl_SplitList(interp, entry, &restorePtr->argc, &restorePtr->argv);
-    *eol = saved;
-    *sp = eol + 1;
-    return result;
+    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * ReadDumpRecord --
- *
- *      Reads the next full record from the given channel, returning the
- *      record as a list. Blank lines and comments are ignored.
+ * Column views --
  *
- * Results: 
- *      TCL_RETURN      The end of the file has been reached.
- *      TCL_ERROR       A read error has occurred and an error message 
- *                      is left in the interpreter result.  
- *      TCL_OK          The next record has been successfully parsed.
+ *      A view lets a client (such as a vector) use the native array of a
+ *      double or time column directly, without copying the values.  For
+ *      the array to be indexed by row, the rows must be stored in order,
+ *      so the table is packed if needed.  Empty cells hold NaN.  While a
+ *      column has views, any change to the storage of the column is
+ *      reported to the view procedures, so that clients never see stale
+ *      pointers.
  *
  *---------------------------------------------------------------------------
  */
 static int
-ReadDumpRecord(Tcl_Interp *interp, Tcl_Channel channel, RestoreData *restorePtr)
+RowsInStorageOrder(Rows *rowsPtr)
 {
-    int result;
-    Tcl_DString ds;
-
-    Tcl_DStringInit(&ds);
-    /* Get first line, ignoring blank lines and comments. */
-    for (;;) {
-        const char *cp;
-        int numChars;
+    Row *rowPtr;
+    long count;
 
-        Tcl_DStringSetLength(&ds, 0);
-        numChars = Tcl_Gets(channel, &ds);
-        if (numChars < 0) {
-            if (Tcl_Eof(channel)) {
-                return TCL_RETURN;
-            }
-            return TCL_ERROR;
-        }
-        restorePtr->numLines++;
-        for (cp = Tcl_DStringValue(&ds); *cp != '\0'; cp++) {
-            if (!isspace(UCHAR(*cp))) {
-                break;
-            }
-        }
-        if ((*cp != '\0') && (*cp != '#')) {
-            break;              /* Not a comment or blank line. */
+    count = 0;
+    for (rowPtr = rowsPtr->headPtr; rowPtr != NULL; rowPtr = rowPtr->nextPtr) {
+        if (rowPtr->offset != count) {
+            return FALSE;
         }
+        count++;
     }
+    return TRUE;
+}
 
-    Tcl_DStringAppend(&ds, "\n", 1);
-    while (!Tcl_CommandComplete(Tcl_DStringValue(&ds))) {
-        int numChars;
+static void
+NotifyColumnViews(Table *tablePtr, Column *colPtr, unsigned int flags)
+{
+    Blt_ChainLink link, next;
 
-        /* Process additional lines if needed */
-        numChars = Tcl_Gets(channel, &ds);
-        if (numChars < 0) {
-            Tcl_AppendResult(interp, "error reading file: ", 
-                             Tcl_PosixError(interp), (char *)NULL);
-            Tcl_DStringFree(&ds);
-            return TCL_ERROR;           /* Found EOF (incomplete entry) or
-                                         * error. */
+    for (link = Blt_Chain_FirstLink(colPtr->views); link != NULL; 
+         link = next) {
+        ColumnView *viewPtr;
+
+        next = Blt_Chain_NextLink(link);
+        viewPtr = Blt_Chain_GetValue(link);
+        if (viewPtr->flags & VIEW_SYNCING) {
+            continue;                   /* Change came from the client. */
         }
-        restorePtr->numLines++;
-        Tcl_DStringAppend(&ds, "\n", 1);
+        (*viewPtr->proc)(viewPtr->clientData, colPtr->data, 
+                tablePtr->corePtr->rows.numUsed, flags);
     }
-    result = Tcl_SplitList(interp, Tcl_DStringValue(&ds), &restorePtr->argc, 
-                           &restorePtr->argv);
-    Tcl_DStringFree(&ds);
-    return result;
 }
 
 static void
-RestoreError(Tcl_Interp *interp, RestoreData *restorePtr)
+FreeView(ColumnView *viewPtr)
 {
-    Tcl_DString ds;
+    Column *colPtr;
 
-    Tcl_DStringInit(&ds);
-    Tcl_DStringGetResult(interp, &ds);
-    Tcl_AppendResult(interp, restorePtr->fileName, ":", 
-        Blt_Ltoa(restorePtr->numLines), ": error: ", Tcl_DStringValue(&ds), 
-        (char *)NULL);
-    Tcl_DStringFree(&ds);
+    colPtr = viewPtr->colPtr;
+    Blt_Chain_DeleteLink(colPtr->views, viewPtr->link);
+    if (Blt_Chain_GetLength(colPtr->views) == 0) {
+        Blt_Chain_Destroy(colPtr->views);
+        colPtr->views = NULL;
+    }
+    Blt_Free(viewPtr);
 }
 
-static int
-RestoreHeader(Tcl_Interp *interp, BLT_TABLE table, RestoreData *restorePtr)
+/*
+ * DestroyColumnViews --
+ *
+ *      Deletes the views of the column made by the given client, or all
+ *      the views if tablePtr is NULL.  This is called before the storage
+ *      of the column is released, so clients can still copy the values.
+ */
+static void
+DestroyColumnViews(Table *tablePtr, Column *colPtr, long numValues)
 {
-    long numCols, numRows, count;
-    int64_t time;
+    Blt_ChainLink link, next;
 
-    /* i rows columns ctime mtime */
-    if (restorePtr->argc != 5) {
-        RestoreError(interp, restorePtr);
-        Tcl_AppendResult(interp, "wrong # of elements in restore header.", 
-                (char *)NULL);
-        return TCL_ERROR;
-    }   
-    if (Blt_GetCount(interp, restorePtr->argv[1], COUNT_POS, &count)
-        != TCL_OK) {
-        RestoreError(interp, restorePtr);
-        return TCL_ERROR;
+    if (colPtr->views == NULL) {
+        return;
     }
-    /* FIXME: What are you doing w/ numRows and numCols? */
-    numRows = count;
-    if (Blt_GetCount(interp, restorePtr->argv[2], COUNT_POS, &count)!=TCL_OK) {
-        RestoreError(interp, restorePtr);
-        return TCL_ERROR;
+    for (link = Blt_Chain_FirstLink(colPtr->views); link != NULL; 
+         link = next) {
+        ColumnView *viewPtr;
+
+        next = Blt_Chain_NextLink(link);
+        viewPtr = Blt_Chain_GetValue(link);
+        if ((tablePtr != NULL) && (viewPtr->tablePtr != tablePtr)) {
+            continue;
+        }
+        (*viewPtr->proc)(viewPtr->clientData, colPtr->data, numValues, 
+                         TABLE_VIEW_DELETED);
+        FreeView(viewPtr);
     }
-    numCols = count;
-    if ((restorePtr->flags & TABLE_RESTORE_OVERWRITE) == 0) {
-        numRows += restorePtr->numRows;
-        numCols += restorePtr->numCols;
+}
+
+/*
+ * RefreshColumnViews --
+ *
+ *      Called after rows are added, deleted, or moved.  The cells of the
+ *      new rows, if any, are set to NaN.  Packs the table if the rows are
+ *      no longer in storage order and hands the (possibly moved) arrays to
+ *      the views.
+ */
+static void
+RefreshColumnViews(Table *tablePtr, Blt_Chain newRows)
+{
+    Column *colPtr;
+    int hasViews;
+
+    hasViews = FALSE;
+    for (colPtr = tablePtr->corePtr->columns.headPtr; colPtr != NULL;
+         colPtr = colPtr->nextPtr) {
+        if (colPtr->views != NULL) {
+            hasViews = TRUE;
+            break;
+        }
     }
-    if (Blt_GetInt64(interp, restorePtr->argv[3], &time) != TCL_OK){
-        RestoreError(interp, restorePtr);
-        return TCL_ERROR;
+    if (!hasViews) {
+        return;
     }
-    restorePtr->ctime = time;
-    if (Blt_GetInt64(interp, restorePtr->argv[4], &time) != TCL_OK){
-        RestoreError(interp, restorePtr);
-        return TCL_ERROR;
+    if (newRows != NULL) {
+        for (colPtr = tablePtr->corePtr->columns.headPtr; colPtr != NULL;
+             colPtr = colPtr->nextPtr) {
+            Blt_ChainLink link;
+
+            if ((colPtr->views == NULL) || (colPtr->data == NULL)) {
+                continue;
+            }
+            for (link = Blt_Chain_FirstLink(newRows); link != NULL; 
+                 link = Blt_Chain_NextLink(link)) {
+                Row *rowPtr;
+
+                rowPtr = Blt_Chain_GetValue(link);
+                ((double *)colPtr->data)[rowPtr->offset] = Blt_NaN();
+            }
+        }
+    }
+    if (!RowsInStorageOrder(&tablePtr->corePtr->rows)) {
+        blt_table_pack(tablePtr);       /* Refreshes the views. */
+        return;
+    }
+    for (colPtr = tablePtr->corePtr->columns.headPtr; colPtr != NULL;
+         colPtr = colPtr->nextPtr) {
+        if (colPtr->views == NULL) {
+            continue;
+        }
+        if ((colPtr->data == NULL) && (tablePtr->corePtr->rows.numUsed > 0)) {
+            long i;
+
+            if (!AllocDenseStorage(tablePtr, colPtr)) {
+                DestroyColumnViews(NULL, colPtr, 0);
+                continue;
+            }
+            for (i = 0; i < tablePtr->corePtr->rows.numAllocated; i++) {
+                ((double *)colPtr->data)[i] = Blt_NaN();
+            }
+        }
+        NotifyColumnViews(tablePtr, colPtr, TABLE_VIEW_MOVED);
     }
-    restorePtr->mtime = time;
-    return TCL_OK;
 }
 
-static int
-RestoreColumn(Tcl_Interp *interp, BLT_TABLE table, RestoreData *restorePtr)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_create_view --
+ *
+ *      Creates a view of the values of a double or time column.  The
+ *      view procedure is called right away with the array of values, and
+ *      again whenever the array is moved, resized, or changed (see
+ *      BLT_TABLE_VIEW).  The rows of the table are packed into storage
+ *      order if necessary.  The client may write into the array, but
+ *      must then call blt_table_sync_view.
+ *
+ * Results:
+ *      Returns the token of the view.  If the column isn't a double or
+ *      time column, NULL is returned and an error message is left in
+ *      interp.
+ *
+ *---------------------------------------------------------------------------
+ */
+BLT_TABLE_VIEW
+blt_table_create_view(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
+                      BLT_TABLE_VIEW_PROC *proc, ClientData clientData)
 {
-    long index;
-    Column *colPtr;
-    int type;
-    const char *label;
-    int isNew;
-    Blt_HashEntry *hPtr;
+    ColumnView *viewPtr;
+    Rows *rowsPtr;
+    long i;
 
-    /* c index label type ?tagList? */
-    if ((restorePtr->argc < 4) || (restorePtr->argc > 5)) {
-        RestoreError(interp, restorePtr);
-        Tcl_AppendResult(interp, "wrong # elements in restore column entry", 
-                (char *)NULL);
-        return TCL_ERROR;
-    }   
-    if (Blt_GetLong(interp, restorePtr->argv[1], &index) != TCL_OK) {
-        RestoreError(interp, restorePtr);
-        return TCL_ERROR;
+    if ((colPtr->type != TABLE_COLUMN_TYPE_DOUBLE) &&
+        (colPtr->type != TABLE_COLUMN_TYPE_TIME)) {
+        Tcl_AppendResult(interp, "can't view column \"", colPtr->label, 
+                "\": not a double or time column", (char *)NULL);
+        return NULL;
     }
-    label = restorePtr->argv[2];
-    colPtr = blt_table_get_column_by_label(table, label);
-    if ((colPtr == NULL) || 
-        ((restorePtr->flags & TABLE_RESTORE_OVERWRITE) == 0)) {
-        colPtr = blt_table_create_column(interp, table, label);
-        if (colPtr == NULL) {
-            RestoreError(interp, restorePtr);
-            Tcl_AppendResult(interp, "can't append column \"", label, "\"",
-                             (char *)NULL);
-            return TCL_ERROR;
+    rowsPtr = &tablePtr->corePtr->rows;
+    if (colPtr->sharePtr != NULL) {
+        UnshareColumn(tablePtr->corePtr, colPtr);
+    }
+    if ((colPtr->flags & TABLE_COLUMN_MAPPED) &&
+        (!UnmapColumn(tablePtr->corePtr, colPtr))) {
+        Tcl_AppendResult(interp, "can't view column \"", colPtr->label,
+                "\": out of memory", (char *)NULL);
+        return NULL;
+    }
+    if ((colPtr->data == NULL) && (rowsPtr->numAllocated > 0) &&
+        (!AllocDenseStorage(tablePtr, colPtr))) {
+        Tcl_AppendResult(interp, "can't view column \"", colPtr->label,
+                "\": out of memory", (char *)NULL);
+        return NULL;
+    }
+    if (!RowsInStorageOrder(rowsPtr)) {
+        blt_table_pack(tablePtr);
+    }
+    /* Empty cells hold NaN, so that they read as empty in the array. */
+    for (i = 0; i < rowsPtr->numUsed; i++) {
+        if (!DenseIsSet(colPtr, i)) {
+            ((double *)colPtr->data)[i] = Blt_NaN();
         }
     }
-    hPtr = Blt_CreateHashEntry(&restorePtr->colIndices,(intptr_t)index, &isNew);
-    Blt_SetHashValue(hPtr, colPtr);
+    viewPtr = Blt_AssertCalloc(1, sizeof(ColumnView));
+    viewPtr->tablePtr = tablePtr;
+    viewPtr->colPtr = colPtr;
+    viewPtr->proc = proc;
+    viewPtr->clientData = clientData;
+    if (colPtr->views == NULL) {
+        colPtr->views = Blt_Chain_Create();
+    }
+    viewPtr->link = Blt_Chain_Append(colPtr->views, viewPtr);
+    (*proc)(clientData, colPtr->data, rowsPtr->numUsed, TABLE_VIEW_MOVED);
+    return viewPtr;
+}
 
-    type = blt_table_name_to_column_type(restorePtr->argv[3]);
-    if (type == TABLE_COLUMN_TYPE_UNKNOWN) {
-        RestoreError(interp, restorePtr);
-        Tcl_AppendResult(interp, "bad column type \"", restorePtr->argv[3], 
-                         "\"", (char *)NULL);
-        return TCL_ERROR;
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_delete_view --
+ *
+ *      Deletes the view.  The view procedure isn't called.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_delete_view(Table *tablePtr, ColumnView *viewPtr)
+{
+    FreeView(viewPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_sync_view --
+ *
+ *      Updates the column after the client has written into the array
+ *      of the view.  NaN values become empty cells.  Cached strings,
+ *      statistics, keys, and the index of the column are discarded.  A
+ *      write or unset trace is fired for each non-empty or cleared cell,
+ *      collected into a single batch.  The procedures of other views of
+ *      the column are called.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_sync_view(Table *tablePtr, ColumnView *viewPtr)
+{
+    Column *colPtr;
+    Row *rowPtr;
+    double *array;
+
+    colPtr = viewPtr->colPtr;
+    array = colPtr->data;
+    if (array == NULL) {
+        return;
     }
-    colPtr->type = type;
-    if ((restorePtr->argc == 5) && 
-        ((restorePtr->flags & TABLE_RESTORE_NO_TAGS) == 0)) {
-        int i, argc;
-        const char **argv;
+    FreeColumnStats(colPtr);
+    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
+        InvalidateKeys(tablePtr, colPtr);
+    }
+    if (colPtr->indexPtr != NULL) {
+        InvalidateIndex(colPtr);
+    }
+    viewPtr->flags |= VIEW_SYNCING;
+    blt_table_begin_batch(tablePtr);
+    for (rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL; 
+         rowPtr = rowPtr->nextPtr) {
+        long offset;
 
-        if (Tcl_SplitList(interp, restorePtr->argv[4], &argc, &argv)!= TCL_OK) {
-            RestoreError(interp, restorePtr);
-            return TCL_ERROR;
+        offset = rowPtr->offset;
+        if ((colPtr->strings != NULL) && (colPtr->strings[offset] != NULL)) {
+            Blt_Free(colPtr->strings[offset]);
+            colPtr->strings[offset] = NULL;
         }
-        
-        for (i = 0; i < argc; i++) {
-            if (blt_table_set_column_tag(interp, table, colPtr, argv[i]) 
-                != TCL_OK) {
-                Tcl_Free((char *)argv);
-                return TCL_ERROR;
+        if (isnan(array[offset])) {
+            if (DenseIsSet(colPtr, offset)) {
+                DenseClear(colPtr, offset);
+                CallTraces(tablePtr, rowPtr, colPtr, TABLE_TRACE_UNSETS);
             }
+        } else {
+            DenseSet(colPtr, offset);
+            CallTraces(tablePtr, rowPtr, colPtr, TABLE_TRACE_WRITES);
         }
-        Tcl_Free((char *)argv);
     }
-    return TCL_OK;
+    blt_table_end_batch(tablePtr);
+    viewPtr->flags &= ~VIEW_SYNCING;
 }
 
-static int
-RestoreRow(Tcl_Interp *interp, BLT_TABLE table, RestoreData *restorePtr)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_value_exists --
+ *
+ *      Indicates if a value exists for a given row,column offset in the
+ *      tuple.  Note that this routine does not fire read traces.
+ *
+ * Results:
+ *      Returns 1 is a value exists, 0 otherwise.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_value_exists(Table *tablePtr, Row *rowPtr, Column *colPtr)
 {
-    BLT_TABLE_ROW row;
-    Blt_HashEntry *hPtr;
-    const char *label;
-    int isNew;
-    long index;
+    if ((colPtr == NULL) || (rowPtr == NULL)) {
+        return 0;
+    }
+    return !IsEmpty(rowPtr, colPtr);
+}
 
-    /* r index label ?tagList? */
-    if ((restorePtr->argc < 3) || (restorePtr->argc > 4)) {
-        RestoreError(interp, restorePtr);
-        Tcl_AppendResult(interp, "wrong # of elements in restore row entry", 
-                         (char *)NULL);
-        return TCL_ERROR;
-    }   
-    if (Blt_GetLong(interp, restorePtr->argv[1], &index) != TCL_OK) {
-        RestoreError(interp, restorePtr);
-        return TCL_ERROR;
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_extend_rows --
+ *
+ *      Adds new rows to the table.  Rows are slots in an array of Rows.  The
+ *      array grows by doubling its size, so there may be more slots than
+ *      needed (# rows).
+ *
+ * Results:
+ *      Returns TCL_OK is the tuple is resized and TCL_ERROR if an not enough
+ *      memory was available.
+ *
+ * Side Effects:
+ *      If more rows are needed, the array which holds the tuples is
+ *      reallocated by doubling its size.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_extend_rows(Tcl_Interp *interp, Table *tablePtr, size_t numExtra, 
+                      Row **rows)
+{
+    long i;
+    Blt_Chain chain;
+    Blt_ChainLink link;
+
+    if (numExtra == 0) {
+        return TCL_OK;
     }
-    label = restorePtr->argv[2];
-    row = blt_table_get_row_by_label(table, label);
-    if ((row == NULL) || ((restorePtr->flags & TABLE_RESTORE_OVERWRITE) == 0)) {
-        row = blt_table_create_row(interp, table, label);
-        if (row == NULL) {
-            RestoreError(interp, restorePtr);
-            Tcl_AppendResult(interp, "can't append row \"", label, "\"",
-                     (char *)NULL);
-            return TCL_ERROR;
+    chain = Blt_Chain_Create();
+    if (!ExtendRows(tablePtr, numExtra, chain)) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "can't extend table by ", 
+                Blt_Ltoa(numExtra), " rows: out of memory.", (char *)NULL);
         }
+        Blt_Chain_Destroy(chain);
+        return TCL_ERROR;
     }
-    hPtr = Blt_CreateHashEntry(&restorePtr->rowIndices,(intptr_t)index, &isNew);
-    Blt_SetHashValue(hPtr, row);
-    if ((restorePtr->argc == 5) && 
-        ((restorePtr->flags & TABLE_RESTORE_NO_TAGS) == 0)) {
-        const char **argv;
-        int argc;
-        int i;
+    RefreshColumnViews(tablePtr, chain);
+    /* For each new row generate a notify event. */
+    for (i = 0, link = Blt_Chain_FirstLink(chain); link != NULL; 
+         link = Blt_Chain_NextLink(link), i++) {
+        Row *rowPtr;
 
-        if (Tcl_SplitList(interp, restorePtr->argv[3], &argc, &argv)!= TCL_OK) {
-            RestoreError(interp, restorePtr);
-            return TCL_ERROR;
-        }
-        for (i = 0; i < argc; i++) {
-            if (blt_table_set_row_tag(interp, table, row, argv[i]) != TCL_OK) {
-                Tcl_Free((char *)argv);
-                return TCL_ERROR;
-            }
+        rowPtr = Blt_Chain_GetValue(link);
+        if (rows != NULL) {
+            rows[i] = rowPtr;
         }
-        Tcl_Free((char *)argv);
+        NotifyRowChanged(tablePtr, rowPtr, TABLE_NOTIFY_ROWS_CREATED);
     }
+    assert(Blt_Chain_GetLength(chain) > 0);
+    Blt_Chain_Destroy(chain);
     return TCL_OK;
 }
 
-static int
-RestoreValue(Tcl_Interp *interp, BLT_TABLE table, RestoreData *restorePtr)
+int
+blt_table_delete_row(Table *tablePtr, Row *rowPtr)
+{
+    NotifyRowChanged(tablePtr, rowPtr, TABLE_NOTIFY_ROWS_DELETED);
+    UnsetRowValues(tablePtr, rowPtr);
+    ClearTagsFromRow(tablePtr, rowPtr);
+    blt_table_clear_row_traces(tablePtr, rowPtr);
+    ClearRowNotifiers(tablePtr, rowPtr);
+    if (tablePtr->corePtr->batchPtr != NULL) {
+        ForgetBatchRow(tablePtr->corePtr, rowPtr);
+    }
+    DeleteRow(&tablePtr->corePtr->rows, rowPtr);
+    RefreshColumnViews(tablePtr, NULL);
+    return TCL_OK;
+}
+
+BLT_TABLE_ROW
+blt_table_create_row(Tcl_Interp *interp, BLT_TABLE table, const char *label)
 {
-    Blt_HashEntry *hPtr;
-    int result;
     Row *rowPtr;
-    Column *colPtr;
-    Value *valuePtr;
-    long index;
 
-    /* d row column value */
-    if (restorePtr->argc != 4) {
-        RestoreError(interp, restorePtr);
-        Tcl_AppendResult(interp, "wrong # elements in restore data entry", 
-                (char *)NULL);
-        return TCL_ERROR;
-    }   
-    if (Blt_GetLong(interp, restorePtr->argv[1], &index) != TCL_OK) {
-        RestoreError(interp, restorePtr);
-        return TCL_ERROR;
-    }
-    hPtr = Blt_FindHashEntry(&restorePtr->rowIndices, (intptr_t)index);
-    if (hPtr == NULL) {
-        RestoreError(interp, restorePtr);
-        Tcl_AppendResult(interp, "bad row index \"", restorePtr->argv[1], "\"",
-                         (char *)NULL);
-        return TCL_ERROR;
-    }
-    rowPtr = Blt_GetHashValue(hPtr);
-    if (Blt_GetLong(interp, restorePtr->argv[2], &index) != TCL_OK) {
-        RestoreError(interp, restorePtr);
-        return TCL_ERROR;
-    }
-    hPtr = Blt_FindHashEntry(&restorePtr->colIndices, (intptr_t)index);
-    if (hPtr == NULL) {
-        RestoreError(interp, restorePtr);
-        Tcl_AppendResult(interp, "bad column index \"", restorePtr->argv[2], 
-                "\"", (char *)NULL);
-        return TCL_ERROR;
+    rowPtr = NULL;                      /* Suppress compiler warning. */
+    if (blt_table_extend_rows(interp, table, 1, &rowPtr) != TCL_OK) {
+        return NULL;
     }
-    colPtr = Blt_GetHashValue(hPtr);
-    valuePtr = GetValue(table, rowPtr, colPtr);
-    result = SetValueFromString(interp, colPtr->type, restorePtr->argv[3], -1,
-        valuePtr);
-    if (result != TCL_OK) {
-        RestoreError(interp, restorePtr);
+    if (label != NULL) {
+        if (blt_table_set_row_label(interp, table, rowPtr, label) != TCL_OK) {
+            blt_table_delete_row(table, rowPtr);
+            return NULL;
+        }
     }
-    return result;
+    return rowPtr;
 }
 
-BLT_TABLE_ROW *
-blt_table_get_row_map(Table *tablePtr)  
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_move_rows --
+ *
+ *      Move one of more rows to a new location in the tuple.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+int
+blt_table_move_rows(Tcl_Interp *interp, Table *tablePtr, Row *destPtr, 
+                   Row *firstPtr, Row *lastPtr, int after)
 {
-    if (tablePtr->corePtr->rows.flags & REINDEX) {
-        ResetRowMap(&tablePtr->corePtr->rows);
+    Rows *rowsPtr;
+
+    rowsPtr = &tablePtr->corePtr->rows;
+    if (!MoveRows(rowsPtr, destPtr, firstPtr, lastPtr, after)) {
+        Tcl_AppendResult(interp, "can't allocate new map for \"", 
+                blt_table_name(tablePtr), "\"", (char *)NULL);
+        return TCL_ERROR;
     }
-    return tablePtr->corePtr->rows.map;
+    RefreshColumnViews(tablePtr, NULL);
+    NotifyRowChanged(tablePtr, NULL, TABLE_NOTIFY_ROWS_MOVED);
+    return TCL_OK;
 }
 
-BLT_TABLE_COLUMN *
-blt_table_get_column_map(Table *tablePtr)  
+void
+blt_table_set_row_map(Table *tablePtr, Row **map)
 {
-    if (tablePtr->corePtr->columns.flags & REINDEX) {
-        ResetColumnMap(&tablePtr->corePtr->columns);
-    }
-    return tablePtr->corePtr->columns.map;
+    ReplaceRowMap(&tablePtr->corePtr->rows, map);
+    RefreshColumnViews(tablePtr, NULL);
+    NotifyRowChanged(tablePtr, NULL, TABLE_NOTIFY_ROWS_MOVED);
 }
 
-Blt_Chain
-blt_table_get_row_tags(Table *tablePtr, Row *rowPtr)  
+void
+blt_table_sort_init(Table *tablePtr, BLT_TABLE_SORT_ORDER *order, 
+                    long numColumns, unsigned int flags)
 {
-    Blt_Chain chain;
+    long i;
 
-    chain = Blt_Chain_Create();
-    Blt_Tags_AppendTagsToChain(tablePtr->rowTags, rowPtr, chain);
-    return chain;
+    tablePtr->sortOrder = order;
+    tablePtr->numSortColumns = numColumns;
+    tablePtr->sortFlags = flags;
+    for (i = 0; i < numColumns; i++) {
+        BLT_TABLE_SORT_ORDER *sortPtr;
+
+        sortPtr = order + i;
+        sortPtr->clientData = tablePtr;
+        sortPtr->cmpProc = blt_table_get_compare_proc(tablePtr, 
+                sortPtr->column, flags);
+    }
 }
 
-Blt_HashTable *
-blt_table_get_row_tag_table(Table *tablePtr)  
+void
+blt_table_sort_finish()
 {
-    return Blt_Tags_GetTable(tablePtr->rowTags);
+    /* Sort keys are released at the end of each sort.  Nothing is left
+     * to clean up. */
 }
 
-Blt_HashTable *
-blt_table_get_column_tag_table(Table *tablePtr)  
+BLT_TABLE_ROW *
+blt_table_sort_rows(Table *tablePtr)
 {
-    return Blt_Tags_GetTable(tablePtr->columnTags);
+    Rows *rowsPtr;
+    Row **map;
+
+    /* Make a copy of the current row map, sort it, and return it. */
+    rowsPtr = &tablePtr->corePtr->rows;
+    if (rowsPtr->flags & REINDEX) {
+        ResetRowMap(rowsPtr);
+    }
+    map = Blt_Malloc(sizeof(Row *) * rowsPtr->numAllocated);
+    if (map == NULL) {
+        return NULL;
+    }
+    memcpy(map, rowsPtr->map, sizeof(Row *) * rowsPtr->numAllocated);
+    SortRows(tablePtr, map, rowsPtr->numUsed);
+    return map;
 }
 
-Blt_Chain
-blt_table_get_column_tags(Table *tablePtr, Column *colPtr)  
+void
+blt_table_sort_row_map(Table *tablePtr, long numRows, BLT_TABLE_ROW *rows)
 {
-    Blt_Chain chain;
-
-    chain = Blt_Chain_Create();
-    Blt_Tags_AppendTagsToChain(tablePtr->columnTags, colPtr, chain);
-    return chain;
+    SortRows(tablePtr, rows, numRows);
 }
 
-Blt_Chain
-blt_table_get_tagged_columns(Table *tablePtr, const char *tag)  
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_partial_sort_row_map --
+ *
+ *      Sorts the first numSorted rows of the array, according to the sort
+ *      order set by blt_table_sort_init.  They are the same as the first
+ *      numSorted rows of a full sort.  The remaining rows follow in their
+ *      original order.  This is much faster than sorting all the rows
+ *      when only the top rows are needed.
+ *
+ *---------------------------------------------------------------------------
+ */
+void
+blt_table_partial_sort_row_map(Table *tablePtr, long numRows, 
+                               BLT_TABLE_ROW *rows, long numSorted)
 {
-    return Blt_Tags_GetItemList(tablePtr->columnTags, tag);
+    PartialSortRows(tablePtr, rows, numRows, numSorted);
 }
 
-Blt_Chain
-blt_table_get_tagged_rows(Table *tablePtr, const char *tag)  
+/*
+ *---------------------------------------------------------------------------
+ *
+ * HashCell --
+ *
+ *      Computes a 64-bit hash of the value in a non-empty cell.  Numeric
+ *      values are hashed by their internal representation, strings by
+ *      their bytes.
+ *
+ *---------------------------------------------------------------------------
+ */
+static uint64_t
+HashCell(Table *tablePtr, Row *rowPtr, Column *colPtr)
 {
-    return Blt_Tags_GetItemList(tablePtr->rowTags, tag);
-}
+    uint64_t hash;
 
+    if (IsDenseColumn(colPtr)) {
+        Value value;
 
-int 
-blt_table_same_object(Table *tablePtr1, Table *tablePtr2)  
-{
-    return tablePtr1->corePtr == tablePtr2->corePtr;
+        GetCellDatum(rowPtr, colPtr, &value);
+        switch (colPtr->type) {
+        case TABLE_COLUMN_TYPE_DOUBLE:
+        case TABLE_COLUMN_TYPE_TIME:
+            if (value.datum.d == 0.0) {
+                value.datum.d = 0.0;    /* Same hash for -0.0 and 0.0 */
+            }
+            memcpy(&hash, &value.datum.d, sizeof(hash));
+            break;
+        case TABLE_COLUMN_TYPE_INT64:
+            hash = (uint64_t)value.datum.i64;
+            break;
+        default:
+            hash = (uint64_t)value.datum.l;
+            break;
+        }
+    } else {
+        const unsigned char *p, *pend;
+        unsigned int length;
+
+        /* FNV-1a */
+        p = (const unsigned char *)GetCellString(tablePtr, rowPtr, colPtr, 
+                                                 &length);
+        hash = UINT64_C(0xcbf29ce484222325);
+        for (pend = p + length; p < pend; p++) {
+            hash ^= *p;
+            hash *= UINT64_C(0x100000001b3);
+        }
+    }
+    /* Mix the bits so that similar values select different registers. */
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 33;
+    return hash;
 }
 
-BLT_TABLE_ROW
-blt_table_get_row_by_index(Table *tablePtr, long index)  
+static void
+AddDistinct(ColumnStats *statsPtr, uint64_t hash)
 {
-    if (tablePtr->corePtr->rows.flags & REINDEX) {
-        ResetRowMap(&tablePtr->corePtr->rows);
+    size_t i;
+    int rank;
+
+    /* The high bits select the register.  The register keeps the highest
+     * position of the first 1 bit seen in the remaining bits. */
+    i = (size_t)(hash >> (64 - STATS_HLL_BITS));
+    hash <<= STATS_HLL_BITS;
+    for (rank = 1; rank <= (64 - STATS_HLL_BITS); rank++) {
+        if (hash & (UINT64_C(1) << 63)) {
+            break;
+        }
+        hash <<= 1;
     }
-    if (index < blt_table_num_rows(tablePtr)) {
-        return blt_table_row(tablePtr, index);
+    if (rank > statsPtr->registers[i]) {
+        statsPtr->registers[i] = (unsigned char)rank;
     }
-    return NULL;
 }
 
-BLT_TABLE_COLUMN
-blt_table_get_column_by_index(Table *tablePtr, long index)  
+static long
+EstimateDistinct(ColumnStats *statsPtr)
 {
-    if (tablePtr->corePtr->columns.flags & REINDEX) {
-        ResetColumnMap(&tablePtr->corePtr->columns);
+    double m, sum, estimate;
+    size_t i, numZeros;
+
+    if (statsPtr->numValues == 0) {
+        return 0;
     }
-    if (index < blt_table_num_columns(tablePtr)) {
-        return blt_table_column(tablePtr, index);
+    m = (double)STATS_HLL_REGISTERS;
+    sum = 0.0;
+    numZeros = 0;
+    for (i = 0; i < STATS_HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -(int)statsPtr->registers[i]);
+        if (statsPtr->registers[i] == 0) {
+            numZeros++;
+        }
     }
-    return NULL;
+    estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+    if ((estimate <= (2.5 * m)) && (numZeros > 0)) {
+        /* Small range correction: use linear counting. */
+        estimate = m * log(m / (double)numZeros);
+    }
+    if (estimate > (double)statsPtr->numValues) {
+        estimate = (double)statsPtr->numValues;
+    }
+    return (long)(estimate + 0.5);
 }
 
-BLT_TABLE_ROWCOLUMN_SPEC
-blt_table_row_spec(BLT_TABLE table, Tcl_Obj *objPtr, const char **sp)
+static double
+GetCellNumber(Row *rowPtr, Column *colPtr)
 {
-    const char *p;
-    const char *string;
-    long index;
-    char c;
+    Value value;
 
-    string = Tcl_GetString(objPtr);
-    *sp = string;
-    c = string[0];
-    if (c == '@') {
-        *sp = string + 1;
-        return TABLE_SPEC_TAG;
-    } else if ((isdigit(UCHAR(c))) && 
-               (Blt_GetLongFromObj(NULL, objPtr, &index) == TCL_OK)) {
-        return TABLE_SPEC_INDEX;
-    } else if ((c == 'r') && (strncmp(string, "range:", 6) == 0)) {
-        *sp = string + 6;
-        return TABLE_SPEC_RANGE;
-    } else if ((c == 'i') && (strncmp(string, "index:", 6) == 0)) {
-        *sp = string + 6;
-        return TABLE_SPEC_INDEX;
-    } else if ((c == 'l') && (strncmp(string, "label:", 6) == 0)) {
-        *sp = string + 6;
-        return TABLE_SPEC_LABEL;
-    } else if ((c == 't') && (strncmp(string, "tag:", 4) == 0)) {
-        *sp = string + 4;
-        return TABLE_SPEC_TAG;
-    } else if (blt_table_get_row_by_label(table, string) != NULL) {
-        return TABLE_SPEC_LABEL;
+    value.datum.l = 0;
+    GetDenseDatum(colPtr, rowPtr->offset, &value);
+    switch (colPtr->type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+        return value.datum.d;
+    case TABLE_COLUMN_TYPE_INT64:
+        return (double)value.datum.i64;
+    default:
+        return (double)value.datum.l;
     }
-    p = strchr(string, '-');
-    if (p != NULL) {
-        Tcl_Obj *rangeObjPtr;
-        BLT_TABLE_ROW row;
-
-        rangeObjPtr = Tcl_NewStringObj(string, p - string);
-        row = blt_table_get_row((Tcl_Interp *)NULL, table, rangeObjPtr);
-        Tcl_DecrRefCount(rangeObjPtr);
-        if (row != NULL) {
-            rangeObjPtr = Tcl_NewStringObj(p + 1, -1);
-            row = blt_table_get_row((Tcl_Interp *)NULL, table, rangeObjPtr);
-            Tcl_DecrRefCount(rangeObjPtr);
-            if (row != NULL) {
-                return TABLE_SPEC_RANGE;
-            }
-        }
-    } 
-    return TABLE_SPEC_UNKNOWN;
 }
 
-BLT_TABLE_COLUMN
-blt_table_first_column(Table *tablePtr)  
+static void
+FreeColumnStats(Column *colPtr)
 {
-    return tablePtr->corePtr->columns.headPtr;
+    if (colPtr->statsPtr != NULL) {
+        Blt_Free(colPtr->statsPtr);
+        colPtr->statsPtr = NULL;
+    }
 }
 
-BLT_TABLE_COLUMN
-blt_table_last_column(Table *tablePtr)  
+/*
+ *---------------------------------------------------------------------------
+ *
+ * AddStatsValue --
+ *
+ *      Adds the value just stored in the cell to the column statistics.
+ *      The new value is compared with the current limits.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+AddStatsValue(Table *tablePtr, Row *rowPtr, Column *colPtr)
 {
-    return tablePtr->corePtr->columns.tailPtr;
-}
+    ColumnStats *statsPtr;
+    BLT_TABLE_COMPARE_PROC *proc;
 
-BLT_TABLE_COLUMN
-blt_table_next_column(Column *colPtr)  
-{
-    return colPtr->nextPtr;
+    if (IsEmpty(rowPtr, colPtr)) {
+        return;
+    }
+    statsPtr = colPtr->statsPtr;
+    statsPtr->numValues++;
+    if (IsDenseColumn(colPtr)) {
+        statsPtr->sum += GetCellNumber(rowPtr, colPtr);
+    }
+    AddDistinct(statsPtr, HashCell(tablePtr, rowPtr, colPtr));
+    if (statsPtr->flags & STATS_LIMITS_DIRTY) {
+        return;                         /* Limits will be rescanned. */
+    }
+    if (statsPtr->minRowPtr == NULL) {
+        statsPtr->minRowPtr = statsPtr->maxRowPtr = rowPtr;
+        return;
+    }
+    proc = blt_table_get_compare_proc(tablePtr, colPtr, 0);
+    if ((*proc)(NULL, colPtr, rowPtr, statsPtr->minRowPtr) < 0) {
+        statsPtr->minRowPtr = rowPtr;
+    }
+    if ((*proc)(NULL, colPtr, rowPtr, statsPtr->maxRowPtr) > 0) {
+        statsPtr->maxRowPtr = rowPtr;
+    }
 }
 
-BLT_TABLE_COLUMN
-blt_table_previous_column(Column *colPtr)  
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RemoveStatsValue --
+ *
+ *      Removes the value about to be overwritten or unset from the column
+ *      statistics.  If the cell holds the minimum or maximum value, the
+ *      limits are marked to be rescanned.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+RemoveStatsValue(Table *tablePtr, Row *rowPtr, Column *colPtr)
 {
-    return colPtr->prevPtr;
+    ColumnStats *statsPtr;
+
+    if (IsEmpty(rowPtr, colPtr)) {
+        return;
+    }
+    statsPtr = colPtr->statsPtr;
+    statsPtr->numValues--;
+    if (IsDenseColumn(colPtr)) {
+        statsPtr->sum -= GetCellNumber(rowPtr, colPtr);
+    }
+    if ((rowPtr == statsPtr->minRowPtr) || (rowPtr == statsPtr->maxRowPtr)) {
+        statsPtr->flags |= STATS_LIMITS_DIRTY;
+    }
 }
 
-BLT_TABLE_ROW
-blt_table_first_row(Table *tablePtr)  
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetColumnStats --
+ *
+ *      Returns the cached statistics of the column.  If there are none,
+ *      they are computed from the column's values.  If the limits were
+ *      removed, only the limits are recomputed.
+ *
+ *---------------------------------------------------------------------------
+ */
+static ColumnStats *
+GetColumnStats(Table *tablePtr, Column *colPtr)
 {
-    return tablePtr->corePtr->rows.headPtr;
+    ColumnStats *statsPtr;
+    BLT_TABLE_COMPARE_PROC *proc;
+    Row *rowPtr;
+    int isNew;
+
+    statsPtr = colPtr->statsPtr;
+    isNew = (statsPtr == NULL);
+    if (isNew) {
+        statsPtr = Blt_AssertCalloc(1, sizeof(ColumnStats));
+        colPtr->statsPtr = statsPtr;
+    } else if ((statsPtr->flags & STATS_LIMITS_DIRTY) == 0) {
+        return statsPtr;
+    }
+    statsPtr->flags &= ~STATS_LIMITS_DIRTY;
+    statsPtr->minRowPtr = statsPtr->maxRowPtr = NULL;
+    proc = blt_table_get_compare_proc(tablePtr, colPtr, 0);
+    for (rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL; 
+         rowPtr = rowPtr->nextPtr) {
+        if (IsEmpty(rowPtr, colPtr)) {
+            continue;
+        }
+        if (isNew) {
+            statsPtr->numValues++;
+            if (IsDenseColumn(colPtr)) {
+                statsPtr->sum += GetCellNumber(rowPtr, colPtr);
+            }
+            AddDistinct(statsPtr, HashCell(tablePtr, rowPtr, colPtr));
+        }
+        if (statsPtr->minRowPtr == NULL) {
+            statsPtr->minRowPtr = statsPtr->maxRowPtr = rowPtr;
+            continue;
+        }
+        if ((*proc)(NULL, colPtr, rowPtr, statsPtr->minRowPtr) < 0) {
+            statsPtr->minRowPtr = rowPtr;
+        }
+        if ((*proc)(NULL, colPtr, rowPtr, statsPtr->maxRowPtr) > 0) {
+            statsPtr->maxRowPtr = rowPtr;
+        }
+    }
+    return statsPtr;
 }
 
-BLT_TABLE_ROW
-blt_table_last_row(Table *tablePtr)  
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_get_column_stats --
+ *
+ *      Gets the statistics of the column's values: the number of values,
+ *      their sum, the rows with the minimum and maximum values, and the
+ *      estimated number of distinct values.  Empty cells are ignored.
+ *      The statistics are cached in the column, so only the first call
+ *      scans the column.
+ *
+ * Results:
+ *      Always returns TCL_OK.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_get_column_stats(Tcl_Interp *interp, Table *tablePtr, 
+                           Column *colPtr, BLT_TABLE_COLUMN_STATS *resultPtr)
 {
-    return tablePtr->corePtr->rows.tailPtr;
+    ColumnStats *statsPtr;
+
+    statsPtr = GetColumnStats(tablePtr, colPtr);
+    resultPtr->numValues = statsPtr->numValues;
+    resultPtr->sum = statsPtr->sum;
+    resultPtr->minRow = statsPtr->minRowPtr;
+    resultPtr->maxRow = statsPtr->maxRowPtr;
+    resultPtr->numDistinct = EstimateDistinct(statsPtr);
+    return TCL_OK;
 }
 
-BLT_TABLE_ROW
-blt_table_next_row(Row *rowPtr)  
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_get_column_limits --
+ *
+ *      Gets the minimum and maximum values of the column.  Empty cells
+ *      are ignored.  If the column is indexed, the limits are the first
+ *      and last rows of the index.  Otherwise they are taken from the
+ *      column statistics.
+ *
+ * Results:
+ *      Always returns TCL_OK.  The limits are NULL if the column has no
+ *      values.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_get_column_limits(Tcl_Interp *interp, Table *tablePtr, Column *colPtr,
+                          Tcl_Obj **minObjPtrPtr, Tcl_Obj **maxObjPtrPtr)
 {
-    return rowPtr->nextPtr;
+    ColumnStats *statsPtr;
+
+    *minObjPtrPtr = *maxObjPtrPtr = NULL;
+    if (blt_table_num_rows(tablePtr) == 0) {
+        return TCL_OK;
+    }
+    if ((colPtr->indexPtr != NULL) && 
+        (GetIndex(tablePtr->corePtr, colPtr)->numRows > 0)) {
+        ColumnIndex *indexPtr;
+        long last;
+
+        /* The first and last rows of the index hold the limits.  Skip
+         * the NaNs at the end of the index. */
+        indexPtr = colPtr->indexPtr;
+        last = indexPtr->numRows - 1;
+        if (IsDenseColumn(colPtr)) {
+            while (last > 0) {
+                Value value;
+
+                GetDenseDatum(colPtr, indexPtr->rows[last]->offset, &value);
+                if (((colPtr->type != TABLE_COLUMN_TYPE_DOUBLE) &&
+                     (colPtr->type != TABLE_COLUMN_TYPE_TIME)) ||
+                    (value.datum.d == value.datum.d)) {
+                    break;
+                }
+                last--;
+            }
+        }
+        *minObjPtrPtr = blt_table_get_obj(tablePtr, indexPtr->rows[0], colPtr);
+        *maxObjPtrPtr = blt_table_get_obj(tablePtr, indexPtr->rows[last], 
+                                          colPtr);
+        return TCL_OK;
+    }
+    /* Otherwise the limits are cached in the column statistics. */
+    statsPtr = GetColumnStats(tablePtr, colPtr);
+    if (statsPtr->minRowPtr == NULL) {
+        return TCL_OK;                  /* Column has no values. */
+    }
+    *minObjPtrPtr = blt_table_get_obj(tablePtr, statsPtr->minRowPtr, colPtr);
+    *maxObjPtrPtr = blt_table_get_obj(tablePtr, statsPtr->maxRowPtr, colPtr);
+    return TCL_OK;
 }
 
-BLT_TABLE_ROW
-blt_table_previous_row(Row *rowPtr)  
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_delete_column --
+ *
+ *      Remove the designated column from the table.  The actual space
+ *      contained by the column isn't freed.  The map is compressed.
+ *      Tcl_Objs stored as column values are released.  Traces and tags
+ *      associated with the column are removed.
+ *
+ * Side Effects:
+ *      Traces may fire when column values are unset.  Also notifier events
+ *      may be triggered, indicating the column has been deleted.
+ *
+ *---------------------------------------------------------------------------
+ */
+int
+blt_table_delete_column(Table *tablePtr, Column *colPtr)
 {
-    return rowPtr->prevPtr;
+    /* If the deleted column is a primary key, the generated keytables
+     * are now invalid. So remove them. */
+    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
+        blt_table_unset_keys(tablePtr);
+    }
+    NotifyColumnChanged(tablePtr, colPtr, TABLE_NOTIFY_COLUMNS_DELETED);
+    blt_table_clear_column_traces(tablePtr, colPtr);
+    Blt_Tags_ClearTagsFromItem(tablePtr->columnTags, colPtr);
+    ClearColumnNotifiers(tablePtr, colPtr);
+    if (tablePtr->corePtr->batchPtr != NULL) {
+        ForgetBatchColumn(tablePtr->corePtr, colPtr);
+    }
+    DeleteColumn(tablePtr, colPtr);
+    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_iterate_rows --
+ * blt_table_extend_columns --
  *
- *      Returns the id of the first row derived from the given tag,
- *      label or index represented in objPtr.  
+ *      Adds new columns to the table.  Columns are slots in an array of
+ *      Columns.  The array columns by doubling its size, so there may be more
+ *      slots than needed (# columns).
  *
  * Results:
- *      Returns the row location of the first item.  If no row 
- *      can be found, then -1 is returned and an error message is
- *      left in the interpreter.
+ *      Returns TCL_OK is the tuple is resized and TCL_ERROR if an
+ *      not enough memory was available.
+ *
+ * Side Effects:
+ *      If more columns are needed, the array which holds the tuples is
+ *      reallocated by doubling its size.  
  *
  *---------------------------------------------------------------------------
  */
 int
-blt_table_iterate_rows(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr, 
-                      BLT_TABLE_ITERATOR *iterPtr)
+blt_table_extend_columns(Tcl_Interp *interp, BLT_TABLE table, size_t numExtra, 
+                        Column **columns)
 {
-    const char *tag, *p;
-    long index;
-    BLT_TABLE_ROWCOLUMN_SPEC spec;
-    Rows *rowsPtr;
-    memset(iterPtr, 0, sizeof(BLT_TABLE_ITERATOR));
-    iterPtr->table = table;
-    iterPtr->type = TABLE_ITERATOR_INDEX;
-    iterPtr->link = NULL;
-    iterPtr->numEntries = 0;
-
-    spec = blt_table_row_spec(table, objPtr, &tag);
-    rowsPtr = blt_table_rows(table);
-    if (rowsPtr->flags & REINDEX) {
-        ResetRowMap(rowsPtr);
-    }
-    switch (spec) {
-    case TABLE_SPEC_INDEX:
-        {
-            int result;
-
-            p = Tcl_GetString(objPtr);
-            if (p == tag) {
-                result = Blt_GetLongFromObj(NULL, objPtr, &index);
-            } else {
-                result = Blt_GetLong(NULL, (char *)tag, &index);
-            }
-            if (result != TCL_OK) {
-                if (interp != NULL) {
-                    Tcl_AppendResult(interp, "badly formed row index \"", tag, 
-                                     "\"", (char *)NULL);
-                }
-                return TCL_ERROR;
-            }
-            if (index >= blt_table_num_rows(table)) {
-                if (interp != NULL) {
-                    Tcl_AppendResult(interp, "bad row index \"", 
-                                     Tcl_GetString(objPtr), "\"", (char *)NULL);
-                }
-                return TCL_ERROR;
-            }               
-            iterPtr->firstPtr = iterPtr->lastPtr = blt_table_row(table, index);
-            if (iterPtr->firstPtr != NULL) {
-                iterPtr->numEntries = 1;
-            }
-            iterPtr->tag = tag;
-            return TCL_OK;
-        }
-        break;
+    size_t i;
+    Blt_Chain chain;
+    Blt_ChainLink link;
 
-    case TABLE_SPEC_LABEL:
-        iterPtr->tablePtr = blt_table_row_get_label_table(table, tag);
-        if (iterPtr->tablePtr != NULL) {
-            iterPtr->type = TABLE_ITERATOR_LABEL;
-            iterPtr->tag = tag;
-            iterPtr->numEntries = iterPtr->tablePtr->numEntries;
-            return TCL_OK;
+    chain = Blt_Chain_Create();
+    if (!ExtendColumns(table, numExtra, chain)) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "can't extend table by ", 
+                Blt_Ltoa(numExtra), " columns: out of memory.", (char *)NULL);
         }
-        break;
-        
-    case TABLE_SPEC_TAG:
-        {
-            Blt_Chain chain;
+        Blt_Chain_Destroy(chain);
+        return TCL_ERROR;
+    }
+    /* For each new column generate a notify event. */
+    for (i = 0, link = Blt_Chain_FirstLink(chain); link != NULL; 
+         link = Blt_Chain_NextLink(link), i++) {
+        Column *colPtr;
 
-            if (strcmp(tag, "all") == 0) {
-                Row *firstPtr, *lastPtr;
-                
-                iterPtr->type = TABLE_ITERATOR_ALL;
-                firstPtr = blt_table_first_row(table);
-                lastPtr = blt_table_last_row(table);
-                iterPtr->tag = tag;
-                if (firstPtr != NULL) {
-                    iterPtr->numEntries = lastPtr->index - firstPtr->index + 1;
-                }
-                iterPtr->firstPtr = firstPtr;
-                iterPtr->lastPtr = lastPtr;
-                return TCL_OK;
-            }
-            if (strcmp(tag, "end") == 0) {
-                iterPtr->tag = tag;
-                iterPtr->firstPtr = iterPtr->lastPtr = 
-                    blt_table_last_row(table);
-                if (iterPtr->firstPtr != NULL) {
-                    iterPtr->numEntries = 1;
-                }
-                return TCL_OK;
-            }
-            chain = blt_table_get_tagged_rows(iterPtr->table, tag);
-            if (chain != NULL) {
-                iterPtr->link = Blt_Chain_FirstLink(chain);
-                iterPtr->type = TABLE_ITERATOR_TAG;
-                iterPtr->tag = tag;
-                iterPtr->chain = NULL;  /* Don't free row tag chain. */
-                iterPtr->numEntries = Blt_Chain_GetLength(chain);
-            }
+        colPtr = Blt_Chain_GetValue(link);
+        if (columns != NULL) {
+            columns[i] = colPtr;
         }
-        return TCL_OK;
-        
-    case TABLE_SPEC_RANGE:
-        {
-            Row *firstPtr, *lastPtr;
-            Tcl_Obj *rangeObjPtr;
+        NotifyColumnChanged(table, colPtr, TABLE_NOTIFY_COLUMNS_CREATED);
+    }
+    Blt_Chain_Destroy(chain);
+    return TCL_OK;
+}
 
-            p = strchr(tag, '-');
-            if (p == NULL) {
-                if (interp != NULL) {
-                    Tcl_AppendResult(interp, "bad range specification \"", tag, 
-                                     "\"", (char *)NULL);
-                }
-                return TCL_ERROR;
-            }
-            rangeObjPtr = Tcl_NewStringObj(tag, p - tag);
-            firstPtr = blt_table_get_row(interp, table, rangeObjPtr);
-            Tcl_DecrRefCount(rangeObjPtr);
-            if (firstPtr == NULL) {
-                return TCL_ERROR;
-            }
-            rangeObjPtr = Tcl_NewStringObj(p + 1, -1);
-            lastPtr = blt_table_get_row(interp, table, rangeObjPtr);
-            Tcl_DecrRefCount(rangeObjPtr);
-            if (lastPtr == NULL) {
-                return TCL_ERROR;
-            }
-            if (firstPtr->index > lastPtr->index) {
-                return TCL_OK;
-            }
-            iterPtr->firstPtr = firstPtr;
-            iterPtr->lastPtr = lastPtr;
-            iterPtr->type = TABLE_ITERATOR_RANGE;
-            iterPtr->table = table;
-            iterPtr->tag = tag;
-            iterPtr->numEntries = lastPtr->index - firstPtr->index + 1;
-        }
-        return TCL_OK;
+BLT_TABLE_COLUMN
+blt_table_create_column(Tcl_Interp *interp, BLT_TABLE table, const char *label)
+{
+    Column *colPtr;
 
-    default:
-        break;
+    colPtr = NULL;                      /* Suppress compiler warning. */
+    if (blt_table_extend_columns(interp, table, 1, &colPtr) != TCL_OK) {
+        return NULL;
     }
-    if (interp != NULL) {
-        Tcl_AppendResult(interp, "unknown row specification \"", tag, 
-                         "\" in ", blt_table_name(table), (char *)NULL);
+    if (label != NULL) {
+        if (blt_table_set_column_label(interp, table, colPtr, label)!=TCL_OK) {
+            blt_table_delete_column(table, colPtr);
+            return NULL;
+        }
     }
-    return TCL_ERROR;
+    return colPtr;
+}
+
+void
+blt_table_set_column_map(Table *tablePtr, Column **map)
+{
+    NotifyColumnChanged(tablePtr, NULL, TABLE_NOTIFY_COLUMNS_MOVED);
+    ReplaceColumnMap(&tablePtr->corePtr->columns, map);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_first_tagged_row --
- *
- *      Returns the id of the next row derived from the given tag.
+ * blt_table_move_columns --
  *
- * Results:
- *      Returns the row location of the first item.  If no more rows
- *      can be found, then -1 is returned.
+ *      Move one of more rows to a new location in the tuple.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_ROW
-blt_table_first_tagged_row(BLT_TABLE_ITERATOR *iterPtr)
+/*ARGSUSED*/
+int
+blt_table_move_columns(Tcl_Interp *interp, Table *tablePtr, Column *destPtr, 
+                       Column *firstPtr, Column *lastPtr, int after)
 {
-    switch (iterPtr->type) {
-    case TABLE_ITERATOR_TAG:
-    case TABLE_ITERATOR_CHAIN:
-        /* iterPtr->link is already set by blt_table_row_iterator */
-        if (iterPtr->link != NULL) {
-            BLT_TABLE_ROW row;
-
-            row = Blt_Chain_GetValue(iterPtr->link);
-            iterPtr->link = Blt_Chain_NextLink(iterPtr->link);
-            return row;
-        }
-        break;
-    case TABLE_ITERATOR_LABEL:
-        {
-            Blt_HashEntry *hPtr;
-
-            hPtr = Blt_FirstHashEntry(iterPtr->tablePtr, &iterPtr->cursor);
-            if (hPtr == NULL) {
-                return NULL;
-            }
-            return Blt_GetHashValue(hPtr);
-        }
-        break;
-
-    default:
-        if (iterPtr->firstPtr != NULL) {
-            Row *rowPtr;
+    Columns *columnsPtr;
 
-            rowPtr = iterPtr->firstPtr;
-            if (rowPtr == iterPtr->lastPtr) {
-                iterPtr->nextPtr = NULL;
-            } else {
-                iterPtr->nextPtr = rowPtr->nextPtr;
-            }
-            return rowPtr;
-        } 
+    columnsPtr = &tablePtr->corePtr->columns;
+    if (!MoveColumns(columnsPtr, destPtr, firstPtr, lastPtr, after)) {
+        Tcl_AppendResult(interp, "can't move columns in \"", 
+                blt_table_name(tablePtr), "\"", (char *)NULL);
+        return TCL_ERROR;
     }
-    return NULL;
+    NotifyColumnChanged(tablePtr, NULL, TABLE_NOTIFY_COLUMNS_MOVED);
+    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_next_tagged_row --
+ * blt_table_restore --
  *
- *      Returns the id of the next row derived from the given tag.
+ *      Restores data to the given table based upon the dump string.
+ *      The dump string should have been generated by blt_table_dump.
+ *      Two bit flags may be set.
+ *      
+ *      TABLE_RESTORE_NO_TAGS   Don't restore tag information.
+ *      TABLE_RESTORE_OVERWRITE Look for row and columns with the 
+ *                              same label. Overwrite if necessary.
  *
  * Results:
- *      Returns the row location of the first item.  If no more rows can be
- *      found, then -1 is returned.
+ *      A standard TCL result.  If the restore was successful, TCL_OK
+ *      is returned.  Otherwise, TCL_ERROR is returned and an error
+ *      message is left in the interpreter result.
+ *
+ * Side Effects:
+ *      New row and columns are created in the table and may possibly
+ *      generate event notifier or trace callbacks.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_ROW
-blt_table_next_tagged_row(BLT_TABLE_ITERATOR *iterPtr)
+int
+blt_table_restore(Tcl_Interp *interp, BLT_TABLE table, char *data, 
+                      unsigned int flags)
 {
-    switch (iterPtr->type) {
-    case TABLE_ITERATOR_CHAIN:
-    case TABLE_ITERATOR_TAG:
-        if (iterPtr->link != NULL) {
-            BLT_TABLE_ROW row;
-            
-            row = Blt_Chain_GetValue(iterPtr->link);
-            iterPtr->link = Blt_Chain_NextLink(iterPtr->link);
-            return row;
+    RestoreData restore;
+    int result;
+
+    restore.argc = 0;
+    restore.mtime = restore.ctime = 0L;
+    restore.argv = NULL;
+    restore.fileName = "data string";
+    restore.numLines = 0;
+    restore.flags = flags;
+    restore.numCols = blt_table_num_columns(table);
+    restore.numRows = blt_table_num_rows(table);
+    Blt_InitHashTableWithPool(&restore.rowIndices, BLT_ONE_WORD_KEYS);
+    Blt_InitHashTableWithPool(&restore.colIndices, BLT_ONE_WORD_KEYS);
+    /* Read dump information */
+    result = TCL_ERROR;
+    for (;;) {
+        char c1, c2;
+
+        result = ParseDumpRecord(interp, &data, &restore);
+        if (result != TCL_OK) {
+            break;
         }
-        break;
-    case TABLE_ITERATOR_LABEL:
-        {
-            Blt_HashEntry *hPtr;
-            
-            hPtr = Blt_NextHashEntry(&iterPtr->cursor); 
-            if (hPtr == NULL) {
-                return NULL;
-            }
-            return Blt_GetHashValue(hPtr);
+        if (restore.argc == 0) {
+            continue;
+        }
+        c1 = restore.argv[0][0], c2 = restore.argv[0][1];
+        if ((c1 == 'i') && (c2 == '\0')) {
+            result = RestoreHeader(interp, table, &restore);
+        } else if ((c1 == 'r') && (c2 == '\0')) {
+            result = RestoreRow(interp, table, &restore);
+        } else if ((c1 == 'c') && (c2 == '\0')) {
+            result = RestoreColumn(interp, table, &restore);
+        } else if ((c1 == 'd') && (c2 == '\0')) {
+            result = RestoreValue(interp, table, &restore);
+        } else {
+            Tcl_AppendResult(interp, restore.fileName, ":", 
+                Blt_Ltoa(restore.numLines), ": error: unknown entry \"", 
+                restore.argv[0], "\"", (char *)NULL);
+            result = TCL_ERROR;
+        }
+        Tcl_Free((char *)restore.argv);
+        if (result != TCL_OK) {
+            break;
         }
-        break;
-    default:
-        if (iterPtr->nextPtr != NULL) {
-            Row *rowPtr;
-
-            rowPtr = iterPtr->nextPtr;
-            if (rowPtr == iterPtr->lastPtr) {
-                iterPtr->nextPtr = NULL;
-            } else {
-                iterPtr->nextPtr = rowPtr->nextPtr;
-            }
-            return rowPtr;
-        }       
     }
-    return NULL;
+    Blt_DeleteHashTable(&restore.rowIndices);
+    Blt_DeleteHashTable(&restore.colIndices);
+    if (result == TCL_ERROR) {
+        return TCL_ERROR;
+    }
+    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_get_row --
+ * blt_table_file_restore --
  *
- *      Gets the row offset associated the given row index, tag, or label.
- *      This routine is used when you want only one row index.  It's an
- *      error if more than one row is specified (e.g. "all" tag or range
- *      "1-4").  It's also an error if the row tag is empty (no rows are
- *      currently tagged).
+ *      Restores data to the given table based upon the dump file
+ *      provided. The dump file should have been generated by
+ *      blt_table_dump or blt_table_file_dump.
+ *
+ *      If the filename starts with an '@', then it is the name of an
+ *      already opened channel to be used. Two bit flags may be set.
+ *      
+ *      TABLE_RESTORE_NO_TAGS   Don't restore tag information.
+ *      TABLE_RESTORE_OVERWRITE Look for row and columns with 
+ *                              the same label. Overwrite if necessary.
+ *
+ * Results:
+ *      A standard TCL result.  If the restore was successful, TCL_OK
+ *      is returned.  Otherwise, TCL_ERROR is returned and an error
+ *      message is left in the interpreter result.
+ *
+ * Side Effects:
+ *      Row and columns are created in the table and may possibly
+ *      generate trace or notifier event callbacks.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_ROW
-blt_table_get_row(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr)
+int
+blt_table_file_restore(Tcl_Interp *interp, BLT_TABLE table, 
+                       const char *fileName, unsigned int flags)
 {
-    BLT_TABLE_ITERATOR iter;
-    BLT_TABLE_ROW first, next;
-    
-    if (blt_table_iterate_rows(interp, table, objPtr, &iter) != TCL_OK) {
-        return NULL;
-    }
-    first = blt_table_first_tagged_row(&iter);
-    if (first == NULL) {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "no rows specified by \"", 
-                             Tcl_GetString(objPtr), "\"", (char *)NULL);
+    RestoreData restore;
+    Tcl_Channel channel;
+    int closeChannel;
+    int result;
+
+    closeChannel = TRUE;
+    if ((fileName[0] == '@') && (fileName[1] != '\0')) {
+        int mode;
+        
+        channel = Tcl_GetChannel(interp, fileName+1, &mode);
+        if (channel == NULL) {
+            return TCL_ERROR;
         }
-        return NULL;
-    }
-    next = blt_table_next_tagged_row(&iter);
-    if (next != NULL) {
-        if (interp != NULL) {
-            const char *tag;
-            
-            blt_table_row_spec(table, objPtr, &tag);
-            Tcl_AppendResult(interp, "multiple rows specified by \"", 
-                             tag, "\"", (char *)NULL);
+        if ((mode & TCL_READABLE) == 0) {
+            Tcl_AppendResult(interp, "channel \"", fileName, 
+                "\" not opened for reading", (char *)NULL);
+            return TCL_ERROR;
+        }
+        closeChannel = FALSE;
+    } else {
+        channel = Tcl_OpenFileChannel(interp, fileName, "r", 0);
+        if (channel == NULL) {
+            return TCL_ERROR;   /* Can't open dump file. */
         }
-        return NULL;
     }
-    return first;
-}
-
-BLT_TABLE_ROWCOLUMN_SPEC
-blt_table_column_spec(BLT_TABLE table, Tcl_Obj *objPtr, const char **sp)
-{
-    const char *p;
-    const char *string;
-    long index;
-    char c;
+    restore.argc = 0;
+    restore.mtime = restore.ctime = 0L;
+    restore.argv = NULL;
+    restore.fileName = fileName;
+    restore.numLines = 0;
+    restore.flags = flags;
+    restore.numCols = blt_table_num_columns(table);
+    restore.numRows = blt_table_num_rows(table);
+    Blt_InitHashTableWithPool(&restore.rowIndices, BLT_ONE_WORD_KEYS);
+    Blt_InitHashTableWithPool(&restore.colIndices, BLT_ONE_WORD_KEYS);
 
-    string = Tcl_GetString(objPtr);
-    *sp = string;
-    c = string[0];
-    if (c == '@') {
-        *sp = string + 1;
-        return TABLE_SPEC_TAG;
-    } else if ((isdigit(c)) &&
-               (Blt_GetLongFromObj(NULL, objPtr, &index) == TCL_OK)) {
-        return TABLE_SPEC_INDEX;
-    } else if ((c == 'r') && (strncmp(string, "range:", 6) == 0)) {
-        *sp = string + 6;
-        return TABLE_SPEC_RANGE;
-    } else if ((c == 'i') && (strncmp(string, "index:", 6) == 0)) {
-        *sp = string + 6;
-        return TABLE_SPEC_INDEX;
-    } else if ((c == 'l') && (strncmp(string, "label:", 6) == 0)) {
-        *sp = string + 6;
-        return TABLE_SPEC_LABEL;
-    } else if ((c == 't') && (strncmp(string, "tag:", 4) == 0)) {
-        *sp = string + 4;
-        return TABLE_SPEC_TAG;
-    } else if (blt_table_get_column_by_label(table, string) != NULL) {
-        return TABLE_SPEC_LABEL;
-    }
-    p = strchr(string, '-');
-    if (p != NULL) {
-        Tcl_Obj *objPtr;
-        BLT_TABLE_COLUMN col;
+    result = TCL_ERROR;
+    /* Process dump information record by record. */
+    for (;;) {
+        char c1, c2;
 
-        objPtr = Tcl_NewStringObj(string, p - string);
-        Tcl_IncrRefCount(objPtr);
-        col = blt_table_get_column(NULL, table, objPtr);
-        Tcl_DecrRefCount(objPtr);
-        if (col != NULL) {
-            objPtr = Tcl_NewStringObj(p + 1, -1);
-            col = blt_table_get_column(NULL, table, objPtr);
-            Tcl_DecrRefCount(objPtr);
-            if (col != NULL) {
-                return TABLE_SPEC_RANGE;
-            }
+        result = ReadDumpRecord(interp, channel, &restore);
+        if (result != TCL_OK) {
+            break;
+        }
+        if (restore.argc == 0) {
+            continue;
+        }
+        c1 = restore.argv[0][0], c2 = restore.argv[0][1];
+        if ((c1 == 'i') && (c2 == '\0')) {
+            result = RestoreHeader(interp, table, &restore);
+        } else if ((c1 == 'r') && (c2 == '\0')) {
+            result = RestoreRow(interp, table, &restore);
+        } else if ((c1 == 'c') && (c2 == '\0')) {
+            result = RestoreColumn(interp, table, &restore);
+        } else if ((c1 == 'd') && (c2 == '\0')) {
+            result = RestoreValue(interp, table, &restore);
+        } else {
+            Tcl_AppendResult(interp, fileName, ":", Blt_Ltoa(restore.numLines), 
+                ": error: unknown entry \"", restore.argv[0], "\"", 
+                (char *)NULL);
+            result = TCL_ERROR;
         }
+        if (result != TCL_OK) {
+            Tcl_Free((char *)restore.argv); /* Allocated by Tcl_SplitList */
+            break;
+        }
+        Tcl_Free((char *)restore.argv); /* Allocated by Tcl_SplitList */
     }
-    return TABLE_SPEC_UNKNOWN;
+    Blt_DeleteHashTable(&restore.rowIndices);
+    Blt_DeleteHashTable(&restore.colIndices);
+    if (closeChannel) {
+        Tcl_Close(interp, channel);
+    }
+    if (result == TCL_ERROR) {
+        return TCL_ERROR;
+    }
+    return TCL_OK;
 }
 
 /*
- *---------------------------------------------------------------------------
- *
- * blt_table_iterate_columns --
- *
- *      Returns the id of the first column derived from the given tag,
- *      label or index represented in objPtr.
- *
- * Results:
- *      Returns the column location of the first item.  If no column can be
- *      found, then -1 is returned and an error message is left in the
- *      interpreter.
- *
- *---------------------------------------------------------------------------
+ * Binary snapshots --
+ *
+ *      A snapshot is a binary image of a table that can be restored
+ *      without converting any value from a string.  Numbers are stored in
+ *      the byte order of the machine that wrote the snapshot.  The
+ *      snapshot is laid out as
+ *
+ *          header                      SnapshotHeader
+ *          row directory               SnapshotRow[numRows]
+ *          column directory            SnapshotColumn[numCols]
+ *          column blocks               one per column
+ *          string heap                 to the end of the snapshot
+ *
+ *      Each column block holds a bitmap of the non-empty cells, padded
+ *      to 8 bytes, followed by the values of the column's cells in row
+ *      order.  Numeric values are stored as native doubles, 64-bit
+ *      integers, or 32-bit integers (booleans).  String and blob cells
+ *      are stored as SnapshotString offsets into the string heap.  The
+ *      column directory records the encoding of string columns.
+ *      Numeric columns may also have an array of heap offsets for the
+ *      strings that the cells were set from.  Labels and tag lists are
+ *      also stored in the heap.  Every string in the heap is terminated
+ *      by a NUL byte.  All offsets are relative to the start of the
+ *      snapshot, except heap offsets, which are relative to the start of
+ *      the heap.
  */
-int
-blt_table_iterate_columns(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr, 
-                         BLT_TABLE_ITERATOR *iterPtr)
-{
-    const char *tag, *p;
-    int result;
-    long index;
-    BLT_TABLE_ROWCOLUMN_SPEC spec;
-    Columns *columnsPtr;
+#define SNAPSHOT_MAGIC          "BLTDTAB\n"
+#define SNAPSHOT_VERSION        2
+#define SNAPSHOT_BYTE_ORDER     0x01020304
 
-    columnsPtr = blt_table_columns(table);
-    if (columnsPtr->flags & REINDEX) {
-        ResetColumnMap(columnsPtr);
-    }
-    iterPtr->table = table;
-    iterPtr->type = TABLE_ITERATOR_INDEX;
-    iterPtr->link = NULL;
-    iterPtr->numEntries = 0;
+#define SnapshotAlign(n)        (((n) + 7) & ~((size_t)7))
 
-    spec = blt_table_column_spec(table, objPtr, &tag);
-    switch (spec) {
-    case TABLE_SPEC_INDEX:
-        p = Tcl_GetString(objPtr);
-        if (p == tag) {
-            result = Blt_GetLongFromObj(NULL, objPtr, &index);
-        } else {
-            result = Blt_GetLong(NULL, (const char *)tag, &index);
-        }
-        if (result != TCL_OK) {
-            if (interp != NULL) {
-                Tcl_AppendResult(interp, "badly formed column index \"", 
-                        tag, "\"", (char *)NULL);
-            }
-            return TCL_ERROR;
-        }
-        if ((index < 0) || (index >= blt_table_num_columns(table))) {
-            if (interp != NULL) {
-                Tcl_AppendResult(interp, "bad column index \"", 
-                        Tcl_GetString(objPtr), "\"", (char *)NULL);
-            }
-            return TCL_ERROR;
-        }               
-        iterPtr->firstPtr = iterPtr->lastPtr = blt_table_column(table, index);
-        if (iterPtr->firstPtr != NULL) {
-            iterPtr->numEntries = 1;
-        }
-        iterPtr->tag = tag;
-        return TCL_OK;
+typedef struct {
+    char magic[8];                      /* SNAPSHOT_MAGIC */
+    uint32_t version;                   /* Version of the format. */
+    uint32_t byteOrder;                 /* SNAPSHOT_BYTE_ORDER as written
+                                         * by the dumping machine. */
+    int64_t numRows, numCols;
+    int64_t ctime, mtime;
+    int64_t heapOffset;                 /* Offset of the string heap. */
+    int64_t reserved;
+} SnapshotHeader;
 
-    case TABLE_SPEC_LABEL:
-        iterPtr->tablePtr = blt_table_column_get_label_table(table, tag);
-        if (iterPtr->tablePtr != NULL) {
-            iterPtr->type = TABLE_ITERATOR_LABEL;
-            iterPtr->tag = tag;
-            iterPtr->numEntries = iterPtr->tablePtr->numEntries;
-            return TCL_OK;
-        }
-        break;
-        
-    case TABLE_SPEC_TAG:
-        {
-            Blt_Chain chain;
+typedef struct {
+    int64_t label;                      /* Heap offset of the label. */
+    int64_t tags;                       /* Heap offset of the tag list or
+                                         * -1 if there are no tags. */
+} SnapshotRow;
 
-            if (strcmp(tag, "all") == 0) {
-                Column *firstPtr, *lastPtr;
+typedef struct {
+    int64_t label;                      /* Heap offset of the label. */
+    int64_t tags;                       /* Heap offset of the tag list or
+                                         * -1 if there are no tags. */
+    int32_t type;                       /* Column type. */
+    int32_t width;                      /* Size of each cell value. */
+    int32_t encoding;                   /* Column encoding. */
+    int32_t reserved;
+    int64_t bitmap;                     /* Offset of non-empty bitmap. */
+    int64_t values;                     /* Offset of cell values. */
+    int64_t strings;                    /* Offset of the string
+                                         * representations of numeric
+                                         * values or -1 if there are
+                                         * none. */
+} SnapshotColumn;
 
-                iterPtr->type = TABLE_ITERATOR_ALL;
-                iterPtr->tag = tag;
-                firstPtr = blt_table_first_column(table);
-                lastPtr = blt_table_last_column(table);
-                if (firstPtr != NULL) {
-                    iterPtr->numEntries = lastPtr->index - firstPtr->index + 1;
-                }
-                iterPtr->firstPtr = firstPtr;
-                iterPtr->lastPtr = lastPtr;
-                return TCL_OK;
-            }
-            if (strcmp(tag, "end") == 0) {
-                iterPtr->tag = tag;
-                iterPtr->firstPtr = iterPtr->lastPtr = 
-                    blt_table_last_column(table);
-                if (iterPtr->firstPtr != NULL) {
-                    iterPtr->numEntries = 1;
-                }
-                return TCL_OK;
-            }
-            
-            chain = blt_table_get_tagged_columns(iterPtr->table, tag);
-            if (chain != NULL) {
-                iterPtr->link = Blt_Chain_FirstLink(chain);
-                iterPtr->type = TABLE_ITERATOR_TAG;
-                iterPtr->tag = tag;
-                iterPtr->chain = NULL;  /* Don't free column tag chain.  */
-                iterPtr->numEntries = Blt_Chain_GetLength(chain);
-                return TCL_OK;
-            }
-        }
-        break;
+typedef struct {
+    int64_t offset;                     /* Heap offset of string. */
+    int64_t length;                     /* # of bytes in string. */
+} SnapshotString;
 
-    case TABLE_SPEC_RANGE:
-        {
-            Column *firstPtr, *lastPtr;
-            Tcl_Obj *fromObjPtr, *toObjPtr;
-            
-            p = strchr(tag, '-');
-            if (p == NULL) {
-                if (interp != NULL) {
-                    Tcl_AppendResult(interp, "bad range specification \"", tag, 
-                                     "\"", (char *)NULL);
-                }
-                return TCL_ERROR;
-            }
-            fromObjPtr = Tcl_NewStringObj(tag, p - tag);
-            firstPtr = blt_table_get_column(interp, table, fromObjPtr);
-            Tcl_DecrRefCount(fromObjPtr);
-            if (firstPtr == NULL) {
-                return TCL_ERROR;
-            }
-            toObjPtr = Tcl_NewStringObj(p + 1, -1);
-            lastPtr = blt_table_get_column(interp, table, toObjPtr);
-            Tcl_DecrRefCount(toObjPtr);
-            if (lastPtr == NULL) {
-                return TCL_ERROR;
-            }
-            iterPtr->firstPtr = firstPtr;
-            iterPtr->lastPtr = lastPtr;
-            iterPtr->type  = TABLE_ITERATOR_RANGE;
-            iterPtr->tag = tag;
-            if (firstPtr != NULL) {
-                iterPtr->numEntries = lastPtr->index - firstPtr->index + 1;
-            }
-        }
-        return TCL_OK;
+typedef struct {
+    unsigned char *bytes;
+    size_t length, numAllocated;
+} SnapshotBuffer;
 
+typedef struct {
+    Tcl_Interp *interp;
+    Tcl_Channel channel;                /* If NULL, the snapshot is
+                                         * collected in the buffer. */
+    SnapshotBuffer buffer;
+} SnapshotWriter;
+
+static int
+SnapshotWidth(BLT_TABLE_COLUMN_TYPE type)
+{
+    switch (type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+    case TABLE_COLUMN_TYPE_INT64:
+    case TABLE_COLUMN_TYPE_LONG:
+        return 8;
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        return 4;
     default:
-        break;
-    }
-    if (interp != NULL) {
-        Tcl_AppendResult(interp, "unknown column specification \"", 
-                         tag, "\" in ", blt_table_name(table),(char *)NULL);
+        return sizeof(SnapshotString);
     }
-    return TCL_ERROR;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_first_tagged_column --
+ * AppendToSnapshotBuffer --
  *
- *      Returns the first column based upon given iterator.
+ *      Appends the bytes to the buffer, growing it as needed.
  *
  * Results:
- *      Returns the column location of the first item.  If no more columns
- *      can be found, then -1 is returned.
+ *      Returns the offset of the bytes in the buffer.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_COLUMN
-blt_table_first_tagged_column(BLT_TABLE_ITERATOR *iterPtr)
+static int64_t
+AppendToSnapshotBuffer(SnapshotBuffer *bufPtr, const void *bytes, 
+                       size_t numBytes)
 {
-    switch (iterPtr->type) {
-    case TABLE_ITERATOR_TAG:
-    case TABLE_ITERATOR_CHAIN:
-        /* iterPtr->link is already set by blt_table_column_iterator */
-        if (iterPtr->link != NULL) {
-            BLT_TABLE_COLUMN col;
+    int64_t offset;
 
-            col = Blt_Chain_GetValue(iterPtr->link);
-            iterPtr->link = Blt_Chain_NextLink(iterPtr->link);
-            return col;
-        }
-        break;
-    case TABLE_ITERATOR_LABEL:
-        {
-            Blt_HashEntry *hPtr;
-            
-            hPtr = Blt_FirstHashEntry(iterPtr->tablePtr, &iterPtr->cursor);
-            if (hPtr == NULL) {
-                return NULL;
-            }
-            return Blt_GetHashValue(hPtr);
+    if ((bufPtr->length + numBytes) > bufPtr->numAllocated) {
+        size_t newSize;
+
+        newSize = (bufPtr->numAllocated == 0) ? 4096 : bufPtr->numAllocated;
+        while (newSize < (bufPtr->length + numBytes)) {
+            newSize += newSize;
         }
-        break;
-    default:
-        if (iterPtr->firstPtr != NULL) {
-            Column *colPtr;
+        bufPtr->bytes = Blt_AssertRealloc(bufPtr->bytes, newSize);
+        bufPtr->numAllocated = newSize;
+    }
+    offset = bufPtr->length;
+    memcpy(bufPtr->bytes + bufPtr->length, bytes, numBytes);
+    bufPtr->length += numBytes;
+    return offset;
+}
 
-            colPtr = iterPtr->firstPtr;
-            if (colPtr == iterPtr->lastPtr) {
-                iterPtr->nextPtr = NULL;
-            } else {
-                iterPtr->nextPtr = colPtr->nextPtr;
-            }
-            return colPtr;
-        } 
-        break;
+static int64_t
+AppendSnapshotString(SnapshotBuffer *heapPtr, const char *string, 
+                     size_t length)
+{
+    int64_t offset;
+
+    offset = AppendToSnapshotBuffer(heapPtr, string, length);
+    AppendToSnapshotBuffer(heapPtr, "", 1);
+    return offset;
+}
+
+static int64_t
+AppendSnapshotTags(SnapshotBuffer *heapPtr, Blt_Chain chain)
+{
+    Blt_ChainLink link;
+    Tcl_DString ds;
+    int64_t offset;
+
+    if (Blt_Chain_GetLength(chain) == 0) {
+        Blt_Chain_Destroy(chain);
+        return -1;
+    }
+    Tcl_DStringInit(&ds);
+    for (link = Blt_Chain_FirstLink(chain); link != NULL;
+         link = Blt_Chain_NextLink(link)) {
+        Tcl_DStringAppendElement(&ds, Blt_Chain_GetValue(link));
+    }
+    Blt_Chain_Destroy(chain);
+    offset = AppendSnapshotString(heapPtr, Tcl_DStringValue(&ds), 
+                                  Tcl_DStringLength(&ds));
+    Tcl_DStringFree(&ds);
+    return offset;
+}
+
+static int
+WriteSnapshot(SnapshotWriter *writerPtr, const void *bytes, size_t numBytes)
+{
+    if (numBytes == 0) {
+        return TCL_OK;
+    }
+    if (writerPtr->channel == NULL) {
+        AppendToSnapshotBuffer(&writerPtr->buffer, bytes, numBytes);
+        return TCL_OK;
+    }
+    if (Tcl_Write(writerPtr->channel, bytes, numBytes) != (int)numBytes) {
+        Tcl_AppendResult(writerPtr->interp, "error writing snapshot: ",
+                         Tcl_PosixError(writerPtr->interp), (char *)NULL);
+        return TCL_ERROR;
     }
-    return NULL;
+    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_next_tagged_column --
- *
- *      Returns the column location of the next column using the given
- *      iterator.
+ * IsSnapshotString --
  *
- * Results:
- *      Returns the column location of the next item.  If no more columns
- *      can be found, then -1 is returned.
+ *      Indicates if the string representation of the cell in the numeric
+ *      column must be saved in a snapshot.  Strings generated from the
+ *      value when the cell was read don't need to be saved.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_COLUMN
-blt_table_next_tagged_column(BLT_TABLE_ITERATOR *iterPtr)
+static int
+IsSnapshotString(Column *colPtr, Row *rowPtr)
 {
-    switch (iterPtr->type) {
-    case TABLE_ITERATOR_TAG:
-    case TABLE_ITERATOR_CHAIN:
-        if (iterPtr->link != NULL) {
-            BLT_TABLE_COLUMN col;
-            
-            col = Blt_Chain_GetValue(iterPtr->link);
-            iterPtr->link = Blt_Chain_NextLink(iterPtr->link);
-            return col;
-        }
-        break;
-    case TABLE_ITERATOR_LABEL:
-        {
-            Blt_HashEntry *hPtr;
-
-            hPtr = Blt_NextHashEntry(&iterPtr->cursor); 
-            if (hPtr == NULL) {
-                return NULL;
-            }
-            return Blt_GetHashValue(hPtr);
-        }
-        break;
-    default:
-        if (iterPtr->nextPtr != NULL) {
-            Column *colPtr;
+    const char *string;
+    char generated[DENSE_STRING_LENGTH];
+    Value value;
 
-            colPtr = iterPtr->nextPtr;
-            if (colPtr == iterPtr->lastPtr) {
-                iterPtr->nextPtr = NULL;
-            } else {
-                iterPtr->nextPtr = colPtr->nextPtr;
-            }
-            return colPtr;
-        }       
-        break;
+    if ((colPtr->strings == NULL) || (IsEmpty(rowPtr, colPtr))) {
+        return FALSE;
     }
-    return NULL;
+    string = colPtr->strings[rowPtr->offset];
+    if (string == NULL) {
+        return FALSE;
+    }
+    GetDenseDatum(colPtr, rowPtr->offset, &value);
+    FormatDatum(colPtr->type, &value, generated);
+    return (strcmp(string, generated) != 0);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_get_column --
+ * HasSnapshotStrings --
+ *
+ *      Indicates if any of the cells of the numeric column have a string
+ *      representation that must be saved in a snapshot.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_COLUMN
-blt_table_get_column(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr)
+static int
+HasSnapshotStrings(Column *colPtr, size_t numRows, Row **rows)
 {
-    BLT_TABLE_ITERATOR iter;
-    BLT_TABLE_COLUMN first, next;
+    size_t i;
 
-    if (blt_table_iterate_columns(interp, table, objPtr, &iter) != TCL_OK) {
-        return NULL;
-    }
-    first = blt_table_first_tagged_column(&iter);
-    if (first == NULL) {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "no columns specified by \"", 
-                Tcl_GetString(objPtr), "\"", (char *)NULL);
-        }
-        return NULL;
+    if ((!IsDenseColumn(colPtr)) || (colPtr->strings == NULL)) {
+        return FALSE;
     }
-    next = blt_table_next_tagged_column(&iter);
-    if (next != NULL) {
-        if (interp != NULL) {
-            const char *tag;
-            
-            blt_table_column_spec(table, objPtr, &tag);
-            Tcl_AppendResult(interp, "multiple columns specified by \"", 
-                tag, "\"", (char *)NULL);
+    for (i = 0; i < numRows; i++) {
+        if (IsSnapshotString(colPtr, rows[i])) {
+            return TRUE;
         }
-        return NULL;
     }
-    return first;
+    return FALSE;
 }
 
-
-int
-blt_table_list_columns(Tcl_Interp *interp, BLT_TABLE table, int objc, 
-                       Tcl_Obj *const *objv, Blt_Chain chain)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * WriteSnapshotColumn --
+ *
+ *      Writes the block of cell values of the column.  Strings are
+ *      appended to the heap.  If hasStrings is set, the heap offsets of
+ *      the string representations of the numeric values follow the cell
+ *      values.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+WriteSnapshotColumn(SnapshotWriter *writerPtr, SnapshotBuffer *heapPtr,
+                    Column *colPtr, size_t numRows, Row **rows, int hasStrings)
 {
-    Blt_ChainLink link;
-    Blt_HashTable cols;
-    int i;
+    static const char pad[8];
+    unsigned char *bitmap, *values;
+    int64_t *strings;
+    size_t i, numBitmapBytes, numBytes;
+    int width, result;
+
+    width = SnapshotWidth(colPtr->type);
+    numBitmapBytes = SnapshotAlign(DenseBitmapSize(numRows));
+    bitmap = Blt_AssertCalloc(numBitmapBytes + 1, 1);
+    values = Blt_AssertCalloc(numRows + 1, width);
+    strings = NULL;
+    if (hasStrings) {
+        strings = Blt_AssertMalloc((numRows + 1) * sizeof(int64_t));
+    }
+    for (i = 0; i < numRows; i++) {
+        Row *rowPtr;
+        unsigned char *p;
 
-    Blt_InitHashTableWithPool(&cols, BLT_ONE_WORD_KEYS);
-    /* Initialize the hash table with the existing entries. */
-    for (link = Blt_Chain_FirstLink(chain); link != NULL; 
-         link = Blt_Chain_NextLink(link)) {
-        int isNew;
-        BLT_TABLE_COLUMN col;
+        rowPtr = rows[i];
+        if (strings != NULL) {
+            strings[i] = -1;
+        }
+        if (IsEmpty(rowPtr, colPtr)) {
+            continue;
+        }
+        bitmap[i >> 3] |= (1 << (i & 7));
+        p = values + i * width;
+        if (IsDenseColumn(colPtr)) {
+            Value value;
 
-        col = Blt_Chain_GetValue(link);
-        Blt_CreateHashEntry(&cols, col, &isNew);
-    }
-    /* Collect the columns into a hash table. */
-    for (i = 0; i < objc; i++) {
-        BLT_TABLE_ITERATOR iter;
-        BLT_TABLE_COLUMN col;
+            GetDenseDatum(colPtr, rowPtr->offset, &value);
+            switch (colPtr->type) {
+            case TABLE_COLUMN_TYPE_DOUBLE:
+            case TABLE_COLUMN_TYPE_TIME:
+                memcpy(p, &value.datum.d, 8);
+                break;
+            case TABLE_COLUMN_TYPE_INT64:
+                memcpy(p, &value.datum.i64, 8);
+                break;
+            case TABLE_COLUMN_TYPE_LONG:
+                {
+                    int64_t i64;
 
-        if (blt_table_iterate_columns(interp, table, objv[i], &iter) 
-            != TCL_OK) {
-            Blt_DeleteHashTable(&cols);
-            return TCL_ERROR;
-        }
-        for (col = blt_table_first_tagged_column(&iter); col != NULL; 
-             col = blt_table_next_tagged_column(&iter)) {
-            int isNew;
+                    i64 = value.datum.l;
+                    memcpy(p, &i64, 8);
+                }
+                break;
+            case TABLE_COLUMN_TYPE_BOOLEAN:
+                {
+                    int32_t i32;
 
-            Blt_CreateHashEntry(&cols, col, &isNew);
-            if (isNew) {
-                Blt_Chain_Append(chain, col);
+                    i32 = (int32_t)value.datum.l;
+                    memcpy(p, &i32, 4);
+                }
+                break;
+            default:
+                break;
+            }
+            /* Save only the strings the value was set from, not the
+             * generated ones. */
+            if ((strings != NULL) && (IsSnapshotString(colPtr, rowPtr))) {
+                const char *string;
+
+                string = colPtr->strings[rowPtr->offset];
+                strings[i] = AppendSnapshotString(heapPtr, string, 
+                                                  strlen(string));
             }
+        } else {
+            const char *string;
+            unsigned int length;
+            SnapshotString s;
+
+            string = GetStoredString(rowPtr, colPtr, &length);
+            s.length = length;
+            s.offset = AppendSnapshotString(heapPtr, string, length);
+            memcpy(p, &s, sizeof(s));
         }
     }
-    Blt_DeleteHashTable(&cols);
-    return TCL_OK;
+    result = WriteSnapshot(writerPtr, bitmap, numBitmapBytes);
+    if (result == TCL_OK) {
+        result = WriteSnapshot(writerPtr, values, numRows * width);
+    }
+    /* Pad the cell values out to 8 bytes. */
+    numBytes = numRows * width;
+    if ((result == TCL_OK) && (SnapshotAlign(numBytes) > numBytes)) {
+        result = WriteSnapshot(writerPtr, pad, 
+                               SnapshotAlign(numBytes) - numBytes);
+    }
+    if ((result == TCL_OK) && (strings != NULL)) {
+        result = WriteSnapshot(writerPtr, strings, numRows * sizeof(int64_t));
+    }
+    Blt_Free(bitmap);
+    Blt_Free(values);
+    if (strings != NULL) {
+        Blt_Free(strings);
+    }
+    return result;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * blt_table_binary_dump --
+ *
+ *      Writes a binary snapshot of the rows and columns of the table
+ *      selected by the iterators.  If channel is NULL, the snapshot is
+ *      left as a byte array in the interpreter result.  The channel is
+ *      switched to binary translation.
+ *
+ * Results:
+ *      A standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
 int
-blt_table_list_rows(Tcl_Interp *interp, BLT_TABLE table, int objc, 
-                    Tcl_Obj *const *objv, Blt_Chain chain)
+blt_table_binary_dump(Tcl_Interp *interp, Table *tablePtr, 
+                      BLT_TABLE_ITERATOR *riPtr, BLT_TABLE_ITERATOR *ciPtr,
+                      Tcl_Channel channel)
 {
-    Blt_ChainLink link;
-    Blt_HashTable rows;
-    int i;
-
-    Blt_InitHashTableWithPool(&rows, BLT_ONE_WORD_KEYS);
-    /* Initialize the hash table with the existing entries. */
-    for (link = Blt_Chain_FirstLink(chain); link != NULL; 
-         link = Blt_Chain_NextLink(link)) {
-        int isNew;
-        BLT_TABLE_ROW row;
+    Column **cols, *colPtr;
+    Row **rows, *rowPtr;
+    SnapshotBuffer heap;
+    SnapshotColumn *colDir;
+    SnapshotHeader header;
+    SnapshotRow *rowDir;
+    SnapshotWriter writer;
+    int64_t offset;
+    size_t i, numRows, numCols;
+    int result;
 
-        row = Blt_Chain_GetValue(link);
-        Blt_CreateHashEntry(&rows, row, &isNew);
+    if ((channel != NULL) && 
+        (Tcl_SetChannelOption(interp, channel, "-translation", "binary") 
+         != TCL_OK)) {
+        return TCL_ERROR;
     }
-    for (i = 0; i < objc; i++) {
-        BLT_TABLE_ITERATOR iter;
-        BLT_TABLE_ROW row;
-
-        if (blt_table_iterate_rows(interp, table, objv[i], &iter) != TCL_OK){
-            Blt_DeleteHashTable(&rows);
-            return TCL_ERROR;
-        }
-        /* Append the new rows onto the chain. */
-        for (row = blt_table_first_tagged_row(&iter); row != NULL; 
-             row = blt_table_next_tagged_row(&iter)) {
-            int isNew;
-
-            Blt_CreateHashEntry(&rows, row, &isNew);
-            if (isNew) {
-                Blt_Chain_Append(chain, row);
-            }
+    numRows = numCols = 0;
+    for (rowPtr = blt_table_first_tagged_row(riPtr); rowPtr != NULL;
+         rowPtr = blt_table_next_tagged_row(riPtr)) {
+        numRows++;
+    }
+    for (colPtr = blt_table_first_tagged_column(ciPtr); colPtr != NULL;
+         colPtr = blt_table_next_tagged_column(ciPtr)) {
+        numCols++;
+    }
+    rows = Blt_AssertMalloc((numRows + 1) * sizeof(Row *));
+    cols = Blt_AssertMalloc((numCols + 1) * sizeof(Column *));
+    rowDir = Blt_AssertCalloc(numRows + 1, sizeof(SnapshotRow));
+    colDir = Blt_AssertCalloc(numCols + 1, sizeof(SnapshotColumn));
+    memset(&heap, 0, sizeof(heap));
+    i = 0;
+    for (rowPtr = blt_table_first_tagged_row(riPtr); rowPtr != NULL;
+         rowPtr = blt_table_next_tagged_row(riPtr)) {
+        rows[i] = rowPtr;
+        rowDir[i].label = AppendSnapshotString(&heap, rowPtr->label, 
+                                               strlen(rowPtr->label));
+        rowDir[i].tags = AppendSnapshotTags(&heap, 
+                blt_table_get_row_tags(tablePtr, rowPtr));
+        i++;
+    }
+    /* Compute where each column block will be written. */
+    offset = sizeof(SnapshotHeader) + numRows * sizeof(SnapshotRow) + 
+        numCols * sizeof(SnapshotColumn);
+    i = 0;
+    for (colPtr = blt_table_first_tagged_column(ciPtr); colPtr != NULL;
+         colPtr = blt_table_next_tagged_column(ciPtr)) {
+        SnapshotColumn *dirPtr;
+
+        cols[i] = colPtr;
+        dirPtr = colDir + i;
+        dirPtr->label = AppendSnapshotString(&heap, colPtr->label, 
+                                             strlen(colPtr->label));
+        dirPtr->tags = AppendSnapshotTags(&heap, 
+                blt_table_get_column_tags(tablePtr, colPtr));
+        dirPtr->type = colPtr->type;
+        dirPtr->width = SnapshotWidth(colPtr->type);
+        dirPtr->encoding = blt_table_column_encoding(colPtr);
+        dirPtr->bitmap = offset;
+        offset += SnapshotAlign(DenseBitmapSize(numRows));
+        dirPtr->values = offset;
+        offset += SnapshotAlign(numRows * dirPtr->width);
+        dirPtr->strings = -1;
+        if (HasSnapshotStrings(colPtr, numRows, rows)) {
+            dirPtr->strings = offset;
+            offset += numRows * sizeof(int64_t);
         }
-    }
-    Blt_DeleteHashTable(&rows);
-    return TCL_OK;
+        i++;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.numRows = numRows;
+    header.numCols = numCols;
+    header.heapOffset = offset;
+
+    memset(&writer, 0, sizeof(writer));
+    writer.interp = interp;
+    writer.channel = channel;
+    result = WriteSnapshot(&writer, &header, sizeof(header));
+    if (result == TCL_OK) {
+        result = WriteSnapshot(&writer, rowDir, numRows * sizeof(SnapshotRow));
+    }
+    if (result == TCL_OK) {
+        result = WriteSnapshot(&writer, colDir, 
+                               numCols * sizeof(SnapshotColumn));
+    }
+    for (i = 0; (result == TCL_OK) && (i < numCols); i++) {
+        result = WriteSnapshotColumn(&writer, &heap, cols[i], numRows, rows,
+                                     (colDir[i].strings >= 0));
+    }
+    if (result == TCL_OK) {
+        result = WriteSnapshot(&writer, heap.bytes, heap.length);
+    }
+    if ((result == TCL_OK) && (channel == NULL)) {
+        Tcl_SetObjResult(interp, Tcl_NewByteArrayObj(writer.buffer.bytes,
+                writer.buffer.length));
+    }
+    if (writer.buffer.bytes != NULL) {
+        Blt_Free(writer.buffer.bytes);
+    }
+    if (heap.bytes != NULL) {
+        Blt_Free(heap.bytes);
+    }
+    Blt_Free(rows);
+    Blt_Free(cols);
+    Blt_Free(rowDir);
+    Blt_Free(colDir);
+    return result;
 }
 
-int
-blt_table_iterate_rows_objv(Tcl_Interp *interp, BLT_TABLE table, int objc, 
-                            Tcl_Obj *const *objv, BLT_TABLE_ITERATOR *iterPtr)
+static int
+SnapshotError(Tcl_Interp *interp, const char *mesg)
 {
-    Blt_Chain chain;
+    Tcl_AppendResult(interp, "bad datatable snapshot: ", mesg, (char *)NULL);
+    return TCL_ERROR;
+}
 
-    chain = Blt_Chain_Create();
-    if (blt_table_list_rows(interp, table, objc, objv, chain) != TCL_OK) {
-        Blt_Chain_Destroy(chain);
-        return TCL_ERROR;
+/* Returns the string at the heap offset or NULL if the offset is bad. */
+static const char *
+SnapshotHeapString(const unsigned char *heap, size_t heapSize, int64_t offset)
+{
+    if ((offset < 0) || ((uint64_t)offset >= heapSize)) {
+        return NULL;
     }
-    iterPtr->type = TABLE_ITERATOR_CHAIN;
-    iterPtr->link = Blt_Chain_FirstLink(chain);
-    /* Indicate to free created chain. */
-    iterPtr->chain = chain;
-    iterPtr->numEntries = Blt_Chain_GetLength(chain);
-    iterPtr->tag = "";
-    return TCL_OK;
+    return (const char *)heap + offset;
 }
 
-void
-blt_table_iterate_all_rows(BLT_TABLE table, BLT_TABLE_ITERATOR *iterPtr)
+static int
+SnapshotBlockOk(size_t numBytes, int64_t offset, uint64_t blockSize)
 {
-    Row *firstPtr, *lastPtr;
-    Rows *rowsPtr;
-    
-    rowsPtr = blt_table_rows(table);
-    if (rowsPtr->flags & REINDEX) {
-        ResetRowMap(rowsPtr);
-    }
+    return ((offset >= 0) && ((uint64_t)offset <= numBytes) &&
+            (blockSize <= (numBytes - offset)));
+}
 
-    iterPtr->chain = NULL;
-    iterPtr->link = NULL;
-    iterPtr->numEntries = 0;
-    iterPtr->table = table;
-    iterPtr->tag = "all";
-    iterPtr->type = TABLE_ITERATOR_ALL;
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SnapshotStringsOk --
+ *
+ *      Checks that the strings of the column's non-empty cells are all in
+ *      the string heap.  These are the cell values of string and blob
+ *      columns, and the string representations of numeric columns.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+SnapshotStringsOk(const unsigned char *bytes, const SnapshotColumn *dirPtr,
+                  const unsigned char *heap, size_t heapSize, size_t numRows)
+{
+    const unsigned char *bitmap;
+    size_t i;
 
-    firstPtr = blt_table_first_row(table);
-    lastPtr = blt_table_last_row(table);
-    if (firstPtr != NULL) {
-        iterPtr->numEntries = lastPtr->index - firstPtr->index + 1;
-    } 
-    iterPtr->firstPtr = firstPtr;
-    iterPtr->lastPtr = lastPtr;
+    bitmap = bytes + dirPtr->bitmap;
+    if ((dirPtr->type == TABLE_COLUMN_TYPE_STRING) ||
+        (dirPtr->type == TABLE_COLUMN_TYPE_BLOB)) {
+        const unsigned char *values;
+
+        values = bytes + dirPtr->values;
+        for (i = 0; i < numRows; i++) {
+            SnapshotString s;
+
+            if ((bitmap[i >> 3] & (1 << (i & 7))) == 0) {
+                continue;
+            }
+            memcpy(&s, values + i * sizeof(s), sizeof(s));
+            if ((s.offset < 0) || (s.length < 0) || 
+                ((uint64_t)s.offset > heapSize) ||
+                ((uint64_t)s.length > (heapSize - s.offset))) {
+                return FALSE;
+            }
+        }
+    } else if (dirPtr->strings >= 0) {
+        const unsigned char *strings;
+
+        strings = bytes + dirPtr->strings;
+        for (i = 0; i < numRows; i++) {
+            int64_t heapOffset;
+
+            if ((bitmap[i >> 3] & (1 << (i & 7))) == 0) {
+                continue;
+            }
+            memcpy(&heapOffset, strings + i * sizeof(int64_t), 
+                   sizeof(int64_t));
+            if ((heapOffset >= 0) && 
+                (SnapshotHeapString(heap, heapSize, heapOffset) == NULL)) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
 }
 
-int
-blt_table_iterate_columns_objv(Tcl_Interp *interp, BLT_TABLE table, int objc, 
-                               Tcl_Obj *const *objv,
-                               BLT_TABLE_ITERATOR *iterPtr)
+/* Returns TRUE if the tags at the heap offset are a proper TCL list. */
+static int
+SnapshotTagsOk(const unsigned char *heap, size_t heapSize, int64_t offset)
 {
-    Blt_Chain chain;
+    const char **argv;
+    const char *tags;
+    int argc;
 
-    chain = Blt_Chain_Create();
-    if (blt_table_list_columns(interp, table, objc, objv, chain) != TCL_OK) {
-        Blt_Chain_Destroy(chain);
-        return TCL_ERROR;
+    if (offset < 0) {
+        return TRUE;                    /* No tags. */
     }
-    iterPtr->table = table;
-    iterPtr->type = TABLE_ITERATOR_CHAIN;
-    iterPtr->link = Blt_Chain_FirstLink(chain);    
-    /* Indicate to free created chain. */
-    iterPtr->chain = chain;
-    iterPtr->numEntries = Blt_Chain_GetLength(chain);
-    iterPtr->tag = "";
-    return TCL_OK;
+    tags = SnapshotHeapString(heap, heapSize, offset);
+    if ((tags == NULL) || 
+        (Tcl_SplitList((Tcl_Interp *)NULL, tags, &argc, &argv) != TCL_OK)) {
+        return FALSE;
+    }
+    Tcl_Free((char *)argv);
+    return TRUE;
 }
 
-void
-blt_table_iterate_all_columns(BLT_TABLE table, BLT_TABLE_ITERATOR *iterPtr)
+static int
+RestoreSnapshotTags(Tcl_Interp *interp, Table *tablePtr, const char *tags,
+                    Row *rowPtr, Column *colPtr)
 {
-    Column *firstPtr, *lastPtr;
-    Columns *columnsPtr;
+    const char **argv;
+    int i, argc;
 
-    columnsPtr = blt_table_columns(table);
-    if (columnsPtr->flags & REINDEX) { 
-        ResetColumnMap(columnsPtr);
+    if (Tcl_SplitList(interp, tags, &argc, &argv) != TCL_OK) {
+        return TCL_ERROR;
     }
+    for (i = 0; i < argc; i++) {
+        int result;
 
-    iterPtr->chain = NULL;
-    iterPtr->link = NULL;
-    iterPtr->numEntries = 0;
-    iterPtr->table = table;
-    iterPtr->tag = "all";
-    iterPtr->type = TABLE_ITERATOR_ALL;
-
-    firstPtr = blt_table_first_column(table);
-    lastPtr = blt_table_last_column(table);
-    if (firstPtr != NULL) {
-        iterPtr->numEntries = lastPtr->index - firstPtr->index + 1;
-    } 
-    iterPtr->firstPtr = firstPtr;
-    iterPtr->lastPtr = lastPtr;
-}
-
-void
-blt_table_free_iterator_objv(BLT_TABLE_ITERATOR *iterPtr)
-{
-    if ((iterPtr->type == TABLE_ITERATOR_CHAIN) && (iterPtr->chain != NULL)) {
-        Blt_Chain_Destroy(iterPtr->chain);
-        iterPtr->chain = NULL;
+        if (rowPtr != NULL) {
+            result = blt_table_set_row_tag(interp, tablePtr, rowPtr, argv[i]);
+        } else {
+            result = blt_table_set_column_tag(interp, tablePtr, colPtr, 
+                                              argv[i]);
+        }
+        if (result != TCL_OK) {
+            Tcl_Free((char *)argv);
+            return TCL_ERROR;
+        }
     }
+    Tcl_Free((char *)argv);
+    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * FreeTrace --
- *
- *      Memory is deallocated for the trace.
+ * DecodeDenseDatum --
  *
- * Results:
- *      None.
+ *      Converts a value in the external binary layout into the datum of
+ *      a numeric column.  Doubles, times, and integers are 8 bytes wide
+ *      (long integers are stored as 64-bit), booleans are 4 bytes wide.
  *
  *---------------------------------------------------------------------------
  */
 static void
-FreeTrace(Trace *tracePtr)
+DecodeDenseDatum(BLT_TABLE_COLUMN_TYPE type, const unsigned char *p, 
+                 Value *valuePtr)
 {
-    if (tracePtr->rowTag != NULL) {
-        Blt_Free(tracePtr->rowTag);
-    }
-    if (tracePtr->colTag != NULL) {
-        Blt_Free(tracePtr->colTag);
+    switch (type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+        memcpy(&valuePtr->datum.d, p, 8);
+        break;
+    case TABLE_COLUMN_TYPE_INT64:
+        memcpy(&valuePtr->datum.i64, p, 8);
+        break;
+    case TABLE_COLUMN_TYPE_LONG:
+        {
+            int64_t i64;
+
+            memcpy(&i64, p, 8);
+            valuePtr->datum.l = (long)i64;
+        }
+        break;
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        {
+            int32_t i32;
+
+            memcpy(&i32, p, 4);
+            valuePtr->datum.l = i32;
+        }
+        break;
+    default:
+        break;
     }
-    Blt_Free(tracePtr);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_delete_trace --
- *
- *      Deletes a trace.
- *
- * Results:
- *      None.
+ * LoadDenseValues --
  *
- * Side Effects:
- *      Memory is deallocated for the trace.
+ *      Stores a block of values in the external binary layout into the
+ *      native array of a numeric column.  If the rows are consecutive in
+ *      the column's array and the values are already in the native
+ *      format, the whole block is copied at once.  If clearEmpty is set,
+ *      cells whose bit is clear in the bitmap are emptied, otherwise they
+ *      keep their current value.  Keys, indices, and statistics of the
+ *      column are not updated.
  *
  *---------------------------------------------------------------------------
  */
-void
-blt_table_delete_trace(Table *tablePtr, Trace *tracePtr)
+static int
+LoadDenseValues(Tcl_Interp *interp, Table *tablePtr, Column *colPtr,
+                size_t numRows, Row **rows, const unsigned char *bitmap,
+                const unsigned char *values, size_t width, int isContiguous,
+                int clearEmpty)
 {
-    Blt_HashEntry *hPtr;
+    size_t i;
 
-    hPtr = Blt_FindHashEntry(&tablePtr->traces, tracePtr);
-    if (hPtr == NULL) {
-        return;                         /* Invalid trace token. */
+    if ((colPtr->data == NULL) && (!AllocDenseStorage(tablePtr, colPtr))) {
+        Tcl_AppendResult(interp, "can't allocate column \"", colPtr->label,
+                         "\": out of memory", (char *)NULL);
+        return TCL_ERROR;
     }
-    Blt_DeleteHashEntry(&tablePtr->traces, hPtr);
-    if ((tracePtr->flags & TABLE_TRACE_DESTROYED) == 0) {
-        if (tracePtr->deleteProc != NULL) {
-            (*tracePtr->deleteProc)(tracePtr->clientData);
+    if ((isContiguous) && (colPtr->strings == NULL) &&
+        (width == DenseValueSize(colPtr->type))) {
+        long first;
+
+        /* Bulk load: the rows are consecutive in the column's array and
+         * the values are in the native format. */
+        first = rows[0]->offset;
+        memcpy((char *)colPtr->data + first * width, values, numRows * width);
+        for (i = 0; i < numRows; i++) {
+            if (bitmap[i >> 3] & (1 << (i & 7))) {
+                DenseSet(colPtr, first + i);
+            } else {
+                DenseClear(colPtr, first + i);
+            }
         }
-        if (tracePtr->flags & TABLE_TRACE_PENDING) {
-            Tcl_CancelIdleCall(TraceIdleProc, tracePtr);
+        return TCL_OK;
+    }
+    for (i = 0; i < numRows; i++) {
+        Value value;
+        long offset;
+
+        offset = rows[i]->offset;
+        if (((bitmap[i >> 3] & (1 << (i & 7))) == 0) && (!clearEmpty)) {
+            continue;
         }
-        /* 
-         * This accomplishes two things.  
-         * 1) It doesn't let it anything match the trace and 
-         * 2) marks the trace as invalid. 
-         */
-        /* Take it out of the list so you can't use it anymore. */
-        if (tracePtr->readLink != NULL) {
-            Blt_Chain_DeleteLink(tablePtr->readTraces, tracePtr->readLink);
-            tracePtr->readLink = NULL;
+        if ((colPtr->strings != NULL) && (colPtr->strings[offset] != NULL)) {
+            Blt_Free(colPtr->strings[offset]);
+            colPtr->strings[offset] = NULL;
         }
-        if (tracePtr->writeLink != NULL) {
-            Blt_Chain_DeleteLink(tablePtr->writeTraces, tracePtr->writeLink);
-            tracePtr->writeLink = NULL;
+        if ((bitmap[i >> 3] & (1 << (i & 7))) == 0) {
+            DenseClear(colPtr, offset);
+            continue;
         }
-        tracePtr->flags = TABLE_TRACE_DESTROYED;        
-        Tcl_EventuallyFree(tracePtr, (Tcl_FreeProc *)FreeTrace);
+        DecodeDenseDatum(colPtr->type, values + i * width, &value);
+        SetDenseDatum(colPtr, offset, &value);
+        DenseSet(colPtr, offset);
     }
+    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_create_trace --
- *
- *      Creates a trace for one or more rows/columns in the table based
- *      upon the given criteria.  Whenever a matching action occurs in the
- *      table object, the specified procedure is executed.
- *
- *      The trace may be put into 1 or 2 callback lists: one for read
- *      traces and another for write, create, and/or unset traces.  This is
- *      done to improve performance on reads.  We only examine the list of
- *      read traces, which in most cases will me empty.
- *
- * Results:
- *      Returns a token for the trace.
+ * RestoreSnapshotColumn --
  *
- * Side Effects:
- *      Memory is allocated for the trace.
+ *      Loads the cell values of a column from the snapshot.  Numeric
+ *      values are copied directly into the column's native array.  If
+ *      the rows are newly created and contiguous, the whole block is
+ *      copied at once.  If the snapshot is mapped into memory and the
+ *      rows start at the first offset, the column points directly into
+ *      the snapshot instead.  The strings of the column must already have
+ *      been checked by SnapshotStringsOk.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_TRACE
-blt_table_create_trace(
-    Table *tablePtr,                    /* Table to be traced. */
-    Row *rowPtr, 
-    Column *colPtr,                     /* Row/column in table. */
-    const char *rowTag, 
-    const char *colTag,
-    unsigned int flags,                 /* Bit mask indicating what actions
-                                         * to trace. */
-    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
-                                         * trace. */
-    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
-    ClientData clientData)              /* One-word of data passed along
-                                         * when the callback is
-                                         * executed. */
+static int
+RestoreSnapshotColumn(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
+                      const unsigned char *bytes, const SnapshotColumn *dirPtr,
+                      const unsigned char *heap, size_t heapSize,
+                      size_t numRows, Row **rows, int isContiguous, 
+                      int isMapped)
 {
-    Blt_HashEntry *hPtr;
-    Trace *tracePtr;
-    int isNew;
+    const unsigned char *bitmap, *values;
+    size_t i;
+    int isAttached;
+
+    if (colPtr->sharePtr != NULL) {
+        UnshareColumn(tablePtr->corePtr, colPtr);
+    }
+    FreeColumnStats(colPtr);
+    bitmap = bytes + dirPtr->bitmap;
+    values = bytes + dirPtr->values;
+    isAttached = FALSE;
+    if ((isMapped) && (isContiguous) && (rows[0]->offset == 0) &&
+        (IsDenseColumn(colPtr)) && (colPtr->data == NULL) &&
+        ((size_t)dirPtr->width == DenseValueSize(colPtr->type))) {
+        colPtr->data = (void *)values;
+        colPtr->nonEmpty = (unsigned char *)bitmap;
+        colPtr->flags |= TABLE_COLUMN_MAPPED;
+        isAttached = TRUE;
+    }
+    if (!IsDenseColumn(colPtr)) {
+        for (i = 0; i < numRows; i++) {
+            SnapshotString s;
+            Value value;
 
-    tracePtr = Blt_Calloc(1, sizeof (Trace));
-    if (tracePtr == NULL) {
-        return NULL;
-    }
-    tracePtr->row = rowPtr;
-    tracePtr->column = colPtr;
-    if (rowTag != NULL) {
-        tracePtr->rowTag = Blt_AssertStrdup(rowTag);
-    }
-    if (colTag != NULL) {
-        tracePtr->colTag = Blt_AssertStrdup(colTag);
-    }
-    tracePtr->flags = flags;
-    tracePtr->proc = proc;
-    tracePtr->deleteProc = deleteProc;
-    tracePtr->clientData = clientData;
-    if (tracePtr->flags & TABLE_TRACE_READS) {
-        tracePtr->readLink = Blt_Chain_Append(tablePtr->readTraces, tracePtr);
+            if ((bitmap[i >> 3] & (1 << (i & 7))) == 0) {
+                continue;
+            }
+            memcpy(&s, values + i * sizeof(s), sizeof(s));
+            memset(&value, 0, sizeof(Value));
+            if ((SetValueFromString(interp, colPtr, colPtr->type, 
+                        (const char *)heap + s.offset, s.length, &value) 
+                 != TCL_OK) ||
+                (PutValue(interp, tablePtr, rows[i], colPtr, &value) 
+                 != TCL_OK)) {
+                return TCL_ERROR;
+            }
+        }
+        return TCL_OK;
     }
-    if (tracePtr->flags & 
-        (TABLE_TRACE_WRITES | TABLE_TRACE_UNSETS | TABLE_TRACE_CREATES)) {
-        tracePtr->writeLink = Blt_Chain_Append(tablePtr->writeTraces, tracePtr);
+    if ((!isAttached) &&
+        (LoadDenseValues(interp, tablePtr, colPtr, numRows, rows, bitmap,
+                values, dirPtr->width, isContiguous, FALSE) != TCL_OK)) {
+        return TCL_ERROR;
     }
-    hPtr = Blt_CreateHashEntry(&tablePtr->traces, tracePtr, &isNew);
-    Tcl_SetHashValue(hPtr, tracePtr);
-    assert(isNew);
-    tracePtr->table = tablePtr;
-    return tracePtr;
-}
-
-void
-blt_table_trace_column(
-    Table *tablePtr,                    /* Table to be traced. */
-    Column *colPtr,                     /* Cell in table. */
-    unsigned int flags,                 /* Bit mask indicating what actions
-                                         * to trace. */
-    BLT_TABLE_TRACE_PROC *proc,        /* Callback procedure for the
-                                        * trace. */
-    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
-    ClientData clientData)              /* One-word of data passed along
-                                         * when the callback is
-                                         * executed. */
-{
-    blt_table_create_trace(tablePtr, NULL, colPtr, NULL, NULL, flags,
-                           proc, deleteProc, clientData);
-}
+    if (dirPtr->strings >= 0) {
+        const unsigned char *strings;
 
-BLT_TABLE_TRACE
-blt_table_create_column_trace(
-    Table *tablePtr,                    /* Table to be traced. */
-    Column *colPtr,                     /* Cell in table. */
-    unsigned int flags,                 /* Bit mask indicating what actions
-                                         * to trace. */
-    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
-                                         * trace. */
-    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
-    ClientData clientData)              /* One-word of data passed along
-                                         * when the callback is
-                                         * executed. */
-{
-    return blt_table_create_trace(tablePtr, NULL, colPtr, NULL, NULL, flags,
-                proc, deleteProc, clientData);
-}
+        strings = bytes + dirPtr->strings;
+        for (i = 0; i < numRows; i++) {
+            const char *string;
+            int64_t heapOffset;
+            long offset;
 
-BLT_TABLE_TRACE
-blt_table_create_column_tag_trace(
-    Table *tablePtr,                    /* Table to be traced. */
-    const char *colTag,                 /* Cell in table. */
-    unsigned int flags,                 /* Bit mask indicating what actions
-                                         * to trace. */
-    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
-                                         * trace. */
-    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
-    ClientData clientData)              /* One-word of data passed along
-                                         * when the callback is
-                                         * executed. */
-{
-    return blt_table_create_trace(tablePtr, NULL, NULL, NULL, colTag, flags,
-                proc, deleteProc, clientData);
+            if ((bitmap[i >> 3] & (1 << (i & 7))) == 0) {
+                continue;
+            }
+            memcpy(&heapOffset, strings + i * sizeof(int64_t), 
+                   sizeof(int64_t));
+            if (heapOffset < 0) {
+                continue;
+            }
+            string = (const char *)heap + heapOffset;
+            if (colPtr->strings == NULL) {
+                colPtr->strings = Blt_AssertCalloc(
+                        tablePtr->corePtr->rows.numAllocated, sizeof(char *));
+            }
+            offset = rows[i]->offset;
+            if (colPtr->strings[offset] != NULL) {
+                Blt_Free(colPtr->strings[offset]);
+            }
+            colPtr->strings[offset] = (char *)Blt_AssertStrdup(string);
+        }
+    }
+    return TCL_OK;
 }
 
-void
-blt_table_trace_row(
-    Table *tablePtr,                    /* Table to be traced. */
-    Row *rowPtr,                        /* Cell in table. */
-    unsigned int flags,                 /* Bit mask indicating what actions
-                                         * to trace. */
-    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
-                                         * trace. */
-    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
-    ClientData clientData)              /* One-word of data passed along
-                                         * when the callback is
-                                         * executed. */
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RestoreSnapshot --
+ *
+ *      Restores data to the given table from a binary snapshot generated
+ *      by blt_table_binary_dump.  The flags are the same as for
+ *      blt_table_restore.  If isMapped is set, the snapshot is a private
+ *      writable mapping that lives as long as the table object, and
+ *      numeric columns may point directly into it.
+ *
+ * Results:
+ *      A standard TCL result.  If the restore was successful, TCL_OK is
+ *      returned.  Otherwise, TCL_ERROR is returned and an error message
+ *      is left in the interpreter result.
+ *
+ * Side Effects:
+ *      Row and columns are created in the table and may possibly
+ *      generate notifier event callbacks.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+RestoreSnapshot(Tcl_Interp *interp, Table *tablePtr, 
+                const unsigned char *bytes, size_t numBytes,
+                unsigned int flags, int isMapped)
 {
-    blt_table_create_trace(tablePtr, 
-        rowPtr,                         /* Row */
-        (BLT_TABLE_COLUMN)NULL,         /* Column */
-        (const char *)NULL,             /* Row tag. */
-        (const char *)NULL,             /* Column tag. */
-        flags,                          /* Flags. */
-        proc,                           /* Callback procedure. */
-        deleteProc,                     /* Delete callback procedure. */
-        clientData);                    /* Data passed to callbacks. */
-}
+    Column **cols;
+    Row **rows;
+    SnapshotColumn *colDir;
+    SnapshotHeader header;
+    SnapshotRow *rowDir;
+    const unsigned char *heap;
+    size_t i, numRows, numCols, heapSize;
+    int isContiguous, result;
+
+    if (numBytes < sizeof(header)) {
+        return SnapshotError(interp, "too short");
+    }
+    memcpy(&header, bytes, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        return SnapshotError(interp, "missing header");
+    }
+    if (header.byteOrder != SNAPSHOT_BYTE_ORDER) {
+        return SnapshotError(interp, "written with a different byte order");
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        Tcl_AppendResult(interp, "can't restore datatable snapshot version ",
+                         Blt_Ltoa(header.version), (char *)NULL);
+        return TCL_ERROR;
+    }
+    if ((header.numRows < 0) || (header.numCols < 0) ||
+        (header.numRows > (int64_t)(numBytes / sizeof(SnapshotRow))) ||
+        (header.numCols > (int64_t)(numBytes / sizeof(SnapshotColumn))) ||
+        (!SnapshotBlockOk(numBytes, sizeof(header),
+                header.numRows * sizeof(SnapshotRow) + 
+                header.numCols * sizeof(SnapshotColumn))) ||
+        (header.heapOffset < 0) || ((uint64_t)header.heapOffset > numBytes)) {
+        return SnapshotError(interp, "bad directory");
+    }
+    numRows = header.numRows;
+    numCols = header.numCols;
+    heap = bytes + header.heapOffset;
+    heapSize = numBytes - header.heapOffset;
+    if ((heapSize > 0) && (heap[heapSize - 1] != '\0')) {
+        return SnapshotError(interp, "bad string heap");
+    }
+    /* Copy the directories, since the snapshot may not be aligned. */
+    rowDir = Blt_AssertMalloc((numRows + 1) * sizeof(SnapshotRow));
+    memcpy(rowDir, bytes + sizeof(header), numRows * sizeof(SnapshotRow));
+    colDir = Blt_AssertMalloc((numCols + 1) * sizeof(SnapshotColumn));
+    memcpy(colDir, bytes + sizeof(header) + numRows * sizeof(SnapshotRow),
+           numCols * sizeof(SnapshotColumn));
+    rows = Blt_AssertMalloc((numRows + 1) * sizeof(Row *));
+    cols = Blt_AssertMalloc((numCols + 1) * sizeof(Column *));
+    result = TCL_ERROR;
 
-BLT_TABLE_TRACE
-blt_table_create_row_trace(
-    Table *tablePtr,                    /* Table to be traced. */
-    Row *rowPtr,                        /* Cell in table. */
-    unsigned int flags,                 /* Bit mask indicating what actions
-                                         * to trace. */
-    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
-                                         * trace. */
-    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
-    ClientData clientData)              /* One-word of data passed along
-                                         * when the callback is
-                                         * executed. */
-{
-    return blt_table_create_trace(tablePtr, 
-        rowPtr, 
-        (Column *)NULL, 
-        (const char *)NULL, 
-        (const char *)NULL, 
-        flags,
-        proc, 
-        deleteProc, 
-        clientData);
+    /* Check everything in the snapshot before changing the table. */
+    for (i = 0; i < numRows; i++) {
+        if ((SnapshotHeapString(heap, heapSize, rowDir[i].label) == NULL) ||
+            (!SnapshotTagsOk(heap, heapSize, rowDir[i].tags))) {
+            SnapshotError(interp, "bad row label");
+            goto done;
+        }
+    }
+    for (i = 0; i < numCols; i++) {
+        SnapshotColumn *dirPtr;
+
+        dirPtr = colDir + i;
+        if ((SnapshotHeapString(heap, heapSize, dirPtr->label) == NULL) ||
+            (!SnapshotTagsOk(heap, heapSize, dirPtr->tags))) {
+            SnapshotError(interp, "bad column label");
+            goto done;
+        }
+        if ((dirPtr->type < TABLE_COLUMN_TYPE_STRING) ||
+            (dirPtr->type > TABLE_COLUMN_TYPE_BLOB) ||
+            (dirPtr->width != SnapshotWidth(dirPtr->type))) {
+            SnapshotError(interp, "bad column type");
+            goto done;
+        }
+        if ((dirPtr->encoding != TABLE_COLUMN_ENCODING_NONE) &&
+            ((dirPtr->encoding != TABLE_COLUMN_ENCODING_DICTIONARY) ||
+             (dirPtr->type != TABLE_COLUMN_TYPE_STRING))) {
+            SnapshotError(interp, "bad column encoding");
+            goto done;
+        }
+        if ((!SnapshotBlockOk(numBytes, dirPtr->bitmap, 
+                              DenseBitmapSize(numRows))) ||
+            (!SnapshotBlockOk(numBytes, dirPtr->values, 
+                              numRows * dirPtr->width)) ||
+            ((dirPtr->strings >= 0) &&
+             (!SnapshotBlockOk(numBytes, dirPtr->strings, 
+                               numRows * sizeof(int64_t))))) {
+            SnapshotError(interp, "column block out of range");
+            goto done;
+        }
+        if (!SnapshotStringsOk(bytes, dirPtr, heap, heapSize, numRows)) {
+            SnapshotError(interp, "string out of range");
+            goto done;
+        }
+    }
+
+    /* Create or find the rows. */
+    isContiguous = FALSE;
+    if (flags & TABLE_RESTORE_OVERWRITE) {
+        for (i = 0; i < numRows; i++) {
+            const char *label;
+
+            label = (const char *)heap + rowDir[i].label;
+            rows[i] = blt_table_get_row_by_label(tablePtr, label);
+            if (rows[i] == NULL) {
+                rows[i] = blt_table_create_row(interp, tablePtr, label);
+                if (rows[i] == NULL) {
+                    goto done;
+                }
+            }
+        }
+    } else if (numRows > 0) {
+        if (blt_table_extend_rows(interp, tablePtr, numRows, rows) != TCL_OK) {
+            goto done;
+        }
+        isContiguous = TRUE;
+        for (i = 0; i < numRows; i++) {
+            if (blt_table_set_row_label(interp, tablePtr, rows[i], 
+                        (const char *)heap + rowDir[i].label) != TCL_OK) {
+                goto done;
+            }
+            if (rows[i]->offset != (rows[0]->offset + (long)i)) {
+                isContiguous = FALSE;
+            }
+        }
+    }
+    if ((flags & TABLE_RESTORE_NO_TAGS) == 0) {
+        for (i = 0; i < numRows; i++) {
+            if ((rowDir[i].tags >= 0) &&
+                (RestoreSnapshotTags(interp, tablePtr, 
+                        (const char *)heap + rowDir[i].tags, rows[i], NULL)
+                 != TCL_OK)) {
+                goto done;
+            }
+        }
+    }
+
+    /* Create or find each column and load its values. */
+    for (i = 0; i < numCols; i++) {
+        SnapshotColumn *dirPtr;
+        Column *colPtr;
+        const char *label;
+
+        dirPtr = colDir + i;
+        label = (const char *)heap + dirPtr->label;
+        colPtr = blt_table_get_column_by_label(tablePtr, label);
+        if ((colPtr == NULL) || ((flags & TABLE_RESTORE_OVERWRITE) == 0)) {
+            colPtr = blt_table_create_column(interp, tablePtr, label);
+            if (colPtr == NULL) {
+                goto done;
+            }
+        }
+        cols[i] = colPtr;
+        if ((colPtr->type != (BLT_TABLE_COLUMN_TYPE)dirPtr->type) &&
+            (blt_table_set_column_type(interp, tablePtr, colPtr, 
+                dirPtr->type) != TCL_OK)) {
+            goto done;
+        }
+        /* Encode the column before loading its values, so that strings
+         * are stored directly in the dictionary. */
+        if (blt_table_set_column_encoding(interp, tablePtr, colPtr, 
+                dirPtr->encoding) != TCL_OK) {
+            goto done;
+        }
+        if (((flags & TABLE_RESTORE_NO_TAGS) == 0) && (dirPtr->tags >= 0) &&
+            (RestoreSnapshotTags(interp, tablePtr, 
+                (const char *)heap + dirPtr->tags, NULL, colPtr) != TCL_OK)) {
+            goto done;
+        }
+        if (colPtr->indexPtr != NULL) {
+            InvalidateIndex(colPtr);
+        }
+        if ((numRows > 0) && 
+            (RestoreSnapshotColumn(interp, tablePtr, colPtr, bytes, dirPtr, 
+                heap, heapSize, numRows, rows, isContiguous, isMapped) 
+             != TCL_OK)) {
+            goto done;
+        }
+        if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
+            InvalidateKeys(tablePtr, colPtr);
+        }
+    }
+    result = TCL_OK;
+ done:
+    Blt_Free(rowDir);
+    Blt_Free(colDir);
+    Blt_Free(rows);
+    Blt_Free(cols);
+    return result;
 }
 
-BLT_TABLE_TRACE
-blt_table_create_row_tag_trace(
-    Table *tablePtr,                    /* Table to be traced. */
-    const char *rowTag,                 /* Cell in table. */
-    unsigned int flags,                 /* Bit mask indicating what actions
-                                         * to trace. */
-    BLT_TABLE_TRACE_PROC *proc,         /* Callback procedure for the
-                                         * trace. */
-    BLT_TABLE_TRACE_DELETE_PROC *deleteProc, 
-    ClientData clientData)              /* One-word of data passed along
-                                         * when the callback is
-                                         * executed. */
+int
+blt_table_binary_restore(Tcl_Interp *interp, Table *tablePtr, 
+                         const unsigned char *bytes, size_t numBytes,
+                         unsigned int flags)
 {
-    return blt_table_create_trace(tablePtr, NULL, NULL, rowTag, NULL, flags,
-                proc, deleteProc, clientData);
+    return RestoreSnapshot(interp, tablePtr, bytes, numBytes, flags, FALSE);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_release_tags --
+ * blt_table_file_binary_restore --
  *
- *      Releases the tag table used by this client.  
+ *      Restores data to the given table from a binary snapshot file.  The
+ *      file is mapped into memory (where supported) so that the column
+ *      blocks are loaded directly from the page cache.  If the filename
+ *      starts with an '@', then it is the name of an already opened
+ *      channel to be read.
  *
  * Results:
- *      None.
- *
- * Side Effects:
- *      If no client is using the table, then it is freed.
+ *      A standard TCL result.
  *
  *---------------------------------------------------------------------------
  */
-void
-blt_table_release_tags(Table *tablePtr)
+int
+blt_table_file_binary_restore(Tcl_Interp *interp, Table *tablePtr, 
+                              const char *fileName, unsigned int flags)
 {
-    Tags *tagsPtr;
+    Tcl_Channel channel;
+    Tcl_Obj *objPtr;
+    int closeChannel;
+    int numBytes, result;
+    unsigned char *bytes;
 
-    tagsPtr = tablePtr->tags;
-    tagsPtr->refCount--;
-    if (tagsPtr->refCount <= 0) {
-        Blt_Tags_Reset(&tagsPtr->rowTags);
-        tablePtr->rowTags = NULL;
-        Blt_Tags_Reset(&tagsPtr->columnTags);
-        tablePtr->columnTags = NULL;
-        Blt_Free(tagsPtr);
+    closeChannel = TRUE;
+    if ((fileName[0] == '@') && (fileName[1] != '\0')) {
+        int mode;
+        
+        channel = Tcl_GetChannel(interp, fileName+1, &mode);
+        if (channel == NULL) {
+            return TCL_ERROR;
+        }
+        if ((mode & TCL_READABLE) == 0) {
+            Tcl_AppendResult(interp, "channel \"", fileName, 
+                "\" not opened for reading", (char *)NULL);
+            return TCL_ERROR;
+        }
+        closeChannel = FALSE;
+    } else {
+#ifdef HAVE_SYS_MMAN_H
+        Tcl_DString ds;
+        const char *path;
+        struct stat sb;
+        void *addr;
+        int fd;
+
+        path = Tcl_TranslateFileName(interp, fileName, &ds);
+        if (path == NULL) {
+            return TCL_ERROR;
+        }
+        fd = open(path, O_RDONLY);
+        Tcl_DStringFree(&ds);
+        if (fd < 0) {
+            Tcl_AppendResult(interp, "can't open \"", fileName, "\": ", 
+                             Tcl_PosixError(interp), (char *)NULL);
+            return TCL_ERROR;
+        }
+        if (fstat(fd, &sb) < 0) {
+            Tcl_AppendResult(interp, "can't stat \"", fileName, "\": ", 
+                             Tcl_PosixError(interp), (char *)NULL);
+            close(fd);
+            return TCL_ERROR;
+        }
+        if (sb.st_size == 0) {
+            close(fd);
+            return SnapshotError(interp, "too short");
+        }
+        addr = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) {
+            Tcl_AppendResult(interp, "can't map \"", fileName, "\": ", 
+                             Tcl_PosixError(interp), (char *)NULL);
+            return TCL_ERROR;
+        }
+#ifdef MADV_SEQUENTIAL
+        madvise(addr, sb.st_size, MADV_SEQUENTIAL);
+#endif  /* MADV_SEQUENTIAL */
+        result = blt_table_binary_restore(interp, tablePtr, addr, sb.st_size,
+                                          flags);
+        munmap(addr, sb.st_size);
+        return result;
+#else
+        channel = Tcl_OpenFileChannel(interp, fileName, "r", 0);
+        if (channel == NULL) {
+            return TCL_ERROR;   /* Can't open snapshot file. */
+        }
+#endif  /* HAVE_SYS_MMAN_H */
+    }
+    result = TCL_ERROR;
+    objPtr = Tcl_NewObj();
+    Tcl_IncrRefCount(objPtr);
+    if ((Tcl_SetChannelOption(interp, channel, "-translation", "binary") 
+         == TCL_OK) && (Tcl_ReadChars(channel, objPtr, -1, 0) >= 0)) {
+        bytes = Tcl_GetByteArrayFromObj(objPtr, &numBytes);
+        result = blt_table_binary_restore(interp, tablePtr, bytes, numBytes,
+                                          flags);
+    } else if (Tcl_GetString(Tcl_GetObjResult(interp))[0] == '\0') {
+        Tcl_AppendResult(interp, "error reading \"", fileName, "\": ", 
+                         Tcl_PosixError(interp), (char *)NULL);
+    }
+    Tcl_DecrRefCount(objPtr);
+    if (closeChannel) {
+        Tcl_Close(interp, channel);
     }
+    return result;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_tags_are_shared --
+ * blt_table_map_snapshot --
  *
- *      Returns whether the tag table is shared with another client.
+ *      Loads an empty table from a binary snapshot file by mapping the
+ *      file into memory.  Numeric columns are not copied: their values
+ *      and bitmaps point directly into a private mapping of the file.
+ *      Several processes mapping the same snapshot share its pages
+ *      until one of them writes to a cell, at which point only the
+ *      touched page is copied.  A column is moved to its own storage
+ *      when rows are added, the table is packed, or its type changes.
+ *
+ *      String columns, labels, and tags are always copied.  If memory
+ *      mapped files aren't available, the snapshot is simply read.
  *
  * Results:
- *      Returns TRUE if the current tag table is shared with another
- *      client, FALSE otherwise.
+ *      Returns a standard TCL result.
  *
  *---------------------------------------------------------------------------
  */
 int
-blt_table_tags_are_shared(Table *tablePtr)
+blt_table_map_snapshot(Tcl_Interp *interp, Table *tablePtr, 
+                       const char *fileName)
+{
+#ifdef HAVE_SYS_MMAN_H
+    TableObject *corePtr;
+    Tcl_DString ds;
+    const char *path;
+    struct stat sb;
+    void *addr;
+    int fd, result, isMapped;
+    long i;
+
+    corePtr = tablePtr->corePtr;
+    if ((corePtr->mapAddr != NULL) || (corePtr->rows.numUsed > 0) || 
+        (corePtr->columns.numUsed > 0)) {
+        Tcl_AppendResult(interp, "can't map \"", fileName, 
+                "\": table \"", tablePtr->name, "\" is not empty", 
+                (char *)NULL);
+        return TCL_ERROR;
+    }
+    path = Tcl_TranslateFileName(interp, fileName, &ds);
+    if (path == NULL) {
+        return TCL_ERROR;
+    }
+    fd = open(path, O_RDONLY);
+    Tcl_DStringFree(&ds);
+    if (fd < 0) {
+        Tcl_AppendResult(interp, "can't open \"", fileName, "\": ", 
+                         Tcl_PosixError(interp), (char *)NULL);
+        return TCL_ERROR;
+    }
+    if (fstat(fd, &sb) < 0) {
+        Tcl_AppendResult(interp, "can't stat \"", fileName, "\": ", 
+                         Tcl_PosixError(interp), (char *)NULL);
+        close(fd);
+        return TCL_ERROR;
+    }
+    if (sb.st_size < (off_t)sizeof(SnapshotHeader)) {
+        close(fd);
+        return SnapshotError(interp, "too short");
+    }
+    /* 
+     * The mapping is private and writable: cells can be set in place
+     * and the kernel copies only the pages that are modified.
+     */
+    addr = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        Tcl_AppendResult(interp, "can't map \"", fileName, "\": ", 
+                         Tcl_PosixError(interp), (char *)NULL);
+        return TCL_ERROR;
+    }
+    corePtr->mapAddr = addr;
+    corePtr->mapSize = sb.st_size;
+    corePtr->numMappedRows = ((SnapshotHeader *)addr)->numRows;
+    result = RestoreSnapshot(interp, tablePtr, addr, sb.st_size, 0, TRUE);
+    isMapped = FALSE;
+    for (i = 0; i < corePtr->columns.numUsed; i++) {
+        Column *colPtr;
+
+        colPtr = corePtr->columns.map[i];
+        if ((colPtr->flags & TABLE_COLUMN_MAPPED) == 0) {
+            continue;
+        }
+        if (result != TCL_OK) {
+            /* Don't leave columns pointing into the mapping. */
+            colPtr->data = NULL;
+            colPtr->nonEmpty = NULL;
+            colPtr->flags &= ~TABLE_COLUMN_MAPPED;
+            continue;
+        }
+        isMapped = TRUE;
+    }
+    if (!isMapped) {
+        ReleaseMapping(corePtr);
+    }
+    return result;
+#else
+    return blt_table_file_binary_restore(interp, tablePtr, fileName, 0);
+#endif  /* HAVE_SYS_MMAN_H */
+}
+
+static void
+FreePrimaryKeys(Table *tablePtr)
+{
+    int i;
+    
+    for (i = 0; i < tablePtr->numKeys; i++) {
+        Column *colPtr;
+        
+        colPtr = tablePtr->primaryKeys[i];
+        colPtr->flags &= ~TABLE_COLUMN_PRIMARY_KEY;
+    }
+    Blt_Free(tablePtr->primaryKeys);
+    tablePtr->primaryKeys = NULL;
+    tablePtr->numKeys = 0;
+}
+
+static void
+FreeKeyTables(Table *tablePtr)
+{
+    if (tablePtr->keyTables != NULL) {
+        int i;
+
+        for (i = 0; i < tablePtr->numKeys; i++) {
+            Blt_DeleteHashTable(tablePtr->keyTables + i);
+        }
+        Blt_Free(tablePtr->keyTables);
+        tablePtr->keyTables = NULL;
+    }
+    if (tablePtr->masterKey != NULL) {
+        Blt_Free(tablePtr->masterKey);
+        Blt_DeleteHashTable(&tablePtr->masterKeyTable);
+        Blt_DeleteHashTable(&tablePtr->duplicateKeyTable);
+        tablePtr->masterKey = NULL;
+    }
+}
+
+void
+blt_table_unset_keys(Table *tablePtr)
+{
+    FreeKeyTables(tablePtr);
+    FreePrimaryKeys(tablePtr);
+    tablePtr->flags &= ~(TABLE_KEYS_DIRTY | TABLE_KEYS_UNIQUE);
+}
+
+int
+blt_table_get_keys(Table *tablePtr, BLT_TABLE_COLUMN **keysPtr)
 {
-    return (tablePtr->tags->refCount > 1);
-}   
+    *keysPtr = tablePtr->primaryKeys;
+    return tablePtr->numKeys;
+}
 
-/*
- *---------------------------------------------------------------------------
- *
- * blt_table_new_tags --
- *
- *      Releases the old tag table (if it exists) and creates a new empty
- *      tag table.
- *
- * Results:
- *      None.
- *
- * Side Effects:
- *      Possible frees memory for the old tag table (if no one else is
- *      using it) and resets the pointers to the new tag tables.
- *
- *---------------------------------------------------------------------------
- */
-void
-blt_table_new_tags(Table *tablePtr)
+static int
+SameKeys(int len1, BLT_TABLE_COLUMN *keys1, int len2, BLT_TABLE_COLUMN *keys2)
 {
-    if (tablePtr->tags != NULL) {
-        blt_table_release_tags(tablePtr);
+    int i;
+    
+    if (len1 != len2) {
+        return FALSE;
     }
-    tablePtr->tags = NewTags();
-    tablePtr->rowTags = &tablePtr->tags->rowTags;
-    tablePtr->columnTags = &tablePtr->tags->columnTags;
+    for (i = 0; i < len1; i++) {
+        if (keys1[i] != keys2[i]) {
+            fprintf(stderr, "different keys\n");
+            return FALSE;
+        }
+    } 
+    return TRUE;
 }
 
-/*
- *---------------------------------------------------------------------------
- *
- * blt_table_forget_row_tag --
- *
- *      Removes a tag from the row tag table.  Row tags are contained in
- *      hash tables keyed by the tag name.  Each table is in turn hashed by
- *      the row index in the row tag table.
- *
- * Results:
- *      None.
- *
- * Side Effects:
- *      Entries for the given tag in the corresponding row in hash tables
- *      may be removed.
- *      
- *---------------------------------------------------------------------------
- */
 int
-blt_table_forget_row_tag(Tcl_Interp *interp, Table *tablePtr, const char *tag)
+blt_table_set_keys(Table *tablePtr, int numKeys, BLT_TABLE_COLUMN *keys,
+                   int unique)
 {
-    if ((strcmp(tag, "all") == 0) || (strcmp(tag, "end") == 0)) {
-        return TCL_OK;                  /* Can't forget reserved tags. */
+    int i;
+    
+    if (SameKeys(tablePtr->numKeys, tablePtr->primaryKeys, numKeys, keys)) {
+        return TCL_OK;
+    }
+    if (tablePtr->primaryKeys != NULL) {
+        FreePrimaryKeys(tablePtr);
+    }
+    tablePtr->primaryKeys = keys;
+    tablePtr->numKeys = numKeys;
+    
+    /* Mark the designated columns as primary keys.  This flag is used to
+     * check if a primary column is deleted, it's rows are added or
+     * changed, or it's values set or unset.  The generated keytables are
+     * invalid and need to be regenerated. */
+    for (i = 0; i < numKeys; i++) {
+        Column *colPtr;
+        
+        colPtr = keys[i];
+        colPtr->flags |= TABLE_COLUMN_PRIMARY_KEY;
+    }
+    tablePtr->flags |= TABLE_KEYS_DIRTY;
+    if (unique) {
+        tablePtr->flags |= TABLE_KEYS_UNIQUE;
     }
-    Blt_Tags_ForgetTag(tablePtr->rowTags, tag);
     return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_forget_column_tag --
- *
- *      Removes a tag from the column tag table.  Column tags are contained
- *      in hash tables keyed by the tag name.  Each table is in turn hashed
- *      by the column offset in the column tag table.
+ * GetKeyEntry --
  *
- * Results:
- *      None.
+ *      Returns the entry for the row's value in the hash table of the
+ *      given key column.  If create is set, the entry is created if it
+ *      doesn't already exist.
  *
- * Side Effects:
- *      Entries for the given tag in the corresponding column in hash tables
- *      may be removed.
- *      
  *---------------------------------------------------------------------------
  */
-int
-blt_table_forget_column_tag(Tcl_Interp *interp, Table *tablePtr, 
-                            const char *tag)
+static Blt_HashEntry *
+GetKeyEntry(Table *tablePtr, int index, Row *rowPtr, int create)
 {
-    if ((strcmp(tag, "all") == 0) || (strcmp(tag, "end") == 0)) {
-        return TCL_OK;                  /* Can't forget reserved tags. */
+    Blt_HashTable *keyTablePtr;
+    Column *colPtr;
+    Value value;
+    const void *key;
+    unsigned int length;
+    int isNew;
+
+    colPtr = tablePtr->primaryKeys[index];
+    keyTablePtr = tablePtr->keyTables + index;
+    switch (colPtr->type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+        GetCellDatum(rowPtr, colPtr, &value);
+        key = &value.datum.d;
+        break;
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+    case TABLE_COLUMN_TYPE_LONG:
+        GetCellDatum(rowPtr, colPtr, &value);
+        key = (const void *)(intptr_t)value.datum.l;
+        break;
+    case TABLE_COLUMN_TYPE_STRING:
+    default:
+        key = GetCellString(tablePtr, rowPtr, colPtr, &length);
+        break;
     }
-    Blt_Tags_ForgetTag(tablePtr->columnTags, tag);
-    return TCL_OK;
+    if (create) {
+        return Blt_CreateHashEntry(keyTablePtr, key, &isNew);
+    }
+    return Blt_FindHashEntry(keyTablePtr, key);
+}
+
+static int
+HasKeyValues(Table *tablePtr, Row *rowPtr)
+{
+    int i;
+
+    for (i = 0; i < tablePtr->numKeys; i++) {
+        if (IsEmpty(rowPtr, tablePtr->primaryKeys[i])) {
+            return FALSE;               /* Rows with an empty key value
+                                         * aren't indexed. */
+        }
+    }
+    return TRUE;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_set_row_tag --
+ * AddRowKeys --
  *
- *      Associates a tag with a given row.  Individual row tags are stored
- *      in hash tables keyed by the tag name.  Each table is in turn stored
- *      in a hash table keyed by the row location. If the row is NULL, this
- *      indicates to simply create the tag entry.
+ *      Adds the row to the key tables of the table.  Each entry of an
+ *      individual key table counts the rows using that value.  The master
+ *      key is the combination of these entries.  The first row added
+ *      with a master key is the one found by lookups.  Any other rows
+ *      with the same master key are counted in the duplicate table.
  *
  * Results:
- *      None.
- *
- * Side Effects:
- *      A tag is stored for a particular row.
+ *      Returns the row that already has the same keys, NULL otherwise.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_set_row_tag(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr, 
-                    const char *tag)
+static Row *
+AddRowKeys(Table *tablePtr, Row *rowPtr)
 {
-    char c;
-    long dummy;
-    
-    c = tag[0];
-    if (((c == 'a') && (strcmp(tag, "all") == 0)) ||
-        ((c == 'e') && (strcmp(tag, "end") == 0))) {
-        return TCL_OK;          /* Don't need to create reserved tags. */
-    }
-    if (c == '\0') {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "tag \"", tag, "\" can't be empty.", 
-                (char *)NULL);
-        }
-        return TCL_ERROR;
-    }
-    if (c == '-') {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "tag \"", tag, 
-                "\" can't start with a '-'.", (char *)NULL);
-        }
-        return TCL_ERROR;
+    Blt_HashEntry *hPtr;
+    int i, isNew;
+
+    if (!HasKeyValues(tablePtr, rowPtr)) {
+        return NULL;
     }
-    if ((isdigit(c)) && Blt_GetLong(NULL, (char *)tag, &dummy) == TCL_OK) {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "tag \"", tag, "\" can't be a number.",
-                             (char *)NULL);
-        }
-        return TCL_ERROR;
+    for (i = 0; i < tablePtr->numKeys; i++) {
+        intptr_t refCount;
+
+        hPtr = GetKeyEntry(tablePtr, i, rowPtr, TRUE);
+        refCount = (intptr_t)Blt_GetHashValue(hPtr);
+        Blt_SetHashValue(hPtr, (ClientData)(refCount + 1));
+        tablePtr->masterKey[i] = hPtr;
     }
-    if (rowPtr == NULL) {
-        Blt_Tags_AddTag(tablePtr->rowTags, tag);
+    hPtr = Blt_CreateHashEntry(&tablePtr->masterKeyTable, tablePtr->masterKey,
+                               &isNew);
+    if (isNew) {
+        Blt_SetHashValue(hPtr, rowPtr);
+        return NULL;
     } else {
-        Blt_Tags_AddItemToTag(tablePtr->rowTags, tag, rowPtr);
+        Blt_HashEntry *dupPtr;
+        intptr_t count;
+
+        dupPtr = Blt_CreateHashEntry(&tablePtr->duplicateKeyTable, 
+                tablePtr->masterKey, &isNew);
+        count = (intptr_t)Blt_GetHashValue(dupPtr);
+        Blt_SetHashValue(dupPtr, (ClientData)(count + 1));
+        return Blt_GetHashValue(hPtr);
     }
-    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_set_column_tag --
- *
- *      Associates a tag with a given column.  Individual column tags are
- *      stored in hash tables keyed by the tag name.  Each table is in turn
- *      stored in a hash table keyed by the column location.  If the column
- *      is NULL, then this means to simply create the tag.
+ * RemoveRowKeys --
  *
- * Results:
- *      None.
- *
- * Side Effects:
- *      A tag is stored for a particular column.
+ *      Removes the row from the key tables of the table.  If the row is
+ *      the one found for its keys and other rows have the same keys, the
+ *      key tables are marked to be regenerated instead.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_set_column_tag(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
-                         const char *tag)
+static void
+RemoveRowKeys(Table *tablePtr, Row *rowPtr)
 {
-    long dummy;
-    char c;
+    Blt_HashEntry *hPtr, *dupPtr;
+    int i;
 
-    c = tag[0];
-    if (((c == 'a') && (strcmp(tag, "all") == 0)) ||
-        ((c == 'e') && (strcmp(tag, "end") == 0))) {
-        return TCL_OK;                  /* Don't create reserved tags. */
+    if (!HasKeyValues(tablePtr, rowPtr)) {
+        return;
     }
-    if (c == '\0') {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "tag \"", tag, "\" can't be empty.", 
-                             (char *)NULL);
+    for (i = 0; i < tablePtr->numKeys; i++) {
+        hPtr = GetKeyEntry(tablePtr, i, rowPtr, FALSE);
+        if (hPtr == NULL) {
+            tablePtr->flags |= TABLE_KEYS_DIRTY;
+            return;
         }
-        return TCL_ERROR;
+        tablePtr->masterKey[i] = hPtr;
     }
-    if (c == '-') {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "tag \"", tag, 
-                "\" can't start with a '-'.", (char *)NULL);
-        }
-        return TCL_ERROR;
+    hPtr = Blt_FindHashEntry(&tablePtr->masterKeyTable, tablePtr->masterKey);
+    if (hPtr == NULL) {
+        tablePtr->flags |= TABLE_KEYS_DIRTY;
+        return;
     }
-    if ((isdigit(c)) &&(Blt_GetLong(NULL, (const char *)tag, &dummy)==TCL_OK)) {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "tag \"", tag, "\" can't be a number.",
-                             (char *)NULL);
+    dupPtr = Blt_FindHashEntry(&tablePtr->duplicateKeyTable, 
+                               tablePtr->masterKey);
+    if (Blt_GetHashValue(hPtr) == rowPtr) {
+        if (dupPtr != NULL) {
+            /* Another row with the same keys must replace this one. */
+            tablePtr->flags |= TABLE_KEYS_DIRTY;
+            return;
+        }
+        Blt_DeleteHashEntry(&tablePtr->masterKeyTable, hPtr);
+    } else if (dupPtr != NULL) {
+        intptr_t count;
+
+        count = (intptr_t)Blt_GetHashValue(dupPtr) - 1;
+        if (count == 0) {
+            Blt_DeleteHashEntry(&tablePtr->duplicateKeyTable, dupPtr);
+        } else {
+            Blt_SetHashValue(dupPtr, (ClientData)count);
         }
-        return TCL_ERROR;
     }
-    if (colPtr == NULL) {
-        Blt_Tags_AddTag(tablePtr->columnTags, tag);
-    } else {
-        Blt_Tags_AddItemToTag(tablePtr->columnTags, tag, colPtr);
+    for (i = 0; i < tablePtr->numKeys; i++) {
+        intptr_t refCount;
+
+        hPtr = tablePtr->masterKey[i];
+        refCount = (intptr_t)Blt_GetHashValue(hPtr) - 1;
+        if (refCount == 0) {
+            Blt_DeleteHashEntry(tablePtr->keyTables + i, hPtr);
+        } else {
+            Blt_SetHashValue(hPtr, (ClientData)refCount);
+        }
     }
-    return TCL_OK;
 }
 
-/*
- *---------------------------------------------------------------------------
- *
- * blt_table_row_has_tag --
- *
- *      Checks if a tag is associated with the given row.  
- *
- * Results:
- *      Returns TRUE if the tag is found, FALSE otherwise.
- *
- *---------------------------------------------------------------------------
- */
-int
-blt_table_row_has_tag(Table *tablePtr, Row *rowPtr, const char *tag)
+static int
+IsKeyColumn(Table *tablePtr, Column *colPtr)
 {
-    char c;
+    int i;
 
-    c = tag[0];
-    if ((c == 'a') && (strcmp(tag, "all") == 0)) {
-        return TRUE;            /* "all" tags matches every row. */
+    if ((tablePtr->keyTables == NULL) || 
+        (tablePtr->flags & TABLE_KEYS_DIRTY)) {
+        return FALSE;                   /* Key tables will be rebuilt. */
     }
-    if ((c == 'e') && (strcmp(tag, "end") == 0)) {
-        return (blt_table_row_index(tablePtr, rowPtr)==
-                (blt_table_num_rows(tablePtr)-1));
+    for (i = 0; i < tablePtr->numKeys; i++) {
+        if (tablePtr->primaryKeys[i] == colPtr) {
+            return TRUE;
+        }
     }
-    return Blt_Tags_ItemHasTag(tablePtr->rowTags, rowPtr, tag);
+    return FALSE;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_column_has_tag --
- *
- *      Checks if a tag is associated with the given column.  
+ * UnlinkRowKeys --
  *
- * Results:
- *      Returns TRUE if the tag is found, FALSE otherwise.
+ *      Called before a value of a primary key column is changed.  Removes
+ *      the row from the key tables of every client that uses the column
+ *      as a key.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_column_has_tag(Table *tablePtr, Column *colPtr, const char *tag)
+static void
+UnlinkRowKeys(Table *tablePtr, Row *rowPtr, Column *colPtr)
 {
-    char c;
+    Blt_ChainLink link;
 
-    c = tag[0];
-    if ((c == 'a') && (strcmp(tag, "all") == 0)) {
-        return TRUE;                    /* "all" tags matches every column. */
-    }
-    if ((c == 'e') && (strcmp(tag, "end") == 0)) {
-        return (colPtr == (Column *)tablePtr->corePtr->columns.tailPtr);
+    for (link = Blt_Chain_FirstLink(tablePtr->corePtr->clients); link != NULL;
+         link = Blt_Chain_NextLink(link)) {
+        Table *clientPtr;
+
+        clientPtr = Blt_Chain_GetValue(link);
+        if (IsKeyColumn(clientPtr, colPtr)) {
+            RemoveRowKeys(clientPtr, rowPtr);
+        }
     }
-    return Blt_Tags_ItemHasTag(tablePtr->columnTags, colPtr, tag);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_unset_row_tag --
- *
- *      Removes a tag from a given row.  
- *
- * Results:
- *      A standard TCL result.  If an error occurred, TCL_ERROR is returned
- *      and the interpreter result contains the error message.
+ * LinkRowKeys --
  *
- * Side Effects:
- *      The tag associated with the row is freed.
+ *      Called after a value of a primary key column has changed.  Adds
+ *      the row back into the key tables of every client that uses the
+ *      column as a key.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_unset_row_tag(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr, 
-                        const char *tag)
+static void
+LinkRowKeys(Table *tablePtr, Row *rowPtr, Column *colPtr)
 {
-    char c;
+    Blt_ChainLink link;
 
-    c = tag[0];
-    if (((c == 'a') && (strcmp(tag, "all") == 0)) ||
-        ((c == 'e') && (strcmp(tag, "end") == 0))) {
-        return TCL_OK;                  /* Can't remove reserved tags. */
-    } 
-    Blt_Tags_RemoveItemFromTag(tablePtr->rowTags, tag, rowPtr);
-    return TCL_OK;
-}    
+    for (link = Blt_Chain_FirstLink(tablePtr->corePtr->clients); link != NULL;
+         link = Blt_Chain_NextLink(link)) {
+        Table *clientPtr;
+
+        clientPtr = Blt_Chain_GetValue(link);
+        if (IsKeyColumn(clientPtr, colPtr)) {
+            AddRowKeys(clientPtr, rowPtr);
+        }
+    }
+}
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_unset_column_tag --
- *
- *      Removes a tag from a given column.  
- *
- * Results:
- *      A standard TCL result.  If an error occurred, TCL_ERROR
- *      is returned and the interpreter result contains the error
- *      message.
+ * InvalidateKeys --
  *
- * Side Effects:
- *      The tag associated with the column is freed.
+ *      Marks the key tables of every client that uses the column as a key
+ *      to be regenerated.  This is done when the values of the column are
+ *      replaced wholesale.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_unset_column_tag(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
-                         const char *tag)
+static void
+InvalidateKeys(Table *tablePtr, Column *colPtr)
 {
-    char c;
+    Blt_ChainLink link;
 
-    c = tag[0];
-    if (((c == 'a') && (strcmp(tag, "all") == 0)) ||
-        ((c == 'e') && (strcmp(tag, "end") == 0))) {
-        return TCL_OK;                  /* Can't remove reserved tags. */
-    } 
-    Blt_Tags_RemoveItemFromTag(tablePtr->columnTags, tag, colPtr);
-    return TCL_OK;
-}    
+    for (link = Blt_Chain_FirstLink(tablePtr->corePtr->clients); link != NULL;
+         link = Blt_Chain_NextLink(link)) {
+        Table *clientPtr;
+
+        clientPtr = Blt_Chain_GetValue(link);
+        if (IsKeyColumn(clientPtr, colPtr)) {
+            clientPtr->flags |= TABLE_KEYS_DIRTY;
+        }
+    }
+}
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_clear_row_tags --
+ * MakeKeyTables --
  *
- *      Removes all tags for a given row.  
+ *      Generates the key tables from scratch.  Afterwards, the key tables
+ *      are updated in place as rows and key values change.
  *
  * Results:
- *      None.
- *
- * Side Effects:
- *      All tags associated with the row are freed.
+ *      Returns a standard TCL result.  If the keys were designated as
+ *      unique and two rows have the same keys, an error is returned and
+ *      the keys are unset.
  *
  *---------------------------------------------------------------------------
  */
-void
-blt_table_clear_row_tags(Table *tablePtr, Row *rowPtr)
+static int
+MakeKeyTables(Tcl_Interp *interp, Table *tablePtr)
 {
-    Blt_Tags_ClearTagsFromItem(tablePtr->rowTags, rowPtr);
-}
+    Row *rowPtr;
+    int i;
+    size_t masterKeySize;
+
+    FreeKeyTables(tablePtr);
+    tablePtr->flags &= ~TABLE_KEYS_DIRTY;
+
+    /* Create a hashtable for each key. */
+    tablePtr->keyTables =
+        Blt_Malloc(sizeof(Blt_HashTable) * tablePtr->numKeys);
+    if (tablePtr->keyTables == NULL) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "can't allocated keytables for ",
+                Blt_Itoa(tablePtr->numKeys), " keys.", (char *)NULL);
+        }
+        return TCL_ERROR;
+    }
+    for (i = 0; i < tablePtr->numKeys; i++) {
+        size_t size;
+        Column *colPtr;
+
+        colPtr = tablePtr->primaryKeys[i];
+        switch (colPtr->type) {
+        case TABLE_COLUMN_TYPE_DOUBLE:
+        case TABLE_COLUMN_TYPE_TIME:
+            size = sizeof(double)/sizeof(int);
+            break;
+        case TABLE_COLUMN_TYPE_BOOLEAN:
+        case TABLE_COLUMN_TYPE_LONG:
+            size = BLT_ONE_WORD_KEYS;
+            break;
+        default:
+        case TABLE_COLUMN_TYPE_STRING:
+            size = BLT_STRING_KEYS;
+            break;
+        }
+        Blt_InitHashTable(tablePtr->keyTables + i, size);
+    }
+    /* Generate a master table of key tuple combinations for each row.  
+     * We uniquely identify each key value by its entry in the key's hash
+     * table. The combination of these entries (in the exact order) is how
+     * we find the row. */
+    masterKeySize = sizeof(Blt_HashEntry *) * tablePtr->numKeys;
+    tablePtr->masterKey = Blt_AssertMalloc(masterKeySize);
+    Blt_InitHashTable(&tablePtr->masterKeyTable, masterKeySize / sizeof(int));
+    Blt_InitHashTable(&tablePtr->duplicateKeyTable, 
+                      masterKeySize / sizeof(int));
 
+    /* For each row, create hash entries for the individual key columns,
+     * but also for the combined keys for the row.  The hash of the
+     * combined keys must be unique. */
+    for (rowPtr = (Row *)tablePtr->corePtr->rows.headPtr; rowPtr != NULL; 
+         rowPtr = rowPtr->nextPtr) {
+        Row *dupRowPtr;
+
+        dupRowPtr = AddRowKeys(tablePtr, rowPtr);
+        if ((dupRowPtr != NULL) && (tablePtr->flags & TABLE_KEYS_UNIQUE)) {
+            if (interp != NULL) {
+                Tcl_AppendResult(interp, "primary keys are not unique:",
+                        "rows \"", blt_table_row_label(dupRowPtr), 
+                        "\" and \"", blt_table_row_label(rowPtr), 
+                        "\" have the same keys.", (char *)NULL);
+            }
+            blt_table_unset_keys(tablePtr);
+            return TCL_ERROR;           /* Bail out. Keys aren't unique. */
+        }
+    }
+    tablePtr->flags &= ~TABLE_KEYS_UNIQUE;
+    return TCL_OK;
+}
+            
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_clear_column_tags --
+ * blt_table_key_lookup --
  *
- *      Removes all tags for a given column.  
+ *      Look up the (hopefully) unique row that matches all the values
+ *      for each of the key columns.  
  *
  * Results:
- *      None.
- *
- * Side Effects:
- *      All tags associated with the column are freed.
+ *      Returns a standard TCL result.  *rowPtrPtr will return the 
+ *      pointer to the found row.  NULL is the row wasn't found.
  *
  *---------------------------------------------------------------------------
  */
-void
-blt_table_clear_column_tags(Table *tablePtr, Column *colPtr)
+int
+blt_table_key_lookup(Tcl_Interp *interp, Table *tablePtr, int objc, 
+                     Tcl_Obj *const *objv, Row **rowPtrPtr)
 {
-    Blt_Tags_ClearTagsFromItem(tablePtr->columnTags, colPtr);
+    int i;
+    Blt_HashEntry *hPtr;
+    
+    *rowPtrPtr = NULL;
+    if (objc != tablePtr->numKeys) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "wrong # of values: should be ",
+                Blt_Itoa(tablePtr->numKeys), " value(s) of ", (char *)NULL);
+            for (i = 0; i < tablePtr->numKeys; i++) {
+                BLT_TABLE_COLUMN col;
+
+                col = tablePtr->primaryKeys[i];
+                Tcl_AppendResult(interp, blt_table_column_label(col), " ", 
+                                 (char *)NULL);
+            }
+        }
+        return TCL_ERROR;               /* Wrong # of keys supplied. */
+    }
+    if (tablePtr->numKeys == 0) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "no primary keys designated",
+                         (char *)NULL);
+        }
+        return TCL_ERROR;
+    }
+    if (tablePtr->flags & TABLE_KEYS_DIRTY) {
+        if (MakeKeyTables(interp, tablePtr) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+    /* Create a master search key by getting the rows from the individual
+     * key hash tables for each key.  Use this key to search the master
+     * table. */
+    for (i = 0; i < tablePtr->numKeys; i++) {
+        Blt_HashTable *keyTablePtr;
+        Column *colPtr;
+        Blt_HashEntry *hPtr;
+
+        colPtr = tablePtr->primaryKeys[i];
+        keyTablePtr = tablePtr->keyTables + i;
+        switch (colPtr->type) {
+        case TABLE_COLUMN_TYPE_DOUBLE:
+        case TABLE_COLUMN_TYPE_TIME:
+            {
+                double dval;
+
+                if (Blt_GetDoubleFromObj(interp, objv[i], &dval) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                hPtr = Blt_FindHashEntry(keyTablePtr, &dval);
+            }
+            break;
+        case TABLE_COLUMN_TYPE_BOOLEAN:
+            {
+                int ival;
+                
+                if (Tcl_GetBooleanFromObj(interp, objv[i], &ival) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                hPtr = Blt_FindHashEntry(keyTablePtr, (intptr_t)ival);
+            }
+            break;
+        case TABLE_COLUMN_TYPE_LONG:
+            {
+                long lval;
+
+                if (Blt_GetLongFromObj(interp, objv[i], &lval) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                hPtr = Blt_FindHashEntry(keyTablePtr, (intptr_t)lval);
+            }
+            break;
+        default:
+        case TABLE_COLUMN_TYPE_STRING:
+            {
+                const char *string;
+
+                string = Tcl_GetString(objv[i]);
+                hPtr = Blt_FindHashEntry(keyTablePtr, string);
+            }
+            break;
+        }
+        if (hPtr == NULL) {
+            return TCL_OK;              /* Can't find one of the keys, so
+                                         * the whole search fails. */
+        }
+        tablePtr->masterKey[i] = hPtr;
+    }
+    hPtr = Blt_FindHashEntry(&tablePtr->masterKeyTable, tablePtr->masterKey);
+    if (hPtr == NULL) {
+        return TCL_OK;                  /* Each value is used, but not in
+                                         * this combination. */
+    }
+    *rowPtrPtr = Blt_GetHashValue(hPtr);
+    return TCL_OK;
 }
 
 /*
- *---------------------------------------------------------------------------
- *
- * blt_table_get_value --
- *
- *      Gets a scalar Tcl_Obj value from the table at the designated
- *      row, column location.  "Read" traces may be fired *before* the
- *      value is retrieved.  If no value exists at that location,
- *      *objPtrPtr is set to NULL.
- *
- * Results:
- *      A standard TCL result.  Returns TCL_OK if successful accessing
- *      the table location.  If an error occurs, TCL_ERROR is returned
- *      and an error message is left in the interpreter.
- *
- * -------------------------------------------------------------------------- 
+ * Ordered column indexes --
+ *
+ *      An index holds the rows of a column that have values, ordered by
+ *      value.  Numbers are compared numerically (NaNs last) and strings in
+ *      dictionary order, the same as the default sort.  Rows with equal
+ *      values are ordered by their row pointer, so every row has a unique
+ *      position and can be found by binary search when its value is about
+ *      to change.
+ *
+ *      The index is kept in the core table object, so it's shared by all
+ *      clients.  It's updated in place as cells are set or unset.  When
+ *      the column's values are replaced wholesale (restoring a snapshot or
+ *      changing the column type), the index is marked dirty and rebuilt
+ *      the next time it's used.
  */
-BLT_TABLE_VALUE
-blt_table_get_value(Table *tablePtr, Row *rowPtr, Column *colPtr)
-{
-    return GetValue(tablePtr, rowPtr, colPtr);
-}
-
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_set_value --
+ * CompareIndexValues --
  *
- *      Sets a scalar Tcl_Obj value in the table at the designated row and
- *      column.  "Write" and possibly "create" or "unset" traces may be fired
- *      *after* the value is set.  If valuePtr is NULL, this indicates to
- *      unset the old value.
+ *      Compares two values of the column.
  *
  * Results:
- *      A standard TCL result.  Returns TCL_OK if successful setting the value
- *      at the table location.  If an error occurs, TCL_ERROR is returned and
- *      an error message is left in the interpreter.
+ *      Returns -1, 0, or 1 if the first value is less than, equal to, or
+ *      greater than the second.
  *
- * -------------------------------------------------------------------------- 
+ *---------------------------------------------------------------------------
  */
-int
-blt_table_set_value(Table *tablePtr, Row *rowPtr, Column *colPtr, Value *newPtr)
+static int
+CompareIndexValues(Column *colPtr, Value *valuePtr1, Value *valuePtr2)
 {
-    Value *valuePtr;
-    int flags;
-
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    flags = TABLE_TRACE_WRITES;
-    if (IsEmptyValue(newPtr)) {         /* New value is empty. This is the
-                                         * same as unsetting the value. */
-        flags |= TABLE_TRACE_UNSETS;
-    } else if (IsEmptyValue(valuePtr)) {
-        flags |= TABLE_TRACE_CREATES;   /* Old value was empty. */
-    } 
-    if (newPtr != valuePtr) {
-        ResetValue(valuePtr);
-        *valuePtr = *newPtr;            /* Copy the value. */
-        if ((newPtr->string != NULL) &&
-            (newPtr->string != TABLE_VALUE_STORE)) {
-            valuePtr->string = Blt_AssertStrdup(newPtr->string);
+    switch (colPtr->type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+        {
+            double d1, d2;
+
+            d1 = valuePtr1->datum.d;
+            d2 = valuePtr2->datum.d;
+            if (d1 != d1) {                     /* NaN */
+                return (d2 != d2) ? 0 : 1;
+            } 
+            if (d2 != d2) {
+                return -1;
+            }
+            return (d1 < d2) ? -1 : (d1 > d2);
         }
-        CallTraces(tablePtr, rowPtr, colPtr, flags);
+    case TABLE_COLUMN_TYPE_INT64:
+        return (valuePtr1->datum.i64 < valuePtr2->datum.i64) ? -1 :
+            (valuePtr1->datum.i64 > valuePtr2->datum.i64);
+    case TABLE_COLUMN_TYPE_LONG:
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        return (valuePtr1->datum.l < valuePtr2->datum.l) ? -1 :
+            (valuePtr1->datum.l > valuePtr2->datum.l);
+    default:
+        return Blt_DictionaryCompare(GetValueString(valuePtr1),
+                                     GetValueString(valuePtr2));
     }
-    return TCL_OK;
 }
 
-
-/*
- *---------------------------------------------------------------------------
- *
- * blt_table_get_obj --
- *
- *      Gets a scalar Tcl_Obj value from the table at the designated row,
- *      column location.  "Read" traces may be fired *before* the value is
- *      retrieved.  If no value exists at that location, the return value
- *      is NULL.
- *
- * Results:
- *      A standard TCL result.  Returns TCL_OK if successful accessing the
- *      table location.  If an error occurs, TCL_ERROR is returned.
- *
- * -------------------------------------------------------------------------- 
- */
-Tcl_Obj *
-blt_table_get_obj(Table *tablePtr, Row *rowPtr, Column *colPtr)
+static INLINE Value *
+GetIndexValue(Row *rowPtr, Column *colPtr, Value *scratchPtr)
 {
-    Value *valuePtr;
-    Tcl_Obj *objPtr;
-
-    CallTraces(tablePtr, rowPtr, colPtr, TABLE_TRACE_READS);
-    if (IsEmpty(rowPtr, colPtr)) {
-        return NULL;
+    if (IsDenseColumn(colPtr)) {
+        GetDenseDatum(colPtr, rowPtr->offset, scratchPtr);
+        return scratchPtr;
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    objPtr = GetObjFromValue(colPtr->type, valuePtr);
-    return objPtr;
+    if (colPtr->dictPtr != NULL) {
+        scratchPtr->string = (char *)GetStoredString(rowPtr, colPtr, 
+                &scratchPtr->length);
+        return scratchPtr;
+    }
+    return colPtr->vector + rowPtr->offset;
 }
 
-/*
- *---------------------------------------------------------------------------
- *
- * blt_table_set_obj --
- *
- *      Sets a scalar Tcl_Obj value in the table at the designated row and
- *      column.  "Write" and possibly "create" or "unset" traces may be fired
- *      *after* the value is set.  If valueObjPtr is NULL, this indicates to
- *      unset the old value.
- *
- * Results:
- *      A standard TCL result.  Returns TCL_OK if successful setting the value
- *      at the table location.  If an error occurs, TCL_ERROR is returned and
- *      an error message is left in the interpreter.
- *
- * -------------------------------------------------------------------------- 
- */
-int
-blt_table_set_obj(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
-                  Column *colPtr, Tcl_Obj *objPtr)
+static int
+CompareIndexRows(Column *colPtr, Row *rowPtr1, Row *rowPtr2)
 {
-    unsigned int flags;
-    Value *valuePtr;
+    Value value1, value2;
+    int result;
 
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    flags = TABLE_TRACE_WRITES;
-    if (objPtr == NULL) {               /* New value is empty. This is the 
-                                         * same as unsetting the value. */
-        flags |= TABLE_TRACE_UNSETS;
-    } else if (IsEmptyValue(valuePtr)) {
-        flags |= TABLE_TRACE_CREATES;
-    } 
-    if (SetValueFromObj(interp, colPtr->type, objPtr, valuePtr) != TCL_OK) {
-        return TCL_ERROR;
+    result = CompareIndexValues(colPtr, 
+        GetIndexValue(rowPtr1, colPtr, &value1),
+        GetIndexValue(rowPtr2, colPtr, &value2));
+    if (result == 0) {
+        result = (rowPtr1 < rowPtr2) ? -1 : (rowPtr1 > rowPtr2);
     }
-    CallTraces(tablePtr, rowPtr, colPtr, flags);
-    return TCL_OK;
+    return result;
 }
 
-/*
- *---------------------------------------------------------------------------
- *
- * blt_table_unset_value --
- *
- *      Unsets a scalar Tcl_Obj value in the table at the designated row,
- *      column location.  It's okay is there is presently no value at the
- *      location. Unset traces may be fired *before* the value is unset.
- *
- * Results:
- *      A standard TCL result.  Returns TCL_OK if successful unsetting the
- *      value at the table location.  If an error occurs, TCL_ERROR is
- *      returned and an error message is left in the interpreter.
- *
- * -------------------------------------------------------------------------- 
- */
-int
-blt_table_unset_value(Table *tablePtr, Row *rowPtr, Column *colPtr)
+static void
+SortIndexRows(Column *colPtr, Row **rows, Row **scratch, long numRows)
 {
-    if (!IsEmpty(rowPtr, colPtr)) {
-        Value *valuePtr;
+    long half, i, j, k;
 
-        valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-        CallTraces(tablePtr, rowPtr, colPtr, TABLE_TRACE_UNSETS);
-        /* Indicate the keytables need to be regenerated. */
-        if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
-            tablePtr->flags |= TABLE_KEYS_DIRTY;
+    if (numRows < 2) {
+        return;
+    }
+    half = numRows / 2;
+    SortIndexRows(colPtr, rows, scratch, half);
+    SortIndexRows(colPtr, rows + half, scratch, numRows - half);
+    if (CompareIndexRows(colPtr, rows[half - 1], rows[half]) <= 0) {
+        return;                         /* Already in order. */
+    }
+    memcpy(scratch, rows, half * sizeof(Row *));
+    i = 0, j = half, k = 0;
+    while ((i < half) && (j < numRows)) {
+        if (CompareIndexRows(colPtr, rows[j], scratch[i]) < 0) {
+            rows[k++] = rows[j++];
+        } else {
+            rows[k++] = scratch[i++];
         }
-        ResetValue(valuePtr);
     }
-    return TCL_OK;
+    while (i < half) {
+        rows[k++] = scratch[i++];
+    }
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_create --
- *
- *      Creates a table object by the designated name.  It's an error if a
- *      table object already exists by that name.
- *
- * Results:
- *      A standard TCL result.  If successful, a new table object is created
- *      and TCL_OK is returned.  If an object already exists or the table
- *      object can't be allocated, then TCL_ERROR is returned and an error
- *      message is left in the interpreter.
+ * BuildIndex --
  *
- * Side Effects:
- *      A new table object is created.
+ *      Regenerates the index from the rows of the column.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_create(
-    Tcl_Interp *interp,                 /* Interpreter to report errors back
-                                         * to. */
-    const char *name,                   /* Name of tuple in namespace.  Object
-                                         * must not already exist. */
-    Table **tablePtrPtr)                /* (out) Client token of newly created
-                                         * table object.  Releasing the token
-                                         * will free the tuple.  If NULL, no
-                                         * token is generated. */
+static void
+BuildIndex(TableObject *corePtr, Column *colPtr)
 {
-    InterpData *dataPtr;
-    TableObject *corePtr;
-    Blt_ObjectName objName;
-    Table *newClientPtr;
-    Tcl_DString ds;
-    const char *qualName;
-    char string[200];
+    ColumnIndex *indexPtr;
+    Row *rowPtr, **scratch;
+    long count;
 
-    dataPtr = GetInterpData(interp);
-    if (name != NULL) {
-        /* Check if a client by this name already exist in the current
-         * namespace. */
-        if (GetTable(dataPtr, name, NS_SEARCH_CURRENT) != NULL) {
-            Tcl_AppendResult(interp, "a table object \"", name,
-                "\" already exists", (char *)NULL);
-            return TCL_ERROR;
-        }
-    } else {
-        /* Generate a unique name in the current namespace. */
-        do  {
-            Blt_FmtString(string, 200, "datatable%d", dataPtr->nextId++);
-        } while (GetTable(dataPtr, name, NS_SEARCH_CURRENT) != NULL);
-        name = string;
-    } 
-    /* 
-     * Tear apart and put back together the namespace-qualified name of the
-     * object.  This is to ensure that naming is consistent.
-     */ 
-    if (!Blt_ParseObjectName(interp, name, &objName, 0)) {
-        return TCL_ERROR;
-    }
-    corePtr = NewTableObject();
-    if (corePtr == NULL) {
-        Tcl_AppendResult(interp, "can't allocate table object.", (char *)NULL);
-        Tcl_DStringFree(&ds);
-        return TCL_ERROR;
+    indexPtr = colPtr->indexPtr;
+    if (indexPtr->numAllocated < corePtr->rows.numUsed) {
+        indexPtr->numAllocated = corePtr->rows.numUsed;
+        indexPtr->rows = Blt_AssertRealloc(indexPtr->rows, 
+                indexPtr->numAllocated * sizeof(Row *));
     }
-    qualName = Blt_MakeQualifiedName(&objName, &ds);
-    newClientPtr = NewTable(dataPtr, corePtr, qualName);
-    Tcl_DStringFree(&ds);
-    if (newClientPtr == NULL) {
-        Tcl_AppendResult(interp, "can't allocate table token", (char *)NULL);
-        return TCL_ERROR;
+    count = 0;
+    for (rowPtr = corePtr->rows.headPtr; rowPtr != NULL; 
+         rowPtr = rowPtr->nextPtr) {
+        if (!IsEmpty(rowPtr, colPtr)) {
+            indexPtr->rows[count] = rowPtr;
+            count++;
+        }
     }
-    
-    if (tablePtrPtr != NULL) {
-        *tablePtrPtr = newClientPtr;
+    indexPtr->numRows = count;
+    if (count > 1) {
+        scratch = Blt_AssertMalloc((count / 2) * sizeof(Row *));
+        SortIndexRows(colPtr, indexPtr->rows, scratch, count);
+        Blt_Free(scratch);
     }
-    return TCL_OK;
+    indexPtr->flags &= ~INDEX_DIRTY;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_open --
+ * SearchIndex --
  *
- *      Allocates a token for the table object designated by name.  It's an
- *      error if no table object exists by that name.  The token returned is
- *      passed to various routines to manipulate the object.  Traces and event
- *      notifications are also made through the token.
+ *      Searches for the position of the row in the index.  The row's
+ *      current value is used.
  *
  * Results:
- *      A new token is returned representing the table object.  
- *
- * Side Effects:
- *      If this is the remaining client, then the table object itself is
- *      freed.
+ *      Returns the position of the first row in the index that follows
+ *      or matches the row.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_open(
-    Tcl_Interp *interp,                 /* Interpreter to report errors back
-                                         * to. */
-    const char *name,                   /* Name of table object in
-                                         * namespace. */
-    Table **tablePtrPtr)
+static long
+SearchIndex(Column *colPtr, Row *rowPtr)
 {
-    Table *tablePtr, *newClientPtr;
-    InterpData *dataPtr;
+    ColumnIndex *indexPtr;
+    long low, high;
 
-    dataPtr = GetInterpData(interp);
-    tablePtr = GetTable(dataPtr, name, NS_SEARCH_BOTH);
-    if ((tablePtr == NULL) || (tablePtr->corePtr == NULL)) {
-        Tcl_AppendResult(interp, "can't find a table object \"", name, "\"", 
-                (char *)NULL);
-        return TCL_ERROR;
-    }
-    newClientPtr = NewTable(dataPtr, tablePtr->corePtr, name);
-    if (newClientPtr == NULL) {
-        Tcl_AppendResult(interp, "can't allocate token for table \"", name, 
-                "\"", (char *)NULL);
-        return TCL_ERROR;
+    indexPtr = colPtr->indexPtr;
+    low = 0, high = indexPtr->numRows;
+    while (low < high) {
+        long mid;
+
+        mid = (low + high) / 2;
+        if (CompareIndexRows(colPtr, indexPtr->rows[mid], rowPtr) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
     }
-    /* By default, share tags with an existing table. Clients can can
-     * blt_table_new_tags to get a new tags table. */
-    ShareTags(tablePtr, newClientPtr);
-    *tablePtrPtr = newClientPtr;
-    return TCL_OK;
+    return low;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_close --
- *
- *      Releases the tuple token, indicating this the client is no longer
- *      using the object. The client is removed from the tuple object's client
- *      list.  If this is the last client, then the object itself is destroyed
- *      and memory is freed.
- *
- * Results:
- *      None.
+ * RemoveIndexRow --
  *
- * Side Effects:
- *      If this is the remaining client, then the table object itself
- *      is freed.
+ *      Called before a value of an indexed column is changed or unset.
+ *      Removes the row from the index.
  *
  *---------------------------------------------------------------------------
  */
-void
-blt_table_close(Table *tablePtr)
+static void
+RemoveIndexRow(Column *colPtr, Row *rowPtr)
 {
-    if (tablePtr->magic != TABLE_MAGIC) {
-        Blt_Warn("invalid table object token %p\n", tablePtr);
+    ColumnIndex *indexPtr;
+    long pos;
+
+    indexPtr = colPtr->indexPtr;
+    if ((indexPtr->flags & INDEX_DIRTY) || (IsEmpty(rowPtr, colPtr))) {
         return;
     }
-    if (tablePtr->link2 != NULL) {
-        Blt_Chain chain;
-
-        /* Remove the client from the list of clients using the table name.
-         * This is different from the table core. */
-        chain = Blt_GetHashValue(tablePtr->hPtr);
-        Blt_Chain_DeleteLink(chain, tablePtr->link2);
-        if (Blt_Chain_GetLength(chain) == 0) {
-            /* If no more clients are using this name, then remove it from the
-             * interpreter-specific hash table. */      
-            Blt_DeleteHashEntry(tablePtr->clientTablePtr, tablePtr->hPtr);
-        }
+    pos = SearchIndex(colPtr, rowPtr);
+    if ((pos >= indexPtr->numRows) || (indexPtr->rows[pos] != rowPtr)) {
+        indexPtr->flags |= INDEX_DIRTY; /* Should never happen. */
+        return;
     }
-    DestroyClient(tablePtr);
+    indexPtr->numRows--;
+    memmove(indexPtr->rows + pos, indexPtr->rows + pos + 1,
+            (indexPtr->numRows - pos) * sizeof(Row *));
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_exists --
- *
- *      Indicates if a table object by the given name exists in either the
- *      current or global namespace.
+ * InsertIndexRow --
  *
- * Results:
- *      Returns 1 if a table object exists and 0 otherwise.
+ *      Called after a value of an indexed column has been set.  Adds the
+ *      row back into the index at the position of its new value.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_exists(Tcl_Interp *interp, const char *name)
+static void
+InsertIndexRow(Column *colPtr, Row *rowPtr)
 {
-    InterpData *dataPtr;
+    ColumnIndex *indexPtr;
+    long pos;
 
-    dataPtr = GetInterpData(interp);
-    return (GetTable(dataPtr, name, NS_SEARCH_BOTH) != NULL);
+    indexPtr = colPtr->indexPtr;
+    if ((indexPtr->flags & INDEX_DIRTY) || (IsEmpty(rowPtr, colPtr))) {
+        return;
+    }
+    if (indexPtr->numRows >= indexPtr->numAllocated) {
+        indexPtr->numAllocated = (indexPtr->numAllocated == 0) ? 
+            TABLE_ALLOC_INIT_SIZE : indexPtr->numAllocated * 2;
+        indexPtr->rows = Blt_AssertRealloc(indexPtr->rows, 
+                indexPtr->numAllocated * sizeof(Row *));
+    }
+    pos = indexPtr->numRows;
+    if ((pos > 0) && 
+        (CompareIndexRows(colPtr, indexPtr->rows[pos - 1], rowPtr) > 0)) {
+        pos = SearchIndex(colPtr, rowPtr);
+        memmove(indexPtr->rows + pos + 1, indexPtr->rows + pos,
+                (indexPtr->numRows - pos) * sizeof(Row *));
+    }
+    indexPtr->rows[pos] = rowPtr;
+    indexPtr->numRows++;
 }
 
-static Notifier *
-CreateNotifier(Tcl_Interp *interp, Blt_Chain chain, unsigned int mask,
-               BLT_TABLE_NOTIFY_EVENT_PROC *proc, 
-               BLT_TABLE_NOTIFIER_DELETE_PROC *deleteProc, 
-               ClientData clientData)
+static void
+InvalidateIndex(Column *colPtr)
 {
-    Notifier *notifierPtr;
-
-    notifierPtr = Blt_AssertMalloc(sizeof (Notifier));
-    notifierPtr->proc = proc;
-    notifierPtr->deleteProc = deleteProc;
-    notifierPtr->chain = chain;
-    notifierPtr->clientData = clientData;
-    notifierPtr->column = NULL;         /* All columns. */
-    notifierPtr->row = NULL;            /* All rows. */
-    notifierPtr->tag = NULL;            /* No tag. */
-    notifierPtr->flags = mask | TABLE_NOTIFY_COLUMN | TABLE_NOTIFY_ROW;
-    notifierPtr->interp = interp;
-    notifierPtr->link = Blt_Chain_Append(chain, notifierPtr);
-    return notifierPtr;
+    colPtr->indexPtr->flags |= INDEX_DIRTY;
 }
 
-static Notifier *
-CreateNotifierForRows(Tcl_Interp *interp, Blt_Chain chain, unsigned int mask,
-                      Row *rowPtr, const char *tag, 
-                      BLT_TABLE_NOTIFY_EVENT_PROC *proc,
-                      BLT_TABLE_NOTIFIER_DELETE_PROC *deleteProc, 
-                      ClientData clientData)
+static void
+FreeIndex(Column *colPtr)
 {
-    Notifier *notifierPtr;
+    ColumnIndex *indexPtr;
 
-    notifierPtr = Blt_AssertMalloc(sizeof (Notifier));
-    notifierPtr->proc = proc;
-    notifierPtr->deleteProc = deleteProc;
-    notifierPtr->chain = chain;
-    notifierPtr->clientData = clientData;
-    notifierPtr->row = rowPtr;
-    notifierPtr->column = NULL;
-    notifierPtr->tag = (tag != NULL) ? Blt_AssertStrdup(tag) : NULL;
-    notifierPtr->flags = mask | TABLE_NOTIFY_ROW;
-    notifierPtr->interp = interp;
-    notifierPtr->link = Blt_Chain_Append(chain, notifierPtr);
-    return notifierPtr;
+    indexPtr = colPtr->indexPtr;
+    if (indexPtr->rows != NULL) {
+        Blt_Free(indexPtr->rows);
+    }
+    Blt_Free(indexPtr);
+    colPtr->indexPtr = NULL;
 }
 
-static Notifier *
-CreateNotifierForColumns(Tcl_Interp *interp, Blt_Chain chain, unsigned int mask,
-        Column *colPtr, const char *tag, BLT_TABLE_NOTIFY_EVENT_PROC *proc,
-        BLT_TABLE_NOTIFIER_DELETE_PROC *deleteProc, ClientData clientData)
+static ColumnIndex *
+GetIndex(TableObject *corePtr, Column *colPtr)
 {
-    Notifier *notifierPtr;
-
-    notifierPtr = Blt_AssertMalloc(sizeof (Notifier));
-    notifierPtr->proc = proc;
-    notifierPtr->deleteProc = deleteProc;
-    notifierPtr->chain = chain;
-    notifierPtr->clientData = clientData;
-    notifierPtr->column = colPtr;
-    notifierPtr->row = NULL;
-    notifierPtr->tag = (tag != NULL) ? Blt_AssertStrdup(tag) : NULL;
-    notifierPtr->flags = mask | TABLE_NOTIFY_COLUMN;
-    notifierPtr->interp = interp;
-    notifierPtr->link = Blt_Chain_Append(chain, notifierPtr);
-    return notifierPtr;
+    if (colPtr->indexPtr->flags & INDEX_DIRTY) {
+        BuildIndex(corePtr, colPtr);
+    }
+    return colPtr->indexPtr;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_create_notifier --
+ * blt_table_create_index --
  *
- *      Creates an event handler using the following three pieces of
- *      information: 
- *              1. C function pointer, 
- *              2. one-word of data passed on each call, and 
- *              3. event mask indicating which events are of interest.  
- *      If an event already exists matching all of the above criteria,
- *      it is repositioned on the end of the event handler list.  This
- *      means that it will be the last to fire.
+ *      Creates an ordered index for the column.  If unique is set, the
+ *      values of the column must all be different, and setting a cell to
+ *      a value that another row already has is an error.
  *
  * Results:
- *      Returns a pointer to the event handler.
- *
- * Side Effects:
- *      Memory for the event handler is possibly allocated.
+ *      Returns a standard TCL result.  It's an error if unique is set and
+ *      two rows have the same value.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_NOTIFIER
-blt_table_create_notifier(Tcl_Interp *interp, Table *tablePtr, 
-                          unsigned int mask, BLT_TABLE_NOTIFY_EVENT_PROC *proc,
-                          BLT_TABLE_NOTIFIER_DELETE_PROC *deletedProc,
-                          ClientData clientData)
+int
+blt_table_create_index(Tcl_Interp *interp, Table *tablePtr, Column *colPtr,
+                       int unique)
 {
-    return CreateNotifier(interp, tablePtr->columnNotifiers, mask,  proc, 
-                          deletedProc, clientData);
-}
+    ColumnIndex *indexPtr;
 
-/*
- *---------------------------------------------------------------------------
- *
- * blt_table_create_column_notifier --
- *
- *      Creates an event handler using the following three pieces of
- *      information: 
- *              1. C function pointer, 
- *              2. one-word of data passed on each call, and 
- *              3. event mask indicating which events are of interest.  
- *      If an event already exists matching all of the above criteria,
- *      it is repositioned on the end of the event handler list.  This
- *      means that it will be the last to fire.
- *
- * Results:
- *      Returns a pointer to the event handler.
- *
- * Side Effects:
- *      Memory for the event handler is possibly allocated.
- *
- *---------------------------------------------------------------------------
- */
-BLT_TABLE_NOTIFIER
-blt_table_create_column_notifier(Tcl_Interp *interp, Table *tablePtr,
-                               BLT_TABLE_COLUMN col, unsigned int mask,
-                               BLT_TABLE_NOTIFY_EVENT_PROC *proc,
-                               BLT_TABLE_NOTIFIER_DELETE_PROC *deletedProc,
-                               ClientData clientData)
-{
-    return CreateNotifierForColumns(interp, tablePtr->columnNotifiers, mask, 
-                col, NULL, proc, deletedProc, clientData);
+    if (colPtr->type == TABLE_COLUMN_TYPE_BLOB) {
+        if (interp != NULL) {
+            Tcl_AppendResult(interp, "can't index blob column \"", 
+                colPtr->label, "\"", (char *)NULL);
+        }
+        return TCL_ERROR;
+    }
+    if (colPtr->indexPtr != NULL) {
+        FreeIndex(colPtr);
+    }
+    indexPtr = Blt_AssertCalloc(1, sizeof(ColumnIndex));
+    colPtr->indexPtr = indexPtr;
+    BuildIndex(tablePtr->corePtr, colPtr);
+    if (unique) {
+        long i;
+
+        for (i = 1; i < indexPtr->numRows; i++) {
+            Value value1, value2;
+
+            if (CompareIndexValues(colPtr, 
+                GetIndexValue(indexPtr->rows[i - 1], colPtr, &value1),
+                GetIndexValue(indexPtr->rows[i], colPtr, &value2)) == 0) {
+                if (interp != NULL) {
+                    long index1, index2;
+
+                    index1 = blt_table_row_index(tablePtr, 
+                                                 indexPtr->rows[i - 1]);
+                    index2 = blt_table_row_index(tablePtr, indexPtr->rows[i]);
+                    Tcl_AppendResult(interp, "column \"", colPtr->label, 
+                        "\" has duplicate values in rows ", 
+                        Blt_Ltoa(MIN(index1, index2)), (char *)NULL);
+                    Tcl_AppendResult(interp, " and ", 
+                        Blt_Ltoa(MAX(index1, index2)), (char *)NULL);
+                }
+                FreeIndex(colPtr);
+                return TCL_ERROR;
+            }
+        }
+        indexPtr->flags |= INDEX_UNIQUE;
+    }
+    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_create_column_tag_notifier --
- *
- *      Creates an event handler using the following three pieces of
- *      information: 
- *              1. C function pointer, 
- *              2. one-word of data passed on each call, and 
- *              3. event mask indicating which events are of interest.  
- *      If an event already exists matching all of the above criteria,
- *      it is repositioned on the end of the event handler list.  This
- *      means that it will be the last to fire.
+ * blt_table_delete_index --
  *
- * Results:
- *      Returns a pointer to the event handler.
- *
- * Side Effects:
- *      Memory for the event handler is possibly allocated.
+ *      Removes the ordered index of the column, if there is one.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_NOTIFIER
-blt_table_create_column_tag_notifier(Tcl_Interp *interp, Table *tablePtr,
-                                  const char *tag, unsigned int mask,
-                                  BLT_TABLE_NOTIFY_EVENT_PROC *proc,
-                                  BLT_TABLE_NOTIFIER_DELETE_PROC *deletedProc,
-                                  ClientData clientData)
+void
+blt_table_delete_index(Table *tablePtr, Column *colPtr)
 {
-    return CreateNotifierForColumns(interp, tablePtr->columnNotifiers, mask, 
-        NULL, tag, proc, deletedProc, clientData);
+    if (colPtr->indexPtr != NULL) {
+        FreeIndex(colPtr);
+    }
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_create_row_notifier --
+ * blt_table_index_rows --
  *
- *      Creates an event handler using the following three pieces of
- *      information: 
- *              1. C function pointer, 
- *              2. one-word of data passed on each call, and 
- *              3. event mask indicating which events are of interest.  
- *      If an event already exists matching all of the above criteria,
- *      it is repositioned on the end of the event handler list.  This
- *      means that it will be the last to fire.
+ *      Returns the rows of the column's index, ordered by value.  The
+ *      array belongs to the index and is only valid until the column is
+ *      changed.
  *
  * Results:
- *      Returns a pointer to the event handler.
- *
- * Side Effects:
- *      Memory for the event handler is possibly allocated.
+ *      Returns the number of rows in the index, or -1 if the column isn't
+ *      indexed.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_NOTIFIER
-blt_table_create_row_notifier(Tcl_Interp *interp, Table *tablePtr, 
-                            BLT_TABLE_ROW row, unsigned int mask,
-                            BLT_TABLE_NOTIFY_EVENT_PROC *proc,
-                            BLT_TABLE_NOTIFIER_DELETE_PROC *deletedProc,
-                            ClientData clientData)
+long
+blt_table_index_rows(Table *tablePtr, Column *colPtr, Row ***rowsPtr)
 {
-    return CreateNotifierForRows(interp, tablePtr->rowNotifiers, mask, row, 
-        NULL, proc, deletedProc, clientData);
+    ColumnIndex *indexPtr;
+
+    if (colPtr->indexPtr == NULL) {
+        return -1;
+    }
+    indexPtr = GetIndex(tablePtr->corePtr, colPtr);
+    *rowsPtr = indexPtr->rows;
+    return indexPtr->numRows;
 }
 
-/*
- *---------------------------------------------------------------------------
- *
- * blt_table_create_column_tag_notifier --
- *
- *      Creates an event handler using the following three pieces of
- *      information: 
- *              1. C function pointer, 
- *              2. one-word of data passed on each call, and 
- *              3. event mask indicating which events are of interest.  
- *      If an event already exists matching all of the above criteria,
- *      it is repositioned on the end of the event handler list.  This
- *      means that it will be the last to fire.
- *
- * Results:
- *      Returns a pointer to the event handler.
- *
- * Side Effects:
- *      Memory for the event handler is possibly allocated.
- *
- *---------------------------------------------------------------------------
- */
-BLT_TABLE_NOTIFIER
-blt_table_create_row_tag_notifier(Tcl_Interp *interp, Table *tablePtr,
-                               const  char *tag, unsigned int mask,
-                               BLT_TABLE_NOTIFY_EVENT_PROC *proc,
-                               BLT_TABLE_NOTIFIER_DELETE_PROC *deletedProc,
-                               ClientData clientData)
+/* Returns the position of the first indexed row whose value is greater
+ * than (or if inclusive, greater than or equal to) the given value. */
+static long
+SearchIndexValue(ColumnIndex *indexPtr, Column *colPtr, Value *valuePtr,
+                 int inclusive)
 {
-    return CreateNotifierForRows(interp, tablePtr->rowNotifiers, mask, NULL, 
-        tag, proc, deletedProc, clientData);
+    long low, high;
+
+    low = 0, high = indexPtr->numRows;
+    while (low < high) {
+        Value value;
+        long mid;
+        int result;
+
+        mid = (low + high) / 2;
+        result = CompareIndexValues(colPtr, 
+                GetIndexValue(indexPtr->rows[mid], colPtr, &value), valuePtr);
+        if ((result < 0) || ((result == 0) && (!inclusive))) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_delete_notifier --
+ * CheckUniqueValue --
  *
- *      Removes the event handler designated by following three pieces
- *      of information: 
- *         1. C function pointer, 
- *         2. one-word of data passed on each call, and 
- *         3. event mask indicating which events are of interest.
+ *      Called before a value is stored in a column with a unique index.
+ *      Checks that no other row in the column already has the value.
  *
  * Results:
- *      Nothing.
- *
- * Side Effects:
- *      Memory for the event handler is freed.
+ *      Returns a standard TCL result.  If another row has the value,
+ *      TCL_ERROR is returned and an error message is left in interp, if
+ *      it isn't NULL.
  *
  *---------------------------------------------------------------------------
  */
-void
-blt_table_delete_notifier(Table *tablePtr, Notifier *notifierPtr)
+static int
+CheckUniqueValue(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr, 
+                 Column *colPtr, Value *valuePtr)
 {
-    /* Check if notifier is already being deleted. */
-    if ((notifierPtr->flags & TABLE_NOTIFY_DESTROYED) == 0) {
-        if (notifierPtr->deleteProc != NULL) {
-            (*notifierPtr->deleteProc)(notifierPtr->clientData);
+    ColumnIndex *indexPtr;
+    long pos;
+
+    indexPtr = GetIndex(tablePtr->corePtr, colPtr);
+    for (pos = SearchIndexValue(indexPtr, colPtr, valuePtr, TRUE);
+         pos < indexPtr->numRows; pos++) {
+        Value value;
+        Row *dupRowPtr;
+
+        dupRowPtr = indexPtr->rows[pos];
+        if (CompareIndexValues(colPtr, 
+                GetIndexValue(dupRowPtr, colPtr, &value), valuePtr) != 0) {
+            break;
         }
-        if (notifierPtr->flags & TABLE_NOTIFY_PENDING) {
-            Tcl_CancelIdleCall(NotifyIdleProc, notifierPtr);
+        if (dupRowPtr != rowPtr) {
+            if (interp != NULL) {
+                Tcl_AppendResult(interp, "column \"", colPtr->label, 
+                        "\" is unique: row ", 
+                        Blt_Ltoa(blt_table_row_index(tablePtr, dupRowPtr)), 
+                        " already has the value", (char *)NULL);
+            }
+            return TCL_ERROR;
         }
-        notifierPtr->flags = TABLE_NOTIFY_DESTROYED;
-        Tcl_EventuallyFree(notifierPtr, (Tcl_FreeProc *)FreeNotifier);
     }
+    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_get_row_by_label --
+ * blt_table_index_range --
  *
- *      Returns the offset of the row given its label.  If the row label is
- *      invalid, then -1 is returned.
+ *      Finds the rows whose values in the column are between the low and
+ *      high values, inclusive.  A NULL bound is open.  The column's index
+ *      is used if it has one; otherwise the rows are scanned.
  *
  * Results:
- *      Returns the offset of the row or -1 if not found.
+ *      Returns a standard TCL result.  The rows, ordered by value, are
+ *      returned in a malloc-ed array that the caller must free.  It's an
+ *      error if a bound can't be converted to the column's type.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_ROW
-blt_table_get_row_by_label(Table *tablePtr, const char *label)
+int
+blt_table_index_range(Tcl_Interp *interp, Table *tablePtr, Column *colPtr,
+                      Tcl_Obj *loObjPtr, Tcl_Obj *hiObjPtr, Row ***rowsPtr,
+                      long *numRowsPtr)
 {
-    return FindRowLabel(&tablePtr->corePtr->rows, label);
-}
+    Value lo, hi;
+    Row **rows;
+    long first, last, count;
+    int result;
+
+    memset(&lo, 0, sizeof(Value));
+    memset(&hi, 0, sizeof(Value));
+    result = TCL_ERROR;
+    if ((loObjPtr != NULL) && 
+        (SetValueFromObj(interp, colPtr, colPtr->type, loObjPtr, &lo) 
+         != TCL_OK)) {
+        goto error;
+    }
+    if ((hiObjPtr != NULL) && 
+        (SetValueFromObj(interp, colPtr, colPtr->type, hiObjPtr, &hi) 
+         != TCL_OK)) {
+        goto error;
+    }
+    if (colPtr->indexPtr != NULL) {
+        ColumnIndex *indexPtr;
+
+        indexPtr = GetIndex(tablePtr->corePtr, colPtr);
+        first = (loObjPtr == NULL) ? 0 : 
+            SearchIndexValue(indexPtr, colPtr, &lo, TRUE);
+        last = (hiObjPtr == NULL) ? indexPtr->numRows :
+            SearchIndexValue(indexPtr, colPtr, &hi, FALSE);
+        count = (last > first) ? last - first : 0;
+        rows = Blt_AssertMalloc((count + 1) * sizeof(Row *));
+        memcpy(rows, indexPtr->rows + first, count * sizeof(Row *));
+    } else {
+        Row *rowPtr;
+
+        rows = Blt_AssertMalloc((tablePtr->corePtr->rows.numUsed + 1) * 
+                                sizeof(Row *));
+        count = 0;
+        for (rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL;
+             rowPtr = rowPtr->nextPtr) {
+            Value value, *valuePtr;
+
+            if (IsEmpty(rowPtr, colPtr)) {
+                continue;
+            }
+            valuePtr = GetIndexValue(rowPtr, colPtr, &value);
+            if ((loObjPtr != NULL) && 
+                (CompareIndexValues(colPtr, valuePtr, &lo) < 0)) {
+                continue;
+            }
+            if ((hiObjPtr != NULL) && 
+                (CompareIndexValues(colPtr, valuePtr, &hi) > 0)) {
+                continue;
+            }
+            rows[count] = rowPtr;
+            count++;
+        }
+        if (count > 1) {
+            Row **scratch;
 
+            scratch = Blt_AssertMalloc((count / 2) * sizeof(Row *));
+            SortIndexRows(colPtr, rows, scratch, count);
+            Blt_Free(scratch);
+        }
+    }
+    *rowsPtr = rows;
+    *numRowsPtr = count;
+    result = TCL_OK;
+ error:
+    ResetValue(&lo);
+    ResetValue(&hi);
+    return result;
+}
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_get_column_by_label --
+ * Aggregation --
  *
- *      Returns the offset of the column given its label.  If the column label
- *      is invalid, then -1 is returned.
+ *      blt_table_aggregate groups rows by the values of one or more
+ *      columns and computes the count, sum, mean, minimum, or maximum of
+ *      other columns over each group.  Groups are hashed like primary keys
+ *      (see MakeKeyTables): each group column has a table of its distinct
+ *      values, and a group is keyed by the combination of the value
+ *      entries.  Numeric columns are hashed and summed by their native
+ *      values, so no strings are generated.  Empty cells form their own
+ *      group.
  *
- * Results:
- *      Returns the offset of the column or -1 if not found.
+ *      With more than one thread, the rows are split into consecutive
+ *      ranges and each thread aggregates its range separately.  The
+ *      partial groups are then merged in range order, so that the groups
+ *      are always ordered by their first row.
  *
  *---------------------------------------------------------------------------
  */
-BLT_TABLE_COLUMN
-blt_table_get_column_by_label(Table *tablePtr, const char *label)
+#define AGGREGATE_MAX_THREADS   16
+
+typedef struct {
+    long count;                         /* # of non-empty values. */
+    Value sum, min, max;                /* Datums are int64_t for integer
+                                         * columns, double otherwise. */
+} Accumulator;
+
+typedef struct {
+    Row *rowPtr;                        /* First row of the group.  Its
+                                         * values are the group's. */
+    long numRows;                       /* # of rows in the group. */
+    Accumulator *accums;                /* One for each aggregate. */
+} AggregateGroup;
+
+typedef struct {
+    long numColumns;                    /* # of group columns. */
+    Column **columns;                   /* Columns to group by. */
+    long numAggregates;
+    BLT_TABLE_AGGREGATE *aggregates;
+    int *isInteger;                     /* Indicates if each aggregate
+                                         * column has integer values. */
+    Row **rows;                         /* Range of rows to aggregate. */
+    long numRows;
+    Blt_HashTable *valueTables;         /* Distinct values of each group
+                                         * column. */
+    Blt_HashTable groupTable;           /* Groups keyed by the combination
+                                         * of value entries. */
+    Blt_HashEntry **key;                /* Scratch master key. */
+    Blt_Chain groups;                   /* Groups in the order that they
+                                         * were found. */
+    Row *badRowPtr;                     /* If non-NULL, row and column */
+    Column *badColPtr;                  /* of a non-numeric value. */
+} Aggregator;
+
+static int
+IsIntegerColumn(Column *colPtr)
 {
-    return FindColumnLabel(&tablePtr->corePtr->columns, label);
+    switch (colPtr->type) {
+    case TABLE_COLUMN_TYPE_LONG:
+    case TABLE_COLUMN_TYPE_INT64:
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static void
+InitAggregator(Aggregator *aggPtr, long numColumns, Column **columns,
+               long numAggregates, BLT_TABLE_AGGREGATE *aggregates,
+               int *isInteger, Row **rows, long numRows)
+{
+    long i;
+    size_t keySize;
+
+    memset(aggPtr, 0, sizeof(Aggregator));
+    aggPtr->numColumns = numColumns;
+    aggPtr->columns = columns;
+    aggPtr->numAggregates = numAggregates;
+    aggPtr->aggregates = aggregates;
+    aggPtr->isInteger = isInteger;
+    aggPtr->rows = rows;
+    aggPtr->numRows = numRows;
+    aggPtr->valueTables = Blt_AssertMalloc((numColumns + 1) *
+                                           sizeof(Blt_HashTable));
+    for (i = 0; i < numColumns; i++) {
+        size_t size;
+
+        switch (columns[i]->type) {
+        case TABLE_COLUMN_TYPE_DOUBLE:
+        case TABLE_COLUMN_TYPE_TIME:
+            size = sizeof(double) / sizeof(int);
+            break;
+        case TABLE_COLUMN_TYPE_INT64:
+            size = sizeof(int64_t) / sizeof(int);
+            break;
+        case TABLE_COLUMN_TYPE_BOOLEAN:
+        case TABLE_COLUMN_TYPE_LONG:
+            size = BLT_ONE_WORD_KEYS;
+            break;
+        default:
+        case TABLE_COLUMN_TYPE_STRING:
+            size = BLT_STRING_KEYS;
+            break;
+        }
+        Blt_InitHashTable(aggPtr->valueTables + i, size);
+    }
+    /* Without group columns, all the rows are one group.  The master key
+     * is then a single NULL entry. */
+    keySize = sizeof(Blt_HashEntry *) * MAX(numColumns, 1);
+    aggPtr->key = Blt_AssertCalloc(1, keySize);
+    Blt_InitHashTable(&aggPtr->groupTable, keySize / sizeof(int));
+    aggPtr->groups = Blt_Chain_Create();
+}
+
+static void
+FreeAggregator(Aggregator *aggPtr)
+{
+    Blt_ChainLink link;
+    long i;
+
+    for (link = Blt_Chain_FirstLink(aggPtr->groups); link != NULL;
+         link = Blt_Chain_NextLink(link)) {
+        AggregateGroup *groupPtr;
+
+        groupPtr = Blt_Chain_GetValue(link);
+        Blt_Free(groupPtr);
+    }
+    Blt_Chain_Destroy(aggPtr->groups);
+    for (i = 0; i < aggPtr->numColumns; i++) {
+        Blt_DeleteHashTable(aggPtr->valueTables + i);
+    }
+    Blt_Free(aggPtr->valueTables);
+    Blt_DeleteHashTable(&aggPtr->groupTable);
+    Blt_Free(aggPtr->key);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_column_get_label_table --
- *
- *      Returns the offset of the column given its label.  If the column label
- *      is invalid, then -1 is returned.
+ * GetGroupValueEntry --
  *
- * Results:
- *      Returns the offset of the column or -1 if not found.
+ *      Returns the entry for the row's value in the value table of the
+ *      group column, creating it if needed.  Empty cells have no entry.
+ *      Only native values and stored strings are read, so it's safe to
+ *      call from several threads at once.
  *
  *---------------------------------------------------------------------------
  */
-Blt_HashTable *
-blt_table_column_get_label_table(Table *tablePtr, const char *label)
+static Blt_HashEntry *
+GetGroupValueEntry(Aggregator *aggPtr, long index, Row *rowPtr)
 {
-    return GetColumnLabelTable(&tablePtr->corePtr->columns, label);
+    Column *colPtr;
+    Value value;
+    const void *key;
+    unsigned int length;
+    int isNew;
+
+    colPtr = aggPtr->columns[index];
+    if (IsEmpty(rowPtr, colPtr)) {
+        return NULL;
+    }
+    switch (colPtr->type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+        GetCellDatum(rowPtr, colPtr, &value);
+        if (value.datum.d == 0.0) {
+            value.datum.d = 0.0;        /* Don't separate -0.0 and 0.0. */
+        }
+        key = &value.datum.d;
+        break;
+    case TABLE_COLUMN_TYPE_INT64:
+        GetCellDatum(rowPtr, colPtr, &value);
+        key = &value.datum.i64;
+        break;
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+    case TABLE_COLUMN_TYPE_LONG:
+        GetCellDatum(rowPtr, colPtr, &value);
+        key = (const void *)(intptr_t)value.datum.l;
+        break;
+    case TABLE_COLUMN_TYPE_STRING:
+    default:
+        key = GetStoredString(rowPtr, colPtr, &length);
+        break;
+    }
+    return Blt_CreateHashEntry(aggPtr->valueTables + index, key, &isNew);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_row_get_label_table --
- *
- *      Returns the offset of the column given its label.  If the column label
- *      is invalid, then -1 is returned.
+ * GetAggregateGroup --
  *
- * Results:
- *      Returns the offset of the column or -1 if not found.
+ *      Returns the group of the row, creating a new group (with the row
+ *      as its first row) if needed.
  *
  *---------------------------------------------------------------------------
  */
-Blt_HashTable *
-blt_table_row_get_label_table(Table *tablePtr, const char *label)
+static AggregateGroup *
+GetAggregateGroup(Aggregator *aggPtr, Row *rowPtr)
 {
-    return GetRowLabelTable(&tablePtr->corePtr->rows, label);
+    AggregateGroup *groupPtr;
+    Blt_HashEntry *hPtr;
+    long i;
+    int isNew;
+
+    for (i = 0; i < aggPtr->numColumns; i++) {
+        aggPtr->key[i] = GetGroupValueEntry(aggPtr, i, rowPtr);
+    }
+    hPtr = Blt_CreateHashEntry(&aggPtr->groupTable, aggPtr->key, &isNew);
+    if (!isNew) {
+        return Blt_GetHashValue(hPtr);
+    }
+    groupPtr = Blt_AssertCalloc(1, sizeof(AggregateGroup) +
+                                aggPtr->numAggregates * sizeof(Accumulator));
+    groupPtr->rowPtr = rowPtr;
+    groupPtr->accums = (Accumulator *)(groupPtr + 1);
+    Blt_SetHashValue(hPtr, groupPtr);
+    Blt_Chain_Append(aggPtr->groups, groupPtr);
+    return groupPtr;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_set_row_label --
- *
- *      Returns the label of the row.  If the row offset is invalid or the row
- *      has no label, then NULL is returned.
+ * AccumulateValue --
  *
- * Results:
- *      Returns the label of the row.
+ *      Adds the value to the accumulator of an aggregate.  Both are
+ *      int64_t datums if isInteger is set, doubles otherwise.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_set_row_label(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr, 
-                        const char *label)
+static INLINE void
+AccumulateValue(Accumulator *accPtr, int isInteger, Value *valuePtr)
 {
-    BLT_TABLE_NOTIFY_EVENT event;
-        
-    InitNotifyEvent(tablePtr, &event);
-    event.type = TABLE_NOTIFY_RELABEL;
-    event.row = rowPtr;
-    SetRowLabel(&tablePtr->corePtr->rows, rowPtr, label);
-    NotifyClients(tablePtr, &event);
-    return TCL_OK;
+    if (isInteger) {
+        int64_t x;
+
+        x = valuePtr->datum.i64;
+        if ((accPtr->count == 0) || (x < accPtr->min.datum.i64)) {
+            accPtr->min.datum.i64 = x;
+        }
+        if ((accPtr->count == 0) || (x > accPtr->max.datum.i64)) {
+            accPtr->max.datum.i64 = x;
+        }
+        accPtr->sum.datum.i64 += x;
+    } else {
+        double x;
+
+        x = valuePtr->datum.d;
+        if ((accPtr->count == 0) || (x < accPtr->min.datum.d)) {
+            accPtr->min.datum.d = x;
+        }
+        if ((accPtr->count == 0) || (x > accPtr->max.datum.d)) {
+            accPtr->max.datum.d = x;
+        }
+        accPtr->sum.datum.d += x;
+    }
+}
+
+static void
+MergeAccumulator(Accumulator *accPtr, int isInteger, Accumulator *srcPtr)
+{
+    if (srcPtr->count == 0) {
+        return;
+    }
+    if (accPtr->count == 0) {
+        *accPtr = *srcPtr;
+        return;
+    }
+    if (isInteger) {
+        accPtr->min.datum.i64 = MIN(accPtr->min.datum.i64,
+                                    srcPtr->min.datum.i64);
+        accPtr->max.datum.i64 = MAX(accPtr->max.datum.i64,
+                                    srcPtr->max.datum.i64);
+        accPtr->sum.datum.i64 += srcPtr->sum.datum.i64;
+    } else {
+        accPtr->min.datum.d = MIN(accPtr->min.datum.d, srcPtr->min.datum.d);
+        accPtr->max.datum.d = MAX(accPtr->max.datum.d, srcPtr->max.datum.d);
+        accPtr->sum.datum.d += srcPtr->sum.datum.d;
+    }
+    accPtr->count += srcPtr->count;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_set_column_label --
- *
- *      Sets the label of the column.  If the column offset is invalid, then
- *      no label is set.
+ * AggregateRows --
  *
- * Results:
- *      None.
+ *      Aggregates the aggregator's range of rows.  If a value of a string
+ *      column isn't a number, the row and column are recorded and the
+ *      aggregation stops.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_set_column_label(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
-                           const char *label)
+static void
+AggregateRows(Aggregator *aggPtr)
 {
-    BLT_TABLE_NOTIFY_EVENT event;
+    long i;
 
-    InitNotifyEvent(tablePtr, &event);
-    event.type = TABLE_NOTIFY_COLUMNS_RELABEL;
-    event.column = colPtr;
-    SetColumnLabel(&tablePtr->corePtr->columns, colPtr, label);
-    NotifyClients(tablePtr, &event);
-    return TCL_OK;
+    for (i = 0; i < aggPtr->numRows; i++) {
+        AggregateGroup *groupPtr;
+        Row *rowPtr;
+        long j;
+
+        rowPtr = aggPtr->rows[i];
+        groupPtr = GetAggregateGroup(aggPtr, rowPtr);
+        groupPtr->numRows++;
+        for (j = 0; j < aggPtr->numAggregates; j++) {
+            Column *colPtr;
+            Accumulator *accPtr;
+            Value value;
+            unsigned int length;
+
+            colPtr = aggPtr->aggregates[j].column;
+            if ((colPtr == NULL) || (IsEmpty(rowPtr, colPtr))) {
+                continue;
+            }
+            accPtr = groupPtr->accums + j;
+            if (aggPtr->aggregates[j].type == TABLE_AGGREGATE_COUNT) {
+                accPtr->count++;
+                continue;
+            }
+            switch (colPtr->type) {
+            case TABLE_COLUMN_TYPE_DOUBLE:
+            case TABLE_COLUMN_TYPE_TIME:
+            case TABLE_COLUMN_TYPE_INT64:
+                GetCellDatum(rowPtr, colPtr, &value);
+                break;
+            case TABLE_COLUMN_TYPE_LONG:
+            case TABLE_COLUMN_TYPE_BOOLEAN:
+                GetCellDatum(rowPtr, colPtr, &value);
+                value.datum.i64 = value.datum.l;
+                break;
+            default:
+                if (Tcl_GetDouble((Tcl_Interp *)NULL, GetStoredString(rowPtr,
+                        colPtr, &length), &value.datum.d) != TCL_OK) {
+                    aggPtr->badRowPtr = rowPtr;
+                    aggPtr->badColPtr = colPtr;
+                    return;
+                }
+                break;
+            }
+            AccumulateValue(accPtr, aggPtr->isInteger[j], &value);
+            accPtr->count++;
+        }
+    }
+}
+
+static Tcl_ThreadCreateType
+AggregateWorkerProc(ClientData clientData)
+{
+    Aggregator *aggPtr = clientData;
+
+    AggregateRows(aggPtr);
+    TCL_THREAD_CREATE_RETURN;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_set_column_type --
- *
- *      Sets the type of the given column.  
+ * MergeAggregator --
  *
- * Results:
- *      None.
+ *      Merges the groups of a later range of rows into the aggregator.
+ *      Each group is looked up again by the values of its first row.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_set_column_type(Tcl_Interp *interp, Table *tablePtr, Column *colPtr, 
-                          BLT_TABLE_COLUMN_TYPE type)
+static void
+MergeAggregator(Aggregator *aggPtr, Aggregator *srcPtr)
 {
-    if (type == colPtr->type) {
-        return TCL_OK;                  /* Already the requested type. */
+    Blt_ChainLink link;
+
+    for (link = Blt_Chain_FirstLink(srcPtr->groups); link != NULL;
+         link = Blt_Chain_NextLink(link)) {
+        AggregateGroup *groupPtr, *srcGroupPtr;
+        long i;
+
+        srcGroupPtr = Blt_Chain_GetValue(link);
+        groupPtr = GetAggregateGroup(aggPtr, srcGroupPtr->rowPtr);
+        groupPtr->numRows += srcGroupPtr->numRows;
+        for (i = 0; i < aggPtr->numAggregates; i++) {
+            MergeAccumulator(groupPtr->accums + i, aggPtr->isInteger[i],
+                             srcGroupPtr->accums + i);
+        }
     }
-    return SetColumnType(interp, tablePtr, colPtr, type);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_value_exists --
- *
- *      Indicates if a value exists for a given row,column offset in the
- *      tuple.  Note that this routine does not fire read traces.
+ * StoreAggregate --
  *
- * Results:
- *      Returns 1 is a value exists, 0 otherwise.
+ *      Sets the cell of an aggregate column in the destination table.
+ *      Aggregates over no values are left empty.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_value_exists(Table *tablePtr, Row *rowPtr, Column *colPtr)
+static int
+StoreAggregate(Tcl_Interp *interp, Table *destPtr, Row *rowPtr,
+               Column *colPtr, BLT_TABLE_AGGREGATE *aggPtr, int isInteger,
+               AggregateGroup *groupPtr, Accumulator *accPtr)
 {
-    if ((colPtr == NULL) || (rowPtr == NULL)) {
-        return 0;
+    Value *valuePtr;
+
+    switch (aggPtr->type) {
+    case TABLE_AGGREGATE_COUNT:
+        return blt_table_set_long(interp, destPtr, rowPtr, colPtr,
+            (aggPtr->column == NULL) ? groupPtr->numRows : accPtr->count);
+    case TABLE_AGGREGATE_MEAN:
+        if (accPtr->count == 0) {
+            return TCL_OK;
+        }
+        return blt_table_set_double(interp, destPtr, rowPtr, colPtr,
+                (isInteger) ?
+                (double)accPtr->sum.datum.i64 / accPtr->count :
+                accPtr->sum.datum.d / accPtr->count);
+    case TABLE_AGGREGATE_SUM:
+        valuePtr = &accPtr->sum;
+        break;
+    case TABLE_AGGREGATE_MIN:
+        valuePtr = &accPtr->min;
+        break;
+    case TABLE_AGGREGATE_MAX:
+    default:
+        valuePtr = &accPtr->max;
+        break;
+    }
+    if (accPtr->count == 0) {
+        return TCL_OK;
+    }
+    switch (colPtr->type) {
+    case TABLE_COLUMN_TYPE_INT64:
+        return blt_table_set_int64(interp, destPtr, rowPtr, colPtr,
+                valuePtr->datum.i64);
+    case TABLE_COLUMN_TYPE_LONG:
+        return blt_table_set_long(interp, destPtr, rowPtr, colPtr,
+                (long)valuePtr->datum.i64);
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        return blt_table_set_boolean(interp, destPtr, rowPtr, colPtr,
+                (int)valuePtr->datum.i64);
+    default:
+        return blt_table_set_double(interp, destPtr, rowPtr, colPtr,
+                valuePtr->datum.d);
     }
-    return !IsEmpty(rowPtr, colPtr);
 }
 
+static BLT_TABLE_COLUMN_TYPE
+GetAggregateType(BLT_TABLE_AGGREGATE *aggPtr)
+{
+    Column *colPtr;
+
+    colPtr = aggPtr->column;
+    switch (aggPtr->type) {
+    case TABLE_AGGREGATE_COUNT:
+        return TABLE_COLUMN_TYPE_LONG;
+    case TABLE_AGGREGATE_MEAN:
+        return TABLE_COLUMN_TYPE_DOUBLE;
+    case TABLE_AGGREGATE_SUM:
+        if (colPtr->type == TABLE_COLUMN_TYPE_INT64) {
+            return TABLE_COLUMN_TYPE_INT64;
+        }
+        return (IsIntegerColumn(colPtr)) ?
+            TABLE_COLUMN_TYPE_LONG : TABLE_COLUMN_TYPE_DOUBLE;
+    case TABLE_AGGREGATE_MIN:
+    case TABLE_AGGREGATE_MAX:
+    default:
+        return (IsDenseColumn(colPtr)) ?
+            colPtr->type : TABLE_COLUMN_TYPE_DOUBLE;
+    }
+}
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_extend_rows --
+ * blt_table_aggregate --
  *
- *      Adds new rows to the table.  Rows are slots in an array of Rows.  The
- *      array grows by doubling its size, so there may be more slots than
- *      needed (# rows).
+ *      Groups the rows of the table by the values of the group columns
+ *      and computes the aggregates for each group.  For each group a row
+ *      is appended to the destination table.  Its first columns hold the
+ *      group's values, followed by one column for each aggregate.  The
+ *      rows are in the order that the groups first appear.  If rows is
+ *      NULL, all the rows of the table are aggregated.
  *
- * Results:
- *      Returns TCL_OK is the tuple is resized and TCL_ERROR if an not enough
- *      memory was available.
+ *      Counts are integers.  Sums of integer columns are integers, means
+ *      are doubles, and minimums and maximums have the type of the
+ *      column.  Values of string columns are read as doubles.  If
+ *      numThreads is greater than 1, the rows are split into that many
+ *      ranges aggregated in parallel.
  *
- * Side Effects:
- *      If more rows are needed, the array which holds the tuples is
- *      reallocated by doubling its size.
+ * Results:
+ *      Returns a standard TCL result.  It's an error if a value of a
+ *      string column to be summed, averaged, or compared isn't a number.
+ *      In that case the destination table is left unchanged.
  *
  *---------------------------------------------------------------------------
  */
 int
-blt_table_extend_rows(Tcl_Interp *interp, Table *tablePtr, size_t numExtra, 
-                      Row **rows)
+blt_table_aggregate(Tcl_Interp *interp, Table *tablePtr, long numRows,
+                    Row **rows, long numColumns, Column **columns,
+                    long numAggregates, BLT_TABLE_AGGREGATE *aggregates,
+                    int numThreads, Table *destPtr)
 {
-    long i;
-    Blt_Chain chain;
+    Aggregator aggs[AGGREGATE_MAX_THREADS];
+    Tcl_ThreadId ids[AGGREGATE_MAX_THREADS];
+    int created[AGGREGATE_MAX_THREADS];
+    Column **destColumns;
+    Row **allRows, **destRows;
     Blt_ChainLink link;
+    int *isInteger;
+    long i, numGroups;
+    int result;
 
-    if (numExtra == 0) {
-        return TCL_OK;
-    }
-    chain = Blt_Chain_Create();
-    if (!ExtendRows(tablePtr, numExtra, chain)) {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "can't extend table by ", 
-                Blt_Ltoa(numExtra), " rows: out of memory.", (char *)NULL);
+    allRows = NULL;
+    if (rows == NULL) {
+        Row *rowPtr;
+
+        numRows = tablePtr->corePtr->rows.numUsed;
+        allRows = Blt_AssertMalloc((numRows + 1) * sizeof(Row *));
+        for (i = 0, rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL;
+             rowPtr = rowPtr->nextPtr, i++) {
+            allRows[i] = rowPtr;
         }
-        Blt_Chain_Destroy(chain);
-        return TCL_ERROR;
+        rows = allRows;
     }
-    /* For each new row generate a notify event. */
-    for (i = 0, link = Blt_Chain_FirstLink(chain); link != NULL; 
-         link = Blt_Chain_NextLink(link), i++) {
-        Row *rowPtr;
+    isInteger = Blt_AssertMalloc((numAggregates + 1) * sizeof(int));
+    for (i = 0; i < numAggregates; i++) {
+        isInteger[i] = (aggregates[i].column != NULL) &&
+            (IsIntegerColumn(aggregates[i].column));
+    }
+    if (numThreads > AGGREGATE_MAX_THREADS) {
+        numThreads = AGGREGATE_MAX_THREADS;
+    }
+    if (numThreads > numRows) {
+        numThreads = numRows;
+    }
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+    for (i = 0; i < numThreads; i++) {
+        long first, last;
 
-        rowPtr = Blt_Chain_GetValue(link);
-        if (rows != NULL) {
-            rows[i] = rowPtr;
+        first = (numRows * i) / numThreads;
+        last = (numRows * (i + 1)) / numThreads;
+        InitAggregator(aggs + i, numColumns, columns, numAggregates,
+                       aggregates, isInteger, rows + first, last - first);
+        created[i] = (i > 0) &&
+            (Tcl_CreateThread(ids + i, AggregateWorkerProc, aggs + i,
+                TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) == TCL_OK);
+    }
+    for (i = 0; i < numThreads; i++) {
+        if (!created[i]) {
+            AggregateRows(aggs + i);
         }
-        NotifyRowChanged(tablePtr, rowPtr, TABLE_NOTIFY_ROWS_CREATED);
     }
-    assert(Blt_Chain_GetLength(chain) > 0);
-    Blt_Chain_Destroy(chain);
-    return TCL_OK;
-}
+    for (i = 0; i < numThreads; i++) {
+        if (created[i]) {
+            int dummy;
 
-int
-blt_table_delete_row(Table *tablePtr, Row *rowPtr)
-{
-    NotifyRowChanged(tablePtr, rowPtr, TABLE_NOTIFY_ROWS_DELETED);
-    UnsetRowValues(tablePtr, rowPtr);
-    Blt_Tags_ClearTagsFromItem(tablePtr->rowTags, rowPtr);
-    blt_table_clear_row_traces(tablePtr, rowPtr);
-    ClearRowNotifiers(tablePtr, rowPtr);
-    tablePtr->flags |= TABLE_KEYS_DIRTY;
-    DeleteRow(&tablePtr->corePtr->rows, rowPtr);
-    return TCL_OK;
-}
+            Tcl_JoinThread(ids[i], &dummy);
+        }
+    }
+    destColumns = NULL;
+    destRows = NULL;
+    result = TCL_ERROR;
+    for (i = 0; i < numThreads; i++) {
+        if (aggs[i].badRowPtr != NULL) {
+            if (interp != NULL) {
+                unsigned int length;
+
+                Tcl_AppendResult(interp, "value \"",
+                    GetStoredString(aggs[i].badRowPtr, aggs[i].badColPtr,
+                                    &length),
+                    "\" in row \"", aggs[i].badRowPtr->label,
+                    "\" of column \"", aggs[i].badColPtr->label,
+                    "\" is not a number", (char *)NULL);
+            }
+            goto error;
+        }
+    }
+    for (i = 1; i < numThreads; i++) {
+        MergeAggregator(aggs, aggs + i);
+    }
 
-BLT_TABLE_ROW
-blt_table_create_row(Tcl_Interp *interp, BLT_TABLE table, const char *label)
-{
-    Row *rowPtr;
+    /* Add the group and aggregate columns to the destination table. */
+    destColumns = Blt_AssertMalloc((numColumns + numAggregates + 1) *
+                                   sizeof(Column *));
+    for (i = 0; i < (numColumns + numAggregates); i++) {
+        BLT_TABLE_COLUMN_TYPE type;
+        const char *label;
 
-    rowPtr = NULL;                      /* Suppress compiler warning. */
-    if (blt_table_extend_rows(interp, table, 1, &rowPtr) != TCL_OK) {
-        return NULL;
+        if (i < numColumns) {
+            label = columns[i]->label;
+            type = columns[i]->type;
+        } else {
+            label = aggregates[i - numColumns].label;
+            type = GetAggregateType(aggregates + i - numColumns);
+        }
+        destColumns[i] = blt_table_create_column(interp, destPtr, label);
+        if ((destColumns[i] == NULL) ||
+            (blt_table_set_column_type(interp, destPtr, destColumns[i], type)
+             != TCL_OK)) {
+            goto error;
+        }
     }
-    if (label != NULL) {
-        if (blt_table_set_row_label(interp, table, rowPtr, label) != TCL_OK) {
-            blt_table_delete_row(table, rowPtr);
-            return NULL;
+    numGroups = Blt_Chain_GetLength(aggs[0].groups);
+    destRows = Blt_AssertMalloc((numGroups + 1) * sizeof(Row *));
+    if (blt_table_extend_rows(interp, destPtr, numGroups, destRows)
+        != TCL_OK) {
+        goto error;
+    }
+    for (i = 0, link = Blt_Chain_FirstLink(aggs[0].groups); link != NULL;
+         link = Blt_Chain_NextLink(link), i++) {
+        AggregateGroup *groupPtr;
+        long j;
+
+        groupPtr = Blt_Chain_GetValue(link);
+        for (j = 0; j < numColumns; j++) {
+            if (IsEmpty(groupPtr->rowPtr, columns[j])) {
+                continue;
+            }
+            if (blt_table_set_value(destPtr, destRows[i], destColumns[j],
+                    blt_table_get_value(tablePtr, groupPtr->rowPtr,
+                                        columns[j])) != TCL_OK) {
+                goto error;
+            }
+        }
+        for (j = 0; j < numAggregates; j++) {
+            if (StoreAggregate(interp, destPtr, destRows[i],
+                    destColumns[numColumns + j], aggregates + j,
+                    isInteger[j], groupPtr, groupPtr->accums + j) != TCL_OK) {
+                goto error;
+            }
         }
     }
-    return rowPtr;
+    result = TCL_OK;
+ error:
+    for (i = 0; i < numThreads; i++) {
+        FreeAggregator(aggs + i);
+    }
+    if (destColumns != NULL) {
+        Blt_Free(destColumns);
+    }
+    if (destRows != NULL) {
+        Blt_Free(destRows);
+    }
+    if (allRows != NULL) {
+        Blt_Free(allRows);
+    }
+    Blt_Free(isInteger);
+    return result;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_move_rows --
+ * Windows --
  *
- *      Move one of more rows to a new location in the tuple.
+ *      blt_table_window computes a rolling (or cumulative) sum, mean,
+ *      minimum, maximum, standard deviation, or median of a column into
+ *      another column.  Each row's window is the row and the rows before
+ *      it, in table order, up to the window size.  With a group column,
+ *      windows only span rows of the same group.  The groups are found
+ *      as for aggregates, and the rows are then ordered by group so that
+ *      each group is computed in one pass.
+ *
+ *      Sums and means are kept as running totals, minimums and maximums
+ *      with monotonic deques of the window's values, standard deviations
+ *      with Welford's updates, and medians with a Fenwick tree over the
+ *      ranks of the group's values.
  *
  *---------------------------------------------------------------------------
  */
-/*ARGSUSED*/
-int
-blt_table_move_rows(Tcl_Interp *interp, Table *tablePtr, Row *destPtr, 
-                   Row *firstPtr, Row *lastPtr, int after)
-{
-    Rows *rowsPtr;
+typedef union {
+    double d;
+    int64_t i64;                        /* Integer columns. */
+} WindowDatum;
 
-    rowsPtr = &tablePtr->corePtr->rows;
-    if (!MoveRows(rowsPtr, destPtr, firstPtr, lastPtr, after)) {
-        Tcl_AppendResult(interp, "can't allocate new map for \"", 
-                blt_table_name(tablePtr), "\"", (char *)NULL);
-        return TCL_ERROR;
-    }
-    NotifyRowChanged(tablePtr, NULL, TABLE_NOTIFY_ROWS_MOVED);
-    return TCL_OK;
-}
+typedef struct {
+    WindowDatum x;
+    long pos;                           /* Position of the value in the
+                                         * group. */
+} WindowRank;
 
-void
-blt_table_set_row_map(Table *tablePtr, Row **map)
-{
-    ReplaceRowMap(&tablePtr->corePtr->rows, map);
-    NotifyRowChanged(tablePtr, NULL, TABLE_NOTIFY_ROWS_MOVED);
-}
+typedef struct {
+    BLT_TABLE_WINDOW *winPtr;
+    int isInteger;                      /* Indicates if the values are
+                                         * integers. */
+    WindowDatum *values;                /* Values of the group, by
+                                         * position. */
+    unsigned char *isEmpty;             /* Indicates empty values. */
+    WindowDatum *results;
+    unsigned char *hasResult;
+    long *deque;                        /* Positions of the monotonic
+                                         * deque of minimums or maximums. */
+    WindowRank *sorted;                 /* Group's values sorted, for
+                                         * medians. */
+    long *ranks;                        /* Rank of each position. */
+    long *tree;                         /* Fenwick tree of the ranks in
+                                         * the window. */
+} Windower;
 
-void
-blt_table_sort_init(Table *tablePtr, BLT_TABLE_SORT_ORDER *order, 
-                    long numColumns, unsigned int flags)
+static int
+CompareWindowDoubles(const void *a, const void *b)
 {
-    size_t i;
-
-    sortData.table = tablePtr;
-    sortData.order = order;
-    sortData.numColumns = numColumns;
-    sortData.flags = flags;
-    for (i = 0; i < numColumns; i++) {
-        BLT_TABLE_SORT_ORDER *sortPtr;
+    const WindowRank *r1 = a, *r2 = b;
 
-        sortPtr = order + i;
-        sortPtr->clientData = tablePtr;
-        sortPtr->cmpProc = blt_table_get_compare_proc(tablePtr, 
-                sortPtr->column, flags);
+    if (r1->x.d < r2->x.d) {
+        return -1;
     }
+    return (r1->x.d > r2->x.d);
 }
 
-void
-blt_table_sort_finish()
-{
-}
-
-BLT_TABLE_ROW *
-blt_table_sort_rows(Table *tablePtr)
+static int
+CompareWindowInt64s(const void *a, const void *b)
 {
-    return SortRows(&tablePtr->corePtr->rows, (QSortCompareProc *)CompareRows);
-}
-
-
+    const WindowRank *r1 = a, *r2 = b;
 
-void
-blt_table_sort_row_map(Table *tablePtr, long numRows, BLT_TABLE_ROW *rows)
-{
-    /* Sort the map and return it. */
-    qsort((char *)rows, numRows, sizeof(BLT_TABLE_ROW), 
-          (QSortCompareProc *)CompareRows);
+    if (r1->x.i64 < r2->x.i64) {
+        return -1;
+    }
+    return (r1->x.i64 > r2->x.i64);
 }
 
-int
-blt_table_get_column_limits(Tcl_Interp *interp, Table *tablePtr, Column *colPtr,
-                          Tcl_Obj **minObjPtrPtr, Tcl_Obj **maxObjPtrPtr)
+static INLINE double
+WindowDouble(Windower *winPtr, WindowDatum *datumPtr)
 {
-    Row *rowPtr, *minRowPtr, *maxRowPtr;
-
-    if (blt_table_num_rows(tablePtr) == 0) {
-        return TCL_OK;
-    }
-    rowPtr = blt_table_first_row(tablePtr);
-    maxRowPtr = minRowPtr = rowPtr;
-    sortData.table = tablePtr;
-    for (/*empty*/; rowPtr != NULL; rowPtr = rowPtr->nextPtr) {
-        BLT_TABLE_COMPARE_PROC *proc;
-
-        proc = blt_table_get_compare_proc(tablePtr, colPtr, 0);
-        if ((*proc)(NULL, colPtr, rowPtr, minRowPtr) < 0) {
-                minRowPtr = rowPtr;
-        }
-        if ((*proc)(NULL, colPtr, rowPtr, maxRowPtr) > 0) {
-            maxRowPtr = rowPtr;
-        }
-    }
-    *minObjPtrPtr = blt_table_get_obj(tablePtr, minRowPtr, colPtr);
-    *maxObjPtrPtr = blt_table_get_obj(tablePtr, maxRowPtr, colPtr);
-    return TCL_OK;
+    return (winPtr->isInteger) ? (double)datumPtr->i64 : datumPtr->d;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_delete_column --
- *
- *      Remove the designated column from the table.  The actual space
- *      contained by the column isn't freed.  The map is compressed.
- *      Tcl_Objs stored as column values are released.  Traces and tags
- *      associated with the column are removed.
+ * WindowTotals --
  *
- * Side Effects:
- *      Traces may fire when column values are unset.  Also notifier events
- *      may be triggered, indicating the column has been deleted.
+ *      Computes the rolling sums, means, or standard deviations of a
+ *      group.  Values are added as they enter the window and subtracted
+ *      as they leave it.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_delete_column(Table *tablePtr, Column *colPtr)
+static void
+WindowTotals(Windower *winPtr, long length)
 {
-    /* If the deleted column is a primary key, the generated keytables
-     * are now invalid. So remove them. */
-    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
-        blt_table_unset_keys(tablePtr);
+    BLT_TABLE_WINDOW_TYPE type;
+    WindowDatum *values, *results;
+    double sum, mean, m2;
+    int64_t isum;
+    long count, p, size;
+
+    type = winPtr->winPtr->type;
+    size = winPtr->winPtr->size;
+    values = winPtr->values;
+    results = winPtr->results;
+    count = 0;
+    isum = 0;
+    sum = mean = m2 = 0.0;
+    for (p = 0; p < length; p++) {
+        double x, delta;
+
+        if (!winPtr->isEmpty[p]) {
+            x = WindowDouble(winPtr, values + p);
+            if (winPtr->isInteger) {
+                isum += values[p].i64;
+            }
+            sum += x;
+            count++;
+            delta = x - mean;
+            mean += delta / count;
+            m2 += delta * (x - mean);
+        }
+        if ((size > 0) && (p >= size) && (!winPtr->isEmpty[p - size])) {
+            x = WindowDouble(winPtr, values + p - size);
+            if (winPtr->isInteger) {
+                isum -= values[p - size].i64;
+            }
+            sum -= x;
+            count--;
+            if (count == 0) {
+                sum = mean = m2 = 0.0;
+            } else {
+                delta = x - mean;
+                mean -= delta / count;
+                m2 -= delta * (x - mean);
+            }
+        }
+        winPtr->hasResult[p] = (count > 0);
+        switch (type) {
+        case TABLE_WINDOW_SUM:
+            if (winPtr->isInteger) {
+                results[p].i64 = isum;
+            } else {
+                results[p].d = sum;
+            }
+            break;
+        case TABLE_WINDOW_MEAN:
+            results[p].d = (winPtr->isInteger) ? 
+                (double)isum / count : sum / count;
+            break;
+        case TABLE_WINDOW_STD:
+        default:
+            /* Sample standard deviation, so at least two values. */
+            winPtr->hasResult[p] = (count > 1);
+            results[p].d = (m2 > 0.0) ? sqrt(m2 / (count - 1)) : 0.0;
+            break;
+        }
     }
-    NotifyColumnChanged(tablePtr, colPtr, TABLE_NOTIFY_COLUMNS_DELETED);
-    blt_table_clear_column_traces(tablePtr, colPtr);
-    Blt_Tags_ClearTagsFromItem(tablePtr->columnTags, colPtr);
-    ClearColumnNotifiers(tablePtr, colPtr);
-    DeleteColumn(tablePtr, colPtr);
-    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_extend_columns --
- *
- *      Adds new columns to the table.  Columns are slots in an array of
- *      Columns.  The array columns by doubling its size, so there may be more
- *      slots than needed (# columns).
- *
- * Results:
- *      Returns TCL_OK is the tuple is resized and TCL_ERROR if an
- *      not enough memory was available.
+ * WindowExtrema --
  *
- * Side Effects:
- *      If more columns are needed, the array which holds the tuples is
- *      reallocated by doubling its size.  
+ *      Computes the rolling minimums or maximums of a group.  The deque
+ *      holds the positions of the window's values that may still become
+ *      the extreme value, in order.  Its values are monotonic, so the
+ *      front is the extreme value of the window.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_extend_columns(Tcl_Interp *interp, BLT_TABLE table, size_t numExtra, 
-                        Column **columns)
+static void
+WindowExtrema(Windower *winPtr, long length)
 {
-    size_t i;
-    Blt_Chain chain;
-    Blt_ChainLink link;
-
-    chain = Blt_Chain_Create();
-    if (!ExtendColumns(table, numExtra, chain)) {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "can't extend table by ", 
-                Blt_Ltoa(numExtra), " columns: out of memory.", (char *)NULL);
-        }
-        Blt_Chain_Destroy(chain);
-        return TCL_ERROR;
-    }
-    /* For each new column generate a notify event. */
-    for (i = 0, link = Blt_Chain_FirstLink(chain); link != NULL; 
-         link = Blt_Chain_NextLink(link), i++) {
-        Column *colPtr;
-
-        colPtr = Blt_Chain_GetValue(link);
-        if (columns != NULL) {
-            columns[i] = colPtr;
+    WindowDatum *values;
+    long *deque;
+    long head, tail, p, size;
+    int isMax;
+
+    isMax = (winPtr->winPtr->type == TABLE_WINDOW_MAX);
+    size = winPtr->winPtr->size;
+    values = winPtr->values;
+    deque = winPtr->deque;
+    head = tail = 0;
+    for (p = 0; p < length; p++) {
+        if (!winPtr->isEmpty[p]) {
+            while (tail > head) {
+                WindowDatum *lastPtr;
+                int isWorse;
+
+                lastPtr = values + deque[tail - 1];
+                if (winPtr->isInteger) {
+                    isWorse = (isMax) ? (lastPtr->i64 <= values[p].i64) :
+                        (lastPtr->i64 >= values[p].i64);
+                } else {
+                    isWorse = (isMax) ? (lastPtr->d <= values[p].d) :
+                        (lastPtr->d >= values[p].d);
+                }
+                if (!isWorse) {
+                    break;
+                }
+                tail--;
+            }
+            deque[tail++] = p;
+        }
+        if ((size > 0) && (head < tail) && (deque[head] <= (p - size))) {
+            head++;                     /* Front has left the window. */
+        }
+        winPtr->hasResult[p] = (head < tail);
+        if (head < tail) {
+            winPtr->results[p] = values[deque[head]];
         }
-        NotifyColumnChanged(table, colPtr, TABLE_NOTIFY_COLUMNS_CREATED);
     }
-    Blt_Chain_Destroy(chain);
-    return TCL_OK;
 }
 
-BLT_TABLE_COLUMN
-blt_table_create_column(Tcl_Interp *interp, BLT_TABLE table, const char *label)
+static INLINE void
+UpdateRankTree(long *tree, long n, long rank, long delta)
 {
-    Column *colPtr;
-
-    colPtr = NULL;                      /* Suppress compiler warning. */
-    if (blt_table_extend_columns(interp, table, 1, &colPtr) != TCL_OK) {
-        return NULL;
+    for (rank++; rank <= n; rank += rank & -rank) {
+        tree[rank] += delta;
     }
-    if (label != NULL) {
-        if (blt_table_set_column_label(interp, table, colPtr, label)!=TCL_OK) {
-            blt_table_delete_column(table, colPtr);
-            return NULL;
-        }
-    }
-    return colPtr;
 }
 
-void
-blt_table_set_column_map(Table *tablePtr, Column **map)
+/* Returns the rank of the kth (from 1) smallest value in the tree. */
+static INLINE long
+FindRankTree(long *tree, long n, long k)
 {
-    NotifyColumnChanged(tablePtr, NULL, TABLE_NOTIFY_COLUMNS_MOVED);
-    ReplaceColumnMap(&tablePtr->corePtr->columns, map);
+    long rank, step;
+
+    rank = 0;
+    for (step = 1; (step << 1) <= n; step <<= 1) {
+        /* empty */
+    }
+    for (/*empty*/; step > 0; step >>= 1) {
+        if (((rank + step) <= n) && (tree[rank + step] < k)) {
+            rank += step;
+            k -= tree[rank];
+        }
+    }
+    return rank;                        /* Ranks start from 0. */
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_move_columns --
+ * WindowMedians --
  *
- *      Move one of more rows to a new location in the tuple.
+ *      Computes the rolling medians of a group.  The group's values are
+ *      sorted once to rank them.  A Fenwick tree counts the ranks in the
+ *      window, so the middle values are found in logarithmic time.
  *
  *---------------------------------------------------------------------------
  */
-/*ARGSUSED*/
-int
-blt_table_move_columns(Tcl_Interp *interp, Table *tablePtr, Column *destPtr, 
-                       Column *firstPtr, Column *lastPtr, int after)
+static void
+WindowMedians(Windower *winPtr, long length)
 {
-    Columns *columnsPtr;
+    WindowRank *sorted;
+    long *tree;
+    long i, n, count, p, size;
+
+    size = winPtr->winPtr->size;
+    sorted = winPtr->sorted;
+    tree = winPtr->tree;
+    n = 0;
+    for (p = 0; p < length; p++) {
+        if (!winPtr->isEmpty[p]) {
+            sorted[n].x = winPtr->values[p];
+            sorted[n].pos = p;
+            n++;
+        }
+    }
+    qsort(sorted, n, sizeof(WindowRank), (winPtr->isInteger) ? 
+          CompareWindowInt64s : CompareWindowDoubles);
+    for (i = 0; i < n; i++) {
+        winPtr->ranks[sorted[i].pos] = i;
+    }
+    memset(tree, 0, (n + 1) * sizeof(long));
+    count = 0;
+    for (p = 0; p < length; p++) {
+        if (!winPtr->isEmpty[p]) {
+            UpdateRankTree(tree, n, winPtr->ranks[p], 1);
+            count++;
+        }
+        if ((size > 0) && (p >= size) && (!winPtr->isEmpty[p - size])) {
+            UpdateRankTree(tree, n, winPtr->ranks[p - size], -1);
+            count--;
+        }
+        winPtr->hasResult[p] = (count > 0);
+        if (count > 0) {
+            double median;
+
+            median = WindowDouble(winPtr, 
+                &sorted[FindRankTree(tree, n, (count + 1) / 2)].x);
+            if ((count & 1) == 0) {
+                median = (median + WindowDouble(winPtr, 
+                        &sorted[FindRankTree(tree, n, count / 2 + 1)].x)) 
+                    * 0.5;
+            }
+            winPtr->results[p].d = median;
+        }
+    }
+}
 
-    columnsPtr = &tablePtr->corePtr->columns;
-    if (!MoveColumns(columnsPtr, destPtr, firstPtr, lastPtr, after)) {
-        Tcl_AppendResult(interp, "can't move columns in \"", 
-                blt_table_name(tablePtr), "\"", (char *)NULL);
-        return TCL_ERROR;
+/* Computes the results of the rows from first to last (exclusive). */
+static void
+WindowRun(Windower *winPtr, long first, long last)
+{
+    Windower run;
+
+    run = *winPtr;
+    run.values += first;
+    run.isEmpty += first;
+    run.results += first;
+    run.hasResult += first;
+    switch (winPtr->winPtr->type) {
+    case TABLE_WINDOW_MIN:
+    case TABLE_WINDOW_MAX:
+        WindowExtrema(&run, last - first);
+        break;
+    case TABLE_WINDOW_MEDIAN:
+        WindowMedians(&run, last - first);
+        break;
+    default:
+        WindowTotals(&run, last - first);
+        break;
+    }
+}
+
+static BLT_TABLE_COLUMN_TYPE
+GetWindowType(BLT_TABLE_WINDOW *winPtr, Column *colPtr)
+{
+    switch (winPtr->type) {
+    case TABLE_WINDOW_SUM:
+        if (colPtr->type == TABLE_COLUMN_TYPE_INT64) {
+            return TABLE_COLUMN_TYPE_INT64;
+        }
+        return (IsIntegerColumn(colPtr)) ?
+            TABLE_COLUMN_TYPE_LONG : TABLE_COLUMN_TYPE_DOUBLE;
+    case TABLE_WINDOW_MIN:
+    case TABLE_WINDOW_MAX:
+        return (IsDenseColumn(colPtr)) ?
+            colPtr->type : TABLE_COLUMN_TYPE_DOUBLE;
+    default:
+        return TABLE_COLUMN_TYPE_DOUBLE;
     }
-    NotifyColumnChanged(tablePtr, NULL, TABLE_NOTIFY_COLUMNS_MOVED);
-    return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_restore --
- *
- *      Restores data to the given table based upon the dump string.
- *      The dump string should have been generated by blt_table_dump.
- *      Two bit flags may be set.
- *      
- *      TABLE_RESTORE_NO_TAGS   Don't restore tag information.
- *      TABLE_RESTORE_OVERWRITE Look for row and columns with the 
- *                              same label. Overwrite if necessary.
- *
- * Results:
- *      A standard TCL result.  If the restore was successful, TCL_OK
- *      is returned.  Otherwise, TCL_ERROR is returned and an error
- *      message is left in the interpreter result.
+ * StoreWindowResult --
  *
- * Side Effects:
- *      New row and columns are created in the table and may possibly
- *      generate event notifier or trace callbacks.
+ *      Sets the cell of the destination column.  Integer results are
+ *      stored as integers, so they're exact.  Only the batch records the
+ *      write: the caller has a batch open.
  *
  *---------------------------------------------------------------------------
  */
-int
-blt_table_restore(Tcl_Interp *interp, BLT_TABLE table, char *data, 
-                      unsigned int flags)
+static int
+StoreWindowResult(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
+                  Column *colPtr, int isInteger, WindowDatum *datumPtr)
 {
-    RestoreData restore;
-    int result;
-
-    restore.argc = 0;
-    restore.mtime = restore.ctime = 0L;
-    restore.argv = NULL;
-    restore.fileName = "data string";
-    restore.numLines = 0;
-    restore.flags = flags;
-    restore.numCols = blt_table_num_columns(table);
-    restore.numRows = blt_table_num_rows(table);
-    Blt_InitHashTableWithPool(&restore.rowIndices, BLT_ONE_WORD_KEYS);
-    Blt_InitHashTableWithPool(&restore.colIndices, BLT_ONE_WORD_KEYS);
-    /* Read dump information */
-    result = TCL_ERROR;
-    for (;;) {
-        char c1, c2;
-
-        result = ParseDumpRecord(interp, &data, &restore);
-        if (result != TCL_OK) {
-            break;
-        }
-        if (restore.argc == 0) {
-            continue;
-        }
-        c1 = restore.argv[0][0], c2 = restore.argv[0][1];
-        if ((c1 == 'i') && (c2 == '\0')) {
-            result = RestoreHeader(interp, table, &restore);
-        } else if ((c1 == 'r') && (c2 == '\0')) {
-            result = RestoreRow(interp, table, &restore);
-        } else if ((c1 == 'c') && (c2 == '\0')) {
-            result = RestoreColumn(interp, table, &restore);
-        } else if ((c1 == 'd') && (c2 == '\0')) {
-            result = RestoreValue(interp, table, &restore);
+    BLT_TABLE_COLUMN_TYPE type;
+    Value cell;
+
+    memset(&cell, 0, sizeof(Value));
+    if (isInteger) {
+        if (colPtr->type == TABLE_COLUMN_TYPE_LONG) {
+            type = TABLE_COLUMN_TYPE_LONG;
+            cell.datum.l = (long)datumPtr->i64;
         } else {
-            Tcl_AppendResult(interp, restore.fileName, ":", 
-                Blt_Ltoa(restore.numLines), ": error: unknown entry \"", 
-                restore.argv[0], "\"", (char *)NULL);
-            result = TCL_ERROR;
-        }
-        Tcl_Free((char *)restore.argv);
-        if (result != TCL_OK) {
-            break;
+            type = TABLE_COLUMN_TYPE_INT64;
+            cell.datum.i64 = datumPtr->i64;
         }
+    } else {
+        type = (colPtr->type == TABLE_COLUMN_TYPE_TIME) ? 
+            TABLE_COLUMN_TYPE_TIME : TABLE_COLUMN_TYPE_DOUBLE;
+        cell.datum.d = datumPtr->d;
     }
-    Blt_DeleteHashTable(&restore.rowIndices);
-    Blt_DeleteHashTable(&restore.colIndices);
-    if (result == TCL_ERROR) {
+    if (PutNumber(interp, tablePtr, rowPtr, colPtr, type, &cell) != TCL_OK) {
         return TCL_ERROR;
     }
+    CallCellTraces(tablePtr, rowPtr, colPtr, TABLE_TRACE_WRITES);
     return TCL_OK;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_file_restore --
+ * blt_table_window --
  *
- *      Restores data to the given table based upon the dump file
- *      provided. The dump file should have been generated by
- *      blt_table_dump or blt_table_file_dump.
+ *      Computes a rolling window operation over the source column and
+ *      stores the results in the destination column.  The window of each
+ *      row is the row and the (size - 1) rows before it.  If size is 0,
+ *      the window is cumulative: it starts at the first row.  If there's
+ *      a group column, rows are only windowed with the rows of the same
+ *      group.  Empty values are skipped.  If a row's window has no values
+ *      (or fewer than two for standard deviations), the destination cell
+ *      is unset.
  *
- *      If the filename starts with an '@', then it is the name of an
- *      already opened channel to be used. Two bit flags may be set.
- *      
- *      TABLE_RESTORE_NO_TAGS   Don't restore tag information.
- *      TABLE_RESTORE_OVERWRITE Look for row and columns with 
- *                              the same label. Overwrite if necessary.
+ *      Sums of integer columns are integers, minimums and maximums have
+ *      the type of the column, and other results are doubles.  Values of
+ *      string columns are read as doubles.  If the TABLE_WINDOW_SET_TYPE
+ *      flag is set, the destination column is first set to the type of
+ *      the results.  The writes are made in a batch that records the
+ *      whole column, so traces on the destination column fire once.
  *
  * Results:
- *      A standard TCL result.  If the restore was successful, TCL_OK
- *      is returned.  Otherwise, TCL_ERROR is returned and an error
- *      message is left in the interpreter result.
- *
- * Side Effects:
- *      Row and columns are created in the table and may possibly
- *      generate trace or notifier event callbacks.
+ *      Returns a standard TCL result.  It's an error if a value of a
+ *      string column isn't a number.  In that case the destination column
+ *      is left unchanged.
  *
  *---------------------------------------------------------------------------
  */
 int
-blt_table_file_restore(Tcl_Interp *interp, BLT_TABLE table, 
-                       const char *fileName, unsigned int flags)
+blt_table_window(Tcl_Interp *interp, Table *tablePtr, Column *srcPtr,
+                 Column *destPtr, BLT_TABLE_WINDOW *winPtr)
 {
-    RestoreData restore;
-    Tcl_Channel channel;
-    int closeChannel;
+    Aggregator agg;
+    AggregateGroup **groups;
+    Windower win;
+    Row **rows, **order, *rowPtr;
+    long i, numRows;
+    int isIntegerResult;
     int result;
-
-    closeChannel = TRUE;
-    if ((fileName[0] == '@') && (fileName[1] != '\0')) {
-        int mode;
-        
-        channel = Tcl_GetChannel(interp, fileName+1, &mode);
-        if (channel == NULL) {
-            return TCL_ERROR;
+    unsigned int traceFlags;
+
+    numRows = tablePtr->corePtr->rows.numUsed;
+    rows = Blt_AssertMalloc((numRows + 1) * sizeof(Row *));
+    for (i = 0, rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL;
+         rowPtr = rowPtr->nextPtr, i++) {
+        rows[i] = rowPtr;
+    }
+    memset(&win, 0, sizeof(Windower));
+    win.winPtr = winPtr;
+    win.isInteger = IsIntegerColumn(srcPtr);
+    groups = NULL;
+    order = rows;
+    if (winPtr->groupColumn != NULL) {
+        Blt_ChainLink link;
+        long offset;
+
+        /* Order the rows by group, keeping the table order within each
+         * group.  The count of each group's rows becomes the next slot of
+         * the group in the order. */
+        InitAggregator(&agg, 1, (Column **)&winPtr->groupColumn, 0, NULL,
+                       NULL, rows, numRows);
+        groups = Blt_AssertMalloc((numRows + 1) * sizeof(AggregateGroup *));
+        for (i = 0; i < numRows; i++) {
+            groups[i] = GetAggregateGroup(&agg, rows[i]);
+            groups[i]->numRows++;
         }
-        if ((mode & TCL_READABLE) == 0) {
-            Tcl_AppendResult(interp, "channel \"", fileName, 
-                "\" not opened for reading", (char *)NULL);
-            return TCL_ERROR;
+        offset = 0;
+        for (link = Blt_Chain_FirstLink(agg.groups); link != NULL;
+             link = Blt_Chain_NextLink(link)) {
+            AggregateGroup *groupPtr;
+            long count;
+
+            groupPtr = Blt_Chain_GetValue(link);
+            count = groupPtr->numRows;
+            groupPtr->numRows = offset;
+            offset += count;
         }
-        closeChannel = FALSE;
-    } else {
-        channel = Tcl_OpenFileChannel(interp, fileName, "r", 0);
-        if (channel == NULL) {
-            return TCL_ERROR;   /* Can't open dump file. */
+        order = Blt_AssertMalloc((numRows + 1) * sizeof(Row *));
+        for (i = 0; i < numRows; i++) {
+            order[groups[i]->numRows++] = rows[i];
         }
+        /* Each group's count is now the end of its run of rows. */
     }
-    restore.argc = 0;
-    restore.mtime = restore.ctime = 0L;
-    restore.argv = NULL;
-    restore.fileName = fileName;
-    restore.numLines = 0;
-    restore.flags = flags;
-    restore.numCols = blt_table_num_columns(table);
-    restore.numRows = blt_table_num_rows(table);
-    Blt_InitHashTableWithPool(&restore.rowIndices, BLT_ONE_WORD_KEYS);
-    Blt_InitHashTableWithPool(&restore.colIndices, BLT_ONE_WORD_KEYS);
-
     result = TCL_ERROR;
-    /* Process dump information record by record. */
-    for (;;) {
-        char c1, c2;
-
-        result = ReadDumpRecord(interp, channel, &restore);
-        if (result != TCL_OK) {
-            break;
-        }
-        if (restore.argc == 0) {
+    win.values = Blt_AssertMalloc((numRows + 1) * sizeof(WindowDatum));
+    win.results = Blt_AssertMalloc((numRows + 1) * sizeof(WindowDatum));
+    win.isEmpty = Blt_AssertMalloc(numRows + 1);
+    win.hasResult = Blt_AssertMalloc(numRows + 1);
+    for (i = 0; i < numRows; i++) {
+        Value value;
+        unsigned int length;
+
+        rowPtr = order[i];
+        win.isEmpty[i] = IsEmpty(rowPtr, srcPtr);
+        if (win.isEmpty[i]) {
             continue;
         }
-        c1 = restore.argv[0][0], c2 = restore.argv[0][1];
-        if ((c1 == 'i') && (c2 == '\0')) {
-            result = RestoreHeader(interp, table, &restore);
-        } else if ((c1 == 'r') && (c2 == '\0')) {
-            result = RestoreRow(interp, table, &restore);
-        } else if ((c1 == 'c') && (c2 == '\0')) {
-            result = RestoreColumn(interp, table, &restore);
-        } else if ((c1 == 'd') && (c2 == '\0')) {
-            result = RestoreValue(interp, table, &restore);
-        } else {
-            Tcl_AppendResult(interp, fileName, ":", Blt_Ltoa(restore.numLines), 
-                ": error: unknown entry \"", restore.argv[0], "\"", 
-                (char *)NULL);
-            result = TCL_ERROR;
-        }
-        if (result != TCL_OK) {
-            Tcl_Free((char *)restore.argv); /* Allocated by Tcl_SplitList */
+        switch (srcPtr->type) {
+        case TABLE_COLUMN_TYPE_DOUBLE:
+        case TABLE_COLUMN_TYPE_TIME:
+            GetCellDatum(rowPtr, srcPtr, &value);
+            win.values[i].d = value.datum.d;
+            break;
+        case TABLE_COLUMN_TYPE_INT64:
+            GetCellDatum(rowPtr, srcPtr, &value);
+            win.values[i].i64 = value.datum.i64;
+            break;
+        case TABLE_COLUMN_TYPE_LONG:
+        case TABLE_COLUMN_TYPE_BOOLEAN:
+            GetCellDatum(rowPtr, srcPtr, &value);
+            win.values[i].i64 = value.datum.l;
+            break;
+        default:
+            if (Tcl_GetDouble((Tcl_Interp *)NULL, GetStoredString(rowPtr,
+                        srcPtr, &length), &win.values[i].d) != TCL_OK) {
+                if (interp != NULL) {
+                    Tcl_AppendResult(interp, "value \"", 
+                        GetStoredString(rowPtr, srcPtr, &length),
+                        "\" in row \"", rowPtr->label, "\" of column \"", 
+                        srcPtr->label, "\" is not a number", (char *)NULL);
+                }
+                goto error;
+            }
             break;
         }
-        Tcl_Free((char *)restore.argv); /* Allocated by Tcl_SplitList */
-    }
-    Blt_DeleteHashTable(&restore.rowIndices);
-    Blt_DeleteHashTable(&restore.colIndices);
-    if (closeChannel) {
-        Tcl_Close(interp, channel);
-    }
-    if (result == TCL_ERROR) {
-        return TCL_ERROR;
-    }
-    return TCL_OK;
-}
-
-static void
-FreePrimaryKeys(Table *tablePtr)
-{
-    int i;
-    
-    for (i = 0; i < tablePtr->numKeys; i++) {
-        Column *colPtr;
-        
-        colPtr = tablePtr->primaryKeys[i];
-        colPtr->flags &= ~TABLE_COLUMN_PRIMARY_KEY;
-    }
-    Blt_Free(tablePtr->primaryKeys);
-    tablePtr->primaryKeys = NULL;
-    tablePtr->numKeys = 0;
-}
-
-static void
-FreeKeyTables(Table *tablePtr)
-{
-    if (tablePtr->keyTables != NULL) {
-        int i;
-
-        for (i = 0; i < tablePtr->numKeys; i++) {
-            Blt_DeleteHashTable(tablePtr->keyTables + i);
-        }
-        Blt_Free(tablePtr->keyTables);
-        tablePtr->keyTables = NULL;
     }
-    if (tablePtr->masterKey != NULL) {
-        Blt_Free(tablePtr->masterKey);
-        Blt_DeleteHashTable(&tablePtr->masterKeyTable);
-        tablePtr->masterKey = NULL;
+    switch (winPtr->type) {
+    case TABLE_WINDOW_MIN:
+    case TABLE_WINDOW_MAX:
+        win.deque = Blt_AssertMalloc((numRows + 1) * sizeof(long));
+        break;
+    case TABLE_WINDOW_MEDIAN:
+        win.sorted = Blt_AssertMalloc((numRows + 1) * sizeof(WindowRank));
+        win.ranks = Blt_AssertMalloc((numRows + 1) * sizeof(long));
+        win.tree = Blt_AssertMalloc((numRows + 1) * sizeof(long));
+        break;
+    default:
+        break;
     }
-}
 
-void
-blt_table_unset_keys(Table *tablePtr)
-{
-    FreeKeyTables(tablePtr);
-    FreePrimaryKeys(tablePtr);
-    tablePtr->flags &= ~(TABLE_KEYS_DIRTY | TABLE_KEYS_UNIQUE);
-}
+    /* Compute each group's run of rows in one pass. */
+    if (groups != NULL) {
+        Blt_ChainLink link;
+        long first;
 
-int
-blt_table_get_keys(Table *tablePtr, BLT_TABLE_COLUMN **keysPtr)
-{
-    *keysPtr = tablePtr->primaryKeys;
-    return tablePtr->numKeys;
-}
+        first = 0;
+        for (link = Blt_Chain_FirstLink(agg.groups); link != NULL;
+             link = Blt_Chain_NextLink(link)) {
+            AggregateGroup *groupPtr;
 
-static int
-SameKeys(int len1, BLT_TABLE_COLUMN *keys1, int len2, BLT_TABLE_COLUMN *keys2)
-{
-    int i;
-    
-    if (len1 != len2) {
-        return FALSE;
+            groupPtr = Blt_Chain_GetValue(link);
+            WindowRun(&win, first, groupPtr->numRows);
+            first = groupPtr->numRows;
+        }
+    } else {
+        WindowRun(&win, 0, numRows);
     }
-    for (i = 0; i < len1; i++) {
-        if (keys1[i] != keys2[i]) {
-            fprintf(stderr, "different keys\n");
-            return FALSE;
+
+    if (winPtr->flags & TABLE_WINDOW_SET_TYPE) {
+        if (blt_table_set_column_type(interp, tablePtr, destPtr, 
+                GetWindowType(winPtr, srcPtr)) != TCL_OK) {
+            goto error;
         }
-    } 
-    return TRUE;
+    }
+    isIntegerResult = (win.isInteger) && 
+        ((winPtr->type == TABLE_WINDOW_SUM) ||
+         (winPtr->type == TABLE_WINDOW_MIN) ||
+         (winPtr->type == TABLE_WINDOW_MAX));
+    result = TCL_OK;
+    blt_table_begin_batch(tablePtr);
+    traceFlags = 0;
+    for (i = 0; i < numRows; i++) {
+        if (!win.hasResult[i]) {
+            if (!IsEmpty(order[i], destPtr)) {
+                CallCellTraces(tablePtr, order[i], destPtr, 
+                               TABLE_TRACE_UNSETS);
+                UnsetValue(tablePtr, order[i], destPtr);
+                traceFlags |= TABLE_TRACE_UNSETS;
+            }
+        } else if (StoreWindowResult(interp, tablePtr, order[i], destPtr,
+                        isIntegerResult, win.results + i) != TCL_OK) {
+            result = TCL_ERROR;
+            break;
+        } else {
+            traceFlags |= TABLE_TRACE_WRITES;
+        }
+    }
+    if (traceFlags != 0) {
+        RecordBatchColumn(tablePtr->corePtr->batchPtr, destPtr, traceFlags);
+    }
+    blt_table_end_batch(tablePtr);
+ error:
+    if (groups != NULL) {
+        FreeAggregator(&agg);
+        Blt_Free(groups);
+        Blt_Free(order);
+    }
+    Blt_Free(rows);
+    Blt_Free(win.values);
+    Blt_Free(win.results);
+    Blt_Free(win.isEmpty);
+    Blt_Free(win.hasResult);
+    if (win.deque != NULL) {
+        Blt_Free(win.deque);
+    }
+    if (win.sorted != NULL) {
+        Blt_Free(win.sorted);
+        Blt_Free(win.ranks);
+        Blt_Free(win.tree);
+    }
+    return result;
 }
 
-int
-blt_table_set_keys(Table *tablePtr, int numKeys, BLT_TABLE_COLUMN *keys,
-                   int unique)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * Joins --
+ *
+ *      blt_table_join adds the columns of matching rows from another
+ *      table.  Rows match if the values of their key columns are equal.
+ *      The rows of the smaller table are hashed by their keys, and the
+ *      rows of the larger table probe the hash table.  As with primary
+ *      keys, each key column has a table of its distinct values and rows
+ *      are hashed by the combination of the value entries.  Keys of
+ *      numeric columns are compared by their native values, so no strings
+ *      are generated.
+ *
+ *---------------------------------------------------------------------------
+ */
+typedef enum {
+    JOIN_KEY_DOUBLE,                    /* Compared as doubles. */
+    JOIN_KEY_INT64,                     /* Compared as integers. */
+    JOIN_KEY_STRING                     /* Compared as strings. */
+} JoinKeyType;
+
+typedef struct {
+    long left;                          /* Index of the row of the table. */
+    Row *srcRowPtr;                     /* Matching row of the source. */
+} JoinMatch;
+
+typedef struct {
+    long numKeys;
+    JoinKeyType *types;                 /* How each pair of key columns
+                                         * is compared. */
+    Blt_HashTable *valueTables;         /* Distinct values of each pair of
+                                         * key columns. */
+    Blt_HashTable masterTable;          /* Rows hashed by the combination
+                                         * of value entries. */
+    Blt_HashEntry **key;                /* Scratch master key. */
+} Joiner;
+
+static JoinKeyType
+GetJoinKeyType(Column *colPtr1, Column *colPtr2)
 {
-    int i;
-    
-    if (SameKeys(tablePtr->numKeys, tablePtr->primaryKeys, numKeys, keys)) {
-        return TCL_OK;
-    }
-    if (tablePtr->primaryKeys != NULL) {
-        FreePrimaryKeys(tablePtr);
+    if ((!IsDenseColumn(colPtr1)) || (!IsDenseColumn(colPtr2))) {
+        return JOIN_KEY_STRING;
     }
-    tablePtr->primaryKeys = keys;
-    tablePtr->numKeys = numKeys;
-    
-    /* Mark the designated columns as primary keys.  This flag is used to
-     * check if a primary column is deleted, it's rows are added or
-     * changed, or it's values set or unset.  The generated keytables are
-     * invalid and need to be regenerated. */
-    for (i = 0; i < numKeys; i++) {
-        Column *colPtr;
-        
-        colPtr = keys[i];
-        colPtr->flags |= TABLE_COLUMN_PRIMARY_KEY;
-    }
-    tablePtr->flags |= TABLE_KEYS_DIRTY;
-    if (unique) {
-        tablePtr->flags |= TABLE_KEYS_UNIQUE;
+    if ((IsIntegerColumn(colPtr1)) && (IsIntegerColumn(colPtr2))) {
+        return JOIN_KEY_INT64;
     }
-    return TCL_OK;
+    return JOIN_KEY_DOUBLE;
 }
 
-static int
-MakeKeyTables(Tcl_Interp *interp, Table *tablePtr)
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetJoinEntry --
+ *
+ *      Returns the entry of the row's keys in the master table.  If
+ *      create is set, the entries are created if they don't already exist.
+ *      Otherwise NULL is returned if there isn't an entry.  Rows with an
+ *      empty key value have no entry.
+ *
+ *---------------------------------------------------------------------------
+ */
+static Blt_HashEntry *
+GetJoinEntry(Joiner *joinPtr, Table *tablePtr, Row *rowPtr, Column **keys,
+             int create)
 {
-    Row *rowPtr;
-    int i;
-    size_t masterKeySize;
-
-    FreeKeyTables(tablePtr);
-    tablePtr->flags &= ~TABLE_KEYS_DIRTY;
+    long i;
+    int isNew;
 
-    /* Create a hashtable for each key. */
-    tablePtr->keyTables =
-        Blt_Malloc(sizeof(Blt_HashTable) * tablePtr->numKeys);
-    if (tablePtr->keyTables == NULL) {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "can't allocated keytables for ",
-                Blt_Itoa(tablePtr->numKeys), " keys.", (char *)NULL);
-        }
-        return TCL_ERROR;
-    }
-    for (i = 0; i < tablePtr->numKeys; i++) {
-        size_t size;
+    for (i = 0; i < joinPtr->numKeys; i++) {
         Column *colPtr;
+        Value value;
+        const void *key;
+        unsigned int length;
 
-        colPtr = tablePtr->primaryKeys[i];
-        switch (colPtr->type) {
-        case TABLE_COLUMN_TYPE_DOUBLE:
-        case TABLE_COLUMN_TYPE_TIME:
-            size = sizeof(double)/sizeof(int);
+        colPtr = keys[i];
+        if (IsEmpty(rowPtr, colPtr)) {
+            return NULL;
+        }
+        switch (joinPtr->types[i]) {
+        case JOIN_KEY_DOUBLE:
+            GetCellDatum(rowPtr, colPtr, &value);
+            if (colPtr->type == TABLE_COLUMN_TYPE_INT64) {
+                value.datum.d = (double)value.datum.i64;
+            } else if (IsIntegerColumn(colPtr)) {
+                value.datum.d = (double)value.datum.l;
+            }
+            if (value.datum.d == 0.0) {
+                value.datum.d = 0.0;    /* Don't separate -0.0 and 0.0. */
+            }
+            key = &value.datum.d;
             break;
-        case TABLE_COLUMN_TYPE_BOOLEAN:
-        case TABLE_COLUMN_TYPE_LONG:
-            size = BLT_ONE_WORD_KEYS;
+        case JOIN_KEY_INT64:
+            GetCellDatum(rowPtr, colPtr, &value);
+            if (colPtr->type != TABLE_COLUMN_TYPE_INT64) {
+                value.datum.i64 = value.datum.l;
+            }
+            key = &value.datum.i64;
             break;
+        case JOIN_KEY_STRING:
         default:
-        case TABLE_COLUMN_TYPE_STRING:
-            size = BLT_STRING_KEYS;
+            key = GetCellString(tablePtr, rowPtr, colPtr, &length);
             break;
         }
-        Blt_InitHashTable(tablePtr->keyTables + i, size);
+        if (create) {
+            joinPtr->key[i] = Blt_CreateHashEntry(joinPtr->valueTables + i,
+                                                  key, &isNew);
+        } else {
+            joinPtr->key[i] = Blt_FindHashEntry(joinPtr->valueTables + i,
+                                                key);
+            if (joinPtr->key[i] == NULL) {
+                return NULL;
+            }
+        }
     }
-    /* Generate a master table of key tuple combinations for each row.  
-     * We uniquely identify the key by its row in the column. The combination
-     * of these keys (in the exact order) is how we find the row. */
-    masterKeySize = sizeof(BLT_TABLE_ROW) * tablePtr->numKeys;
-    tablePtr->masterKey = Blt_AssertMalloc(masterKeySize);
-    Blt_InitHashTable(&tablePtr->masterKeyTable, masterKeySize / sizeof(int));
+    if (create) {
+        return Blt_CreateHashEntry(&joinPtr->masterTable, joinPtr->key,
+                                   &isNew);
+    }
+    return Blt_FindHashEntry(&joinPtr->masterTable, joinPtr->key);
+}
 
-    /* For each row, create hash entries for the individual key columns,
-     * but also for the combined keys for the row.  The hash of the
-     * combined keys must be unique. */
-    for (rowPtr = (Row *)tablePtr->corePtr->rows.headPtr; rowPtr != NULL; 
-         rowPtr = rowPtr->nextPtr) {
-        int j;
+static Row **
+GetAllRows(Table *tablePtr)
+{
+    Row **rows, *rowPtr;
+    long i;
 
-        for (j = 0; j < tablePtr->numKeys; j++) {
-            Blt_HashTable *keyTablePtr;
-            Column *colPtr;
-            int isNew;
-            Blt_HashEntry *hPtr;
-            Value *valuePtr;
-            
-            colPtr = tablePtr->primaryKeys[j];
-            if (IsEmpty(rowPtr, colPtr)) {
-                break;                  /* Skip this row since one of the
-                                         * key values is empty. */
-            }
-            keyTablePtr = tablePtr->keyTables + j;
-            valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-            switch (colPtr->type) {
-            case TABLE_COLUMN_TYPE_DOUBLE:
-            case TABLE_COLUMN_TYPE_TIME:
-                hPtr = Blt_CreateHashEntry(keyTablePtr, &valuePtr->datum.d,
-                                           &isNew);
-                break;
-            case TABLE_COLUMN_TYPE_BOOLEAN:
-            case TABLE_COLUMN_TYPE_LONG:
-                hPtr = Blt_CreateHashEntry(keyTablePtr,
-                                           (intptr_t)valuePtr->datum.l, &isNew);
-                break;
-            case TABLE_COLUMN_TYPE_STRING:
-            default:
-                hPtr = Blt_CreateHashEntry(keyTablePtr,
-                                           GetValueString(valuePtr), &isNew);
-                break;
+    rows = Blt_AssertMalloc((tablePtr->corePtr->rows.numUsed + 1) *
+                            sizeof(Row *));
+    for (i = 0, rowPtr = tablePtr->corePtr->rows.headPtr; rowPtr != NULL;
+         rowPtr = rowPtr->nextPtr, i++) {
+        rows[i] = rowPtr;
+    }
+    return rows;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CopyCell --
+ *
+ *      Copies the value of a cell into an empty cell of a column of the
+ *      same type.  The cells can be in different tables.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+CopyCell(Table *tablePtr, Row *rowPtr, Column *colPtr, Row *srcRowPtr,
+         Column *srcColPtr)
+{
+    Value value;
+
+    if (IsEmpty(srcRowPtr, srcColPtr)) {
+        return TCL_OK;
+    }
+    if (colPtr->sharePtr != NULL) {
+        UnshareColumn(tablePtr->corePtr, colPtr);
+    }
+    memset(&value, 0, sizeof(Value));
+    if (IsDenseColumn(srcColPtr)) {
+        long offset;
+
+        offset = srcRowPtr->offset;
+        GetDenseDatum(srcColPtr, offset, &value);
+        if ((srcColPtr->strings != NULL) &&
+            (srcColPtr->strings[offset] != NULL)) {
+            value.string = Blt_AssertStrdup(srcColPtr->strings[offset]);
+        }
+        if (((colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) == 0) && 
+            (colPtr->indexPtr == NULL) && (colPtr->statsPtr == NULL)) {
+            /* Store the datum directly.  The string is already known to
+             * be a valid representation, so it isn't compared with a
+             * generated one. */
+            if ((colPtr->data == NULL) && 
+                (!AllocDenseStorage(tablePtr, colPtr))) {
+                ResetValue(&value);
+                return TCL_ERROR;
             }
-            if (isNew) {
-                Blt_SetHashValue(hPtr, rowPtr);
+            offset = rowPtr->offset;
+            SetDenseDatum(colPtr, offset, &value);
+            DenseSet(colPtr, offset);
+            if (value.string != NULL) {
+                if (colPtr->strings == NULL) {
+                    colPtr->strings = Blt_AssertCalloc(
+                        tablePtr->corePtr->rows.numAllocated, sizeof(char *));
+                }
+                colPtr->strings[offset] = (char *)value.string;
             }
-            tablePtr->masterKey[j] = Blt_GetHashValue(hPtr);
+            goto done;
         }
-        if (j == tablePtr->numKeys) {
-            Blt_HashEntry *hPtr;
-            int isNew;
+    } else if (srcColPtr->dictPtr != NULL) {
+        const char *string;
+        unsigned int length;
 
-            /* If we created all the hashkeys necessary for this row, then
-             * generate an entry for the row in the master key table. */
-            hPtr = Blt_CreateHashEntry(&tablePtr->masterKeyTable, 
-                tablePtr->masterKey, &isNew);
-            if (isNew) {
-                Blt_SetHashValue(hPtr, rowPtr);
-            } else if (tablePtr->flags & TABLE_KEYS_UNIQUE) {
-                if (interp != NULL) {
-                    BLT_TABLE_ROW dupRow;
-        
-                    dupRow = Blt_GetHashValue(hPtr);
-                    Tcl_AppendResult(interp, "primary keys are not unique:",
-                        "rows \"", blt_table_row_label(dupRow), "\" and \"",
-                        blt_table_row_label(rowPtr), 
-                        "\" have the same keys.", (char *)NULL);
-                }
-                blt_table_unset_keys(tablePtr);
-                return TCL_ERROR;       /* Bail out. Keys aren't unique. */
-            }
+        string = GetStoredString(srcRowPtr, srcColPtr, &length);
+        SetValueFromString(NULL, NULL, TABLE_COLUMN_TYPE_STRING, string, length,
+                           &value);
+    } else {
+        Value *valuePtr;
+
+        valuePtr = srcColPtr->vector + srcRowPtr->offset;
+        value = *valuePtr;
+        if (valuePtr->string != TABLE_VALUE_STORE) {
+            char *string;
+
+            string = Blt_AssertMalloc(valuePtr->length + 1);
+            memcpy(string, valuePtr->string, valuePtr->length);
+            string[valuePtr->length] = '\0';
+            value.string = string;
         }
     }
-    tablePtr->flags &= ~TABLE_KEYS_UNIQUE;
+    if (PutValue(tablePtr->interp, tablePtr, rowPtr, colPtr, &value) 
+        != TCL_OK) {
+        return TCL_ERROR;
+    }
+ done:
+    CallTraces(tablePtr, rowPtr, colPtr,
+               TABLE_TRACE_WRITES | TABLE_TRACE_CREATES);
     return TCL_OK;
 }
-            
+
 /*
  *---------------------------------------------------------------------------
  *
- * blt_table_key_lookup --
+ * blt_table_join --
  *
- *      Look up the (hopefully) unique row that matches all the values
- *      for each of the key columns.  
+ *      Joins the rows of the source table to the rows of the table whose
+ *      key column values are equal.  For each source column given, a new
+ *      column (with the same label and type) is appended to the table
+ *      and filled with the values from the matching source rows.  If a
+ *      row matches more than one source row, a copy of the row is
+ *      appended to the table for each extra match.  Rows without a match
+ *      are left with empty values, or with TABLE_JOIN_INNER, deleted.
+ *      Empty key values never match.  It's an error if the label of a
+ *      source column is already used by the table or by another source
+ *      column.
+ *
+ *      Integer and double key columns are compared numerically, otherwise
+ *      keys are compared as strings.
  *
  * Results:
- *      Returns a standard TCL result.  *rowPtrPtr will return the 
- *      pointer to the found row.  NULL is the row wasn't found.
+ *      Returns a standard TCL result.
  *
  *---------------------------------------------------------------------------
  */
 int
-blt_table_key_lookup(Tcl_Interp *interp, Table *tablePtr, int objc, 
-                     Tcl_Obj *const *objv, Row **rowPtrPtr)
+blt_table_join(Tcl_Interp *interp, Table *tablePtr, Table *srcPtr,
+               long numKeys, Column **keys, Column **srcKeys,
+               long numColumns, Column **srcColumns, unsigned int flags)
 {
-    int i;
-    Blt_HashEntry *hPtr;
-    
-    *rowPtrPtr = NULL;
-    if (objc != tablePtr->numKeys) {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "wrong # of values: should be ",
-                Blt_Itoa(tablePtr->numKeys), " value(s) of ", (char *)NULL);
-            for (i = 0; i < tablePtr->numKeys; i++) {
-                BLT_TABLE_COLUMN col;
+    Joiner joiner;
+    JoinMatch *matches;
+    Row **rows, **srcRows, **buildRows, **probeRows, **newRows;
+    Column **buildKeys, **probeKeys, **oldColumns, **newColumns, *colPtr;
+    Table *buildPtr, *probePtr;
+    long *next, *tail, *counts;
+    long i, numRows, numSrcRows, numBuild, numProbe, numMatches, numAllocated;
+    long numOldColumns, numMatched, numNew, m;
+    size_t keySize;
+    int result;
 
-                col = tablePtr->primaryKeys[i];
-                Tcl_AppendResult(interp, blt_table_column_label(col), " ", 
-                                 (char *)NULL);
+    /* Don't create columns with duplicate labels. */
+    for (i = 0; i < numColumns; i++) {
+        const char *label;
+        long j;
+
+        label = srcColumns[i]->label;
+        for (j = 0; j < i; j++) {
+            if (strcmp(srcColumns[j]->label, label) == 0) {
+                break;
+            }
+        }
+        if ((j < i) || (blt_table_get_column_by_label(tablePtr, label) 
+                        != NULL)) {
+            if (interp != NULL) {
+                Tcl_AppendResult(interp, "can't join column \"", label, 
+                        "\": label already exists in \"", 
+                        blt_table_name(tablePtr), "\"", (char *)NULL);
             }
+            return TCL_ERROR;
+        }
+    }
+    numRows = tablePtr->corePtr->rows.numUsed;
+    numSrcRows = srcPtr->corePtr->rows.numUsed;
+    rows = GetAllRows(tablePtr);
+    srcRows = GetAllRows(srcPtr);
+    numOldColumns = tablePtr->corePtr->columns.numUsed;
+    oldColumns = Blt_AssertMalloc((numOldColumns + 1) * sizeof(Column *));
+    for (i = 0, colPtr = tablePtr->corePtr->columns.headPtr; colPtr != NULL;
+         colPtr = colPtr->nextPtr, i++) {
+        oldColumns[i] = colPtr;
+    }
+
+    joiner.numKeys = numKeys;
+    joiner.types = Blt_AssertMalloc((numKeys + 1) * sizeof(JoinKeyType));
+    joiner.valueTables = Blt_AssertMalloc((numKeys + 1) *
+                                          sizeof(Blt_HashTable));
+    for (i = 0; i < numKeys; i++) {
+        size_t size;
+
+        joiner.types[i] = GetJoinKeyType(keys[i], srcKeys[i]);
+        switch (joiner.types[i]) {
+        case JOIN_KEY_DOUBLE:
+            size = sizeof(double) / sizeof(int);
+            break;
+        case JOIN_KEY_INT64:
+            size = sizeof(int64_t) / sizeof(int);
+            break;
+        case JOIN_KEY_STRING:
+        default:
+            size = BLT_STRING_KEYS;
+            break;
         }
-        return TCL_ERROR;               /* Wrong # of keys supplied. */
-    }
-    if (tablePtr->numKeys == 0) {
-        if (interp != NULL) {
-            Tcl_AppendResult(interp, "no primary keys designated",
-                         (char *)NULL);
+        Blt_InitHashTable(joiner.valueTables + i, size);
+    }
+    keySize = sizeof(Blt_HashEntry *) * numKeys;
+    joiner.key = Blt_AssertMalloc(keySize);
+    Blt_InitHashTable(&joiner.masterTable, keySize / sizeof(int));
+
+    /* Hash the smaller table. */
+    if (numRows < numSrcRows) {
+        buildPtr = tablePtr, buildRows = rows, buildKeys = keys;
+        numBuild = numRows;
+        probePtr = srcPtr, probeRows = srcRows, probeKeys = srcKeys;
+        numProbe = numSrcRows;
+    } else {
+        buildPtr = srcPtr, buildRows = srcRows, buildKeys = srcKeys;
+        numBuild = numSrcRows;
+        probePtr = tablePtr, probeRows = rows, probeKeys = keys;
+        numProbe = numRows;
+    }
+    /* Rows with the same keys are linked in order. */
+    next = Blt_AssertMalloc((numBuild + 1) * sizeof(long));
+    tail = Blt_AssertMalloc((numBuild + 1) * sizeof(long));
+    for (i = 0; i < numBuild; i++) {
+        Blt_HashEntry *hPtr;
+
+        next[i] = -1;
+        hPtr = GetJoinEntry(&joiner, buildPtr, buildRows[i], buildKeys, TRUE);
+        if (hPtr == NULL) {
+            continue;
         }
-        return TCL_ERROR;
-    }
-    if (tablePtr->flags & TABLE_KEYS_DIRTY) {
-        if (MakeKeyTables(interp, tablePtr) != TCL_OK) {
-            return TCL_ERROR;
+        if (Blt_GetHashValue(hPtr) == NULL) {
+            Blt_SetHashValue(hPtr, (intptr_t)(i + 1));
+            tail[i] = i;
+        } else {
+            long first;
+
+            first = (intptr_t)Blt_GetHashValue(hPtr) - 1;
+            next[tail[first]] = i;
+            tail[first] = i;
         }
     }
-    /* Create a master search key by getting the rows from the individual
-     * key hash tables for each key.  Use this key to search the master
-     * table. */
-    for (i = 0; i < tablePtr->numKeys; i++) {
-        Blt_HashTable *keyTablePtr;
-        Column *colPtr;
+
+    /* Probe with the rows of the larger table.  Collect the matches for
+     * each row of the table. */
+    counts = Blt_AssertCalloc(numRows + 1, sizeof(long));
+    numAllocated = 64;
+    matches = Blt_AssertMalloc(numAllocated * sizeof(JoinMatch));
+    numMatches = 0;
+    for (i = 0; i < numProbe; i++) {
         Blt_HashEntry *hPtr;
+        long j;
 
-        colPtr = tablePtr->primaryKeys[i];
-        keyTablePtr = tablePtr->keyTables + i;
-        switch (colPtr->type) {
-        case TABLE_COLUMN_TYPE_DOUBLE:
-        case TABLE_COLUMN_TYPE_TIME:
-            {
-                double dval;
+        hPtr = GetJoinEntry(&joiner, probePtr, probeRows[i], probeKeys, FALSE);
+        if (hPtr == NULL) {
+            continue;
+        }
+        for (j = (intptr_t)Blt_GetHashValue(hPtr) - 1; j >= 0; j = next[j]) {
+            JoinMatch *matchPtr;
 
-                if (Blt_GetDoubleFromObj(interp, objv[i], &dval) != TCL_OK) {
-                    return TCL_ERROR;
-                }
-                hPtr = Blt_FindHashEntry(keyTablePtr, &dval);
+            if (numMatches == numAllocated) {
+                numAllocated += numAllocated;
+                matches = Blt_AssertRealloc(matches,
+                        numAllocated * sizeof(JoinMatch));
             }
-            break;
-        case TABLE_COLUMN_TYPE_BOOLEAN:
-            {
-                int ival;
-                
-                if (Tcl_GetBooleanFromObj(interp, objv[i], &ival) != TCL_OK) {
-                    return TCL_ERROR;
-                }
-                hPtr = Blt_FindHashEntry(keyTablePtr, (intptr_t)ival);
+            matchPtr = matches + numMatches;
+            if (buildPtr == tablePtr) {
+                matchPtr->left = j;
+                matchPtr->srcRowPtr = srcRows[i];
+            } else {
+                matchPtr->left = i;
+                matchPtr->srcRowPtr = srcRows[j];
             }
-            break;
-        case TABLE_COLUMN_TYPE_LONG:
-            {
-                long lval;
+            counts[matchPtr->left]++;
+            numMatches++;
+        }
+    }
+    Blt_Free(next);
+    Blt_Free(tail);
+    Blt_DeleteHashTable(&joiner.masterTable);
+    for (i = 0; i < numKeys; i++) {
+        Blt_DeleteHashTable(joiner.valueTables + i);
+    }
+    Blt_Free(joiner.valueTables);
+    Blt_Free(joiner.types);
+    Blt_Free(joiner.key);
+
+    if (buildPtr == tablePtr) {
+        JoinMatch *sorted;
+        long *starts, sum;
+
+        /* Matches were found in source order.  Reorder them by the rows
+         * of the table, keeping the source order for each row. */
+        starts = Blt_AssertMalloc((numRows + 1) * sizeof(long));
+        for (i = 0, sum = 0; i < numRows; i++) {
+            starts[i] = sum;
+            sum += counts[i];
+        }
+        sorted = Blt_AssertMalloc((numMatches + 1) * sizeof(JoinMatch));
+        for (i = 0; i < numMatches; i++) {
+            sorted[starts[matches[i].left]++] = matches[i];
+        }
+        Blt_Free(starts);
+        Blt_Free(matches);
+        matches = sorted;
+    }
 
-                if (Blt_GetLongFromObj(interp, objv[i], &lval) != TCL_OK) {
-                    return TCL_ERROR;
+    /* Add the new columns and a row for each extra match. */
+    result = TCL_ERROR;
+    newRows = NULL;
+    newColumns = Blt_AssertMalloc((numColumns + 1) * sizeof(Column *));
+    for (i = 0; i < numColumns; i++) {
+        newColumns[i] = blt_table_create_column(interp, tablePtr,
+                                                srcColumns[i]->label);
+        if ((newColumns[i] == NULL) ||
+            (blt_table_set_column_type(interp, tablePtr, newColumns[i],
+                                       srcColumns[i]->type) != TCL_OK)) {
+            goto error;
+        }
+    }
+    numMatched = 0;
+    for (i = 0; i < numRows; i++) {
+        if (counts[i] > 0) {
+            numMatched++;
+        }
+    }
+    newRows = Blt_AssertMalloc((numMatches - numMatched + 1) * sizeof(Row *));
+    if (blt_table_extend_rows(interp, tablePtr, numMatches - numMatched,
+                              newRows) != TCL_OK) {
+        goto error;
+    }
+    m = numNew = 0;
+    for (i = 0; i < numRows; i++) {
+        long j;
+
+        for (j = 0; j < counts[i]; j++, m++) {
+            Row *rowPtr;
+            long k;
+
+            rowPtr = rows[i];
+            if (j > 0) {
+                /* Extra matches go into copies of the row. */
+                rowPtr = newRows[numNew];
+                numNew++;
+                for (k = 0; k < numOldColumns; k++) {
+                    if (CopyCell(tablePtr, rowPtr, oldColumns[k], rows[i],
+                                 oldColumns[k]) != TCL_OK) {
+                        goto error;
+                    }
                 }
-                hPtr = Blt_FindHashEntry(keyTablePtr, (intptr_t)lval);
             }
-            break;
-        default:
-        case TABLE_COLUMN_TYPE_STRING:
-            {
-                const char *string;
-
-                string = Tcl_GetString(objv[i]);
-                hPtr = Blt_FindHashEntry(keyTablePtr, string);
+            for (k = 0; k < numColumns; k++) {
+                if (CopyCell(tablePtr, rowPtr, newColumns[k],
+                             matches[m].srcRowPtr, srcColumns[k]) != TCL_OK) {
+                    goto error;
+                }
             }
-            break;
-        }
-        if (hPtr == NULL) {
-            return TCL_OK;              /* Can't find one of the keys, so
-                                         * the whole search fails. */
         }
-        tablePtr->masterKey[i] = Blt_GetHashValue(hPtr);
     }
-    hPtr = Blt_FindHashEntry(&tablePtr->masterKeyTable, tablePtr->masterKey);
-    if (hPtr == NULL) {
-        Blt_Warn("can't find master key\n");
-        return TCL_OK;
+    if (flags & TABLE_JOIN_INNER) {
+        for (i = 0; i < numRows; i++) {
+            if (counts[i] == 0) {
+                blt_table_delete_row(tablePtr, rows[i]);
+            }
+        }
     }
-    *rowPtrPtr = Blt_GetHashValue(hPtr);
-    return TCL_OK;
+    result = TCL_OK;
+ error:
+    if (newRows != NULL) {
+        Blt_Free(newRows);
+    }
+    Blt_Free(newColumns);
+    Blt_Free(matches);
+    Blt_Free(counts);
+    Blt_Free(oldColumns);
+    Blt_Free(srcRows);
+    Blt_Free(rows);
+    return result;
 }
 
 /*
@@ -6558,8 +15751,7 @@ int
 blt_table_set_long(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
                    Column *colPtr, long value)
 {
-    Value *valuePtr;
-    char string[200];
+    Value cell;
 
     if ((colPtr->type != TABLE_COLUMN_TYPE_LONG) &&
         (colPtr->type != TABLE_COLUMN_TYPE_STRING)) {
@@ -6570,19 +15762,11 @@ blt_table_set_long(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
         }
         return TCL_ERROR;
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    ResetValue(valuePtr);
-    valuePtr->datum.l = value;
-    valuePtr->length = sprintf(string, "%ld", value);
-    if (strlen(string) >= TABLE_VALUE_LENGTH) {
-        valuePtr->string = Blt_AssertStrdup(string);
-    } else {
-        strcpy(valuePtr->store, string);
-        valuePtr->string = TABLE_VALUE_STORE;
-    }
-    /* Indicate the keytables need to be regenerated. */
-    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
-        tablePtr->flags |= TABLE_KEYS_DIRTY;
+    memset(&cell, 0, sizeof(Value));
+    cell.datum.l = value;
+    if (PutNumber(interp, tablePtr, rowPtr, colPtr, TABLE_COLUMN_TYPE_LONG,
+                  &cell) != TCL_OK) {
+        return TCL_ERROR;
     }
     return TCL_OK;
 }
@@ -6609,8 +15793,7 @@ int
 blt_table_set_boolean(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
                       Column *colPtr, int value)
 {
-    Value *valuePtr;
-    char string[200];
+    Value cell;
 
     if ((colPtr->type != TABLE_COLUMN_TYPE_BOOLEAN) &&
         (colPtr->type != TABLE_COLUMN_TYPE_STRING)) {
@@ -6621,19 +15804,11 @@ blt_table_set_boolean(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
         }
         return TCL_ERROR;
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    ResetValue(valuePtr);
-    valuePtr->datum.l = (long)value;
-    valuePtr->length = sprintf(string, "%d", value);
-    if (strlen(string) >= TABLE_VALUE_LENGTH) {
-        valuePtr->string = Blt_AssertStrdup(string);
-    } else {
-        strcpy(valuePtr->store, string);
-        valuePtr->string = valuePtr->store;
-    }
-    /* Indicate the keytables need to be regenerated. */
-    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
-        tablePtr->flags |= TABLE_KEYS_DIRTY;
+    memset(&cell, 0, sizeof(Value));
+    cell.datum.l = value;
+    if (PutNumber(interp, tablePtr, rowPtr, colPtr, 
+                  TABLE_COLUMN_TYPE_BOOLEAN, &cell) != TCL_OK) {
+        return TCL_ERROR;
     }
     return TCL_OK;
 }
@@ -6660,8 +15835,7 @@ int
 blt_table_set_int64(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
                    Column *colPtr, int64_t value)
 {
-    Value *valuePtr;
-    char string[200];
+    Value cell;
 
     if ((colPtr->type != TABLE_COLUMN_TYPE_INT64) &&
         (colPtr->type != TABLE_COLUMN_TYPE_STRING)) {
@@ -6672,19 +15846,11 @@ blt_table_set_int64(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
         }
         return TCL_ERROR;
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    ResetValue(valuePtr);
-    valuePtr->datum.i64 = value;
-    valuePtr->length = sprintf(string, "%" PRId64, value);
-    if (strlen(string) >= TABLE_VALUE_LENGTH) {
-        valuePtr->string = Blt_AssertStrdup(string);
-    } else {
-        strcpy(valuePtr->store, string);
-        valuePtr->string = TABLE_VALUE_STORE;
-    }
-    /* Indicate the keytables need to be regenerated. */
-    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
-        tablePtr->flags |= TABLE_KEYS_DIRTY;
+    memset(&cell, 0, sizeof(Value));
+    cell.datum.i64 = value;
+    if (PutNumber(interp, tablePtr, rowPtr, colPtr, TABLE_COLUMN_TYPE_INT64,
+                  &cell) != TCL_OK) {
+        return TCL_ERROR;
     }
     return TCL_OK;
 }
@@ -6709,18 +15875,14 @@ int
 blt_table_set_string_rep(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
                          Column *colPtr, const char *string, int length)
 {
-    Value *valuePtr;
+    Value value;
 
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    ResetValue(valuePtr);
-    if (SetValueFromString(interp, colPtr->type, string, length, valuePtr)
-        != TCL_OK) {
+    memset(&value, 0, sizeof(Value));
+    if ((SetValueFromString(interp, colPtr, colPtr->type, string, length, 
+                            &value) != TCL_OK) || 
+        (PutValue(interp, tablePtr, rowPtr, colPtr, &value) != TCL_OK)) {
         return TCL_ERROR;
     }
-    /* Indicate the keytables need to be regenerated. */
-    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
-        tablePtr->flags |= TABLE_KEYS_DIRTY;
-    }
     return TCL_OK;
 }
 
@@ -6780,73 +15942,27 @@ int
 blt_table_append_string(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr, 
                        Column *colPtr, const char *s, int length)
 {
-    Value *valuePtr;
-    long l;
-    double d;
+    Value value;
     Tcl_Obj *objPtr;
+    int result;
 
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    if (IsEmptyValue(valuePtr)) {
+    if (IsEmpty(rowPtr, colPtr)) {
         objPtr = Tcl_NewStringObj(s, length);
     } else {
-        objPtr = Tcl_NewStringObj(GetValueString(valuePtr),
-                                  GetValueLength(valuePtr));
+        const char *string;
+        unsigned int oldLength;
+
+        string = GetCellString(tablePtr, rowPtr, colPtr, &oldLength);
+        objPtr = Tcl_NewStringObj(string, oldLength);
         Tcl_AppendToObj(objPtr, s, length);
     }
     Tcl_IncrRefCount(objPtr);
-    switch (colPtr->type) {
-    case TABLE_COLUMN_TYPE_TIME:        /* Time: is a double */
-        if (Blt_GetTimeFromObj(interp, objPtr, &d) != TCL_OK) {
-            Tcl_DecrRefCount(objPtr);
-            return TCL_ERROR;
-        }
-        valuePtr->datum.d = d;
-        break;
-
-    case TABLE_COLUMN_TYPE_DOUBLE:      /* double */
-        if (Blt_GetDoubleFromObj(interp, objPtr, &d) != TCL_OK) {
-            Tcl_DecrRefCount(objPtr);
-            return TCL_ERROR;
-        }
-        valuePtr->datum.d = d;
-        break;
-    case TABLE_COLUMN_TYPE_BOOLEAN:      /* boolean */
-        {
-            int ival;
-            
-            if (Tcl_GetBooleanFromObj(interp, objPtr, &ival) != TCL_OK) {
-                Tcl_DecrRefCount(objPtr);
-                return TCL_ERROR;
-            }
-            valuePtr->datum.l = ival;
-        }
-        break;
-    case TABLE_COLUMN_TYPE_LONG:        /* long */
-        if (Blt_GetLongFromObj(interp, objPtr, &l) != TCL_OK) {
-            Tcl_DecrRefCount(objPtr);
-            return TCL_ERROR;
-        }
-        valuePtr->datum.l = l;
-        break;
-    default:                            /* string. */
-        break;
-    }
-    s = Tcl_GetStringFromObj(objPtr, &length);
-    ResetValue(valuePtr);
-    if (length >= TABLE_VALUE_LENGTH) {
-        valuePtr->string = Blt_Strndup(s, length + 1);
-        valuePtr->length = length;
-    } else {
-        strncpy(valuePtr->store, s, length);
-        valuePtr->store[length] = '\0';
-        valuePtr->string = TABLE_VALUE_STORE;
-        valuePtr->length = length;
-    }
+    memset(&value, 0, sizeof(Value));
+    result = SetValueFromObj(interp, colPtr, colPtr->type, objPtr, &value);
     Tcl_DecrRefCount(objPtr);
-
-    /* Indicate the keytables need to be regenerated. */
-    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
-        tablePtr->flags |= TABLE_KEYS_DIRTY;
+    if ((result != TCL_OK) || 
+        (PutValue(interp, tablePtr, rowPtr, colPtr, &value) != TCL_OK)) {
+        return TCL_ERROR;
     }
     return TCL_OK;
 }
@@ -6870,8 +15986,6 @@ int
 blt_table_set_double(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
                      Column *colPtr, double value)
 {
-    Value *valuePtr;
-
     if ((colPtr->type != TABLE_COLUMN_TYPE_DOUBLE) &&
         (colPtr->type != TABLE_COLUMN_TYPE_STRING) &&
         (colPtr->type != TABLE_COLUMN_TYPE_TIME)) {
@@ -6881,24 +15995,18 @@ blt_table_set_double(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
         }
         return TCL_ERROR;
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    ResetValue(valuePtr);
-    if (!isnan(value)) {
-        char string[200];
+    if (isnan(value)) {
+        UnsetValue(tablePtr, rowPtr, colPtr);
+    } else {
+        Value cell;
 
-        valuePtr->datum.d = value;
-        valuePtr->length = sprintf(string, "%.17g", value);
-        if (strlen(string) >= TABLE_VALUE_LENGTH) {
-            valuePtr->string = Blt_AssertStrdup(string);
-        } else {
-            strcpy(valuePtr->store, string);
-            valuePtr->string = TABLE_VALUE_STORE;
+        memset(&cell, 0, sizeof(Value));
+        cell.datum.d = value;
+        if (PutNumber(interp, tablePtr, rowPtr, colPtr, 
+                      TABLE_COLUMN_TYPE_DOUBLE, &cell) != TCL_OK) {
+            return TCL_ERROR;
         }
     }
-    /* Indicate the keytables need to be regenerated. */
-    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
-        tablePtr->flags |= TABLE_KEYS_DIRTY;
-    }
     CallTraces(tablePtr, rowPtr, colPtr, TABLE_TRACE_WRITES);
     return TCL_OK;
 }
@@ -6925,7 +16033,7 @@ int
 blt_table_set_bytes(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
                     Column *colPtr, const unsigned char *bytes, int numBytes)
 {
-    Value *valuePtr;
+    Value value;
 
     if (colPtr->type != TABLE_COLUMN_TYPE_BLOB) {
         if (interp != NULL) {
@@ -6934,16 +16042,12 @@ blt_table_set_bytes(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
         }
         return TCL_ERROR;
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    ResetValue(valuePtr);
-    if (SetValueFromString(interp, colPtr->type, (const char *)bytes, numBytes,
-                           valuePtr) != TCL_OK) {
+    memset(&value, 0, sizeof(Value));
+    if ((SetValueFromString(interp, colPtr, colPtr->type, (const char *)bytes, 
+                numBytes, &value) != TCL_OK) ||
+        (PutValue(interp, tablePtr, rowPtr, colPtr, &value) != TCL_OK)) {
         return TCL_ERROR;
     }
-    /* Indicate the keytables need to be regenerated. */
-    if (colPtr->flags & TABLE_COLUMN_PRIMARY_KEY) {
-        tablePtr->flags |= TABLE_KEYS_DIRTY;
-    }
     return TCL_OK;
 }
 
@@ -6966,13 +16070,12 @@ blt_table_set_bytes(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
 const char *
 blt_table_get_string(Table *tablePtr, Row *rowPtr, Column *colPtr)
 {
-    Value *valuePtr;
+    unsigned int length;
 
     if (IsEmpty(rowPtr, colPtr)) {
         return NULL;
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
-    return GetValueString(valuePtr);
+    return GetCellString(tablePtr, rowPtr, colPtr, &length);
 }
 
 /*
@@ -6995,18 +16098,21 @@ double
 blt_table_get_double(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
                      Column *colPtr)
 {
-    Value *valuePtr;
+    char buffer[DENSE_STRING_LENGTH];
     double d;
 
     if (IsEmpty(rowPtr, colPtr)) {
         return Blt_NaN();
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
     if ((colPtr->type == TABLE_COLUMN_TYPE_DOUBLE) ||
         (colPtr->type == TABLE_COLUMN_TYPE_TIME)) {
-        return valuePtr->datum.d;
+        Value value;
+
+        GetCellDatum(rowPtr, colPtr, &value);
+        return value.datum.d;
     }
-    if (Blt_GetDouble(interp, GetValueString(valuePtr), &d) != TCL_OK) {
+    if (Blt_GetDouble(interp, FormatCellString(rowPtr, colPtr, buffer), &d)
+        != TCL_OK) {
         return Blt_NaN();
     }
     return d;
@@ -7032,17 +16138,20 @@ long
 blt_table_get_long(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
                    Column *colPtr, long defVal)
 {
-    Value *valuePtr;
+    char buffer[DENSE_STRING_LENGTH];
     long l;
 
     if (IsEmpty(rowPtr, colPtr)) {
         return defVal;
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
     if (colPtr->type == TABLE_COLUMN_TYPE_LONG) {
-        return valuePtr->datum.l;
+        Value value;
+
+        GetCellDatum(rowPtr, colPtr, &value);
+        return value.datum.l;
     }
-    if (Blt_GetLong(interp, GetValueString(valuePtr), &l) != TCL_OK) {
+    if (Blt_GetLong(interp, FormatCellString(rowPtr, colPtr, buffer),
+                    &l) != TCL_OK) {
         return TCL_ERROR;
     }
     return l;
@@ -7068,17 +16177,20 @@ int
 blt_table_get_boolean(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
                       Column *colPtr, int defVal)
 {
-    Value *valuePtr;
+    char buffer[DENSE_STRING_LENGTH];
     int state;
 
     if (IsEmpty(rowPtr, colPtr)) {
         return defVal;
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
     if (colPtr->type == TABLE_COLUMN_TYPE_BOOLEAN) {
-        return (int)valuePtr->datum.l;
+        Value value;
+
+        GetCellDatum(rowPtr, colPtr, &value);
+        return (int)value.datum.l;
     }
-    if (Tcl_GetBoolean(interp, GetValueString(valuePtr), &state) != TCL_OK) {
+    if (Tcl_GetBoolean(interp, FormatCellString(rowPtr, colPtr, buffer),
+                       &state) != TCL_OK) {
         return TCL_ERROR;
     }
     return state;
@@ -7104,17 +16216,20 @@ int64_t
 blt_table_get_int64(Tcl_Interp *interp, Table *tablePtr, Row *rowPtr,
                    Column *colPtr, int64_t defVal)
 {
-    Value *valuePtr;
+    char buffer[DENSE_STRING_LENGTH];
     int64_t i;
 
     if (IsEmpty(rowPtr, colPtr)) {
         return defVal;
     }
-    valuePtr = GetValue(tablePtr, rowPtr, colPtr);
     if (colPtr->type == TABLE_COLUMN_TYPE_INT64) {
-        return valuePtr->datum.i64;
+        Value value;
+
+        GetCellDatum(rowPtr, colPtr, &value);
+        return value.datum.i64;
     }
-    if (Blt_GetInt64(interp, GetValueString(valuePtr), &i) != TCL_OK) {
+    if (Blt_GetInt64(interp, FormatCellString(rowPtr, colPtr, buffer),
+                     &i) != TCL_OK) {
         return TCL_ERROR;
     }
     return i;
@@ -7128,16 +16243,111 @@ blt_table_clear(Table *tablePtr)
     corePtr = tablePtr->corePtr;
     FreeColumns(corePtr);
     FreeRows(corePtr);
+    ReleaseMapping(corePtr);
     /* Re-initialize rows and columns. */
     Blt_InitHashTableWithPool(&corePtr->columns.labelTable, BLT_STRING_KEYS);
     Blt_InitHashTableWithPool(&corePtr->rows.labelTable, BLT_STRING_KEYS);
     corePtr->columns.pool = Blt_Pool_Create(BLT_FIXED_SIZE_ITEMS);
     corePtr->columns.nextColumnId = 1;
-    corePtr->rows.freeList = Blt_Chain_Create();
     corePtr->rows.pool = Blt_Pool_Create(BLT_FIXED_SIZE_ITEMS);
     corePtr->rows.nextRowId = 1;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * PackDenseStorage --
+ *
+ *      Compacts the native array, bitmap, and strings of a numeric column
+ *      so that the cells are in row order and sized exactly to the number
+ *      of rows in use.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+PackDenseStorage(Rows *rowsPtr, Column *colPtr)
+{
+    Row *rowPtr;
+    char *data, **strings;
+    unsigned char *nonEmpty;
+    size_t size, count;
+
+    if (rowsPtr->numUsed == 0) {
+        FreeColumnValues(rowsPtr, colPtr);
+        return;                         /* Reallocated on the next set. */
+    }
+    size = DenseValueSize(colPtr->type);
+    data = Blt_AssertMalloc(rowsPtr->numUsed * size);
+    nonEmpty = Blt_AssertCalloc(DenseBitmapSize(rowsPtr->numUsed), 
+                                sizeof(unsigned char));
+    strings = NULL;
+    if (colPtr->strings != NULL) {
+        strings = Blt_AssertCalloc(rowsPtr->numUsed, sizeof(char *));
+    }
+    count = 0;
+    for (rowPtr = rowsPtr->headPtr; rowPtr != NULL; rowPtr = rowPtr->nextPtr) {
+        long offset;
+
+        offset = rowPtr->offset;
+        memcpy(data + count * size, (char *)colPtr->data + offset * size, size);
+        if (DenseIsSet(colPtr, offset)) {
+            nonEmpty[count >> 3] |= (1 << (count & 7));
+        }
+        if (strings != NULL) {
+            strings[count] = colPtr->strings[offset];
+            colPtr->strings[offset] = NULL;
+        }
+        count++;
+    }
+    if (colPtr->strings != NULL) {
+        Blt_Free(colPtr->strings);
+    }
+    if (colPtr->flags & TABLE_COLUMN_MAPPED) {
+        colPtr->flags &= ~TABLE_COLUMN_MAPPED;
+    } else {
+        Blt_Free(colPtr->data);
+        Blt_Free(colPtr->nonEmpty);
+    }
+    colPtr->data = data;
+    colPtr->nonEmpty = nonEmpty;
+    colPtr->strings = strings;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * PackCodes --
+ *
+ *      Compacts the codes of a dictionary encoded column so that they're
+ *      in row order and sized exactly to the number of rows in use.  The
+ *      dictionary itself is unchanged.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+PackCodes(Rows *rowsPtr, Column *colPtr)
+{
+    Row *rowPtr;
+    char *codes;
+    size_t width, count;
+
+    width = colPtr->dictPtr->width;
+    if (rowsPtr->numUsed == 0) {
+        Blt_Free(colPtr->codes);
+        colPtr->codes = NULL;           /* Reallocated on the next set. */
+        return;
+    }
+    codes = Blt_AssertMalloc(rowsPtr->numUsed * width);
+    count = 0;
+    for (rowPtr = rowsPtr->headPtr; rowPtr != NULL; rowPtr = rowPtr->nextPtr) {
+        memcpy(codes + count * width, 
+               (char *)colPtr->codes + rowPtr->offset * width, width);
+        count++;
+    }
+    Blt_Free(colPtr->codes);
+    colPtr->codes = codes;
+}
+
 void
 blt_table_pack(Table *tablePtr)
 {
@@ -7147,9 +16357,15 @@ blt_table_pack(Table *tablePtr)
 
     rowsPtr = &tablePtr->corePtr->rows;
     columnsPtr = &tablePtr->corePtr->columns;
+    if (rowsPtr->flags & REINDEX) {
+        ResetRowMap(rowsPtr);
+    }
     /* Replace each vector with one exactly the number of used rows.  */
     for (colPtr = columnsPtr->headPtr; colPtr != NULL; 
          colPtr = colPtr->nextPtr) {
+        if (colPtr->sharePtr != NULL) {
+            UnshareColumn(tablePtr->corePtr, colPtr);
+        }
         if (colPtr->vector != NULL) {
             Row *rowPtr;
             Value *vector, *valuePtr;
@@ -7166,14 +16382,30 @@ blt_table_pack(Table *tablePtr)
             Blt_Free(colPtr->vector);
             colPtr->vector = vector;
         }
+        if (colPtr->codes != NULL) {
+            PackCodes(rowsPtr, colPtr);
+        }
+        if (colPtr->data != NULL) {
+            PackDenseStorage(rowsPtr, colPtr);
+        }
     }
     {
         size_t count;
         Row *rowPtr;
+        long *newOffsets;
+        long i;
         
+        /* Record where each row moves to, so that row tags can be
+         * renumbered. */
+        newOffsets = Blt_AssertMalloc(sizeof(long) * 
+                                      (rowsPtr->numAllocated + 1));
+        for (i = 0; i < rowsPtr->numAllocated; i++) {
+            newOffsets[i] = -1;
+        }
         count = 0;
         for (rowPtr = rowsPtr->headPtr; rowPtr != NULL;
              rowPtr = rowPtr->nextPtr) {
+            newOffsets[rowPtr->offset] = count;
             rowPtr->offset = count;
             rowPtr->index = count;
             count++;
@@ -7189,13 +16421,18 @@ blt_table_pack(Table *tablePtr)
                 map = Blt_Realloc(rowsPtr->map, sizeof(Row *) * count);
             }
             rowsPtr->map = map;
+            rowsPtr->offsets = Blt_Realloc(rowsPtr->offsets, 
+                                           sizeof(Row *) * count);
+            for (rowPtr = rowsPtr->headPtr; rowPtr != NULL;
+                 rowPtr = rowPtr->nextPtr) {
+                rowsPtr->offsets[rowPtr->offset] = rowPtr;
+            }
             rowsPtr->numAllocated = count;
         }
-        if (rowsPtr->freeList != NULL) {
-            /* Dump the free list. */
-            Blt_Chain_Destroy(rowsPtr->freeList);
-            rowsPtr->freeList = Blt_Chain_Create();
-        }
+        RemapRowTags(tablePtr, newOffsets);
+        Blt_Free(newOffsets);
+        /* Dump the free queue. */
+        rowsPtr->firstFree = rowsPtr->lastFree = 0;
     }
     {
         size_t count;
@@ -7220,4 +16457,5 @@ blt_table_pack(Table *tablePtr)
             columnsPtr->numAllocated = count;
         }
     }
+    RefreshColumnViews(tablePtr, NULL);
 }
@@ -120,7 +120,46 @@ struct _BLT_TABLE_COLUMN {
     const char *label;                  /* Label of row or column. */
     long index;                         /* Reverse lookup
                                          * offset-to-index. */
-    BLT_TABLE_VALUE vector;
+    BLT_TABLE_VALUE vector;             /* Values of string and blob
+                                         * columns. */
+    void *data;                         /* Values of numeric columns,
+                                         * stored as a native array of
+                                         * doubles, int64_ts, longs, or
+                                         * ints depending upon the
+                                         * column type. */
+    unsigned char *nonEmpty;            /* Bitmap of the cells in data
+                                         * that hold a value. */
+    char **strings;                     /* String representations of
+                                         * numeric values.  Generated on
+                                         * demand, unless the value was
+                                         * set from a string that isn't
+                                         * in the generated form. */
+    struct _BLT_TABLE_VALUE scratch;    /* Numeric value handed out by
+                                         * blt_table_get_value. */
+    struct _BLT_TABLE_COLUMN_INDEX *indexPtr; /* If non-NULL, the rows of
+                                         * the column ordered by value. */
+    struct _BLT_TABLE_DICTIONARY *dictPtr; /* If non-NULL, the column
+                                         * is dictionary encoded.  Each
+                                         * distinct string is stored once
+                                         * in the dictionary. */
+    void *codes;                        /* Dictionary codes of the cells,
+                                         * an array of 8, 16, or 32-bit
+                                         * integers. */
+    struct _BLT_TABLE_COLUMN_SHARE *sharePtr; /* If non-NULL, the
+                                         * storage above may be shared
+                                         * with other columns.  It's
+                                         * copied before it's changed. */
+    struct _BLT_TABLE_STATS_CACHE *statsPtr; /* If non-NULL, cached
+                                         * statistics of the column's
+                                         * values, kept up to date as
+                                         * cells are set and unset. */
+    Blt_Chain views;                    /* If non-NULL, clients using
+                                         * the column's doubles in place
+                                         * (see blt_table_create_view). */
+    struct _Blt_TimeFormat *timeFmtPtr; /* If non-NULL, the compiled
+                                         * format tried first when
+                                         * strings are converted to time
+                                         * values for the column. */
     BLT_TABLE_COLUMN_TYPE type;
     unsigned int flags;
 };
@@ -139,11 +178,24 @@ typedef struct _BLT_TABLE_ROWS {
                                          * rows used. */
     long numUsed;
     BLT_TABLE_ROW *map;                 /* Array of row pointers. */
+    BLT_TABLE_ROW *offsets;             /* Array of row pointers indexed
+                                         * by storage offset.  Unused
+                                         * offsets are NULL. */
     Blt_HashTable labelTable;           /* Hash table of labels. Maps
                                          * labels to table offsets. */
     long nextRowId;                     /* Used to generate default
                                          * row labels. */
-    Blt_Chain freeList;                 /* List of free rows. */
+    long *freeOffsets;                  /* Queue of the storage offsets of
+                                         * deleted rows, reused by new rows
+                                         * oldest first. */
+    long firstFree, lastFree;           /* Head and tail of the queue. */
+    long freeSize;                      /* Allocated length of the
+                                         * queue. */
+    long *holes;                        /* If non-NULL, tree counting the
+                                         * slots of deleted rows still in
+                                         * the map. */
+    long numSlots;                      /* # of slots in the map, including
+                                         * holes. */
 } BLT_TABLE_ROWS;
 
 /*
@@ -218,6 +270,15 @@ typedef struct _BLT_TABLE_CORE {
     unsigned int notifyFlags;           /* Notification flags. See
                                          * definitions below. */
     int notifyHold;
+    void *mapAddr;                      /* If non-NULL, snapshot file
+                                         * mapped into memory.  Numeric
+                                         * columns may point into it. */
+    size_t mapSize;                     /* Size of the mapped snapshot. */
+    size_t numMappedRows;               /* # of rows in the mapped
+                                         * column blocks. */
+    struct _BLT_TABLE_BATCH *batchPtr;  /* If non-NULL, a batch of updates
+                                         * is open.  Trace events are
+                                         * recorded rather than fired. */
 } BLT_TABLE_CORE;
 
 #ifndef _BLT_TAGS_H
@@ -269,7 +330,8 @@ typedef struct _BLT_TABLE {
     Blt_ChainLink link2;                /* Pointer into the list of clients
                                          * using the same table name. */
 
-    Blt_Tags rowTags;
+    Blt_HashTable *rowTags;             /* Row tag bitmaps keyed by tag
+                                         * name. */
     Blt_Tags columnTags;
 
     Blt_HashTable traces;               /* Hash table of valid traces */
@@ -284,13 +346,24 @@ typedef struct _BLT_TABLE {
 
     Blt_HashTable *keyTables;           /* Array of primary key
                                          * hashtables. */
-    BLT_TABLE_ROW *masterKey;           /* Master key entry. */
-    Blt_HashTable masterKeyTable;
+    Blt_HashEntry **masterKey;          /* Master key: the entry of each
+                                         * key value in its key
+                                         * hashtable. */
+    Blt_HashTable masterKeyTable;       /* Master keys to rows. */
+    Blt_HashTable duplicateKeyTable;    /* Counts the other rows having
+                                         * the same master key. */
     BLT_TABLE_COLUMN *primaryKeys;      /* Array of columns acting as
                                          * primary keys for table
                                          * lookups. */
     int numKeys;                        /* # of primary keys. */
 
+    struct _BLT_TABLE_SORT_ORDER *sortOrder; /* Sort order set by
+                                         * blt_table_sort_init. */
+    long numSortColumns;                /* # of columns in above order. */
+    unsigned int sortFlags;
+    int batchDepth;                     /* # of batches opened by this
+                                         * client and not yet ended. */
+
     unsigned int flags;
 } *BLT_TABLE;
 
@@ -519,6 +592,10 @@ typedef struct _BLT_TABLE_ITERATOR {
                                          * hash table must be freed after
                                          * its use. */
     Blt_ChainLink link;                 /* Search iterator for chain. */
+
+    /* For row tag searches. */
+    struct _BLT_TABLE_TAG_SET *tagSetPtr; /* Bitmap of the tagged rows. */
+    long nextOffset;                    /* Next row offset to search. */
 } BLT_TABLE_ITERATOR;
 
 BLT_EXTERN int blt_table_iterate_rows(Tcl_Interp *interp, BLT_TABLE table, 
@@ -539,6 +616,9 @@ BLT_EXTERN void blt_table_free_iterator_objv(BLT_TABLE_ITERATOR *iterPtr);
 BLT_EXTERN void blt_table_iterate_all_rows(BLT_TABLE table, 
         BLT_TABLE_ITERATOR *iterPtr);
 
+BLT_EXTERN int blt_table_iterate_row_tag(BLT_TABLE table, const char *tag,
+        BLT_TABLE_ITERATOR *iterPtr);
+
 BLT_EXTERN void blt_table_iterate_all_columns(BLT_TABLE table, 
         BLT_TABLE_ITERATOR *iterPtr);
 
@@ -558,6 +638,23 @@ BLT_EXTERN int blt_table_list_rows(Tcl_Interp *interp, BLT_TABLE table,
 BLT_EXTERN int blt_table_list_columns(Tcl_Interp *interp, BLT_TABLE table, 
         int objc, Tcl_Obj *const *objv, Blt_Chain chain);
 
+/*
+ * BLT_TABLE_COLUMN_STATS --
+ *
+ *      Statistics of the values of a column.  The table caches them in
+ *      the column and updates them as cells are set and unset.
+ */
+typedef struct {
+    long numValues;                     /* # of non-empty cells. */
+    double sum;                         /* Sum of the values.  Always 0.0
+                                         * for string and blob columns. */
+    BLT_TABLE_ROW minRow, maxRow;       /* Rows holding the minimum and
+                                         * maximum values.  NULL if the
+                                         * column has no values. */
+    long numDistinct;                   /* Estimated # of distinct
+                                         * values. */
+} BLT_TABLE_COLUMN_STATS;
+
 /*
  * BLT_TABLE_TRACE_EVENT --
  *
@@ -582,6 +679,11 @@ typedef struct {
     BLT_TABLE_ROW row;                  /* Matching row and column. */
     BLT_TABLE_COLUMN column;
     unsigned int mask;                  /* Type of event received. */
+    BLT_TABLE_ROW lastRow;              /* For batch events, the last
+                                         * changed row and column.
+                                         * Otherwise the same as row and
+                                         * column. */
+    BLT_TABLE_COLUMN lastColumn;
 } BLT_TABLE_TRACE_EVENT;
 
 typedef int (BLT_TABLE_TRACE_PROC)(ClientData clientData, 
@@ -641,6 +743,10 @@ typedef struct _BLT_TABLE_TRACE {
 #define TABLE_TRACE_DESTROYED   (1<<11)
 #define TABLE_TRACE_PENDING     (1<<12)
 #define TABLE_TRACE_WHENIDLE    (1<<13)
+#define TABLE_TRACE_EACH_CELL   (1<<14) /* Fire for each cell, even while
+                                         * a batch is open. */
+#define TABLE_TRACE_BATCH       (1<<15) /* Event summarizes the changes of
+                                         * a batch. */
 
 BLT_EXTERN void blt_table_clear_row_traces(BLT_TABLE table, BLT_TABLE_ROW row);
 
@@ -678,6 +784,9 @@ BLT_EXTERN BLT_TABLE_TRACE blt_table_create_row_tag_trace(BLT_TABLE table,
 
 BLT_EXTERN void blt_table_delete_trace(BLT_TABLE table, BLT_TABLE_TRACE trace);
 
+BLT_EXTERN void blt_table_begin_batch(BLT_TABLE table);
+BLT_EXTERN void blt_table_end_batch(BLT_TABLE table);
+
 /*
  * BLT_TABLE_NOTIFY_EVENT --
  *
@@ -808,7 +917,7 @@ BLT_EXTERN void blt_table_delete_notifier(BLT_TABLE table,
 typedef int (BLT_TABLE_COMPARE_PROC)(ClientData clientData, 
         BLT_TABLE_COLUMN col, BLT_TABLE_ROW row1, BLT_TABLE_ROW row2);
 
-typedef struct {
+typedef struct _BLT_TABLE_SORT_ORDER {
     int type;                           /* Type of sort to be performed:
                                          * see flags below. */
     BLT_TABLE_COMPARE_PROC *cmpProc;    /* Procedures to be called to
@@ -837,6 +946,8 @@ BLT_EXTERN void blt_table_sort_init(BLT_TABLE table,
 BLT_EXTERN BLT_TABLE_ROW *blt_table_sort_rows(BLT_TABLE table);
 BLT_EXTERN void blt_table_sort_row_map(BLT_TABLE table, long numRows, 
         BLT_TABLE_ROW *rows);
+BLT_EXTERN void blt_table_partial_sort_row_map(BLT_TABLE table, 
+        long numRows, BLT_TABLE_ROW *rows, long numSorted);
 BLT_EXTERN void blt_table_sort_finish(void);
 BLT_EXTERN BLT_TABLE_COMPARE_PROC *blt_table_get_compare_proc(BLT_TABLE table, 
         BLT_TABLE_COLUMN column, unsigned int flags);
@@ -849,11 +960,21 @@ BLT_EXTERN void blt_table_set_column_map(BLT_TABLE table, BLT_TABLE_COLUMN *map)
 
 #define TABLE_RESTORE_NO_TAGS       (1<<0)
 #define TABLE_RESTORE_OVERWRITE     (1<<1)
+#define TABLE_RESTORE_BINARY        (1<<2)
 
 BLT_EXTERN int blt_table_restore(Tcl_Interp *interp, BLT_TABLE table, 
         char *string, unsigned int flags);
 BLT_EXTERN int blt_table_file_restore(Tcl_Interp *interp, BLT_TABLE table, 
         const char *fileName, unsigned int flags);
+BLT_EXTERN int blt_table_binary_dump(Tcl_Interp *interp, BLT_TABLE table, 
+        BLT_TABLE_ITERATOR *rowIterPtr, BLT_TABLE_ITERATOR *colIterPtr, 
+        Tcl_Channel channel);
+BLT_EXTERN int blt_table_binary_restore(Tcl_Interp *interp, BLT_TABLE table, 
+        const unsigned char *bytes, size_t numBytes, unsigned int flags);
+BLT_EXTERN int blt_table_file_binary_restore(Tcl_Interp *interp, 
+        BLT_TABLE table, const char *fileName, unsigned int flags);
+BLT_EXTERN int blt_table_map_snapshot(Tcl_Interp *interp, BLT_TABLE table, 
+        const char *fileName);
 
 typedef int (BLT_TABLE_IMPORT_PROC)(BLT_TABLE table, Tcl_Interp *interp, 
         int objc, Tcl_Obj *const *objv);
@@ -874,6 +995,174 @@ BLT_EXTERN int blt_table_key_lookup(Tcl_Interp *interp, BLT_TABLE table,
 BLT_EXTERN int blt_table_get_column_limits(Tcl_Interp *interp, BLT_TABLE table, 
         BLT_TABLE_COLUMN col, Tcl_Obj **minObjPtrPtr, Tcl_Obj **maxObjPtrPtr);
 
+BLT_EXTERN int blt_table_get_column_stats(Tcl_Interp *interp, BLT_TABLE table, 
+        BLT_TABLE_COLUMN col, BLT_TABLE_COLUMN_STATS *statsPtr);
+
+BLT_EXTERN int blt_table_create_index(Tcl_Interp *interp, BLT_TABLE table,
+        BLT_TABLE_COLUMN col, int unique);
+BLT_EXTERN void blt_table_delete_index(BLT_TABLE table, BLT_TABLE_COLUMN col);
+BLT_EXTERN long blt_table_index_rows(BLT_TABLE table, BLT_TABLE_COLUMN col,
+        BLT_TABLE_ROW **rowsPtr);
+BLT_EXTERN int blt_table_index_range(Tcl_Interp *interp, BLT_TABLE table,
+        BLT_TABLE_COLUMN col, Tcl_Obj *loObjPtr, Tcl_Obj *hiObjPtr,
+        BLT_TABLE_ROW **rowsPtr, long *numRowsPtr);
+
+/*
+ * BLT_TABLE_AGGREGATE --
+ *
+ *      Describes one result column of blt_table_aggregate.
+ */
+typedef enum {
+    TABLE_AGGREGATE_COUNT,              /* # of non-empty values. */
+    TABLE_AGGREGATE_SUM,
+    TABLE_AGGREGATE_MEAN,
+    TABLE_AGGREGATE_MIN,
+    TABLE_AGGREGATE_MAX
+} BLT_TABLE_AGGREGATE_TYPE;
+
+typedef struct {
+    BLT_TABLE_AGGREGATE_TYPE type;
+    BLT_TABLE_COLUMN column;            /* Column to be aggregated.  For
+                                         * counts, NULL means to count the
+                                         * rows of the group. */
+    const char *label;                  /* Label of the result column. */
+} BLT_TABLE_AGGREGATE;
+
+BLT_EXTERN int blt_table_aggregate(Tcl_Interp *interp, BLT_TABLE table,
+        long numRows, BLT_TABLE_ROW *rows, long numGroupColumns,
+        BLT_TABLE_COLUMN *groupColumns, long numAggregates,
+        BLT_TABLE_AGGREGATE *aggregates, int numThreads, BLT_TABLE dest);
+
+/*
+ * BLT_TABLE_WINDOW --
+ *
+ *      Describes the rolling window operation of blt_table_window.
+ */
+typedef enum {
+    TABLE_WINDOW_SUM,
+    TABLE_WINDOW_MEAN,
+    TABLE_WINDOW_MIN,
+    TABLE_WINDOW_MAX,
+    TABLE_WINDOW_STD,                   /* Sample standard deviation. */
+    TABLE_WINDOW_MEDIAN
+} BLT_TABLE_WINDOW_TYPE;
+
+typedef struct {
+    BLT_TABLE_WINDOW_TYPE type;
+    long size;                          /* # of rows in the window.  0
+                                         * means a cumulative window. */
+    BLT_TABLE_COLUMN groupColumn;       /* If non-NULL, windows only span
+                                         * rows with the same value in
+                                         * this column. */
+    unsigned int flags;
+} BLT_TABLE_WINDOW;
+
+#define TABLE_WINDOW_SET_TYPE   (1<<0)  /* Set the type of the destination
+                                         * column from the results. */
+
+BLT_EXTERN int blt_table_window(Tcl_Interp *interp, BLT_TABLE table,
+        BLT_TABLE_COLUMN src, BLT_TABLE_COLUMN dest, BLT_TABLE_WINDOW *winPtr);
+
+#define TABLE_JOIN_INNER        (1<<0)  /* Delete rows without a match. */
+
+BLT_EXTERN int blt_table_join(Tcl_Interp *interp, BLT_TABLE table,
+        BLT_TABLE src, long numKeys, BLT_TABLE_COLUMN *keys,
+        BLT_TABLE_COLUMN *srcKeys, long numColumns,
+        BLT_TABLE_COLUMN *srcColumns, unsigned int flags);
+
+typedef enum {
+    TABLE_COLUMN_ENCODING_NONE,         /* Each cell holds its own
+                                         * string. */
+    TABLE_COLUMN_ENCODING_DICTIONARY    /* Cells hold codes into a
+                                         * dictionary of the column's
+                                         * distinct strings. */
+} BLT_TABLE_COLUMN_ENCODING;
+
+BLT_EXTERN int blt_table_set_column_encoding(Tcl_Interp *interp, 
+        BLT_TABLE table, BLT_TABLE_COLUMN col, 
+        BLT_TABLE_COLUMN_ENCODING encoding);
+BLT_EXTERN int blt_table_set_column_time_format(Tcl_Interp *interp, 
+        BLT_TABLE table, BLT_TABLE_COLUMN col, const char *pattern);
+BLT_EXTERN const char *blt_table_column_time_format(BLT_TABLE_COLUMN col);
+BLT_EXTERN long blt_table_dictionary_code(BLT_TABLE_COLUMN col, 
+        const char *string);
+BLT_EXTERN long blt_table_get_code(BLT_TABLE table, BLT_TABLE_ROW row,
+        BLT_TABLE_COLUMN col);
+
+BLT_EXTERN int blt_table_mirror_rows(Tcl_Interp *interp, BLT_TABLE src,
+        BLT_TABLE dst);
+BLT_EXTERN int blt_table_share_column(BLT_TABLE src, BLT_TABLE_COLUMN srcCol,
+        BLT_TABLE dst, BLT_TABLE_COLUMN dstCol);
+BLT_EXTERN int blt_table_load_column(Tcl_Interp *interp, BLT_TABLE table,
+        BLT_TABLE_COLUMN col, size_t numRows, BLT_TABLE_ROW *rows,
+        const unsigned char *bitmap, const void *values, size_t width,
+        const int64_t *offsets);
+
+/*
+ * BLT_TABLE_TYPE_GUESS --
+ *
+ *      Infers the type of a column from the strings loaded into it by an
+ *      import.  The column stays a string column until sampleSize values
+ *      have been seen, then its type is set to the narrowest type that
+ *      fits them all (boolean, long, int64, double, time, or string).
+ *      Later values are converted as they are loaded.  If one doesn't fit,
+ *      the column is widened.  If sampleSize is 0, the type is set only
+ *      when the guess is finished.
+ */
+typedef struct {
+    BLT_TABLE_COLUMN column;            /* Column being typed.  May be
+                                         * NULL until the column is
+                                         * created. */
+    long sampleSize;                    /* # of values to examine before
+                                         * the column type is set. */
+    long numValues;                     /* # of values examined. */
+    unsigned int mask;                  /* Types that fit all the values
+                                         * examined so far. */
+    unsigned int timeFormats;           /* Time formats that fit all the
+                                         * values examined so far. */
+    int isTyped;                        /* Indicates the column's type has
+                                         * been set. */
+} BLT_TABLE_TYPE_GUESS;
+
+BLT_EXTERN void blt_table_init_type_guess(BLT_TABLE_TYPE_GUESS *guessPtr,
+        BLT_TABLE_COLUMN col, long sampleSize);
+BLT_EXTERN void blt_table_guess_value(BLT_TABLE_TYPE_GUESS *guessPtr,
+        const char *string, int length);
+BLT_EXTERN int blt_table_set_guessed_type(Tcl_Interp *interp, 
+        BLT_TABLE table, BLT_TABLE_TYPE_GUESS *guessPtr);
+BLT_EXTERN int blt_table_set_guessed_value(Tcl_Interp *interp, 
+        BLT_TABLE table, BLT_TABLE_ROW row, BLT_TABLE_TYPE_GUESS *guessPtr,
+        const char *string, int length);
+BLT_EXTERN int blt_table_finish_type_guess(Tcl_Interp *interp, 
+        BLT_TABLE table, BLT_TABLE_TYPE_GUESS *guessPtr, 
+        Tcl_Obj *listObjPtr);
+
+/*
+ * BLT_TABLE_VIEW --
+ *
+ *      A view of the values of a double or time column as an array of
+ *      doubles, in row order, that is used in place.  Empty cells hold
+ *      NaN.  The view procedure is called whenever the array is moved or
+ *      resized, when values are changed, and when the view is deleted
+ *      by the table (the array is still valid during the call).
+ */
+typedef struct _BLT_TABLE_VIEW *BLT_TABLE_VIEW;
+
+#define TABLE_VIEW_MOVED        (1<<0)  /* The array was moved or
+                                         * resized. */
+#define TABLE_VIEW_CHANGED      (1<<1)  /* Values in the array changed. */
+#define TABLE_VIEW_DELETED      (1<<2)  /* The view is deleted after the
+                                         * procedure returns. */
+
+typedef void (BLT_TABLE_VIEW_PROC)(ClientData clientData, double *array,
+        long numValues, unsigned int flags);
+
+BLT_EXTERN BLT_TABLE_VIEW blt_table_create_view(Tcl_Interp *interp, 
+        BLT_TABLE table, BLT_TABLE_COLUMN col, BLT_TABLE_VIEW_PROC *proc,
+        ClientData clientData);
+BLT_EXTERN void blt_table_delete_view(BLT_TABLE table, BLT_TABLE_VIEW view);
+BLT_EXTERN void blt_table_sync_view(BLT_TABLE table, BLT_TABLE_VIEW view);
+
 BLT_EXTERN BLT_TABLE_ROW blt_table_row(BLT_TABLE table, long index);
 BLT_EXTERN BLT_TABLE_COLUMN blt_table_column(BLT_TABLE table, long index);
 BLT_EXTERN long blt_table_row_index(BLT_TABLE table, BLT_TABLE_ROW row);
@@ -888,6 +1177,10 @@ BLT_EXTERN long blt_table_column_index(BLT_TABLE table,
 #define blt_table_name(t)               ((t)->name)
 #define blt_table_empty_value(t)        ((t)->emptyValue)
 #define blt_table_column_type(c)        ((c)->type)
+#define blt_table_column_has_index(c)   ((c)->indexPtr != NULL)
+#define blt_table_column_encoding(c)    \
+    (((c)->dictPtr != NULL) ? TABLE_COLUMN_ENCODING_DICTIONARY : \
+     TABLE_COLUMN_ENCODING_NONE)
 #define blt_table_columns(t)            (&(t)->corePtr->columns)
 #define blt_table_rows(t)               (&(t)->corePtr->rows)
 #endif /* BLT_DATATABLE_H */
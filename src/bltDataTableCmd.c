@@ -136,6 +136,8 @@ typedef struct {
 enum DataFormats {
     FMT_TXT,                            /* Comma separated value files */
     FMT_CSV,                            /* Comma separated value files r/w */
+    FMT_COLUMNAR,                       /* Columnar binary r/w */
+    FMT_NDJSON,                         /* Newline-delimited JSON r/w */
 #ifdef HAVE_LIBMYSQL
     FMT_MYSQL,                          /* Mysql r/w */
 #endif
@@ -156,6 +158,8 @@ enum DataFormats {
 static DataFormat dataFormats[] = {
     { "txt" },                          /* White space separated values */
     { "csv" },                          /* Comma separated values */
+    { "columnar" },                     /* Columnar binary buffers */
+    { "ndjson" },                       /* Newline-delimited JSON */
 #ifdef HAVE_LIBMYSQL
     { "mysql" },                        /* mysql client library. */
 #endif
@@ -217,6 +221,9 @@ BLT_EXTERN Blt_SwitchParseProc blt_table_row_iter_switch_proc;
 static Blt_SwitchParseProc TableSwitchProc;
 static Blt_SwitchFreeProc TableFreeProc;
 static Blt_SwitchParseProc ColumnTypeSwitchProc;
+static Blt_SwitchParseProc ColumnEncodingSwitchProc;
+static Blt_SwitchParseProc AggregateSwitchProc;
+static Blt_SwitchParseProc SortRangeSwitchProc;
 static Blt_SwitchParseProc AfterColumnSwitch;
 static Blt_SwitchParseProc AfterRowSwitch;
 
@@ -232,6 +239,15 @@ static Blt_SwitchCustom tableSwitch = {
 static Blt_SwitchCustom columnTypeSwitch = {
     ColumnTypeSwitchProc, NULL, NULL, 0,
 };
+static Blt_SwitchCustom columnEncodingSwitch = {
+    ColumnEncodingSwitchProc, NULL, NULL, 0,
+};
+static Blt_SwitchCustom aggregateSwitch = {
+    AggregateSwitchProc, NULL, NULL, 0,
+};
+static Blt_SwitchCustom sortRangeSwitch = {
+    SortRangeSwitchProc, NULL, NULL, 0,
+};
 
 #ifdef notdef
 
@@ -364,6 +380,9 @@ typedef struct {
     Tcl_Obj *tags;                      /* List of tags to be applied to
                                          * this row or column. */
     BLT_TABLE_COLUMN_TYPE type;
+    BLT_TABLE_COLUMN_ENCODING encoding;
+    const char *timeFormat;             /* Pattern to parse time
+                                         * strings. */
     unsigned int flags;
 } InsertColumnSwitches;
 
@@ -373,10 +392,15 @@ static Blt_SwitchSpec insertColumnSwitches[] =
         Blt_Offset(InsertColumnSwitches, destColumn), 0, 0, &afterColumnSwitch},
     {BLT_SWITCH_CUSTOM, "-before", "columnName",    (char *)NULL,
         Blt_Offset(InsertColumnSwitches, destColumn), 0, 0, &afterColumnSwitch},
+    {BLT_SWITCH_CUSTOM, "-encoding", "encodingName", (char *)NULL,
+        Blt_Offset(InsertColumnSwitches, encoding), 0, 0, 
+        &columnEncodingSwitch},
     {BLT_SWITCH_STRING, "-label",  "string",    (char *)NULL,
         Blt_Offset(InsertColumnSwitches, label),  0},
     {BLT_SWITCH_OBJ,    "-tags",   "tagList",      (char *)NULL,
         Blt_Offset(InsertColumnSwitches, tags),   0},
+    {BLT_SWITCH_STRING, "-timeformat", "pattern",  (char *)NULL,
+        Blt_Offset(InsertColumnSwitches, timeFormat), 0},
     {BLT_SWITCH_CUSTOM, "-type",   "columnType",      (char *)NULL,
         Blt_Offset(InsertColumnSwitches, type),   0, 0, &columnTypeSwitch},
     {BLT_SWITCH_END}
@@ -469,6 +493,74 @@ static Blt_SwitchSpec addSwitches[] =
     {BLT_SWITCH_END}
 };
 
+typedef struct {
+    Tcl_Obj *onObjPtr;                  /* List of key column pairs. */
+    Tcl_Obj *typeObjPtr;                /* "inner" or "left". */
+    BLT_TABLE_ITERATOR ci;              /* Source columns to join. */
+} TableJoinSwitches;
+
+static Blt_SwitchSpec tableJoinSwitches[] = 
+{
+    {BLT_SWITCH_CUSTOM, "-columns", "columns", (char *)NULL,
+        Blt_Offset(TableJoinSwitches, ci), 0, 0, &columnIterSwitch},
+    {BLT_SWITCH_OBJ,    "-on",      "columnPairs", (char *)NULL,
+        Blt_Offset(TableJoinSwitches, onObjPtr), 0},
+    {BLT_SWITCH_OBJ,    "-type",    "inner|left", (char *)NULL,
+        Blt_Offset(TableJoinSwitches, typeObjPtr), 0},
+    {BLT_SWITCH_END}
+};
+
+typedef struct {
+    BLT_TABLE table;                    /* If non-NULL, table to hold the
+                                         * results. */
+    int numThreads;
+    BLT_TABLE_ITERATOR ri, gi;
+    Blt_Chain aggregates;               /* Aggregates in the order they
+                                         * were specified. */
+} AggregateSwitches;
+
+static Blt_SwitchSpec aggregateSwitches[] = 
+{
+    {BLT_SWITCH_CUSTOM, "-count",   "columns", (char *)NULL,
+        Blt_Offset(AggregateSwitches, aggregates), 0, 0, &aggregateSwitch},
+    {BLT_SWITCH_CUSTOM, "-groupby", "columns", (char *)NULL,
+        Blt_Offset(AggregateSwitches, gi), 0, 0, &columnIterSwitch},
+    {BLT_SWITCH_CUSTOM, "-into",    "tableName", (char *)NULL,
+        Blt_Offset(AggregateSwitches, table), 0, 0, &tableSwitch},
+    {BLT_SWITCH_CUSTOM, "-max",     "columns", (char *)NULL,
+        Blt_Offset(AggregateSwitches, aggregates), 0, 0, &aggregateSwitch},
+    {BLT_SWITCH_CUSTOM, "-mean",    "columns", (char *)NULL,
+        Blt_Offset(AggregateSwitches, aggregates), 0, 0, &aggregateSwitch},
+    {BLT_SWITCH_CUSTOM, "-min",     "columns", (char *)NULL,
+        Blt_Offset(AggregateSwitches, aggregates), 0, 0, &aggregateSwitch},
+    {BLT_SWITCH_CUSTOM, "-rows",    "rows", (char *)NULL,
+        Blt_Offset(AggregateSwitches, ri), 0, 0, &rowIterSwitch},
+    {BLT_SWITCH_CUSTOM, "-sum",     "columns", (char *)NULL,
+        Blt_Offset(AggregateSwitches, aggregates), 0, 0, &aggregateSwitch},
+    {BLT_SWITCH_INT_NNEG, "-threads", "numThreads", (char *)NULL,
+        Blt_Offset(AggregateSwitches, numThreads), 0},
+    {BLT_SWITCH_END}
+};
+
+typedef struct {
+    long size;                          /* # of rows in the window.  0
+                                         * means cumulative. */
+    Tcl_Obj *opObjPtr;                  /* Operation: "mean", "sum", ... */
+    Tcl_Obj *byObjPtr;                  /* If non-NULL, column to group
+                                         * rows by. */
+} WindowSwitches;
+
+static Blt_SwitchSpec windowSwitches[] = 
+{
+    {BLT_SWITCH_OBJ,    "-by",     "columnName", (char *)NULL,
+        Blt_Offset(WindowSwitches, byObjPtr), 0},
+    {BLT_SWITCH_OBJ,    "-op",     "mean|sum|min|max|std|median", (char *)NULL,
+        Blt_Offset(WindowSwitches, opObjPtr), 0},
+    {BLT_SWITCH_LONG_NNEG, "-size", "numRows", (char *)NULL,
+        Blt_Offset(WindowSwitches, size), 0},
+    {BLT_SWITCH_END}
+};
+
 typedef struct {
     unsigned int flags;
 } MoveSwitches;
@@ -493,8 +585,12 @@ typedef struct {
     Tcl_Obj *fileObjPtr;
 } DumpSwitches;
 
+#define DUMP_BINARY     (1<<0)          /* Write a binary snapshot. */
+
 static Blt_SwitchSpec dumpSwitches[] = 
 {
+    {BLT_SWITCH_BITS_NOARG, "-binary", "", (char *)NULL,
+        Blt_Offset(DumpSwitches, flags), 0, DUMP_BINARY},
     {BLT_SWITCH_CUSTOM, "-rows",    "rows", (char *)NULL,
         Blt_Offset(DumpSwitches, ri),      0, 0, &rowIterSwitch},
     {BLT_SWITCH_CUSTOM, "-columns", "columns", (char *)NULL,
@@ -514,6 +610,8 @@ typedef struct {
 
 static Blt_SwitchSpec restoreSwitches[] = 
 {
+    {BLT_SWITCH_BITS_NOARG, "-binary", "", (char *)NULL,
+        Blt_Offset(RestoreSwitches, flags), 0, TABLE_RESTORE_BINARY},
     {BLT_SWITCH_OBJ, "-data", "string", (char *)NULL,
         Blt_Offset(RestoreSwitches, dataObjPtr), 0, 0},
     {BLT_SWITCH_OBJ, "-file", "fileName", (char *)NULL,
@@ -535,6 +633,11 @@ typedef struct {
     Tcl_Obj *freqListVarObjPtr;         /* Specifies TCL variable to store
                                          * list of frequencies, one per
                                          * row. */
+    long limit;                         /* If >= 0, # of leading sorted
+                                         * rows wanted. */
+    long range[2];                      /* First and last sorted rows
+                                         * wanted. First is -1 if no range
+                                         * was given. */
 } SortSwitches;
 
 #define SORT_UNIQUE     (1<<16)         /* Indicates to output only the
@@ -573,10 +676,14 @@ static Blt_SwitchSpec sortSwitches[] =
         Blt_Offset(SortSwitches, returnType), 0, SORT_RETURN_INDICES},
     {BLT_SWITCH_VALUE, "-labels", "", (char *)NULL,
         Blt_Offset(SortSwitches, returnType), 0, SORT_RETURN_LABELS},
+    {BLT_SWITCH_LONG_NNEG, "-limit", "numRows", (char *)NULL,
+        Blt_Offset(SortSwitches, limit), 0},
     {BLT_SWITCH_BITS_NOARG, "-nocase", "", (char *)NULL,
         Blt_Offset(SortSwitches, tsFlags), 0, TABLE_SORT_IGNORECASE},
     {BLT_SWITCH_BITS_NOARG, "-nonempty", "", (char *)NULL,
         Blt_Offset(SortSwitches, flags), 0, SORT_NONEMPTY},
+    {BLT_SWITCH_CUSTOM, "-range", "{first last}", (char *)NULL,
+        Blt_Offset(SortSwitches, range), 0, 0, &sortRangeSwitch},
     {BLT_SWITCH_CUSTOM, "-rows", "", (char *)NULL,
         Blt_Offset(SortSwitches, ri), 0, 0, &rowIterSwitch},
     {BLT_SWITCH_BITS_NOARG, "-unique", "", (char *)NULL,
@@ -625,6 +732,8 @@ typedef struct {
     const char *tag;
     unsigned int flags;
     size_t maxMatches;
+    Blt_Chain matches;                  /* If non-NULL, collects the
+                                         * matching rows. */
 } FindSwitches;
 
 #define FIND_INVERT     (1<<0)
@@ -646,6 +755,37 @@ static Blt_SwitchSpec findSwitches[] =
     {BLT_SWITCH_END}
 };
 
+typedef struct {
+    Tcl_Obj *whereObjPtr;               /* If non-NULL, delete only the
+                                         * rows matching this expression. */
+    Tcl_Obj *emptyValueObjPtr;
+    unsigned int flags;
+} RowDeleteSwitches;
+
+static Blt_SwitchSpec rowDeleteSwitches[] = 
+{
+    {BLT_SWITCH_OBJ,    "-emptyvalue", "string", (char *)NULL,
+        Blt_Offset(RowDeleteSwitches, emptyValueObjPtr), 0},
+    {BLT_SWITCH_BITS_NOARG, "-invert", "", (char *)NULL,
+        Blt_Offset(RowDeleteSwitches, flags), 0, FIND_INVERT},
+    {BLT_SWITCH_OBJ,    "-where", "exprString", (char *)NULL,
+        Blt_Offset(RowDeleteSwitches, whereObjPtr), 0},
+    {BLT_SWITCH_END}
+};
+
+#define INDEX_UNIQUE    (1<<0)
+
+typedef struct {
+    unsigned int flags;
+} IndexSwitches;
+
+static Blt_SwitchSpec indexSwitches[] = 
+{
+    {BLT_SWITCH_BITS_NOARG, "-unique", "", (char *)NULL,
+        Blt_Offset(IndexSwitches, flags), 0, INDEX_UNIQUE},
+    {BLT_SWITCH_END}
+};
+
 static BLT_TABLE_TRACE_PROC TraceProc;
 static BLT_TABLE_TRACE_DELETE_PROC TraceDeleteProc;
 
@@ -1204,6 +1344,210 @@ ColumnTypeSwitchProc(
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetColumnEncodingFromObj --
+ *
+ *      Converts the name of a column encoding: "none" or "dictionary".
+ *
+ *---------------------------------------------------------------------------
+ */
+static const char *columnEncodingNames[] = {
+    "none", "dictionary", NULL
+};
+
+static int
+GetColumnEncodingFromObj(Tcl_Interp *interp, Tcl_Obj *objPtr, 
+                         BLT_TABLE_COLUMN_ENCODING *encodingPtr)
+{
+    const char *string;
+
+    string = Tcl_GetString(objPtr);
+    if (strcmp(string, "none") == 0) {
+        *encodingPtr = TABLE_COLUMN_ENCODING_NONE;
+    } else if (strcmp(string, "dictionary") == 0) {
+        *encodingPtr = TABLE_COLUMN_ENCODING_DICTIONARY;
+    } else {
+        Tcl_AppendResult(interp, "unknown column encoding \"", string, 
+                "\": should be none or dictionary", (char *)NULL);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ColumnEncodingSwitchProc --
+ *
+ *      Converts a Tcl_Obj representing how the values of a table column
+ *      are stored.
+ *
+ * Results:
+ *      The return value is a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+ColumnEncodingSwitchProc(
+    ClientData clientData,              /* Not used. */
+    Tcl_Interp *interp,                 /* Interpreter to report results. */
+    const char *switchName,             /* Not used. */
+    Tcl_Obj *objPtr,                    /* String representation */
+    char *record,                       /* Structure record */
+    int offset,                         /* Offset to field in structure */
+    int flags)                          /* Not used. */
+{
+    BLT_TABLE_COLUMN_ENCODING *encodingPtr = 
+        (BLT_TABLE_COLUMN_ENCODING *)(record + offset);
+
+    return GetColumnEncodingFromObj(interp, objPtr, encodingPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SortRangeSwitchProc --
+ *
+ *      Converts a Tcl_Obj representing the first and last positions of
+ *      the sorted rows to be returned.  Both are zero-based and "end" may
+ *      be used for the last.
+ *
+ * Results:
+ *      The return value is a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+SortRangeSwitchProc(
+    ClientData clientData,              /* Not used. */
+    Tcl_Interp *interp,                 /* Interpreter to report results. */
+    const char *switchName,             /* Not used. */
+    Tcl_Obj *objPtr,                    /* String representation */
+    char *record,                       /* Structure record */
+    int offset,                         /* Offset to field in structure */
+    int flags)                          /* Not used. */
+{
+    long *range = (long *)(record + offset);
+    Tcl_Obj **objv;
+    int objc;
+    long first, last;
+
+    if (Tcl_ListObjGetElements(interp, objPtr, &objc, &objv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (objc != 2) {
+        goto error;
+    }
+    if ((Blt_GetLongFromObj(NULL, objv[0], &first) != TCL_OK) || 
+        (first < 0)) {
+        goto error;
+    }
+    if (strcmp(Tcl_GetString(objv[1]), "end") == 0) {
+        last = -1;                      /* Last row. */
+    } else if ((Blt_GetLongFromObj(NULL, objv[1], &last) != TCL_OK) || 
+               (last < first)) {
+        goto error;
+    }
+    range[0] = first;
+    range[1] = last;
+    return TCL_OK;
+ error:
+    Tcl_AppendResult(interp, "bad range \"", Tcl_GetString(objPtr), 
+        "\": should be \"first last\"", (char *)NULL);
+    return TCL_ERROR;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * AggregateSwitchProc --
+ *
+ *      Converts the list of columns of an aggregate switch (-count, -sum,
+ *      -mean, -min, or -max) into aggregates appended to the chain.  The
+ *      result columns are labeled "column_switch".  For -count, "*" means
+ *      to count the rows of each group.
+ *
+ * Results:
+ *      The return value is a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+AggregateSwitchProc(
+    ClientData clientData,              /* Table of the columns. */
+    Tcl_Interp *interp,                 /* Interpreter to report results. */
+    const char *switchName,             /* Selects the type of aggregate. */
+    Tcl_Obj *objPtr,                    /* String representation */
+    char *record,                       /* Structure record */
+    int offset,                         /* Offset to field in structure */
+    int flags)                          /* Not used. */
+{
+    Blt_Chain *chainPtr = (Blt_Chain *)(record + offset);
+    BLT_TABLE table = clientData;
+    BLT_TABLE_AGGREGATE_TYPE type;
+    BLT_TABLE_AGGREGATE *aggPtr;
+    BLT_TABLE_ITERATOR iter;
+    BLT_TABLE_COLUMN col;
+    const char *suffix;
+    Tcl_Obj **objv;
+    int objc;
+
+    suffix = switchName + 1;
+    if (strcmp(suffix, "count") == 0) {
+        type = TABLE_AGGREGATE_COUNT;
+    } else if (strcmp(suffix, "sum") == 0) {
+        type = TABLE_AGGREGATE_SUM;
+    } else if (strcmp(suffix, "mean") == 0) {
+        type = TABLE_AGGREGATE_MEAN;
+    } else if (strcmp(suffix, "min") == 0) {
+        type = TABLE_AGGREGATE_MIN;
+    } else {
+        type = TABLE_AGGREGATE_MAX;
+    }
+    if (*chainPtr == NULL) {
+        *chainPtr = Blt_Chain_Create();
+    }
+    if ((type == TABLE_AGGREGATE_COUNT) &&
+        (strcmp(Tcl_GetString(objPtr), "*") == 0)) {
+        aggPtr = Blt_AssertMalloc(sizeof(BLT_TABLE_AGGREGATE) + 6);
+        aggPtr->type = type;
+        aggPtr->column = NULL;
+        aggPtr->label = (char *)(aggPtr + 1);
+        strcpy((char *)aggPtr->label, "count");
+        Blt_Chain_Append(*chainPtr, aggPtr);
+        return TCL_OK;
+    }
+    if (Tcl_ListObjGetElements(interp, objPtr, &objc, &objv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (blt_table_iterate_columns_objv(interp, table, objc, objv, &iter)
+        != TCL_OK) {
+        return TCL_ERROR;
+    }
+    for (col = blt_table_first_tagged_column(&iter); col != NULL; 
+         col = blt_table_next_tagged_column(&iter)) {
+        const char *label;
+        char *p;
+
+        label = blt_table_column_label(col);
+        aggPtr = Blt_AssertMalloc(sizeof(BLT_TABLE_AGGREGATE) + 
+                                  strlen(label) + strlen(suffix) + 2);
+        aggPtr->type = type;
+        aggPtr->column = col;
+        p = (char *)(aggPtr + 1);
+        sprintf(p, "%s_%s", label, suffix);
+        aggPtr->label = p;
+        Blt_Chain_Append(*chainPtr, aggPtr);
+    }
+    blt_table_free_iterator_objv(&iter);
+    return TCL_OK;
+}
+
 static int
 MakeRows(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr)
 {
@@ -1576,6 +1920,8 @@ GetTraceFlags(const char *string)
             flags |= TABLE_TRACE_UNSETS;        break;
         case 'C':
             flags |= TABLE_TRACE_CREATES;       break;
+        case 'E':
+            flags |= TABLE_TRACE_EACH_CELL;     break;
         default:
             return -1;
         }
@@ -1589,7 +1935,7 @@ GetTraceFlags(const char *string)
  * PrintTraceFlags --
  *
  *      Generates a string representation of the trace bit flags.  It's
- *      assumed that the provided string is at least 5 bytes.
+ *      assumed that the provided string is at least 7 bytes.
  *
  * Results:
  *      None.
@@ -1617,13 +1963,19 @@ PrintTraceFlags(unsigned int flags, char *string)
     if (flags & TABLE_TRACE_CREATES) {
         *p++ = 'c';
     } 
+    if (flags & TABLE_TRACE_EACH_CELL) {
+        *p++ = 'e';
+    } 
+    if (flags & TABLE_TRACE_BATCH) {
+        *p++ = 'b';
+    } 
     *p = '\0';
 }
 
 static void
 PrintTraceInfo(Tcl_Interp *interp, TraceInfo *tiPtr, Tcl_Obj *listObjPtr)
 {
-    char string[5];
+    char string[7];
     struct _BLT_TABLE_TRACE *tracePtr;
 
     Tcl_ListObjAppendElement(interp, listObjPtr, Tcl_NewStringObj("name", 4));
@@ -1700,17 +2052,33 @@ static int
 TraceProc(ClientData clientData, BLT_TABLE_TRACE_EVENT *eventPtr)
 {
     TraceInfo *tracePtr = clientData; 
-    char string[5];
+    char string[7];
     int result;
     Tcl_Obj *cmdObjPtr, *objPtr;
     Tcl_Interp *interp;
 
     interp = eventPtr->interp;
     cmdObjPtr = Tcl_DuplicateObj(tracePtr->cmdObjPtr);
-    objPtr = GetRowIndexObj(eventPtr->table, eventPtr->row);
-    Tcl_ListObjAppendElement(interp, cmdObjPtr, objPtr);
-    objPtr = GetColumnIndexObj(eventPtr->table, eventPtr->column);
-    Tcl_ListObjAppendElement(interp, cmdObjPtr, objPtr);
+    if (eventPtr->mask & TABLE_TRACE_BATCH) {
+        char range[200];
+
+        /* The event covers a range of rows and columns: "first-last". */
+        Blt_FmtString(range, 200, "%ld-%ld", 
+                blt_table_row_index(eventPtr->table, eventPtr->row),
+                blt_table_row_index(eventPtr->table, eventPtr->lastRow));
+        objPtr = Tcl_NewStringObj(range, -1);
+        Tcl_ListObjAppendElement(interp, cmdObjPtr, objPtr);
+        Blt_FmtString(range, 200, "%ld-%ld", 
+                blt_table_column_index(eventPtr->table, eventPtr->column),
+                blt_table_column_index(eventPtr->table, eventPtr->lastColumn));
+        objPtr = Tcl_NewStringObj(range, -1);
+        Tcl_ListObjAppendElement(interp, cmdObjPtr, objPtr);
+    } else {
+        objPtr = GetRowIndexObj(eventPtr->table, eventPtr->row);
+        Tcl_ListObjAppendElement(interp, cmdObjPtr, objPtr);
+        objPtr = GetColumnIndexObj(eventPtr->table, eventPtr->column);
+        Tcl_ListObjAppendElement(interp, cmdObjPtr, objPtr);
+    }
     PrintTraceFlags(eventPtr->mask, string);
     objPtr = Tcl_NewStringObj(string, -1);
     Tcl_ListObjAppendElement(interp, cmdObjPtr, objPtr);
@@ -1910,108 +2278,1717 @@ EvaluateExpr(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *exprObjPtr,
     return TCL_OK;
 }
 
-static int
-FindRows(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr, 
-         FindSwitches *switchesPtr)
-{
-    Blt_HashEntry *hPtr;
-    BLT_TABLE_ROW row;
-    TableCmdInterpData *dataPtr;
-    Tcl_Namespace *nsPtr;
-    Tcl_Obj *listObjPtr;
-    int isNew;
-    size_t numMatches;
-    int result = TCL_OK;
+/*
+ * Compiled find expressions --
+ *
+ *      Most "find" expressions are simple comparisons of column values
+ *      against constants.  Rather than evaluating the expression with
+ *      Tcl_ExprObj for every row (creating a Tcl_Obj for every column
+ *      referenced), the expression is compiled once into a small postfix
+ *      program.  The program runs over blocks of rows at a time: each
+ *      instruction is applied to a whole vector of values pulled straight
+ *      from the columns.
+ *
+ *      Only a subset of the TCL expression syntax is compiled: numbers,
+ *      string literals, column variables, parentheses, the arithmetic
+ *      operators + - * / %, the relational and equality operators, eq, ne,
+ *      !, &&, ||, and [string match ?-nocase? pattern $column].  Anything
+ *      else (or a column with read traces) makes the compiler give up, and
+ *      the expression is evaluated by TCL as before.
+ *
+ *      The program never guesses.  If a value can't be handled exactly as
+ *      TCL would (an empty cell, a string that isn't a plain decimal
+ *      number, an integer overflow, a division by zero), the result for
+ *      that row is marked unknown and just that row is evaluated by TCL.
+ */
+#define FIND_BLOCK_SIZE         256     /* # of rows evaluated at once. */
+
+#define FIND_TYPE_NUMBER        0       /* Numeric result. */
+#define FIND_TYPE_STRING        1       /* String result. */
+#define FIND_TYPE_COLUMN        2       /* Column value whose type
+                                         * depends upon where it's used. */
+
+typedef enum {
+    FIND_OP_NUMBER_COLUMN,              /* Push column values as numbers. */
+    FIND_OP_STRING_COLUMN,              /* Push column values as strings. */
+    FIND_OP_ROW_INDEX,                  /* Push row indices. */
+    FIND_OP_NUMBER,                     /* Push numeric constant. */
+    FIND_OP_STRING,                     /* Push string constant. */
+    FIND_OP_CODE_EQ, FIND_OP_CODE_NE,   /* Push comparison of a dictionary
+                                         * encoded column with the code of
+                                         * a string constant. */
+    FIND_OP_ADD, FIND_OP_SUB, FIND_OP_MUL, FIND_OP_DIV, FIND_OP_MOD,
+    FIND_OP_NEG, FIND_OP_NOT,
+    FIND_OP_LT, FIND_OP_GT, FIND_OP_LE, FIND_OP_GE, FIND_OP_EQ, FIND_OP_NE,
+    FIND_OP_STR_EQ, FIND_OP_STR_NE,
+    FIND_OP_MATCH,                      /* Glob match of string against
+                                         * pattern. */
+    FIND_OP_AND, FIND_OP_OR
+} FindOpcode;
 
-    Tcl_AddInterpResolvers(interp, TABLE_FIND_KEY, (Tcl_ResolveCmdProc*)NULL,
-        ColumnVarResolverProc, (Tcl_ResolveCompiledVarProc*)NULL);
+typedef struct {
+    FindOpcode op;
+    BLT_TABLE_COLUMN column;            /* Column to be loaded. */
+    int isInt;                          /* Numeric constant. */
+    int64_t i;
+    double d;
+    Tcl_Obj *objPtr;                    /* String constant or pattern. */
+    int nocase;                         /* Pattern match ignores case. */
+} FindInstr;
 
-    dataPtr = GetTableCmdInterpData(interp);
-    nsPtr = Tcl_GetCurrentNamespace(interp);
-    hPtr = Blt_CreateHashEntry(&dataPtr->findTable, nsPtr, &isNew);
-    assert(isNew);
-    Blt_SetHashValue(hPtr, switchesPtr);
+typedef struct {
+    BLT_TABLE table;
+    FindInstr *instrs;                  /* Postfix program. */
+    int numInstrs;
+    int numAllocated;
+    int depth, maxDepth;                /* Current and maximum depth of
+                                         * the evaluation stack. */
+    const char *p;                      /* Current parse position. */
+    FindSwitches *switchesPtr;
+} FindProgram;
 
-    /* Now process each row, evaluating the expression. */
-    listObjPtr = Tcl_NewListObj(0, (Tcl_Obj **) NULL);
-    numMatches = 0;
-    for (row = blt_table_first_tagged_row(&switchesPtr->iter); row != NULL; 
-         row = blt_table_next_tagged_row(&switchesPtr->iter)) {
-        int bool;
-        
-        switchesPtr->row = row;
-        result = EvaluateExpr(interp, table, objPtr, &bool);
-        if (result != TCL_OK) {
-            break;
-        }
-        if (switchesPtr->flags & FIND_INVERT) {
-            bool = !bool;
-        }
-        if (bool) {
-            Tcl_Obj *objPtr;
+/* Vector of values on the evaluation stack. */
+typedef struct {
+    unsigned char unknown[FIND_BLOCK_SIZE]; /* Value can't be computed
+                                             * here. */
+    unsigned char isInt[FIND_BLOCK_SIZE];
+    int64_t i[FIND_BLOCK_SIZE];
+    double d[FIND_BLOCK_SIZE];
+    const char *s[FIND_BLOCK_SIZE];
+    int length[FIND_BLOCK_SIZE];
+} FindVector;
 
-            if (switchesPtr->tag != NULL) {
-                result = blt_table_set_row_tag(interp, table, row,
-                        switchesPtr->tag);
-                if (result != TCL_OK) {
-                    break;
-                }
-            }
-            numMatches++;
-            objPtr = GetRowIndexObj(table, row);
-            Tcl_ListObjAppendElement(interp, listObjPtr, objPtr);
-            if ((switchesPtr->maxMatches > 0) && 
-                (numMatches >= switchesPtr->maxMatches)) {
-                break;
-            }
+/* Magnitude below which a 64-bit integer converts exactly to a double. */
+#define FIND_EXACT_DOUBLE       ((int64_t)1 << 53)
+
+static int ParseFindOr(FindProgram *progPtr);
+
+static void
+FreeFindProgram(FindProgram *progPtr)
+{
+    int i;
+
+    for (i = 0; i < progPtr->numInstrs; i++) {
+        if (progPtr->instrs[i].objPtr != NULL) {
+            Tcl_DecrRefCount(progPtr->instrs[i].objPtr);
         }
     }
-    if (result != TCL_OK) {
-        Tcl_DecrRefCount(listObjPtr);
-    } else {
-        Tcl_SetObjResult(interp, listObjPtr);
-    }
-    /* Clean up. */
-    Blt_DeleteHashEntry(&dataPtr->findTable, hPtr);
-    Blt_FreeCachedVars(&switchesPtr->varTable);
-    if (!Tcl_RemoveInterpResolvers(interp, TABLE_FIND_KEY)) {
-        Tcl_AppendResult(interp, "can't delete resolver scheme", 
-                (char *)NULL);
-        return TCL_ERROR;
+    if (progPtr->instrs != NULL) {
+        Blt_Free(progPtr->instrs);
     }
-    return result;
+    Blt_Free(progPtr);
 }
 
-static int
-AppendColumn(Tcl_Interp *interp, BLT_TABLE src, BLT_TABLE dst,
-    BLT_TABLE_COLUMN srcCol,            /* Column in the source table. */
-    BLT_TABLE_COLUMN dstCol)            /* Column in the dstination table. */
+static FindInstr *
+EmitFindInstr(FindProgram *progPtr, FindOpcode op)
 {
-    size_t i, j, oldNumRows, need;
-    BLT_TABLE_COLUMN_TYPE type;
-    
-    oldNumRows = blt_table_num_rows(src);
-    need = oldNumRows + blt_table_num_rows(dst);
-    if (blt_table_extend_rows(interp, dst, need, NULL) != TCL_OK) {
-        return TCL_ERROR;
-    }
-    for (i = 0, j = oldNumRows; i < blt_table_num_rows(src); i++, j++) {
-        BLT_TABLE_ROW srcRow, dstRow;
-        BLT_TABLE_VALUE value;
+    FindInstr *instrPtr;
 
-        srcRow = blt_table_row(src, i);
-        value = blt_table_get_value(src, srcRow, srcCol);
-        if (value == NULL) {
-            continue;
-        }
-        dstRow = blt_table_row(dst, j);
-        if (blt_table_set_value(dst, dstRow, dstCol, value) != TCL_OK) {
-            return TCL_ERROR;
-        }
+    if (progPtr->numInstrs >= progPtr->numAllocated) {
+        progPtr->numAllocated = (progPtr->numAllocated == 0) ? 16 :
+            progPtr->numAllocated * 2;
+        progPtr->instrs = Blt_AssertRealloc(progPtr->instrs, 
+                progPtr->numAllocated * sizeof(FindInstr));
     }
-    type = blt_table_column_type(dstCol);
-    if (blt_table_set_column_type(interp, dst, dstCol, type) != TCL_OK) {
-        return TCL_ERROR;
+    instrPtr = progPtr->instrs + progPtr->numInstrs;
+    progPtr->numInstrs++;
+    memset(instrPtr, 0, sizeof(FindInstr));
+    instrPtr->op = op;
+    switch (op) {
+    case FIND_OP_NUMBER_COLUMN:
+    case FIND_OP_STRING_COLUMN:
+    case FIND_OP_ROW_INDEX:
+    case FIND_OP_NUMBER:
+    case FIND_OP_STRING:
+    case FIND_OP_CODE_EQ:
+    case FIND_OP_CODE_NE:
+        progPtr->depth++;
+        if (progPtr->depth > progPtr->maxDepth) {
+            progPtr->maxDepth = progPtr->depth;
+        }
+        break;
+    case FIND_OP_NEG:
+    case FIND_OP_NOT:
+    case FIND_OP_MATCH:
+        break;
+    default:
+        progPtr->depth--;               /* Binary operators. */
+        break;
+    }
+    return instrPtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ParseDecimalNumber --
+ *
+ *      Parses a string that is a plain decimal integer or floating point
+ *      number, without surrounding whitespace.  Other forms that TCL
+ *      accepts as numbers (hexadecimal, octal, etc.) are rejected, so the
+ *      caller can let TCL handle them.
+ *
+ * Results:
+ *      Returns 1 for an integer (stored in *intPtr), 2 for a double
+ *      (stored in *doublePtr), and 0 if the string isn't a plain number.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ParseDecimalNumber(const char *string, int length, int64_t *intPtr, 
+                   double *doublePtr)
+{
+    const char *p, *end, *digits;
+    int numDigits, numFracDigits, isDouble;
+
+    p = string;
+    end = string + length;
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+        p++;
+    }
+    digits = p;
+    while ((p < end) && (isdigit(UCHAR(*p)))) {
+        p++;
+    }
+    numDigits = p - digits;
+    numFracDigits = 0;
+    isDouble = FALSE;
+    if ((p < end) && (*p == '.')) {
+        const char *frac;
+
+        isDouble = TRUE;
+        frac = ++p;
+        while ((p < end) && (isdigit(UCHAR(*p)))) {
+            p++;
+        }
+        numFracDigits = p - frac;
+    }
+    if ((numDigits + numFracDigits) == 0) {
+        return 0;
+    }
+    if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+        const char *exp;
+
+        isDouble = TRUE;
+        p++;
+        if ((p < end) && ((*p == '-') || (*p == '+'))) {
+            p++;
+        }
+        exp = p;
+        while ((p < end) && (isdigit(UCHAR(*p)))) {
+            p++;
+        }
+        if (p == exp) {
+            return 0;
+        }
+    }
+    if (p != end) {
+        return 0;
+    }
+    if ((numDigits > 1) && (digits[0] == '0') && (numFracDigits == 0)) {
+        return 0;                       /* Octal or leading zeros. */
+    }
+    if (isDouble) {
+        char buf[200];
+
+        if (length >= (int)sizeof(buf)) {
+            return 0;
+        }
+        memcpy(buf, string, length);
+        buf[length] = '\0';
+        *doublePtr = strtod(buf, NULL);
+        return 2;
+    } else {
+        int64_t i;
+
+        if (numDigits > 18) {
+            return 0;                   /* May not fit in 64 bits. */
+        }
+        i = 0;
+        for (p = digits; p < end; p++) {
+            i = (i * 10) + (*p - '0');
+        }
+        *intPtr = (string[0] == '-') ? -i : i;
+        return 1;
+    }
+}
+
+static void
+SkipFindSpace(FindProgram *progPtr)
+{
+    while (isspace(UCHAR(*progPtr->p))) {
+        progPtr->p++;
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ParseFindWord --
+ *
+ *      Parses a braced or double-quoted string, or a bare word.  Only
+ *      strings without substitutions are accepted.
+ *
+ * Results:
+ *      Returns a new Tcl_Obj containing the string, or NULL if the word
+ *      can't be compiled.
+ *
+ *---------------------------------------------------------------------------
+ */
+static Tcl_Obj *
+ParseFindWord(FindProgram *progPtr)
+{
+    const char *p, *start;
+
+    SkipFindSpace(progPtr);
+    p = progPtr->p;
+    if (*p == '{') {
+        int level;
+
+        start = p + 1;
+        level = 1;
+        for (p = start; *p != '\0'; p++) {
+            if (*p == '\\') {
+                return NULL;
+            } else if (*p == '{') {
+                level++;
+            } else if ((*p == '}') && (--level == 0)) {
+                break;
+            }
+        }
+        if (*p != '}') {
+            return NULL;
+        }
+        progPtr->p = p + 1;
+        return Tcl_NewStringObj(start, p - start);
+    } 
+    if (*p == '"') {
+        start = p + 1;
+        for (p = start; (*p != '"') && (*p != '\0'); p++) {
+            if ((*p == '\\') || (*p == '$') || (*p == '[')) {
+                return NULL;
+            }
+        }
+        if (*p != '"') {
+            return NULL;
+        }
+        progPtr->p = p + 1;
+        return Tcl_NewStringObj(start, p - start);
+    }
+    start = p;
+    while ((*p != '\0') && (!isspace(UCHAR(*p))) && (*p != ']')) {
+        if ((*p == '\\') || (*p == '$') || (*p == '[') || (*p == '{') ||
+            (*p == '"') || (*p == ';')) {
+            return NULL;
+        }
+        p++;
+    }
+    if (p == start) {
+        return NULL;
+    }
+    progPtr->p = p;
+    return Tcl_NewStringObj(start, p - start);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ParseFindVariable --
+ *
+ *      Parses a $name or ${name} variable reference and resolves it to a
+ *      column the same way ColumnVarResolverProc does.
+ *
+ * Results:
+ *      Returns FIND_TYPE_COLUMN or FIND_TYPE_NUMBER (for ${#}), or -1 if
+ *      the variable doesn't refer to a column.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ParseFindVariable(FindProgram *progPtr)
+{
+    BLT_TABLE_COLUMN col;
+    FindInstr *instrPtr;
+    Tcl_DString ds;
+    const char *p, *name, *prefix;
+    long index;
+    int prefixLen;
+
+    p = progPtr->p + 1;                 /* Skip the $ */
+    Tcl_DStringInit(&ds);
+    if (*p == '{') {
+        const char *start;
+
+        start = ++p;
+        while ((*p != '}') && (*p != '\0')) {
+            p++;
+        }
+        if (*p != '}') {
+            return -1;
+        }
+        Tcl_DStringAppend(&ds, start, p - start);
+        p++;
+    } else {
+        const char *start;
+
+        start = p;
+        for (;;) {
+            if ((isalnum(UCHAR(*p))) || (*p == '_')) {
+                p++;
+            } else if ((p[0] == ':') && (p[1] == ':')) {
+                while (*p == ':') {
+                    p++;
+                }
+            } else {
+                break;
+            }
+        }
+        if ((p == start) || (*p == '(')) {
+            return -1;                  /* Array elements aren't
+                                         * columns. */
+        }
+        Tcl_DStringAppend(&ds, start, p - start);
+    }
+    progPtr->p = p;
+    name = Tcl_DStringValue(&ds);
+    if (strcmp(name, "#") == 0) {
+        Tcl_DStringFree(&ds);
+        EmitFindInstr(progPtr, FIND_OP_ROW_INDEX);
+        return FIND_TYPE_NUMBER;
+    }
+    prefix = NULL;
+    prefixLen = 0;
+    if (progPtr->switchesPtr->prefixObjPtr != NULL) {
+        prefix = Tcl_GetStringFromObj(progPtr->switchesPtr->prefixObjPtr, 
+                                      &prefixLen);
+    }
+    col = NULL;
+    if ((isdigit(UCHAR(name[0]))) &&
+        (Blt_GetLong(NULL, name, &index) == TCL_OK)) {
+        col = blt_table_get_column_by_index(progPtr->table, index);
+    } else if (prefixLen == 0) {
+        col = blt_table_get_column_by_label(progPtr->table, name);
+    } else if (strncmp(name, prefix, prefixLen) == 0) {
+        col = blt_table_get_column_by_label(progPtr->table, name + prefixLen);
+    }
+    Tcl_DStringFree(&ds);
+    if ((col == NULL) || 
+        (blt_table_column_type(col) == TABLE_COLUMN_TYPE_BLOB)) {
+        return -1;
+    }
+    instrPtr = EmitFindInstr(progPtr, FIND_OP_NUMBER_COLUMN);
+    instrPtr->column = col;
+    return FIND_TYPE_COLUMN;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CoerceFindOperand --
+ *
+ *      Makes sure that the operand, ending at the given instruction, is of
+ *      the requested type.  Column values are converted by changing the
+ *      instruction that loads them.  Numeric columns can't be used as
+ *      strings since their string representation may differ from what
+ *      TCL would generate.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+CoerceFindOperand(FindProgram *progPtr, int instr, int type, int wanted)
+{
+    FindInstr *instrPtr;
+
+    if (type == wanted) {
+        return TRUE;
+    }
+    if (type != FIND_TYPE_COLUMN) {
+        return FALSE;
+    }
+    instrPtr = progPtr->instrs + instr;
+    if (wanted == FIND_TYPE_NUMBER) {
+        instrPtr->op = FIND_OP_NUMBER_COLUMN;
+        return TRUE;
+    }
+    if (blt_table_column_type(instrPtr->column) != TABLE_COLUMN_TYPE_STRING) {
+        return FALSE;
+    }
+    instrPtr->op = FIND_OP_STRING_COLUMN;
+    return TRUE;
+}
+
+static int
+ParseFindMatch(FindProgram *progPtr)
+{
+    Tcl_Obj *objPtr;
+    const char *p;
+    int nocase, type;
+    FindInstr *instrPtr;
+
+    /* [string match ?-nocase? pattern $column] */
+    p = progPtr->p + 1;
+    while (isspace(UCHAR(*p))) {
+        p++;
+    }
+    if ((strncmp(p, "string", 6) != 0) || (!isspace(UCHAR(p[6])))) {
+        return -1;
+    }
+    p += 6;
+    while (isspace(UCHAR(*p))) {
+        p++;
+    }
+    if ((strncmp(p, "match", 5) != 0) || (!isspace(UCHAR(p[5])))) {
+        return -1;
+    }
+    progPtr->p = p + 5;
+    SkipFindSpace(progPtr);
+    nocase = FALSE;
+    if ((strncmp(progPtr->p, "-nocase", 7) == 0) && 
+        (isspace(UCHAR(progPtr->p[7])))) {
+        nocase = TRUE;
+        progPtr->p += 7;
+    }
+    objPtr = ParseFindWord(progPtr);
+    if (objPtr == NULL) {
+        return -1;
+    }
+    Tcl_IncrRefCount(objPtr);
+    SkipFindSpace(progPtr);
+    if ((*progPtr->p != '$') || 
+        ((type = ParseFindVariable(progPtr)) != FIND_TYPE_COLUMN) ||
+        (!CoerceFindOperand(progPtr, progPtr->numInstrs - 1, type, 
+                            FIND_TYPE_STRING))) {
+        Tcl_DecrRefCount(objPtr);
+        return -1;
+    }
+    SkipFindSpace(progPtr);
+    if (*progPtr->p != ']') {
+        Tcl_DecrRefCount(objPtr);
+        return -1;
+    }
+    progPtr->p++;
+    instrPtr = EmitFindInstr(progPtr, FIND_OP_MATCH);
+    instrPtr->objPtr = objPtr;
+    instrPtr->nocase = nocase;
+    return FIND_TYPE_NUMBER;
+}
+
+static int
+ParseFindPrimary(FindProgram *progPtr)
+{
+    const char *p, *start;
+    int type;
+
+    SkipFindSpace(progPtr);
+    p = start = progPtr->p;
+    if (*p == '(') {
+        progPtr->p++;
+        type = ParseFindOr(progPtr);
+        SkipFindSpace(progPtr);
+        if ((type < 0) || (*progPtr->p != ')')) {
+            return -1;
+        }
+        progPtr->p++;
+        return type;
+    }
+    if (*p == '$') {
+        return ParseFindVariable(progPtr);
+    }
+    if (*p == '[') {
+        return ParseFindMatch(progPtr);
+    }
+    if ((*p == '"') || (*p == '{') || (isdigit(UCHAR(*p))) || 
+        ((*p == '.') && (isdigit(UCHAR(p[1]))))) {
+        FindInstr *instrPtr;
+        Tcl_Obj *objPtr;
+        const char *string;
+        int length, result;
+        int64_t i;
+        double d;
+
+        i = 0, d = 0.0;
+        if ((*p == '"') || (*p == '{')) {
+            objPtr = ParseFindWord(progPtr);
+        } else {
+            /* Bare number. */
+            while ((isalnum(UCHAR(*p))) || (*p == '.') ||
+                   (((*p == '-') || (*p == '+')) && 
+                    ((p[-1] == 'e') || (p[-1] == 'E')))) {
+                p++;
+            }
+            progPtr->p = p;
+            objPtr = Tcl_NewStringObj(start, p - start);
+        }
+        if (objPtr == NULL) {
+            return -1;
+        }
+        string = Tcl_GetStringFromObj(objPtr, &length);
+        result = ParseDecimalNumber(string, length, &i, &d);
+        if (result > 0) {
+            instrPtr = EmitFindInstr(progPtr, FIND_OP_NUMBER);
+            instrPtr->isInt = (result == 1);
+            instrPtr->i = i;
+            instrPtr->d = d;
+            Tcl_DecrRefCount(objPtr);
+            return FIND_TYPE_NUMBER;
+        }
+        if ((*start == '"') || (*start == '{')) {
+            /* Strings that look like other kinds of numbers are left to
+             * TCL. */
+            if (Tcl_GetDoubleFromObj(NULL, objPtr, &d) == TCL_OK) {
+                Tcl_DecrRefCount(objPtr);
+                return -1;
+            }
+            instrPtr = EmitFindInstr(progPtr, FIND_OP_STRING);
+            instrPtr->objPtr = objPtr;
+            Tcl_IncrRefCount(objPtr);
+            return FIND_TYPE_STRING;
+        }
+        Tcl_DecrRefCount(objPtr);
+        return -1;
+    }
+    return -1;
+}
+
+static int
+ParseFindUnary(FindProgram *progPtr)
+{
+    int type;
+    char c;
+
+    SkipFindSpace(progPtr);
+    c = *progPtr->p;
+    if ((c == '!') || (c == '-') || (c == '+')) {
+        progPtr->p++;
+        type = ParseFindUnary(progPtr);
+        if (!CoerceFindOperand(progPtr, progPtr->numInstrs - 1, type, 
+                               FIND_TYPE_NUMBER)) {
+            return -1;
+        }
+        if (c == '!') {
+            EmitFindInstr(progPtr, FIND_OP_NOT);
+        } else if (c == '-') {
+            EmitFindInstr(progPtr, FIND_OP_NEG);
+        }
+        return FIND_TYPE_NUMBER;
+    }
+    return ParseFindPrimary(progPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ParseFindBinary --
+ *
+ *      Parses a left-associative sequence of operands and operators of
+ *      the same precedence.  The table of operators lists the operator
+ *      strings and opcodes for the precedence level.
+ *
+ *---------------------------------------------------------------------------
+ */
+typedef struct {
+    const char *name;                   /* Operator string. */
+    FindOpcode op;                      /* Numeric opcode. */
+    int strOp;                          /* Opcode if the operands are
+                                         * strings, or -1 if operator
+                                         * requires numbers. */
+} FindOperator;
+
+static FindOperator findMulOps[] = {
+    {"*", FIND_OP_MUL, -1}, {"/", FIND_OP_DIV, -1}, {"%", FIND_OP_MOD, -1}, 
+    {NULL}
+};
+static FindOperator findAddOps[] = {
+    {"+", FIND_OP_ADD, -1}, {"-", FIND_OP_SUB, -1}, {NULL}
+};
+static FindOperator findRelOps[] = {
+    {"<=", FIND_OP_LE, -1}, {">=", FIND_OP_GE, -1}, 
+    {"<", FIND_OP_LT, -1}, {">", FIND_OP_GT, -1}, {NULL}
+};
+static FindOperator findEqualOps[] = {
+    {"==", FIND_OP_EQ, FIND_OP_STR_EQ}, {"!=", FIND_OP_NE, FIND_OP_STR_NE}, 
+    {NULL}
+};
+static FindOperator findStrEqualOps[] = {
+    {"eq", FIND_OP_STR_EQ, FIND_OP_STR_EQ}, 
+    {"ne", FIND_OP_STR_NE, FIND_OP_STR_NE}, {NULL}
+};
+static FindOperator findAndOps[] = {
+    {"&&", FIND_OP_AND, -1}, {NULL}
+};
+static FindOperator findOrOps[] = {
+    {"||", FIND_OP_OR, -1}, {NULL}
+};
+
+static FindOperator *findOpLevels[] = {
+    findOrOps, findAndOps, findStrEqualOps, findEqualOps, findRelOps,
+    findAddOps, findMulOps, NULL
+};
+
+static FindOperator *
+MatchFindOperator(FindProgram *progPtr, FindOperator *ops)
+{
+    FindOperator *opPtr;
+    const char *p;
+
+    SkipFindSpace(progPtr);
+    p = progPtr->p;
+    for (opPtr = ops; opPtr->name != NULL; opPtr++) {
+        size_t length;
+        char next;
+
+        length = strlen(opPtr->name);
+        if (strncmp(p, opPtr->name, length) != 0) {
+            continue;
+        }
+        next = p[length];
+        if (isalpha(UCHAR(opPtr->name[0]))) {
+            if ((isalnum(UCHAR(next))) || (next == '_')) {
+                continue;
+            }
+        } else if ((next == '*') || (next == '<') || (next == '>') ||
+                   (next == '=') || (next == '&') || (next == '|')) {
+            continue;                   /* Part of a longer operator
+                                         * (e.g. "**", "<<", "<=") */
+        }
+        progPtr->p += length;
+        return opPtr;
+    }
+    return NULL;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FoldFindCodeCompare --
+ *
+ *      Replaces the string comparison of a dictionary encoded column and a
+ *      string constant, the last two instructions of the program, with a
+ *      comparison of dictionary codes.  The constant is then looked up
+ *      just once, instead of comparing strings for each row.
+ *
+ * Results:
+ *      Returns 1 if the comparison was replaced, 0 otherwise.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+FoldFindCodeCompare(FindProgram *progPtr, int first, FindOpcode op)
+{
+    FindInstr *colInstrPtr, *strInstrPtr, *instrPtr;
+    BLT_TABLE_COLUMN col;
+    long code;
+
+    colInstrPtr = progPtr->instrs + first;
+    strInstrPtr = colInstrPtr + 1;
+    if (colInstrPtr->op == FIND_OP_STRING) {
+        colInstrPtr = strInstrPtr;
+        strInstrPtr = progPtr->instrs + first;
+    }
+    if ((colInstrPtr->op != FIND_OP_STRING_COLUMN) ||
+        (strInstrPtr->op != FIND_OP_STRING) ||
+        (blt_table_column_encoding(colInstrPtr->column) != 
+         TABLE_COLUMN_ENCODING_DICTIONARY)) {
+        return FALSE;
+    }
+    col = colInstrPtr->column;
+    code = blt_table_dictionary_code(col, Tcl_GetString(strInstrPtr->objPtr));
+    Tcl_DecrRefCount(strInstrPtr->objPtr);
+    progPtr->numInstrs = first;
+    progPtr->depth -= 2;
+    instrPtr = EmitFindInstr(progPtr, 
+        (op == FIND_OP_STR_EQ) ? FIND_OP_CODE_EQ : FIND_OP_CODE_NE);
+    instrPtr->column = col;
+    instrPtr->i = code;
+    return TRUE;
+}
+
+static int
+ParseFindBinary(FindProgram *progPtr, int level)
+{
+    FindOperator *ops, *opPtr;
+    int left;
+    int leftInstr;
+
+    ops = findOpLevels[level];
+    if (ops == NULL) {
+        return ParseFindUnary(progPtr);
+    }
+    left = ParseFindBinary(progPtr, level + 1);
+    leftInstr = progPtr->numInstrs - 1;
+    while ((left >= 0) && ((opPtr = MatchFindOperator(progPtr, ops)) != NULL)){
+        int right, rightInstr;
+        FindOpcode op;
+
+        right = ParseFindBinary(progPtr, level + 1);
+        if (right < 0) {
+            return -1;
+        }
+        rightInstr = progPtr->numInstrs - 1;
+        op = opPtr->op;
+        if ((int)opPtr->op == opPtr->strOp) {
+            /* eq, ne: always compare strings. */
+            if ((!CoerceFindOperand(progPtr, leftInstr, left, 
+                                    FIND_TYPE_STRING)) ||
+                (!CoerceFindOperand(progPtr, rightInstr, right, 
+                                    FIND_TYPE_STRING))) {
+                return -1;
+            }
+        } else if ((left == FIND_TYPE_STRING) || (right == FIND_TYPE_STRING)) {
+            /* A non-numeric string constant: ==, != compare strings. */
+            if ((opPtr->strOp < 0) ||
+                (!CoerceFindOperand(progPtr, leftInstr, left, 
+                                    FIND_TYPE_STRING)) ||
+                (!CoerceFindOperand(progPtr, rightInstr, right, 
+                                    FIND_TYPE_STRING))) {
+                return -1;
+            }
+            op = opPtr->strOp;
+        } else {
+            CoerceFindOperand(progPtr, leftInstr, left, FIND_TYPE_NUMBER);
+            CoerceFindOperand(progPtr, rightInstr, right, FIND_TYPE_NUMBER);
+        }
+        if (((op != FIND_OP_STR_EQ) && (op != FIND_OP_STR_NE)) ||
+            (rightInstr != leftInstr + 1) ||
+            (!FoldFindCodeCompare(progPtr, leftInstr, op))) {
+            EmitFindInstr(progPtr, op);
+        }
+        left = FIND_TYPE_NUMBER;
+        leftInstr = progPtr->numInstrs - 1;
+    }
+    return left;
+}
+
+static int
+ParseFindOr(FindProgram *progPtr)
+{
+    return ParseFindBinary(progPtr, 0);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TableHasReadTraces --
+ *
+ *      Indicates if any client of the table has read traces.  Read traces
+ *      must fire for every value the expression looks at, so compiled
+ *      expressions can't be used.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+TableHasReadTraces(BLT_TABLE table)
+{
+    Blt_ChainLink link;
+
+    for (link = Blt_Chain_FirstLink(table->corePtr->clients); link != NULL;
+         link = Blt_Chain_NextLink(link)) {
+        BLT_TABLE client;
+
+        client = Blt_Chain_GetValue(link);
+        if (Blt_Chain_GetLength(client->readTraces) > 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CompileFindExpr --
+ *
+ *      Compiles the find expression into a postfix program.
+ *
+ * Results:
+ *      Returns the compiled program, or NULL if the expression can't be
+ *      compiled.  No error message is left: the expression is then
+ *      evaluated by TCL.
+ *
+ *---------------------------------------------------------------------------
+ */
+static FindProgram *
+CompileFindExpr(BLT_TABLE table, Tcl_Obj *exprObjPtr, 
+                FindSwitches *switchesPtr)
+{
+    FindProgram *progPtr;
+    int type;
+
+    if (TableHasReadTraces(table)) {
+        return NULL;
+    }
+    progPtr = Blt_AssertCalloc(1, sizeof(FindProgram));
+    progPtr->table = table;
+    progPtr->switchesPtr = switchesPtr;
+    progPtr->p = Tcl_GetString(exprObjPtr);
+    type = ParseFindOr(progPtr);
+    SkipFindSpace(progPtr);
+    if ((type < 0) || (*progPtr->p != '\0') || (progPtr->depth != 1) ||
+        (!CoerceFindOperand(progPtr, progPtr->numInstrs - 1, type, 
+                            FIND_TYPE_NUMBER))) {
+        FreeFindProgram(progPtr);
+        return NULL;
+    }
+    return progPtr;
+}
+
+static void
+LoadFindNumbers(BLT_TABLE table, BLT_TABLE_COLUMN col, BLT_TABLE_ROW *rows,
+                int numRows, FindVector *vecPtr)
+{
+    BLT_TABLE_COLUMN_TYPE type;
+    int j;
+
+    type = blt_table_column_type(col);
+    for (j = 0; j < numRows; j++) {
+        BLT_TABLE_VALUE value;
+        int result;
+
+        vecPtr->unknown[j] = FALSE;
+        vecPtr->isInt[j] = TRUE;
+        if (!blt_table_value_exists(table, rows[j], col)) {
+            vecPtr->unknown[j] = TRUE;
+            continue;
+        }
+        switch (type) {
+        case TABLE_COLUMN_TYPE_DOUBLE:
+        case TABLE_COLUMN_TYPE_TIME:
+            vecPtr->d[j] = blt_table_get_double(NULL, table, rows[j], col);
+            vecPtr->isInt[j] = FALSE;
+            vecPtr->unknown[j] = (vecPtr->d[j] != vecPtr->d[j]); /* NaN */
+            break;
+        case TABLE_COLUMN_TYPE_LONG:
+            vecPtr->i[j] = blt_table_get_long(NULL, table, rows[j], col, 0);
+            break;
+        case TABLE_COLUMN_TYPE_INT64:
+            vecPtr->i[j] = blt_table_get_int64(NULL, table, rows[j], col, 0);
+            break;
+        case TABLE_COLUMN_TYPE_BOOLEAN:
+            vecPtr->i[j] = blt_table_get_boolean(NULL, table, rows[j], col, 0);
+            break;
+        default:
+            value = blt_table_get_value(table, rows[j], col);
+            result = ParseDecimalNumber(blt_table_value_string(value), 
+                blt_table_value_length(value), vecPtr->i + j, vecPtr->d + j);
+            vecPtr->unknown[j] = (result == 0);
+            vecPtr->isInt[j] = (result == 1);
+            break;
+        }
+    }
+}
+
+static void
+LoadFindStrings(BLT_TABLE table, BLT_TABLE_COLUMN col, BLT_TABLE_ROW *rows,
+                int numRows, FindVector *vecPtr)
+{
+    int j;
+
+    for (j = 0; j < numRows; j++) {
+        BLT_TABLE_VALUE value;
+
+        vecPtr->unknown[j] = !blt_table_value_exists(table, rows[j], col);
+        if (vecPtr->unknown[j]) {
+            continue;
+        }
+        value = blt_table_get_value(table, rows[j], col);
+        vecPtr->s[j] = blt_table_value_string(value);
+        vecPtr->length[j] = blt_table_value_length(value);
+    }
+}
+
+#define FindDouble(v,j)  (((v)->isInt[j]) ? (double)(v)->i[j] : (v)->d[j])
+#define FindTruth(v,j)   (((v)->isInt[j]) ? ((v)->i[j] != 0) : ((v)->d[j] != 0.0))
+
+static void
+SetFindBoolean(FindVector *vecPtr, int j, int bool)
+{
+    vecPtr->isInt[j] = TRUE;
+    vecPtr->i[j] = bool;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FindArithmetic --
+ *
+ *      Applies the arithmetic operator to each pair of values, storing
+ *      the result in the first vector.  Integer results that would
+ *      overflow 64 bits (TCL would switch to bignums), integer division
+ *      by zero, and NaN results are marked unknown.  Integer division
+ *      and remainder round toward negative infinity, as in TCL.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+FindArithmetic(FindOpcode op, FindVector *a, FindVector *b, int numRows)
+{
+    int j;
+
+    for (j = 0; j < numRows; j++) {
+        if ((a->unknown[j]) || (b->unknown[j])) {
+            a->unknown[j] = TRUE;
+            continue;
+        }
+        if ((a->isInt[j]) && (b->isInt[j])) {
+            int64_t x, y, r;
+
+            x = a->i[j], y = b->i[j];
+            r = 0;
+            switch (op) {
+            case FIND_OP_ADD:
+                if (((y > 0) && (x > INT64_MAX - y)) ||
+                    ((y < 0) && (x < INT64_MIN - y))) {
+                    a->unknown[j] = TRUE;
+                }
+                r = x + y;
+                break;
+            case FIND_OP_SUB:
+                if (((y < 0) && (x > INT64_MAX + y)) ||
+                    ((y > 0) && (x < INT64_MIN + y))) {
+                    a->unknown[j] = TRUE;
+                }
+                r = x - y;
+                break;
+            case FIND_OP_MUL:
+                /* The product of the doubles is close enough to tell if
+                 * the integer product fits. */
+                if (fabs((double)x * (double)y) >= 9.2e18) {
+                    a->unknown[j] = TRUE;
+                    break;
+                }
+                r = x * y;
+                break;
+            case FIND_OP_DIV:
+            case FIND_OP_MOD:
+                if ((y == 0) || ((x == INT64_MIN) && (y == -1))) {
+                    a->unknown[j] = TRUE;
+                    break;
+                }
+                if (op == FIND_OP_DIV) {
+                    r = x / y;
+                    if (((x % y) != 0) && ((x < 0) != (y < 0))) {
+                        r--;
+                    }
+                } else {
+                    r = x % y;
+                    if ((r != 0) && ((r < 0) != (y < 0))) {
+                        r += y;
+                    }
+                }
+                break;
+            default:
+                break;
+            }
+            a->i[j] = r;
+        } else {
+            double x, y, r;
+
+            if (op == FIND_OP_MOD) {
+                a->unknown[j] = TRUE;   /* Error in TCL. */
+                continue;
+            }
+            x = FindDouble(a, j);
+            y = FindDouble(b, j);
+            switch (op) {
+            case FIND_OP_ADD:
+                r = x + y;
+                break;
+            case FIND_OP_SUB:
+                r = x - y;
+                break;
+            case FIND_OP_MUL:
+                r = x * y;
+                break;
+            default:
+                r = x / y;
+                break;
+            }
+            a->isInt[j] = FALSE;
+            a->d[j] = r;
+            a->unknown[j] = (r != r);   /* NaN is a domain error. */
+        }
+    }
+}
+
+static void
+FindCompare(FindOpcode op, FindVector *a, FindVector *b, int numRows)
+{
+    int j;
+
+    for (j = 0; j < numRows; j++) {
+        int cmp;
+
+        if ((a->unknown[j]) || (b->unknown[j])) {
+            a->unknown[j] = TRUE;
+            continue;
+        }
+        if ((a->isInt[j]) && (b->isInt[j])) {
+            cmp = (a->i[j] < b->i[j]) ? -1 : (a->i[j] > b->i[j]);
+        } else {
+            double x, y;
+
+            /* Large integers can't be converted exactly to doubles. */
+            if (((a->isInt[j]) && ((a->i[j] > FIND_EXACT_DOUBLE) || 
+                                   (a->i[j] < -FIND_EXACT_DOUBLE))) ||
+                ((b->isInt[j]) && ((b->i[j] > FIND_EXACT_DOUBLE) || 
+                                   (b->i[j] < -FIND_EXACT_DOUBLE)))) {
+                a->unknown[j] = TRUE;
+                continue;
+            }
+            x = FindDouble(a, j);
+            y = FindDouble(b, j);
+            cmp = (x < y) ? -1 : (x > y);
+        }
+        switch (op) {
+        case FIND_OP_LT:
+            cmp = (cmp < 0);
+            break;
+        case FIND_OP_GT:
+            cmp = (cmp > 0);
+            break;
+        case FIND_OP_LE:
+            cmp = (cmp <= 0);
+            break;
+        case FIND_OP_GE:
+            cmp = (cmp >= 0);
+            break;
+        case FIND_OP_EQ:
+            cmp = (cmp == 0);
+            break;
+        default:
+            cmp = (cmp != 0);
+            break;
+        }
+        SetFindBoolean(a, j, cmp);
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RunFindProgram --
+ *
+ *      Evaluates the compiled program for a block of rows.
+ *
+ * Results:
+ *      For each row, results holds 1 if the expression is true, 0 if
+ *      false, and -1 if it must be evaluated by TCL.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+RunFindProgram(FindProgram *progPtr, FindVector *stack, BLT_TABLE_ROW *rows,
+               int numRows, signed char *results)
+{
+    FindVector *a, *b, *top;
+    int i, j;
+
+    top = stack - 1;
+    for (i = 0; i < progPtr->numInstrs; i++) {
+        FindInstr *instrPtr;
+
+        instrPtr = progPtr->instrs + i;
+        switch (instrPtr->op) {
+        case FIND_OP_NUMBER_COLUMN:
+            top++;
+            LoadFindNumbers(progPtr->table, instrPtr->column, rows, numRows, 
+                            top);
+            break;
+        case FIND_OP_STRING_COLUMN:
+            top++;
+            LoadFindStrings(progPtr->table, instrPtr->column, rows, numRows, 
+                            top);
+            break;
+        case FIND_OP_ROW_INDEX:
+            top++;
+            for (j = 0; j < numRows; j++) {
+                top->unknown[j] = FALSE;
+                top->isInt[j] = TRUE;
+                top->i[j] = blt_table_row_index(progPtr->table, rows[j]);
+            }
+            break;
+        case FIND_OP_NUMBER:
+            top++;
+            for (j = 0; j < numRows; j++) {
+                top->unknown[j] = FALSE;
+                top->isInt[j] = instrPtr->isInt;
+                top->i[j] = instrPtr->i;
+                top->d[j] = instrPtr->d;
+            }
+            break;
+        case FIND_OP_STRING:
+            {
+                const char *string;
+                int length;
+
+                top++;
+                string = Tcl_GetStringFromObj(instrPtr->objPtr, &length);
+                for (j = 0; j < numRows; j++) {
+                    top->unknown[j] = FALSE;
+                    top->s[j] = string;
+                    top->length[j] = length;
+                }
+            }
+            break;
+        case FIND_OP_CODE_EQ:
+        case FIND_OP_CODE_NE:
+            top++;
+            for (j = 0; j < numRows; j++) {
+                long code;
+
+                code = blt_table_get_code(progPtr->table, rows[j], 
+                                          instrPtr->column);
+                top->unknown[j] = (code == 0);
+                if (code != 0) {
+                    SetFindBoolean(top, j, (instrPtr->op == FIND_OP_CODE_EQ) ?
+                                   (code == instrPtr->i) :
+                                   (code != instrPtr->i));
+                }
+            }
+            break;
+        case FIND_OP_ADD:
+        case FIND_OP_SUB:
+        case FIND_OP_MUL:
+        case FIND_OP_DIV:
+        case FIND_OP_MOD:
+            b = top--;
+            FindArithmetic(instrPtr->op, top, b, numRows);
+            break;
+        case FIND_OP_LT:
+        case FIND_OP_GT:
+        case FIND_OP_LE:
+        case FIND_OP_GE:
+        case FIND_OP_EQ:
+        case FIND_OP_NE:
+            b = top--;
+            FindCompare(instrPtr->op, top, b, numRows);
+            break;
+        case FIND_OP_STR_EQ:
+        case FIND_OP_STR_NE:
+            b = top--;
+            a = top;
+            for (j = 0; j < numRows; j++) {
+                int equal;
+
+                if ((a->unknown[j]) || (b->unknown[j])) {
+                    a->unknown[j] = TRUE;
+                    continue;
+                }
+                equal = ((a->length[j] == b->length[j]) &&
+                         (memcmp(a->s[j], b->s[j], a->length[j]) == 0));
+                SetFindBoolean(a, j, (instrPtr->op == FIND_OP_STR_EQ) ? 
+                               equal : !equal);
+            }
+            break;
+        case FIND_OP_MATCH:
+            {
+                const char *pattern;
+
+                pattern = Tcl_GetString(instrPtr->objPtr);
+                for (j = 0; j < numRows; j++) {
+                    if (!top->unknown[j]) {
+                        SetFindBoolean(top, j, Tcl_StringCaseMatch(top->s[j],
+                                pattern, instrPtr->nocase));
+                    }
+                }
+            }
+            break;
+        case FIND_OP_NEG:
+            for (j = 0; j < numRows; j++) {
+                if (top->unknown[j]) {
+                    continue;
+                }
+                if (!top->isInt[j]) {
+                    top->d[j] = -top->d[j];
+                } else if (top->i[j] == INT64_MIN) {
+                    top->unknown[j] = TRUE;
+                } else {
+                    top->i[j] = -top->i[j];
+                }
+            }
+            break;
+        case FIND_OP_NOT:
+            for (j = 0; j < numRows; j++) {
+                if (!top->unknown[j]) {
+                    SetFindBoolean(top, j, !FindTruth(top, j));
+                }
+            }
+            break;
+        case FIND_OP_AND:
+        case FIND_OP_OR:
+            b = top--;
+            a = top;
+            for (j = 0; j < numRows; j++) {
+                int decided;
+
+                /* Like TCL, the right operand doesn't matter if the left
+                 * one decides the result.  */
+                decided = (instrPtr->op == FIND_OP_OR);
+                if (a->unknown[j]) {
+                    continue;
+                }
+                if (FindTruth(a, j) == decided) {
+                    SetFindBoolean(a, j, decided);
+                } else if (b->unknown[j]) {
+                    a->unknown[j] = TRUE;
+                } else {
+                    SetFindBoolean(a, j, FindTruth(b, j));
+                }
+            }
+            break;
+        }
+    }
+    for (j = 0; j < numRows; j++) {
+        results[j] = (top->unknown[j]) ? -1 : FindTruth(top, j);
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FindOperandStart --
+ *
+ *      Returns the first instruction of the operand that ends with the
+ *      given instruction, or -1 if there isn't one.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+FindOperandStart(FindProgram *progPtr, int end)
+{
+    int i, need;
+
+    need = 1;
+    for (i = end; i >= 0; i--) {
+        switch (progPtr->instrs[i].op) {
+        case FIND_OP_NUMBER_COLUMN:
+        case FIND_OP_STRING_COLUMN:
+        case FIND_OP_ROW_INDEX:
+        case FIND_OP_NUMBER:
+        case FIND_OP_STRING:
+        case FIND_OP_CODE_EQ:
+        case FIND_OP_CODE_NE:
+            need--;
+            break;
+        case FIND_OP_NEG:
+        case FIND_OP_NOT:
+        case FIND_OP_MATCH:
+            break;
+        default:
+            need++;                     /* Binary operators. */
+            break;
+        }
+        if (need == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetFindBound --
+ *
+ *      Tests if the operand ending at the given instruction compares an
+ *      indexed numeric column against a number.  If so, the bounds are
+ *      narrowed to the values that can satisfy the comparison.
+ *
+ * Results:
+ *      Returns the column compared, or NULL if the operand isn't such a
+ *      comparison.
+ *
+ *---------------------------------------------------------------------------
+ */
+static BLT_TABLE_COLUMN
+GetFindBound(FindProgram *progPtr, int end, double *loPtr, double *hiPtr)
+{
+    FindInstr *a, *b;
+    FindOpcode op;
+    double d;
+
+    if ((end < 2) || (FindOperandStart(progPtr, end) != (end - 2))) {
+        return NULL;
+    }
+    op = progPtr->instrs[end].op;
+    a = progPtr->instrs + end - 2;
+    b = progPtr->instrs + end - 1;
+    if ((a->op == FIND_OP_NUMBER) && (b->op == FIND_OP_NUMBER_COLUMN)) {
+        FindInstr *tmp;
+
+        /* Flip the comparison so the column is on the left. */
+        tmp = a, a = b, b = tmp;
+        switch (op) {
+        case FIND_OP_LT: op = FIND_OP_GT; break;
+        case FIND_OP_GT: op = FIND_OP_LT; break;
+        case FIND_OP_LE: op = FIND_OP_GE; break;
+        case FIND_OP_GE: op = FIND_OP_LE; break;
+        default: break;
+        }
+    }
+    if ((a->op != FIND_OP_NUMBER_COLUMN) || (b->op != FIND_OP_NUMBER) ||
+        (!blt_table_column_has_index(a->column))) {
+        return NULL;
+    }
+    switch (blt_table_column_type(a->column)) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+    case TABLE_COLUMN_TYPE_TIME:
+    case TABLE_COLUMN_TYPE_LONG:
+    case TABLE_COLUMN_TYPE_INT64:
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        break;
+    default:
+        return NULL;                    /* Strings are ordered by
+                                         * dictionary, not numerically. */
+    }
+    /* The bounds are inclusive, a superset of the matching values. */
+    d = (b->isInt) ? (double)b->i : b->d;
+    switch (op) {
+    case FIND_OP_LT:
+    case FIND_OP_LE:
+        if (d < *hiPtr) {
+            *hiPtr = d;
+        }
+        break;
+    case FIND_OP_GT:
+    case FIND_OP_GE:
+        if (d > *loPtr) {
+            *loPtr = d;
+        }
+        break;
+    case FIND_OP_EQ:
+        if (d < *hiPtr) {
+            *hiPtr = d;
+        }
+        if (d > *loPtr) {
+            *loPtr = d;
+        }
+        break;
+    default:
+        return NULL;
+    }
+    return a->column;
+}
+
+static double
+GetFindIndexValue(BLT_TABLE table, BLT_TABLE_ROW row, BLT_TABLE_COLUMN col)
+{
+    switch (blt_table_column_type(col)) {
+    case TABLE_COLUMN_TYPE_LONG:
+        return (double)blt_table_get_long(NULL, table, row, col, 0);
+    case TABLE_COLUMN_TYPE_INT64:
+        return (double)blt_table_get_int64(NULL, table, row, col, 0);
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        return (double)blt_table_get_boolean(NULL, table, row, col, 0);
+    default:
+        return blt_table_get_double(NULL, table, row, col);
+    }
+}
+
+static int
+CompareRowIndices(const void *a, const void *b)
+{
+    BLT_TABLE_ROW row1, row2;
+
+    row1 = *(BLT_TABLE_ROW *)a;
+    row2 = *(BLT_TABLE_ROW *)b;
+    return (row1->index < row2->index) ? -1 : (row1->index > row2->index);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FindIndexedRows --
+ *
+ *      Uses a column index to pick the rows that need to be evaluated.
+ *      The expression must start with one or more comparisons of the same
+ *      indexed column against numbers, joined by &&.  TCL stops at the
+ *      first false operand of &&, so a row whose value is outside the
+ *      bounds of those comparisons can't match (or raise an error).  Rows
+ *      with an empty or NaN cell are always picked, since TCL decides the
+ *      comparison for them.
+ *
+ * Results:
+ *      Returns the number of rows picked, or -1 if the index can't be
+ *      used.  The rows, in table order, are returned in a malloc-ed array
+ *      that the caller must free.
+ *
+ *---------------------------------------------------------------------------
+ */
+static long
+FindIndexedRows(FindProgram *progPtr, FindSwitches *switchesPtr,
+                BLT_TABLE_ROW **rowsPtr)
+{
+    BLT_TABLE table;
+    BLT_TABLE_COLUMN col;
+    BLT_TABLE_ROW *indexRows, *rows;
+    int *rights;
+    int end, numRights, i;
+    long numIndexed, first, last, nan, count, low, high;
+    double lo, hi;
+
+    if ((switchesPtr->flags & FIND_INVERT) || 
+        (switchesPtr->iter.type != TABLE_ITERATOR_ALL) ||
+        (progPtr->numInstrs < 3)) {
+        return -1;
+    }
+    table = progPtr->table;
+    /* Collect the operands of the && at the top of the program, from left
+     * to right. */
+    rights = Blt_AssertMalloc(progPtr->numInstrs * sizeof(int));
+    numRights = 0;
+    end = progPtr->numInstrs - 1;
+    while (progPtr->instrs[end].op == FIND_OP_AND) {
+        rights[numRights++] = end - 1;
+        end = FindOperandStart(progPtr, end - 1) - 1;
+    }
+    lo = -HUGE_VAL, hi = HUGE_VAL;
+    col = GetFindBound(progPtr, end, &lo, &hi);
+    for (i = numRights - 1; (col != NULL) && (i >= 0); i--) {
+        double newLo, newHi;
+
+        newLo = lo, newHi = hi;
+        if (GetFindBound(progPtr, rights[i], &newLo, &newHi) != col) {
+            break;
+        }
+        lo = newLo, hi = newHi;
+    }
+    Blt_Free(rights);
+    if (col == NULL) {
+        return -1;
+    }
+    numIndexed = blt_table_index_rows(table, col, &indexRows);
+    if (numIndexed < 0) {
+        return -1;
+    }
+    /* NaNs are at the end of the index. */
+    low = 0, high = numIndexed;
+    while (low < high) {
+        long mid;
+        double d;
+
+        mid = (low + high) / 2;
+        d = GetFindIndexValue(table, indexRows[mid], col);
+        if (d == d) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    nan = low;
+    low = 0, high = nan;
+    while (low < high) {
+        long mid;
+
+        mid = (low + high) / 2;
+        if (GetFindIndexValue(table, indexRows[mid], col) < lo) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    first = low;
+    high = nan;
+    while (low < high) {
+        long mid;
+
+        mid = (low + high) / 2;
+        if (GetFindIndexValue(table, indexRows[mid], col) <= hi) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    last = low;
+    rows = Blt_AssertMalloc((blt_table_num_rows(table) + 1) * 
+                            sizeof(BLT_TABLE_ROW));
+    count = last - first;
+    memcpy(rows, indexRows + first, count * sizeof(BLT_TABLE_ROW));
+    memcpy(rows + count, indexRows + nan, 
+           (numIndexed - nan) * sizeof(BLT_TABLE_ROW));
+    count += numIndexed - nan;
+    if (numIndexed < blt_table_num_rows(table)) {
+        BLT_TABLE_ROW row;
+
+        for (row = blt_table_first_row(table); row != NULL; 
+             row = blt_table_next_row(row)) {
+            if (!blt_table_value_exists(table, row, col)) {
+                rows[count++] = row;
+            }
+        }
+    }
+    if (count > 0) {
+        blt_table_row_index(table, rows[0]); /* Make sure the row indices
+                                              * are current. */
+        qsort(rows, count, sizeof(BLT_TABLE_ROW), CompareRowIndices);
+    }
+    *rowsPtr = rows;
+    return count;
+}
+
+static int
+FindRows(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *objPtr, 
+         FindSwitches *switchesPtr)
+{
+    Blt_HashEntry *hPtr;
+    BLT_TABLE_ROW row;
+    TableCmdInterpData *dataPtr;
+    Tcl_Namespace *nsPtr;
+    Tcl_Obj *listObjPtr;
+    FindProgram *progPtr;
+    FindVector *stack;
+    BLT_TABLE_ROW *indexRows;
+    long numIndexRows, nextIndexRow;
+    int isNew, blockSize;
+    size_t numMatches;
+    int result = TCL_OK;
+
+    Tcl_AddInterpResolvers(interp, TABLE_FIND_KEY, (Tcl_ResolveCmdProc*)NULL,
+        ColumnVarResolverProc, (Tcl_ResolveCompiledVarProc*)NULL);
+
+    dataPtr = GetTableCmdInterpData(interp);
+    nsPtr = Tcl_GetCurrentNamespace(interp);
+    hPtr = Blt_CreateHashEntry(&dataPtr->findTable, nsPtr, &isNew);
+    assert(isNew);
+    Blt_SetHashValue(hPtr, switchesPtr);
+
+    /* 
+     * Try to compile the expression.  If it can't be compiled, each row is
+     * evaluated by TCL, one at a time, since the expression may change
+     * the table.
+     */
+    stack = NULL;
+    blockSize = 1;
+    indexRows = NULL;
+    numIndexRows = nextIndexRow = 0;
+    progPtr = CompileFindExpr(table, objPtr, switchesPtr);
+    if (progPtr != NULL) {
+        stack = Blt_AssertMalloc(progPtr->maxDepth * sizeof(FindVector));
+        blockSize = FIND_BLOCK_SIZE;
+        /* If the expression is bounded by an indexed column, evaluate
+         * only the rows the index picks. */
+        numIndexRows = FindIndexedRows(progPtr, switchesPtr, &indexRows);
+    }
+
+    /* Now process each row, evaluating the expression. */
+    listObjPtr = Tcl_NewListObj(0, (Tcl_Obj **) NULL);
+    numMatches = 0;
+    if (indexRows != NULL) {
+        row = (numIndexRows > 0) ? indexRows[nextIndexRow++] : NULL;
+    } else {
+        row = blt_table_first_tagged_row(&switchesPtr->iter);
+    }
+    while (row != NULL) {
+        BLT_TABLE_ROW rows[FIND_BLOCK_SIZE];
+        signed char results[FIND_BLOCK_SIZE];
+        int i, numRows;
+
+        for (numRows = 0; (row != NULL) && (numRows < blockSize); numRows++) {
+            rows[numRows] = row;
+            if (indexRows != NULL) {
+                row = (nextIndexRow < numIndexRows) ? 
+                    indexRows[nextIndexRow++] : NULL;
+            } else {
+                row = blt_table_next_tagged_row(&switchesPtr->iter);
+            }
+        }
+        if (progPtr != NULL) {
+            RunFindProgram(progPtr, stack, rows, numRows, results);
+        } else {
+            memset(results, -1, numRows);
+        }
+        for (i = 0; i < numRows; i++) {
+            int bool;
+
+            bool = results[i];
+            if (bool < 0) {
+                /* Let TCL evaluate the expression for this row. */
+                switchesPtr->row = rows[i];
+                result = EvaluateExpr(interp, table, objPtr, &bool);
+                if (result != TCL_OK) {
+                    goto done;
+                }
+            }
+            if (switchesPtr->flags & FIND_INVERT) {
+                bool = !bool;
+            }
+            if (bool) {
+                Tcl_Obj *objPtr;
+
+                if (switchesPtr->tag != NULL) {
+                    result = blt_table_set_row_tag(interp, table, rows[i],
+                            switchesPtr->tag);
+                    if (result != TCL_OK) {
+                        goto done;
+                    }
+                }
+                if (switchesPtr->matches != NULL) {
+                    Blt_Chain_Append(switchesPtr->matches, rows[i]);
+                }
+                numMatches++;
+                objPtr = GetRowIndexObj(table, rows[i]);
+                Tcl_ListObjAppendElement(interp, listObjPtr, objPtr);
+                if ((switchesPtr->maxMatches > 0) && 
+                    (numMatches >= switchesPtr->maxMatches)) {
+                    goto done;
+                }
+            }
+        }
+    }
+ done:
+    if (result != TCL_OK) {
+        Tcl_DecrRefCount(listObjPtr);
+    } else {
+        Tcl_SetObjResult(interp, listObjPtr);
+    }
+    /* Clean up. */
+    if (indexRows != NULL) {
+        Blt_Free(indexRows);
+    }
+    if (progPtr != NULL) {
+        Blt_Free(stack);
+        FreeFindProgram(progPtr);
+    }
+    Blt_DeleteHashEntry(&dataPtr->findTable, hPtr);
+    Blt_FreeCachedVars(&switchesPtr->varTable);
+    if (!Tcl_RemoveInterpResolvers(interp, TABLE_FIND_KEY)) {
+        Tcl_AppendResult(interp, "can't delete resolver scheme", 
+                (char *)NULL);
+        return TCL_ERROR;
+    }
+    return result;
+}
+
+static int
+AppendColumn(Tcl_Interp *interp, BLT_TABLE src, BLT_TABLE dst,
+    BLT_TABLE_COLUMN srcCol,            /* Column in the source table. */
+    BLT_TABLE_COLUMN dstCol)            /* Column in the dstination table. */
+{
+    size_t i, j, oldNumRows, need;
+    BLT_TABLE_COLUMN_TYPE type;
+    
+    oldNumRows = blt_table_num_rows(src);
+    need = oldNumRows + blt_table_num_rows(dst);
+    if (blt_table_extend_rows(interp, dst, need, NULL) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    for (i = 0, j = oldNumRows; i < blt_table_num_rows(src); i++, j++) {
+        BLT_TABLE_ROW srcRow, dstRow;
+        BLT_TABLE_VALUE value;
+
+        srcRow = blt_table_row(src, i);
+        value = blt_table_get_value(src, srcRow, srcCol);
+        if (value == NULL) {
+            continue;
+        }
+        dstRow = blt_table_row(dst, j);
+        if (blt_table_set_value(dst, dstRow, dstCol, value) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+    type = blt_table_column_type(dstCol);
+    if (blt_table_set_column_type(interp, dst, dstCol, type) != TCL_OK) {
+        return TCL_ERROR;
     }
     return TCL_OK;
 }           
@@ -2039,6 +4016,10 @@ CopyColumn(Tcl_Interp *interp, BLT_TABLE src, BLT_TABLE dst,
             return TCL_ERROR;
         }
     }
+    if (blt_table_set_column_time_format(interp, dst, dcol,
+        blt_table_column_time_format(scol)) != TCL_OK) {
+        return TCL_ERROR;
+    }
     if (blt_table_set_column_type(interp, dst, dcol,
         blt_table_column_type(scol)) != TCL_OK) {
         return TCL_ERROR;
@@ -2123,6 +4104,11 @@ CopyTable(Tcl_Interp *interp, BLT_TABLE src, BLT_TABLE dst)
                                          * same table. */
     }
     ClearTable(dst);
+    /* Lay out the rows like the source table so that the column values
+     * can be shared, copy-on-write, instead of copied. */
+    if (blt_table_mirror_rows(interp, src, dst) != TCL_OK) {
+        return TCL_ERROR;
+    }
     if (blt_table_num_columns(src) > blt_table_num_columns(dst)) {
         size_t count;
 
@@ -2134,7 +4120,8 @@ CopyTable(Tcl_Interp *interp, BLT_TABLE src, BLT_TABLE dst)
 
         c1 = blt_table_column(src, i);
         c2 = blt_table_column(dst, i);
-        if (CopyColumn(interp, src, dst, c1, c2) != TCL_OK) {
+        if ((!blt_table_share_column(src, c1, dst, c2)) &&
+            (CopyColumn(interp, src, dst, c1, c2) != TCL_OK)) {
             return TCL_ERROR;
         }
         if (CopyColumnLabel(interp, src, dst, c1, c2) != TCL_OK) {
@@ -2886,6 +4873,143 @@ AddOp(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const *objv)
     return result;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * AggregateOp --
+ *
+ *      Groups the rows by the values of one or more columns and computes
+ *      the counts, sums, means, minimums, and maximums of other columns
+ *      over each group.  The results are stored in a new table, or in the
+ *      table given by the -into switch, whose contents are replaced.
+ *
+ * Results:
+ *      A standard TCL result.  The name of the result table is returned.
+ *
+ *      tableName aggregate ?switches?
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+AggregateOp(ClientData clientData, Tcl_Interp *interp, int objc,
+            Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    AggregateSwitches switches;
+    BLT_TABLE destTable;
+    BLT_TABLE_AGGREGATE *aggregates;
+    BLT_TABLE_COLUMN *columns, col;
+    BLT_TABLE_ROW *rows;
+    Blt_ChainLink link;
+    Tcl_DString ds;
+    const char *instName;
+    long i, numRows, numColumns, numAggregates;
+    int result;
+
+    memset(&switches, 0, sizeof(AggregateSwitches));
+    switches.numThreads = 1;
+    rowIterSwitch.clientData = cmdPtr->table;
+    columnIterSwitch.clientData = cmdPtr->table;
+    aggregateSwitch.clientData = cmdPtr->table;
+    Tcl_DStringInit(&ds);
+    aggregates = NULL;
+    columns = NULL;
+    rows = NULL;
+    result = TCL_ERROR;
+    if (Blt_ParseSwitches(interp, aggregateSwitches, objc - 2, objv + 2, 
+        &switches, BLT_SWITCH_DEFAULTS) < 0) {
+        goto error;
+    }
+    numColumns = switches.gi.numEntries;
+    columns = Blt_AssertMalloc((numColumns + 1) * sizeof(BLT_TABLE_COLUMN));
+    i = 0;
+    if (switches.gi.chain != NULL) {
+        for (col = blt_table_first_tagged_column(&switches.gi); col != NULL; 
+             col = blt_table_next_tagged_column(&switches.gi)) {
+            columns[i] = col;
+            i++;
+        }
+    }
+    numColumns = i;
+    numAggregates = 0;
+    if (switches.aggregates != NULL) {
+        numAggregates = Blt_Chain_GetLength(switches.aggregates);
+    }
+    aggregates = Blt_AssertMalloc((numAggregates + 1) * 
+                                  sizeof(BLT_TABLE_AGGREGATE));
+    i = 0;
+    if (switches.aggregates != NULL) {
+        for (link = Blt_Chain_FirstLink(switches.aggregates); link != NULL;
+             link = Blt_Chain_NextLink(link)) {
+            BLT_TABLE_AGGREGATE *aggPtr;
+
+            aggPtr = Blt_Chain_GetValue(link);
+            aggregates[i] = *aggPtr;
+            i++;
+        }
+    }
+    numRows = 0;
+    if (switches.ri.chain != NULL) {
+        BLT_TABLE_ROW row;
+
+        rows = Blt_AssertMalloc((switches.ri.numEntries + 1) * 
+                                sizeof(BLT_TABLE_ROW));
+        for (row = blt_table_first_tagged_row(&switches.ri); row != NULL; 
+             row = blt_table_next_tagged_row(&switches.ri)) {
+            rows[numRows] = row;
+            numRows++;
+        }
+    }
+    if (switches.table != NULL) {
+        if (switches.table->corePtr == cmdPtr->table->corePtr) {
+            Tcl_AppendResult(interp, "can't aggregate into the same table",
+                             (char *)NULL);
+            goto error;
+        }
+        destTable = switches.table;
+        instName = blt_table_name(destTable);
+        ClearTable(destTable);
+    } else {
+        instName = GenerateName(interp, "", "", &ds);
+        if ((instName == NULL) || 
+            (blt_table_create(interp, instName, &destTable) != TCL_OK)) {
+            goto error;
+        }
+        NewTableCmd(interp, destTable, instName);
+    }
+    if (blt_table_aggregate(interp, cmdPtr->table, numRows, rows, numColumns,
+            columns, numAggregates, aggregates, switches.numThreads, 
+            destTable) != TCL_OK) {
+        goto error;
+    }
+    Tcl_SetStringObj(Tcl_GetObjResult(interp), instName, -1);
+    result = TCL_OK;
+ error:
+    if (switches.aggregates != NULL) {
+        for (link = Blt_Chain_FirstLink(switches.aggregates); link != NULL;
+             link = Blt_Chain_NextLink(link)) {
+            Blt_Free(Blt_Chain_GetValue(link));
+        }
+        Blt_Chain_Destroy(switches.aggregates);
+    }
+    if (aggregates != NULL) {
+        Blt_Free(aggregates);
+    }
+    if (columns != NULL) {
+        Blt_Free(columns);
+    }
+    if (rows != NULL) {
+        Blt_Free(rows);
+    }
+    Tcl_DStringFree(&ds);
+    /* The iterators don't record the table, so the switches don't free
+     * them. */
+    blt_table_free_iterator_objv(&switches.ri);
+    blt_table_free_iterator_objv(&switches.gi);
+    Blt_FreeSwitches(aggregateSwitches, &switches, 0);
+    return result;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -3311,7 +5435,9 @@ ColumnDupOp(ClientData clientData, Tcl_Interp *interp, int objc,
         if (dstCol == NULL) {
             goto error;
         }
-        if (CopyColumn(interp, table, table, srcCol, dstCol) != TCL_OK) {
+        /* The new column shares the values of the old, copy-on-write. */
+        if ((!blt_table_share_column(table, srcCol, table, dstCol)) &&
+            (CopyColumn(interp, table, table, srcCol, dstCol) != TCL_OK)) {
             goto error;
         }
         CopyColumnTags(table, table, srcCol, dstCol);
@@ -3373,6 +5499,63 @@ ColumnEmptyOp(ClientData clientData, Tcl_Interp *interp, int objc,
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ColumnEncodingOp --
+ *
+ *      Reports and/or sets how the values of a column are stored.
+ * 
+ * Results:
+ *      A standard TCL result.  If the column index is invalid or the
+ *      column can't be encoded, TCL_ERROR is returned and an error message
+ *      is left in the interpreter result.
+ *      
+ *      tableName column encoding columnName ?encodingName?
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ColumnEncodingOp(ClientData clientData, Tcl_Interp *interp, int objc,
+                 Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    BLT_TABLE table;
+    BLT_TABLE_ITERATOR ci;
+    BLT_TABLE_COLUMN col;
+    BLT_TABLE_COLUMN_ENCODING encoding;
+    Tcl_Obj *listObjPtr;
+
+    table = cmdPtr->table;
+    if (blt_table_iterate_columns(interp, table, objv[3], &ci) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (objc == 5) {
+        if (GetColumnEncodingFromObj(interp, objv[4], &encoding) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        for (col = blt_table_first_tagged_column(&ci); col != NULL; 
+             col = blt_table_next_tagged_column(&ci)) {
+            if (blt_table_set_column_encoding(interp, table, col, encoding)
+                != TCL_OK) {
+                return TCL_ERROR;
+            }
+        }
+        return TCL_OK;
+    }
+    listObjPtr = Tcl_NewListObj(0, (Tcl_Obj **) NULL);
+    for (col = blt_table_first_tagged_column(&ci); col != NULL; 
+         col = blt_table_next_tagged_column(&ci)) {
+        Tcl_Obj *objPtr;
+
+        encoding = blt_table_column_encoding(col);
+        objPtr = Tcl_NewStringObj(columnEncodingNames[encoding], -1);
+        Tcl_ListObjAppendElement(interp, listObjPtr, objPtr);
+    }
+    Tcl_SetObjResult(interp, listObjPtr);
+    return TCL_OK;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -3748,10 +5931,19 @@ ColumnCreateOp(ClientData clientData, Tcl_Interp *interp, int objc,
     if (col == NULL) {
         goto error;
     }
+    if ((switches.timeFormat != NULL) && 
+        (blt_table_set_column_time_format(interp, cmdPtr->table, col,
+                switches.timeFormat) != TCL_OK)) {
+        goto error;
+    }
     if (blt_table_set_column_type(interp, cmdPtr->table, col, switches.type)
         != TCL_OK) {
         goto error;
     }
+    if (blt_table_set_column_encoding(interp, cmdPtr->table, col, 
+                switches.encoding) != TCL_OK) {
+        goto error;
+    }
     if (switches.destColumn != NULL) {
         if (blt_table_move_columns(interp, cmdPtr->table, switches.destColumn, 
                 col, col, switches.flags & INSERT_AFTER) != TCL_OK) {
@@ -4137,6 +6329,80 @@ ColumnSetOp(ClientData clientData, Tcl_Interp *interp, int objc,
 }
 
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ColumnStatsOp --
+ *
+ *      Returns the statistics of the values in the given column as a list
+ *      of name-value pairs: the number of non-empty cells, the minimum
+ *      and maximum values, the sum of the values, and the estimated
+ *      number of distinct values.  The sum of a string column is empty.
+ *
+ * Results:
+ *      A standard TCL result. If the column index is invalid, TCL_ERROR
+ *      is returned and an error message is left in the interpreter
+ *      result.
+ *
+ *      tableName column stats columnName
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ColumnStatsOp(ClientData clientData, Tcl_Interp *interp, int objc,
+              Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    BLT_TABLE table;
+    BLT_TABLE_COLUMN col;
+    BLT_TABLE_COLUMN_STATS stats;
+    BLT_TABLE_COLUMN_TYPE type;
+    Tcl_Obj *listObjPtr, *objPtr;
+
+    table = cmdPtr->table;
+    col = blt_table_get_column(interp, table, objv[3]);
+    if (col == NULL) {
+        return TCL_ERROR;
+    }
+    if (blt_table_get_column_stats(interp, table, col, &stats) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    listObjPtr = Tcl_NewListObj(0, (Tcl_Obj **) NULL);
+    Tcl_ListObjAppendElement(interp, listObjPtr, 
+        Tcl_NewStringObj("count", 5));
+    Tcl_ListObjAppendElement(interp, listObjPtr, 
+        Tcl_NewLongObj(stats.numValues));
+    Tcl_ListObjAppendElement(interp, listObjPtr, Tcl_NewStringObj("min", 3));
+    if (stats.minRow == NULL) {
+        objPtr = Tcl_NewStringObj(cmdPtr->emptyString, -1);
+    } else {
+        objPtr = blt_table_get_obj(table, stats.minRow, col);
+    }
+    Tcl_ListObjAppendElement(interp, listObjPtr, objPtr);
+    Tcl_ListObjAppendElement(interp, listObjPtr, Tcl_NewStringObj("max", 3));
+    if (stats.maxRow == NULL) {
+        objPtr = Tcl_NewStringObj(cmdPtr->emptyString, -1);
+    } else {
+        objPtr = blt_table_get_obj(table, stats.maxRow, col);
+    }
+    Tcl_ListObjAppendElement(interp, listObjPtr, objPtr);
+    Tcl_ListObjAppendElement(interp, listObjPtr, Tcl_NewStringObj("sum", 3));
+    type = blt_table_column_type(col);
+    if ((type == TABLE_COLUMN_TYPE_STRING) || 
+        (type == TABLE_COLUMN_TYPE_BLOB)) {
+        objPtr = Tcl_NewStringObj(cmdPtr->emptyString, -1);
+    } else {
+        objPtr = Tcl_NewDoubleObj(stats.sum);
+    }
+    Tcl_ListObjAppendElement(interp, listObjPtr, objPtr);
+    Tcl_ListObjAppendElement(interp, listObjPtr, 
+        Tcl_NewStringObj("distinct", 8));
+    Tcl_ListObjAppendElement(interp, listObjPtr, 
+        Tcl_NewLongObj(stats.numDistinct));
+    Tcl_SetObjResult(interp, listObjPtr);
+    return TCL_OK;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -4753,23 +7019,92 @@ static Blt_OpSpec columnTagOps[] =
 
 };
 
-static int numColumnTagOps = sizeof(columnTagOps) / sizeof(Blt_OpSpec);
+static int numColumnTagOps = sizeof(columnTagOps) / sizeof(Blt_OpSpec);
+
+static int
+ColumnTagOp(ClientData clientData, Tcl_Interp *interp, int objc,
+            Tcl_Obj *const *objv)
+{
+    Tcl_ObjCmdProc *proc;
+
+    int result;
+
+    proc = Blt_GetOpFromObj(interp, numColumnTagOps, columnTagOps, BLT_OP_ARG3,
+        objc, objv, 0);
+    if (proc == NULL) {
+        return TCL_ERROR;
+    }
+    result = (*proc)(clientData, interp, objc, objv);
+    return result;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ColumnTimeFormatOp --
+ *
+ *      Reports and/or sets the pattern used to parse time strings for a
+ *      column.  An empty pattern removes the time format.  The pattern of
+ *      a single column is returned as is, so that it can be given back to
+ *      set the format.  Otherwise a list of the patterns is returned.
+ * 
+ * Results:
+ *      A standard TCL result.  If the column index or pattern is invalid,
+ *      TCL_ERROR is returned and an error message is left in the
+ *      interpreter result.
+ *      
+ *      tableName column timeformat columnName ?pattern?
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ColumnTimeFormatOp(ClientData clientData, Tcl_Interp *interp, int objc,
+                   Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    BLT_TABLE table;
+    BLT_TABLE_ITERATOR ci;
+    BLT_TABLE_COLUMN col;
+    Tcl_Obj *listObjPtr;
+
+    table = cmdPtr->table;
+    if (blt_table_iterate_columns(interp, table, objv[3], &ci) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (objc == 5) {
+        const char *pattern;
 
-static int
-ColumnTagOp(ClientData clientData, Tcl_Interp *interp, int objc,
-            Tcl_Obj *const *objv)
-{
-    Tcl_ObjCmdProc *proc;
+        pattern = Tcl_GetString(objv[4]);
+        for (col = blt_table_first_tagged_column(&ci); col != NULL; 
+             col = blt_table_next_tagged_column(&ci)) {
+            if (blt_table_set_column_time_format(interp, table, col, pattern)
+                != TCL_OK) {
+                return TCL_ERROR;
+            }
+        }
+        return TCL_OK;
+    }
+    if (((ci.type == TABLE_ITERATOR_INDEX) || 
+         (ci.type == TABLE_ITERATOR_LABEL)) && (ci.numEntries == 1)) {
+        const char *pattern;
 
-    int result;
+        col = blt_table_first_tagged_column(&ci);
+        pattern = blt_table_column_time_format(col);
+        Tcl_SetStringObj(Tcl_GetObjResult(interp), 
+                (pattern == NULL) ? "" : pattern, -1);
+        return TCL_OK;
+    }
+    listObjPtr = Tcl_NewListObj(0, (Tcl_Obj **) NULL);
+    for (col = blt_table_first_tagged_column(&ci); col != NULL; 
+         col = blt_table_next_tagged_column(&ci)) {
+        const char *pattern;
 
-    proc = Blt_GetOpFromObj(interp, numColumnTagOps, columnTagOps, BLT_OP_ARG3,
-        objc, objv, 0);
-    if (proc == NULL) {
-        return TCL_ERROR;
+        pattern = blt_table_column_time_format(col);
+        Tcl_ListObjAppendElement(interp, listObjPtr, 
+                Tcl_NewStringObj((pattern == NULL) ? "" : pattern, -1));
     }
-    result = (*proc)(clientData, interp, objc, objv);
-    return result;
+    Tcl_SetObjResult(interp, listObjPtr);
+    return TCL_OK;
 }
 
 /*
@@ -4989,6 +7324,95 @@ ColumnValuesOp(ClientData clientData, Tcl_Interp *interp, int objc,
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ColumnWindowOp --
+ *
+ *      Computes a rolling or cumulative operation over the source column
+ *      into the destination column.  The destination column is created if
+ *      it doesn't already exist.  Traces on the destination column fire
+ *      once for all the rows.
+ * 
+ * Results:
+ *      A standard TCL result. If the column is invalid or a value of the
+ *      source column isn't a number, TCL_ERROR is returned and an error
+ *      message is left in the interpreter result.
+ *
+ *      tableName column window srcColumn destColumn ?switches?
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ColumnWindowOp(ClientData clientData, Tcl_Interp *interp, int objc,
+               Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    BLT_TABLE_COLUMN srcCol, destCol;
+    BLT_TABLE_WINDOW window;
+    WindowSwitches switches;
+    int result;
+
+    memset(&switches, 0, sizeof(switches));
+    if (Blt_ParseSwitches(interp, windowSwitches, objc - 5, objv + 5, 
+                &switches, BLT_SWITCH_DEFAULTS) < 0) {
+        return TCL_ERROR;
+    }
+    result = TCL_ERROR;
+    memset(&window, 0, sizeof(window));
+    window.type = TABLE_WINDOW_MEAN;
+    window.size = switches.size;
+    if (switches.opObjPtr != NULL) {
+        const char *string;
+
+        string = Tcl_GetString(switches.opObjPtr);
+        if (strcmp(string, "mean") == 0) {
+            window.type = TABLE_WINDOW_MEAN;
+        } else if (strcmp(string, "sum") == 0) {
+            window.type = TABLE_WINDOW_SUM;
+        } else if (strcmp(string, "min") == 0) {
+            window.type = TABLE_WINDOW_MIN;
+        } else if (strcmp(string, "max") == 0) {
+            window.type = TABLE_WINDOW_MAX;
+        } else if (strcmp(string, "std") == 0) {
+            window.type = TABLE_WINDOW_STD;
+        } else if (strcmp(string, "median") == 0) {
+            window.type = TABLE_WINDOW_MEDIAN;
+        } else {
+            Tcl_AppendResult(interp, "bad window operation \"", string, 
+                "\": should be mean, sum, min, max, std, or median", 
+                (char *)NULL);
+            goto error;
+        }
+    }
+    srcCol = blt_table_get_column(interp, cmdPtr->table, objv[3]);
+    if (srcCol == NULL) {
+        goto error;
+    }
+    if (switches.byObjPtr != NULL) {
+        window.groupColumn = blt_table_get_column(interp, cmdPtr->table,
+                switches.byObjPtr);
+        if (window.groupColumn == NULL) {
+            goto error;
+        }
+    }
+    /* Destination column may not already exist. */
+    destCol = blt_table_get_column(NULL, cmdPtr->table, objv[4]);
+    if (destCol == NULL) {
+        destCol = blt_table_create_column(interp, cmdPtr->table,
+                Tcl_GetString(objv[4]));
+        if (destCol == NULL) {
+            goto error;
+        }
+        window.flags |= TABLE_WINDOW_SET_TYPE;
+    }
+    result = blt_table_window(interp, cmdPtr->table, srcCol, destCol, 
+                &window);
+ error:
+    Blt_FreeSwitches(windowSwitches, &switches, 0);
+    return result;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -5010,6 +7434,7 @@ static Blt_OpSpec columnOps[] =
     {"delete",    2, ColumnDeleteOp,  3, 0, "?columnName ...?",},
     {"duplicate", 2, ColumnDupOp,     3, 0, "?columnName ...?",},
     {"empty",     3, ColumnEmptyOp,   4, 4, "columnName",},
+    {"encoding",  2, ColumnEncodingOp,4, 5, "columnName ?encodingName?",},
     {"exists",    3, ColumnExistsOp,  4, 4, "columnName",},
     {"extend",    3, ColumnExtendOp,  4, 0, "numColumns ?switches?",},
     {"get",       1, ColumnGetOp,     4, 0, "columnName ?switches?",},
@@ -5022,10 +7447,14 @@ static Blt_OpSpec columnOps[] =
     {"names",     2, ColumnNamesOp,   3, 0, "?pattern ...?",},
     {"nonempty",  3, ColumnNonEmptyOp,4, 4, "columnName",},
     {"set",       1, ColumnSetOp,     5, 0, "columnName rowName ?value ...?",},
+    {"stats",     2, ColumnStatsOp,   4, 4, "columnName",},
     {"tag",       2, ColumnTagOp,     3, 0, "op args...",},
+    {"timeformat",2, ColumnTimeFormatOp,4, 5, "columnName ?pattern?",},
     {"type",      2, ColumnTypeOp,    4, 0, "columnName ?typeName columnName typeName ...?",},
     {"unset",     1, ColumnUnsetOp,   4, 0, "columnName ?indices ...?",},
     {"values",    1, ColumnValuesOp,  4, 5, "columnName ?valueList?",},
+    {"window",    1, ColumnWindowOp,  5, 0, 
+        "srcColumn destColumn ?switches?",},
 };
 
 static int numColumnOps = sizeof(columnOps) / sizeof(Blt_OpSpec);
@@ -5273,6 +7702,11 @@ DumpOp(ClientData clientData, Tcl_Interp *interp, int objc,
         }
         switches.channel = channel;
     }
+    if (switches.flags & DUMP_BINARY) {
+        result = blt_table_binary_dump(interp, table, &switches.ri, 
+                &switches.ci, switches.channel);
+        goto error;
+    }
     Tcl_DStringInit(&ds);
     result = DumpTable(table, &switches);
     if ((switches.channel == NULL) && (result == TCL_OK)) {
@@ -5548,64 +7982,333 @@ GetOp(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const *objv)
     return TCL_OK;
 }
 
-
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ImportOp --
+ *
+ *      Parses the given command line and calls one of several import-specific
+ *      operations.
+ *      
+ * Results:
+ *      Returns a standard TCL result.  It is the result of operation called.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ImportOp(ClientData clientData, Tcl_Interp *interp, int objc,
+         Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    Blt_HashEntry *hPtr;
+    DataFormat *fmtPtr;
+    TableCmdInterpData *dataPtr;
+    const char *fmt;
+
+    dataPtr = GetTableCmdInterpData(interp);
+    if (objc == 2) {
+        Blt_HashSearch iter;
+
+        for (hPtr = Blt_FirstHashEntry(&dataPtr->fmtTable, &iter); 
+             hPtr != NULL; hPtr = Blt_NextHashEntry(&iter)) {
+            fmtPtr = Blt_GetHashValue(hPtr);
+            if (fmtPtr->importProc != NULL) {
+                Tcl_AppendElement(interp, fmtPtr->name);
+            }
+        }
+        return TCL_OK;
+    }
+    fmt = Tcl_GetString(objv[2]);
+    hPtr = Blt_FindHashEntry(&dataPtr->fmtTable, fmt);
+    if (hPtr == NULL) {
+        LoadFormat(interp, fmt);
+        hPtr = Blt_FindHashEntry(&dataPtr->fmtTable, fmt);
+        if (hPtr == NULL) {
+            Tcl_AppendResult(interp, "can't import table format \"", fmt,
+                             "\": format not registered", (char *)NULL);
+            return TCL_ERROR;
+        }
+    }
+    fmtPtr = Blt_GetHashValue(hPtr);
+    if ((fmtPtr->flags & FMT_LOADED) == 0) {
+        LoadFormat(interp, Tcl_GetString(objv[2]));
+    }
+    if (fmtPtr->importProc == NULL) {
+        Tcl_AppendResult(interp, "can't find table import procedure for \"", 
+                fmtPtr->name, "\" format.", (char *)NULL);
+        return TCL_ERROR;
+    }
+    return (*fmtPtr->importProc) (cmdPtr->table, interp, objc, objv);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * IndexCreateOp --
+ *
+ *      Creates an ordered index for the column.
+ *
+ * Results:
+ *      A standard TCL result.  If the column can't be found or has
+ *      duplicate values when -unique is given, TCL_ERROR is returned and
+ *      an error message is left in the interpreter result.
+ *
+ *      tableName index create columnName ?-unique?
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+IndexCreateOp(ClientData clientData, Tcl_Interp *interp, int objc,
+              Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    BLT_TABLE_COLUMN col;
+    IndexSwitches switches;
+
+    col = blt_table_get_column(interp, cmdPtr->table, objv[3]);
+    if (col == NULL) {
+        return TCL_ERROR;
+    }
+    memset(&switches, 0, sizeof(switches));
+    if (Blt_ParseSwitches(interp, indexSwitches, objc - 4, objv + 4, 
+        &switches, BLT_SWITCH_DEFAULTS) < 0) {
+        return TCL_ERROR;
+    }
+    return blt_table_create_index(interp, cmdPtr->table, col, 
+        switches.flags & INDEX_UNIQUE);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * IndexDeleteOp --
+ *
+ *      Removes the ordered indexes of the given columns.
+ *
+ * Results:
+ *      A standard TCL result.  If a column can't be found, TCL_ERROR is
+ *      returned and an error message is left in the interpreter result.
+ *
+ *      tableName index delete ?columnName ...?
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+IndexDeleteOp(ClientData clientData, Tcl_Interp *interp, int objc,
+              Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    BLT_TABLE_ITERATOR ci;
+    BLT_TABLE_COLUMN col;
+
+    if (blt_table_iterate_columns_objv(interp, cmdPtr->table, objc - 3, 
+        objv + 3, &ci) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    for (col = blt_table_first_tagged_column(&ci); col != NULL; 
+         col = blt_table_next_tagged_column(&ci)) {
+        blt_table_delete_index(cmdPtr->table, col);
+    }
+    blt_table_free_iterator_objv(&ci);
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * IndexNamesOp --
+ *
+ *      Returns the labels of the indexed columns.
+ *
+ * Results:
+ *      Always returns TCL_OK.
+ *
+ *      tableName index names 
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+IndexNamesOp(ClientData clientData, Tcl_Interp *interp, int objc,
+             Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    BLT_TABLE_COLUMN col;
+    Tcl_Obj *listObjPtr;
+
+    listObjPtr = Tcl_NewListObj(0, (Tcl_Obj **) NULL);
+    for (col = blt_table_first_column(cmdPtr->table); col != NULL; 
+         col = blt_table_next_column(col)) {
+        if (blt_table_column_has_index(col)) {
+            Tcl_Obj *objPtr;
+
+            objPtr = Tcl_NewStringObj(blt_table_column_label(col), -1);
+            Tcl_ListObjAppendElement(interp, listObjPtr, objPtr);
+        }
+    }
+    Tcl_SetObjResult(interp, listObjPtr);
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * IndexOp --
+ *
+ *      This procedure is invoked to process index operations.
+ *
+ * Results:
+ *      A standard TCL result.
+ *
+ * Side Effects:
+ *      See the user documentation.
+ *
+ *---------------------------------------------------------------------------
+ */
+static Blt_OpSpec indexOps[] =
+{
+    {"create", 1, IndexCreateOp, 4, 5, "columnName ?-unique?",},
+    {"delete", 1, IndexDeleteOp, 3, 0, "?columnName ...?",},
+    {"names",  1, IndexNamesOp,  3, 3, "",},
+};
+
+static int numIndexOps = sizeof(indexOps) / sizeof(Blt_OpSpec);
+
+static int
+IndexOp(ClientData clientData, Tcl_Interp *interp, int objc,
+        Tcl_Obj *const *objv)
+{
+    Tcl_ObjCmdProc *proc;
+    int result;
+
+    proc = Blt_GetOpFromObj(interp, numIndexOps, indexOps, BLT_OP_ARG2, objc, 
+        objv, 0);
+    if (proc == NULL) {
+        return TCL_ERROR;
+    }
+    result = (*proc)(clientData, interp, objc, objv);
+    return result;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
- * ImportOp --
+ * JoinOp --
+ *
+ *      Joins the rows of the source table whose key column values match
+ *      the rows of the table.  For each source column, a new column is
+ *      added to the table holding the values from the matching rows.
  *
- *      Parses the given command line and calls one of several import-specific
- *      operations.
- *      
  * Results:
- *      Returns a standard TCL result.  It is the result of operation called.
+ *      A standard TCL result.  If a column can't be found or the -on
+ *      list is malformed, TCL_ERROR is returned and an error message is
+ *      left in the interpreter result.
+ *
+ *      tableName join srcTableName -on {col srcCol ...} ?switches?
  *
  *---------------------------------------------------------------------------
  */
 static int
-ImportOp(ClientData clientData, Tcl_Interp *interp, int objc,
-         Tcl_Obj *const *objv)
+JoinOp(ClientData clientData, Tcl_Interp *interp, int objc,
+       Tcl_Obj *const *objv)
 {
     Cmd *cmdPtr = clientData;
-    Blt_HashEntry *hPtr;
-    DataFormat *fmtPtr;
-    TableCmdInterpData *dataPtr;
-    const char *fmt;
+    TableJoinSwitches switches;
+    BLT_TABLE src;
+    BLT_TABLE_COLUMN *keys, *srcKeys, *columns, col;
+    Tcl_Obj **elems;
+    long i, numKeys, numColumns;
+    int numElems, result;
+    unsigned int flags;
 
-    dataPtr = GetTableCmdInterpData(interp);
-    if (objc == 2) {
-        Blt_HashSearch iter;
+    if (blt_table_open(interp, Tcl_GetString(objv[2]), &src) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    memset(&switches, 0, sizeof(TableJoinSwitches));
+    columnIterSwitch.clientData = src;
+    keys = srcKeys = columns = NULL;
+    result = TCL_ERROR;
+    if (Blt_ParseSwitches(interp, tableJoinSwitches, objc - 3, objv + 3, 
+        &switches, BLT_SWITCH_DEFAULTS) < 0) {
+        goto error;
+    }
+    flags = 0;
+    if (switches.typeObjPtr != NULL) {
+        const char *string;
 
-        for (hPtr = Blt_FirstHashEntry(&dataPtr->fmtTable, &iter); 
-             hPtr != NULL; hPtr = Blt_NextHashEntry(&iter)) {
-            fmtPtr = Blt_GetHashValue(hPtr);
-            if (fmtPtr->importProc != NULL) {
-                Tcl_AppendElement(interp, fmtPtr->name);
-            }
+        string = Tcl_GetString(switches.typeObjPtr);
+        if (strcmp(string, "inner") == 0) {
+            flags |= TABLE_JOIN_INNER;
+        } else if (strcmp(string, "left") != 0) {
+            Tcl_AppendResult(interp, "bad join type \"", string, 
+                "\": should be inner or left", (char *)NULL);
+            goto error;
         }
-        return TCL_OK;
     }
-    fmt = Tcl_GetString(objv[2]);
-    hPtr = Blt_FindHashEntry(&dataPtr->fmtTable, fmt);
-    if (hPtr == NULL) {
-        LoadFormat(interp, fmt);
-        hPtr = Blt_FindHashEntry(&dataPtr->fmtTable, fmt);
-        if (hPtr == NULL) {
-            Tcl_AppendResult(interp, "can't import table format \"", fmt,
-                             "\": format not registered", (char *)NULL);
-            return TCL_ERROR;
+    if (switches.onObjPtr == NULL) {
+        Tcl_AppendResult(interp, "missing -on switch", (char *)NULL);
+        goto error;
+    }
+    if (Tcl_ListObjGetElements(interp, switches.onObjPtr, &numElems, &elems)
+        != TCL_OK) {
+        goto error;
+    }
+    if ((numElems == 0) || (numElems & 1)) {
+        Tcl_AppendResult(interp, "odd # of columns in -on list: ",
+                "should be \"columnName srcColumnName...\"", (char *)NULL);
+        goto error;
+    }
+    numKeys = numElems / 2;
+    keys = Blt_AssertMalloc(numKeys * sizeof(BLT_TABLE_COLUMN));
+    srcKeys = Blt_AssertMalloc(numKeys * sizeof(BLT_TABLE_COLUMN));
+    for (i = 0; i < numKeys; i++) {
+        keys[i] = blt_table_get_column(interp, cmdPtr->table, elems[2 * i]);
+        if (keys[i] == NULL) {
+            goto error;
+        }
+        srcKeys[i] = blt_table_get_column(interp, src, elems[2 * i + 1]);
+        if (srcKeys[i] == NULL) {
+            goto error;
         }
     }
-    fmtPtr = Blt_GetHashValue(hPtr);
-    if ((fmtPtr->flags & FMT_LOADED) == 0) {
-        LoadFormat(interp, Tcl_GetString(objv[2]));
+    /* By default, join all the source columns that aren't keys. */
+    if (switches.ci.chain == NULL) {
+        blt_table_iterate_all_columns(src, &switches.ci);
     }
-    if (fmtPtr->importProc == NULL) {
-        Tcl_AppendResult(interp, "can't find table import procedure for \"", 
-                fmtPtr->name, "\" format.", (char *)NULL);
-        return TCL_ERROR;
+    columns = Blt_AssertMalloc((blt_table_num_columns(src) + 1) * 
+                               sizeof(BLT_TABLE_COLUMN));
+    numColumns = 0;
+    for (col = blt_table_first_tagged_column(&switches.ci); col != NULL; 
+         col = blt_table_next_tagged_column(&switches.ci)) {
+        if (switches.ci.chain == NULL) {
+            for (i = 0; i < numKeys; i++) {
+                if (srcKeys[i] == col) {
+                    break;
+                }
+            }
+            if (i < numKeys) {
+                continue;
+            }
+        }
+        columns[numColumns] = col;
+        numColumns++;
     }
-    return (*fmtPtr->importProc) (cmdPtr->table, interp, objc, objv);
+    result = blt_table_join(interp, cmdPtr->table, src, numKeys, keys, 
+        srcKeys, numColumns, columns, flags);
+ error:
+    if (keys != NULL) {
+        Blt_Free(keys);
+    }
+    if (srcKeys != NULL) {
+        Blt_Free(srcKeys);
+    }
+    if (columns != NULL) {
+        Blt_Free(columns);
+    }
+    blt_table_free_iterator_objv(&switches.ci);
+    Blt_FreeSwitches(tableJoinSwitches, &switches, 0);
+    blt_table_close(src);
+    return result;
 }
 
 /*
@@ -5805,6 +8508,11 @@ MinMaxOp(ClientData clientData, Tcl_Interp *interp, int objc,
                                           &maxObjPtr) != TCL_OK) {
                 return TCL_ERROR;
             }
+            if (minObjPtr == NULL) {
+                /* The column has no values. */
+                minObjPtr = Tcl_NewStringObj(cmdPtr->emptyString, -1);
+                maxObjPtr = Tcl_NewStringObj(cmdPtr->emptyString, -1);
+            }
             if (flags & GET_MIN) {
                 Tcl_ListObjAppendElement(interp, listObjPtr, minObjPtr);
             } 
@@ -5827,6 +8535,11 @@ MinMaxOp(ClientData clientData, Tcl_Interp *interp, int objc,
                         &maxObjPtr) != TCL_OK) {
                 return TCL_ERROR;
             }
+            if (minObjPtr == NULL) {
+                /* The column has no values. */
+                minObjPtr = Tcl_NewStringObj(cmdPtr->emptyString, -1);
+                maxObjPtr = Tcl_NewStringObj(cmdPtr->emptyString, -1);
+            }
             if (flags & GET_MIN) {
                 Tcl_ListObjAppendElement(interp, listObjPtr, minObjPtr);
             } 
@@ -5942,6 +8655,54 @@ PackOp(ClientData clientData, Tcl_Interp *interp, int objc,
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RangeOp --
+ *
+ *      Returns the indices of the rows whose values in the column are
+ *      between the low and high values, inclusive.  The rows are ordered
+ *      by value.  The column's index is used if it has one.
+ *
+ * Results:
+ *      A standard TCL result.  If the column can't be found or a value
+ *      can't be converted to the column's type, TCL_ERROR is returned and
+ *      an error message is left in the interpreter result.
+ *
+ *      tableName range columnName low high
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+RangeOp(ClientData clientData, Tcl_Interp *interp, int objc,
+        Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    BLT_TABLE_COLUMN col;
+    BLT_TABLE_ROW *rows;
+    Tcl_Obj *listObjPtr;
+    long i, numRows;
+
+    col = blt_table_get_column(interp, cmdPtr->table, objv[2]);
+    if (col == NULL) {
+        return TCL_ERROR;
+    }
+    if (blt_table_index_range(interp, cmdPtr->table, col, objv[3], objv[4],
+                              &rows, &numRows) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    listObjPtr = Tcl_NewListObj(0, (Tcl_Obj **) NULL);
+    for (i = 0; i < numRows; i++) {
+        Tcl_Obj *objPtr;
+
+        objPtr = GetRowIndexObj(cmdPtr->table, rows[i]);
+        Tcl_ListObjAppendElement(interp, listObjPtr, objPtr);
+    }
+    Blt_Free(rows);
+    Tcl_SetObjResult(interp, listObjPtr);
+    return TCL_OK;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -5971,7 +8732,22 @@ RestoreOp(ClientData clientData, Tcl_Interp *interp, int objc,
                          (char *)NULL);
         goto error;
     }
-    if (switches.dataObjPtr != NULL) {
+    if (switches.flags & TABLE_RESTORE_BINARY) {
+        if (switches.dataObjPtr != NULL) {
+            unsigned char *bytes;
+            int numBytes;
+
+            bytes = Tcl_GetByteArrayFromObj(switches.dataObjPtr, &numBytes);
+            result = blt_table_binary_restore(interp, cmdPtr->table, bytes,
+                numBytes, switches.flags);
+        } else if (switches.fileObjPtr != NULL) {
+            result = blt_table_file_binary_restore(interp, cmdPtr->table, 
+                Tcl_GetString(switches.fileObjPtr), switches.flags);
+        } else {
+            Tcl_AppendResult(interp, "must set either -file and -data switch.",
+                             (char *)NULL);
+        }
+    } else if (switches.dataObjPtr != NULL) {
         result = blt_table_restore(interp, cmdPtr->table, 
                 Tcl_GetString(switches.dataObjPtr), switches.flags);
     } else if (switches.fileObjPtr != NULL) {
@@ -6122,20 +8898,80 @@ RowCreateOp(ClientData clientData, Tcl_Interp *interp, int objc,
     return TCL_ERROR;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RowDeleteWhere --
+ *
+ *      Deletes the rows for which the -where expression is true (or
+ *      false, with -invert).  The expression is evaluated as by the
+ *      "find" operation, over the given rows or all rows if none are
+ *      given.  Empty cells read as the -emptyvalue string, if one is
+ *      given.  The matching rows are collected before any are deleted, so
+ *      the expression never sees a partly deleted table.
+ * 
+ * Results:
+ *      A standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+RowDeleteWhere(Tcl_Interp *interp, Cmd *cmdPtr, RowDeleteSwitches *deletePtr,
+               int objc, Tcl_Obj *const *objv)
+{
+    FindSwitches switches;
+    Blt_ChainLink link;
+    int result;
+
+    memset(&switches, 0, sizeof(switches));
+    if (objc > 0) {
+        if (blt_table_iterate_rows_objv(interp, cmdPtr->table, objc, objv, 
+                &switches.iter) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    } else {
+        blt_table_iterate_all_rows(cmdPtr->table, &switches.iter);
+    }
+    switches.table = cmdPtr->table;
+    switches.emptyValueObjPtr = deletePtr->emptyValueObjPtr;
+    switches.flags = deletePtr->flags & FIND_INVERT;
+    switches.matches = Blt_Chain_Create();
+    Blt_InitHashTable(&switches.varTable, BLT_ONE_WORD_KEYS);
+    result = FindRows(interp, cmdPtr->table, deletePtr->whereObjPtr, 
+                      &switches);
+    if (result == TCL_OK) {
+        Tcl_ResetResult(interp);
+        for (link = Blt_Chain_FirstLink(switches.matches); link != NULL;
+             link = Blt_Chain_NextLink(link)) {
+            BLT_TABLE_ROW row;
+
+            row = Blt_Chain_GetValue(link);
+            result = blt_table_delete_row(cmdPtr->table, row);
+            if (result != TCL_OK) {
+                break;
+            }
+        }
+    }
+    Blt_Chain_Destroy(switches.matches);
+    blt_table_free_iterator_objv(&switches.iter);
+    return result;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
  * RowDeleteOp --
  *
  *      Deletes the rows designated.  One or more rows may be deleted using
- *      a tag.
+ *      a tag or, with the -where switch, an expression.  Switches may come
+ *      before or after the row names.
  * 
  * Results:
  *      A standard TCL result. If the tag or row index is invalid,
  *      TCL_ERROR is returned and an error message is left in the
  *      interpreter result.
  *
- *      tableName row delete ?rowName ...?
+ *      tableName row delete ?switches? ?rowName ...? ?switches?
  *
  *---------------------------------------------------------------------------
  */
@@ -6146,11 +8982,40 @@ RowDeleteOp(ClientData clientData, Tcl_Interp *interp, int objc,
     Cmd *cmdPtr = clientData;
     BLT_TABLE_ITERATOR ri;
     BLT_TABLE_ROW row;
-    int result;
+    RowDeleteSwitches switches;
+    int i, first, numRows, result;
 
+    memset(&switches, 0, sizeof(switches));
+    /* Switches before the row names. */
+    i = Blt_ParseSwitches(interp, rowDeleteSwitches, objc - 3, objv + 3, 
+        &switches, BLT_SWITCH_OBJV_PARTIAL);
+    if (i < 0) {
+        Blt_FreeSwitches(rowDeleteSwitches, &switches, 0);
+        return TCL_ERROR;
+    }
+    first = 3 + i;
+    for (i = first; i < objc; i++) {
+        if (Tcl_GetString(objv[i])[0] == '-') {
+            break;
+        }
+    }
+    numRows = i - first;
+    /* Switches after the row names. */
+    if (Blt_ParseSwitches(interp, rowDeleteSwitches, objc - i, objv + i, 
+        &switches, BLT_SWITCH_DEFAULTS) < 0) {
+        Blt_FreeSwitches(rowDeleteSwitches, &switches, 0);
+        return TCL_ERROR;
+    }
+    if (switches.whereObjPtr != NULL) {
+        result = RowDeleteWhere(interp, cmdPtr, &switches, numRows, 
+                                objv + first);
+        Blt_FreeSwitches(rowDeleteSwitches, &switches, 0);
+        return result;
+    }
+    Blt_FreeSwitches(rowDeleteSwitches, &switches, 0);
     result = TCL_ERROR;
-    if (blt_table_iterate_rows_objv(interp, cmdPtr->table, objc - 3, objv + 3, 
-        &ri) != TCL_OK) {
+    if (blt_table_iterate_rows_objv(interp, cmdPtr->table, numRows, 
+        objv + first, &ri) != TCL_OK) {
         goto error;
     }
     for (row = blt_table_first_tagged_row(&ri); row != NULL; 
@@ -7274,7 +10139,8 @@ RowTagExistsOp(ClientData clientData, Tcl_Interp *interp, int objc,
     const char *tag;
 
     tag = Tcl_GetString(objv[4]);
-    bool = (blt_table_get_tagged_rows(cmdPtr->table, tag) != NULL);
+    bool = (Blt_FindHashEntry(blt_table_get_row_tag_table(cmdPtr->table), 
+                              tag) != NULL);
     if (objc == 6) {
         BLT_TABLE_ROW row;
 
@@ -7425,27 +10291,21 @@ GetRowTagMatches(BLT_TABLE table, int objc, Tcl_Obj *const *objv)
     }
     /* Now check user-defined tags. */
     for (i = 0; i < objc; i++) {
-        Blt_Chain chain;
-        Blt_ChainLink link;
+        BLT_TABLE_ITERATOR iter;
+        BLT_TABLE_ROW row;
         const char *tag;
         
         tag = Tcl_GetString(objv[i]);
         if ((strcmp("all", tag) == 0) || (strcmp("end", tag) == 0)) {
             continue;
         }
-        chain = blt_table_get_tagged_rows(table, tag);
-        if (chain == NULL) {
+        if (blt_table_iterate_row_tag(table, tag, &iter) != TCL_OK) {
             Blt_Free(matches);
             return NULL;
         }
-        for (link = Blt_Chain_FirstLink(chain); link != NULL; 
-             link = Blt_Chain_NextLink(link)) {
-            BLT_TABLE_ROW row;
-            size_t j;
-            
-            row = Blt_Chain_GetValue(link);
-            j = blt_table_row_index(table, row);
-            matches[j] = TRUE;
+        for (row = blt_table_first_tagged_row(&iter); row != NULL; 
+             row = blt_table_next_tagged_row(&iter)) {
+            matches[blt_table_row_index(table, row)] = TRUE;
         }
     }
     return matches;
@@ -7927,7 +10787,7 @@ static Blt_OpSpec rowOps[] =
 {
     {"copy",      2, RowCopyOp,     5, 0, "destRow srcRow ?switches?",},
     {"create",    2, RowCreateOp,   3, 0, "?switches...?",},
-    {"delete",    2, RowDeleteOp,   3, 0, "?rowName ...?",},
+    {"delete",    2, RowDeleteOp,   3, 0, "?switches? ?rowName ...?",},
     {"duplicate", 2, RowDupOp,      3, 0, "?rowName ...?",},
     {"empty",     3, RowEmptyOp,    4, 4, "rowName",},
     {"exists",    3, RowExistsOp,   4, 4, "rowName",},
@@ -8047,7 +10907,7 @@ SortOp(ClientData clientData, Tcl_Interp *interp, int objc,
     BLT_TABLE_SORT_ORDER *sp, *order;
     SortSwitches switches;
     int result;
-    long numColumns, numRows;
+    long numColumns, numRows, first, last;
 
     result = TCL_ERROR;
     order = NULL;
@@ -8056,6 +10916,8 @@ SortOp(ClientData clientData, Tcl_Interp *interp, int objc,
     /* Process switches  */
     memset(&switches, 0, sizeof(SortSwitches));
     switches.tsFlags = TABLE_SORT_AUTO;
+    switches.limit = -1;
+    switches.range[0] = -1;
     rowIterSwitch.clientData = cmdPtr->table;
     columnIterSwitch.clientData = cmdPtr->table;
     blt_table_iterate_all_columns(cmdPtr->table, &switches.ci);
@@ -8083,6 +10945,22 @@ SortOp(ClientData clientData, Tcl_Interp *interp, int objc,
             goto error;
         }
     }
+    if ((switches.limit >= 0) || (switches.range[0] >= 0)) {
+        if (switches.flags & SORT_UNIQUE) {
+            Tcl_AppendResult(interp,
+                 "-unique switch is incompatible with -limit and -range.",
+                (char *)NULL);
+            goto error;
+        }
+        if ((switches.freqArrVarObjPtr != NULL) || 
+            (switches.freqListVarObjPtr != NULL) || 
+            (switches.flags & SORT_BYFREQ)) {
+            Tcl_AppendResult(interp,
+                 "frequency switches are incompatible with -limit and -range.",
+                (char *)NULL);
+            goto error;
+        }
+    }
     numColumns = switches.ci.numEntries;
     if (numColumns == 0) {
         goto error;
@@ -8133,8 +11011,25 @@ SortOp(ClientData clientData, Tcl_Interp *interp, int objc,
         }
         numRows = i;
     }
-    /* Sort the row map. */
-    blt_table_sort_row_map(cmdPtr->table, numRows, map);
+    /* Determine the sorted rows wanted. */
+    first = 0;
+    last = numRows - 1;
+    if (switches.range[0] >= 0) {
+        first = switches.range[0];
+        if ((switches.range[1] >= 0) && (switches.range[1] < last)) {
+            last = switches.range[1];
+        }
+    }
+    if ((switches.limit >= 0) && (switches.limit <= last)) {
+        last = switches.limit - 1;
+    }
+    /* Sort the row map.  If only some of the leading rows are wanted,
+     * select and sort just those. */
+    if (last < (numRows - 1)) {
+        blt_table_partial_sort_row_map(cmdPtr->table, numRows, map, last + 1);
+    } else {
+        blt_table_sort_row_map(cmdPtr->table, numRows, map);
+    }
     
     if ((switches.freqArrVarObjPtr != NULL) || 
         (switches.freqListVarObjPtr != NULL) || 
@@ -8147,8 +11042,12 @@ SortOp(ClientData clientData, Tcl_Interp *interp, int objc,
     if (switches.flags & SORT_UNIQUE) {
         result = SetUniqueSortedResult(interp, cmdPtr, numRows, map, col, 
                                        &switches);
+    } else if (first <= last) {
+        result = SetSortedResult(interp, cmdPtr, last - first + 1, map + first,
+                col, &switches);
     } else {
-        result = SetSortedResult(interp, cmdPtr, numRows, map, col, &switches);
+        Tcl_ResetResult(interp);
+        result = TCL_OK;
     }
     if (result != TCL_OK) {
         goto error;
@@ -8683,6 +11582,48 @@ TraceOp(ClientData clientData, Tcl_Interp *interp, int objc,
     return result;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TransactionOp --
+ *
+ *      Evaluates a script as a single batch of updates.  Traces (other
+ *      than those created with the "e" flag) are fired once, after the
+ *      script completes, instead of for each cell changed.  The batch is
+ *      ended even if the script fails.
+ * 
+ * Results:
+ *      A standard TCL result.  It is the result of the script.
+ *      
+ *      tableName transaction script
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+TransactionOp(ClientData clientData, Tcl_Interp *interp, int objc,
+              Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr = clientData;
+    Tcl_InterpState state;
+    int result;
+
+    blt_table_begin_batch(cmdPtr->table);
+    result = Tcl_EvalObjEx(interp, objv[2], 0);
+    if (result == TCL_ERROR) {
+        Tcl_AddErrorInfo(interp, "\n    (\"transaction\" script)");
+    }
+    if (cmdPtr->table != NULL) {
+        /* Trace procedures fired at the end of the batch may overwrite
+         * the result of the script. */
+        state = Tcl_SaveInterpState(interp, result);
+        blt_table_end_batch(cmdPtr->table);
+        result = Tcl_RestoreInterpState(interp, state);
+    }
+    /* Otherwise the table was destroyed by the script and its batches
+     * already ended. */
+    return result;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -9153,6 +12094,7 @@ WatchOp(ClientData clientData, Tcl_Interp *interp, int objc,
 static Blt_OpSpec tableOps[] =
 {
     {"add",        2, AddOp,        3, 0, "tableName ?switches?",},
+    {"aggregate",  2, AggregateOp,  2, 0, "?switches?",},
     {"append",     2, AppendOp,     5, 0, "rowName columnName ?value ...?",},
     {"attach",     2, AttachOp,     2, 3, "tableName",},
     {"column",     3, ColumnOp,     3, 0, "op args...",},
@@ -9166,7 +12108,9 @@ static Blt_OpSpec tableOps[] =
     {"export",     3, ExportOp,     2, 0, "formatName args...",},
     {"find",       1, FindOp,       3, 0, "exprString ?switches?",},
     {"get",        1, GetOp,        4, 5, "rowName columnName ?defValue?",},
-    {"import",     1, ImportOp,     2, 0, "formatName args...",},
+    {"import",     2, ImportOp,     2, 0, "formatName args...",},
+    {"index",      2, IndexOp,      3, 0, "op args...",},
+    {"join",       1, JoinOp,       3, 0, "srcTableName ?switches?",},
     {"keys",       1, KeysOp,       2, 0, "?columnName ...?",},
     {"lappend",    2, LappendOp,    5, 0, "rowName columnName ?value ...?",},
     {"limits",     2, MinMaxOp,     2, 3, "?columnName?",},
@@ -9176,11 +12120,13 @@ static Blt_OpSpec tableOps[] =
     {"numcolumns", 4, NumColumnsOp, 2, 3, "?numColumns?",},
     {"numrows",    4, NumRowsOp,    2, 3, "?numRows?",},
     {"pack",       1, PackOp,       2, 2, "",},
+    {"range",      2, RangeOp,      5, 5, "columnName low high",},
     {"restore",    2, RestoreOp,    2, 0, "?switches?",},
     {"row",        2, RowOp,        3, 0, "op args...",},
     {"set",        2, SetOp,        3, 0, "?rowName columnName value ...?",},
     {"sort",       2, SortOp,       3, 0, "?flags ...?",},
-    {"trace",      2, TraceOp,      2, 0, "op args...",},
+    {"trace",      4, TraceOp,      2, 0, "op args...",},
+    {"transaction", 4, TransactionOp, 3, 3, "script",},
     {"unset",      1, UnsetOp,      4, 0, "?rowName columnName ...?",},
     {"watch",      1, WatchOp,      2, 0, "op args...",},
 #ifdef notplanned
@@ -9246,6 +12192,12 @@ TableInstObjCmd(
  *
  *---------------------------------------------------------------------------
  */
+static void
+FreeCmd(DestroyData data)
+{
+    Blt_Free(data);
+}
+
 static void
 TableInstDeleteProc(ClientData clientData)
 {
@@ -9276,7 +12228,8 @@ TableInstDeleteProc(ClientData clientData)
         Blt_DeleteHashEntry(cmdPtr->tablePtr, cmdPtr->hPtr);
     }
     blt_table_close(cmdPtr->table);
-    Blt_Free(cmdPtr);
+    cmdPtr->table = NULL;
+    Tcl_EventuallyFree(cmdPtr, FreeCmd);
 }
 
 /*
@@ -9375,6 +12328,69 @@ TableCreateOp(ClientData clientData, Tcl_Interp *interp, int objc,
     return TCL_ERROR;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TableOpenOp --
+ *
+ *      Creates a new table object from a binary snapshot file (see the
+ *      "dump -binary" operation).  The file is mapped into memory and
+ *      numeric columns read their values directly from the mapping, so
+ *      that processes opening the same snapshot share its pages.  Pages
+ *      are copied only as cells are modified.
+ *      
+ * Results:
+ *      A standard TCL result.  If the table is successfully created, the
+ *      namespace-qualified name of the instance is returned.
+ *
+ *      blt::datatable open -mmap fileName ?tableName?
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+TableOpenOp(ClientData clientData, Tcl_Interp *interp, int objc, 
+            Tcl_Obj *const *objv)
+{
+    Cmd *cmdPtr;
+    Tcl_Obj *args[3];
+    Tcl_Obj *nameObjPtr;
+    const char *string;
+
+    string = Tcl_GetString(objv[2]);
+    if (strcmp(string, "-mmap") != 0) {
+        Tcl_AppendResult(interp, "bad switch \"", string, 
+                "\": should be -mmap", (char *)NULL);
+        return TCL_ERROR;
+    }
+    args[0] = objv[0];
+    args[1] = objv[1];
+    args[2] = (objc == 5) ? objv[4] : NULL;
+    if (TableCreateOp(clientData, interp, objc - 2, args) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    nameObjPtr = Tcl_GetObjResult(interp);
+    Tcl_IncrRefCount(nameObjPtr);
+    cmdPtr = GetTableCmd(interp, Tcl_GetString(nameObjPtr));
+    assert(cmdPtr != NULL);
+    Tcl_ResetResult(interp);
+    if (blt_table_map_snapshot(interp, cmdPtr->table, 
+                Tcl_GetString(objv[3])) != TCL_OK) {
+        Tcl_Obj *errObjPtr;
+
+        errObjPtr = Tcl_GetObjResult(interp);
+        Tcl_IncrRefCount(errObjPtr);
+        Tcl_DeleteCommandFromToken(interp, cmdPtr->cmdToken);
+        Tcl_SetObjResult(interp, errObjPtr);
+        Tcl_DecrRefCount(errObjPtr);
+        Tcl_DecrRefCount(nameObjPtr);
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, nameObjPtr);
+    Tcl_DecrRefCount(nameObjPtr);
+    return TCL_OK;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -9538,9 +12554,17 @@ TableLoadOp(ClientData clientData, Tcl_Interp *interp, int objc,
     Blt_FmtString(safeProcName, 11 + length + 9+1, "blt_table_%s_safe_init", fmt);
 
     Tcl_DStringAppend(&libName, "/", -1);
-    Tcl_UtfToTitle((char *)fmt);
     Tcl_DStringAppend(&libName, "Table", 5);
-    Tcl_DStringAppend(&libName, fmt, -1);
+    {
+        int offset;
+
+        /* Title-case a copy of the format name.  The string belongs to
+         * the argument object, which may be a shared literal. */
+        offset = Tcl_DStringLength(&libName);
+        Tcl_DStringAppend(&libName, fmt, -1);
+        Tcl_DStringSetLength(&libName, offset + 
+                Tcl_UtfToTitle(Tcl_DStringValue(&libName) + offset));
+    }
     Tcl_DStringAppend(&libName, Blt_Itoa(BLT_MAJOR_VERSION), 1);
     Tcl_DStringAppend(&libName, Blt_Itoa(BLT_MINOR_VERSION), 1);
     Tcl_DStringAppend(&libName, BLT_LIB_SUFFIX, -1);
@@ -9572,6 +12596,7 @@ static Blt_OpSpec tableCmdOps[] =
     {"exists",  1, TableExistsOp,  3, 3, "tableName",},
     {"load",    1, TableLoadOp,    4, 4, "tableName libpath",},
     {"names",   1, TableNamesOp,   2, 0, "?pattern ...?",},
+    {"open",    1, TableOpenOp,    4, 5, "-mmap fileName ?tableName?",},
 };
 
 static int numCmdOps = sizeof(tableCmdOps) / sizeof(Blt_OpSpec);
@@ -0,0 +1,970 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * bltDataTableColumnar.c --
+ *
+ * Copyright 2015 George A. Howlett. All rights reserved.  
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are
+ *   met:
+ *
+ *   1) Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2) Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the
+ *      distribution.
+ *   3) Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *   4) Products derived from this software may not be called "BLT" nor may
+ *      "BLT" appear in their names without specific prior written
+ *      permission from the author.
+ *
+ *   THIS SOFTWARE IS PROVIDED ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ *   WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ *   BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ *   OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ *   IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * The "columnar" format is a binary image of the table laid out column by
+ * column, in the spirit of the Arrow IPC format.  Each column is stored
+ * as a validity bitmap followed by a buffer of fixed-width values (or,
+ * for strings and blobs, a buffer of offsets and a buffer of bytes).
+ * Reading a file is mostly a matter of copying the buffers into the
+ * table's own column arrays.
+ *
+ * All numbers are in the byte order of the machine that wrote the file.
+ * Every block starts on an 8-byte boundary.
+ *
+ *      header          magic "BLTCOL01", byte order mark, flags, 
+ *                      # of rows, # of columns.
+ *      column ...      block descriptor, label, bitmap, offsets
+ *                      (strings and blobs only), and values.
+ *
+ * The bitmap has a bit for each row (least significant bit first) that
+ * is set if the cell has a value.  Strings and blobs have numRows + 1
+ * 64-bit offsets into the value buffer.  If row labels are exported, they
+ * are stored in a string column block marked COLUMNAR_ROW_LABELS.
+ */
+
+#include <bltInt.h>
+
+#ifndef NO_DATATABLE
+#include "config.h"
+#include <tcl.h>
+#include <bltSwitch.h>
+#include <bltDataTable.h>
+#include <bltAlloc.h>
+
+#ifdef HAVE_MEMORY_H
+  #include <memory.h>
+#endif /* HAVE_MEMORY_H */
+
+#ifdef HAVE_STRING_H
+  #include <string.h>
+#endif /* HAVE_STRING_H */
+
+DLLEXPORT extern Tcl_AppInitProc blt_table_columnar_init;
+DLLEXPORT extern Tcl_AppInitProc blt_table_columnar_safe_init;
+
+#define TRUE    1
+#define FALSE   0
+
+#define COLUMNAR_MAGIC          "BLTCOL01"
+#define COLUMNAR_BYTE_ORDER     0x01020304
+#define COLUMNAR_ROW_LABELS     (1<<0)  /* Block holds the row labels. */
+
+#define EXPORT_ROWLABELS        (1<<0)
+
+#define PAD8(n)         (((n) + 7) & ~((size_t)7))
+#define BITMAP_SIZE(n)  PAD8(((n) + 7) / 8)
+
+/* Type codes used in the file.  These are independent of the
+ * BLT_TABLE_COLUMN_TYPE values, which may change. */
+enum ColumnarTypes {
+    COLUMNAR_STRING, COLUMNAR_DOUBLE, COLUMNAR_LONG, COLUMNAR_INT64,
+    COLUMNAR_TIME, COLUMNAR_BOOLEAN, COLUMNAR_BLOB
+};
+
+typedef struct {
+    char magic[8];                      /* "BLTCOL01" */
+    uint32_t byteOrder;                 /* COLUMNAR_BYTE_ORDER as written
+                                         * by the machine. */
+    uint32_t flags;                     /* Reserved. */
+    int64_t numRows;
+    int64_t numColumns;
+} ColumnarHeader;
+
+typedef struct {
+    int32_t type;                       /* Type code of the column. */
+    int32_t width;                      /* # of bytes per value, or 0 if
+                                         * the values have offsets. */
+    int32_t labelLength;                /* # of bytes in the label. */
+    int32_t flags;                      
+    int64_t dataLength;                 /* # of bytes of values. */
+    int64_t reserved;
+} ColumnarBlock;
+
+/*
+ * ImportSwitches --
+ */
+typedef struct {
+    Tcl_Obj *fileObjPtr;                /* Name of file representing the
+                                         * channel used as the input
+                                         * source. */
+    Tcl_Obj *dataObjPtr;                /* If non-NULL, data object to use
+                                         * as input source. */
+} ImportSwitches;
+
+static Blt_SwitchSpec importSwitches[] = 
+{
+    {BLT_SWITCH_OBJ,    "-data",      "data", (char *)NULL,
+        Blt_Offset(ImportSwitches, dataObjPtr), 0, 0, NULL},
+    {BLT_SWITCH_OBJ,    "-file",      "fileName", (char *)NULL,
+        Blt_Offset(ImportSwitches, fileObjPtr), 0},
+    {BLT_SWITCH_END}
+};
+
+/*
+ * ExportSwitches --
+ */
+typedef struct {
+    BLT_TABLE_ITERATOR ri, ci;
+    unsigned int flags;
+    Tcl_Obj *fileObjPtr;
+} ExportSwitches;
+
+static Blt_SwitchFreeProc ColumnIterFreeProc;
+static Blt_SwitchParseProc ColumnIterSwitchProc;
+static Blt_SwitchCustom columnIterSwitch = {
+    ColumnIterSwitchProc, NULL, ColumnIterFreeProc, 0,
+};
+static Blt_SwitchFreeProc RowIterFreeProc;
+static Blt_SwitchParseProc RowIterSwitchProc;
+static Blt_SwitchCustom rowIterSwitch = {
+    RowIterSwitchProc, NULL, RowIterFreeProc, 0,
+};
+
+static Blt_SwitchSpec exportSwitches[] = 
+{
+    {BLT_SWITCH_CUSTOM, "-columns",   "columns" ,(char *)NULL,
+        Blt_Offset(ExportSwitches, ci),   0, 0, &columnIterSwitch},
+    {BLT_SWITCH_OBJ,    "-file",      "fileName", (char *)NULL,
+        Blt_Offset(ExportSwitches, fileObjPtr), 0},
+    {BLT_SWITCH_BITS_NOARG, "-rowlabels",  "", (char *)NULL,
+        Blt_Offset(ExportSwitches, flags), 0, EXPORT_ROWLABELS},
+    {BLT_SWITCH_CUSTOM, "-rows",      "rows", (char *)NULL,
+        Blt_Offset(ExportSwitches, ri),   0, 0, &rowIterSwitch},
+    {BLT_SWITCH_END}
+};
+
+static BLT_TABLE_IMPORT_PROC ImportProc;
+static BLT_TABLE_EXPORT_PROC ExportProc;
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ColumnIterFreeProc --
+ *
+ *      Free the storage associated with the -columns switch.
+ *
+ * Results:
+ *      None.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static void
+ColumnIterFreeProc(ClientData clientData, char *record, int offset, int flags)
+{
+    BLT_TABLE_ITERATOR *iterPtr = (BLT_TABLE_ITERATOR *)(record + offset);
+
+    blt_table_free_iterator_objv(iterPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ColumnIterSwitchProc --
+ *
+ *      Convert a Tcl_Obj representing an offset in the table.
+ *
+ * Results:
+ *      The return value is a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+ColumnIterSwitchProc(
+    ClientData clientData,              /* Table to iterate over. */
+    Tcl_Interp *interp,                 /* Interpreter to report results. */
+    const char *switchName,             /* Not used. */
+    Tcl_Obj *objPtr,                    /* String representation */
+    char *record,                       /* Structure record */
+    int offset,                         /* Offset to field in structure */
+    int flags)                          /* Not used. */
+{
+    BLT_TABLE_ITERATOR *iterPtr = (BLT_TABLE_ITERATOR *)(record + offset);
+    BLT_TABLE table;
+    Tcl_Obj **objv;
+    int objc;
+
+    table = clientData;
+    if (Tcl_ListObjGetElements(interp, objPtr, &objc, &objv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (blt_table_iterate_columns_objv(interp, table, objc, objv, iterPtr)
+        != TCL_OK) {
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RowIterFreeProc --
+ *
+ *      Free the storage associated with the -rows switch.
+ *
+ * Results:
+ *      None.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static void
+RowIterFreeProc(ClientData clientData, char *record, int offset, int flags)
+{
+    BLT_TABLE_ITERATOR *iterPtr = (BLT_TABLE_ITERATOR *)(record + offset);
+
+    blt_table_free_iterator_objv(iterPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RowIterSwitchProc --
+ *
+ *      Convert a Tcl_Obj representing an offset in the table.
+ *
+ * Results:
+ *      The return value is a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+RowIterSwitchProc(
+    ClientData clientData,              /* Table to iterate over. */
+    Tcl_Interp *interp,                 /* Interpreter to report results. */
+    const char *switchName,             /* Not used. */
+    Tcl_Obj *objPtr,                    /* String representation */
+    char *record,                       /* Structure record */
+    int offset,                         /* Offset to field in structure */
+    int flags)                          /* Not used. */
+{
+    BLT_TABLE_ITERATOR *iterPtr = (BLT_TABLE_ITERATOR *)(record + offset);
+    BLT_TABLE table;
+    Tcl_Obj **objv;
+    int objc;
+
+    table = clientData;
+    if (Tcl_ListObjGetElements(interp, objPtr, &objc, &objv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (blt_table_iterate_rows_objv(interp, table, objc, objv, iterPtr)
+        != TCL_OK) {
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+static const char zeros[8];
+
+static int
+ColumnTypeToCode(BLT_TABLE_COLUMN_TYPE type, int *widthPtr)
+{
+    switch (type) {
+    case TABLE_COLUMN_TYPE_DOUBLE:
+        *widthPtr = 8;
+        return COLUMNAR_DOUBLE;
+    case TABLE_COLUMN_TYPE_LONG:
+        *widthPtr = 8;
+        return COLUMNAR_LONG;
+    case TABLE_COLUMN_TYPE_INT64:
+        *widthPtr = 8;
+        return COLUMNAR_INT64;
+    case TABLE_COLUMN_TYPE_TIME:
+        *widthPtr = 8;
+        return COLUMNAR_TIME;
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        *widthPtr = 4;
+        return COLUMNAR_BOOLEAN;
+    case TABLE_COLUMN_TYPE_BLOB:
+        *widthPtr = 0;
+        return COLUMNAR_BLOB;
+    default:
+        *widthPtr = 0;
+        return COLUMNAR_STRING;
+    }
+}
+
+static int
+CodeToColumnType(int code, int width, BLT_TABLE_COLUMN_TYPE *typePtr)
+{
+    BLT_TABLE_COLUMN_TYPE type;
+    int needed;
+
+    switch (code) {
+    case COLUMNAR_STRING:       type = TABLE_COLUMN_TYPE_STRING;  break;
+    case COLUMNAR_DOUBLE:       type = TABLE_COLUMN_TYPE_DOUBLE;  break;
+    case COLUMNAR_LONG:         type = TABLE_COLUMN_TYPE_LONG;    break;
+    case COLUMNAR_INT64:        type = TABLE_COLUMN_TYPE_INT64;   break;
+    case COLUMNAR_TIME:         type = TABLE_COLUMN_TYPE_TIME;    break;
+    case COLUMNAR_BOOLEAN:      type = TABLE_COLUMN_TYPE_BOOLEAN; break;
+    case COLUMNAR_BLOB:         type = TABLE_COLUMN_TYPE_BLOB;    break;
+    default:
+        return FALSE;
+    }
+    ColumnTypeToCode(type, &needed);
+    if (width != needed) {
+        return FALSE;
+    }
+    *typePtr = type;
+    return TRUE;
+}
+
+/* 
+ * Appends count bytes to the dynamic string, followed by zeros up to the
+ * next 8-byte boundary.  Returns a pointer to the bytes appended.
+ */
+static unsigned char *
+AppendBlock(Tcl_DString *dsPtr, const void *bytes, size_t count)
+{
+    size_t length;
+    unsigned char *bp;
+
+    length = Tcl_DStringLength(dsPtr);
+    Tcl_DStringSetLength(dsPtr, length + PAD8(count));
+    bp = (unsigned char *)Tcl_DStringValue(dsPtr) + length;
+    if (bytes != NULL) {
+        memcpy(bp, bytes, count);
+    } else {
+        memset(bp, 0, count);
+    }
+    memset(bp + count, 0, PAD8(count) - count);
+    return bp;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ExportColumn --
+ *
+ *      Appends the block of a single column to the dynamic string.  If
+ *      col is NULL, the row labels are written instead.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+ExportColumn(Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col,
+             size_t numRows, BLT_TABLE_ROW *rows, Tcl_DString *dsPtr)
+{
+    ColumnarBlock block;
+    BLT_TABLE_COLUMN_TYPE type;
+    const char *label;
+    size_t i, start;
+    unsigned char *bitmap;
+
+    memset(&block, 0, sizeof(block));
+    if (col == NULL) {
+        type = TABLE_COLUMN_TYPE_STRING;
+        label = "";
+        block.flags = COLUMNAR_ROW_LABELS;
+    } else {
+        type = blt_table_column_type(col);
+        label = blt_table_column_label(col);
+    }
+    block.type = ColumnTypeToCode(type, &block.width);
+    block.labelLength = strlen(label);
+    start = Tcl_DStringLength(dsPtr);
+    AppendBlock(dsPtr, &block, sizeof(block));
+    AppendBlock(dsPtr, label, block.labelLength);
+
+    /* The bitmap, offsets, and values are reserved first and then filled
+     * in, since appending may move the dynamic string. */
+    if (block.width > 0) {
+        size_t bitmapStart, valuesStart;
+
+        bitmapStart = Tcl_DStringLength(dsPtr);
+        AppendBlock(dsPtr, NULL, (numRows + 7) / 8);
+        valuesStart = Tcl_DStringLength(dsPtr);
+        AppendBlock(dsPtr, NULL, numRows * block.width);
+        bitmap = (unsigned char *)Tcl_DStringValue(dsPtr) + bitmapStart;
+        for (i = 0; i < numRows; i++) {
+            unsigned char *p;
+
+            if (!blt_table_value_exists(table, rows[i], col)) {
+                continue;
+            }
+            bitmap[i >> 3] |= (1 << (i & 7));
+            p = (unsigned char *)Tcl_DStringValue(dsPtr) + valuesStart + 
+                i * block.width;
+            switch (type) {
+            case TABLE_COLUMN_TYPE_DOUBLE:
+            case TABLE_COLUMN_TYPE_TIME:
+                {
+                    double d;
+
+                    d = blt_table_get_double(interp, table, rows[i], col);
+                    memcpy(p, &d, 8);
+                }
+                break;
+            case TABLE_COLUMN_TYPE_LONG:
+                {
+                    int64_t i64;
+
+                    i64 = blt_table_get_long(interp, table, rows[i], col, 0);
+                    memcpy(p, &i64, 8);
+                }
+                break;
+            case TABLE_COLUMN_TYPE_INT64:
+                {
+                    int64_t i64;
+
+                    i64 = blt_table_get_int64(interp, table, rows[i], col, 0);
+                    memcpy(p, &i64, 8);
+                }
+                break;
+            case TABLE_COLUMN_TYPE_BOOLEAN:
+                {
+                    int32_t i32;
+
+                    i32 = blt_table_get_boolean(interp, table, rows[i], col,
+                                                FALSE);
+                    memcpy(p, &i32, 4);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        block.dataLength = numRows * block.width;
+    } else {
+        size_t bitmapStart, offsetsStart;
+        int64_t offset;
+
+        bitmapStart = Tcl_DStringLength(dsPtr);
+        AppendBlock(dsPtr, NULL, (numRows + 7) / 8);
+        offsetsStart = Tcl_DStringLength(dsPtr);
+        AppendBlock(dsPtr, NULL, (numRows + 1) * sizeof(int64_t));
+        offset = 0;
+        for (i = 0; i < numRows; i++) {
+            const char *bytes;
+            size_t length;
+            
+            bytes = NULL;
+            length = 0;
+            if (col == NULL) {
+                bytes = blt_table_row_label(rows[i]);
+                length = strlen(bytes);
+            } else if (blt_table_value_exists(table, rows[i], col)) {
+                BLT_TABLE_VALUE value;
+
+                value = blt_table_get_value(table, rows[i], col);
+                if (type == TABLE_COLUMN_TYPE_BLOB) {
+                    bytes = (const char *)blt_table_value_bytes(value);
+                } else {
+                    bytes = blt_table_value_string(value);
+                }
+                length = blt_table_value_length(value);
+            }
+            if (bytes != NULL) {
+                bitmap = (unsigned char *)Tcl_DStringValue(dsPtr) + 
+                    bitmapStart;
+                bitmap[i >> 3] |= (1 << (i & 7));
+                Tcl_DStringAppend(dsPtr, bytes, length);
+            }
+            offset += length;
+            memcpy(Tcl_DStringValue(dsPtr) + offsetsStart + 
+                   (i + 1) * sizeof(int64_t), &offset, sizeof(int64_t));
+        }
+        block.dataLength = offset;
+        Tcl_DStringAppend(dsPtr, zeros, PAD8(offset) - offset);
+    }
+    memcpy(Tcl_DStringValue(dsPtr) + start, &block, sizeof(block));
+}
+
+/* 
+ * $table export columnar ?switches...?
+ */
+static int
+ExportProc(BLT_TABLE table, Tcl_Interp *interp, int objc, Tcl_Obj *const *objv)
+{
+    ExportSwitches switches;
+    ColumnarHeader header;
+    BLT_TABLE_ROW row, *rows;
+    BLT_TABLE_COLUMN col;
+    Tcl_Channel channel;
+    Tcl_DString ds;
+    int closeChannel;
+    int result;
+    size_t numRows;
+
+    closeChannel = FALSE;
+    channel = NULL;
+    rows = NULL;
+    Tcl_DStringInit(&ds);
+    memset(&switches, 0, sizeof(switches));
+    rowIterSwitch.clientData = table;
+    columnIterSwitch.clientData = table;
+    blt_table_iterate_all_rows(table, &switches.ri);
+    blt_table_iterate_all_columns(table, &switches.ci);
+    if (Blt_ParseSwitches(interp, exportSwitches, objc - 3, objv + 3, &switches,
+        BLT_SWITCH_DEFAULTS) < 0) {
+        return TCL_ERROR;
+    }
+    result = TCL_ERROR;
+    if (switches.fileObjPtr != NULL) {
+        const char *fileName;
+
+        closeChannel = TRUE;
+        fileName = Tcl_GetString(switches.fileObjPtr);
+        if ((fileName[0] == '@') && (fileName[1] != '\0')) {
+            int mode;
+            
+            channel = Tcl_GetChannel(interp, fileName+1, &mode);
+            if (channel == NULL) {
+                goto error;
+            }
+            if ((mode & TCL_WRITABLE) == 0) {
+                Tcl_AppendResult(interp, "channel \"", fileName, 
+                                 "\" not opened for writing", (char *)NULL);
+                goto error;
+            }
+            closeChannel = FALSE;
+        } else {
+            channel = Tcl_OpenFileChannel(interp, fileName, "w", 0666);
+            if (channel == NULL) {
+                goto error;     /* Can't open export file. */
+            }
+        }
+        if (Tcl_SetChannelOption(interp, channel, "-translation", "binary")
+            != TCL_OK) {
+            goto error;
+        }
+    }
+    rows = Blt_AssertMalloc((blt_table_num_rows(table) + 1) * 
+                            sizeof(BLT_TABLE_ROW));
+    numRows = 0;
+    for (row = blt_table_first_tagged_row(&switches.ri); row != NULL; 
+         row = blt_table_next_tagged_row(&switches.ri)) {
+        rows[numRows] = row;
+        numRows++;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COLUMNAR_MAGIC, 8);
+    header.byteOrder = COLUMNAR_BYTE_ORDER;
+    header.numRows = numRows;
+    AppendBlock(&ds, &header, sizeof(header));
+    if (switches.flags & EXPORT_ROWLABELS) {
+        ExportColumn(interp, table, NULL, numRows, rows, &ds);
+        header.numColumns++;
+    }
+    for (col = blt_table_first_tagged_column(&switches.ci); col != NULL; 
+         col = blt_table_next_tagged_column(&switches.ci)) {
+        ExportColumn(interp, table, col, numRows, rows, &ds);
+        header.numColumns++;
+    }
+    memcpy(Tcl_DStringValue(&ds), &header, sizeof(header));
+    if (channel != NULL) {
+        if (Tcl_Write(channel, Tcl_DStringValue(&ds), Tcl_DStringLength(&ds))
+            < 0) {
+            Tcl_AppendResult(interp, "error writing \"", 
+                Tcl_GetString(switches.fileObjPtr), "\": ", 
+                Tcl_PosixError(interp), (char *)NULL);
+            goto error;
+        }
+    } else {
+        Tcl_SetObjResult(interp, Tcl_NewByteArrayObj(
+                (unsigned char *)Tcl_DStringValue(&ds), Tcl_DStringLength(&ds)));
+    }
+    result = TCL_OK;
+ error:
+    if (rows != NULL) {
+        Blt_Free(rows);
+    }
+    Tcl_DStringFree(&ds);
+    if (closeChannel) {
+        Tcl_Close(interp, channel);
+    }
+    Blt_FreeSwitches(exportSwitches, (char *)&switches, 0);
+    return result;
+}
+
+/*
+ * ColumnarBuffers --
+ *
+ *      Locations of the label, bitmap, offsets, and values of a column
+ *      block in the input.
+ */
+typedef struct {
+    ColumnarBlock block;
+    BLT_TABLE_COLUMN_TYPE type;
+    const char *label;
+    const unsigned char *bitmap;
+    const int64_t *offsets;
+    const unsigned char *values;
+} ColumnarBuffers;
+
+static int
+FormatError(Tcl_Interp *interp, const char *mesg)
+{
+    Tcl_AppendResult(interp, "bad columnar data: ", mesg, (char *)NULL);
+    return TCL_ERROR;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ParseColumn --
+ *
+ *      Checks the column block at the given offset in the input and
+ *      records where its buffers are.  All sizes and offsets are
+ *      verified against the length of the input, so the buffers can be
+ *      loaded without further checks.
+ *
+ * Results:
+ *      A standard TCL result.  The offset is advanced to the next block.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ParseColumn(Tcl_Interp *interp, const unsigned char *bytes, size_t numBytes,
+            size_t *offsetPtr, size_t numRows, ColumnarBuffers *bufPtr)
+{
+    size_t offset, size;
+
+    offset = *offsetPtr;
+    if ((numBytes - offset) < sizeof(ColumnarBlock)) {
+        return FormatError(interp, "truncated column block");
+    }
+    memcpy(&bufPtr->block, bytes + offset, sizeof(ColumnarBlock));
+    offset += sizeof(ColumnarBlock);
+    if (!CodeToColumnType(bufPtr->block.type, bufPtr->block.width, 
+                          &bufPtr->type)) {
+        return FormatError(interp, "unknown column type");
+    }
+    if ((bufPtr->block.flags & COLUMNAR_ROW_LABELS) &&
+        ((bufPtr->block.width != 0) || 
+         (bufPtr->type != TABLE_COLUMN_TYPE_STRING))) {
+        return FormatError(interp, "bad row label block");
+    }
+    if ((bufPtr->block.labelLength < 0) || (bufPtr->block.dataLength < 0)) {
+        return FormatError(interp, "bad column block");
+    }
+    size = PAD8((size_t)bufPtr->block.labelLength);
+    if ((numBytes - offset) < size) {
+        return FormatError(interp, "truncated column label");
+    }
+    bufPtr->label = (const char *)bytes + offset;
+    offset += size;
+    size = BITMAP_SIZE(numRows);
+    if ((numBytes - offset) < size) {
+        return FormatError(interp, "truncated bitmap");
+    }
+    bufPtr->bitmap = bytes + offset;
+    offset += size;
+    bufPtr->offsets = NULL;
+    if (bufPtr->block.width == 0) {
+        size_t i;
+
+        size = PAD8((numRows + 1) * sizeof(int64_t));
+        if ((numBytes - offset) < size) {
+            return FormatError(interp, "truncated offsets");
+        }
+        bufPtr->offsets = (const int64_t *)(bytes + offset);
+        offset += size;
+        if (bufPtr->offsets[0] != 0) {
+            return FormatError(interp, "bad offsets");
+        }
+        for (i = 0; i < numRows; i++) {
+            if (bufPtr->offsets[i + 1] < bufPtr->offsets[i]) {
+                return FormatError(interp, "bad offsets");
+            }
+        }
+        if (bufPtr->offsets[numRows] != bufPtr->block.dataLength) {
+            return FormatError(interp, "bad offsets");
+        }
+    } else if ((uint64_t)bufPtr->block.dataLength != 
+               (numRows * bufPtr->block.width)) {
+        return FormatError(interp, "bad column length");
+    }
+    size = PAD8((size_t)bufPtr->block.dataLength);
+    if ((numBytes - offset) < size) {
+        return FormatError(interp, "truncated values");
+    }
+    bufPtr->values = bytes + offset;
+    offset += size;
+    *offsetPtr = offset;
+    return TCL_OK;
+}
+
+static int
+SetRowLabels(Tcl_Interp *interp, BLT_TABLE table, size_t numRows, 
+             BLT_TABLE_ROW *rows, ColumnarBuffers *bufPtr)
+{
+    Tcl_DString ds;
+    size_t i;
+    int result;
+
+    result = TCL_OK;
+    Tcl_DStringInit(&ds);
+    for (i = 0; i < numRows; i++) {
+        if ((bufPtr->bitmap[i >> 3] & (1 << (i & 7))) == 0) {
+            continue;
+        }
+        Tcl_DStringSetLength(&ds, 0);
+        Tcl_DStringAppend(&ds, (const char *)bufPtr->values + 
+                bufPtr->offsets[i], 
+                (int)(bufPtr->offsets[i + 1] - bufPtr->offsets[i]));
+        result = blt_table_set_row_label(interp, table, rows[i], 
+                Tcl_DStringValue(&ds));
+        if (result != TCL_OK) {
+            break;
+        }
+    }
+    Tcl_DStringFree(&ds);
+    return result;
+}
+
+static int
+ImportColumns(Tcl_Interp *interp, BLT_TABLE table, const unsigned char *bytes,
+              size_t numBytes)
+{
+    ColumnarHeader header;
+    ColumnarBuffers *buffers;
+    BLT_TABLE_ROW *rows;
+    Tcl_DString ds;
+    size_t numRows, numColumns, offset, i, count, numLabelBlocks;
+    int result;
+
+    if (numBytes < sizeof(ColumnarHeader)) {
+        return FormatError(interp, "missing header");
+    }
+    memcpy(&header, bytes, sizeof(header));
+    if (memcmp(header.magic, COLUMNAR_MAGIC, 8) != 0) {
+        return FormatError(interp, "wrong magic number");
+    }
+    if (header.byteOrder != COLUMNAR_BYTE_ORDER) {
+        return FormatError(interp, "written with a different byte order");
+    }
+    if ((header.numRows < 0) || (header.numColumns < 0) ||
+        ((uint64_t)header.numColumns > (numBytes / sizeof(ColumnarBlock))) ||
+        ((uint64_t)header.numRows > ((uint64_t)numBytes * 8))) {
+        return FormatError(interp, "bad header");
+    }
+    numRows = header.numRows;
+    numColumns = header.numColumns;
+
+    /* Check all the blocks before changing the table. */
+    buffers = Blt_AssertMalloc((numColumns + 1) * sizeof(ColumnarBuffers));
+    offset = sizeof(ColumnarHeader);
+    numLabelBlocks = 0;
+    for (i = 0; i < numColumns; i++) {
+        if (ParseColumn(interp, bytes, numBytes, &offset, numRows, 
+                        buffers + i) != TCL_OK) {
+            Blt_Free(buffers);
+            return TCL_ERROR;
+        }
+        if (buffers[i].block.flags & COLUMNAR_ROW_LABELS) {
+            numLabelBlocks++;
+        }
+    }
+    if (numLabelBlocks > 1) {
+        Blt_Free(buffers);
+        return FormatError(interp, "more than one row label block");
+    }
+    result = TCL_ERROR;
+    Tcl_DStringInit(&ds);
+    rows = Blt_AssertMalloc((numRows + 1) * sizeof(BLT_TABLE_ROW));
+
+    /* Reuse the table's rows from the start, adding rows as needed. */
+    count = MIN(numRows, (size_t)blt_table_num_rows(table));
+    for (i = 0; i < count; i++) {
+        rows[i] = blt_table_row(table, i);
+    }
+    if ((numRows > count) &&
+        (blt_table_extend_rows(interp, table, numRows - count, rows + count)
+         != TCL_OK)) {
+        goto error;
+    }
+    for (i = 0; i < numColumns; i++) {
+        ColumnarBuffers *bufPtr;
+        BLT_TABLE_COLUMN col;
+
+        bufPtr = buffers + i;
+        if (bufPtr->block.flags & COLUMNAR_ROW_LABELS) {
+            if (SetRowLabels(interp, table, numRows, rows, bufPtr) != TCL_OK) {
+                goto error;
+            }
+            continue;
+        }
+        if (blt_table_extend_columns(interp, table, 1, &col) != TCL_OK) {
+            goto error;
+        }
+        if (bufPtr->block.labelLength > 0) {
+            Tcl_DStringSetLength(&ds, 0);
+            Tcl_DStringAppend(&ds, bufPtr->label, bufPtr->block.labelLength);
+            if (blt_table_set_column_label(interp, table, col, 
+                        Tcl_DStringValue(&ds)) != TCL_OK) {
+                goto error;
+            }
+        }
+        if ((blt_table_set_column_type(interp, table, col, bufPtr->type) 
+             != TCL_OK) ||
+            (blt_table_load_column(interp, table, col, numRows, rows,
+                bufPtr->bitmap, bufPtr->values, bufPtr->block.width, 
+                bufPtr->offsets) != TCL_OK)) {
+            goto error;
+        }
+    }
+    result = TCL_OK;
+ error:
+    Tcl_DStringFree(&ds);
+    Blt_Free(rows);
+    Blt_Free(buffers);
+    return result;
+}
+
+/* 
+ * $table import columnar -file fileName
+ * $table import columnar -data bytes
+ */
+static int
+ImportProc(BLT_TABLE table, Tcl_Interp *interp, int objc, Tcl_Obj *const *objv)
+{
+    ImportSwitches switches;
+    Tcl_Obj *objPtr;
+    const unsigned char *bytes;
+    int numBytes, result;
+
+    memset(&switches, 0, sizeof(switches));
+    if (Blt_ParseSwitches(interp, importSwitches, objc - 3 , objv + 3, 
+        &switches, BLT_SWITCH_DEFAULTS) < 0) {
+        return TCL_ERROR;
+    }
+    result = TCL_ERROR;
+    objPtr = NULL;
+    if ((switches.dataObjPtr != NULL) && (switches.fileObjPtr != NULL)) {
+        Tcl_AppendResult(interp, "can't set both -file and -data switches.",
+                         (char *)NULL);
+        goto error;
+    }
+    if (switches.dataObjPtr != NULL) {
+        objPtr = switches.dataObjPtr;
+        Tcl_IncrRefCount(objPtr);
+    } else {
+        int closeChannel;
+        Tcl_Channel channel;
+        const char *fileName;
+
+        if (switches.fileObjPtr == NULL) {
+            Tcl_AppendResult(interp, "either -file or -data switch is required",
+                (char *)NULL);
+            goto error;
+        }
+        closeChannel = TRUE;
+        fileName = Tcl_GetString(switches.fileObjPtr);
+        if ((fileName[0] == '@') && (fileName[1] != '\0')) {
+            int mode;
+            
+            channel = Tcl_GetChannel(interp, fileName+1, &mode);
+            if (channel == NULL) {
+                goto error;
+            }
+            if ((mode & TCL_READABLE) == 0) {
+                Tcl_AppendResult(interp, "channel \"", fileName, 
+                                 "\" not opened for reading", (char *)NULL);
+                goto error;
+            }
+            closeChannel = FALSE;
+        } else {
+            channel = Tcl_OpenFileChannel(interp, fileName, "r", 0);
+            if (channel == NULL) {
+                goto error;
+            }
+        }
+        objPtr = Tcl_NewObj();
+        Tcl_IncrRefCount(objPtr);
+        if ((Tcl_SetChannelOption(interp, channel, "-translation", "binary")
+             != TCL_OK) || 
+            (Tcl_ReadChars(channel, objPtr, -1, 0) < 0)) {
+            if (Tcl_GetStringResult(interp)[0] == '\0') {
+                Tcl_AppendResult(interp, "error reading \"", fileName, "\": ",
+                        Tcl_PosixError(interp), (char *)NULL);
+            }
+            if (closeChannel) {
+                Tcl_Close(interp, channel);
+            }
+            goto error;
+        }
+        if (closeChannel) {
+            Tcl_Close(interp, channel);
+        }
+    }
+    bytes = Tcl_GetByteArrayFromObj(objPtr, &numBytes);
+    result = ImportColumns(interp, table, bytes, numBytes);
+ error:
+    if (objPtr != NULL) {
+        Tcl_DecrRefCount(objPtr);
+    }
+    Blt_FreeSwitches(importSwitches, (char *)&switches, 0);
+    return result;
+}
+    
+int 
+blt_table_columnar_init(Tcl_Interp *interp)
+{
+#ifdef USE_TCL_STUBS
+    if (Tcl_InitStubs(interp, TCL_VERSION_COMPILED, PKG_ANY) == NULL) {
+        return TCL_ERROR;
+    };
+#endif
+#ifdef USE_BLT_STUBS
+    if (Blt_InitTclStubs(interp, BLT_VERSION, PKG_EXACT) == NULL) {
+        return TCL_ERROR;
+    };
+#endif    
+    if (Tcl_PkgRequire(interp, "blt_tcl", BLT_VERSION, PKG_EXACT) == NULL) {
+        return TCL_ERROR;
+    }
+    if (Tcl_PkgProvide(interp, "blt_datatable_columnar", BLT_VERSION) 
+        != TCL_OK) { 
+        return TCL_ERROR;
+    }
+    return blt_table_register_format(interp,
+        "columnar",             /* Name of format. */
+        ImportProc,             /* Import procedure. */
+        ExportProc);            /* Export procedure. */
+}
+
+int 
+blt_table_columnar_safe_init(Tcl_Interp *interp)
+{
+    return blt_table_columnar_init(interp);
+}
+
+#endif /* NO_DATATABLE */
@@ -62,6 +62,9 @@ DLLEXPORT extern Tcl_AppInitProc blt_table_csv_safe_init;
 #define EXPORT_ROWLABELS        (1<<0)
 #define EXPORT_COLUMNLABELS     (1<<1)
 
+#define IMPORT_GUESSED          (1<<0)  /* Column types were guessed in a
+                                         * first pass over the input. */
+
 /*
  * Format       Import          Export
  * csv          file/data       file/data
@@ -117,8 +120,107 @@ typedef struct {
                                          * rows have been found. */
     const char **columnLabels;
     int nextLabel;
+    int numThreads;                     /* # of threads to parse the data
+                                         * with. */
+    Tcl_DString block;                  /* Holds the block of lines read
+                                         * from the channel. */
+    size_t blockUsed;                   /* # of bytes in the block already
+                                         * handed out. */
+    long numRowsLoaded;                 /* # of rows imported so far. */
+    BLT_TABLE_ROW row;                  /* Row currently being loaded. */
+    long nextColumn;                    /* Index of the column of the next
+                                         * field in the row. */
+    long sampleSize;                    /* If non-zero, infer the types of
+                                         * new columns from this many
+                                         * values.  INFER_ALL means from
+                                         * all the values. */
+    BLT_TABLE_TYPE_GUESS *guesses;      /* Type guesses for the columns,
+                                         * by column index. */
+    long numGuesses;                    /* # of guesses allocated. */
+    long firstNewColumn;                /* Index of the first column
+                                         * created by the import. */
 } ImportArgs;
 
+#define INFER_ALL               (-1)
+
+#define CSV_BLOCK_SIZE          (1<<20) /* # of characters read at a
+                                         * time. */
+#define CSV_MAX_THREADS         16
+
+/* Field flags. */
+#define FIELD_FIRST             (1<<0)  /* Field starts a new row. */
+#define FIELD_VALUE             (1<<1)  /* Field is set, possibly to the
+                                         * empty string. */
+
+/*
+ * CsvSyntax --
+ *
+ *      Characters that have meaning to the CSV parser.
+ */
+typedef struct {
+    char separatorChar;
+    char quoteChar;
+    char commentChar;
+    unsigned char special[256];         /* Indicates if the parser needs
+                                         * to look at the character. */
+} CsvSyntax;
+
+/*
+ * CsvState --
+ *
+ *      State of the parser between lines.  
+ */
+typedef struct {
+    int inQuotes;                       /* Inside a quoted field. */
+    int isQuoted;                       /* Current field was quoted. */
+    int isPath;                         /* Current field is an unquoted
+                                         * path. */
+    int inRow;                          /* A row has been started. */
+} CsvState;
+
+typedef struct {
+    size_t offset;                      /* Offset of the field in the
+                                         * record bytes. */
+    unsigned int length;                /* # of bytes in the field. */
+    unsigned int flags;
+} CsvField;
+
+/*
+ * CsvRecords --
+ *
+ *      Fields parsed from a block of lines, waiting to be loaded into the
+ *      table.  The field values are stored back-to-back in a single
+ *      array of bytes.
+ */
+typedef struct {
+    char *bytes;                        /* Field values. */
+    size_t numBytes;                    /* # of bytes used. */
+    size_t numAllocated;                /* # of bytes allocated. */
+    size_t mark;                        /* Start of the field currently
+                                         * being parsed. */
+    CsvField *fields;
+    size_t numFields;
+    size_t numFieldsAllocated;
+    long numRows;                       /* # of rows started. */
+} CsvRecords;
+
+/*
+ * CsvWorker --
+ *
+ *      Chunk of lines parsed in a separate thread.
+ */
+typedef struct {
+    CsvSyntax *synPtr;
+    CsvState state;
+    CsvRecords *recPtr;
+    const char *first, *last;           /* Lines to parse. */
+} CsvWorker;
+
+static Blt_SwitchParseProc InferTypesSwitchProc;
+static Blt_SwitchCustom inferTypesSwitch = {
+    InferTypesSwitchProc, NULL, NULL, 0,
+};
+
 static Blt_SwitchSpec importSwitches[] = 
 {
     {BLT_SWITCH_LIST,   "-columnlabels",  "labelList", (char *)NULL,
@@ -133,6 +235,8 @@ static Blt_SwitchSpec importSwitches[] =
         Blt_Offset(ImportArgs, encodingObjPtr), 0, 0, NULL},
     {BLT_SWITCH_OBJ,    "-file",      "fileName", (char *)NULL,
         Blt_Offset(ImportArgs, fileObjPtr), 0},
+    {BLT_SWITCH_CUSTOM, "-infertypes", "numRows|all", (char *)NULL,
+        Blt_Offset(ImportArgs, sampleSize), 0, 0, &inferTypesSwitch},
     {BLT_SWITCH_INT_NNEG, "-maxrows", "numRows", (char *)NULL,
         Blt_Offset(ImportArgs, maxRows), 0},
     {BLT_SWITCH_STRING, "-possibleseparators", "string", (char *)NULL,
@@ -141,6 +245,8 @@ static Blt_SwitchSpec importSwitches[] =
         Blt_Offset(ImportArgs, reqQuote), 0},
     {BLT_SWITCH_STRING, "-separator", "char", (char *)NULL,
         Blt_Offset(ImportArgs, reqSeparator), 0},
+    {BLT_SWITCH_INT_NNEG, "-threads", "numThreads", (char *)NULL,
+        Blt_Offset(ImportArgs, numThreads), 0},
     {BLT_SWITCH_END}
 };
 
@@ -321,6 +427,43 @@ RowIterSwitchProc(
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * InferTypesSwitchProc --
+ *
+ *      Converts the number of values to sample when inferring column
+ *      types.  "all" means to examine all the values.
+ *
+ * Results:
+ *      The return value is a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+InferTypesSwitchProc(ClientData clientData, Tcl_Interp *interp,
+                     const char *switchName, Tcl_Obj *objPtr, char *record,
+                     int offset, int flags)
+{
+    long *sampleSizePtr = (long *)(record + offset);
+    const char *string;
+    long count;
+
+    string = Tcl_GetString(objPtr);
+    if (strcmp(string, "all") == 0) {
+        *sampleSizePtr = INFER_ALL;
+        return TCL_OK;
+    }
+    if (Blt_GetCountFromObj(NULL, objPtr, COUNT_NNEG, &count) != TCL_OK) {
+        Tcl_AppendResult(interp, "bad value \"", string, 
+                "\": should be a number of values or \"all\"", (char *)NULL);
+        return TCL_ERROR;
+    }
+    *sampleSizePtr = count;
+    return TCL_OK;
+}
+
 static void
 StartCsvRecord(ExportArgs *exportPtr)
 {
@@ -711,224 +854,864 @@ GetNextLabel(ImportArgs *importPtr)
     return label;
 }
 
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ImportGetBlock --
+ *
+ *      Gets the next block of complete lines from the input buffer or
+ *      file.  Blocks are about blockSize bytes long, but always end on a
+ *      newline, so a block may be longer if it ends in a long line.  If
+ *      the last line of input is missing its newline, one is added.  The
+ *      block is valid until the next call.
+ *
+ * Results:
+ *      Returns a standard TCL result.  The number of bytes in the block
+ *      is 0 at the end of the input.
+ *
+ *---------------------------------------------------------------------------
+ */
 static int
-ImportCsv(Tcl_Interp *interp, BLT_TABLE table, ImportArgs *importPtr)
+ImportGetBlock(Tcl_Interp *interp, ImportArgs *importPtr, size_t blockSize,
+               const char **bufferPtr, size_t *numBytesPtr)
 {
-    Tcl_DString ds;
-    char *fp, *field;
-    int fieldSize;
-    int inQuotes, isQuoted, isPath;
-    int result;
-    long i;
-    BLT_TABLE_ROW row;
-    BLT_TABLE_COLUMN col;
-
-    result = TCL_ERROR;
-    isPath = isQuoted = inQuotes = FALSE;
-    row = NULL;
-    i = 0;
-    Tcl_DStringInit(&ds);
-    fieldSize = 128;
-    Tcl_DStringSetLength(&ds, fieldSize + 1);
-    fp = field = Tcl_DStringValue(&ds);
-    for (;;) {
-        const char *bp, *bend;
-        size_t numBytes;
+    if (importPtr->channel != NULL) {
+        Tcl_DString *dsPtr;
+        char *bp, *bend;
+        int length, isEof;
+
+        dsPtr = &importPtr->block;
+        length = Tcl_DStringLength(dsPtr);
+        if (importPtr->blockUsed > 0) {
+            char *bytes;
+
+            /* Move the partial line left from the last block to the
+             * front. */
+            bytes = Tcl_DStringValue(dsPtr);
+            length -= importPtr->blockUsed;
+            memmove(bytes, bytes + importPtr->blockUsed, length);
+            Tcl_DStringSetLength(dsPtr, length);
+            importPtr->blockUsed = 0;
+        }
+        isEof = FALSE;
+        for (;;) {
+            Tcl_Obj *objPtr;
+            const char *bytes;
+            int numBytes, numChars;
+
+            objPtr = Tcl_NewObj();
+            Tcl_IncrRefCount(objPtr);
+            numChars = Tcl_ReadChars(importPtr->channel, objPtr, blockSize, 0);
+            if (numChars < 0) {
+                Tcl_DecrRefCount(objPtr);
+                Tcl_AppendResult(interp, "error reading file: ", 
+                                 Tcl_PosixError(interp), (char *)NULL);
+                return TCL_ERROR;
+            }
+            bytes = Tcl_GetStringFromObj(objPtr, &numBytes);
+            Tcl_DStringAppend(dsPtr, bytes, numBytes);
+            Tcl_DecrRefCount(objPtr);
+            if ((numChars == 0) || (Tcl_Eof(importPtr->channel))) {
+                isEof = TRUE;
+                break;
+            }
+            if (memchr(Tcl_DStringValue(dsPtr) + length, '\n', numBytes) 
+                != NULL) {
+                break;
+            }
+            length += numBytes;
+        }
+        length = Tcl_DStringLength(dsPtr);
+        if ((isEof) && (length > 0) && 
+            (Tcl_DStringValue(dsPtr)[length - 1] != '\n')) {
+            Tcl_DStringAppend(dsPtr, "\n", 1);
+            length++;
+        }
+        /* Hand out everything up to the last newline. */
+        bp = Tcl_DStringValue(dsPtr);
+        for (bend = bp + length; bend > bp; bend--) {
+            if (*(bend - 1) == '\n') {
+                break;
+            }
+        }
+        importPtr->blockUsed = bend - bp;
+        *bufferPtr = bp;
+        *numBytesPtr = bend - bp;
+    } else {
+        const char *bp, *bend, *last;
 
-        result = ImportGetLine(interp, importPtr, &bp, &numBytes);
-        if (result != TCL_OK) {
-            goto error;                 /* I/O Error. */
+        bp = importPtr->next;
+        if (importPtr->bytesLeft == 0) {
+            *numBytesPtr = 0;
+            return TCL_OK;
         }
-        if (numBytes == 0) {
-            break;                      /* EOF */
+        bend = bp + importPtr->bytesLeft;
+        last = bp + MIN(blockSize, importPtr->bytesLeft) - 1;
+        last = memchr(last, '\n', bend - last);
+        if (last != NULL) {
+            *bufferPtr = bp;
+            *numBytesPtr = last + 1 - bp;
+        } else {
+            /* Find the start of the last line. */
+            for (last = bend; last > bp; last--) {
+                if (*(last - 1) == '\n') {
+                    break;
+                }
+            }
+            if (last > bp) {
+                /* Return the complete lines first. */
+                *bufferPtr = bp;
+                *numBytesPtr = last - bp;
+            } else {
+                /* The last newline has been trimmed.  Don't change the
+                 * data object's string representation. Copy the line and
+                 * append the newline. */
+                Tcl_DStringSetLength(&importPtr->currLine, 0);
+                Tcl_DStringAppend(&importPtr->currLine, bp, bend - bp);
+                Tcl_DStringAppend(&importPtr->currLine, "\n", 1);
+                *bufferPtr = Tcl_DStringValue(&importPtr->currLine);
+                *numBytesPtr = Tcl_DStringLength(&importPtr->currLine);
+                importPtr->next = bend;
+                importPtr->bytesLeft = 0;
+                return TCL_OK;
+            }
+        }
+        importPtr->next += *numBytesPtr;
+        importPtr->bytesLeft -= *numBytesPtr;
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * InitCsvSyntax --
+ *
+ *      Marks the characters the parser must look at.  All other
+ *      characters are copied into the field in runs.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+InitCsvSyntax(ImportArgs *importPtr, CsvSyntax *synPtr)
+{
+    memset(synPtr, 0, sizeof(CsvSyntax));
+    synPtr->separatorChar = importPtr->separatorChar;
+    synPtr->quoteChar = importPtr->quoteChar;
+    synPtr->commentChar = importPtr->commentChar;
+    synPtr->special[UCHAR(synPtr->separatorChar)] = TRUE;
+    synPtr->special[UCHAR(synPtr->quoteChar)] = TRUE;
+    synPtr->special['\n'] = TRUE;
+    synPtr->special[' '] = TRUE;
+    synPtr->special['\t'] = TRUE;
+    synPtr->special['\\'] = TRUE;
+}
+
+static void
+InitCsvRecords(CsvRecords *recPtr)
+{
+    memset(recPtr, 0, sizeof(CsvRecords));
+}
+
+static void
+FreeCsvRecords(CsvRecords *recPtr)
+{
+    if (recPtr->bytes != NULL) {
+        Blt_Free(recPtr->bytes);
+    }
+    if (recPtr->fields != NULL) {
+        Blt_Free(recPtr->fields);
+    }
+    InitCsvRecords(recPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ResetCsvRecords --
+ *
+ *      Discards the fields after they have been loaded into the table.
+ *      The bytes of the field currently being parsed are kept.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+ResetCsvRecords(CsvRecords *recPtr)
+{
+    size_t numPending;
+
+    numPending = recPtr->numBytes - recPtr->mark;
+    if ((numPending > 0) && (recPtr->mark > 0)) {
+        memmove(recPtr->bytes, recPtr->bytes + recPtr->mark, numPending);
+    }
+    recPtr->numBytes = numPending;
+    recPtr->mark = 0;
+    recPtr->numFields = recPtr->numRows = 0;
+}
+
+static INLINE void
+AppendFieldBytes(CsvRecords *recPtr, const char *bytes, size_t numBytes)
+{
+    if ((recPtr->numBytes + numBytes) > recPtr->numAllocated) {
+        size_t newSize;
+
+        newSize = (recPtr->numAllocated == 0) ? 4096 : recPtr->numAllocated;
+        while (newSize < (recPtr->numBytes + numBytes)) {
+            newSize += newSize;
         }
-        bend = bp + numBytes;
-        while ((bp < bend) && (isspace(*bp)) && (!IsSeparator(importPtr, *bp))){
+        recPtr->bytes = Blt_AssertRealloc(recPtr->bytes, newSize);
+        recPtr->numAllocated = newSize;
+    }
+    memcpy(recPtr->bytes + recPtr->numBytes, bytes, numBytes);
+    recPtr->numBytes += numBytes;
+}
+
+static INLINE void
+AppendField(CsvRecords *recPtr, size_t last, unsigned int flags)
+{
+    CsvField *fieldPtr;
+
+    if (recPtr->numFields >= recPtr->numFieldsAllocated) {
+        size_t newSize;
+
+        newSize = (recPtr->numFieldsAllocated == 0) ? 1024 : 
+            recPtr->numFieldsAllocated * 2;
+        recPtr->fields = Blt_AssertRealloc(recPtr->fields, 
+                newSize * sizeof(CsvField));
+        recPtr->numFieldsAllocated = newSize;
+    }
+    fieldPtr = recPtr->fields + recPtr->numFields;
+    fieldPtr->offset = recPtr->mark;
+    fieldPtr->length = last - recPtr->mark;
+    fieldPtr->flags = flags;
+    recPtr->numFields++;
+    /* Drop any trailing spaces and start the next field. */
+    recPtr->numBytes = recPtr->mark = last;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ParseCsvLines --
+ *
+ *      Splits a block of complete lines into fields.  The fields are
+ *      appended to the records.  The parser state carries quoted fields
+ *      over from one block to the next.
+ *
+ *      This routine doesn't touch the table or the interpreter, so
+ *      separate blocks can be parsed in different threads.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+ParseCsvLines(CsvSyntax *synPtr, CsvState *statePtr, CsvRecords *recPtr,
+              const char *bp, const char *bend)
+{
+    const unsigned char *special;
+    const char *line, *lend;
+
+    special = synPtr->special;
+    for (line = bp; line < bend; line = lend) {
+        lend = memchr(line, '\n', bend - line);
+        lend = (lend == NULL) ? bend : lend + 1;
+        bp = line;
+        while ((bp < lend) && (isspace(UCHAR(*bp))) && 
+               (*bp != synPtr->separatorChar)) {
             bp++;                       /* Skip leading spaces. */
         }
-        if ((*bp == '\0') || (*bp == importPtr->commentChar)) {
+        if ((bp == lend) || (*bp == '\0') || (*bp == synPtr->commentChar)) {
             continue;                   /* Ignore blank or comment lines */
         }
-        for (/*empty*/; bp < bend; bp++) {
-            if ((IsSeparator(importPtr, *bp)) || (*bp == '\n')) {
-                if (inQuotes) {
-                    *fp++ = *bp;        /* Copy the separator or newline. */
-                } else {
-                    BLT_TABLE_COLUMN col;
-                    char *last;
-
-                    if ((isPath) && (IsSeparator(importPtr, *bp)) && 
-                        (fp != field) && (*(fp - 1) != '\\')) {
-                        *fp++ = *bp;    /* Copy the separator or newline. */
-                        goto currLine;
-                    }    
-                    /* "last" points to the character after the last character
-                     * in the field. */
-                    last = fp;  
-
-                    /* Remove trailing spaces only if the field wasn't
-                     * quoted. */
-                    if ((!isQuoted) && (!isPath)) {
-                        while ((last > field) && (isspace(*(last - 1)))) {
-                            last--;
-                        }
-                    }
-                    if (row == NULL) {
-                        if ((*bp == '\n') &&  (fp == field)) {
-                            goto currLine;  /* Ignore empty lines. */
-                        }
-                        if (blt_table_extend_rows(interp, table, 1, &row) 
-                            != TCL_OK) {
-                            goto error;
-                        }
-                        if ((importPtr->maxRows > 0) && 
-                            (blt_table_num_rows(table) > importPtr->maxRows)) {
-                            bp = bend;
-                            goto currLine;
-                        }
-                    }
-                    /* End of field. Append field to row. */
-                    if (i >= blt_table_num_columns(table)) {
-                        const char *label;
-                        
-                        if (blt_table_extend_columns(interp, table, 1, &col) 
-                            != TCL_OK) {
-                            goto error;
-                        }
-                        label = GetNextLabel(importPtr);
-                        if ((label != NULL) && 
-                            (blt_table_set_column_label(interp, table, col,
-                                                        label) != TCL_OK)) {
-                            goto error;
-                        }
-                    } else {
-                        col = blt_table_column(table, i);
-                    }
-                    if (((last > field) || (isQuoted)) && 
-                        (!IsEmpty(importPtr, field, last - field))) {
-                        if (blt_table_set_string_rep(interp, table, row, col,
-                                field, last - field) != TCL_OK) {             
-                            goto error;
-                        }
+        for (/*empty*/; bp < lend; bp++) {
+            char c;
+
+            c = *bp;
+            if (!special[UCHAR(c)]) {
+                const char *p;
+
+                /* Copy the run of ordinary characters at once. */
+                for (p = bp + 1; (p < lend) && (!special[UCHAR(*p)]); p++) {
+                    /*empty*/
+                }
+                AppendFieldBytes(recPtr, bp, p - bp);
+                bp = p - 1;
+            } else if ((c == synPtr->separatorChar) || (c == '\n')) {
+                size_t last;
+                unsigned int flags;
+
+                if ((statePtr->inQuotes) || 
+                    ((statePtr->isPath) && (c == synPtr->separatorChar) &&
+                     (recPtr->numBytes > recPtr->mark) && 
+                     (recPtr->bytes[recPtr->numBytes - 1] != '\\'))) {
+                    /* Copy the separator or newline. */
+                    AppendFieldBytes(recPtr, bp, 1); 
+                    continue;
+                }
+                /* "last" is the offset after the last character in the
+                 * field. Remove trailing spaces only if the field wasn't
+                 * quoted. */
+                last = recPtr->numBytes;
+                if ((!statePtr->isQuoted) && (!statePtr->isPath)) {
+                    while ((last > recPtr->mark) && 
+                           (isspace(UCHAR(recPtr->bytes[last - 1])))) {
+                        last--;
                     }
-                    i++;
-                    if (*bp == '\n') {
-                        row = NULL;
-                        i = 0;
+                }
+                flags = 0;
+                if (!statePtr->inRow) {
+                    if ((c == '\n') && (recPtr->numBytes == recPtr->mark)) {
+                        continue;       /* Ignore empty lines. */
                     }
-                    fp = field;
-                    isPath = isQuoted = FALSE;
+                    statePtr->inRow = TRUE;
+                    recPtr->numRows++;
+                    flags |= FIELD_FIRST;
                 }
-            currLine:
-                if ((importPtr->maxRows > 0) && 
-                    (blt_table_num_rows(table) > importPtr->maxRows)) {
-                    break;
+                if ((last > recPtr->mark) || (statePtr->isQuoted)) {
+                    flags |= FIELD_VALUE;
                 }
-                ;
-            } else if ((*bp == ' ') || (*bp == '\t')) {
+                AppendField(recPtr, last, flags);
+                if (c == '\n') {
+                    statePtr->inRow = FALSE;
+                }
+                statePtr->isPath = statePtr->isQuoted = FALSE;
+            } else if ((c == ' ') || (c == '\t')) {
                 /* 
-                 * Include whitespace in the field only if it's not leading or
-                 * we're inside of quotes or a path.
+                 * Include whitespace in the field only if it's not leading
+                 * or we're inside of quotes or a path.
                  */
-                if ((fp != field) || (inQuotes) || (isPath)) {
-                    *fp++ = *bp; 
+                if ((recPtr->numBytes > recPtr->mark) || 
+                    (statePtr->inQuotes) || (statePtr->isPath)) {
+                    AppendFieldBytes(recPtr, bp, 1);
                 }
-            } else if (*bp == '\\') {
+            } else if (c == '\\') {
                 /* 
                  * Handle special case CSV files that allow unquoted paths.
                  * Example:  ...,\this\path " should\have been\quoted\,...
                  */
-                if (fp == field) {
-                    isPath = TRUE; 
+                if (recPtr->numBytes == recPtr->mark) {
+                    statePtr->isPath = TRUE; 
                 }
-                *fp++ = *bp;
-            } else if (*bp == importPtr->quoteChar ) {
-                if (inQuotes) {
-                    if (*(bp+1) == importPtr->quoteChar) {
-                        *fp++ = importPtr->quoteChar;
+                AppendFieldBytes(recPtr, bp, 1);
+            } else if (c == synPtr->quoteChar) {
+                if (statePtr->inQuotes) {
+                    if (((bp + 1) < lend) && (*(bp + 1) == synPtr->quoteChar)) {
+                        AppendFieldBytes(recPtr, bp, 1);
                         bp++;
                     } else {
-                        inQuotes = FALSE;
+                        statePtr->inQuotes = FALSE;
                     }
+                } else if (recPtr->numBytes == recPtr->mark) {
+                    statePtr->isQuoted = statePtr->inQuotes = TRUE; 
                 } else {
                     /* 
                      * If the quote doesn't start a field, then treat all
                      * quotes in the field as ordinary characters.
                      */
-                    if (fp == field) {
-                        isQuoted = inQuotes = TRUE; 
-                    } else {
-                        *fp++ = *bp;
-                    }
+                    AppendFieldBytes(recPtr, bp, 1);
                 }
             } else {
-                *fp++ = *bp;    /* Copy the character. */
+                AppendFieldBytes(recPtr, bp, 1);
             }
-            if ((fp - field) >= fieldSize) {
-                int offset;
+        }
+    }
+}
 
-                /* 
-                 * We've exceeded the current maximum size of the field.
-                 * Double the size of the field, but make sure to reset the
-                 * pointers to the (possibly) new memory location.
-                 */
-                offset = fp - field;
-                fieldSize += fieldSize;
-                Tcl_DStringSetLength(&ds, fieldSize + 1);
-                field = Tcl_DStringValue(&ds);
-                fp = field + offset;
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetColumnGuess --
+ *
+ *      Returns the type guess for the column at the given index, growing
+ *      the array of guesses as needed.
+ *
+ *---------------------------------------------------------------------------
+ */
+static BLT_TABLE_TYPE_GUESS *
+GetColumnGuess(ImportArgs *importPtr, long index)
+{
+    if (index >= importPtr->numGuesses) {
+        long i, numGuesses;
+
+        numGuesses = MAX(index + 1, importPtr->numGuesses * 2);
+        importPtr->guesses = Blt_AssertRealloc(importPtr->guesses, 
+                numGuesses * sizeof(BLT_TABLE_TYPE_GUESS));
+        for (i = importPtr->numGuesses; i < numGuesses; i++) {
+            blt_table_init_type_guess(importPtr->guesses + i, NULL,
+                (importPtr->sampleSize == INFER_ALL) ? 0 : 
+                importPtr->sampleSize);
+        }
+        importPtr->numGuesses = numGuesses;
+    }
+    return importPtr->guesses + index;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * NewColumnGuess --
+ *
+ *      Starts guessing the type of a column created by the import.  If
+ *      the values were already examined in a first pass over the input,
+ *      the column's type is set now, so that values are converted as
+ *      they're loaded.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+NewColumnGuess(Tcl_Interp *interp, BLT_TABLE table, ImportArgs *importPtr, 
+               long index, BLT_TABLE_COLUMN col)
+{
+    BLT_TABLE_TYPE_GUESS *guessPtr;
+
+    guessPtr = GetColumnGuess(importPtr, index);
+    guessPtr->column = col;
+    if (importPtr->flags & IMPORT_GUESSED) {
+        return blt_table_set_guessed_type(interp, table, guessPtr);
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GuessCsvRecords --
+ *
+ *      Examines the parsed fields of columns that will be created by the
+ *      import, narrowing the guesses of their types.  Nothing is loaded
+ *      into the table.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+GuessCsvRecords(ImportArgs *importPtr, CsvRecords *recPtr)
+{
+    CsvField *fp, *fend;
+
+    for (fp = recPtr->fields, fend = fp + recPtr->numFields; fp < fend; fp++) {
+        const char *field;
+
+        if (fp->flags & FIELD_FIRST) {
+            if ((importPtr->maxRows > 0) && 
+                (importPtr->numRowsLoaded >= importPtr->maxRows)) {
+                break;
             }
+            importPtr->numRowsLoaded++;
+            importPtr->nextColumn = 0;
         }
-        if (numBytes < 1) {
-            /* 
-             * We're reached the end of input. But there may not have been a
-             * final newline to trigger the final append. So check if a last
-             * field is still needs appending the the last row.
-             */
-            if (fp != field) {
-                char *last;
-                const char *label;
-
-                last = fp;
-                /* Remove trailing spaces */
-                while (isspace(*(last - 1))) {
-                    last--;
-                }
-                if (row == NULL) {
-                    if (blt_table_extend_rows(interp, table, 1, &row) != TCL_OK){
-                        goto error;
-                    }
-                }
-                col = blt_table_get_column_by_index(table, i);
-                if (col == NULL) {
-                    if (blt_table_extend_columns(interp, table, 1, &col) 
-                        != TCL_OK) {
-                        goto error;
-                    }
-                }                       
-                label = GetNextLabel(importPtr);
-                if ((label != NULL) &&
-                    (blt_table_set_column_label(interp, table, col,
-                                                label) != TCL_OK)) {
-                    goto error;
-                }
-                if (((last > field) || (isQuoted)) && 
-                    (!IsEmpty(importPtr, field, last - field))) {
-                    if (blt_table_set_string(interp, table, row, col, field, 
-                        last - field) != TCL_OK) {
-                        goto error;
-                    }
-                }               
-            }    
-            break;
+        field = recPtr->bytes + fp->offset;
+        if ((importPtr->nextColumn >= importPtr->firstNewColumn) &&
+            (fp->flags & FIELD_VALUE) && 
+            (!IsEmpty(importPtr, field, fp->length))) {
+            blt_table_guess_value(GetColumnGuess(importPtr, 
+                importPtr->nextColumn), field, fp->length);
         }
+        importPtr->nextColumn++;
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * LoadCsvRecords --
+ *
+ *      Adds the parsed fields to the table.  The new rows are created all
+ *      at once.  A row may continue from the previous records, if a
+ *      quoted field spans the block boundary.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+LoadCsvRecords(Tcl_Interp *interp, BLT_TABLE table, ImportArgs *importPtr,
+               CsvRecords *recPtr)
+{
+    BLT_TABLE_ROW *rows;
+    CsvField *fp, *fend;
+    long numRows, i;
+    int result;
+
+    numRows = recPtr->numRows;
+    if ((importPtr->maxRows > 0) && 
+        ((importPtr->numRowsLoaded + numRows) > importPtr->maxRows)) {
+        numRows = importPtr->maxRows - importPtr->numRowsLoaded;
+    }
+    rows = NULL;
+    if (numRows > 0) {
+        rows = Blt_AssertMalloc(numRows * sizeof(BLT_TABLE_ROW));
+        if (blt_table_extend_rows(interp, table, numRows, rows) != TCL_OK) {
+            Blt_Free(rows);
+            return TCL_ERROR;
+        }
+    }
+    result = TCL_ERROR;
+    i = -1;
+    for (fp = recPtr->fields, fend = fp + recPtr->numFields; fp < fend; fp++) {
+        BLT_TABLE_COLUMN col;
+        const char *field;
+
+        if (fp->flags & FIELD_FIRST) {
+            i++;
+            if (i >= numRows) {
+                break;                  /* Reached the maximum # of rows. */
+            }
+            importPtr->row = rows[i];
+            importPtr->nextColumn = 0;
+        }
+        if (importPtr->row == NULL) {
+            continue;                   /* Row was past the maximum. */
+        }
+        /* End of field. Append field to row. */
+        if (importPtr->nextColumn >= blt_table_num_columns(table)) {
+            const char *label;
+
+            if (blt_table_extend_columns(interp, table, 1, &col) != TCL_OK) {
+                goto error;
+            }
+            label = GetNextLabel(importPtr);
+            if ((label != NULL) && 
+                (blt_table_set_column_label(interp, table, col, label) 
+                 != TCL_OK)) {
+                goto error;
+            }
+            if ((importPtr->sampleSize != 0) &&
+                (NewColumnGuess(interp, table, importPtr, 
+                        importPtr->nextColumn, col) != TCL_OK)) {
+                goto error;
+            }
+        } else {
+            col = blt_table_column(table, importPtr->nextColumn);
+        }
+        field = recPtr->bytes + fp->offset;
+        if ((fp->flags & FIELD_VALUE) && 
+            (!IsEmpty(importPtr, field, fp->length))) {
+            int result;
+
+            if ((importPtr->nextColumn < importPtr->numGuesses) &&
+                (importPtr->guesses[importPtr->nextColumn].column == col)) {
+                result = blt_table_set_guessed_value(interp, table, 
+                        importPtr->row, 
+                        importPtr->guesses + importPtr->nextColumn, 
+                        field, fp->length);
+            } else {
+                result = blt_table_set_string_rep(interp, table,
+                        importPtr->row, col, field, fp->length);
+            }
+            if (result != TCL_OK) {
+                goto error;
+            }
+        }
+        importPtr->nextColumn++;
+    }
+    importPtr->numRowsLoaded += numRows;
+    if (i >= numRows) {
+        importPtr->row = NULL;
     }
     result = TCL_OK;
  error:
-    Tcl_DStringFree(&ds);
+    if (rows != NULL) {
+        Blt_Free(rows);
+    }
+    return result;
+}
+
+static Tcl_ThreadCreateType
+CsvWorkerProc(ClientData clientData)
+{
+    CsvWorker *workerPtr = clientData;
+
+    ParseCsvLines(workerPtr->synPtr, &workerPtr->state, workerPtr->recPtr,
+                  workerPtr->first, workerPtr->last);
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ParseCsvChunks --
+ *
+ *      Parses a block of lines, split into chunks that are parsed in
+ *      separate threads.  Each chunk, except the first, is parsed as if
+ *      it starts a new row.  The chunks are then loaded in input order.
+ *      If a chunk really started inside a quoted field, it's parsed
+ *      again here from where the previous chunk left off.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ParseCsvChunks(Tcl_Interp *interp, BLT_TABLE table, ImportArgs *importPtr,
+               CsvSyntax *synPtr, CsvState *statePtr, CsvRecords *recPtr,
+               const char *bp, const char *bend)
+{
+    CsvWorker workers[CSV_MAX_THREADS];
+    CsvRecords records[CSV_MAX_THREADS];
+    Tcl_ThreadId ids[CSV_MAX_THREADS];
+    int created[CSV_MAX_THREADS];
+    const char *bounds[CSV_MAX_THREADS + 1];
+    int i, numChunks, result;
+    size_t chunkSize;
+
+    /* Split the block on line boundaries. */
+    chunkSize = (bend - bp) / importPtr->numThreads;
+    bounds[0] = bp;
+    numChunks = 0;
+    while ((numChunks < (importPtr->numThreads - 1)) && 
+           ((bend - bounds[numChunks]) > (ssize_t)chunkSize)) {
+        const char *p;
+
+        p = memchr(bounds[numChunks] + chunkSize, '\n',
+                   bend - (bounds[numChunks] + chunkSize));
+        if ((p == NULL) || ((p + 1) == bend)) {
+            break;
+        }
+        numChunks++;
+        bounds[numChunks] = p + 1;
+    }
+    numChunks++;
+    bounds[numChunks] = bend;
+    for (i = 0; i < numChunks; i++) {
+        CsvWorker *workerPtr;
+
+        workerPtr = workers + i;
+        workerPtr->synPtr = synPtr;
+        workerPtr->first = bounds[i];
+        workerPtr->last = bounds[i + 1];
+        if (i == 0) {
+            workerPtr->recPtr = recPtr;
+            workerPtr->state = *statePtr;
+        } else {
+            InitCsvRecords(records + i);
+            workerPtr->recPtr = records + i;
+            memset(&workerPtr->state, 0, sizeof(CsvState));
+        }
+        created[i] = (i > 0) && 
+            (Tcl_CreateThread(ids + i, CsvWorkerProc, workerPtr, 
+                TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) == TCL_OK);
+    }
+    ParseCsvLines(synPtr, &workers[0].state, recPtr, bounds[0], bounds[1]);
+    for (i = 1; i < numChunks; i++) {
+        if (created[i]) {
+            int dummy;
+
+            Tcl_JoinThread(ids[i], &dummy);
+        } else {
+            ParseCsvLines(synPtr, &workers[i].state, workers[i].recPtr,
+                          workers[i].first, workers[i].last);
+        }
+    }
+    result = LoadCsvRecords(interp, table, importPtr, recPtr);
+    ResetCsvRecords(recPtr);
+    *statePtr = workers[0].state;
+    for (i = 1; (i < numChunks) && (result == TCL_OK); i++) {
+        CsvWorker *workerPtr;
+
+        workerPtr = workers + i;
+        if ((statePtr->inQuotes) || (statePtr->isQuoted) || 
+            (statePtr->isPath) || (statePtr->inRow)) {
+            /* Guessed wrong. Parse the chunk again. */
+            ParseCsvLines(synPtr, statePtr, recPtr, workerPtr->first,
+                          workerPtr->last);
+            result = LoadCsvRecords(interp, table, importPtr, recPtr);
+            ResetCsvRecords(recPtr);
+        } else {
+            CsvRecords *chunkPtr;
+
+            chunkPtr = workerPtr->recPtr;
+            result = LoadCsvRecords(interp, table, importPtr, chunkPtr);
+            /* Carry over the field still being parsed. */
+            AppendFieldBytes(recPtr, chunkPtr->bytes + chunkPtr->mark,
+                             chunkPtr->numBytes - chunkPtr->mark);
+            *statePtr = workerPtr->state;
+        }
+    }
+    for (i = 1; i < numChunks; i++) {
+        FreeCsvRecords(records + i);
+    }
     return result;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GuessCsvInput --
+ *
+ *      Makes a first pass over the input, guessing the types of the
+ *      columns that will be created.  The input is then rewound.  If the
+ *      channel can't be rewound, nothing is done and the types are
+ *      instead set after all the values have been loaded.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+GuessCsvInput(Tcl_Interp *interp, ImportArgs *importPtr, CsvSyntax *synPtr,
+              CsvRecords *recPtr, size_t blockSize)
+{
+    CsvState state;
+    Tcl_WideInt pos;
+    int result;
+
+    pos = 0;
+    if (importPtr->channel != NULL) {
+        pos = Tcl_Tell(importPtr->channel);
+        if (pos < 0) {
+            return TCL_OK;              /* Can't rewind the channel. */
+        }
+    }
+    memset(&state, 0, sizeof(CsvState));
+    for (;;) {
+        const char *bp;
+        size_t numBytes;
+
+        result = ImportGetBlock(interp, importPtr, blockSize, &bp, &numBytes);
+        if ((result != TCL_OK) || (numBytes == 0)) {
+            break;                      /* I/O error or EOF. */
+        }
+        ParseCsvLines(synPtr, &state, recPtr, bp, bp + numBytes);
+        GuessCsvRecords(importPtr, recPtr);
+        ResetCsvRecords(recPtr);
+        if ((importPtr->maxRows > 0) && 
+            (importPtr->numRowsLoaded >= importPtr->maxRows)) {
+            break;
+        }
+    }
+    ResetCsvRecords(recPtr);
+    if (result != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (importPtr->channel != NULL) {
+        if (Tcl_Seek(importPtr->channel, pos, SEEK_SET) < 0) {
+            Tcl_AppendResult(interp, "can't rewind channel: ",
+                             Tcl_PosixError(interp), (char *)NULL);
+            return TCL_ERROR;
+        }
+        Tcl_DStringSetLength(&importPtr->block, 0);
+        importPtr->blockUsed = 0;
+    } else {
+        importPtr->next = importPtr->buffer;
+        importPtr->bytesLeft = importPtr->numBytes;
+    }
+    importPtr->numRowsLoaded = 0;
+    importPtr->nextColumn = 0;
+    importPtr->flags |= IMPORT_GUESSED;
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ImportCsv --
+ *
+ *      Reads the CSV data in large blocks of lines.  Each block is split
+ *      into fields and then the fields are loaded into the table, adding
+ *      all the rows of the block at once.  If more than one thread was
+ *      requested, the blocks are parsed in parallel.  If the types of the
+ *      new columns are inferred from all the values, the input is first
+ *      read once just to guess the types.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ImportCsv(Tcl_Interp *interp, BLT_TABLE table, ImportArgs *importPtr)
+{
+    CsvSyntax syntax;
+    CsvState state;
+    CsvRecords records;
+    size_t blockSize;
+    int result;
+
+    InitCsvSyntax(importPtr, &syntax);
+    InitCsvRecords(&records);
+    memset(&state, 0, sizeof(CsvState));
+    if (importPtr->numThreads > CSV_MAX_THREADS) {
+        importPtr->numThreads = CSV_MAX_THREADS;
+    }
+    blockSize = CSV_BLOCK_SIZE;
+    if (importPtr->numThreads > 1) {
+        blockSize *= importPtr->numThreads;
+    }
+    importPtr->firstNewColumn = blt_table_num_columns(table);
+    if ((importPtr->sampleSize == INFER_ALL) &&
+        (GuessCsvInput(interp, importPtr, &syntax, &records, blockSize) 
+         != TCL_OK)) {
+        FreeCsvRecords(&records);
+        return TCL_ERROR;
+    }
+    for (;;) {
+        const char *bp;
+        size_t numBytes;
+
+        result = ImportGetBlock(interp, importPtr, blockSize, &bp, &numBytes);
+        if (result != TCL_OK) {
+            break;                      /* I/O Error. */
+        }
+        if (numBytes == 0) {
+            break;                      /* EOF */
+        }
+        if (importPtr->numThreads > 1) {
+            result = ParseCsvChunks(interp, table, importPtr, &syntax, &state,
+                                    &records, bp, bp + numBytes);
+        } else {
+            ParseCsvLines(&syntax, &state, &records, bp, bp + numBytes);
+            result = LoadCsvRecords(interp, table, importPtr, &records);
+            ResetCsvRecords(&records);
+        }
+        if (result != TCL_OK) {
+            break;
+        }
+        if ((importPtr->maxRows > 0) && 
+            (importPtr->numRowsLoaded >= importPtr->maxRows)) {
+            break;
+        }
+    }
+    FreeCsvRecords(&records);
+    return result;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FinishGuesses --
+ *
+ *      Sets the types of the new columns not yet typed, and returns the
+ *      labels and types of the new columns as the interpreter result.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+FinishGuesses(Tcl_Interp *interp, BLT_TABLE table, ImportArgs *importPtr)
+{
+    Tcl_Obj *listObjPtr;
+    long i;
+
+    listObjPtr = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+    for (i = importPtr->firstNewColumn; i < importPtr->numGuesses; i++) {
+        if (blt_table_finish_type_guess(interp, table, importPtr->guesses + i,
+                listObjPtr) != TCL_OK) {
+            Tcl_DecrRefCount(listObjPtr);
+            return TCL_ERROR;
+        }
+    }
+    Tcl_SetObjResult(interp, listObjPtr);
+    return TCL_OK;
+}
+
 static int
 ImportCsvProc(BLT_TABLE table, Tcl_Interp *interp, int objc, 
               Tcl_Obj *const *objv)
@@ -1011,6 +1794,7 @@ ImportCsvProc(BLT_TABLE table, Tcl_Interp *interp, int objc,
         }
         args.channel = channel;
         Tcl_DStringInit(&args.currLine);
+        Tcl_DStringInit(&args.block);
         if ((args.reqSeparator == NULL) || (args.reqSeparator[0] == '\0')) {
             args.separatorChar = GuessSeparator(interp, MAX_LINES, &args);
         } else {
@@ -1018,11 +1802,18 @@ ImportCsvProc(BLT_TABLE table, Tcl_Interp *interp, int objc,
         }
         result = ImportCsv(interp, table, &args);
         Tcl_DStringFree(&args.currLine);
+        Tcl_DStringFree(&args.block);
         if (closeChannel) {
             Tcl_Close(interp, channel);
         }
     }
+    if ((result == TCL_OK) && (args.sampleSize != 0)) {
+        result = FinishGuesses(interp, table, &args);
+    }
  error:
+    if (args.guesses != NULL) {
+        Blt_Free(args.guesses);
+    }
     Blt_FreeSwitches(importSwitches, (char *)&args, 0);
     return result;
 }
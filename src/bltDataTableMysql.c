@@ -40,12 +40,21 @@
 #ifndef NO_DATATABLE
 
 #include "config.h"
+
+#ifdef HAVE_STDLIB_H
+  #include <stdlib.h>
+#endif /* HAVE_STDLIB_H */
+
 #ifdef HAVE_LIBMYSQL
 
 #ifdef HAVE_MEMORY_H
   #include <memory.h>
 #endif /* HAVE_MEMORY_H */
 
+#ifdef HAVE_ERRNO_H
+  #include <errno.h>
+#endif /* HAVE_ERRNO_H */
+
 #include <tcl.h>
 #include <bltDataTable.h>
 #include <bltAlloc.h>
@@ -164,6 +173,12 @@ static BLT_TABLE_EXPORT_PROC ExportMysqlProc;
 
 #define DEF_CLIENT_FLAGS (CLIENT_MULTI_STATEMENTS|CLIENT_MULTI_RESULTS)
 
+#define MYSQL_INSERT_BUFSIZE    (1<<20) /* # of bytes of a multi-row
+                                         * INSERT statement before it's
+                                         * sent to the server.  This
+                                         * must be less than the server's
+                                         * max_allowed_packet. */
+
 static BLT_TABLE_IMPORT_PROC ImportMysqlProc;
 
 
@@ -390,7 +405,9 @@ MysqlResults(Tcl_Interp *interp, MYSQL *cp, MYSQL_RES **resultsPtr,
 {
     MYSQL_RES *results;
 
-    results = mysql_store_result(cp);
+    /* Don't pull the whole result set into memory. Rows are fetched
+     * from the server as they are read. */
+    results = mysql_use_result(cp);
     if (results != NULL) {
         *numFieldsPtr = mysql_num_fields(results);
     } else if (mysql_field_count(cp) == 0) {
@@ -428,53 +445,169 @@ MysqlImportLabels(Tcl_Interp *interp, BLT_TABLE table, MYSQL_RES *myResults,
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * MysqlImportValue --
+ *
+ *      Sets a single cell from the text representation returned by the
+ *      server.  Integer and double values are converted here and stored
+ *      directly, skipping the generic string conversion.  Anything that
+ *      doesn't convert cleanly is handed to blt_table_set_string_rep.
+ *
+ * Results:
+ *      The return value is a standard TCL result.  
+ *
+ *---------------------------------------------------------------------------
+ */
 static int
-MysqlImportRows(Tcl_Interp *interp, BLT_TABLE table, MYSQL_RES *myResults, 
-                size_t numCols, BLT_TABLE_COLUMN *cols) 
+MysqlImportValue(Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_ROW row,
+                 BLT_TABLE_COLUMN col, const char *value, int length)
 {
-    size_t numRows;
-    size_t count;
-    BLT_TABLE_ROW row;
-    
-    numRows = mysql_num_rows(myResults);
-    /* First check that there are enough rows in the table to accomodate
-     * the new data. Add more if necessary. */
-    if (numRows  > blt_table_num_rows(table)) {
-        size_t needed;
-
-        needed = numRows - blt_table_num_rows(table);
-        if (blt_table_extend_rows(interp, table, needed, NULL) != TCL_OK) {
-            return TCL_ERROR;
+    char *end;
+
+    if (length > 0) {
+        switch (blt_table_column_type(col)) {
+        case TABLE_COLUMN_TYPE_LONG:
+            {
+                long l;
+
+                errno = 0;
+                l = strtol(value, &end, 10);
+                if ((errno == 0) && (end == (value + length))) {
+                    return blt_table_set_long(interp, table, row, col, l);
+                }
+            }
+            break;
+        case TABLE_COLUMN_TYPE_DOUBLE:
+            {
+                double d;
+
+                errno = 0;
+                d = strtod(value, &end);
+                if ((errno == 0) && (end == (value + length))) {
+                    return blt_table_set_double(interp, table, row, col, d);
+                }
+            }
+            break;
+        default:
+            break;
         }
     }
-    count = 0;
-    for (row = blt_table_first_row(table); /*empty*/; 
-         row = blt_table_next_row(row), count++) {
-        MYSQL_ROW myRow;
+    return blt_table_set_string_rep(interp, table, row, col, value, length);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * MysqlImportRows --
+ *
+ *      Streams the rows of the (unbuffered) result set into the table.
+ *      Rows are added to the table one at a time as they arrive; the
+ *      table's storage grows geometrically, so no rows are created that
+ *      aren't used.  Values overwrite existing data in the table starting
+ *      from the first row.
+ *
+ * Results:
+ *      The return value is a standard TCL result.  
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+MysqlImportRows(Tcl_Interp *interp, MYSQL *cp, BLT_TABLE table,
+                MYSQL_RES *myResults, size_t numCols, BLT_TABLE_COLUMN *cols) 
+{
+    BLT_TABLE_ROW row;
+    MYSQL_ROW myRow;
+    int result;
+    
+    row = NULL;
+    result = TCL_OK;
+    while ((myRow = mysql_fetch_row(myResults)) != NULL) {
         size_t j;
         unsigned long *lengths;
 
-        myRow = mysql_fetch_row(myResults);
-        if (myRow == NULL) {
-            if (count < numRows) {
-                Tcl_AppendResult(interp, "didn't complete fetching all rows",
-                                 (char *)NULL);
-                return TCL_ERROR;
+        row = (row == NULL) ? blt_table_first_row(table) :
+            blt_table_next_row(row);
+        if (row == NULL) {
+            /* Out of rows. Add another row to the table. */
+            result = blt_table_extend_rows(interp, table, 1, &row);
+            if (result != TCL_OK) {
+                break;
             }
-            break;
         }
         lengths = mysql_fetch_lengths(myResults);
         for (j = 0; j < numCols; j++) {
             if (myRow[j] == NULL) {
                 continue;               /* Empty value. */
             }
-            if (blt_table_set_string_rep(interp, table, row, cols[j], myRow[j],
-                        lengths[j]) != TCL_OK) {
-                return TCL_ERROR;
+            result = MysqlImportValue(interp, table, row, cols[j], myRow[j],
+                lengths[j]);
+            if (result != TCL_OK) {
+                break;
             }
         }
+        if (result != TCL_OK) {
+            break;
+        }
     }
-    return TCL_OK;
+    if ((result == TCL_OK) && (mysql_errno(cp) != 0)) {
+        Tcl_AppendResult(interp, "didn't complete fetching all rows: ",
+                         mysql_error(cp), (char *)NULL);
+        result = TCL_ERROR;
+    }
+    return result;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * MysqlAppendIdentifier --
+ *
+ *      Appends the identifier (column label) to the buffer, quoted with
+ *      backticks.  Embedded backticks are doubled.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+MysqlAppendIdentifier(Blt_DBuffer dbuffer, const char *name)
+{
+    const char *p;
+
+    Blt_DBuffer_AppendByte(dbuffer, '`');
+    for (p = name; *p != '\0'; p++) {
+        if (*p == '`') {
+            Blt_DBuffer_AppendByte(dbuffer, '`');
+        }
+        Blt_DBuffer_AppendByte(dbuffer, *p);
+    }
+    Blt_DBuffer_AppendByte(dbuffer, '`');
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * MysqlAppendValue --
+ *
+ *      Appends the value to the buffer as a quoted SQL string literal,
+ *      escaped by the client library for the connection's character set.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+MysqlAppendValue(Blt_DBuffer dbuffer, MYSQL *conn, const char *value,
+                 unsigned long length)
+{
+    size_t start;
+    char *bp;
+    unsigned long numBytes;
+
+    Blt_DBuffer_AppendByte(dbuffer, '\'');
+    start = Blt_DBuffer_Length(dbuffer);
+    bp = (char *)Blt_DBuffer_Extend(dbuffer, 2 * length + 1);
+    numBytes = mysql_real_escape_string(conn, bp, value, length);
+    Blt_DBuffer_SetLength(dbuffer, start + numBytes);
+    Blt_DBuffer_AppendByte(dbuffer, '\'');
 }
 
 static int
@@ -488,7 +621,7 @@ MysqlCreateTable(Tcl_Interp *interp, MYSQL *conn, BLT_TABLE table,
     int result;
     
     dbuffer = Blt_DBuffer_Create();
-    Blt_DBuffer_Format(dbuffer, "DROP TABLE IF EXISTS [%s];",
+    Blt_DBuffer_Format(dbuffer, "DROP TABLE IF EXISTS %s;",
                        argsPtr->tableName);
     query = (const char *)Blt_DBuffer_String(dbuffer);
     result =  mysql_query(conn, query);
@@ -501,10 +634,11 @@ MysqlCreateTable(Tcl_Interp *interp, MYSQL *conn, BLT_TABLE table,
     Blt_DBuffer_SetLength(dbuffer, 0);
     Blt_DBuffer_Format(dbuffer, "CREATE TABLE %s (",
                        argsPtr->tableName);
+    first = TRUE;
     if (argsPtr->flags & EXPORT_ROWLABELS) {
-        Blt_DBuffer_Format(dbuffer, "_rowId TEXT, ");
+        Blt_DBuffer_Format(dbuffer, "_rowId TEXT");
+        first = FALSE;
     }        
-    first = TRUE;
     for (col = blt_table_first_tagged_column(&argsPtr->ci); col != NULL; 
          col = blt_table_next_tagged_column(&argsPtr->ci)) {
         int type;
@@ -515,7 +649,8 @@ MysqlCreateTable(Tcl_Interp *interp, MYSQL *conn, BLT_TABLE table,
         if (!first) {
             Blt_DBuffer_Format(dbuffer, ", ");
         }
-        Blt_DBuffer_Format(dbuffer, "[%s] ", label);
+        MysqlAppendIdentifier(dbuffer, label);
+        Blt_DBuffer_AppendByte(dbuffer, ' ');
         switch(type) {
         case TABLE_COLUMN_TYPE_BOOLEAN:
             Blt_DBuffer_Format(dbuffer, "TINYINT(1)");  break;
@@ -543,123 +678,107 @@ MysqlCreateTable(Tcl_Interp *interp, MYSQL *conn, BLT_TABLE table,
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * MysqlExportValues --
+ *
+ *      Writes the selected rows and columns into the mysql table using
+ *      multi-row INSERT statements.  Rows are accumulated into a single
+ *      statement until it reaches MYSQL_INSERT_BUFSIZE bytes, so there is
+ *      one round trip to the server per block of rows rather than per
+ *      row.  Empty cells are written as NULL.
+ *
+ * Results:
+ *      The return value is a standard TCL result.  
+ *
+ *---------------------------------------------------------------------------
+ */
 static int
 MysqlExportValues(Tcl_Interp *interp, MYSQL *conn, BLT_TABLE table,
                   ExportArgs *argsPtr)
 {
     BLT_TABLE_COLUMN col;
     BLT_TABLE_ROW row;
-    Blt_DBuffer dbuffer, dbuffer2;
-    MYSQL_BIND *bind;
-    MYSQL_STMT *stmt;
-    const char *query;
-    int count, numParams;
-    int length, result;
+    Blt_DBuffer dbuffer;
+    size_t headerLength;
+    long numPending;
+    int first;
     
-    stmt = mysql_stmt_init(conn);
-    if (stmt == NULL) {
-        Tcl_AppendResult(interp, "can't create statement \": ",
-                         mysql_error(conn), (char *)NULL);
-        return TCL_ERROR;
-
-    }
+    /* Build the "INSERT INTO table (columns) VALUES " prefix. */
     dbuffer = Blt_DBuffer_Create();
-    dbuffer2 = Blt_DBuffer_Create();
     Blt_DBuffer_Format(dbuffer, "INSERT INTO %s (", argsPtr->tableName);
-    Blt_DBuffer_Format(dbuffer2, "(");
-    count = 0;
+    first = TRUE;
     if (argsPtr->flags & EXPORT_ROWLABELS) {
-        Blt_DBuffer_Format(dbuffer, "_rowId TEXT ");
-        Blt_DBuffer_Format(dbuffer2, "?");
-        count++;
+        Blt_DBuffer_Format(dbuffer, "_rowId");
+        first = FALSE;
     }        
     for (col = blt_table_first_tagged_column(&argsPtr->ci); col != NULL;
          col = blt_table_next_tagged_column(&argsPtr->ci)) {
-        const char *label;
-        
-        label = blt_table_column_label(col);
-        if (count > 0) {
+        if (!first) {
             Blt_DBuffer_Format(dbuffer, ", ");
-            Blt_DBuffer_Format(dbuffer2, ", ");
         }
-        Blt_DBuffer_Format(dbuffer, "[%s]", label);
-        Blt_DBuffer_Format(dbuffer2, "?");
-    }
-    Blt_DBuffer_Format(dbuffer2, ");");
-    Blt_DBuffer_Format(dbuffer, ") values ");
-    Blt_DBuffer_Concat(dbuffer, dbuffer2);
-    Blt_DBuffer_Destroy(dbuffer2);
-    query = Blt_DBuffer_String(dbuffer);
-    length = Blt_DBuffer_Length(dbuffer);
-    my_bool true = 1;
-    my_bool false = 1;
-    
-    bind = NULL;
-    result = mysql_stmt_prepare(stmt, query, length);
-    if (result != 0) {
-        Tcl_AppendResult(interp, "error in insert statment \"", query, "\": ", 
-                         mysql_error(conn), (char *)NULL);
-        Blt_DBuffer_Destroy(dbuffer);
-        goto error;
+        MysqlAppendIdentifier(dbuffer, blt_table_column_label(col));
+        first = FALSE;
     }
-    Blt_DBuffer_Destroy(dbuffer);
+    Blt_DBuffer_Format(dbuffer, ") VALUES ");
+    headerLength = Blt_DBuffer_Length(dbuffer);
 
-    numParams = mysql_stmt_param_count(stmt);
-    assert(numParams == count);
-    bind = Blt_AssertCalloc(count, sizeof(MYSQL_BIND));
+    numPending = 0;
     for (row = blt_table_first_tagged_row(&argsPtr->ri); row != NULL; 
          row = blt_table_next_tagged_row(&argsPtr->ri)) {
-        int count;                      
-        
-        count = 0;                      /* mysql parameter indices start
-                                         * from 0. */
+        if (numPending > 0) {
+            Blt_DBuffer_Format(dbuffer, ", ");
+        }
+        Blt_DBuffer_AppendByte(dbuffer, '(');
+        first = TRUE;
         if (argsPtr->flags & EXPORT_ROWLABELS) {
             const char *label;
                     
             label = blt_table_row_label(row);
-            bind[count].buffer_type = MYSQL_TYPE_STRING;
-            bind[count].buffer = (char *)label;
-            bind[count].buffer_length = strlen(label);
-            bind[count].is_null = &false;
-            count++;
+            MysqlAppendValue(dbuffer, conn, label, strlen(label));
+            first = FALSE;
         }
         for (col = blt_table_first_tagged_column(&argsPtr->ci); col != NULL;
              col = blt_table_next_tagged_column(&argsPtr->ci)) {
-            if (!blt_table_value_exists(table, row, col)) {
-                bind[count].buffer_type = MYSQL_TYPE_STRING;
-                bind[count].buffer = (char *)"";
-                bind[count].buffer_length = 0;
-                bind[count].is_null = &true;
+            BLT_TABLE_VALUE value;
+
+            if (!first) {
+                Blt_DBuffer_Format(dbuffer, ", ");
+            }
+            first = FALSE;
+            /* Let mysql do the conversions.  This is the safest way to
+             * push data out. */
+            value = blt_table_get_value(table, row, col);
+            if (value == NULL) {
+                Blt_DBuffer_Format(dbuffer, "NULL");
             } else {
-                BLT_TABLE_VALUE value;
-
-                /* Let mysql do the conversions.  This is the safest
-                 * way to push data out. */
-                value = blt_table_get_value(table, row, col);
-                bind[count].buffer_type = MYSQL_TYPE_STRING;
-                bind[count].buffer = (char *)blt_table_value_string(value);
-                bind[count].buffer_length = blt_table_value_length(value);
-                bind[count].is_null = &false;
+                MysqlAppendValue(dbuffer, conn, blt_table_value_string(value),
+                        blt_table_value_length(value));
             }
-            count++;
         }
-        result = mysql_stmt_bind_param(stmt, bind);
-        if (result != 0) {
-            Tcl_AppendResult(interp, "error in bind \": ", 
-                             mysql_error(conn), (char *)NULL);
-            goto error;
+        Blt_DBuffer_AppendByte(dbuffer, ')');
+        numPending++;
+        if (Blt_DBuffer_Length(dbuffer) >= MYSQL_INSERT_BUFSIZE) {
+            if (mysql_real_query(conn, (const char *)Blt_DBuffer_Bytes(dbuffer),
+                        Blt_DBuffer_Length(dbuffer)) != 0) {
+                goto error;
+            }
+            Blt_DBuffer_SetLength(dbuffer, headerLength);
+            numPending = 0;
         }
     }
-    mysql_stmt_close(stmt);
-    Blt_Free(bind);
+    if ((numPending > 0) &&
+        (mysql_real_query(conn, (const char *)Blt_DBuffer_Bytes(dbuffer),
+                          Blt_DBuffer_Length(dbuffer)) != 0)) {
+        goto error;
+    }
+    Blt_DBuffer_Destroy(dbuffer);
     return TCL_OK;
  error:
-    if (stmt != NULL) {
-        mysql_stmt_close(stmt);
-    }
-    if (bind != NULL) {
-        Blt_Free(bind);
-    }
+    Tcl_AppendResult(interp, "error inserting values into \"",
+        argsPtr->tableName, "\": ", mysql_error(conn), (char *)NULL);
+    Blt_DBuffer_Destroy(dbuffer);
     return TCL_ERROR;
 }
 
@@ -703,7 +822,8 @@ ImportMysqlProc(BLT_TABLE table, Tcl_Interp *interp, int objc,
             result = MysqlImportLabels(interp, table, myResults, numCols, cols);
         }
         if (result == TCL_OK) {
-            result = MysqlImportRows(interp, table, myResults, numCols, cols);
+            result = MysqlImportRows(interp, conn, table, myResults, numCols,
+                cols);
         }
         Blt_Free(cols);
     }
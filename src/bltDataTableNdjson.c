@@ -0,0 +1,1570 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * bltDataTableNdjson.c --
+ *
+ * Copyright 2015 George A. Howlett. All rights reserved.  
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are
+ *   met:
+ *
+ *   1) Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2) Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the
+ *      distribution.
+ *   3) Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *   4) Products derived from this software may not be called "BLT" nor may
+ *      "BLT" appear in their names without specific prior written
+ *      permission from the author.
+ *
+ *   THIS SOFTWARE IS PROVIDED ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ *   WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ *   BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ *   OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ *   IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * The "ndjson" format is newline-delimited JSON: each line of the input
+ * holds one JSON object, and each object is a row of the table.  The
+ * object's keys are the column labels.  Columns are added as new keys
+ * appear.
+ *
+ *      {"name": "a", "size": 10, "ok": true}
+ *      {"name": "b", "size": 12.5, "tags": ["x", "y"]}
+ *
+ * The input is read in large blocks of whole lines, and each line is
+ * tokenized in place.  Only strings with escape sequences are copied (to
+ * a reused scratch buffer).  Keys are mapped to columns through a hash
+ * table, but since most inputs list the keys in the same order on every
+ * line, the key found at each position of the previous object is checked
+ * first.
+ *
+ * Columns created by the import take their type from the values: true
+ * and false are "boolean", integers "long", other numbers "double", and
+ * strings "string".  A column is widened (to "double" or "string") if a
+ * later value doesn't fit.  Nested objects and arrays are stored as
+ * their JSON text.  Null values leave the cell empty.
+ */
+
+#include <bltInt.h>
+
+#ifndef NO_DATATABLE
+#include "config.h"
+#include <tcl.h>
+#include <bltSwitch.h>
+#include <bltDataTable.h>
+#include <bltAlloc.h>
+
+#ifdef HAVE_MEMORY_H
+  #include <memory.h>
+#endif /* HAVE_MEMORY_H */
+
+#ifdef HAVE_CTYPE_H
+  #include <ctype.h>
+#endif /* HAVE_CTYPE_H */
+
+#ifdef HAVE_STRING_H
+  #include <string.h>
+#endif /* HAVE_STRING_H */
+
+#ifdef HAVE_STDLIB_H
+  #include <stdlib.h>
+#endif /* HAVE_STDLIB_H */
+
+#ifdef HAVE_ERRNO_H
+  #include <errno.h>
+#endif /* HAVE_ERRNO_H */
+
+#include "bltMath.h"
+
+DLLEXPORT extern Tcl_AppInitProc blt_table_ndjson_init;
+DLLEXPORT extern Tcl_AppInitProc blt_table_ndjson_safe_init;
+
+#define TRUE    1
+#define FALSE   0
+
+#define EXPORT_NULLS            (1<<0)
+
+#define NDJSON_BLOCK_SIZE       (1<<20) /* # of bytes read or written at
+                                         * a time. */
+/* Most digits in an integer that's sure to fit in a long. */
+#define NDJSON_MAX_DIGITS       ((sizeof(long) > 4) ? 18 : 9)
+/* Most digits in a 64-bit integer. */
+#define NDJSON_INT64_DIGITS     19
+
+/* Types of JSON values. */
+typedef enum {
+    JSON_NULL, JSON_FALSE, JSON_TRUE, JSON_INTEGER, JSON_INT64,
+    JSON_NUMBER, JSON_STRING, JSON_NESTED
+} JsonValueType;
+
+/* Column type each kind of JSON value is imported as. */
+static BLT_TABLE_COLUMN_TYPE jsonColumnTypes[] = {
+    TABLE_COLUMN_TYPE_STRING,           /* null (never used) */
+    TABLE_COLUMN_TYPE_BOOLEAN,          /* false */
+    TABLE_COLUMN_TYPE_BOOLEAN,          /* true */
+    TABLE_COLUMN_TYPE_LONG,             /* integer */
+    TABLE_COLUMN_TYPE_INT64,            /* integer too big for a long */
+    TABLE_COLUMN_TYPE_DOUBLE,           /* number */
+    TABLE_COLUMN_TYPE_STRING,           /* string */
+    TABLE_COLUMN_TYPE_STRING,           /* object or array */
+};
+
+/*
+ * NdjsonKey --
+ *
+ *      Column associated with an object key.
+ */
+typedef struct {
+    BLT_TABLE_COLUMN col;
+    const char *key;                    /* Points to the hash table key. */
+    size_t length;                      /* # of bytes in the key. */
+    int inferType;                      /* If non-zero, the column was
+                                         * created by the import and its
+                                         * type follows the values. */
+    int isTyped;                        /* Indicates the column's type has
+                                         * been set from a value. */
+} NdjsonKey;
+
+/*
+ * ImportArgs --
+ */
+typedef struct {
+    Tcl_Obj *fileObjPtr;                /* Name of file representing the
+                                         * channel used as the input
+                                         * source. */
+    Tcl_Obj *dataObjPtr;                /* If non-NULL, data object to use
+                                         * as input source. */
+    Tcl_Obj *encodingObjPtr;            /* If non-NULL, encoding of the
+                                         * file.  By default "utf-8". */
+    int maxRows;                        /* Stop processing after this many
+                                         * rows have been found. */
+
+    /* Private data. */
+    Tcl_Channel channel;                /* If non-NULL, channel to read
+                                         * from. */
+    const char *next;                   /* Used for parsing data as a
+                                         * single string. */
+    size_t bytesLeft;                   /* Used for parsing data as a
+                                         * single string. */
+    Tcl_DString block;                  /* Holds the block of lines read
+                                         * from the channel. */
+    size_t blockUsed;                   /* # of bytes in the block already
+                                         * handed out. */
+    Tcl_DString currLine;               /* Holds the last line of the data
+                                         * string if it's missing a
+                                         * trailing newline. */
+    Tcl_DString keyScratch;             /* Holds unescaped keys. */
+    Tcl_DString valueScratch;           /* Holds unescaped string
+                                         * values. */
+    Blt_HashTable keyTable;             /* Maps keys to columns. */
+    NdjsonKey **lastKeys;               /* Keys of the previous object, in
+                                         * order. */
+    size_t numLastKeys;                 /* # of keys in the previous
+                                         * object. */
+    size_t lastKeysAllocated;
+    long lineNum;                       /* Current line in the input. */
+    long numRowsLoaded;                 /* # of rows imported so far. */
+} ImportArgs;
+
+static Blt_SwitchSpec importSwitches[] = 
+{
+    {BLT_SWITCH_OBJ,    "-data",      "string", (char *)NULL,
+        Blt_Offset(ImportArgs, dataObjPtr), 0, 0, NULL},
+    {BLT_SWITCH_OBJ,    "-encoding",  "string", (char *)NULL,
+        Blt_Offset(ImportArgs, encodingObjPtr), 0, 0, NULL},
+    {BLT_SWITCH_OBJ,    "-file",      "fileName", (char *)NULL,
+        Blt_Offset(ImportArgs, fileObjPtr), 0},
+    {BLT_SWITCH_INT_NNEG, "-maxrows", "numRows", (char *)NULL,
+        Blt_Offset(ImportArgs, maxRows), 0},
+    {BLT_SWITCH_END}
+};
+
+/*
+ * ExportArgs --
+ */
+typedef struct {
+    BLT_TABLE_ITERATOR ri, ci;
+    unsigned int flags;
+    Tcl_Obj *fileObjPtr;
+} ExportArgs;
+
+static Blt_SwitchFreeProc ColumnIterFreeProc;
+static Blt_SwitchParseProc ColumnIterSwitchProc;
+static Blt_SwitchCustom columnIterSwitch = {
+    ColumnIterSwitchProc, NULL, ColumnIterFreeProc, 0,
+};
+static Blt_SwitchFreeProc RowIterFreeProc;
+static Blt_SwitchParseProc RowIterSwitchProc;
+static Blt_SwitchCustom rowIterSwitch = {
+    RowIterSwitchProc, NULL, RowIterFreeProc, 0,
+};
+
+static Blt_SwitchSpec exportSwitches[] = 
+{
+    {BLT_SWITCH_CUSTOM, "-columns",   "columns" ,(char *)NULL,
+        Blt_Offset(ExportArgs, ci),   0, 0, &columnIterSwitch},
+    {BLT_SWITCH_OBJ,    "-file",      "fileName", (char *)NULL,
+        Blt_Offset(ExportArgs, fileObjPtr), 0},
+    {BLT_SWITCH_BITS_NOARG, "-nulls",  "", (char *)NULL,
+        Blt_Offset(ExportArgs, flags), 0, EXPORT_NULLS},
+    {BLT_SWITCH_CUSTOM, "-rows",      "rows", (char *)NULL,
+        Blt_Offset(ExportArgs, ri),   0, 0, &rowIterSwitch},
+    {BLT_SWITCH_END}
+};
+
+static BLT_TABLE_IMPORT_PROC ImportNdjsonProc;
+static BLT_TABLE_EXPORT_PROC ExportNdjsonProc;
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ColumnIterFreeProc --
+ *
+ *      Free the storage associated with the -columns switch.
+ *
+ * Results:
+ *      None.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static void
+ColumnIterFreeProc(ClientData clientData, char *record, int offset, int flags)
+{
+    BLT_TABLE_ITERATOR *iterPtr = (BLT_TABLE_ITERATOR *)(record + offset);
+
+    blt_table_free_iterator_objv(iterPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ColumnIterSwitchProc --
+ *
+ *      Convert a Tcl_Obj representing an offset in the table.
+ *
+ * Results:
+ *      The return value is a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+ColumnIterSwitchProc(ClientData clientData, Tcl_Interp *interp,
+                     const char *switchName, Tcl_Obj *objPtr, char *record,
+                     int offset, int flags)
+{
+    BLT_TABLE_ITERATOR *iterPtr = (BLT_TABLE_ITERATOR *)(record + offset);
+    BLT_TABLE table;
+    Tcl_Obj **objv;
+    int objc;
+
+    table = clientData;
+    if (Tcl_ListObjGetElements(interp, objPtr, &objc, &objv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (blt_table_iterate_columns_objv(interp, table, objc, objv, iterPtr)
+        != TCL_OK) {
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RowIterFreeProc --
+ *
+ *      Free the storage associated with the -rows switch.
+ *
+ * Results:
+ *      None.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static void
+RowIterFreeProc(ClientData clientData, char *record, int offset, int flags)
+{
+    BLT_TABLE_ITERATOR *iterPtr = (BLT_TABLE_ITERATOR *)(record + offset);
+
+    blt_table_free_iterator_objv(iterPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RowIterSwitchProc --
+ *
+ *      Convert a Tcl_Obj representing an offset in the table.
+ *
+ * Results:
+ *      The return value is a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+RowIterSwitchProc(ClientData clientData, Tcl_Interp *interp,
+                  const char *switchName, Tcl_Obj *objPtr, char *record,
+                  int offset, int flags)
+{
+    BLT_TABLE_ITERATOR *iterPtr = (BLT_TABLE_ITERATOR *)(record + offset);
+    BLT_TABLE table;
+    Tcl_Obj **objv;
+    int objc;
+
+    table = clientData;
+    if (Tcl_ListObjGetElements(interp, objPtr, &objc, &objv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (blt_table_iterate_rows_objv(interp, table, objc, objv, iterPtr)
+        != TCL_OK) {
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * AppendJsonString --
+ *
+ *      Appends the string to the buffer as a quoted JSON string.  Quotes,
+ *      backslashes, and control characters are escaped.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+AppendJsonString(Blt_DBuffer dbuffer, const char *string, size_t length)
+{
+    const unsigned char *p, *pend, *start;
+
+    Blt_DBuffer_AppendByte(dbuffer, '"');
+    start = (const unsigned char *)string;
+    for (p = start, pend = p + length; p < pend; p++) {
+        char esc[7];
+        const char *s;
+        size_t n;
+
+        if ((*p >= 0x20) && (*p != '"') && (*p != '\\') && (*p != 0xC0)) {
+            continue;
+        }
+        switch (*p) {
+        case '"':  s = "\\\"";  n = 2;  break;
+        case '\\': s = "\\\\";  n = 2;  break;
+        case '\n': s = "\\n";   n = 2;  break;
+        case '\r': s = "\\r";   n = 2;  break;
+        case '\t': s = "\\t";   n = 2;  break;
+        case '\b': s = "\\b";   n = 2;  break;
+        case '\f': s = "\\f";   n = 2;  break;
+        case 0xC0:
+            /* TCL encodes the null character as 0xC0 0x80. */
+            if (((p + 1) >= pend) || (p[1] != 0x80)) {
+                continue;
+            }
+            s = "\\u0000";  n = 6;
+            break;
+        default:
+            Blt_FmtString(esc, sizeof(esc), "\\u%04x", *p);
+            s = esc;  n = 6;
+            break;
+        }
+        if (p > start) {
+            Blt_DBuffer_AppendData(dbuffer, start, p - start);
+        }
+        Blt_DBuffer_AppendData(dbuffer, (const unsigned char *)s, n);
+        if (*p == 0xC0) {
+            p++;
+        }
+        start = p + 1;
+    }
+    if (p > start) {
+        Blt_DBuffer_AppendData(dbuffer, start, p - start);
+    }
+    Blt_DBuffer_AppendByte(dbuffer, '"');
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * AppendJsonValue --
+ *
+ *      Appends the value of the cell to the buffer.  Numbers and booleans
+ *      are written from their native values.  Numbers that can't be
+ *      represented in JSON (NaN and infinities) are written as null.
+ *      Everything else is written as a string.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+AppendJsonValue(Blt_DBuffer dbuffer, BLT_TABLE table, BLT_TABLE_ROW row,
+                BLT_TABLE_COLUMN col)
+{
+    char string[TCL_DOUBLE_SPACE + 1];
+
+    switch (blt_table_column_type(col)) {
+    case TABLE_COLUMN_TYPE_LONG:
+        Blt_FmtString(string, sizeof(string), "%ld",
+                      blt_table_get_long(NULL, table, row, col, 0));
+        break;
+    case TABLE_COLUMN_TYPE_INT64:
+        Blt_FmtString(string, sizeof(string), "%" PRId64,
+                      blt_table_get_int64(NULL, table, row, col, 0));
+        break;
+    case TABLE_COLUMN_TYPE_DOUBLE:
+        {
+            double d;
+
+            d = blt_table_get_double(NULL, table, row, col);
+            if ((isnan(d)) || (isinf(d))) {
+                strcpy(string, "null");
+            } else {
+                Tcl_PrintDouble(NULL, d, string);
+            }
+        }
+        break;
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        strcpy(string, 
+               (blt_table_get_boolean(NULL, table, row, col, FALSE)) ? 
+               "true" : "false");
+        break;
+    default:
+        {
+            BLT_TABLE_VALUE value;
+
+            value = blt_table_get_value(table, row, col);
+            AppendJsonString(dbuffer, blt_table_value_string(value),
+                             blt_table_value_length(value));
+        }
+        return;
+    }
+    Blt_DBuffer_AppendString(dbuffer, string, -1);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ExportNdjson --
+ *
+ *      Writes each row as a JSON object on a single line.  The quoted
+ *      column labels are formatted once, up front.  Lines are collected
+ *      in a buffer and written to the channel in blocks.  If there's no
+ *      channel, the buffer is returned as the interpreter result.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ExportNdjson(Tcl_Interp *interp, BLT_TABLE table, ExportArgs *exportPtr,
+             Tcl_Channel channel)
+{
+    BLT_TABLE_COLUMN col, *cols;
+    BLT_TABLE_ROW row;
+    Blt_DBuffer keys, dbuffer;
+    size_t *keyOffsets;
+    long i, numCols;
+    int result;
+
+    /* Format the keys (quoted column labels). */
+    cols = Blt_AssertMalloc((blt_table_num_columns(table) + 1) * 
+                            sizeof(BLT_TABLE_COLUMN));
+    keyOffsets = Blt_AssertMalloc((blt_table_num_columns(table) + 1) * 
+                                  sizeof(size_t));
+    keys = Blt_DBuffer_Create();
+    numCols = 0;
+    for (col = blt_table_first_tagged_column(&exportPtr->ci); col != NULL; 
+         col = blt_table_next_tagged_column(&exportPtr->ci)) {
+        const char *label;
+
+        label = blt_table_column_label(col);
+        keyOffsets[numCols] = Blt_DBuffer_Length(keys);
+        AppendJsonString(keys, label, strlen(label));
+        Blt_DBuffer_AppendByte(keys, ':');
+        cols[numCols] = col;
+        numCols++;
+    }
+    keyOffsets[numCols] = Blt_DBuffer_Length(keys);
+
+    result = TCL_OK;
+    dbuffer = Blt_DBuffer_Create();
+    for (row = blt_table_first_tagged_row(&exportPtr->ri); row != NULL; 
+         row = blt_table_next_tagged_row(&exportPtr->ri)) {
+        int count;
+
+        Blt_DBuffer_AppendByte(dbuffer, '{');
+        count = 0;
+        for (i = 0; i < numCols; i++) {
+            int isEmpty;
+
+            isEmpty = !blt_table_value_exists(table, row, cols[i]);
+            if ((isEmpty) && ((exportPtr->flags & EXPORT_NULLS) == 0)) {
+                continue;
+            }
+            if (count > 0) {
+                Blt_DBuffer_AppendByte(dbuffer, ',');
+            }
+            count++;
+            Blt_DBuffer_AppendData(dbuffer, 
+                Blt_DBuffer_Bytes(keys) + keyOffsets[i], 
+                keyOffsets[i + 1] - keyOffsets[i]);
+            if (isEmpty) {
+                Blt_DBuffer_AppendString(dbuffer, "null", 4);
+            } else {
+                AppendJsonValue(dbuffer, table, row, cols[i]);
+            }
+        }
+        Blt_DBuffer_AppendData(dbuffer, (const unsigned char *)"}\n", 2);
+        if ((channel != NULL) && 
+            (Blt_DBuffer_Length(dbuffer) >= NDJSON_BLOCK_SIZE)) {
+            if (Tcl_Write(channel, (const char *)Blt_DBuffer_Bytes(dbuffer),
+                          Blt_DBuffer_Length(dbuffer)) < 0) {
+                result = TCL_ERROR;
+                break;
+            }
+            Blt_DBuffer_SetLength(dbuffer, 0);
+        }
+    }
+    if (result == TCL_OK) {
+        if (channel == NULL) {
+            Tcl_SetObjResult(interp, 
+                Tcl_NewStringObj((const char *)Blt_DBuffer_Bytes(dbuffer), 
+                                 Blt_DBuffer_Length(dbuffer)));
+        } else if (Tcl_Write(channel, (const char *)Blt_DBuffer_Bytes(dbuffer),
+                             Blt_DBuffer_Length(dbuffer)) < 0) {
+            result = TCL_ERROR;
+        }
+    }
+    if (result != TCL_OK) {
+        Tcl_AppendResult(interp, "can't write ndjson: ", 
+                         Tcl_PosixError(interp), (char *)NULL);
+    }
+    Blt_DBuffer_Destroy(dbuffer);
+    Blt_DBuffer_Destroy(keys);
+    Blt_Free(keyOffsets);
+    Blt_Free(cols);
+    return result;
+}
+
+/* 
+ * $table export ndjson ?switches...?
+ */
+static int
+ExportNdjsonProc(BLT_TABLE table, Tcl_Interp *interp, int objc, 
+                 Tcl_Obj *const *objv)
+{
+    ExportArgs args;
+    Tcl_Channel channel;
+    int closeChannel;
+    int result;
+
+    closeChannel = FALSE;
+    channel = NULL;
+    memset(&args, 0, sizeof(args));
+    rowIterSwitch.clientData = table;
+    columnIterSwitch.clientData = table;
+    blt_table_iterate_all_rows(table, &args.ri);
+    blt_table_iterate_all_columns(table, &args.ci);
+    if (Blt_ParseSwitches(interp, exportSwitches, objc - 3, objv + 3, &args,
+        BLT_SWITCH_DEFAULTS) < 0) {
+        return TCL_ERROR;
+    }
+    result = TCL_ERROR;
+    if (args.fileObjPtr != NULL) {
+        const char *fileName;
+
+        closeChannel = TRUE;
+        fileName = Tcl_GetString(args.fileObjPtr);
+        if ((fileName[0] == '@') && (fileName[1] != '\0')) {
+            int mode;
+            
+            channel = Tcl_GetChannel(interp, fileName+1, &mode);
+            if (channel == NULL) {
+                goto error;
+            }
+            if ((mode & TCL_WRITABLE) == 0) {
+                Tcl_AppendResult(interp, "channel \"", fileName, 
+                                 "\" not opened for writing", (char *)NULL);
+                goto error;
+            }
+            closeChannel = FALSE;
+        } else {
+            channel = Tcl_OpenFileChannel(interp, fileName, "w", 0666);
+            if (channel == NULL) {
+                goto error;     /* Can't open export file. */
+            }
+        }
+    }
+    result = ExportNdjson(interp, table, &args, channel);
+ error:
+    if ((closeChannel) && (channel != NULL)) {
+        Tcl_Close(interp, channel);
+    }
+    Blt_FreeSwitches(exportSwitches, (char *)&args, 0);
+    return result;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetBlock --
+ *
+ *      Returns the next block of complete lines from the input.  Reading
+ *      from a channel, the block is at least NDJSON_BLOCK_SIZE bytes (or
+ *      the rest of the file).  A partial line at the end of the block is
+ *      saved for the next call.  Reading from the data string, the block
+ *      points into the string itself.
+ *
+ * Results:
+ *      Returns a standard TCL result.  The number of bytes in the block
+ *      is 0 at the end of the input.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+GetBlock(Tcl_Interp *interp, ImportArgs *importPtr, const char **bufferPtr,
+         size_t *numBytesPtr)
+{
+    if (importPtr->channel != NULL) {
+        Tcl_DString *dsPtr;
+        char *bp, *bend;
+        int length, isEof;
+
+        dsPtr = &importPtr->block;
+        length = Tcl_DStringLength(dsPtr);
+        if (importPtr->blockUsed > 0) {
+            char *bytes;
+
+            /* Move the partial line left from the last block to the
+             * front. */
+            bytes = Tcl_DStringValue(dsPtr);
+            length -= importPtr->blockUsed;
+            memmove(bytes, bytes + importPtr->blockUsed, length);
+            Tcl_DStringSetLength(dsPtr, length);
+            importPtr->blockUsed = 0;
+        }
+        isEof = FALSE;
+        for (;;) {
+            Tcl_Obj *objPtr;
+            const char *bytes;
+            int numBytes, numChars;
+
+            objPtr = Tcl_NewObj();
+            Tcl_IncrRefCount(objPtr);
+            numChars = Tcl_ReadChars(importPtr->channel, objPtr,
+                                     NDJSON_BLOCK_SIZE, 0);
+            if (numChars < 0) {
+                Tcl_DecrRefCount(objPtr);
+                Tcl_AppendResult(interp, "error reading file: ", 
+                                 Tcl_PosixError(interp), (char *)NULL);
+                return TCL_ERROR;
+            }
+            bytes = Tcl_GetStringFromObj(objPtr, &numBytes);
+            Tcl_DStringAppend(dsPtr, bytes, numBytes);
+            Tcl_DecrRefCount(objPtr);
+            if ((numChars == 0) || (Tcl_Eof(importPtr->channel))) {
+                isEof = TRUE;
+                break;
+            }
+            if (memchr(Tcl_DStringValue(dsPtr) + length, '\n', numBytes) 
+                != NULL) {
+                break;
+            }
+            length += numBytes;
+        }
+        length = Tcl_DStringLength(dsPtr);
+        if ((isEof) && (length > 0) && 
+            (Tcl_DStringValue(dsPtr)[length - 1] != '\n')) {
+            Tcl_DStringAppend(dsPtr, "\n", 1);
+            length++;
+        }
+        /* Hand out everything up to the last newline. */
+        bp = Tcl_DStringValue(dsPtr);
+        for (bend = bp + length; bend > bp; bend--) {
+            if (*(bend - 1) == '\n') {
+                break;
+            }
+        }
+        importPtr->blockUsed = bend - bp;
+        *bufferPtr = bp;
+        *numBytesPtr = bend - bp;
+    } else {
+        const char *bp, *bend, *last;
+
+        bp = importPtr->next;
+        if (importPtr->bytesLeft == 0) {
+            *numBytesPtr = 0;
+            return TCL_OK;
+        }
+        bend = bp + importPtr->bytesLeft;
+        last = bp + MIN(NDJSON_BLOCK_SIZE, importPtr->bytesLeft) - 1;
+        last = memchr(last, '\n', bend - last);
+        if (last != NULL) {
+            *bufferPtr = bp;
+            *numBytesPtr = last + 1 - bp;
+        } else {
+            /* Find the start of the last line. */
+            for (last = bend; last > bp; last--) {
+                if (*(last - 1) == '\n') {
+                    break;
+                }
+            }
+            if (last > bp) {
+                /* Return the complete lines first. */
+                *bufferPtr = bp;
+                *numBytesPtr = last - bp;
+            } else {
+                /* The last newline has been trimmed.  Don't change the
+                 * data object's string representation. Copy the line and
+                 * append the newline. */
+                Tcl_DStringSetLength(&importPtr->currLine, 0);
+                Tcl_DStringAppend(&importPtr->currLine, bp, bend - bp);
+                Tcl_DStringAppend(&importPtr->currLine, "\n", 1);
+                *bufferPtr = Tcl_DStringValue(&importPtr->currLine);
+                *numBytesPtr = Tcl_DStringLength(&importPtr->currLine);
+                importPtr->next = bend;
+                importPtr->bytesLeft = 0;
+                return TCL_OK;
+            }
+        }
+        importPtr->next += *numBytesPtr;
+        importPtr->bytesLeft -= *numBytesPtr;
+    }
+    return TCL_OK;
+}
+
+static INLINE const char *
+SkipSpace(const char *p, const char *pend)
+{
+    while ((p < pend) && 
+           ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n'))) {
+        p++;
+    }
+    return p;
+}
+
+static int
+SyntaxError(Tcl_Interp *interp, ImportArgs *importPtr, const char *mesg)
+{
+    Tcl_AppendResult(interp, "line ", Blt_Ltoa(importPtr->lineNum), ": ", 
+                     mesg, (char *)NULL);
+    return TCL_ERROR;
+}
+
+static int
+GetHexDigits(const char *p, const char *pend, int *codePtr)
+{
+    int i, code;
+
+    if ((pend - p) < 4) {
+        return FALSE;
+    }
+    code = 0;
+    for (i = 0; i < 4; i++) {
+        int c;
+
+        c = p[i];
+        if ((c >= '0') && (c <= '9')) {
+            c -= '0';
+        } else if ((c >= 'a') && (c <= 'f')) {
+            c -= 'a' - 10;
+        } else if ((c >= 'A') && (c <= 'F')) {
+            c -= 'A' - 10;
+        } else {
+            return FALSE;
+        }
+        code = (code << 4) | c;
+    }
+    *codePtr = code;
+    return TRUE;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * AppendUtf --
+ *
+ *      Appends the UTF-8 encoding of the code point to the dynamic
+ *      string.  The null character is encoded as TCL does (0xC0 0x80).
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+AppendUtf(Tcl_DString *dsPtr, int code)
+{
+    char buf[4];
+    int n;
+
+    if ((code > 0) && (code < 0x80)) {
+        buf[0] = code;
+        n = 1;
+    } else if (code < 0x800) {
+        buf[0] = 0xC0 | (code >> 6);
+        buf[1] = 0x80 | (code & 0x3F);
+        n = 2;
+    } else if (code < 0x10000) {
+        buf[0] = 0xE0 | (code >> 12);
+        buf[1] = 0x80 | ((code >> 6) & 0x3F);
+        buf[2] = 0x80 | (code & 0x3F);
+        n = 3;
+    } else {
+        buf[0] = 0xF0 | (code >> 18);
+        buf[1] = 0x80 | ((code >> 12) & 0x3F);
+        buf[2] = 0x80 | ((code >> 6) & 0x3F);
+        buf[3] = 0x80 | (code & 0x3F);
+        n = 4;
+    }
+    Tcl_DStringAppend(dsPtr, buf, n);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ScanString --
+ *
+ *      Scans a quoted JSON string starting at *pp*.  If the string has no
+ *      escape sequences, the string returned points into the input.
+ *      Otherwise the unescaped string is written into the given dynamic
+ *      string.
+ *
+ * Results:
+ *      Returns a standard TCL result.  The string and its length are
+ *      returned via *strPtr* and *lengthPtr*.  *pp* is moved past the
+ *      closing quote.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ScanString(Tcl_Interp *interp, ImportArgs *importPtr, const char **pp, 
+           const char *pend, Tcl_DString *dsPtr, const char **strPtr, 
+           size_t *lengthPtr)
+{
+    const char *p, *start;
+
+    start = p = *pp + 1;                /* Skip the opening quote. */
+    while ((p < pend) && (*p != '"') && (*p != '\\')) {
+        p++;
+    }
+    if (p >= pend) {
+        return SyntaxError(interp, importPtr, "unterminated string");
+    }
+    if (*p == '"') {
+        *strPtr = start;                /* No escapes. */
+        *lengthPtr = p - start;
+        *pp = p + 1;
+        return TCL_OK;
+    }
+    Tcl_DStringSetLength(dsPtr, 0);
+    Tcl_DStringAppend(dsPtr, start, p - start);
+    while ((p < pend) && (*p != '"')) {
+        int code;
+        char c;
+
+        if (*p != '\\') {
+            start = p;
+            while ((p < pend) && (*p != '"') && (*p != '\\')) {
+                p++;
+            }
+            Tcl_DStringAppend(dsPtr, start, p - start);
+            continue;
+        }
+        p++;
+        if (p >= pend) {
+            break;
+        }
+        switch (*p) {
+        case '"':
+        case '\\':
+        case '/':  c = *p;      break;
+        case 'b':  c = '\b';    break;
+        case 'f':  c = '\f';    break;
+        case 'n':  c = '\n';    break;
+        case 'r':  c = '\r';    break;
+        case 't':  c = '\t';    break;
+        case 'u':
+            if (!GetHexDigits(p + 1, pend, &code)) {
+                return SyntaxError(interp, importPtr, 
+                        "bad \\u escape in string");
+            }
+            p += 4;
+            if ((code >= 0xD800) && (code <= 0xDBFF) && ((pend - p) > 6) &&
+                (p[1] == '\\') && (p[2] == 'u')) {
+                int low;
+
+                /* Combine the surrogate pair. */
+                if ((GetHexDigits(p + 3, pend, &low)) && 
+                    (low >= 0xDC00) && (low <= 0xDFFF)) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+            }
+            AppendUtf(dsPtr, code);
+            p++;
+            continue;
+        default:
+            return SyntaxError(interp, importPtr, "bad escape in string");
+        }
+        Tcl_DStringAppend(dsPtr, &c, 1);
+        p++;
+    }
+    if (p >= pend) {
+        return SyntaxError(interp, importPtr, "unterminated string");
+    }
+    *strPtr = Tcl_DStringValue(dsPtr);
+    *lengthPtr = Tcl_DStringLength(dsPtr);
+    *pp = p + 1;
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ScanValue --
+ *
+ *      Scans the JSON value starting at *pp*.  Numbers, literals, and
+ *      nested objects or arrays are returned as their text in the input.
+ *
+ * Results:
+ *      Returns a standard TCL result.  The type, string, and length of
+ *      the value are returned.  *pp* is moved past the value.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ScanValue(Tcl_Interp *interp, ImportArgs *importPtr, const char **pp, 
+          const char *pend, JsonValueType *typePtr, const char **strPtr, 
+          size_t *lengthPtr)
+{
+    const char *p, *start;
+
+    start = p = *pp;
+    switch (*p) {
+    case '"':
+        *typePtr = JSON_STRING;
+        return ScanString(interp, importPtr, pp, pend, 
+                &importPtr->valueScratch, strPtr, lengthPtr);
+    case '{':
+    case '[':
+        {
+            int depth;
+
+            /* Skip to the matching bracket. */
+            depth = 0;
+            for (/*empty*/; p < pend; p++) {
+                if (*p == '"') {
+                    for (p++; (p < pend) && (*p != '"'); p++) {
+                        if (*p == '\\') {
+                            p++;
+                        }
+                    }
+                    if (p >= pend) {
+                        break;
+                    }
+                } else if ((*p == '{') || (*p == '[')) {
+                    depth++;
+                } else if ((*p == '}') || (*p == ']')) {
+                    depth--;
+                    if (depth == 0) {
+                        break;
+                    }
+                }
+            }
+            if (p >= pend) {
+                return SyntaxError(interp, importPtr, 
+                        "unterminated object or array");
+            }
+            p++;
+            *typePtr = JSON_NESTED;
+        }
+        break;
+    case 't':
+        if (((pend - p) < 4) || (strncmp(p, "true", 4) != 0)) {
+            goto badValue;
+        }
+        p += 4;
+        *typePtr = JSON_TRUE;
+        break;
+    case 'f':
+        if (((pend - p) < 5) || (strncmp(p, "false", 5) != 0)) {
+            goto badValue;
+        }
+        p += 5;
+        *typePtr = JSON_FALSE;
+        break;
+    case 'n':
+        if (((pend - p) < 4) || (strncmp(p, "null", 4) != 0)) {
+            goto badValue;
+        }
+        p += 4;
+        *typePtr = JSON_NULL;
+        break;
+    default:
+        {
+            const char *digits;
+            JsonValueType type;
+            size_t numDigits;
+
+            if (*p == '-') {
+                p++;
+            }
+            digits = p;
+            while ((p < pend) && (isdigit(UCHAR(*p)))) {
+                p++;
+            }
+            if (p == digits) {
+                goto badValue;
+            }
+            numDigits = p - digits;
+            if (numDigits <= NDJSON_MAX_DIGITS) {
+                type = JSON_INTEGER;
+            } else if ((numDigits < NDJSON_INT64_DIGITS) ||
+                       ((numDigits == NDJSON_INT64_DIGITS) && 
+                        (memcmp(digits, (*start == '-') ? 
+                                "9223372036854775808" : 
+                                "9223372036854775807", numDigits) <= 0))) {
+                type = JSON_INT64;      /* Still fits in 64 bits. */
+            } else {
+                type = JSON_NUMBER;
+            }
+            if ((p < pend) && (*p == '.')) {
+                type = JSON_NUMBER;
+                for (p++; (p < pend) && (isdigit(UCHAR(*p))); p++) {
+                    /*empty*/
+                }
+            }
+            if ((p < pend) && ((*p == 'e') || (*p == 'E'))) {
+                type = JSON_NUMBER;
+                p++;
+                if ((p < pend) && ((*p == '+') || (*p == '-'))) {
+                    p++;
+                }
+                for (/*empty*/; (p < pend) && (isdigit(UCHAR(*p))); p++) {
+                    /*empty*/
+                }
+            }
+            *typePtr = type;
+        }
+        break;
+    }
+    *strPtr = start;
+    *lengthPtr = p - start;
+    *pp = p;
+    return TCL_OK;
+ badValue:
+    return SyntaxError(interp, importPtr, "bad JSON value");
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetKey --
+ *
+ *      Returns the column information for the key at the given position
+ *      in the object.  The key at the same position in the previous
+ *      object is tried first.  New keys are added to the key table.  If
+ *      there's no column with the key as its label, a new column is
+ *      created.
+ *
+ * Results:
+ *      Returns the key information or NULL if a column couldn't be
+ *      created.
+ *
+ *---------------------------------------------------------------------------
+ */
+static NdjsonKey *
+GetKey(Tcl_Interp *interp, BLT_TABLE table, ImportArgs *importPtr, 
+       size_t pos, const char *key, size_t length)
+{
+    Blt_HashEntry *hPtr;
+    NdjsonKey *keyPtr;
+    const char *label;
+    int isNew;
+
+    if (pos < importPtr->numLastKeys) {
+        keyPtr = importPtr->lastKeys[pos];
+        if ((keyPtr->length == length) && 
+            (memcmp(keyPtr->key, key, length) == 0)) {
+            return keyPtr;              /* Same key as the last object. */
+        }
+    }
+    /* The hash table needs a null-terminated key. */
+    if (key != Tcl_DStringValue(&importPtr->keyScratch)) {
+        Tcl_DStringSetLength(&importPtr->keyScratch, 0);
+        Tcl_DStringAppend(&importPtr->keyScratch, key, length);
+    }
+    label = Tcl_DStringValue(&importPtr->keyScratch);
+    hPtr = Blt_CreateHashEntry(&importPtr->keyTable, label, &isNew);
+    if (isNew) {
+        BLT_TABLE_COLUMN col;
+
+        keyPtr = Blt_AssertCalloc(1, sizeof(NdjsonKey));
+        Blt_SetHashValue(hPtr, keyPtr);
+        keyPtr->key = Blt_GetHashKey(&importPtr->keyTable, hPtr);
+        keyPtr->length = length;
+        col = blt_table_get_column_by_label(table, label);
+        if (col == NULL) {
+            if ((blt_table_extend_columns(interp, table, 1, &col) != TCL_OK) ||
+                (blt_table_set_column_label(interp, table, col, label) 
+                 != TCL_OK)) {
+                return NULL;
+            }
+            keyPtr->inferType = TRUE;
+        }
+        keyPtr->col = col;
+    } else {
+        keyPtr = Blt_GetHashValue(hPtr);
+    }
+    /* Remember the key's position for the next object. */
+    if (pos >= importPtr->lastKeysAllocated) {
+        importPtr->lastKeysAllocated += 16;
+        importPtr->lastKeys = Blt_AssertRealloc(importPtr->lastKeys,
+                importPtr->lastKeysAllocated * sizeof(NdjsonKey *));
+    }
+    importPtr->lastKeys[pos] = keyPtr;
+    if (pos >= importPtr->numLastKeys) {
+        importPtr->numLastKeys = pos + 1;
+    }
+    return keyPtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SetValue --
+ *
+ *      Sets the cell from the JSON value.  If the column was created by
+ *      the import, its type is set from the first value and widened (to
+ *      "int64", "double", or "string") if the value doesn't fit.  Numbers
+ *      and booleans are stored directly into numeric columns.  When a
+ *      boolean column is widened to "string", its cells are reset to
+ *      "true" or "false" so they read the same as in the JSON.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+SetValue(Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_ROW row, 
+         NdjsonKey *keyPtr, JsonValueType jsonType, const char *string, 
+         size_t length)
+{
+    BLT_TABLE_COLUMN_TYPE type;
+    char *end;
+
+    type = blt_table_column_type(keyPtr->col);
+    if (keyPtr->inferType) {
+        BLT_TABLE_COLUMN_TYPE newType, needed;
+
+        needed = jsonColumnTypes[jsonType];
+        if (!keyPtr->isTyped) {
+            newType = needed;
+            keyPtr->isTyped = TRUE;
+        } else if ((needed == type) || 
+                   ((type == TABLE_COLUMN_TYPE_DOUBLE) && 
+                    ((needed == TABLE_COLUMN_TYPE_LONG) ||
+                     (needed == TABLE_COLUMN_TYPE_INT64))) ||
+                   ((type == TABLE_COLUMN_TYPE_INT64) &&
+                    (needed == TABLE_COLUMN_TYPE_LONG))) {
+            newType = type;
+        } else if ((type == TABLE_COLUMN_TYPE_LONG) && 
+                   (needed == TABLE_COLUMN_TYPE_INT64)) {
+            newType = TABLE_COLUMN_TYPE_INT64;
+        } else if (((type == TABLE_COLUMN_TYPE_LONG) || 
+                    (type == TABLE_COLUMN_TYPE_INT64)) && 
+                   (needed == TABLE_COLUMN_TYPE_DOUBLE)) {
+            newType = TABLE_COLUMN_TYPE_DOUBLE;
+        } else {
+            newType = TABLE_COLUMN_TYPE_STRING;
+        }
+        if (newType != type) {
+            if (blt_table_set_column_type(interp, table, keyPtr->col, newType)
+                != TCL_OK) {
+                return TCL_ERROR;
+            }
+            if (type == TABLE_COLUMN_TYPE_BOOLEAN) {
+                BLT_TABLE_ROW r;
+
+                /* Only this import has set cells in the column, so every
+                 * value is a JSON boolean. */
+                for (r = blt_table_first_row(table); r != NULL; 
+                     r = blt_table_next_row(r)) {
+                    const char *s;
+
+                    s = blt_table_get_string(table, r, keyPtr->col);
+                    if ((s != NULL) &&
+                        (blt_table_set_string_rep(interp, table, r, 
+                                keyPtr->col, (*s == '1') ? "true" : "false",
+                                -1) != TCL_OK)) {
+                        return TCL_ERROR;
+                    }
+                }
+            }
+            type = newType;
+        }
+        if (type == TABLE_COLUMN_TYPE_STRING) {
+            keyPtr->inferType = FALSE;  /* Can't get any wider. */
+        }
+    }
+    switch (type) {
+    case TABLE_COLUMN_TYPE_LONG:
+        if ((jsonType == JSON_INTEGER) || (jsonType == JSON_INT64)) {
+            long l;
+
+            errno = 0;
+            l = strtol(string, &end, 10);
+            if (errno == 0) {
+                return blt_table_set_long(interp, table, row, keyPtr->col, l);
+            }
+        }
+        break;
+    case TABLE_COLUMN_TYPE_INT64:
+        if ((jsonType == JSON_INTEGER) || (jsonType == JSON_INT64)) {
+            int64_t i;
+
+            i = strtoll(string, &end, 10);
+            return blt_table_set_int64(interp, table, row, keyPtr->col, i);
+        }
+        break;
+    case TABLE_COLUMN_TYPE_DOUBLE:
+        if ((jsonType == JSON_INTEGER) || (jsonType == JSON_INT64) ||
+            (jsonType == JSON_NUMBER)) {
+            double d;
+
+            d = strtod(string, &end);
+            return blt_table_set_double(interp, table, row, keyPtr->col, d);
+        }
+        break;
+    case TABLE_COLUMN_TYPE_BOOLEAN:
+        if ((jsonType == JSON_TRUE) || (jsonType == JSON_FALSE)) {
+            return blt_table_set_boolean(interp, table, row, keyPtr->col,
+                                         (jsonType == JSON_TRUE));
+        }
+        break;
+    default:
+        break;
+    }
+    return blt_table_set_string_rep(interp, table, row, keyPtr->col, string,
+                                    length);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ParseObject --
+ *
+ *      Parses the JSON object on a single line and loads its values into
+ *      the given row.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+ParseObject(Tcl_Interp *interp, BLT_TABLE table, ImportArgs *importPtr, 
+            BLT_TABLE_ROW row, const char *p, const char *pend)
+{
+    size_t pos;
+
+    if (*p != '{') {
+        return SyntaxError(interp, importPtr, "expected JSON object");
+    }
+    p = SkipSpace(p + 1, pend);
+    if ((p < pend) && (*p == '}')) {
+        p++;                            /* Empty object. */
+    } else {
+        for (pos = 0; /*empty*/; pos++) {
+            NdjsonKey *keyPtr;
+            JsonValueType type;
+            const char *key, *value;
+            size_t keyLength, valueLength;
+
+            if ((p >= pend) || (*p != '"')) {
+                return SyntaxError(interp, importPtr, "expected key string");
+            }
+            if (ScanString(interp, importPtr, &p, pend, 
+                        &importPtr->keyScratch, &key, &keyLength) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            p = SkipSpace(p, pend);
+            if ((p >= pend) || (*p != ':')) {
+                return SyntaxError(interp, importPtr, "expected \":\"");
+            }
+            p = SkipSpace(p + 1, pend);
+            if (p >= pend) {
+                return SyntaxError(interp, importPtr, "missing value");
+            }
+            if (ScanValue(interp, importPtr, &p, pend, &type, &value, 
+                          &valueLength) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            keyPtr = GetKey(interp, table, importPtr, pos, key, keyLength);
+            if (keyPtr == NULL) {
+                return TCL_ERROR;
+            }
+            if ((type != JSON_NULL) &&
+                (SetValue(interp, table, row, keyPtr, type, value, 
+                          valueLength) != TCL_OK)) {
+                return TCL_ERROR;
+            }
+            p = SkipSpace(p, pend);
+            if ((p < pend) && (*p == ',')) {
+                p = SkipSpace(p + 1, pend);
+                continue;
+            }
+            if ((p < pend) && (*p == '}')) {
+                p++;
+                break;
+            }
+            return SyntaxError(interp, importPtr, "expected \",\" or \"}\"");
+        }
+    }
+    p = SkipSpace(p, pend);
+    if (p < pend) {
+        return SyntaxError(interp, importPtr, 
+                "extra characters after JSON object");
+    }
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * LoadBlock --
+ *
+ *      Loads the objects in a block of lines into the table.  The rows
+ *      for all the objects (non-blank lines) in the block are added at
+ *      once.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+LoadBlock(Tcl_Interp *interp, BLT_TABLE table, ImportArgs *importPtr,
+          const char *bp, const char *bend)
+{
+    BLT_TABLE_ROW *rows;
+    const char *p, *q;
+    long i, numRows;
+    int result;
+
+    /* Count the objects in the block. The block always ends with a
+     * newline. */
+    numRows = 0;
+    for (p = bp; p < bend; p = q + 1) {
+        q = memchr(p, '\n', bend - p);
+        if (SkipSpace(p, q) < q) {
+            numRows++;
+        }
+    }
+    if ((importPtr->maxRows > 0) && 
+        ((importPtr->numRowsLoaded + numRows) > importPtr->maxRows)) {
+        numRows = importPtr->maxRows - importPtr->numRowsLoaded;
+    }
+    if (numRows == 0) {
+        return TCL_OK;
+    }
+    rows = Blt_AssertMalloc(numRows * sizeof(BLT_TABLE_ROW));
+    if (blt_table_extend_rows(interp, table, numRows, rows) != TCL_OK) {
+        Blt_Free(rows);
+        return TCL_ERROR;
+    }
+    result = TCL_OK;
+    i = 0;
+    for (p = bp; (p < bend) && (i < numRows); p = q + 1) {
+        const char *start;
+
+        q = memchr(p, '\n', bend - p);
+        importPtr->lineNum++;
+        start = SkipSpace(p, q);
+        if (start == q) {
+            continue;                   /* Blank line. */
+        }
+        result = ParseObject(interp, table, importPtr, rows[i], start, q);
+        if (result != TCL_OK) {
+            break;
+        }
+        i++;
+    }
+    importPtr->numRowsLoaded += numRows;
+    Blt_Free(rows);
+    return result;
+}
+
+static int
+ImportNdjson(Tcl_Interp *interp, BLT_TABLE table, ImportArgs *importPtr)
+{
+    Blt_HashEntry *hPtr;
+    Blt_HashSearch iter;
+    int result;
+
+    Tcl_DStringInit(&importPtr->keyScratch);
+    Tcl_DStringInit(&importPtr->valueScratch);
+    Blt_InitHashTable(&importPtr->keyTable, BLT_STRING_KEYS);
+    for (;;) {
+        const char *bp;
+        size_t numBytes;
+
+        result = GetBlock(interp, importPtr, &bp, &numBytes);
+        if ((result != TCL_OK) || (numBytes == 0)) {
+            break;                      /* I/O error or EOF. */
+        }
+        result = LoadBlock(interp, table, importPtr, bp, bp + numBytes);
+        if (result != TCL_OK) {
+            break;
+        }
+        if ((importPtr->maxRows > 0) && 
+            (importPtr->numRowsLoaded >= importPtr->maxRows)) {
+            break;
+        }
+    }
+    for (hPtr = Blt_FirstHashEntry(&importPtr->keyTable, &iter); hPtr != NULL;
+         hPtr = Blt_NextHashEntry(&iter)) {
+        NdjsonKey *keyPtr;
+
+        keyPtr = Blt_GetHashValue(hPtr);
+        Blt_Free(keyPtr);
+    }
+    Blt_DeleteHashTable(&importPtr->keyTable);
+    if (importPtr->lastKeys != NULL) {
+        Blt_Free(importPtr->lastKeys);
+    }
+    Tcl_DStringFree(&importPtr->keyScratch);
+    Tcl_DStringFree(&importPtr->valueScratch);
+    return result;
+}
+
+/* 
+ * $table import ndjson -file fileName ?switches...?
+ * $table import ndjson -data string ?switches...?
+ */
+static int
+ImportNdjsonProc(BLT_TABLE table, Tcl_Interp *interp, int objc, 
+                 Tcl_Obj *const *objv)
+{
+    ImportArgs args;
+    int result;
+
+    memset(&args, 0, sizeof(args));
+    if (Blt_ParseSwitches(interp, importSwitches, objc - 3 , objv + 3, 
+        &args, BLT_SWITCH_DEFAULTS) < 0) {
+        return TCL_ERROR;
+    }
+    result = TCL_ERROR;
+    Tcl_DStringInit(&args.currLine);
+    Tcl_DStringInit(&args.block);
+    if ((args.dataObjPtr != NULL) && (args.fileObjPtr != NULL)) {
+        Tcl_AppendResult(interp, "can't set both -file and -data switches.",
+                         (char *)NULL);
+        goto error;
+    }
+    if (args.dataObjPtr != NULL) {
+        int numBytes;
+
+        args.next = Tcl_GetStringFromObj(args.dataObjPtr, &numBytes);
+        args.bytesLeft = numBytes;
+        result = ImportNdjson(interp, table, &args);
+    } else {
+        int closeChannel;
+        Tcl_Channel channel;
+        const char *fileName;
+
+        if (args.fileObjPtr == NULL) {
+            Tcl_AppendResult(interp, "either -file or -data switch is required",
+                (char *)NULL);
+            goto error;
+        }
+        closeChannel = TRUE;
+        fileName = Tcl_GetString(args.fileObjPtr);
+        if ((fileName[0] == '@') && (fileName[1] != '\0')) {
+            int mode;
+            
+            channel = Tcl_GetChannel(interp, fileName+1, &mode);
+            if (channel == NULL) {
+                goto error;
+            }
+            if ((mode & TCL_READABLE) == 0) {
+                Tcl_AppendResult(interp, "channel \"", fileName, 
+                                 "\" not opened for reading", (char *)NULL);
+                goto error;
+            }
+            closeChannel = FALSE;
+        } else {
+            channel = Tcl_OpenFileChannel(interp, fileName, "r", 0);
+            if (channel == NULL) {
+                goto error;
+            }
+        }
+        if (Tcl_SetChannelOption(interp, channel, "-encoding", 
+                (args.encodingObjPtr != NULL) ? 
+                Tcl_GetString(args.encodingObjPtr) : "utf-8") != TCL_OK) {
+            if (closeChannel) {
+                Tcl_Close(interp, channel);
+            }
+            goto error;
+        }
+        args.channel = channel;
+        result = ImportNdjson(interp, table, &args);
+        if (closeChannel) {
+            Tcl_Close(interp, channel);
+        }
+    }
+ error:
+    Tcl_DStringFree(&args.currLine);
+    Tcl_DStringFree(&args.block);
+    Blt_FreeSwitches(importSwitches, (char *)&args, 0);
+    return result;
+}
+    
+int 
+blt_table_ndjson_init(Tcl_Interp *interp)
+{
+#ifdef USE_TCL_STUBS
+    if (Tcl_InitStubs(interp, TCL_VERSION_COMPILED, PKG_ANY) == NULL) {
+        return TCL_ERROR;
+    };
+#endif
+#ifdef USE_BLT_STUBS
+    if (Blt_InitTclStubs(interp, BLT_VERSION, PKG_EXACT) == NULL) {
+        return TCL_ERROR;
+    };
+#else
+    if (Tcl_PkgRequire(interp, "blt_tcl", BLT_VERSION, PKG_EXACT) == NULL) {
+        return TCL_ERROR;
+    }
+#endif    
+    if (Tcl_PkgProvide(interp, "blt_datatable_ndjson", BLT_VERSION) 
+        != TCL_OK) { 
+        return TCL_ERROR;
+    }
+    return blt_table_register_format(interp,
+        "ndjson",               /* Name of format. */
+        ImportNdjsonProc,       /* Import procedure. */
+        ExportNdjsonProc);      /* Export procedure. */
+}
+
+int 
+blt_table_ndjson_safe_init(Tcl_Interp *interp)
+{
+    return blt_table_ndjson_init(interp);
+}
+
+#endif /* NO_DATATABLE */
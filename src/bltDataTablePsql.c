@@ -51,6 +51,10 @@
   #include <memory.h>
 #endif /* HAVE_MEMORY_H */
 
+#ifdef HAVE_ERRNO_H
+  #include <errno.h>
+#endif /* HAVE_ERRNO_H */
+
 #include <tcl.h>
 #include <bltDataTable.h>
 #include <bltAlloc.h>
@@ -192,6 +196,23 @@ static PsqlTypeConvert psqlTypeConverts[] = {
 };
 static int numTypeConverts = sizeof(psqlTypeConverts) / sizeof(PsqlTypeConvert);
 
+/* 
+ * Object ids of the built-in postgres types that map directly onto table
+ * column types.  These are fixed by the server (see pg_type.h), but the
+ * header isn't part of the client library.
+ */
+#define PSQL_BOOLOID            16
+#define PSQL_INT8OID            20
+#define PSQL_INT2OID            21
+#define PSQL_INT4OID            23
+#define PSQL_OIDOID             26
+#define PSQL_FLOAT4OID          700
+#define PSQL_FLOAT8OID          701
+
+#define PSQL_COPY_BUFSIZE       (1<<16) /* # of bytes to buffer before
+                                         * sending COPY data to the
+                                         * server. */
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -341,6 +362,38 @@ PsqlConvertToColumnType(const char *string, size_t length)
     return TABLE_COLUMN_TYPE_STRING;        /* Default to string. */
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * PsqlOidToColumnType --
+ *
+ *      Convert the postgres type of a result field (represented by its
+ *      object id) to the associated table column type.
+ *
+ * Results:
+ *      The return value is the converted column type.
+ *
+ *---------------------------------------------------------------------------
+ */
+static BLT_TABLE_COLUMN_TYPE
+PsqlOidToColumnType(Oid oid)
+{
+    switch (oid) {
+    case PSQL_BOOLOID:
+        return TABLE_COLUMN_TYPE_BOOLEAN;
+    case PSQL_INT2OID:
+    case PSQL_INT4OID:
+    case PSQL_INT8OID:
+    case PSQL_OIDOID:
+        return TABLE_COLUMN_TYPE_LONG;
+    case PSQL_FLOAT4OID:
+    case PSQL_FLOAT8OID:
+        return TABLE_COLUMN_TYPE_DOUBLE;
+    default:
+        return TABLE_COLUMN_TYPE_STRING;
+    }
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -433,8 +486,9 @@ PsqlQuery(Tcl_Interp *interp, PGconn *conn, const char *query,
  *
  * PsqlImportLabels --
  *
- *      Sets the column labels in the table for the new columns. The column
- *      names are the postgres field names.
+ *      Sets the column labels and types in the table for the new columns.
+ *      The column names are the postgres field names.  The column types
+ *      are derived from the field type of the result set.
  *
  * Results:
  *      The return value is a standard TCL result.  
@@ -448,6 +502,7 @@ PsqlImportLabels(Tcl_Interp *interp, BLT_TABLE table, PGresult *result,
     size_t i;
 
     for (i = 0; i < numCols; i++) {
+        BLT_TABLE_COLUMN_TYPE type;
         const char *label;
 
         label = PQfname(result, i);
@@ -455,6 +510,10 @@ PsqlImportLabels(Tcl_Interp *interp, BLT_TABLE table, PGresult *result,
             != TCL_OK) {
             return TCL_ERROR;
         }
+        type = PsqlOidToColumnType(PQftype(result, i));
+        if (blt_table_set_column_type(interp, table, cols[i], type) != TCL_OK) {
+            return TCL_ERROR;
+        }
     }
     return TCL_OK;
 }
@@ -462,10 +521,13 @@ PsqlImportLabels(Tcl_Interp *interp, BLT_TABLE table, PGresult *result,
 /*
  *---------------------------------------------------------------------------
  *
- * PsqlImportValues --
+ * PsqlImportValue --
  *
- *      Sets the cell values in the table for the new columns.  This 
- *      overwrites any existing data in the table.
+ *      Sets a single cell from the text representation returned by the
+ *      server.  Integer, double, and boolean values are converted here
+ *      and stored directly, skipping the generic string conversion.
+ *      Anything that doesn't convert cleanly is handed to
+ *      blt_table_set_string_rep.
  *
  * Results:
  *      The return value is a standard TCL result.  
@@ -473,42 +535,151 @@ PsqlImportLabels(Tcl_Interp *interp, BLT_TABLE table, PGresult *result,
  *---------------------------------------------------------------------------
  */
 static int
-PsqlImportValues(Tcl_Interp *interp, BLT_TABLE table, PGresult *result, 
-                 size_t numCols, BLT_TABLE_COLUMN *cols) 
+PsqlImportValue(Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_ROW row,
+                BLT_TABLE_COLUMN col, const char *value, int length)
 {
-    size_t numRows;
-    size_t count;
+    char *end;
+
+    if (length > 0) {
+        switch (blt_table_column_type(col)) {
+        case TABLE_COLUMN_TYPE_LONG:
+            {
+                long l;
+
+                errno = 0;
+                l = strtol(value, &end, 10);
+                if ((errno == 0) && (end == (value + length))) {
+                    return blt_table_set_long(interp, table, row, col, l);
+                }
+            }
+            break;
+        case TABLE_COLUMN_TYPE_DOUBLE:
+            {
+                double d;
+
+                errno = 0;
+                d = strtod(value, &end);
+                if ((errno == 0) && (end == (value + length))) {
+                    return blt_table_set_double(interp, table, row, col, d);
+                }
+            }
+            break;
+        case TABLE_COLUMN_TYPE_BOOLEAN:
+            if ((length == 1) && ((value[0] == 't') || (value[0] == 'f'))) {
+                return blt_table_set_boolean(interp, table, row, col,
+                        (value[0] == 't'));
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return blt_table_set_string_rep(interp, table, row, col, value, length);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * PsqlImportRows --
+ *
+ *      Sends the query to the server and streams the result set into the
+ *      table one row at a time (single-row mode), so that the complete
+ *      result set is never held in client memory.  New columns are
+ *      created when the first result arrives.  Values overwrite existing
+ *      data in the table starting from the first row.  Rows are added to
+ *      the table one at a time as they arrive; the table's storage grows
+ *      geometrically, so no rows are created that aren't used.
+ *
+ * Results:
+ *      The return value is a standard TCL result.  
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+PsqlImportRows(Tcl_Interp *interp, BLT_TABLE table, PGconn *conn,
+               const char *query, size_t *numColsPtr, BLT_TABLE_COLUMN **colsPtr)
+{
+    BLT_TABLE_COLUMN *cols;
     BLT_TABLE_ROW row;
-    
-    numRows = PQntuples(result);
-    /* First check that there are enough rows in the table to accomodate
-     * the new data. Add more if necessary. */
-    if (numRows  > blt_table_num_rows(table)) {
-        size_t needed;
+    PGresult *res;
+    size_t numCols;
+    int result;
 
-        needed = numRows - blt_table_num_rows(table);
-        if (blt_table_extend_rows(interp, table, needed, NULL) != TCL_OK) {
-            return TCL_ERROR;
+    if (!PQsendQuery(conn, query)) {
+        Tcl_AppendResult(interp, "error in query \"", query, "\": ", 
+                         PQerrorMessage(conn), (char *)NULL);
+        return TCL_ERROR;
+    }
+    if (!PQsetSingleRowMode(conn)) {
+        Tcl_AppendResult(interp, "can't set single row mode for query \"",
+                query, "\": ", PQerrorMessage(conn), (char *)NULL);
+        while ((res = PQgetResult(conn)) != NULL) {
+            PQclear(res);
         }
+        return TCL_ERROR;
     }
-    count = 0;
-    for (row = blt_table_first_row(table); /*empty*/; 
-         row = blt_table_next_row(row), count++) {
+    numCols = 0;
+    cols = NULL;
+    row = NULL;
+    result = TCL_OK;
+    /* Always read results until NULL is returned, even after an error, so
+     * that the connection is left in a sane state. */
+    while ((res = PQgetResult(conn)) != NULL) {
+        ExecStatusType status;
         size_t j;
 
+        status = PQresultStatus(res);
+        if (result != TCL_OK) {
+            PQclear(res);
+            continue;
+        }
+        if ((status != PGRES_SINGLE_TUPLE) && (status != PGRES_TUPLES_OK)) {
+            Tcl_AppendResult(interp, "error in query \"", query, "\": ",
+                PQresultErrorMessage(res), (char *)NULL);
+            result = TCL_ERROR;
+            PQclear(res);
+            continue;
+        }
+        if (cols == NULL) {
+            /* Create columns to hold the new values. The final (empty)
+             * result still carries the field descriptions, so columns
+             * are created even if no rows are returned. */
+            numCols = PQnfields(res);
+            cols = Blt_AssertMalloc((numCols + 1) * sizeof(BLT_TABLE_COLUMN));
+            result = blt_table_extend_columns(interp, table, numCols, cols);
+            if (result == TCL_OK) {
+                result = PsqlImportLabels(interp, table, res, numCols, cols);
+            }
+        }
+        if ((result != TCL_OK) || (status != PGRES_SINGLE_TUPLE)) {
+            PQclear(res);
+            continue;
+        }
+        row = (row == NULL) ? blt_table_first_row(table) :
+            blt_table_next_row(row);
+        if (row == NULL) {
+            /* Out of rows. Add another row to the table. */
+            result = blt_table_extend_rows(interp, table, 1, &row);
+            if (result != TCL_OK) {
+                PQclear(res);
+                continue;
+            }
+        }
         for (j = 0; j < numCols; j++) {
-            int length;
-            const char *value;
-
-            value = PQgetvalue(result, count, j);
-            length = PQgetlength(result, count, j);
-            if (blt_table_set_string_rep(interp, table, row, cols[j], value,
-                        length) != TCL_OK) {
-                return TCL_ERROR;
+            if (PQgetisnull(res, 0, j)) {
+                continue;               /* Leave NULL values empty. */
+            }
+            result = PsqlImportValue(interp, table, row, cols[j],
+                PQgetvalue(res, 0, j), PQgetlength(res, 0, j));
+            if (result != TCL_OK) {
+                break;
             }
         }
+        PQclear(res);
     }
-    return TCL_OK;
+    *numColsPtr = numCols;
+    *colsPtr = cols;
+    return result;
 }
 
 /*
@@ -606,6 +777,69 @@ PsqlImportColumnTypes(Tcl_Interp *interp, BLT_TABLE table, PGconn *conn,
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * PsqlAppendIdentifier --
+ *
+ *      Appends the quoted and escaped form of the identifier (column
+ *      label) to the buffer.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+PsqlAppendIdentifier(Blt_DBuffer dbuffer, PGconn *conn, const char *name)
+{
+    char *quoted;
+
+    quoted = PQescapeIdentifier(conn, name, strlen(name));
+    if (quoted != NULL) {
+        Blt_DBuffer_AppendString(dbuffer, quoted, -1);
+        PQfreemem(quoted);
+    } else {
+        Blt_DBuffer_Format(dbuffer, "\"%s\"", name);
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * PsqlAppendCopyValue --
+ *
+ *      Appends the value to the buffer in COPY text format.  Backslashes
+ *      and the characters used as field and record delimiters are escaped.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+PsqlAppendCopyValue(Blt_DBuffer dbuffer, const char *value, int length)
+{
+    const char *p, *pend, *start;
+
+    for (start = p = value, pend = value + length; p < pend; p++) {
+        const char *esc;
+
+        switch (*p) {
+        case '\\':    esc = "\\\\";       break;
+        case '\t':     esc = "\\t";        break;
+        case '\n':     esc = "\\n";        break;
+        case '\r':     esc = "\\r";        break;
+        default:
+            continue;
+        }
+        if (p > start) {
+            Blt_DBuffer_AppendData(dbuffer, (const unsigned char *)start,
+                                   p - start);
+        }
+        Blt_DBuffer_AppendData(dbuffer, (const unsigned char *)esc, 2);
+        start = p + 1;
+    }
+    if (p > start) {
+        Blt_DBuffer_AppendData(dbuffer, (const unsigned char *)start,
+                               p - start);
+    }
+}
+
 static int
 PsqlCreateTable(Tcl_Interp *interp, PGconn *conn, BLT_TABLE table,
                 ExportArgs *argsPtr)
@@ -619,10 +853,11 @@ PsqlCreateTable(Tcl_Interp *interp, PGconn *conn, BLT_TABLE table,
     dbuffer = Blt_DBuffer_Create();
     Blt_DBuffer_Format(dbuffer, "DROP TABLE IF EXISTS %s; CREATE TABLE %s (",
                        argsPtr->tableName, argsPtr->tableName);
+    first = TRUE;
     if (argsPtr->flags & EXPORT_ROWLABELS) {
-        Blt_DBuffer_Format(dbuffer, "_rowId TEXT, ");
+        Blt_DBuffer_Format(dbuffer, "_rowId TEXT");
+        first = FALSE;
     }        
-    first = TRUE;
     for (col = blt_table_first_tagged_column(&argsPtr->ci); col != NULL; 
          col = blt_table_next_tagged_column(&argsPtr->ci)) {
         int type;
@@ -633,20 +868,21 @@ PsqlCreateTable(Tcl_Interp *interp, PGconn *conn, BLT_TABLE table,
         if (!first) {
             Blt_DBuffer_Format(dbuffer, ", ");
         }
-        Blt_DBuffer_Format(dbuffer, "[%s] ", label);
+        PsqlAppendIdentifier(dbuffer, conn, label);
         switch(type) {
         case TABLE_COLUMN_TYPE_BOOLEAN:
-            Blt_DBuffer_Format(dbuffer, "boolean");     break;
+            Blt_DBuffer_Format(dbuffer, " boolean");    break;
         case TABLE_COLUMN_TYPE_LONG:
-            Blt_DBuffer_Format(dbuffer, "int8");        break;
+            Blt_DBuffer_Format(dbuffer, " int8");       break;
         case TABLE_COLUMN_TYPE_DOUBLE:
-            Blt_DBuffer_Format(dbuffer, "float8");      break;
+            Blt_DBuffer_Format(dbuffer, " float8");     break;
         default:
         case TABLE_COLUMN_TYPE_TIME:
         case TABLE_COLUMN_TYPE_STRING:
-            Blt_DBuffer_Format(dbuffer, "text");        break;
         case TABLE_COLUMN_TYPE_BLOB:
-            Blt_DBuffer_Format(dbuffer, "bytea");       break;
+            /* Blobs are written as text: their string representation
+             * isn't in the COPY bytea format. */
+            Blt_DBuffer_Format(dbuffer, " text");       break;
         }
         first = FALSE;
     }
@@ -658,7 +894,7 @@ PsqlCreateTable(Tcl_Interp *interp, PGconn *conn, BLT_TABLE table,
         Blt_DBuffer_Destroy(dbuffer);
         return TCL_ERROR;
     }
-    if (PQresultStatus(result) != PGRES_TUPLES_OK) {
+    if (PQresultStatus(result) != PGRES_COMMAND_OK) {
         Tcl_AppendResult(interp, "error in query \"", query, "\": ", 
                 PQresultErrorMessage(result), (char *)NULL);
         Blt_DBuffer_Destroy(dbuffer);
@@ -670,128 +906,132 @@ PsqlCreateTable(Tcl_Interp *interp, PGconn *conn, BLT_TABLE table,
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * PsqlExportValues --
+ *
+ *      Writes the selected rows and columns into the postgres table using
+ *      "COPY ... FROM STDIN".  Rows are formatted in the COPY text format
+ *      and sent to the server in PSQL_COPY_BUFSIZE blocks rather than as
+ *      one INSERT statement per row.  Empty cells are written as NULL.
+ *
+ * Results:
+ *      The return value is a standard TCL result.  
+ *
+ *---------------------------------------------------------------------------
+ */
 static int
 PsqlExportValues(Tcl_Interp *interp, PGconn *conn, BLT_TABLE table,
                  ExportArgs *argsPtr)
 {
     BLT_TABLE_COLUMN col;
     BLT_TABLE_ROW row;
-    Blt_DBuffer dbuffer, dbuffer2;
-    const char *query;
-    int count, numParams; 
-    int *formats;
-    const char **values;
-    int *lengths;
+    Blt_DBuffer dbuffer;
     PGresult *result;
-    const char *stmtName;
+    const char *query;
+    int first, status;
 
-    stmtName = "TableInsert";
-    /* Build up the insert string including the parameters */
+    /* Start the copy. */
     dbuffer = Blt_DBuffer_Create();
-    dbuffer2 = Blt_DBuffer_Create();
-    Blt_DBuffer_Format(dbuffer, "INSERT INTO '%s' (", argsPtr->tableName);
-    Blt_DBuffer_Format(dbuffer2, " VALUES (");
-    count = 0;
+    Blt_DBuffer_Format(dbuffer, "COPY %s (", argsPtr->tableName);
+    first = TRUE;
     if (argsPtr->flags & EXPORT_ROWLABELS) {
         Blt_DBuffer_Format(dbuffer, "_rowId");
-        Blt_DBuffer_Format(dbuffer2, "?%d", count);
-        count++;
+        first = FALSE;
     }        
     for (col = blt_table_first_tagged_column(&argsPtr->ci); col != NULL;
          col = blt_table_next_tagged_column(&argsPtr->ci)) {
-        const char *label;
-        
-        label = blt_table_column_label(col);
-        if (count > 1) {
+        if (!first) {
             Blt_DBuffer_Format(dbuffer, ", ");
-            Blt_DBuffer_Format(dbuffer2, ", ");
         }
-        Blt_DBuffer_Format(dbuffer, "[%s]", label);
-        Blt_DBuffer_Format(dbuffer2, "?%d", count);
-        count++;
-    }
-    Blt_DBuffer_Format(dbuffer2, ");");
-    Blt_DBuffer_Format(dbuffer, ")");
-    Blt_DBuffer_Concat(dbuffer, dbuffer2);
-    Blt_DBuffer_Destroy(dbuffer2);
-
-    numParams = count;
-    /* Arrays for parameters. */
-    formats = Blt_AssertCalloc(numParams, sizeof(int)); /* Formats are
-                                                         * always text. */
-    values = Blt_AssertMalloc(sizeof(char *) * numParams);
-    lengths = Blt_AssertMalloc(sizeof(int) * numParams);
-
+        PsqlAppendIdentifier(dbuffer, conn, blt_table_column_label(col));
+        first = FALSE;
+    }
+    Blt_DBuffer_Format(dbuffer, ") FROM STDIN;");
     query = Blt_DBuffer_String(dbuffer);
-    result = PQprepare(conn, stmtName, query, numParams, NULL);
-    if (result == NULL) {
-        Tcl_AppendResult(interp, "error in parameters \": ", 
-                PQerrorMessage(conn), (char *)NULL);
+    if (PsqlQuery(interp, conn, query, &result) != TCL_OK) {
         Blt_DBuffer_Destroy(dbuffer);
-        goto error;
+        return TCL_ERROR;
     }
-    if (PQresultStatus(result) != PGRES_COMMAND_OK) {
-        Tcl_AppendResult(interp, "error in insert statment \"", query, "\": ", 
+    if (PQresultStatus(result) != PGRES_COPY_IN) {
+        Tcl_AppendResult(interp, "error in copy statement \"", query, "\": ", 
                 PQresultErrorMessage(result), (char *)NULL);
-        goto error;
+        Blt_DBuffer_Destroy(dbuffer);
+        PQclear(result);
+        return TCL_ERROR;
     }
     PQclear(result);
 
-    Blt_DBuffer_Destroy(dbuffer);
+    /* Send the rows, a block at a time. */
+    Blt_DBuffer_SetLength(dbuffer, 0);
     for (row = blt_table_first_tagged_row(&argsPtr->ri); row != NULL; 
          row = blt_table_next_tagged_row(&argsPtr->ri)) {
-        int count;                      
-        
-        count = 0;                      
+        first = TRUE;
         if (argsPtr->flags & EXPORT_ROWLABELS) {
             const char *label;
                     
             label = blt_table_row_label(row);
-            values[count] = (char *)label;
-            lengths[count] = strlen(label);
-            count++;
+            PsqlAppendCopyValue(dbuffer, label, strlen(label));
+            first = FALSE;
         }
         for (col = blt_table_first_tagged_column(&argsPtr->ci); col != NULL;
              col = blt_table_next_tagged_column(&argsPtr->ci)) {
             BLT_TABLE_VALUE value;
 
+            if (!first) {
+                Blt_DBuffer_AppendByte(dbuffer, '\t');
+            }
+            first = FALSE;
             value = blt_table_get_value(table, row, col);
             if (value == NULL) {
-                values[count] = NULL;
-                lengths[count] = 0;
+                Blt_DBuffer_AppendData(dbuffer, (const unsigned char *)"\\N",
+                                       2);
             } else {
-                values[count] = (char *)blt_table_value_string(value);
-                lengths[count] = blt_table_value_length(value);
+                PsqlAppendCopyValue(dbuffer, blt_table_value_string(value),
+                        blt_table_value_length(value));
             }
-            count++;
         }
-        result = PQexecPrepared(conn, stmtName, numParams, values, lengths,
-                formats, 0);
-        if (result == NULL) {
-            Tcl_AppendResult(interp, "error in parameters \": ", 
-                PQerrorMessage(conn), (char *)NULL);
-            goto error;
+        Blt_DBuffer_AppendByte(dbuffer, '\n');
+        if (Blt_DBuffer_Length(dbuffer) >= PSQL_COPY_BUFSIZE) {
+            if (PQputCopyData(conn, (const char *)Blt_DBuffer_Bytes(dbuffer),
+                        Blt_DBuffer_Length(dbuffer)) != 1) {
+                goto error;
+            }
+            Blt_DBuffer_SetLength(dbuffer, 0);
         }
-        if (PQresultStatus(result) != PGRES_COMMAND_OK) {
-            Tcl_AppendResult(interp, "error in parameters \": ", 
-                PQresultErrorMessage(result), (char *)NULL);
-            goto error;
+    }
+    if ((Blt_DBuffer_Length(dbuffer) > 0) &&
+        (PQputCopyData(conn, (const char *)Blt_DBuffer_Bytes(dbuffer),
+                       Blt_DBuffer_Length(dbuffer)) != 1)) {
+        goto error;
+    }
+    Blt_DBuffer_Destroy(dbuffer);
+    dbuffer = NULL;
+    if (PQputCopyEnd(conn, NULL) != 1) {
+        goto error;
+    }
+    /* Collect the status of the copy. */
+    status = TCL_OK;
+    while ((result = PQgetResult(conn)) != NULL) {
+        if ((status == TCL_OK) &&
+            (PQresultStatus(result) != PGRES_COMMAND_OK)) {
+            Tcl_AppendResult(interp, "error copying values into \"",
+                argsPtr->tableName, "\": ", PQresultErrorMessage(result),
+                (char *)NULL);
+            status = TCL_ERROR;
         }
         PQclear(result);
     }
-    Blt_Free(formats);
-    Blt_Free(values);
-    Blt_Free(lengths);
-    return TCL_OK;
+    return status;
  error:
-    if (formats != NULL) {
-        Blt_Free(formats);
-     }
-    if (values != NULL) {
-        Blt_Free(values);
+    Tcl_AppendResult(interp, "error copying values into \"",
+        argsPtr->tableName, "\": ", PQerrorMessage(conn), (char *)NULL);
+    if (dbuffer != NULL) {
+        Blt_DBuffer_Destroy(dbuffer);
     }
-    if (lengths != NULL) {
-        Blt_Free(lengths);
+    while ((result = PQgetResult(conn)) != NULL) {
+        PQclear(result);
     }
     return TCL_ERROR;
 }
@@ -803,7 +1043,6 @@ ImportPsqlProc(BLT_TABLE table, Tcl_Interp *interp, int objc,
 {
     ImportArgs args;
     PGconn *conn;
-    PGresult *resultset;
     int result;
     
     memset(&args, 0, sizeof(args));
@@ -817,39 +1056,21 @@ ImportPsqlProc(BLT_TABLE table, Tcl_Interp *interp, int objc,
         return TCL_ERROR;
     }
     conn = NULL;
-    resultset = NULL;
     result = PsqlConnect(interp, &args.params, &conn);
     if (result == TCL_OK) {
-        result = PsqlQuery(interp, conn, args.query, &resultset);
-        if ((result == TCL_OK) &&
-            (PQresultStatus(resultset) != PGRES_TUPLES_OK)) {
-            Tcl_AppendResult(interp, "error in query \"", args.query,
-                "\": ", PQresultErrorMessage(resultset), (char *)NULL);
-            PQclear(resultset);
-            result = TCL_ERROR;
-        }
-    }
-    if (result == TCL_OK) {
-        long numCols;
+        size_t numCols;
         BLT_TABLE_COLUMN *cols;
 
-        numCols = PQnfields(resultset);
-        cols = Blt_AssertMalloc(numCols * sizeof(BLT_TABLE_COLUMN));
-        result = blt_table_extend_columns(interp, table, numCols, cols);
-        if (result == TCL_OK) {
-            result = PsqlImportLabels(interp, table, resultset, numCols, cols);
-        }
-        if (result == TCL_OK) {
-            result = PsqlImportValues(interp, table, resultset, numCols, cols);
-        }
+        cols = NULL;
+        result = PsqlImportRows(interp, table, conn, args.query, &numCols,
+                &cols);
         if ((result == TCL_OK) && (args.table != NULL)) {
             result = PsqlImportColumnTypes(interp, table, conn, numCols, cols,
                 args.table);
         }
-        Blt_Free(cols);
-    }
-    if (resultset != NULL) {
-        PQclear(resultset);
+        if (cols != NULL) {
+            Blt_Free(cols);
+        }
     }
     if (conn != NULL) {
         PQfinish(conn);
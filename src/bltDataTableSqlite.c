@@ -46,6 +46,10 @@
   #include <memory.h>
 #endif /* HAVE_MEMORY_H */
 
+#ifdef HAVE_CTYPE_H
+  #include <ctype.h>
+#endif /* HAVE_CTYPE_H */
+
 #include <tcl.h>
 #include <bltDataTable.h>
 #include <bltAlloc.h>
@@ -70,14 +74,22 @@ DLLEXPORT extern Tcl_AppInitProc blt_table_sqlite_safe_init;
 typedef struct {
     Tcl_Obj *fileObjPtr;                /* File to read. */
     Tcl_Obj *queryObjPtr;               /* If non-NULL, query to make. */
+    unsigned int flags;
 } ImportArgs;
 
+#define IMPORT_TYPED            (1<<0)  /* Set the column types from the
+                                         * declared types of the query
+                                         * result and count the rows
+                                         * before importing them. */
+
 static Blt_SwitchSpec importSwitches[] = 
 {
     {BLT_SWITCH_OBJ, "-file",  "fileName", (char *)NULL,
         Blt_Offset(ImportArgs, fileObjPtr), 0, 0},
     {BLT_SWITCH_OBJ, "-query", "string", (char *)NULL,
         Blt_Offset(ImportArgs, queryObjPtr), 0, 0},
+    {BLT_SWITCH_BITS_NOARG, "-typed", "", (char *)NULL,
+        Blt_Offset(ImportArgs, flags), 0, IMPORT_TYPED},
     {BLT_SWITCH_END}
 };
 
@@ -90,6 +102,9 @@ typedef struct {
     Tcl_Obj *fileObjPtr;
     Tcl_Obj *tableObjPtr;
     const char *tableName;
+    long batchSize;                     /* # of rows inserted in each
+                                         * transaction.  If 0, all the rows
+                                         * are inserted in one. */
 } ExportArgs;
 
 #define EXPORT_ROWLABELS        (1<<0)
@@ -107,6 +122,8 @@ static Blt_SwitchCustom rowIterSwitch = {
 
 static Blt_SwitchSpec exportSwitches[] = 
 {
+    {BLT_SWITCH_LONG_NNEG, "-batchsize", "numRows", (char *)NULL,
+        Blt_Offset(ExportArgs, batchSize), 0, 0},
     {BLT_SWITCH_CUSTOM, "-columns",   "columns" ,(char *)NULL,
         Blt_Offset(ExportArgs, ci),   0, 0, &columnIterSwitch},
     {BLT_SWITCH_OBJ, "-file", "fileName", (char *)NULL,
@@ -255,6 +272,47 @@ SqliteTypeToColumnType(int type)
     }
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SqliteDeclTypeToColumnType --
+ *
+ *      Returns the column type for the declared type of a result column.
+ *      The declared type is matched using the same rules that SQLite uses
+ *      to determine the column's affinity.
+ *
+ *---------------------------------------------------------------------------
+ */
+static BLT_TABLE_COLUMN_TYPE
+SqliteDeclTypeToColumnType(const char *declType) 
+{
+    char buffer[200];
+    size_t i;
+
+    if (declType == NULL) {
+        return TABLE_COLUMN_TYPE_STRING; /* Expression, not a column. */
+    }
+    for (i = 0; (declType[i] != '\0') && (i < (sizeof(buffer) - 1)); i++) {
+        buffer[i] = toupper(UCHAR(declType[i]));
+    }
+    buffer[i] = '\0';
+    if (strstr(buffer, "INT") != NULL) {
+        return TABLE_COLUMN_TYPE_LONG;
+    }
+    if ((strstr(buffer, "CHAR") != NULL) || (strstr(buffer, "CLOB") != NULL) ||
+        (strstr(buffer, "TEXT") != NULL)) {
+        return TABLE_COLUMN_TYPE_STRING;
+    }
+    if ((buffer[0] == '\0') || (strstr(buffer, "BLOB") != NULL)) {
+        return TABLE_COLUMN_TYPE_BLOB;
+    }
+    if ((strstr(buffer, "REAL") != NULL) || (strstr(buffer, "FLOA") != NULL) ||
+        (strstr(buffer, "DOUB") != NULL)) {
+        return TABLE_COLUMN_TYPE_DOUBLE;
+    }
+    return TABLE_COLUMN_TYPE_STRING;
+}
+
 static int
 SqliteConnect(Tcl_Interp *interp, const char *fileName, sqlite3 **connPtr)
 {
@@ -276,9 +334,23 @@ SqliteDisconnect(sqlite3 *conn)
     sqlite3_close(conn);
 }
 
+static int
+SqliteExec(Tcl_Interp *interp, sqlite3 *conn, const char *statement)
+{
+    char *mesg;
+
+    if (sqlite3_exec(conn, statement, NULL, NULL, &mesg) != SQLITE_OK) {
+        Tcl_AppendResult(interp, "error in statement \"", statement, "\": ",
+                         mesg, (char *)NULL);
+        sqlite3_free(mesg);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
 static int
 SqliteImportLabel(Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col,
-                  sqlite3_stmt *stmt, int index)
+                  sqlite3_stmt *stmt, int index, int isTyped)
 {
     const char *label;
     int type;
@@ -287,8 +359,12 @@ SqliteImportLabel(Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col,
     if (blt_table_set_column_label(interp, table, col, label) != TCL_OK) { 
         return TCL_ERROR;
     }
-    type = sqlite3_column_type(stmt, index);
-    type = SqliteTypeToColumnType(type);
+    if (isTyped) {
+        type = SqliteDeclTypeToColumnType(sqlite3_column_decltype(stmt, index));
+    } else {
+        type = sqlite3_column_type(stmt, index);
+        type = SqliteTypeToColumnType(type);
+    }
     if (blt_table_set_column_type(interp, table, col, type) != TCL_OK) {
         return TCL_ERROR;
     }
@@ -358,18 +434,66 @@ SqliteImportRow(Tcl_Interp *interp, BLT_TABLE table, sqlite3_stmt *stmt,
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SqliteCountRows --
+ *
+ *      Counts the rows returned by the query, so that the table can be
+ *      extended once before the rows are imported.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+SqliteCountRows(Tcl_Interp *interp, sqlite3 *conn, const char *query, 
+                int length, long *countPtr)
+{
+    Blt_DBuffer dbuffer;
+    sqlite3_stmt *stmt;
+    int result;
+
+    /* Trailing semicolons can't be in a sub-query. */
+    while ((length > 0) && ((query[length - 1] == ';') ||
+                            (isspace(UCHAR(query[length - 1]))))) {
+        length--;
+    }
+    dbuffer = Blt_DBuffer_Create();
+    Blt_DBuffer_Format(dbuffer, "SELECT COUNT(*) FROM (%.*s)", length, query);
+    stmt = NULL;
+    result = sqlite3_prepare_v2(conn, Blt_DBuffer_String(dbuffer),
+                Blt_DBuffer_Length(dbuffer), &stmt, NULL);
+    if ((result == SQLITE_OK) && (stmt != NULL)) {
+        result = sqlite3_step(stmt);
+    }
+    if (result != SQLITE_ROW) {
+        Tcl_AppendResult(interp, "can't count rows of query \"", query, 
+                "\": ", sqlite3_errmsg(conn), (char *)NULL);
+        Blt_DBuffer_Destroy(dbuffer);
+        if (stmt != NULL) {
+            sqlite3_finalize(stmt);
+        }
+        return TCL_ERROR;
+    }
+    *countPtr = (long)sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    Blt_DBuffer_Destroy(dbuffer);
+    return TCL_OK;
+}
+
 static int
 SqliteImport(Tcl_Interp *interp, BLT_TABLE table, sqlite3 *conn, 
              ImportArgs *argsPtr) 
 {
     BLT_TABLE_COLUMN *cols;
     const char *query, *left;
-    int initialized, length, result;
+    int initialized, isTyped, length, result;
     long numColumns, count;
     sqlite3_stmt *stmt;
     
 
     stmt = NULL;
+    cols = NULL;
+    isTyped = (argsPtr->flags & IMPORT_TYPED);
     query = Tcl_GetStringFromObj(argsPtr->queryObjPtr, &length);
     if (sqlite3_prepare_v2(conn, query, length, &stmt, &left) != SQLITE_OK) {
         Tcl_AppendResult(interp, "error in query \"", query, "\": ", 
@@ -384,7 +508,7 @@ SqliteImport(Tcl_Interp *interp, BLT_TABLE table, sqlite3 *conn,
     if ((left != NULL) && (left[0] != '\0')) {
         Tcl_AppendResult(interp, "extra statements follow query \"", left,
                          "\": ", sqlite3_errmsg(conn), (char *)NULL);
-        return TCL_ERROR;
+        goto error;
     }
     numColumns = sqlite3_column_count(stmt);
     cols = Blt_Malloc(sizeof(BLT_TABLE_COLUMN) * numColumns);
@@ -397,6 +521,28 @@ SqliteImport(Tcl_Interp *interp, BLT_TABLE table, sqlite3 *conn,
         goto error;                     /* Can't create new columns. */
     }
     initialized = FALSE;
+    if (isTyped) {
+        long numRows;
+        int i;
+
+        /* The declared types are known before the first step.  Add all
+         * the rows needed at once rather than one at a time. */
+        for (i = 0; i < numColumns; i++) {
+            if (SqliteImportLabel(interp, table, cols[i], stmt, i, TRUE)
+                != TCL_OK) {
+                goto error;
+            }
+        }
+        initialized = TRUE;
+        if (SqliteCountRows(interp, conn, query, length, &numRows) != TCL_OK) {
+            goto error;
+        }
+        if ((numRows > blt_table_num_rows(table)) &&
+            (blt_table_extend_rows(interp, table, 
+                numRows - blt_table_num_rows(table), NULL) != TCL_OK)) {
+            goto error;
+        }
+    }
     result = SQLITE_OK;
     count = 0;
     do {
@@ -407,8 +553,8 @@ SqliteImport(Tcl_Interp *interp, BLT_TABLE table, sqlite3 *conn,
             if (!initialized) {
                 /* After the first step, step the column labels and type.  */
                 for (i = 0; i < numColumns; i++) {
-                    if (SqliteImportLabel(interp, table, cols[i], stmt, i)
-                        != TCL_OK) {
+                    if (SqliteImportLabel(interp, table, cols[i], stmt, i,
+                                          FALSE) != TCL_OK) {
                         goto error;
                     }
                 }
@@ -418,6 +564,7 @@ SqliteImport(Tcl_Interp *interp, BLT_TABLE table, sqlite3 *conn,
                 != TCL_OK) {
                 goto error;
             }
+            count++;
         } else if (result != SQLITE_DONE) {
             Tcl_AppendResult(interp, "step failed \": ", 
                              sqlite3_errmsg(conn), (char *)NULL);
@@ -443,11 +590,8 @@ SqliteCreateTable(Tcl_Interp *interp, sqlite3 *conn, BLT_TABLE table,
 {
     BLT_TABLE_COLUMN col;
     Blt_DBuffer dbuffer;
-    const char *query;
     int first;
-    int length;
     int result;
-    sqlite3_stmt *stmt;
     
     dbuffer = Blt_DBuffer_Create();
     Blt_DBuffer_Format(dbuffer, "DROP TABLE IF EXISTS %s; CREATE TABLE %s (",
@@ -470,6 +614,7 @@ SqliteCreateTable(Tcl_Interp *interp, sqlite3 *conn, BLT_TABLE table,
         switch(type) {
         case TABLE_COLUMN_TYPE_BOOLEAN:
         case TABLE_COLUMN_TYPE_LONG:
+        case TABLE_COLUMN_TYPE_INT64:
             Blt_DBuffer_Format(dbuffer, "INTEGER");     break;
         case TABLE_COLUMN_TYPE_DOUBLE:
             Blt_DBuffer_Format(dbuffer, "REAL");        break;
@@ -483,30 +628,112 @@ SqliteCreateTable(Tcl_Interp *interp, sqlite3 *conn, BLT_TABLE table,
         first = FALSE;
     }
     Blt_DBuffer_Format(dbuffer, ");"); 
-    query = (const char *)Blt_DBuffer_String(dbuffer);
-    length = Blt_DBuffer_Length(dbuffer);
-    result = sqlite3_prepare_v2(conn, query, length, &stmt, NULL);
-    if (result != SQLITE_OK) {
-        Tcl_AppendResult(interp, "error in table create \"", query, "\": ", 
-                         sqlite3_errmsg(conn), (char *)NULL);
-    }
+    /* Both statements are executed. */
+    result = SqliteExec(interp, conn, Blt_DBuffer_String(dbuffer));
     Blt_DBuffer_Destroy(dbuffer);
-    if (result != SQLITE_OK) {
-        goto error;
+    return result;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SqliteBindRow --
+ *
+ *      Binds the values of the row to the parameters of the INSERT
+ *      statement.  Numeric values are bound in their native type, taken
+ *      directly from the column storage.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+SqliteBindRow(Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_ROW row,
+              sqlite3_stmt *stmt, ExportArgs *argsPtr)
+{
+    BLT_TABLE_COLUMN col;
+    int count;                          /* sqlite3 parameter index. */
+        
+    count = 1;                          /* sqlite3 parameter indices start
+                                         * from 1. */
+    if (argsPtr->flags & EXPORT_ROWLABELS) {
+        const char *label;
+                    
+        label = blt_table_row_label(row);
+        sqlite3_bind_text(stmt, count, label, -1, SQLITE_STATIC);
+        count++;
     }
-    do {
-        result = sqlite3_step(stmt);
-    } while (result == SQLITE_OK);
-    sqlite3_finalize(stmt);
-    assert(result == SQLITE_DONE);
-    return TCL_OK;
- error:
-    if (stmt != NULL) {
-        sqlite3_finalize(stmt);
+    for (col = blt_table_first_tagged_column(&argsPtr->ci); col != NULL;
+         col = blt_table_next_tagged_column(&argsPtr->ci)) {
+        if (!blt_table_value_exists(table, row, col)) {
+            sqlite3_bind_null(stmt, count);
+        } else {
+            int type;
+            
+            type = blt_table_column_type(col);
+            switch(type) {
+            case TABLE_COLUMN_TYPE_LONG:
+            case TABLE_COLUMN_TYPE_BOOLEAN:
+                {
+                    long lval;
+                        
+                    lval = blt_table_get_long(interp, table, row, col, 0);
+                    sqlite3_bind_int64(stmt, count, lval);
+                }
+                break;
+            case TABLE_COLUMN_TYPE_INT64:
+                {
+                    int64_t i64;
+
+                    i64 = blt_table_get_int64(interp, table, row, col, 0);
+                    sqlite3_bind_int64(stmt, count, i64);
+                }
+                break;
+            case TABLE_COLUMN_TYPE_DOUBLE:
+                {
+                    double dval;
+                        
+                    dval = blt_table_get_double(interp, table, row, col);
+                    sqlite3_bind_double(stmt, count, dval);
+                }
+                break;
+            case TABLE_COLUMN_TYPE_BLOB:
+                {
+                    BLT_TABLE_VALUE value;
+
+                    value = blt_table_get_value(table, row, col);
+                    sqlite3_bind_blob(stmt, count, 
+                        blt_table_value_bytes(value),
+                        blt_table_value_length(value), SQLITE_STATIC);
+                }
+                break;
+            default:
+            case TABLE_COLUMN_TYPE_STRING:
+                {
+                    const char *sval;
+                        
+                    sval = blt_table_get_string(table, row, col);
+                    sqlite3_bind_text(stmt, count, sval, -1, SQLITE_STATIC);
+                }
+                break;
+            }
+        }
+        count++;
     }
-    return TCL_ERROR;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SqliteExportValues --
+ *
+ *      Inserts the rows into the SQLite table.  The same INSERT statement
+ *      is reused for every row.  The rows are inserted in transactions of
+ *      -batchsize rows, so that SQLite doesn't commit (and sync the
+ *      database file) after every row.  The first transaction must
+ *      already have been started by the caller.  If an insert fails, the
+ *      caller rolls back the current transaction.
+ *
+ *---------------------------------------------------------------------------
+ */
 static int
 SqliteExportValues(Tcl_Interp *interp, sqlite3 *conn, BLT_TABLE table,
                    ExportArgs *argsPtr)
@@ -517,8 +744,11 @@ SqliteExportValues(Tcl_Interp *interp, sqlite3 *conn, BLT_TABLE table,
     const char *query;
     int length, result;
     int count;                          /* sqlite3 parameter index. */
+    long numRows;                       /* # of rows in the current
+                                         * transaction. */
     sqlite3_stmt *stmt;
     
+    stmt = NULL;
     dbuffer = Blt_DBuffer_Create();
     dbuffer2 = Blt_DBuffer_Create();
     Blt_DBuffer_Format(dbuffer, "INSERT INTO %s (", argsPtr->tableName);
@@ -526,7 +756,7 @@ SqliteExportValues(Tcl_Interp *interp, sqlite3 *conn, BLT_TABLE table,
     count = 1;                          /* sqlite3 parameter indices start
                                          * from 1. */
     if (argsPtr->flags & EXPORT_ROWLABELS) {
-        Blt_DBuffer_Format(dbuffer, "_rowId TEXT ");
+        Blt_DBuffer_Format(dbuffer, "_rowId");
         Blt_DBuffer_Format(dbuffer2, "?%d", count);
         count++;
     }        
@@ -564,62 +794,29 @@ SqliteExportValues(Tcl_Interp *interp, sqlite3 *conn, BLT_TABLE table,
         goto error;
     }
     Blt_DBuffer_Destroy(dbuffer);
+    numRows = 0;
     for (row = blt_table_first_tagged_row(&argsPtr->ri); row != NULL; 
          row = blt_table_next_tagged_row(&argsPtr->ri)) {
-        int count;                      /* sqlite3 result set index. */
-        
-        count = 1;                      /* sqlite3 parameter indices start
-                                         * from 1. */
-        if (argsPtr->flags & EXPORT_ROWLABELS) {
-            const char *label;
-                    
-            label = blt_table_row_label(row);
-            sqlite3_bind_text(stmt, count, label, -1, NULL);
-            count++;
-        }
-        for (col = blt_table_first_tagged_column(&argsPtr->ci); col != NULL;
-             col = blt_table_next_tagged_column(&argsPtr->ci)) {
-            if (!blt_table_value_exists(table, row, col)) {
-                sqlite3_bind_null(stmt, count);
-            } else {
-                int type;
-            
-                type = blt_table_column_type(col);
-                switch(type) {
-                case TABLE_COLUMN_TYPE_LONG:
-                case TABLE_COLUMN_TYPE_BOOLEAN:
-                    {
-                        long lval;
-                        
-                        lval = blt_table_get_long(interp, table, row, col, 0);
-                        sqlite3_bind_int64(stmt, count, lval);
-                    }
-                    break;
-                case TABLE_COLUMN_TYPE_DOUBLE:
-                    {
-                        double dval;
-                        
-                        dval = blt_table_get_double(interp, table, row, col);
-                        sqlite3_bind_double(stmt, count, dval);
-                    }
-                    break;
-                default:
-                case TABLE_COLUMN_TYPE_STRING:
-                    {
-                        const char *sval;
-                        
-                        sval = blt_table_get_string(table, row, col);
-                        sqlite3_bind_text(stmt, count, sval, -1, NULL);
-                    }
-                    break;
-                }
+        if ((argsPtr->batchSize > 0) && (numRows == argsPtr->batchSize)) {
+            if ((SqliteExec(interp, conn, "COMMIT;") != TCL_OK) ||
+                (SqliteExec(interp, conn, "BEGIN TRANSACTION;") != TCL_OK)) {
+                goto error;
             }
-            count++;
+            numRows = 0;
+        }
+        SqliteBindRow(interp, table, row, stmt, argsPtr);
+        result = sqlite3_step(stmt);
+        if (result != SQLITE_DONE) {
+            Tcl_AppendResult(interp, "can't insert row \"", 
+                blt_table_row_label(row), "\": ", sqlite3_errmsg(conn), 
+                (char *)NULL);
+            goto error;
         }
-        do {
-            result = sqlite3_step(stmt);
-        } while (result == SQLITE_OK);
         sqlite3_reset(stmt);
+        numRows++;
+    }
+    if (SqliteExec(interp, conn, "COMMIT;") != TCL_OK) {
+        goto error;
     }
     sqlite3_finalize(stmt);
     return TCL_OK;
@@ -698,10 +895,19 @@ ExportSqliteProc(BLT_TABLE table, Tcl_Interp *interp, int objc,
     fileName = Tcl_GetString(args.fileObjPtr);
     result = SqliteConnect(interp, fileName, &conn);
     if (result == TCL_OK) {
-        result = SqliteCreateTable(interp, conn, table, &args);
-    }
-    if (result == TCL_OK) {
-        result = SqliteExportValues(interp, conn, table, &args);
+        /* Replace the table in the same transaction as the first rows, so
+         * that the old table is kept if the export fails before the first
+         * commit. */
+        result = SqliteExec(interp, conn, "BEGIN TRANSACTION;");
+        if (result == TCL_OK) {
+            result = SqliteCreateTable(interp, conn, table, &args);
+            if (result == TCL_OK) {
+                result = SqliteExportValues(interp, conn, table, &args);
+            }
+            if (result != TCL_OK) {
+                sqlite3_exec(conn, "ROLLBACK;", NULL, NULL, NULL);
+            }
+        }
     }
     SqliteDisconnect(conn);
     Blt_FreeSwitches(exportSwitches, &args, 0);
@@ -87,8 +87,24 @@ typedef struct {
     const char *comment;                /* Comment character. */
     int maxRows;                        /* Stop processing after this many
                                          * rows have been found. */
+    long sampleSize;                    /* If non-zero, infer the types of
+                                         * new columns from this many
+                                         * values.  INFER_ALL means from
+                                         * all the values. */
+    BLT_TABLE_TYPE_GUESS *guesses;      /* Type guesses for the columns,
+                                         * by column index. */
+    long numGuesses;                    /* # of guesses allocated. */
+    long firstNewColumn;                /* Index of the first column
+                                         * created by the import. */
 } ImportSwitches;
 
+#define INFER_ALL               (-1)
+
+static Blt_SwitchParseProc InferTypesSwitchProc;
+static Blt_SwitchCustom inferTypesSwitch = {
+    InferTypesSwitchProc, NULL, NULL, 0,
+};
+
 static Blt_SwitchSpec importSwitches[] = 
 {
     {BLT_SWITCH_STRING, "-comment",     "char", (char *)NULL,
@@ -97,6 +113,8 @@ static Blt_SwitchSpec importSwitches[] =
         Blt_Offset(ImportSwitches, dataObjPtr), 0, 0, NULL},
     {BLT_SWITCH_OBJ,    "-file",      "fileName", (char *)NULL,
         Blt_Offset(ImportSwitches, fileObjPtr), 0},
+    {BLT_SWITCH_CUSTOM, "-infertypes", "numRows|all", (char *)NULL,
+        Blt_Offset(ImportSwitches, sampleSize), 0, 0, &inferTypesSwitch},
     {BLT_SWITCH_INT_NNEG, "-maxrows", "integer", (char *)NULL,
         Blt_Offset(ImportSwitches, maxRows), 0},
     {BLT_SWITCH_STRING, "-quote",     "char", (char *)NULL,
@@ -279,6 +297,43 @@ RowIterSwitchProc(
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * InferTypesSwitchProc --
+ *
+ *      Converts the number of values to sample when inferring column
+ *      types.  "all" means to examine all the values.
+ *
+ * Results:
+ *      The return value is a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+InferTypesSwitchProc(ClientData clientData, Tcl_Interp *interp,
+                     const char *switchName, Tcl_Obj *objPtr, char *record,
+                     int offset, int flags)
+{
+    long *sampleSizePtr = (long *)(record + offset);
+    const char *string;
+    long count;
+
+    string = Tcl_GetString(objPtr);
+    if (strcmp(string, "all") == 0) {
+        *sampleSizePtr = INFER_ALL;
+        return TCL_OK;
+    }
+    if (Blt_GetCountFromObj(NULL, objPtr, COUNT_NNEG, &count) != TCL_OK) {
+        Tcl_AppendResult(interp, "bad value \"", string, 
+                "\": should be a number of values or \"all\"", (char *)NULL);
+        return TCL_ERROR;
+    }
+    *sampleSizePtr = count;
+    return TCL_OK;
+}
+
 static void
 StartRecord(ExportSwitches *exportPtr)
 {
@@ -558,6 +613,75 @@ ImportGetLine(Tcl_Interp *interp, ImportSwitches *importPtr, char **bufferPtr,
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * NewColumn --
+ *
+ *      Creates a new column for the import.  If column types are being
+ *      inferred, the guess of the column's type is started.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+NewColumn(Tcl_Interp *interp, BLT_TABLE table, ImportSwitches *importPtr,
+          BLT_TABLE_COLUMN *colPtr)
+{
+    long index;
+
+    if (blt_table_extend_columns(interp, table, 1, colPtr) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (importPtr->sampleSize == 0) {
+        return TCL_OK;
+    }
+    index = blt_table_column_index(table, *colPtr);
+    if (index >= importPtr->numGuesses) {
+        long i, numGuesses;
+
+        numGuesses = MAX(index + 1, importPtr->numGuesses * 2);
+        importPtr->guesses = Blt_AssertRealloc(importPtr->guesses, 
+                numGuesses * sizeof(BLT_TABLE_TYPE_GUESS));
+        for (i = importPtr->numGuesses; i < numGuesses; i++) {
+            blt_table_init_type_guess(importPtr->guesses + i, NULL,
+                (importPtr->sampleSize == INFER_ALL) ? 0 : 
+                importPtr->sampleSize);
+        }
+        importPtr->numGuesses = numGuesses;
+    }
+    importPtr->guesses[index].column = *colPtr;
+    return TCL_OK;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SetValue --
+ *
+ *      Sets the cell from the field.  If the column's type is being
+ *      inferred, the field is also used to guess its type.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+SetValue(Tcl_Interp *interp, BLT_TABLE table, ImportSwitches *importPtr,
+         BLT_TABLE_ROW row, BLT_TABLE_COLUMN col, long index, 
+         const char *field, int length)
+{
+    if ((index < importPtr->numGuesses) && 
+        (importPtr->guesses[index].column == col)) {
+        return blt_table_set_guessed_value(interp, table, row, 
+                importPtr->guesses + index, field, length);
+    }
+    return blt_table_set_string_rep(interp, table, row, col, field, length);
+}
+
 static int
 Import(Tcl_Interp *interp, BLT_TABLE table, ImportSwitches *importPtr)
 {
@@ -577,6 +701,7 @@ Import(Tcl_Interp *interp, BLT_TABLE table, ImportSwitches *importPtr)
     row = NULL;
     i = 0;
     state = STATE_SEPARATOR;
+    importPtr->firstNewColumn = blt_table_num_columns(table);
     Tcl_DStringInit(&ds);
     fieldSize = 128;
     Tcl_DStringSetLength(&ds, fieldSize + 1);
@@ -626,18 +751,18 @@ Import(Tcl_Interp *interp, BLT_TABLE table, ImportSwitches *importPtr)
                             }
                         } 
                         if (i >= blt_table_num_columns(table)) {
-                            if (blt_table_extend_columns(interp, table, 1, &col) 
+                            if (NewColumn(interp, table, importPtr, &col) 
                                 != TCL_OK) {
                                 goto error;
                             }
                         } else {
                             col = blt_table_column(table, i);
                         }
-                        i++;
-                        if (blt_table_set_string_rep(interp, table, row, col,
-                                field, fp - field) != TCL_OK) {
+                        if (SetValue(interp, table, importPtr, row, col, i,
+                                field, fp - field - 1) != TCL_OK) {
                             goto error;
                         }
+                        i++;
                     }
                     /* Transition from value to newline. */
                     if (*bp == '\n') {
@@ -692,12 +817,11 @@ Import(Tcl_Interp *interp, BLT_TABLE table, ImportSwitches *importPtr)
                 }
                 col = blt_table_get_column_by_index(table, i);
                 if (col == NULL) {
-                    if (blt_table_extend_columns(interp, table, 1, &col) 
-                        != TCL_OK) {
+                    if (NewColumn(interp, table, importPtr, &col) != TCL_OK) {
                         goto error;
                     }
                 }                       
-                if (blt_table_set_string_rep(interp, table, row, col, field,
+                if (SetValue(interp, table, importPtr, row, col, i, field,
                         fp - field) != TCL_OK) {
                     goto error;
                 }
@@ -711,6 +835,37 @@ Import(Tcl_Interp *interp, BLT_TABLE table, ImportSwitches *importPtr)
     return result;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FinishGuesses --
+ *
+ *      Sets the types of the new columns not yet typed, and returns the
+ *      labels and types of the new columns as the interpreter result.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+FinishGuesses(Tcl_Interp *interp, BLT_TABLE table, ImportSwitches *importPtr)
+{
+    Tcl_Obj *listObjPtr;
+    long i;
+
+    listObjPtr = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+    for (i = importPtr->firstNewColumn; i < importPtr->numGuesses; i++) {
+        if (blt_table_finish_type_guess(interp, table, importPtr->guesses + i,
+                listObjPtr) != TCL_OK) {
+            Tcl_DecrRefCount(listObjPtr);
+            return TCL_ERROR;
+        }
+    }
+    Tcl_SetObjResult(interp, listObjPtr);
+    return TCL_OK;
+}
+
 static int
 ImportProc(BLT_TABLE table, Tcl_Interp *interp, int objc, Tcl_Obj *const *objv)
 {
@@ -779,7 +934,13 @@ ImportProc(BLT_TABLE table, Tcl_Interp *interp, int objc, Tcl_Obj *const *objv)
             Tcl_Close(interp, channel);
         }
     }
+    if ((result == TCL_OK) && (switches.sampleSize != 0)) {
+        result = FinishGuesses(interp, table, &switches);
+    }
  error:
+    if (switches.guesses != NULL) {
+        Blt_Free(switches.guesses);
+    }
     Blt_FreeSwitches(importSwitches, (char *)&switches, 0);
     Blt_DeleteHashTable(&switches.dataTable);
     return result;
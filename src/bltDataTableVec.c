@@ -41,6 +41,10 @@
 #include <assert.h>
 #include <tcl.h>
 
+#ifdef HAVE_STRING_H
+  #include <string.h>
+#endif /* HAVE_STRING_H */
+
 DLLEXPORT extern Tcl_AppInitProc blt_table_vector_init;
 DLLEXPORT extern Tcl_AppInitProc blt_table_vector_safe_init;
 
@@ -53,26 +57,184 @@ DLLEXPORT extern Tcl_AppInitProc blt_table_vector_safe_init;
  * sql          data            data
  *
  * $table import vector $vecName label $vecName label...
- * $table export vector label $vecName label $vecName...
+ * $table export vector $vecName label $vecName label...
  */
 
 static BLT_TABLE_IMPORT_PROC ImportVectorProc;
 static BLT_TABLE_EXPORT_PROC ExportVectorProc;
 
+typedef struct {
+    unsigned int flags;
+} ExportSwitches;
+
+#define EXPORT_ALIAS    (1<<0)
+
+static Blt_SwitchSpec exportSwitches[] = 
+{
+    {BLT_SWITCH_BITS_NOARG, "-alias", "", (char *)NULL,
+        Blt_Offset(ExportSwitches, flags), 0, EXPORT_ALIAS},
+    {BLT_SWITCH_END}
+};
+
+/*
+ * VectorAlias --
+ *
+ *      Vector exported with the -alias switch.  The vector uses the
+ *      array of the column directly.  Changes to the column are seen
+ *      immediately by the vector.  Changes made to the vector are written
+ *      back to the column when the vector notifies its clients.
+ */
+typedef struct {
+    BLT_TABLE table;
+    BLT_TABLE_VIEW view;                /* View of the column's array. */
+    Blt_VectorId clientId;              /* Vector's client token. */
+    Blt_Vector *vector;
+    double *array;                      /* Last array given to the
+                                         * vector. */
+    int dirty;                          /* Vector's change count when the
+                                         * array was given. */
+    int isUpdating;                     /* Indicates the alias is resetting
+                                         * the vector. */
+} VectorAlias;
+
+static void
+DestroyVectorAlias(VectorAlias *aliasPtr)
+{
+    Blt_SetVectorChangedProc(aliasPtr->clientId, NULL, NULL);
+    Blt_FreeVectorId(aliasPtr->clientId);
+    Blt_Free(aliasPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ColumnViewProc --
+ *
+ *      Called by the table when the array of the column is moved or its
+ *      values changed.  The vector is reset to the new array.  If the view
+ *      is deleted (the column is deleted or changes type), the vector
+ *      keeps a copy of the last values.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+ColumnViewProc(ClientData clientData, double *array, long numValues, 
+               unsigned int flags)
+{
+    VectorAlias *aliasPtr = clientData;
+
+    aliasPtr->isUpdating = TRUE;
+    if (flags & TABLE_VIEW_DELETED) {
+        double *copy;
+
+        copy = NULL;
+        if ((array != NULL) && (numValues > 0)) {
+            copy = Blt_AssertMalloc(numValues * sizeof(double));
+            memcpy(copy, array, numValues * sizeof(double));
+        }
+        Blt_ResetVector(aliasPtr->vector, copy, numValues, numValues, 
+                        TCL_DYNAMIC);
+        DestroyVectorAlias(aliasPtr);
+        return;
+    }
+    Blt_ResetVector(aliasPtr->vector, array, numValues, numValues, 
+                    TCL_STATIC);
+    aliasPtr->array = Blt_VecData(aliasPtr->vector);
+    aliasPtr->dirty = Blt_VecDirty(aliasPtr->vector);
+    aliasPtr->isUpdating = FALSE;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * VectorChangedProc --
+ *
+ *      Called when the vector is changed or destroyed.  Values written
+ *      into the vector are synced back to the column.  If the vector has
+ *      moved its values to a new array (for example, it was resized), it
+ *      no longer aliases the column and the view is deleted.
+ *
+ *---------------------------------------------------------------------------
+ */
+static void
+VectorChangedProc(Tcl_Interp *interp, ClientData clientData, 
+                  Blt_VectorNotify notify)
+{
+    VectorAlias *aliasPtr = clientData;
+
+    if (notify == BLT_VECTOR_NOTIFY_DESTROY) {
+        blt_table_delete_view(aliasPtr->table, aliasPtr->view);
+        DestroyVectorAlias(aliasPtr);
+        return;
+    }
+    if ((aliasPtr->isUpdating) || 
+        (Blt_VecDirty(aliasPtr->vector) == aliasPtr->dirty)) {
+        return;                         /* Change came from the table. */
+    }
+    aliasPtr->dirty = Blt_VecDirty(aliasPtr->vector);
+    blt_table_sync_view(aliasPtr->table, aliasPtr->view);
+    if (Blt_VecData(aliasPtr->vector) != aliasPtr->array) {
+        /* The vector has its own copy of the values now. */
+        blt_table_delete_view(aliasPtr->table, aliasPtr->view);
+        DestroyVectorAlias(aliasPtr);
+    }
+}
+
+static int
+AliasVector(Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col, 
+            Tcl_Obj *objPtr)
+{
+    VectorAlias *aliasPtr;
+    Blt_VectorId clientId;
+    Blt_Vector *vector;
+
+    clientId = Blt_AllocVectorId(interp, Tcl_GetString(objPtr));
+    if (clientId == NULL) {
+        return TCL_ERROR;
+    }
+    if (Blt_GetVectorById(interp, clientId, &vector) != TCL_OK) {
+        Blt_FreeVectorId(clientId);
+        return TCL_ERROR;
+    }
+    aliasPtr = Blt_AssertCalloc(1, sizeof(VectorAlias));
+    aliasPtr->table = table;
+    aliasPtr->clientId = clientId;
+    aliasPtr->vector = vector;
+    aliasPtr->view = blt_table_create_view(interp, table, col, 
+        ColumnViewProc, aliasPtr);
+    if (aliasPtr->view == NULL) {
+        DestroyVectorAlias(aliasPtr);
+        return TCL_ERROR;
+    }
+    Blt_SetVectorChangedProc(clientId, VectorChangedProc, aliasPtr);
+    return TCL_OK;
+}
+
 /* 
- * $table export vector col vecName col vecName...
+ * $table export vector ?-alias? vecName col vecName col...
  */
 static int
 ExportVectorProc(BLT_TABLE table, Tcl_Interp *interp, int objc, 
               Tcl_Obj *const *objv)
 {
+    ExportSwitches switches;
+    const char *cmdName;
     int i;
     long numRows;
     
+    cmdName = Tcl_GetString(objv[0]);
+    switches.flags = 0;
+    i = Blt_ParseSwitches(interp, exportSwitches, objc - 3, objv + 3, 
+        &switches, BLT_SWITCH_OBJV_PARTIAL);
+    if (i < 0) {
+        return TCL_ERROR;
+    }
+    objc -= i, objv += i;
     if ((objc - 3) & 1) {
-        Tcl_AppendResult(interp, "odd # of column/vector pairs: should be \"", 
-                Tcl_GetString(objv[0]), 
-                " export vector col vecName ?col vecName?...", (char *)NULL);
+        Tcl_AppendResult(interp, "odd # of vector/column pairs: should be \"", 
+                cmdName, 
+                " export vector ?-alias? vecName col ?vecName col?...", 
+                (char *)NULL);
         return TCL_ERROR;
     }
     numRows = blt_table_num_rows(table);
@@ -88,6 +250,12 @@ ExportVectorProc(BLT_TABLE table, Tcl_Interp *interp, int objc,
         if (col == NULL) {
             return TCL_ERROR;
         }
+        if (switches.flags & EXPORT_ALIAS) {
+            if (AliasVector(interp, table, col, objv[i]) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            continue;
+        }
         if (Blt_GetVectorFromObj(interp, objv[i], &vector) != TCL_OK) {
             return TCL_ERROR;
         }
@@ -125,7 +293,7 @@ ExportVectorProc(BLT_TABLE table, Tcl_Interp *interp, int objc,
  *      operation.
  *
  *
- *      $table import vector col vecName col vecName...
+ *      $table import vector vecName col vecName col...
  *
  *---------------------------------------------------------------------------
  */
@@ -86,6 +86,10 @@ typedef struct {
     Tcl_Obj *dataObj;
     Tcl_Interp *interp;
     unsigned int flags;
+    long sampleSize;                    /* If non-zero, infer the types of
+                                         * new columns from this many
+                                         * values.  INFER_ALL means from
+                                         * all the values. */
 } ImportSwitches;
 
 #define IMPORT_ATTRIBUTES (1<<0)
@@ -93,12 +97,21 @@ typedef struct {
 #define IMPORT_CDATA      (1<<2)
 #define IMPORT_MASK       (IMPORT_ATTRIBUTES | IMPORT_CDATA | IMPORT_ELEMENTS)
 
+#define INFER_ALL         (-1)
+
+static Blt_SwitchParseProc InferTypesSwitchProc;
+static Blt_SwitchCustom inferTypesSwitch = {
+    InferTypesSwitchProc, NULL, NULL, 0,
+};
+
 static Blt_SwitchSpec importSwitches[] = 
 {
     {BLT_SWITCH_OBJ, "-data", "string", (char *)NULL,
          Blt_Offset(ImportSwitches, dataObj), 0, 0},
     {BLT_SWITCH_OBJ, "-file", "fileName", (char *)NULL,
         Blt_Offset(ImportSwitches, fileObj), 0, 0},
+    {BLT_SWITCH_CUSTOM, "-infertypes", "numRows|all", (char *)NULL,
+        Blt_Offset(ImportSwitches, sampleSize), 0, 0, &inferTypesSwitch},
     {BLT_SWITCH_INVERT_BITS_NOARG,"-noattrs", "", (char *)NULL,
         Blt_Offset(ImportSwitches, flags), 0, IMPORT_ATTRIBUTES},
     {BLT_SWITCH_INVERT_BITS_NOARG,"-noelems", "", (char *)NULL,
@@ -272,6 +285,43 @@ RowIterSwitchProc(
     return TCL_OK;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * InferTypesSwitchProc --
+ *
+ *      Converts the number of values to sample when inferring column
+ *      types.  "all" means to examine all the values.
+ *
+ * Results:
+ *      The return value is a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+/*ARGSUSED*/
+static int
+InferTypesSwitchProc(ClientData clientData, Tcl_Interp *interp,
+                     const char *switchName, Tcl_Obj *objPtr, char *record,
+                     int offset, int flags)
+{
+    long *sampleSizePtr = (long *)(record + offset);
+    const char *string;
+    long count;
+
+    string = Tcl_GetString(objPtr);
+    if (strcmp(string, "all") == 0) {
+        *sampleSizePtr = INFER_ALL;
+        return TCL_OK;
+    }
+    if (Blt_GetCountFromObj(NULL, objPtr, COUNT_NNEG, &count) != TCL_OK) {
+        Tcl_AppendResult(interp, "bad value \"", string, 
+                "\": should be a number of values or \"all\"", (char *)NULL);
+        return TCL_ERROR;
+    }
+    *sampleSizePtr = count;
+    return TCL_OK;
+}
+
 #ifdef HAVE_LIBEXPAT
 
 #include <expat.h>
@@ -287,6 +337,12 @@ typedef struct {
     Blt_HashTable stringTable;
     Blt_List elemList;
     Blt_ListNode node;
+    long sampleSize;                    /* If non-zero, # of values to
+                                         * infer new column types from. */
+    long firstNewColumn;                /* Index of the first column
+                                         * created by the import. */
+    Blt_HashTable guessTable;           /* Type guesses of the new
+                                         * columns, keyed by column. */
 } ImportData;
 
 static Tcl_Obj *
@@ -336,6 +392,128 @@ DumpStringTable(Blt_HashTable *tablePtr)
     Blt_DeleteHashTable(tablePtr);
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CreateXmlColumn --
+ *
+ *      Creates a new column for an element or attribute.  If column
+ *      types are being inferred, the guess of the column's type is
+ *      started.
+ *
+ * Results:
+ *      Returns the new column or NULL if an error occurred.
+ *
+ *---------------------------------------------------------------------------
+ */
+static BLT_TABLE_COLUMN
+CreateXmlColumn(ImportData *importPtr, const char *label)
+{
+    BLT_TABLE_COLUMN col;
+
+    col = blt_table_create_column(importPtr->interp, importPtr->table, label);
+    if ((col != NULL) && (importPtr->sampleSize != 0)) {
+        BLT_TABLE_TYPE_GUESS *guessPtr;
+        Blt_HashEntry *hPtr;
+        int isNew;
+
+        guessPtr = Blt_AssertMalloc(sizeof(BLT_TABLE_TYPE_GUESS));
+        blt_table_init_type_guess(guessPtr, col, 
+                (importPtr->sampleSize == INFER_ALL) ? 0 : 
+                importPtr->sampleSize);
+        hPtr = Blt_CreateHashEntry(&importPtr->guessTable, (char *)col, 
+                &isNew);
+        Blt_SetHashValue(hPtr, guessPtr);
+    }
+    return col;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * SetXmlValue --
+ *
+ *      Sets the cell of the current row.  If the column's type is being
+ *      inferred, the value is also used to guess its type.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+SetXmlValue(ImportData *importPtr, BLT_TABLE_COLUMN col, Tcl_Obj *objPtr)
+{
+    if (importPtr->sampleSize != 0) {
+        Blt_HashEntry *hPtr;
+
+        hPtr = Blt_FindHashEntry(&importPtr->guessTable, (char *)col);
+        if (hPtr != NULL) {
+            const char *string;
+            int length;
+
+            string = Tcl_GetStringFromObj(objPtr, &length);
+            return blt_table_set_guessed_value(importPtr->interp, 
+                importPtr->table, importPtr->row, Blt_GetHashValue(hPtr), 
+                string, length);
+        }
+    }
+    return blt_table_set_obj(importPtr->interp, importPtr->table, 
+        importPtr->row, col, objPtr);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FinishXmlGuesses --
+ *
+ *      Sets the types of the new columns not yet typed, and returns the
+ *      labels and types of the new columns as the interpreter result.
+ *
+ * Results:
+ *      Returns a standard TCL result.
+ *
+ *---------------------------------------------------------------------------
+ */
+static int
+FinishXmlGuesses(ImportData *importPtr)
+{
+    Tcl_Obj *listObjPtr;
+    long i;
+
+    listObjPtr = Tcl_NewListObj(0, (Tcl_Obj **)NULL);
+    for (i = importPtr->firstNewColumn; 
+         i < blt_table_num_columns(importPtr->table); i++) {
+        Blt_HashEntry *hPtr;
+
+        hPtr = Blt_FindHashEntry(&importPtr->guessTable, 
+                (char *)blt_table_column(importPtr->table, i));
+        if (hPtr == NULL) {
+            continue;
+        }
+        if (blt_table_finish_type_guess(importPtr->interp, importPtr->table,
+                Blt_GetHashValue(hPtr), listObjPtr) != TCL_OK) {
+            Tcl_DecrRefCount(listObjPtr);
+            return TCL_ERROR;
+        }
+    }
+    Tcl_SetObjResult(importPtr->interp, listObjPtr);
+    return TCL_OK;
+}
+
+static void
+FreeXmlGuesses(ImportData *importPtr)
+{
+    Blt_HashEntry *hPtr;
+    Blt_HashSearch iter;
+
+    for (hPtr = Blt_FirstHashEntry(&importPtr->guessTable, &iter); 
+         hPtr != NULL; hPtr = Blt_NextHashEntry(&iter)) {
+        Blt_Free(Blt_GetHashValue(hPtr));
+    }
+    Blt_DeleteHashTable(&importPtr->guessTable);
+}
+
 static void
 GetXmlCharacterData(void *userData, const XML_Char *string, int length) 
 {
@@ -356,8 +534,7 @@ GetXmlCharacterData(void *userData, const XML_Char *string, int length)
 
             objPtr = Blt_List_GetValue(node);
             col = (BLT_TABLE_COLUMN)Blt_List_GetKey(node);
-            if (blt_table_set_obj(importPtr->interp, importPtr->table,
-                        importPtr->row, col, objPtr) != TCL_OK) {
+            if (SetXmlValue(importPtr, col, objPtr) != TCL_OK) {
                 Tcl_BackgroundError(importPtr->interp);
             }
         }
@@ -388,7 +565,7 @@ StartXmlTag(void *userData, const char *element, const char **attr)
          */
         hPtr = Blt_CreateHashEntry(&importPtr->elemTable, element, &isNew);
         if (isNew) {
-            col = blt_table_create_column(interp, table, element);
+            col = CreateXmlColumn(importPtr, element);
             if (col == NULL) {
                 goto error;
             }
@@ -419,7 +596,7 @@ StartXmlTag(void *userData, const char *element, const char **attr)
              */
             hPtr = Blt_CreateHashEntry(&importPtr->attrTable, name, &isNew);
             if (isNew) {
-                col = blt_table_create_column(interp, table, name);
+                col = CreateXmlColumn(importPtr, name);
                 if (col == NULL) {
                     goto error;
                 }
@@ -428,8 +605,15 @@ StartXmlTag(void *userData, const char *element, const char **attr)
                 col = Blt_GetHashValue(hPtr);
             }
             /* Set the attribute value as the cell value. */
-            if (blt_table_set_string_rep(interp, table, row, col, value, -1)
-                != TCL_OK) {
+            if (importPtr->sampleSize != 0) {
+                Tcl_Obj *objPtr;
+
+                objPtr = GetStringObj(importPtr, value, strlen(value));
+                if (SetXmlValue(importPtr, col, objPtr) != TCL_OK) {
+                    goto error;
+                }
+            } else if (blt_table_set_string_rep(interp, table, row, col,
+                        value, -1) != TCL_OK) {
                 goto error;
             }
         }
@@ -570,8 +754,8 @@ GetXmlExternalEntityRef(XML_Parser parser, const XML_Char *context,
 }
 
 static int
-ImportXmlFile(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *fileObjPtr,
-              unsigned int flags) 
+ImportXmlFile(Tcl_Interp *interp, BLT_TABLE table, long sampleSize, 
+              Tcl_Obj *fileObjPtr, unsigned int flags) 
 {
     ImportData import;
     XML_Parser parser;
@@ -587,6 +771,9 @@ ImportXmlFile(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *fileObjPtr,
     import.row = NULL;
     import.interp = interp;
     import.flags = flags;
+    import.sampleSize = sampleSize;
+    import.firstNewColumn = blt_table_num_columns(table);
+    Blt_InitHashTable(&import.guessTable, BLT_ONE_WORD_KEYS);
     Blt_InitHashTable(&import.stringTable, BLT_STRING_KEYS);
     Blt_InitHashTable(&import.attrTable, BLT_STRING_KEYS);
     Blt_InitHashTable(&import.elemTable, BLT_STRING_KEYS);
@@ -616,13 +803,17 @@ ImportXmlFile(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *fileObjPtr,
     Blt_DeleteHashTable(&import.elemTable);
     DumpStringTable(&import.stringTable);
     Blt_List_Destroy(import.elemList);
+    if ((result) && (sampleSize != 0)) {
+        result = (FinishXmlGuesses(&import) == TCL_OK);
+    }
+    FreeXmlGuesses(&import);
     return (result) ? TCL_OK : TCL_ERROR;
 } 
 
 
 static int
-ImportXmlData(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *dataObjPtr,
-              unsigned int flags) 
+ImportXmlData(Tcl_Interp *interp, BLT_TABLE table, long sampleSize, 
+              Tcl_Obj *dataObjPtr, unsigned int flags) 
 {
     ImportData import;
     XML_Parser parser;
@@ -639,6 +830,9 @@ ImportXmlData(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *dataObjPtr,
     import.row = NULL;
     import.interp = interp;
     import.flags = flags;
+    import.sampleSize = sampleSize;
+    import.firstNewColumn = blt_table_num_columns(table);
+    Blt_InitHashTable(&import.guessTable, BLT_ONE_WORD_KEYS);
     Blt_InitHashTable(&import.attrTable, BLT_STRING_KEYS);
     Blt_InitHashTable(&import.elemTable, BLT_STRING_KEYS);
     Blt_InitHashTable(&import.stringTable, BLT_STRING_KEYS);
@@ -659,6 +853,10 @@ ImportXmlData(Tcl_Interp *interp, BLT_TABLE table, Tcl_Obj *dataObjPtr,
     Blt_DeleteHashTable(&import.elemTable);
     DumpStringTable(&import.stringTable);
     Blt_List_Destroy(import.elemList);
+    if ((result) && (sampleSize != 0)) {
+        result = (FinishXmlGuesses(&import) == TCL_OK);
+    }
+    FreeXmlGuesses(&import);
     return (result) ? TCL_OK : TCL_ERROR;
 } 
 
@@ -687,9 +885,11 @@ ImportXmlProc(BLT_TABLE table, Tcl_Interp *interp, int objc,
         goto error;
     }
     if (switches.fileObj != NULL) {
-        result = ImportXmlFile(interp, table, switches.fileObj, switches.flags);
+        result = ImportXmlFile(interp, table, switches.sampleSize, 
+                switches.fileObj, switches.flags);
     } else {
-        result = ImportXmlData(interp, table, switches.dataObj, switches.flags);
+        result = ImportXmlData(interp, table, switches.sampleSize, 
+                switches.dataObj, switches.flags);
     }
  error:
     Blt_FreeSwitches(importSwitches, (char *)&switches, 0);
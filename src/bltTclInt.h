@@ -229,6 +229,19 @@ BLT_EXTERN int Blt_GetTimeFromObj(Tcl_Interp *interp, Tcl_Obj *objPtr,
 BLT_EXTERN int Blt_GetTime(Tcl_Interp *interp, const char *string, 
         double *secondsPtr);
 
+typedef struct _Blt_TimeFormat *Blt_TimeFormat;
+
+BLT_EXTERN Blt_TimeFormat Blt_CompileTimeFormat(Tcl_Interp *interp, 
+        const char *pattern);
+BLT_EXTERN void Blt_FreeTimeFormat(Blt_TimeFormat format);
+BLT_EXTERN const char *Blt_TimeFormatPattern(Blt_TimeFormat format);
+BLT_EXTERN int Blt_ParseTimeWithFormat(Tcl_Interp *interp, 
+        Blt_TimeFormat format, const char *string, int length, 
+        double *secondsPtr);
+BLT_EXTERN int Blt_ParseTimesWithFormat(Tcl_Interp *interp, 
+        Blt_TimeFormat format, long numValues, const char *buffer, 
+        const int64_t *offsets, double *seconds);
+
 BLT_EXTERN void Blt_SecondsToDate(double seconds, Blt_DateTime *datePtr);
 BLT_EXTERN void Blt_DateToSeconds(Blt_DateTime *datePtr, double *secondsPtr);
 BLT_EXTERN void Blt_FormatDate(Blt_DateTime *datePtr, const char *format, 
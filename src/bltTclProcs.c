@@ -294,6 +294,38 @@ BltTclProcs bltTclProcs = {
     Blt_ExprVector, /* 278 */
     Blt_InstallIndexProc, /* 279 */
     Blt_VectorExists2, /* 280 */
+    blt_table_binary_dump, /* 281 */
+    blt_table_binary_restore, /* 282 */
+    blt_table_file_binary_restore, /* 283 */
+    blt_table_map_snapshot, /* 284 */
+    blt_table_create_index, /* 285 */
+    blt_table_delete_index, /* 286 */
+    blt_table_index_rows, /* 287 */
+    blt_table_index_range, /* 288 */
+    blt_table_iterate_row_tag, /* 289 */
+    blt_table_aggregate, /* 290 */
+    blt_table_join, /* 291 */
+    blt_table_set_column_encoding, /* 292 */
+    blt_table_dictionary_code, /* 293 */
+    blt_table_get_code, /* 294 */
+    blt_table_begin_batch, /* 295 */
+    blt_table_end_batch, /* 296 */
+    blt_table_mirror_rows, /* 297 */
+    blt_table_share_column, /* 298 */
+    blt_table_get_column_stats, /* 299 */
+    blt_table_load_column, /* 300 */
+    blt_table_create_view, /* 301 */
+    blt_table_delete_view, /* 302 */
+    blt_table_sync_view, /* 303 */
+    blt_table_partial_sort_row_map, /* 304 */
+    blt_table_set_column_time_format, /* 305 */
+    blt_table_column_time_format, /* 306 */
+    blt_table_init_type_guess, /* 307 */
+    blt_table_guess_value, /* 308 */
+    blt_table_set_guessed_type, /* 309 */
+    blt_table_set_guessed_value, /* 310 */
+    blt_table_finish_type_guess, /* 311 */
+    blt_table_window, /* 312 */
 };
 
 /* !END!: Do not edit above this line. */
@@ -1751,6 +1751,227 @@ BLT_EXTERN void		Blt_InstallIndexProc(Tcl_Interp *interp,
 BLT_EXTERN int		Blt_VectorExists2(Tcl_Interp *interp,
 				const char *vecName);
 #endif
+#ifndef blt_table_binary_dump_DECLARED
+#define blt_table_binary_dump_DECLARED
+/* 281 */
+BLT_EXTERN int		blt_table_binary_dump(Tcl_Interp *interp,
+				BLT_TABLE table,
+				BLT_TABLE_ITERATOR *rowIterPtr,
+				BLT_TABLE_ITERATOR *colIterPtr,
+				Tcl_Channel channel);
+#endif
+#ifndef blt_table_binary_restore_DECLARED
+#define blt_table_binary_restore_DECLARED
+/* 282 */
+BLT_EXTERN int		blt_table_binary_restore(Tcl_Interp *interp,
+				BLT_TABLE table, const unsigned char *bytes,
+				size_t numBytes, unsigned int flags);
+#endif
+#ifndef blt_table_file_binary_restore_DECLARED
+#define blt_table_file_binary_restore_DECLARED
+/* 283 */
+BLT_EXTERN int		blt_table_file_binary_restore(Tcl_Interp *interp,
+				BLT_TABLE table, const char *fileName,
+				unsigned int flags);
+#endif
+#ifndef blt_table_map_snapshot_DECLARED
+#define blt_table_map_snapshot_DECLARED
+/* 284 */
+BLT_EXTERN int		blt_table_map_snapshot(Tcl_Interp *interp,
+				BLT_TABLE table, const char *fileName);
+#endif
+#ifndef blt_table_create_index_DECLARED
+#define blt_table_create_index_DECLARED
+/* 285 */
+BLT_EXTERN int		blt_table_create_index(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_COLUMN col, int unique);
+#endif
+#ifndef blt_table_delete_index_DECLARED
+#define blt_table_delete_index_DECLARED
+/* 286 */
+BLT_EXTERN void		blt_table_delete_index(BLT_TABLE table,
+				BLT_TABLE_COLUMN col);
+#endif
+#ifndef blt_table_index_rows_DECLARED
+#define blt_table_index_rows_DECLARED
+/* 287 */
+BLT_EXTERN long		blt_table_index_rows(BLT_TABLE table,
+				BLT_TABLE_COLUMN col, BLT_TABLE_ROW **rowsPtr);
+#endif
+#ifndef blt_table_index_range_DECLARED
+#define blt_table_index_range_DECLARED
+/* 288 */
+BLT_EXTERN int		blt_table_index_range(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_COLUMN col,
+				Tcl_Obj *loObjPtr, Tcl_Obj *hiObjPtr,
+				BLT_TABLE_ROW **rowsPtr, long *numRowsPtr);
+#endif
+#ifndef blt_table_iterate_row_tag_DECLARED
+#define blt_table_iterate_row_tag_DECLARED
+/* 289 */
+BLT_EXTERN int		blt_table_iterate_row_tag(BLT_TABLE table,
+				const char *tag, BLT_TABLE_ITERATOR *iterPtr);
+#endif
+#ifndef blt_table_aggregate_DECLARED
+#define blt_table_aggregate_DECLARED
+/* 290 */
+BLT_EXTERN int		blt_table_aggregate(Tcl_Interp *interp,
+				BLT_TABLE table, long numRows,
+				BLT_TABLE_ROW *rows, long numGroupColumns,
+				BLT_TABLE_COLUMN *groupColumns,
+				long numAggregates,
+				BLT_TABLE_AGGREGATE *aggregates,
+				int numThreads, BLT_TABLE dest);
+#endif
+#ifndef blt_table_join_DECLARED
+#define blt_table_join_DECLARED
+/* 291 */
+BLT_EXTERN int		blt_table_join(Tcl_Interp *interp, BLT_TABLE table,
+				BLT_TABLE src, long numKeys,
+				BLT_TABLE_COLUMN *keys,
+				BLT_TABLE_COLUMN *srcKeys, long numColumns,
+				BLT_TABLE_COLUMN *srcColumns,
+				unsigned int flags);
+#endif
+#ifndef blt_table_set_column_encoding_DECLARED
+#define blt_table_set_column_encoding_DECLARED
+/* 292 */
+BLT_EXTERN int		blt_table_set_column_encoding(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_COLUMN col,
+				BLT_TABLE_COLUMN_ENCODING encoding);
+#endif
+#ifndef blt_table_dictionary_code_DECLARED
+#define blt_table_dictionary_code_DECLARED
+/* 293 */
+BLT_EXTERN long		blt_table_dictionary_code(BLT_TABLE_COLUMN col,
+				const char *string);
+#endif
+#ifndef blt_table_get_code_DECLARED
+#define blt_table_get_code_DECLARED
+/* 294 */
+BLT_EXTERN long		blt_table_get_code(BLT_TABLE table,
+				BLT_TABLE_ROW row, BLT_TABLE_COLUMN col);
+#endif
+#ifndef blt_table_begin_batch_DECLARED
+#define blt_table_begin_batch_DECLARED
+/* 295 */
+BLT_EXTERN void		blt_table_begin_batch(BLT_TABLE table);
+#endif
+#ifndef blt_table_end_batch_DECLARED
+#define blt_table_end_batch_DECLARED
+/* 296 */
+BLT_EXTERN void		blt_table_end_batch(BLT_TABLE table);
+#endif
+#ifndef blt_table_mirror_rows_DECLARED
+#define blt_table_mirror_rows_DECLARED
+/* 297 */
+BLT_EXTERN int		blt_table_mirror_rows(Tcl_Interp *interp,
+				BLT_TABLE src, BLT_TABLE dst);
+#endif
+#ifndef blt_table_share_column_DECLARED
+#define blt_table_share_column_DECLARED
+/* 298 */
+BLT_EXTERN int		blt_table_share_column(BLT_TABLE src,
+				BLT_TABLE_COLUMN srcCol, BLT_TABLE dst,
+				BLT_TABLE_COLUMN dstCol);
+#endif
+#ifndef blt_table_get_column_stats_DECLARED
+#define blt_table_get_column_stats_DECLARED
+/* 299 */
+BLT_EXTERN int		blt_table_get_column_stats(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_COLUMN col,
+				BLT_TABLE_COLUMN_STATS *statsPtr);
+#endif
+#ifndef blt_table_load_column_DECLARED
+#define blt_table_load_column_DECLARED
+/* 300 */
+BLT_EXTERN int		blt_table_load_column(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_COLUMN col,
+				size_t numRows, BLT_TABLE_ROW *rows,
+				const unsigned char *bitmap,
+				const void *values, size_t width,
+				const int64_t *offsets);
+#endif
+#ifndef blt_table_create_view_DECLARED
+#define blt_table_create_view_DECLARED
+/* 301 */
+BLT_EXTERN BLT_TABLE_VIEW		blt_table_create_view(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_COLUMN col,
+				BLT_TABLE_VIEW_PROC *proc,
+				ClientData clientData);
+#endif
+#ifndef blt_table_delete_view_DECLARED
+#define blt_table_delete_view_DECLARED
+/* 302 */
+BLT_EXTERN void		blt_table_delete_view(BLT_TABLE table,
+				BLT_TABLE_VIEW view);
+#endif
+#ifndef blt_table_sync_view_DECLARED
+#define blt_table_sync_view_DECLARED
+/* 303 */
+BLT_EXTERN void		blt_table_sync_view(BLT_TABLE table,
+				BLT_TABLE_VIEW view);
+#endif
+#ifndef blt_table_partial_sort_row_map_DECLARED
+#define blt_table_partial_sort_row_map_DECLARED
+/* 304 */
+BLT_EXTERN void		blt_table_partial_sort_row_map(BLT_TABLE table,
+				long numRows, BLT_TABLE_ROW *rows,
+				long numSorted);
+#endif
+#ifndef blt_table_set_column_time_format_DECLARED
+#define blt_table_set_column_time_format_DECLARED
+/* 305 */
+BLT_EXTERN int		blt_table_set_column_time_format(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_COLUMN col,
+				const char *pattern);
+#endif
+#ifndef blt_table_column_time_format_DECLARED
+#define blt_table_column_time_format_DECLARED
+/* 306 */
+BLT_EXTERN const char *	 blt_table_column_time_format(BLT_TABLE_COLUMN col);
+#endif
+#ifndef blt_table_init_type_guess_DECLARED
+#define blt_table_init_type_guess_DECLARED
+/* 307 */
+BLT_EXTERN void		blt_table_init_type_guess(BLT_TABLE_TYPE_GUESS *guessPtr,
+				BLT_TABLE_COLUMN col, long sampleSize);
+#endif
+#ifndef blt_table_guess_value_DECLARED
+#define blt_table_guess_value_DECLARED
+/* 308 */
+BLT_EXTERN void		blt_table_guess_value(BLT_TABLE_TYPE_GUESS *guessPtr,
+				const char *string, int length);
+#endif
+#ifndef blt_table_set_guessed_type_DECLARED
+#define blt_table_set_guessed_type_DECLARED
+/* 309 */
+BLT_EXTERN int		blt_table_set_guessed_type(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_TYPE_GUESS *guessPtr);
+#endif
+#ifndef blt_table_set_guessed_value_DECLARED
+#define blt_table_set_guessed_value_DECLARED
+/* 310 */
+BLT_EXTERN int		blt_table_set_guessed_value(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_ROW row,
+				BLT_TABLE_TYPE_GUESS *guessPtr,
+				const char *string, int length);
+#endif
+#ifndef blt_table_finish_type_guess_DECLARED
+#define blt_table_finish_type_guess_DECLARED
+/* 311 */
+BLT_EXTERN int		blt_table_finish_type_guess(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_TYPE_GUESS *guessPtr,
+				Tcl_Obj *listObjPtr);
+#endif
+#ifndef blt_table_window_DECLARED
+#define blt_table_window_DECLARED
+/* 312 */
+BLT_EXTERN int		blt_table_window(Tcl_Interp *interp,
+				BLT_TABLE table, BLT_TABLE_COLUMN src,
+				BLT_TABLE_COLUMN dest,
+				BLT_TABLE_WINDOW *winPtr);
+#endif
 
 typedef struct BltTclStubHooks {
     struct BltTclIntProcs *bltTclIntProcs;
@@ -2041,6 +2262,38 @@ typedef struct BltTclProcs {
     int (*blt_ExprVector) (Tcl_Interp *interp, char *expr, Blt_Vector *vecPtr); /* 278 */
     void (*blt_InstallIndexProc) (Tcl_Interp *interp, const char *indexName, Blt_VectorIndexProc *procPtr); /* 279 */
     int (*blt_VectorExists2) (Tcl_Interp *interp, const char *vecName); /* 280 */
+    int (*blt_table_binary_dump) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_ITERATOR *rowIterPtr, BLT_TABLE_ITERATOR *colIterPtr, Tcl_Channel channel); /* 281 */
+    int (*blt_table_binary_restore) (Tcl_Interp *interp, BLT_TABLE table, const unsigned char *bytes, size_t numBytes, unsigned int flags); /* 282 */
+    int (*blt_table_file_binary_restore) (Tcl_Interp *interp, BLT_TABLE table, const char *fileName, unsigned int flags); /* 283 */
+    int (*blt_table_map_snapshot) (Tcl_Interp *interp, BLT_TABLE table, const char *fileName); /* 284 */
+    int (*blt_table_create_index) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col, int unique); /* 285 */
+    void (*blt_table_delete_index) (BLT_TABLE table, BLT_TABLE_COLUMN col); /* 286 */
+    long (*blt_table_index_rows) (BLT_TABLE table, BLT_TABLE_COLUMN col, BLT_TABLE_ROW **rowsPtr); /* 287 */
+    int (*blt_table_index_range) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col, Tcl_Obj *loObjPtr, Tcl_Obj *hiObjPtr, BLT_TABLE_ROW **rowsPtr, long *numRowsPtr); /* 288 */
+    int (*blt_table_iterate_row_tag) (BLT_TABLE table, const char *tag, BLT_TABLE_ITERATOR *iterPtr); /* 289 */
+    int (*blt_table_aggregate) (Tcl_Interp *interp, BLT_TABLE table, long numRows, BLT_TABLE_ROW *rows, long numGroupColumns, BLT_TABLE_COLUMN *groupColumns, long numAggregates, BLT_TABLE_AGGREGATE *aggregates, int numThreads, BLT_TABLE dest); /* 290 */
+    int (*blt_table_join) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE src, long numKeys, BLT_TABLE_COLUMN *keys, BLT_TABLE_COLUMN *srcKeys, long numColumns, BLT_TABLE_COLUMN *srcColumns, unsigned int flags); /* 291 */
+    int (*blt_table_set_column_encoding) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col, BLT_TABLE_COLUMN_ENCODING encoding); /* 292 */
+    long (*blt_table_dictionary_code) (BLT_TABLE_COLUMN col, const char *string); /* 293 */
+    long (*blt_table_get_code) (BLT_TABLE table, BLT_TABLE_ROW row, BLT_TABLE_COLUMN col); /* 294 */
+    void (*blt_table_begin_batch) (BLT_TABLE table); /* 295 */
+    void (*blt_table_end_batch) (BLT_TABLE table); /* 296 */
+    int (*blt_table_mirror_rows) (Tcl_Interp *interp, BLT_TABLE src, BLT_TABLE dst); /* 297 */
+    int (*blt_table_share_column) (BLT_TABLE src, BLT_TABLE_COLUMN srcCol, BLT_TABLE dst, BLT_TABLE_COLUMN dstCol); /* 298 */
+    int (*blt_table_get_column_stats) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col, BLT_TABLE_COLUMN_STATS *statsPtr); /* 299 */
+    int (*blt_table_load_column) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col, size_t numRows, BLT_TABLE_ROW *rows, const unsigned char *bitmap, const void *values, size_t width, const int64_t *offsets); /* 300 */
+    BLT_TABLE_VIEW (*blt_table_create_view) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col, BLT_TABLE_VIEW_PROC *proc, ClientData clientData); /* 301 */
+    void (*blt_table_delete_view) (BLT_TABLE table, BLT_TABLE_VIEW view); /* 302 */
+    void (*blt_table_sync_view) (BLT_TABLE table, BLT_TABLE_VIEW view); /* 303 */
+    void (*blt_table_partial_sort_row_map) (BLT_TABLE table, long numRows, BLT_TABLE_ROW *rows, long numSorted); /* 304 */
+    int (*blt_table_set_column_time_format) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN col, const char *pattern); /* 305 */
+    const char * (*blt_table_column_time_format) (BLT_TABLE_COLUMN col); /* 306 */
+    void (*blt_table_init_type_guess) (BLT_TABLE_TYPE_GUESS *guessPtr, BLT_TABLE_COLUMN col, long sampleSize); /* 307 */
+    void (*blt_table_guess_value) (BLT_TABLE_TYPE_GUESS *guessPtr, const char *string, int length); /* 308 */
+    int (*blt_table_set_guessed_type) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_TYPE_GUESS *guessPtr); /* 309 */
+    int (*blt_table_set_guessed_value) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_ROW row, BLT_TABLE_TYPE_GUESS *guessPtr, const char *string, int length); /* 310 */
+    int (*blt_table_finish_type_guess) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_TYPE_GUESS *guessPtr, Tcl_Obj *listObjPtr); /* 311 */
+    int (*blt_table_window) (Tcl_Interp *interp, BLT_TABLE table, BLT_TABLE_COLUMN src, BLT_TABLE_COLUMN dest, BLT_TABLE_WINDOW *winPtr); /* 312 */
 } BltTclProcs;
 
 #ifdef __cplusplus
@@ -3178,6 +3431,134 @@ extern BltTclProcs *bltTclProcsPtr;
 #define Blt_VectorExists2 \
 	(bltTclProcsPtr->blt_VectorExists2) /* 280 */
 #endif
+#ifndef blt_table_binary_dump
+#define blt_table_binary_dump \
+	(bltTclProcsPtr->blt_table_binary_dump) /* 281 */
+#endif
+#ifndef blt_table_binary_restore
+#define blt_table_binary_restore \
+	(bltTclProcsPtr->blt_table_binary_restore) /* 282 */
+#endif
+#ifndef blt_table_file_binary_restore
+#define blt_table_file_binary_restore \
+	(bltTclProcsPtr->blt_table_file_binary_restore) /* 283 */
+#endif
+#ifndef blt_table_map_snapshot
+#define blt_table_map_snapshot \
+	(bltTclProcsPtr->blt_table_map_snapshot) /* 284 */
+#endif
+#ifndef blt_table_create_index
+#define blt_table_create_index \
+	(bltTclProcsPtr->blt_table_create_index) /* 285 */
+#endif
+#ifndef blt_table_delete_index
+#define blt_table_delete_index \
+	(bltTclProcsPtr->blt_table_delete_index) /* 286 */
+#endif
+#ifndef blt_table_index_rows
+#define blt_table_index_rows \
+	(bltTclProcsPtr->blt_table_index_rows) /* 287 */
+#endif
+#ifndef blt_table_index_range
+#define blt_table_index_range \
+	(bltTclProcsPtr->blt_table_index_range) /* 288 */
+#endif
+#ifndef blt_table_iterate_row_tag
+#define blt_table_iterate_row_tag \
+	(bltTclProcsPtr->blt_table_iterate_row_tag) /* 289 */
+#endif
+#ifndef blt_table_aggregate
+#define blt_table_aggregate \
+	(bltTclProcsPtr->blt_table_aggregate) /* 290 */
+#endif
+#ifndef blt_table_join
+#define blt_table_join \
+	(bltTclProcsPtr->blt_table_join) /* 291 */
+#endif
+#ifndef blt_table_set_column_encoding
+#define blt_table_set_column_encoding \
+	(bltTclProcsPtr->blt_table_set_column_encoding) /* 292 */
+#endif
+#ifndef blt_table_dictionary_code
+#define blt_table_dictionary_code \
+	(bltTclProcsPtr->blt_table_dictionary_code) /* 293 */
+#endif
+#ifndef blt_table_get_code
+#define blt_table_get_code \
+	(bltTclProcsPtr->blt_table_get_code) /* 294 */
+#endif
+#ifndef blt_table_begin_batch
+#define blt_table_begin_batch \
+	(bltTclProcsPtr->blt_table_begin_batch) /* 295 */
+#endif
+#ifndef blt_table_end_batch
+#define blt_table_end_batch \
+	(bltTclProcsPtr->blt_table_end_batch) /* 296 */
+#endif
+#ifndef blt_table_mirror_rows
+#define blt_table_mirror_rows \
+	(bltTclProcsPtr->blt_table_mirror_rows) /* 297 */
+#endif
+#ifndef blt_table_share_column
+#define blt_table_share_column \
+	(bltTclProcsPtr->blt_table_share_column) /* 298 */
+#endif
+#ifndef blt_table_get_column_stats
+#define blt_table_get_column_stats \
+	(bltTclProcsPtr->blt_table_get_column_stats) /* 299 */
+#endif
+#ifndef blt_table_load_column
+#define blt_table_load_column \
+	(bltTclProcsPtr->blt_table_load_column) /* 300 */
+#endif
+#ifndef blt_table_create_view
+#define blt_table_create_view \
+	(bltTclProcsPtr->blt_table_create_view) /* 301 */
+#endif
+#ifndef blt_table_delete_view
+#define blt_table_delete_view \
+	(bltTclProcsPtr->blt_table_delete_view) /* 302 */
+#endif
+#ifndef blt_table_sync_view
+#define blt_table_sync_view \
+	(bltTclProcsPtr->blt_table_sync_view) /* 303 */
+#endif
+#ifndef blt_table_partial_sort_row_map
+#define blt_table_partial_sort_row_map \
+	(bltTclProcsPtr->blt_table_partial_sort_row_map) /* 304 */
+#endif
+#ifndef blt_table_set_column_time_format
+#define blt_table_set_column_time_format \
+	(bltTclProcsPtr->blt_table_set_column_time_format) /* 305 */
+#endif
+#ifndef blt_table_column_time_format
+#define blt_table_column_time_format \
+	(bltTclProcsPtr->blt_table_column_time_format) /* 306 */
+#endif
+#ifndef blt_table_init_type_guess
+#define blt_table_init_type_guess \
+	(bltTclProcsPtr->blt_table_init_type_guess) /* 307 */
+#endif
+#ifndef blt_table_guess_value
+#define blt_table_guess_value \
+	(bltTclProcsPtr->blt_table_guess_value) /* 308 */
+#endif
+#ifndef blt_table_set_guessed_type
+#define blt_table_set_guessed_type \
+	(bltTclProcsPtr->blt_table_set_guessed_type) /* 309 */
+#endif
+#ifndef blt_table_set_guessed_value
+#define blt_table_set_guessed_value \
+	(bltTclProcsPtr->blt_table_set_guessed_value) /* 310 */
+#endif
+#ifndef blt_table_finish_type_guess
+#define blt_table_finish_type_guess \
+	(bltTclProcsPtr->blt_table_finish_type_guess) /* 311 */
+#endif
+#ifndef blt_table_window
+#define blt_table_window \
+	(bltTclProcsPtr->blt_table_window) /* 312 */
+#endif
 
 #endif /* defined(USE_BLT_STUBS) && !defined(BUILD_BLT_TCL_PROCS) */
 
@@ -256,6 +256,17 @@ static Blt_SwitchSpec formatSwitches[] =
     {BLT_SWITCH_END}
 };
 
+typedef struct {
+    Tcl_Obj *fmtObjPtr;
+} ScanSwitches;
+
+static Blt_SwitchSpec scanSwitches[] = 
+{
+    {BLT_SWITCH_OBJ, "-format", "pattern",  (char *)NULL,
+        Blt_Offset(ScanSwitches, fmtObjPtr), 0},
+    {BLT_SWITCH_END}
+};
+
 static int initialized = FALSE;
 static Tcl_ObjCmdProc TimeStampCmd;
 
@@ -2759,9 +2770,36 @@ static int
 ScanOp(ClientData clientData, Tcl_Interp *interp, int objc, 
        Tcl_Obj *const *objv)
 {
+    ScanSwitches switches;
     double seconds;
+    int result;
+
+    memset(&switches, 0, sizeof(switches));
+    if (Blt_ParseSwitches(interp, scanSwitches, objc - 3, objv + 3,
+                &switches, BLT_SWITCH_DEFAULTS) < 0) {
+        return TCL_ERROR;
+    }
+    if (switches.fmtObjPtr != NULL) {
+        Blt_TimeFormat format;
+        
+        format = Blt_CompileTimeFormat(interp, 
+                Tcl_GetString(switches.fmtObjPtr));
+        if (format == NULL) {
+            result = TCL_ERROR;
+        } else {
+            int length;
+            const char *string;
 
-    if (Blt_GetTimeFromObj(interp, objv[2], &seconds) != TCL_OK) {
+            string = Tcl_GetStringFromObj(objv[2], &length);
+            result = Blt_ParseTimeWithFormat(interp, format, string, length,
+                &seconds);
+            Blt_FreeTimeFormat(format);
+        }
+    } else {
+        result = Blt_GetTimeFromObj(interp, objv[2], &seconds);
+    }
+    Blt_FreeSwitches(scanSwitches, (char *)&switches, 0);
+    if (result != TCL_OK) {
         return TCL_ERROR;
     }
     Tcl_SetDoubleObj(Tcl_GetObjResult(interp), seconds);
@@ -2779,7 +2817,7 @@ static Blt_OpSpec timeStampCmdOps[] =
 {
     {"format",  1, FormatOp,      3, 0, "seconds ?switches ...?",},
     {"parse",   1, ParseOp,       3, 3, "timeStamp",},
-    {"scan",    1, ScanOp,        3, 3, "timeStamp",},
+    {"scan",    1, ScanOp,        3, 0, "timeStamp ?-format pattern?",},
 };
 
 static int numCmdOps = sizeof(timeStampCmdOps) / sizeof(Blt_OpSpec);
@@ -3011,6 +3049,531 @@ Blt_GetTimeFromObj(Tcl_Interp *interp, Tcl_Obj *objPtr, double *secondsPtr)
     return TCL_ERROR;
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Compiled time formats --
+ *
+ *      A time format is a strptime-style pattern compiled once into a
+ *      list of fixed fields.  Strings that follow the pattern (such as
+ *      the timestamps of a log file) are then parsed field by field,
+ *      without the tokenizer and date guessing of the general parser.
+ *      Parsing allocates no memory.
+ *
+ *      The fields are
+ *
+ *          %Y  year            %m  month (1-12)    %d, %e  day of month
+ *          %y  2-digit year    %b, %B, %h  month name
+ *          %j  day of year     %H  hour (0-23)     %I  hour (1-12)
+ *          %M  minute          %S  second          %f  fractional second
+ *          %p  AM or PM        %a, %A  weekday name (ignored)
+ *          %z  Z, +hh, +hhmm, or +hh:mm            %s  seconds since epoch
+ *          %T  %H:%M:%S        %R  %H:%M           %F  %Y-%m-%d
+ *          %D  %m/%d/%y        %%  a percent sign
+ *
+ *      White space in the pattern matches any amount of white space.
+ *      Any other character must match exactly.  Missing date fields
+ *      default to the epoch, like the general parser.
+ *
+ *-----------------------------------------------------------------------------
+ */
+typedef enum {
+    FIELD_LITERAL, FIELD_SPACE, FIELD_YEAR, FIELD_YEAR2, FIELD_MONTH,
+    FIELD_MONTHNAME, FIELD_MDAY, FIELD_YDAY, FIELD_HOUR, FIELD_HOUR12,
+    FIELD_MINUTE, FIELD_SECOND, FIELD_FRACTION, FIELD_AMPM, FIELD_WEEKDAY,
+    FIELD_TZOFFSET, FIELD_EPOCH
+} TimeFieldType;
+
+typedef struct {
+    TimeFieldType type;
+    int c;                              /* Character to match for
+                                         * FIELD_LITERAL. */
+} TimeField;
+
+struct _Blt_TimeFormat {
+    char *pattern;                      /* Pattern the format was compiled
+                                         * from. */
+    int numFields;
+    TimeField fields[1];                /* Array of fields.  Allocated
+                                         * with the structure. */
+};
+
+static int
+CompileTimeFields(Tcl_Interp *interp, struct _Blt_TimeFormat *fmtPtr,
+                  const char *pattern)
+{
+    const char *p;
+
+    for (p = pattern; *p != '\0'; p++) {
+        TimeField *fieldPtr;
+        const char *expand;
+
+        fieldPtr = fmtPtr->fields + fmtPtr->numFields;
+        if (isspace(UCHAR(*p))) {
+            if ((fmtPtr->numFields == 0) || 
+                (fieldPtr[-1].type != FIELD_SPACE)) {
+                fieldPtr->type = FIELD_SPACE;
+                fmtPtr->numFields++;
+            }
+            continue;
+        }
+        if (*p != '%') {
+            fieldPtr->type = FIELD_LITERAL;
+            fieldPtr->c = *p;
+            fmtPtr->numFields++;
+            continue;
+        }
+        p++;
+        expand = NULL;
+        switch (*p) {
+        case 'Y':  fieldPtr->type = FIELD_YEAR;         break;
+        case 'y':  fieldPtr->type = FIELD_YEAR2;        break;
+        case 'm':  fieldPtr->type = FIELD_MONTH;        break;
+        case 'b':
+        case 'B':
+        case 'h':  fieldPtr->type = FIELD_MONTHNAME;    break;
+        case 'd':
+        case 'e':  fieldPtr->type = FIELD_MDAY;         break;
+        case 'j':  fieldPtr->type = FIELD_YDAY;         break;
+        case 'H':  fieldPtr->type = FIELD_HOUR;         break;
+        case 'I':  fieldPtr->type = FIELD_HOUR12;       break;
+        case 'M':  fieldPtr->type = FIELD_MINUTE;       break;
+        case 'S':  fieldPtr->type = FIELD_SECOND;       break;
+        case 'f':  fieldPtr->type = FIELD_FRACTION;     break;
+        case 'p':  fieldPtr->type = FIELD_AMPM;         break;
+        case 'a':
+        case 'A':  fieldPtr->type = FIELD_WEEKDAY;      break;
+        case 'z':  fieldPtr->type = FIELD_TZOFFSET;     break;
+        case 's':  fieldPtr->type = FIELD_EPOCH;        break;
+        case 'T':  expand = "%H:%M:%S";                 break;
+        case 'R':  expand = "%H:%M";                    break;
+        case 'F':  expand = "%Y-%m-%d";                 break;
+        case 'D':  expand = "%m/%d/%y";                 break;
+        case '%':  
+            fieldPtr->type = FIELD_LITERAL;
+            fieldPtr->c = '%';
+            break;
+        default:
+            if (interp != NULL) {
+                char mesg[3];
+
+                mesg[0] = '%', mesg[1] = *p, mesg[2] = '\0';
+                Tcl_AppendResult(interp, "bad time format \"", 
+                        fmtPtr->pattern, "\": unknown field \"", mesg, "\"",
+                        (char *)NULL);
+            }
+            return TCL_ERROR;
+        }
+        if (expand != NULL) {
+            if (CompileTimeFields(interp, fmtPtr, expand) != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else {
+            fmtPtr->numFields++;
+        }
+    }
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Blt_CompileTimeFormat --
+ *
+ *      Compiles the strptime-style pattern into a time format.
+ *
+ * Results:
+ *      Returns the compiled format or NULL if the pattern is invalid.
+ *      In that case an error message is left in the interpreter result.
+ *
+ *-----------------------------------------------------------------------------
+ */
+Blt_TimeFormat
+Blt_CompileTimeFormat(Tcl_Interp *interp, const char *pattern)
+{
+    struct _Blt_TimeFormat *fmtPtr;
+    size_t size;
+
+    /* Each character of the pattern compiles into at most one field,
+     * except %T and %D which expand to five fields from two
+     * characters. */
+    size = sizeof(struct _Blt_TimeFormat) + 
+        (3 * strlen(pattern) * sizeof(TimeField));
+    fmtPtr = Blt_AssertCalloc(1, size);
+    fmtPtr->pattern = (char *)Blt_AssertStrdup(pattern);
+    if (CompileTimeFields(interp, fmtPtr, pattern) != TCL_OK) {
+        Blt_FreeTimeFormat(fmtPtr);
+        return NULL;
+    }
+    return fmtPtr;
+}
+
+void
+Blt_FreeTimeFormat(Blt_TimeFormat fmtPtr)
+{
+    Blt_Free(fmtPtr->pattern);
+    Blt_Free(fmtPtr);
+}
+
+const char *
+Blt_TimeFormatPattern(Blt_TimeFormat fmtPtr)
+{
+    return fmtPtr->pattern;
+}
+
+/* Days from the epoch to the given (proleptic Gregorian) date.  The month
+ * is 1-12. */
+static int64_t
+DaysFromCivil(int64_t year, int mon, int mday)
+{
+    int64_t era, yoe, doy, doe;
+
+    year -= (mon <= 2);
+    era = ((year >= 0) ? year : year - 399) / 400;
+    yoe = year - era * 400;
+    doy = (153 * (mon + ((mon > 2) ? -3 : 9)) + 2) / 5 + mday - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static int
+ScanDigits(const char **sp, const char *end, int maxDigits, int *valuePtr)
+{
+    const char *s;
+    int value, n;
+
+    s = *sp;
+    while ((s < end) && ((*s == ' ') || (*s == '\t'))) {
+        s++;                            /* Allow space padding. */
+    }
+    value = n = 0;
+    while ((s < end) && (n < maxDigits) && (isdigit(UCHAR(*s)))) {
+        value = (value * 10) + (*s - '0');
+        s++, n++;
+    }
+    if (n == 0) {
+        return FALSE;
+    }
+    *sp = s;
+    *valuePtr = value;
+    return TRUE;
+}
+
+static int
+ScanName(const char **sp, const char *end, const char **names, int numNames,
+         int *valuePtr)
+{
+    const char *s;
+    int i;
+
+    s = *sp;
+    for (i = 0; i < numNames; i++) {
+        size_t length;
+
+        if (((end - s) < 3) || (strncasecmp(s, names[i], 3) != 0)) {
+            continue;
+        }
+        length = strlen(names[i]);
+        if (((size_t)(end - s) >= length) && 
+            (strncasecmp(s, names[i], length) == 0)) {
+            *sp = s + length;
+        } else {
+            *sp = s + 3;
+        }
+        *valuePtr = i;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static int
+ScanTimeFields(Blt_TimeFormat fmtPtr, const char *s, const char *end,
+               double *secondsPtr)
+{
+    int i;
+    int year, mon, mday, yday, hour, min, sec, tzoffset, pm;
+    int64_t epoch, numDays;
+    double frac;
+    int hasEpoch;
+
+    year = EPOCH, mon = 1, mday = 1, yday = 0;
+    hour = min = sec = tzoffset = 0;
+    pm = -1;
+    frac = 0.0;
+    epoch = 0;
+    hasEpoch = FALSE;
+    for (i = 0; i < fmtPtr->numFields; i++) {
+        TimeField *fieldPtr;
+
+        fieldPtr = fmtPtr->fields + i;
+        switch (fieldPtr->type) {
+        case FIELD_LITERAL:
+            if ((s >= end) || (*s != fieldPtr->c)) {
+                return FALSE;
+            }
+            s++;
+            break;
+        case FIELD_SPACE:
+            while ((s < end) && (isspace(UCHAR(*s)))) {
+                s++;
+            }
+            break;
+        case FIELD_YEAR:
+            if (!ScanDigits(&s, end, 4, &year)) {
+                return FALSE;
+            }
+            break;
+        case FIELD_YEAR2:
+            if (!ScanDigits(&s, end, 2, &year)) {
+                return FALSE;
+            }
+            year += (year < 69) ? 2000 : 1900;
+            break;
+        case FIELD_MONTH:
+            if ((!ScanDigits(&s, end, 2, &mon)) || (mon < 1) || (mon > 12)) {
+                return FALSE;
+            }
+            break;
+        case FIELD_MONTHNAME:
+            if (!ScanName(&s, end, monthNames, numMonths, &mon)) {
+                return FALSE;
+            }
+            mon++;
+            break;
+        case FIELD_WEEKDAY:
+            {
+                int wday;
+
+                if (!ScanName(&s, end, weekdayNames, numWeekdays, &wday)) {
+                    return FALSE;
+                }
+            }
+            break;
+        case FIELD_MDAY:
+            if ((!ScanDigits(&s, end, 2, &mday)) || (mday < 1)) {
+                return FALSE;
+            }
+            break;
+        case FIELD_YDAY:
+            if ((!ScanDigits(&s, end, 3, &yday)) || (yday < 1) || 
+                (yday > 366)) {
+                return FALSE;
+            }
+            break;
+        case FIELD_HOUR:
+            if ((!ScanDigits(&s, end, 2, &hour)) || (hour > 23)) {
+                return FALSE;
+            }
+            break;
+        case FIELD_HOUR12:
+            if ((!ScanDigits(&s, end, 2, &hour)) || (hour < 1) ||
+                (hour > 12)) {
+                return FALSE;
+            }
+            break;
+        case FIELD_MINUTE:
+            if ((!ScanDigits(&s, end, 2, &min)) || (min > 59)) {
+                return FALSE;
+            }
+            break;
+        case FIELD_SECOND:
+            if ((!ScanDigits(&s, end, 2, &sec)) || (sec > 60)) {
+                return FALSE;
+            }
+            break;
+        case FIELD_FRACTION:
+            {
+                double scale;
+
+                if ((s >= end) || (!isdigit(UCHAR(*s)))) {
+                    return FALSE;
+                }
+                scale = 0.1;
+                while ((s < end) && (isdigit(UCHAR(*s)))) {
+                    frac += (*s - '0') * scale;
+                    scale *= 0.1;
+                    s++;
+                }
+            }
+            break;
+        case FIELD_AMPM:
+            if ((end - s) < 2) {
+                return FALSE;
+            }
+            if (strncasecmp(s, "am", 2) == 0) {
+                pm = FALSE;
+            } else if (strncasecmp(s, "pm", 2) == 0) {
+                pm = TRUE;
+            } else {
+                return FALSE;
+            }
+            s += 2;
+            break;
+        case FIELD_TZOFFSET:
+            {
+                int sign, hours, mins;
+
+                if ((s < end) && ((*s == 'Z') || (*s == 'z'))) {
+                    s++;
+                    tzoffset = 0;
+                    break;
+                }
+                if ((s >= end) || ((*s != '+') && (*s != '-'))) {
+                    return FALSE;
+                }
+                sign = (*s == '-') ? 1 : -1;
+                s++;
+                if ((end - s) < 2) {
+                    return FALSE;
+                }
+                if ((!isdigit(UCHAR(s[0]))) || (!isdigit(UCHAR(s[1])))) {
+                    return FALSE;
+                }
+                hours = (s[0] - '0') * 10 + (s[1] - '0');
+                s += 2;
+                mins = 0;
+                if ((s < end) && (*s == ':')) {
+                    s++;
+                }
+                if (((end - s) >= 2) && (isdigit(UCHAR(s[0]))) && 
+                    (isdigit(UCHAR(s[1])))) {
+                    mins = (s[0] - '0') * 10 + (s[1] - '0');
+                    s += 2;
+                }
+                tzoffset = sign * ((hours * SECONDS_HOUR) + 
+                                   (mins * SECONDS_MINUTE));
+            }
+            break;
+        case FIELD_EPOCH:
+            {
+                int sign, n;
+
+                sign = 1;
+                if ((s < end) && ((*s == '-') || (*s == '+'))) {
+                    sign = (*s == '-') ? -1 : 1;
+                    s++;
+                }
+                epoch = 0;
+                for (n = 0; (s < end) && (n < 18) && (isdigit(UCHAR(*s))); 
+                     n++, s++) {
+                    epoch = (epoch * 10) + (*s - '0');
+                }
+                if (n == 0) {
+                    return FALSE;
+                }
+                epoch *= sign;
+                hasEpoch = TRUE;
+            }
+            break;
+        }
+    }
+    while ((s < end) && (isspace(UCHAR(*s)))) {
+        s++;
+    }
+    if (s != end) {
+        return FALSE;                   /* Extra characters. */
+    }
+    if (hasEpoch) {
+        *secondsPtr = (double)epoch + frac;
+        return TRUE;
+    }
+    if (pm >= 0) {
+        if (hour == 12) {
+            hour = 0;
+        }
+        if (pm) {
+            hour += 12;
+        }
+    }
+    if (yday > 0) {
+        if (yday > numDaysYear[IsLeapYear(year)]) {
+            return FALSE;
+        }
+        numDays = DaysFromCivil(year, 1, 1) + yday - 1;
+    } else {
+        if (mday > numDaysMonth[IsLeapYear(year)][mon - 1]) {
+            return FALSE;
+        }
+        numDays = DaysFromCivil(year, mon, mday);
+    }
+    *secondsPtr = (double)(numDays * SECONDS_DAY + tzoffset + 
+        (hour * SECONDS_HOUR) + (min * SECONDS_MINUTE) + sec) + frac;
+    return TRUE;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Blt_ParseTimeWithFormat --
+ *
+ *      Converts a date string that follows the compiled format into the
+ *      number of seconds from the epoch (GMT time).  The string doesn't
+ *      need to be NUL terminated.  If length is negative, the string is
+ *      read up to the NUL byte.
+ *
+ * Results:
+ *      A standard TCL result.  If the string doesn't match the format,
+ *      TCL_ERROR is returned and, if interp isn't NULL, an error message
+ *      is left in the interpreter result.
+ *
+ *-----------------------------------------------------------------------------
+ */
+int
+Blt_ParseTimeWithFormat(Tcl_Interp *interp, Blt_TimeFormat fmtPtr,
+                        const char *string, int length, double *secondsPtr)
+{
+    if (length < 0) {
+        length = strlen(string);
+    }
+    if (ScanTimeFields(fmtPtr, string, string + length, secondsPtr)) {
+        return TCL_OK;
+    }
+    if (interp != NULL) {
+        Tcl_Obj *objPtr;
+
+        objPtr = Tcl_NewStringObj("bad time \"", -1);
+        Tcl_AppendToObj(objPtr, string, length);
+        Tcl_AppendStringsToObj(objPtr, "\": doesn't match format \"",
+                fmtPtr->pattern, "\"", (char *)NULL);
+        Tcl_SetObjResult(interp, objPtr);
+    }
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Blt_ParseTimesWithFormat --
+ *
+ *      Converts a buffer of date strings that follow the compiled format.
+ *      The strings are concatenated in the buffer and offsets holds
+ *      numValues + 1 ascending offsets into it, so that importers can
+ *      convert a whole block of values at once.
+ *
+ * Results:
+ *      A standard TCL result.  The seconds for each string are returned
+ *      in the array.  If a string doesn't match the format, TCL_ERROR is
+ *      returned and, if interp isn't NULL, an error message is left in
+ *      the interpreter result.
+ *
+ *-----------------------------------------------------------------------------
+ */
+int
+Blt_ParseTimesWithFormat(Tcl_Interp *interp, Blt_TimeFormat fmtPtr,
+                         long numValues, const char *buffer,
+                         const int64_t *offsets, double *seconds)
+{
+    long i;
+
+    for (i = 0; i < numValues; i++) {
+        if (Blt_ParseTimeWithFormat(interp, fmtPtr, buffer + offsets[i], 
+                (int)(offsets[i + 1] - offsets[i]), seconds + i) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+    return TCL_OK;
+}
+
 /*
  *-----------------------------------------------------------------------------
  *
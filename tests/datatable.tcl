@@ -16,7 +16,8 @@ test datatable.1 {datatable no args} {
   blt::datatable destroy ?tableName ...?
   blt::datatable exists tableName
   blt::datatable load tableName libpath
-  blt::datatable names ?pattern ...?}}
+  blt::datatable names ?pattern ...?
+  blt::datatable open -mmap fileName ?tableName?}}
 
 test datatable.2 {datatable create #auto} {
     list [catch {blt::datatable create #auto} msg] $msg
@@ -170,6 +171,7 @@ test datatable.28 {datatable0} {
     } msg] $msg
 } {1 {wrong # args: should be one of...
   datatable0 add tableName ?switches?
+  datatable0 aggregate ?switches?
   datatable0 append rowName columnName ?value ...?
   datatable0 attach tableName
   datatable0 column op args...
@@ -184,6 +186,8 @@ test datatable.28 {datatable0} {
   datatable0 find exprString ?switches?
   datatable0 get rowName columnName ?defValue?
   datatable0 import formatName args...
+  datatable0 index op args...
+  datatable0 join srcTableName ?switches?
   datatable0 keys ?columnName ...?
   datatable0 lappend rowName columnName ?value ...?
   datatable0 limits ?columnName?
@@ -193,11 +197,13 @@ test datatable.28 {datatable0} {
   datatable0 numcolumns ?numColumns?
   datatable0 numrows ?numRows?
   datatable0 pack 
+  datatable0 range columnName low high
   datatable0 restore ?switches?
   datatable0 row op args...
   datatable0 set ?rowName columnName value ...?
   datatable0 sort ?flags ...?
   datatable0 trace op args...
+  datatable0 transaction script
   datatable0 unset ?rowName columnName ...?
   datatable0 watch op args...}}
 
@@ -207,6 +213,7 @@ test datatable.29 {datatable0 badOp} {
     } msg] $msg
 } {1 {bad operation "badOp": should be one of...
   datatable0 add tableName ?switches?
+  datatable0 aggregate ?switches?
   datatable0 append rowName columnName ?value ...?
   datatable0 attach tableName
   datatable0 column op args...
@@ -221,6 +228,8 @@ test datatable.29 {datatable0 badOp} {
   datatable0 find exprString ?switches?
   datatable0 get rowName columnName ?defValue?
   datatable0 import formatName args...
+  datatable0 index op args...
+  datatable0 join srcTableName ?switches?
   datatable0 keys ?columnName ...?
   datatable0 lappend rowName columnName ?value ...?
   datatable0 limits ?columnName?
@@ -230,11 +239,13 @@ test datatable.29 {datatable0 badOp} {
   datatable0 numcolumns ?numColumns?
   datatable0 numrows ?numRows?
   datatable0 pack 
+  datatable0 range columnName low high
   datatable0 restore ?switches?
   datatable0 row op args...
   datatable0 set ?rowName columnName value ...?
   datatable0 sort ?flags ...?
   datatable0 trace op args...
+  datatable0 transaction script
   datatable0 unset ?rowName columnName ...?
   datatable0 watch op args...}}
 
@@ -255,6 +266,7 @@ test datatable.31 {datatable0 column badOp} {
   datatable0 column delete ?columnName ...?
   datatable0 column duplicate ?columnName ...?
   datatable0 column empty columnName
+  datatable0 column encoding columnName ?encodingName?
   datatable0 column exists columnName
   datatable0 column extend numColumns ?switches?
   datatable0 column get columnName ?switches?
@@ -267,10 +279,13 @@ test datatable.31 {datatable0 column badOp} {
   datatable0 column names ?pattern ...?
   datatable0 column nonempty columnName
   datatable0 column set columnName rowName ?value ...?
+  datatable0 column stats columnName
   datatable0 column tag op args...
+  datatable0 column timeformat columnName ?pattern?
   datatable0 column type columnName ?typeName columnName typeName ...?
   datatable0 column unset columnName ?indices ...?
-  datatable0 column values columnName ?valueList?}}
+  datatable0 column values columnName ?valueList?
+  datatable0 column window srcColumn destColumn ?switches?}}
 
 test datatable.32 {datatable0 row (wrong \# args)} {
     list [catch {
@@ -286,7 +301,7 @@ test datatable.33 {datatable0 row badOp} {
 } {1 {bad operation "badOp": should be one of...
   datatable0 row copy destRow srcRow ?switches?
   datatable0 row create ?switches...?
-  datatable0 row delete ?rowName ...?
+  datatable0 row delete ?switches? ?rowName ...?
   datatable0 row duplicate ?rowName ...?
   datatable0 row empty rowName
   datatable0 row exists rowName
@@ -328,6 +343,7 @@ test datatable.37 {datatable0 column -label xyz create} {
   datatable0 column delete ?columnName ...?
   datatable0 column duplicate ?columnName ...?
   datatable0 column empty columnName
+  datatable0 column encoding columnName ?encodingName?
   datatable0 column exists columnName
   datatable0 column extend numColumns ?switches?
   datatable0 column get columnName ?switches?
@@ -340,10 +356,13 @@ test datatable.37 {datatable0 column -label xyz create} {
   datatable0 column names ?pattern ...?
   datatable0 column nonempty columnName
   datatable0 column set columnName rowName ?value ...?
+  datatable0 column stats columnName
   datatable0 column tag op args...
+  datatable0 column timeformat columnName ?pattern?
   datatable0 column type columnName ?typeName columnName typeName ...?
   datatable0 column unset columnName ?indices ...?
-  datatable0 column values columnName ?valueList?}}
+  datatable0 column values columnName ?valueList?
+  datatable0 column window srcColumn destColumn ?switches?}}
 
 test datatable.38 {column extend 5} {
     list [catch {datatable0 column extend 5} msg] $msg
@@ -1081,8 +1100,10 @@ test datatable.204 {column create -before 1 -badSwitch} {
 The following switches are available:
    -after columnName
    -before columnName
+   -encoding encodingName
    -label string
    -tags tagList
+   -timeformat pattern
    -type columnType}}
 
 test datatable.205 {datatable0 column create -badSwitch -before 1} {
@@ -1091,8 +1112,10 @@ test datatable.205 {datatable0 column create -badSwitch -before 1} {
 The following switches are available:
    -after columnName
    -before columnName
+   -encoding encodingName
    -label string
    -tags tagList
+   -timeformat pattern
    -type columnType}}
 
 test datatable.206 {datatable0 column create -before 1 -badSwitch arg} {
@@ -1101,8 +1124,10 @@ test datatable.206 {datatable0 column create -before 1 -badSwitch arg} {
 The following switches are available:
    -after columnName
    -before columnName
+   -encoding encodingName
    -label string
    -tags tagList
+   -timeformat pattern
    -type columnType}}
 
 test datatable.207 {datatable0 column create -before 1 -label nc1} {
@@ -1964,7 +1989,7 @@ test datatable.347 {row -label xyz create} {
 } {1 {bad operation "-label": should be one of...
   datatable4 row copy destRow srcRow ?switches?
   datatable4 row create ?switches...?
-  datatable4 row delete ?rowName ...?
+  datatable4 row delete ?switches? ?rowName ...?
   datatable4 row duplicate ?rowName ...?
   datatable4 row empty rowName
   datatable4 row exists rowName
@@ -3025,6 +3050,7 @@ test datatable.538 {datatable0 dump -badSwitch} {
     list [catch {datatable0 dump -badSwitch} msg] $msg
 } {1 {unknown switch "-badSwitch"
 The following switches are available:
+   -binary 
    -rows rows
    -columns columns
    -file fileName}}
@@ -3215,6 +3241,1870 @@ test datatable.552 {dirtest dir /tmp} {
 "defs","file",420
 }}
 
+test datatable.553 {sort -columns with doubles, empties last} {
+    list [catch {
+	set table [blt::datatable create]
+	$table column create -label x -type double
+	$table row create -label a
+	$table row create -label b
+	$table row create -label c
+	$table row create -label d
+	$table set a x 2.5 b x -1.0 d x 2.5
+	set out [$table sort -columns x -labels]
+	blt::datatable destroy $table
+	set out
+    } msg] $msg
+} {0 {b a d c}}
+
+test datatable.554 {sort -columns -decreasing reverses ties and empties} {
+    list [catch {
+	set table [blt::datatable create]
+	$table column create -label x -type long
+	$table row create -label a
+	$table row create -label b
+	$table row create -label c
+	$table row create -label d
+	$table set a x 3 b x 10 d x 3
+	set out [$table sort -columns x -decreasing -labels]
+	blt::datatable destroy $table
+	set out
+    } msg] $msg
+} {0 {c b d a}}
+
+test datatable.555 {sort multiple columns, dictionary order} {
+    list [catch {
+	set table [blt::datatable create]
+	$table column create -label g -type long
+	$table column create -label s
+	foreach {g s} { 1 x10 0 x9 1 X9 0 apple 1 x9 0 Apple } {
+	    set row [$table row create]
+	    $table set $row g $g $row s $s
+	}
+	set out [$table sort -columns {g s} -values]
+	lappend out [$table sort -columns {g s} -indices]
+	blt::datatable destroy $table
+	set out
+    } msg] $msg
+} {0 {0 0 0 1 1 1 {5 3 1 2 4 0}}}
+
+test datatable.556 {sort -ascii -nocase} {
+    list [catch {
+	set table [blt::datatable create]
+	$table column create -label s
+	foreach s { banana Apple cherry apple Banana } {
+	    set row [$table row create]
+	    $table set $row s $s
+	}
+	set out [$table sort -columns s -ascii -nocase -values]
+	blt::datatable destroy $table
+	set out
+    } msg] $msg
+} {0 {Apple apple banana Banana cherry}}
+
+test datatable.557 {sort -alter keeps all rows linked} {
+    list [catch {
+	set table [blt::datatable create]
+	$table column create -label x -type double
+	$table row extend 6
+	$table column values x { 5 3 6 1 4 2 }
+	$table sort -columns x -alter
+	set out [$table column values x]
+	blt::datatable destroy $table
+	set out
+    } msg] $msg
+} {0 {1.0 2.0 3.0 4.0 5.0 6.0}}
+
+test datatable.558 {find with numeric columns and constants} {
+    list [catch {
+	set table [blt::datatable create]
+	$table column create -label x -type double
+	$table column create -label k -type long
+	$table row extend 6
+	$table column values x { 1.5 -2 3 4.25 5 6 }
+	$table column values k { 1 2 3 4 5 6 }
+	set out [$table find { ($x > 2 && $k % 2 == 0) || -$x == 2 }]
+	blt::datatable destroy $table
+	set out
+    } msg] $msg
+} {0 {1 3 5}}
+
+test datatable.559 {find with string columns, eq, and string match} {
+    list [catch {
+	set table [blt::datatable create]
+	$table column create -label s
+	$table row extend 5
+	$table column values s { apple Banana cherry banana 10 }
+	set out [list \
+	    [$table find { $s eq "banana" }] \
+	    [$table find { $s != "cherry" } -invert] \
+	    [$table find { [string match -nocase b* $s] }] \
+	    [$table find { $s > 9 && $s < 100 } -maxrows 1]]
+	blt::datatable destroy $table
+	set out
+    } msg] $msg
+} {0 {3 2 {1 3} 4}}
+
+test datatable.560 {find evaluates empty and non-numeric values like expr} {
+    list [catch {
+	set table [blt::datatable create]
+	$table column create -label s
+	$table row extend 5
+	$table column values s { 0x10 010 " 16" 16 }
+	set out [$table find { $s == 16 } -emptyvalue 16]
+	blt::datatable destroy $table
+	set out
+    } msg] $msg
+} {0 {0 2 3 4}}
+
+test datatable.561 {find reports expression errors for the offending row} {
+    list [catch {
+	set table [blt::datatable create]
+	$table column create -label k -type long
+	$table row extend 3
+	$table column values k { 1 2 0 }
+	$table find { 10 / $k > 1 }
+    } msg] $msg
+} {1 {divide by zero}}
+
+test datatable.562 {numeric columns keep the strings they were set from} {
+    list [catch {
+	set table [blt::datatable create]
+	$table column create -label x -type long
+	$table row extend 3
+	$table set 0 x +16 1 x 20 2 x 016
+	catch { $table set 2 x 1e2 }
+	set out [list [$table column values x] [$table get 0 x] \
+		     [$table export csv]]
+	$table column type x double
+	$table set 1 x 0.1
+	lappend out [$table column values x] [$table export csv]
+	blt::datatable destroy $table
+	set out
+    } msg] $msg
+} {0 {{16 20 16} 16 {"x"
++16
+20
+016
+} {16.0 0.1 16.0} {"x"
++16
+0.1
+016
+}}}
+
+test datatable.563 {dump -binary and restore -binary round trip} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label d -type double -tags {x y}
+	$t1 column create -label l -type long
+	$t1 column create -label s
+	$t1 row extend 4
+	$t1 row tag add myTag 1 3
+	$t1 set 0 d 1.5 0 l +16 0 s "hello world" 1 d 0.1 2 s {}
+	$t1 set 3 l -7 3 s "a much longer string value"
+	set t2 [blt::datatable create]
+	$t2 restore -binary -data [$t1 dump -binary]
+	set out [string equal [$t1 dump] [$t2 dump]]
+	$t1 dump -binary -file tmpdata.bin
+	$t2 restore -binary -overwrite -file tmpdata.bin
+	lappend out [string equal [$t1 dump] [$t2 dump]]
+	lappend out [$t2 get 0 l] [$t2 row tag indices myTag]
+	file delete tmpdata.bin
+	blt::datatable destroy $t1 $t2
+	set out
+    } msg] $msg
+} {0 {1 1 16 {1 3}}}
+
+test datatable.564 {restore -binary bad data} {
+    list [catch {
+	set t1 [blt::datatable create]
+	set code [catch {$t1 restore -binary -data "i 1 1 0 0"} out]
+	blt::datatable destroy $t1
+	list $code $out
+    } msg] $msg
+} {0 {1 {bad datatable snapshot: too short}}}
+
+test datatable.565 {open -mmap} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label d -type double
+	$t1 column create -label l -type long
+	$t1 column create -label s
+	$t1 row extend 3
+	$t1 set 0 d 1.5 0 l 10 0 s "hello" 2 d -2.25 2 l 30
+	$t1 dump -binary -file tmpdata.bin
+	set t2 [blt::datatable open -mmap tmpdata.bin]
+	set out [string equal [$t1 dump] [$t2 dump]]
+	lappend out [$t2 get 0 d] [$t2 get 2 l] [$t2 get 0 s]
+	$t2 set 1 d 4.0
+	lappend out [$t2 get 1 d]
+	$t2 row extend 1
+	$t2 set 3 l 40
+	lappend out [$t2 column values l]
+	set t3 [blt::datatable open -mmap tmpdata.bin]
+	lappend out [string equal [$t1 dump] [$t3 dump]]
+	file delete tmpdata.bin
+	blt::datatable destroy $t1 $t2 $t3
+	set out
+    } msg] $msg
+} {0 {1 1.5 30 hello 4.0 {10 {} 30 40} 1}}
+
+test datatable.566 {open -mmap missing file} {
+    list [catch {
+	blt::datatable open -mmap nosuchfile.bin
+    } msg] [string match {can't open "nosuchfile.bin": *} $msg]
+} {1 1}
+
+test datatable.567 {import csv -threads} {
+    list [catch {
+	set data {}
+	for { set i 0 } { $i < 200 } { incr i } {
+	    append data "$i,\"line $i\nnext, \"\"q\"\"\", plain $i \n"
+	}
+	set t1 [blt::datatable create]
+	set t2 [blt::datatable create]
+	$t1 import csv -data $data
+	$t2 import csv -data $data -threads 4
+	set out [string equal [$t1 dump] [$t2 dump]]
+	lappend out [$t2 numrows] [$t2 get 199 c2] [$t2 get 199 c3]
+	blt::datatable destroy $t1 $t2
+	set out
+    } msg] $msg
+} {0 {1 200 {line 199
+next, "q"} {plain 199}}}
+
+test datatable.568 {import csv -maxrows} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 import csv -data "a,b\n1,2\n3,4\n5,6" -maxrows 2
+	set out [list [$t1 numrows] [$t1 column values c1]]
+	blt::datatable destroy $t1
+	set out
+    } msg] $msg
+} {0 {2 {a 1}}}
+
+test datatable.569 {lookup follows key edits} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label a -type long
+	$t1 column create -label s
+	$t1 set 0 a 1 0 s x
+	$t1 set 1 a 2 1 s y
+	$t1 keys a s
+	set out [list [$t1 lookup 2 y]]
+	$t1 set 2 a 3 2 s z
+	lappend out [$t1 lookup 3 z]
+	$t1 set 1 s w
+	lappend out [$t1 lookup 2 y] [$t1 lookup 2 w]
+	$t1 row delete 0
+	lappend out [$t1 lookup 1 x] [$t1 lookup 3 z]
+	$t1 unset 1 s
+	lappend out [$t1 lookup 3 z]
+	blt::datatable destroy $t1
+	set out
+    } msg] $msg
+} {0 {1 2 -1 1 -1 1 -1}}
+
+test datatable.570 {index create -unique} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label x -type long
+	$t1 row extend 3
+	$t1 set 0 x 5 1 x 7 2 x 5
+	$t1 index create x -unique
+    } msg] $msg
+} {1 {column "x" has duplicate values in rows 0 and 2}}
+
+test datatable.571 {range follows edits of an indexed column} {
+    list [catch {
+	$t1 set 2 x 1
+	$t1 index create x -unique
+	set out [list [$t1 index names] [$t1 range x 0 6]]
+	$t1 row extend 2
+	$t1 set 3 x 3 4 x 6
+	lappend out [$t1 range x 0 6]
+	$t1 unset 0 x
+	$t1 row delete 2
+	lappend out [$t1 range x 0 100] [$t1 limits x]
+    } msg] $msg
+} {0 {x {2 0} {2 3 0 4} {2 3 1} {3 7}}}
+
+test datatable.572 {find uses the index} {
+    list [catch {
+	set out [$t1 find {$x >= 4 && $x < 7} -emptyvalue 0]
+	lappend out [$t1 find {$x > 0 && $x != 6} -emptyvalue 0]
+	lappend out [$t1 find {$x > 0} -emptyvalue 1]
+	lappend out [catch {$t1 find {$x > 0}}]
+	$t1 column type x double
+	lappend out [$t1 range x 3.5 7] [$t1 limits x]
+    } msg] $msg
+} {0 {3 {1 2} {0 1 2 3} 1 {3 1} {3.0 7.0}}}
+
+test datatable.573 {index delete} {
+    list [catch {
+	$t1 index delete x
+	set out [list [$t1 index names] [$t1 range x 3.5 7]]
+	blt::datatable destroy $t1
+	set out
+    } msg] $msg
+} {0 {{} {3 1}}}
+
+test datatable.704 {set duplicate value after index create -unique} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label x -type long
+	$t1 column create -label s
+	$t1 row extend 3
+	$t1 set 0 x 5 1 x 7 0 s a 1 s b
+	$t1 index create x -unique
+	$t1 index create s -unique
+	set out [list [catch {$t1 set 2 x 7} msg] $msg]
+	lappend out [catch {$t1 set 1 s a} msg] $msg
+	lappend out [$t1 column values x] [$t1 column values s]
+	$t1 set 1 x 7 1 s b
+	$t1 unset 0 x
+	$t1 set 2 x 5 0 s c 2 s a
+	lappend out [$t1 column values x] [$t1 range x 0 10] \
+	    [$t1 column values s]
+	blt::datatable destroy $t1
+	set out
+    } msg] $msg
+} {0 {1 {column "x" is unique: row 1 already has the value} 1 {column "s" is unique: row 0 already has the value} {5 7 {}} {a b {}} {{} 7 5} {2 1} {c b a}}}
+
+test datatable.574 {row tags follow rows} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 row extend 6
+	$t1 row tag add even 0 2 4
+	$t1 row tag add odd 5 3 1
+	set out [list [$t1 row tag indices odd]]
+	$t1 row delete 2 3
+	$t1 row extend 1
+	lappend out [$t1 row tag indices even] [$t1 row tag indices odd] \
+	    [$t1 row tag get 4]
+	$t1 pack
+	lappend out [$t1 row tag labels even] [$t1 row tag indices even]
+    } msg] $msg
+} {0 {{1 3 5} {0 2} {1 3} {} {r1 r5} {0 2}}}
+
+test datatable.575 {row tag with many rows} {
+    list [catch {
+	$t1 row extend 99995
+	$t1 row tag range 0 99999 big
+	for { set i 0 } { $i < 100000 } { incr i 2 } {
+	    $t1 row tag unset $i big
+	}
+	set out [list [llength [$t1 row tag indices big]] \
+		     [$t1 row tag exists big 99999] [$t1 row tag exists big 2]]
+	$t1 row tag forget big
+	lappend out [$t1 row tag exists big]
+	blt::datatable destroy $t1
+	set out
+    } msg] $msg
+} {0 {50000 1 0 0}}
+
+test datatable.576 {aggregate -groupby -count -sum -mean} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column extend 3 -labels {a x y}
+	$t1 column type x integer
+	$t1 column type y double
+	$t1 row extend 5
+	$t1 column values a {p q p q p}
+	$t1 column values x {10 20 30 5 7}
+	$t1 set 0 y 1.5 1 y 2.5 2 y 3.5 4 y 0.5
+	set t2 [$t1 aggregate -groupby a -count * -sum x -mean y -count y]
+	set out {}
+	foreach c [$t2 column names] {
+	    lappend out $c [$t2 column type $c] [$t2 column values $c]
+	}
+	blt::datatable destroy $t2
+	set out
+    } msg] $msg
+} {0 {a string {p q} count long {3 2} x_sum long {47 25} y_mean double {1.8333333333333333 2.5} y_count long {3 1}}}
+
+test datatable.577 {aggregate -min -max -rows without -groupby} {
+    list [catch {
+	set t2 [$t1 aggregate -min {x y} -max x -rows {1 2 3}]
+	set out [$t2 row get 0]
+	blt::datatable destroy $t2
+	set out
+    } msg] $msg
+} {0 {0 5 1 2.5 2 30}}
+
+test datatable.578 {aggregate -threads -into} {
+    list [catch {
+	set t2 [blt::datatable create]
+	set out [expr {[$t1 aggregate -groupby {a x} -count * -threads 4 \
+			    -into $t2] eq $t2}]
+	lappend out [$t2 numrows] [$t2 column values a] [$t2 column values x]
+	blt::datatable destroy $t2
+	set out
+    } msg] $msg
+} {0 {1 5 {p q p q p} {10 20 30 5 7}}}
+
+test datatable.579 {aggregate -sum string column} {
+    list [catch {
+	$t1 aggregate -sum a
+    } msg] $msg
+} {1 {value "p" in row "r1" of column "a" is not a number}}
+
+test datatable.580 {aggregate -into same table} {
+    list [catch {
+	$t1 aggregate -groupby a -into $t1
+    } msg] $msg
+} {1 {can't aggregate into the same table}}
+
+test datatable.581 {join -on} {
+    list [catch {
+	set t2 [blt::datatable create]
+	$t2 column extend 3 -labels {key name w}
+	$t2 column type key integer
+	$t2 column type w double
+	$t2 row extend 3
+	$t2 column values key {10 30 10}
+	$t2 column values name {ten thirty dix}
+	$t2 column values w {1.5 2.5 3.5}
+	$t1 join $t2 -on {x key}
+	list [$t1 numrows] [$t1 column names] [$t1 column type w] \
+	    [$t1 column values a] [$t1 column values name] [$t1 column values w]
+    } msg] $msg
+} {0 {6 {a x y name w} double {p q p q p p} {ten {} thirty {} {} dix} {1.5 {} 2.5 {} {} 3.5}}}
+
+test datatable.582 {join -type inner -columns} {
+    list [catch {
+	set t3 [blt::datatable create]
+	$t3 column extend 1 -labels {k}
+	$t3 row extend 4
+	$t3 column values k {30 11 10 {}}
+	$t3 join $t2 -on {k key} -type inner -columns name
+	list [$t3 column names] [$t3 column values k] [$t3 column values name]
+    } msg] $msg
+} {0 {{k name} {30 10 10} {thirty ten dix}}}
+
+test datatable.583 {join -type badType} {
+    list [catch {
+	$t3 join $t2 -on {k key} -type outer
+    } msg] $msg
+} {1 {bad join type "outer": should be inner or left}}
+
+test datatable.584 {join -on oddList} {
+    list [catch {
+	$t3 join $t2 -on {k}
+    } msg] $msg
+} {1 {odd # of columns in -on list: should be "columnName srcColumnName..."}}
+
+test datatable.585 {join (no -on)} {
+    list [catch {
+	$t3 join $t2
+    } msg] $msg
+} {1 {missing -on switch}}
+
+test datatable.586 {join after destroy} {
+    list [catch {
+	blt::datatable destroy $t2
+	$t3 join $t2 -on {k key}
+    } msg] [string match {*can't find*} $msg]
+} {1 1}
+
+test datatable.587 {column create -encoding dictionary} {
+    list [catch {
+	set t4 [blt::datatable create]
+	$t4 column create -label status -encoding dictionary
+	$t4 row extend 6
+	$t4 column values status {open closed open pending open closed}
+	list [$t4 column encoding status] [$t4 column values status]
+    } msg] $msg
+} {0 {dictionary {open closed open pending open closed}}}
+
+test datatable.588 {find with dictionary encoded column} {
+    list [catch {
+	list [$t4 find {$status eq "open"}] [$t4 find {"closed" != $status}] \
+	    [$t4 find {$status eq "missing"}]
+    } msg] $msg
+} {0 {{0 2 4} {0 2 3 4} {}}}
+
+test datatable.589 {sort dictionary encoded column} {
+    list [catch {
+	$t4 set 5 status Apple
+	list [$t4 sort -columns status] [$t4 sort -columns status -decreasing]
+    } msg] $msg
+} {0 {{5 1 0 2 4 3} {3 4 2 0 1 5}}}
+
+test datatable.590 {column encoding none} {
+    list [catch {
+	$t4 unset 1 status
+	$t4 column encoding status none
+	list [$t4 column encoding status] [$t4 column values status]
+    } msg] $msg
+} {0 {none {open {} open pending open Apple}}}
+
+test datatable.591 {column encoding (not string)} {
+    list [catch {
+	$t4 column create -label n -type double
+	$t4 column encoding n dictionary
+    } msg] $msg
+} {1 {can't encode column "n": only string columns can be dictionary encoded}}
+
+test datatable.592 {column encoding badEncoding} {
+    list [catch {
+	$t4 column encoding status badEncoding
+    } msg] $msg
+} {1 {unknown column encoding "badEncoding": should be none or dictionary}}
+
+test datatable.593 {column type removes encoding} {
+    list [catch {
+	$t4 column encoding status dictionary
+	$t4 column type status blob
+	set result [$t4 column encoding status]
+	blt::datatable destroy $t4
+	set result
+    } msg] $msg
+} {0 none}
+
+test datatable.594 {transaction fires each trace once} {
+    list [catch {
+	set t5 [blt::datatable create]
+	$t5 column create -type int -label a
+	$t5 column create -type int -label b
+	$t5 numrows 5
+	set events {}
+	proc TraceBatch { table row col ops } {
+	    lappend ::events [list $row $col $ops]
+	}
+	$t5 trace column all wcu TraceBatch
+	$t5 transaction {
+	    for { set i 0 } { $i < 5 } { incr i } {
+		$t5 set $i a $i
+	    }
+	    $t5 set 2 b 7
+	}
+	set events
+    } msg] $msg
+} {0 {{0-4 0-1 wcb}}}
+
+test datatable.595 {transaction with per-cell trace} {
+    list [catch {
+	set events {}
+	$t5 trace column b we TraceBatch
+	$t5 transaction {
+	    $t5 set 3 b 8
+	}
+	set events
+    } msg] $msg
+} {0 {{3 1 wc} {3-3 1-1 wcb}}}
+
+test datatable.596 {nested transactions} {
+    list [catch {
+	set events {}
+	$t5 transaction {
+	    $t5 transaction {
+		$t5 set 0 a 10
+	    }
+	    set inner $events
+	}
+	list $inner $events
+    } msg] $msg
+} {0 {{} {{0-0 0-0 wb}}}}
+
+test datatable.597 {transaction script error} {
+    list [catch {
+	set events {}
+	set code [catch {$t5 transaction { $t5 set 1 a 11; error "oops" }} msg2]
+	list $code $msg2 $events
+    } msg] $msg
+} {0 {1 oops {{1-1 0-0 wb}}}}
+
+test datatable.598 {transaction ignores deleted rows} {
+    list [catch {
+	set events {}
+	$t5 transaction {
+	    $t5 set 4 a 12
+	    $t5 row delete 4
+	}
+	set events
+    } msg] $msg
+} {0 {}}
+
+test datatable.599 {transaction trace flags} {
+    list [catch {
+	array set info [$t5 trace info trace1]
+	blt::datatable destroy $t5
+	set info(flags)
+    } msg] $msg
+} {0 we}
+
+test datatable.600 {transaction badArgs} {
+    list [catch {datatable0 transaction} msg] $msg
+} {1 {wrong # args: should be "datatable0 transaction script"}}
+
+test datatable.601 {duplicate shares values until changed} {
+    list [catch {
+	set cow1 [blt::datatable create]
+	$cow1 column create -label s
+	$cow1 column create -label d -type double
+	$cow1 set 0 s a 1 s b 2 s c 0 d 1.5 1 d 2.5 2 d 3.5
+	set cow2 [$cow1 duplicate]
+	$cow2 set 1 s x 2 d 9.5
+	list [$cow1 column values s] [$cow1 column values d] \
+	    [$cow2 column values s] [$cow2 column values d]
+    } msg] $msg
+} {0 {{a b c} {1.5 2.5 3.5} {a x c} {1.5 2.5 9.5}}}
+
+test datatable.602 {change original after duplicate} {
+    list [catch {
+	$cow1 set 0 s y
+	$cow1 column unset d 0
+	list [$cow1 column values s] [$cow1 column values d] \
+	    [$cow2 column values s] [$cow2 column values d]
+    } msg] $msg
+} {0 {{y b c} {{} 2.5 3.5} {a x c} {1.5 2.5 9.5}}}
+
+test datatable.603 {delete rows and pack after duplicate} {
+    list [catch {
+	set cow3 [$cow2 duplicate]
+	$cow3 row delete 0
+	$cow2 pack
+	$cow3 row create -label new
+	$cow3 set new s z
+	list [$cow2 column values s] [$cow3 column values s] \
+	    [$cow3 column values d]
+    } msg] $msg
+} {0 {{a x c} {x c z} {2.5 9.5 {}}}}
+
+test datatable.699 {row extend after duplicate} {
+    list [catch {
+	set cow4 [blt::datatable create]
+	$cow4 column create -label d -type double
+	$cow4 column create -label s
+	$cow4 column create -label e -encoding dictionary
+	$cow4 row extend 3
+	$cow4 column values d {1.5 2.5 3.5}
+	$cow4 column values s {a b c}
+	$cow4 column values e {red blue red}
+	set cow5 [$cow4 duplicate]
+	$cow5 row extend 100
+	$cow5 set 102 d 4.5 102 s d 102 e green
+	list [$cow4 column values d] [$cow4 numrows] [$cow5 numrows] \
+	    [$cow5 get 0 d] [$cow5 get 2 s] [$cow5 get 1 e] [$cow5 get 102 e]
+    } msg] $msg
+} {0 {{1.5 2.5 3.5} 3 103 1.5 c blue green}}
+
+test datatable.700 {row create after duplicate} {
+    list [catch {
+	blt::datatable destroy $cow5
+	set cow5 [$cow4 duplicate]
+	for { set i 0 } { $i < 100 } { incr i } {
+	    $cow5 row create -label new$i
+	}
+	$cow5 set new99 d 9.5
+	list [$cow4 column values s] [$cow5 numrows] [$cow5 get 1 d] \
+	    [$cow5 get new99 d] [$cow5 get 2 e]
+    } msg] $msg
+} {0 {{a b c} 103 2.5 9.5 red}}
+
+test datatable.701 {restore after duplicate} {
+    list [catch {
+	blt::datatable destroy $cow5
+	set cow5 [$cow4 duplicate]
+	set t1 [blt::datatable create]
+	$t1 column create -label d -type double
+	$t1 column create -label e
+	for { set i 0 } { $i < 100 } { incr i } {
+	    $t1 row create -label new$i
+	    $t1 set new$i d $i.5 new$i e green
+	}
+	$cow5 restore -overwrite -data [$t1 dump]
+	set out [list [$cow4 numrows] [$cow5 numrows] [$cow5 get 0 s] \
+		     [$cow5 get new99 d] [$cow5 get new99 e] [$cow5 get 2 e] \
+		     [$cow4 get 2 e]]
+	blt::datatable destroy $cow4 $cow5 $t1
+	set out
+    } msg] $msg
+} {0 {3 103 a 99.5 green red red}}
+
+test datatable.604 {copy dictionary encoded column} {
+    list [catch {
+	$cow1 column create -label e
+	$cow1 column encoding e dictionary
+	$cow1 set 0 e red 1 e blue 2 e red
+	$cow3 copy $cow1
+	$cow3 set 2 e green
+	blt::datatable destroy $cow1
+	list [$cow2 column values s] [$cow3 column values e] \
+	    [$cow3 column encoding e]
+    } msg] $msg
+} {0 {{a x c} {red blue green} dictionary}}
+
+test datatable.605 {column dup shares values until changed} {
+    list [catch {
+	set col [$cow3 column dup 1]
+	$cow3 set 1 $col 7.5
+	$cow3 numrows 4
+	$cow3 set 3 1 8.5
+	list [$cow3 column values 1] [$cow3 column values $col] \
+	    [$cow3 column type $col]
+    } msg] $msg
+} {0 {{{} 2.5 3.5 8.5} {{} 7.5 3.5 {}} double}}
+
+test datatable.606 {column type change after column dup} {
+    list [catch {
+	set col [$cow3 column dup 1]
+	$cow3 column type $col string
+	$cow3 set 0 $col abc
+	blt::datatable destroy $cow2
+	set result [list [$cow3 column values 1] [$cow3 column values $col]]
+	blt::datatable destroy $cow3
+	set result
+    } msg] $msg
+} {0 {{{} 2.5 3.5 8.5} {abc 2.5 3.5 8.5}}}
+
+test datatable.607 {column stats} {
+    list [catch {
+	set stats1 [blt::datatable create]
+	$stats1 column create -label d -type double
+	$stats1 column create -label s
+	$stats1 set 0 d 1.5 1 d 4.0 2 d -2.0 3 d 4.0 0 s b 1 s a 2 s c
+	list [$stats1 column stats d] [$stats1 column stats s]
+    } msg] $msg
+} {0 {{count 4 min -2.0 max 4.0 sum 7.5 distinct 3} {count 3 min a max c sum {} distinct 3}}}
+
+test datatable.608 {column stats after overwriting limits} {
+    list [catch {
+	$stats1 set 2 d 3.0 0 d 10.0
+	list [$stats1 column stats d] [$stats1 limits d]
+    } msg] $msg
+} {0 {{count 4 min 3.0 max 10.0 sum 21.0 distinct 4} {3.0 10.0}}}
+
+test datatable.609 {column stats after unset and delete} {
+    list [catch {
+	$stats1 column unset d 0
+	$stats1 row delete 2
+	list [$stats1 column stats d] [$stats1 min d] [$stats1 max d]
+    } msg] $msg
+} {0 {{count 2 min 4.0 max 4.0 sum 8.0 distinct 2} 4.0 4.0}}
+
+test datatable.610 {column stats after type change} {
+    list [catch {
+	$stats1 column type d string
+	$stats1 set 0 d x
+	$stats1 column stats d
+    } msg] $msg
+} {0 {count 3 min 4.0 max x sum {} distinct 2}}
+
+test datatable.611 {column stats empty column} {
+    list [catch {
+	$stats1 column create -label e
+	set result [$stats1 column stats e]
+	blt::datatable destroy $stats1
+	set result
+    } msg] $msg
+} {0 {count 0 min {} max {} sum {} distinct 0}}
+
+test datatable.612 {column stats badColumn} {
+    list [catch {datatable0 column stats badColumn} msg] $msg
+} {1 {unknown column specification "badColumn" in ::datatable0}}
+
+test datatable.613 {export columnar} {
+    list [catch {
+	set col1 [blt::datatable create]
+	$col1 column create -label d -type double
+	$col1 column create -label l -type long
+	$col1 column create -label s -type string
+	$col1 numrows 3
+	$col1 set 0 d 1.5 0 l 10 0 s "hello world"
+	$col1 set 1 d -2.25 1 s ""
+	$col1 set 2 l -7 2 s "aéb"
+	$col1 row label 0 first
+	set data [$col1 export columnar -rowlabels]
+	list [string range $data 0 7] [expr {[string length $data] % 8}]
+    } msg] $msg
+} {0 {BLTCOL01 0}}
+
+test datatable.614 {import columnar} {
+    list [catch {
+	set col2 [blt::datatable create]
+	$col2 import columnar -data $data
+	list [$col2 column names] [$col2 row names] \
+	    [$col2 column type d] [$col2 column type l] [$col2 column type s]
+    } msg] $msg
+} {0 {{d l s} {first r2 r3} double long string}}
+
+test datatable.615 {import columnar values and empty cells} {
+    list [catch {
+	set result {}
+	foreach row {0 1 2} {
+	    foreach col {d l s} {
+		lappend result [$col2 exists $row $col] [$col2 get $row $col ""]
+	    }
+	}
+	set result
+    } msg] $msg
+} {0 {1 1.5 1 10 1 {hello world} 1 -2.25 0 {} 1 {} 0 {} 1 -7 1 aéb}}
+
+test datatable.616 {export columnar -file, import columnar -file} {
+    list [catch {
+	$col1 export columnar -file /tmp/datatable.col -columns {l s} -rows {1 2}
+	set col3 [blt::datatable create]
+	$col3 import columnar -file /tmp/datatable.col
+	file delete /tmp/datatable.col
+	list [$col3 column names] [$col3 numrows] [$col3 get 1 l] [$col3 get 1 s]
+    } msg] $msg
+} {0 {{l s} 2 -7 aéb}}
+
+test datatable.617 {import columnar into existing rows} {
+    list [catch {
+	$col3 import columnar -data [$col1 export columnar -columns d]
+	list [$col3 column names] [$col3 numrows] [$col3 get 2 d]
+    } msg] $msg
+} {0 {{l s d} 3 {}}}
+
+test datatable.618 {import columnar bad data} {
+    list [catch {$col3 import columnar -data "BLTCOL00xxxxxxxxxxxxxxxxxxxxxxxx"} msg] $msg
+} {1 {bad columnar data: wrong magic number}}
+
+test datatable.619 {import columnar truncated data} {
+    list [catch {
+	$col3 import columnar -data [string range $data 0 100]
+    } msg] $msg
+} {1 {bad columnar data: bad header}}
+
+test datatable.702 {import columnar row labels flag on a double column} {
+    list [catch {
+	set col4 [blt::datatable create]
+	$col4 column create -label d -type double
+	$col4 row extend 2
+	$col4 set 0 d 1.5 1 d 2.5
+	set bytes [$col4 export columnar]
+	set bytes [string replace $bytes 44 47 [binary format n 1]]
+	$col4 import columnar -data $bytes
+    } msg] $msg
+} {1 {bad columnar data: bad row label block}}
+
+test datatable.703 {import columnar two row label blocks} {
+    list [catch {
+	set col5 [blt::datatable create]
+	$col5 row create -label a
+	$col5 row create -label b
+	set bytes [$col5 export columnar -rowlabels]
+	set block [string range $bytes 32 end]
+	set bytes [string range $bytes 0 23][binary format m 2]$block$block
+	set code [catch {$col5 import columnar -data $bytes} result]
+	blt::datatable destroy $col4 $col5
+	list $code $result
+    } msg] $msg
+} {0 {1 {bad columnar data: more than one row label block}}}
+
+test datatable.620 {import columnar no switches} {
+    list [catch {
+	$col3 import columnar
+    } msg] $msg
+} {1 {either -file or -data switch is required}}
+
+test datatable.621 {import columnar both switches} {
+    list [catch {
+	$col3 import columnar -file x -data y
+    } msg] $msg
+} {1 {can't set both -file and -data switches.}}
+
+test datatable.622 {export columnar empty table} {
+    list [catch {
+	set col4 [blt::datatable create]
+	$col4 import columnar -data [$col4 export columnar]
+	set result [list [$col4 numrows] [$col4 numcolumns]]
+	blt::datatable destroy $col1 $col2 $col3 $col4
+	set result
+    } msg] $msg
+} {0 {0 0}}
+
+test datatable.623 {export vector -alias} {
+    list [catch {
+	set view1 [blt::datatable create]
+	$view1 column create -type double -label x
+	$view1 column create -label s
+	$view1 set 0 x 1.5 1 x 2.5 3 x 4.5
+	blt::vector create view1v
+	$view1 export vector -alias view1v x
+	view1v values
+    } msg] $msg
+} {0 {1.5 2.5 NaN 4.5}}
+
+test datatable.624 {export vector -alias sees sets and unsets} {
+    list [catch {
+	$view1 set 2 x 3.5
+	$view1 unset 0 x
+	view1v values
+    } msg] $msg
+} {0 {NaN 2.5 3.5 4.5}}
+
+test datatable.625 {export vector -alias writes back to column} {
+    list [catch {
+	view1v value set 0 10
+	update idletasks
+	list [$view1 exists 0 x] [$view1 column values x]
+    } msg] $msg
+} {0 {1 {10.0 2.5 3.5 4.5}}}
+
+test datatable.626 {export vector -alias follows added rows} {
+    list [catch {
+	$view1 row create
+	$view1 set 4 x 5.5
+	$view1 row create
+	view1v values
+    } msg] $msg
+} {0 {10.0 2.5 3.5 4.5 5.5 NaN}}
+
+test datatable.627 {export vector -alias follows deleted rows} {
+    list [catch {
+	$view1 row delete 1 5
+	view1v values
+    } msg] $msg
+} {0 {10.0 3.5 4.5 5.5}}
+
+test datatable.628 {export vector -alias follows sorted rows} {
+    list [catch {
+	$view1 sort -columns x -alter
+	list [view1v values] [$view1 column values x]
+    } msg] $msg
+} {0 {{3.5 4.5 5.5 10.0} {3.5 4.5 5.5 10.0}}}
+
+test datatable.629 {export vector -alias not double column} {
+    list [catch {
+	$view1 export vector -alias view1v s
+    } msg] $msg
+} {1 {can't view column "s": not a double or time column}}
+
+test datatable.630 {export vector -alias ends when column type changes} {
+    list [catch {
+	$view1 column type x string
+	$view1 set 0 x abc
+	view1v values
+    } msg] $msg
+} {0 {3.5 4.5 5.5 10.0}}
+
+test datatable.631 {export vector -alias ends when vector is resized} {
+    list [catch {
+	$view1 column create -type double -label y
+	$view1 set 0 y 1.0 1 y 2.0
+	$view1 export vector -alias view1v y
+	view1v append 3.0
+	update idletasks
+	$view1 set 0 y 7.0
+	list [view1v values] [$view1 column values y]
+    } msg] $msg
+} {0 {{1.0 2.0 NaN NaN 3.0} {7.0 2.0 {} {}}}}
+
+test datatable.632 {export vector -alias vector destroyed} {
+    list [catch {
+	$view1 export vector -alias view1v y
+	blt::vector destroy view1v
+	$view1 set 1 y 8.0
+	$view1 row create
+	$view1 column values y
+    } msg] $msg
+} {0 {7.0 8.0 {} {} {}}}
+
+test datatable.633 {export vector -alias table destroyed} {
+    list [catch {
+	blt::vector create view1v
+	$view1 export vector -alias view1v y
+	blt::datatable destroy $view1
+	set result [view1v values]
+	blt::vector destroy view1v
+	set result
+    } msg] $msg
+} {0 {7.0 8.0 NaN NaN NaN}}
+
+test datatable.634 {sort -limit} {
+    list [catch {
+	set topk [blt::datatable create]
+	$topk column create -type double -label x
+	$topk column create -type long -label y
+	$topk set 0 x 5.0 1 x 3.0 2 x 9.0 3 x 1.0 4 x 7.0 6 x 3.0
+	$topk set 0 y 1 1 y 2 2 y 1 3 y 2 4 y 1 5 y 2 6 y 1
+	$topk sort -columns x -limit 3
+    } msg] $msg
+} {0 {3 1 6}}
+
+test datatable.635 {sort -limit -decreasing} {
+    list [catch {
+	$topk sort -columns x -limit 3 -decreasing
+    } msg] $msg
+} {0 {5 2 4}}
+
+test datatable.636 {sort -limit multiple columns} {
+    list [catch {
+	$topk sort -columns {y x} -limit 4
+    } msg] $msg
+} {0 {6 0 4 2}}
+
+test datatable.637 {sort -limit larger than table} {
+    list [catch {
+	$topk sort -columns x -limit 100
+    } msg] $msg
+} {0 {3 1 6 0 4 2 5}}
+
+test datatable.638 {sort -limit 0} {
+    list [catch {
+	$topk sort -columns x -limit 0
+    } msg] $msg
+} {0 {}}
+
+test datatable.639 {sort -range} {
+    list [catch {
+	$topk sort -columns x -range {2 4}
+    } msg] $msg
+} {0 {6 0 4}}
+
+test datatable.640 {sort -range end} {
+    list [catch {
+	$topk sort -columns x -range {4 end}
+    } msg] $msg
+} {0 {4 2 5}}
+
+test datatable.641 {sort -range -limit} {
+    list [catch {
+	$topk sort -columns x -range {1 end} -limit 3
+    } msg] $msg
+} {0 {1 6}}
+
+test datatable.642 {sort -range bad} {
+    list [catch {
+	$topk sort -columns x -range {4 2}
+    } msg] $msg
+} {1 {bad range "4 2": should be "first last"}}
+
+test datatable.643 {sort -limit -unique} {
+    list [catch {
+	$topk sort -columns x -limit 2 -unique
+    } msg] $msg
+} {1 {-unique switch is incompatible with -limit and -range.}}
+
+test datatable.644 {sort -limit -alter} {
+    list [catch {
+	$topk sort -columns x -limit 2 -alter
+	set result [$topk column values x]
+	blt::datatable destroy $topk
+	set result
+    } msg] $msg
+} {0 {1.0 3.0 5.0 9.0 7.0 {} 3.0}}
+
+test datatable.645 {row delete interleaved with row index} {
+    list [catch {
+	set del [blt::datatable create]
+	$del column create -type long -label x
+	$del numrows 10
+	$del column values x {0 1 2 3 4 5 6 7 8 9}
+	set label [$del row label 5]
+	set result {}
+	foreach r {7 0 2} {
+	    $del row delete $r
+	    lappend result [$del row index $label]
+	}
+	lappend result [$del column values x]
+    } msg] $msg
+} {0 {5 4 3 {1 2 4 5 6 8 9}}}
+
+test datatable.646 {row get by index after deletes} {
+    list [catch {
+	set result {}
+	foreach i {0 3 6} {
+	    lappend result [$del get $i x]
+	}
+	lappend result [$del numrows] [$del row indices 2-4]
+    } msg] $msg
+} {0 {1 5 9 7 {2 3 4}}}
+
+test datatable.647 {row create after deletes} {
+    list [catch {
+	$del row delete 1
+	$del row create -after @end
+	$del set @end x 10
+	$del row create -before 0
+	$del set 0 x -1
+	list [$del column values x] [$del row index @end]
+    } msg] $msg
+} {0 {{-1 1 4 5 6 8 9 10} 7}}
+
+test datatable.648 {sort -alter after deletes} {
+    list [catch {
+	$del row delete 3
+	$del sort -columns x -decreasing -alter
+	$del row create -after @end
+	$del set @end x 0
+	$del column values x
+    } msg] $msg
+} {0 {10 9 8 6 4 1 -1 0}}
+
+test datatable.649 {row delete -where} {
+    list [catch {
+	$del row delete -where { $x < 4 }
+	$del column values x
+    } msg] $msg
+} {0 {10 9 8 6 4}}
+
+test datatable.650 {row delete -where rowName} {
+    list [catch {
+	$del row delete -where { $x % 2 == 0 } 2-4
+	$del column values x
+    } msg] $msg
+} {0 {10 9}}
+
+test datatable.651 {row delete -where (missing expression)} {
+    list [catch {
+	$del row delete -where
+    } msg] $msg
+} {1 {value for "-where" missing}}
+
+test datatable.652 {row delete -where (bad expression)} {
+    list [catch {
+	set result [$del row delete -where { $nope > 1 }]
+    } msg] $msg
+} {1 {can't read "nope": no such variable}}
+
+test datatable.653 {row delete -where all} {
+    list [catch {
+	$del row delete -where { $x > 0 }
+	set result [$del numrows]
+	blt::datatable destroy $del
+	set result
+    } msg] $msg
+} {0 0}
+
+test datatable.654 {column create -timeformat} {
+    list [catch {
+	set tf [blt::datatable create]
+	$tf column create -label ts -type time \
+	    -timeformat "%d/%b/%Y:%H:%M:%S %z"
+	$tf column timeformat ts
+    } msg] $msg
+} {0 {%d/%b/%Y:%H:%M:%S %z}}
+
+test datatable.655 {set time with format} {
+    list [catch {
+	$tf set 0 ts "05/Mar/2024:12:34:56 -0700"
+	$tf get 0 ts
+    } msg] $msg
+} {0 1709667296.0}
+
+test datatable.656 {set time not matching format} {
+    list [catch {
+	$tf set 1 ts "2024-03-05 12:00"
+	$tf get 1 ts
+    } msg] $msg
+} {0 1709640000.0}
+
+test datatable.657 {column timeformat (bad pattern)} {
+    list [catch {
+	$tf column timeformat ts "%Y-%Q"
+    } msg] $msg
+} {1 {bad time format "%Y-%Q": unknown field "%Q"}}
+
+test datatable.658 {column type time with format} {
+    list [catch {
+	$tf column create -label s
+	$tf set 0 s "2024-03-05T12:34:56.5Z"
+	$tf set 1 s "2024-03-06T00:00:00.0Z"
+	$tf column timeformat s "%Y-%m-%dT%H:%M:%S.%fZ"
+	$tf column type s time
+	$tf column values s
+    } msg] $msg
+} {0 {1709642096.5 1709683200.0}}
+
+test datatable.659 {import csv with time format} {
+    list [catch {
+	set csv [blt::datatable create]
+	$csv import csv -data "12:00:01 03/05/24\n01:02:03 12/31/99\n"
+	$csv column timeformat c1 "%T %D"
+	$csv column type c1 time
+	set result [$csv column values c1]
+	blt::datatable destroy $csv
+	set result
+    } msg] $msg
+} {0 {1709640001.0 946602123.0}}
+
+test datatable.660 {column timeformat ""} {
+    list [catch {
+	$tf column timeformat ts ""
+	set result [$tf column timeformat ts]
+	blt::datatable destroy $tf
+	set result
+    } msg] $msg
+} {0 {}}
+
+test datatable.661 {import ndjson} {
+    list [catch {
+	set nd [blt::datatable create]
+	$nd import ndjson -data {{"name":"a","size":10,"ok":true}
+{"name":"b","size":12.5,"ok":false}
+
+{"name":"c","tags":["x",{"y":1}],"size":null}}
+	set result {}
+	foreach c [$nd column names] {
+	    lappend result $c [$nd column type $c] [$nd column values $c]
+	}
+	set result
+    } msg] $msg
+} {0 {name string {a b c} size double {10.0 12.5 {}} ok boolean {1 0 {}} tags string {{} {} {["x",{"y":1}]}}}}
+
+test datatable.662 {export ndjson} {
+    list [catch {
+	$nd export ndjson
+    } msg] $msg
+} {0 {{"name":"a","size":10.0,"ok":true}
+{"name":"b","size":12.5,"ok":false}
+{"name":"c","tags":"[\"x\",{\"y\":1}]"}
+}}
+
+test datatable.663 {export ndjson -nulls -rows -columns} {
+    list [catch {
+	$nd export ndjson -nulls -rows 2 -columns {name size}
+    } msg] $msg
+} {0 {{"name":"c","size":null}
+}}
+
+test datatable.664 {import ndjson (widen new column, keep old type)} {
+    list [catch {
+	$nd import ndjson -data "{\"ok\":1,\"w\":1}\n{\"w\":\"x\"}"
+	list [$nd column type ok] [$nd column type w] [$nd column values w] \
+	    [$nd numrows]
+    } msg] $msg
+} {0 {boolean string {{} {} {} 1 x} 5}}
+
+test datatable.665 {import ndjson (escapes)} {
+    list [catch {
+	set t [blt::datatable create]
+	$t import ndjson -data {{"s":"a\"b\\c\n\u00e9\/"}}
+	set result [list [$t get 0 s]]
+	lappend result [$t export ndjson]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} [list 0 [list "a\"b\\c\n\u00e9/" "{\"s\":\"a\\\"b\\\\c\\n\u00e9/\"}\n"]]
+
+test datatable.666 {import ndjson (typed existing column)} {
+    list [catch {
+	set t [blt::datatable create]
+	$t column create -label n -type double
+	$t import ndjson -data "{\"n\":1}\n{\"n\":2,\"m\":3}\n{\"m\":4.5}\n"
+	set result [list [$t column type n] [$t column values n] \
+			[$t column type m] [$t column values m]]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {double {1.0 2.0 {}} double {{} 3.0 4.5}}}
+
+test datatable.667 {import ndjson -maxrows} {
+    list [catch {
+	set t [blt::datatable create]
+	$t import ndjson -data "{\"a\":1}\n{\"a\":2}\n{\"a\":3}" -maxrows 2
+	set result [$t column values a]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {1 2}}
+
+test datatable.668 {import ndjson (not an object)} {
+    list [catch {
+	$nd import ndjson -data "{\"a\":1}\n\[1,2\]"
+    } msg] $msg
+} {1 {line 2: expected JSON object}}
+
+test datatable.669 {import ndjson (bad value)} {
+    list [catch {
+	$nd import ndjson -data {{"a":tru}}
+    } msg] $msg
+} {1 {line 1: bad JSON value}}
+
+test datatable.670 {import ndjson (unterminated string)} {
+    list [catch {
+	$nd import ndjson -data {{"a":"x}}
+    } msg] $msg
+} {1 {line 1: unterminated string}}
+
+test datatable.671 {import ndjson (extra characters)} {
+    list [catch {
+	$nd import ndjson -data {{"a":1} x}
+    } msg] $msg
+} {1 {line 1: extra characters after JSON object}}
+
+test datatable.672 {import ndjson (no -file or -data)} {
+    list [catch {
+	$nd import ndjson
+    } msg] $msg
+} {1 {either -file or -data switch is required}}
+
+test datatable.673 {export/import ndjson -file} {
+    list [catch {
+	set t [blt::datatable create]
+	$t import ndjson -data {{"i":1,"d":0.25,"s":"x y","b":true}}
+	$t export ndjson -file /tmp/datatable.ndjson
+	set t2 [blt::datatable create]
+	$t2 import ndjson -file /tmp/datatable.ndjson
+	file delete /tmp/datatable.ndjson
+	set result [$t2 export ndjson]
+	blt::datatable destroy $t $t2 $nd
+	set result
+    } msg] $msg
+} {0 {{"i":1,"d":0.25,"s":"x y","b":true}
+}}
+
+test datatable.674 {import csv -infertypes} {
+    list [catch {
+	set t [blt::datatable create]
+	set result [$t import csv -data "1,2.5,true,2020-01-01,abc\n2,3,no,2021-02-03,007\n" -infertypes 2]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {c1 long c2 double c3 boolean c4 {time %Y-%m-%d} c5 string}}
+
+test datatable.675 {import csv -infertypes widens column} {
+    list [catch {
+	set t [blt::datatable create]
+	$t import csv -data "1,1\n2,x\n3.5,3\n" -infertypes 1
+	set result [list [$t column type c1] [$t column type c2] \
+			[$t get 2 c1] [$t get 1 c2]]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {double string 3.5 x}}
+
+test datatable.676 {import csv -infertypes all} {
+    list [catch {
+	set t [blt::datatable create]
+	set result [$t import csv -data "1,a\n2,\n3.5,\n" -infertypes all]
+	lappend result [$t get 0 c1]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {c1 double c2 string 1.0}}
+
+test datatable.677 {import csv -infertypes keeps existing columns} {
+    list [catch {
+	set t [blt::datatable create]
+	$t column create -label c1 -type string
+	set result [$t import csv -data "1,2\n3,4\n" -infertypes all]
+	lappend result [$t column type c1]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {c2 long string}}
+
+test datatable.678 {import csv -infertypes leading zeros} {
+    list [catch {
+	set t [blt::datatable create]
+	set result [$t import csv -data "007\n010\n" -infertypes all]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {c1 string}}
+
+test datatable.679 {import csv -infertypes badValue} {
+    list [catch {
+	set t [blt::datatable create]
+	$t import csv -data "1\n" -infertypes foo
+    } msg] $msg
+} {1 {bad value "foo": should be a number of values or "all"}}
+
+test datatable.680 {import txt -infertypes} {
+    list [catch {
+	set t [blt::datatable create]
+	set result [$t import txt -data "1 2.5 yes\n2 x no\n" -infertypes 1]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {c1 long c2 string c3 boolean}}
+
+test datatable.681 {import txt -infertypes all} {
+    list [catch {
+	set t [blt::datatable create]
+	set result [$t import txt -data "1 2\n2 3.5\n" -infertypes all]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {c1 long c2 double}}
+
+test datatable.682 {import xml -infertypes} {
+    list [catch {
+	set t [blt::datatable create]
+	set result [$t import xml -noelems -infertypes all \
+			-data {<r><e a="1" b="2.5"/><e a="2" b="x"/></r>}]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {a long b string}}
+
+test datatable.683 {column window (wrong \# args)} {
+    list [catch {
+	set t [blt::datatable create windowTable]
+	$t column window x
+    } msg] $msg
+} {1 {wrong # args: should be "::windowTable column window srcColumn destColumn ?switches?"}}
+
+test datatable.684 {column window -op mean -size 2} {
+    list [catch {
+	$t column create -label x -type long
+	$t column values x {1 2 3 4 5 6}
+	$t unset 4 x
+	$t column window x y -op mean -size 2
+	list [$t column type y] [$t column values y]
+    } msg] $msg
+} {0 {double {1.0 1.5 2.5 3.5 4.0 6.0}}}
+
+test datatable.685 {column window cumulative sum} {
+    list [catch {
+	$t column window x y2 -op sum
+	list [$t column type y2] [$t column values y2]
+    } msg] $msg
+} {0 {long {1 3 6 10 10 16}}}
+
+test datatable.686 {column window -op min/max} {
+    list [catch {
+	$t column values x {5 3 4 1 2 6}
+	$t column window x lo -op min -size 3
+	$t column window x hi -op max -size 3
+	list [$t column values lo] [$t column values hi]
+    } msg] $msg
+} {0 {{5 3 3 1 1 1} {5 5 5 4 4 6}}}
+
+test datatable.687 {column window -op std} {
+    list [catch {
+	$t column values x {2 4 4 4 5 5}
+	$t column window x sd -op std -size 3
+	set result {}
+	foreach value [$t column values sd] {
+	    if { $value != "" } {
+		set value [format %.6f $value]
+	    }
+	    lappend result $value
+	}
+	set result
+    } msg] $msg
+} {0 {{} 1.414214 1.154701 0.000000 0.577350 0.577350}}
+
+test datatable.688 {column window -op median} {
+    list [catch {
+	$t column values x {5 1 3 8 2 9}
+	$t column window x md -op median -size 4
+	$t column values md
+    } msg] $msg
+} {0 {5.0 3.0 3.0 4.0 2.5 5.5}}
+
+test datatable.689 {column window -by} {
+    list [catch {
+	$t column create -label g
+	$t column values g {a b a b a b}
+	$t column window x gs -op sum -by g
+	$t column values gs
+    } msg] $msg
+} {0 {5 1 8 9 10 18}}
+
+test datatable.690 {column window into existing column} {
+    list [catch {
+	$t column window x gs -op mean -size 2
+	$t column values gs
+    } msg] $msg
+} {1 {expected integer but got "5.0"}}
+
+test datatable.691 {column window fires one trace} {
+    list [catch {
+	set events {}
+	$t trace column md w TraceBatch
+	$t column window x md -op max -size 2
+	set events
+    } msg] $msg
+} {0 {{0-5 6-6 wb}}}
+
+test datatable.692 {column window -op badOp} {
+    list [catch {
+	$t column window x md -op foo
+    } msg] $msg
+} {1 {bad window operation "foo": should be mean, sum, min, max, std, or median}}
+
+test datatable.693 {column window non-numeric string column} {
+    list [catch {
+	$t column window g md
+    } msg] $msg
+} {1 {value "a" in row "r1" of column "g" is not a number}}
+
+test datatable.694 {column window -size -1} {
+    list [catch {
+	$t column window x md -size -1
+    } msg] $msg
+} {1 {bad value "-1": can't be negative}}
+
+test datatable.695 {column window empty table} {
+    list [catch {
+	set t2 [blt::datatable create]
+	$t2 column create -label x -type double
+	$t2 column window x y -op median
+	set result [$t2 column type y]
+	blt::datatable destroy $t2 $t
+	set result
+    } msg] $msg
+} {0 double}
+
+test datatable.696 {dump -binary skips strings generated by reads} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label d -type double
+	$t1 row extend 3
+	$t1 set 0 d 1.5 1 d 2.25 2 d -4.0
+	set before [string length [$t1 dump -binary]]
+	$t1 column values d
+	set after [string length [$t1 dump -binary]]
+	blt::datatable destroy $t1
+	expr {$before == $after}
+    } msg] $msg
+} {0 1}
+
+test datatable.697 {dump -binary boolean strings with odd rows} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label b -type boolean
+	$t1 column create -label d -type double
+	$t1 row extend 3
+	$t1 set 0 b yes 1 b off 2 b 1 0 d 1.50 2 d 3
+	set t2 [blt::datatable create]
+	$t2 restore -binary -data [$t1 dump -binary]
+	set out [string equal [$t1 export csv] [$t2 export csv]]
+	lappend out [$t2 export csv]
+	blt::datatable destroy $t1 $t2
+	set out
+    } msg] $msg
+} {0 {1 {"b","d"
+yes,1.50
+off,
+1,3
+}}}
+
+test datatable.698 {restore -binary keeps dictionary encoding} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label status -encoding dictionary
+	$t1 column create -label name
+	$t1 row extend 4
+	$t1 column values status {open closed {} open}
+	$t1 column values name {a b c d}
+	set t2 [blt::datatable create]
+	$t2 restore -binary -data [$t1 dump -binary]
+	set out [list [$t2 column encoding status] [$t2 column encoding name] \
+		     [$t2 column values status]]
+	$t2 column encoding name dictionary
+	$t2 restore -binary -overwrite -data [$t1 dump -binary]
+	lappend out [$t2 column encoding name]
+	blt::datatable destroy $t1 $t2
+	set out
+    } msg] $msg
+} {0 {dictionary none {open closed {} open} none}}
+
+test datatable.719 {restore -binary bad string leaves the table unchanged} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label n -type long
+	$t1 column create -label s
+	$t1 row extend 2
+	$t1 set 0 n 1 1 n 22 0 s a 1 s bb
+	set snap [$t1 dump -binary]
+	# Make the string of the first cell of "s" run past the heap.  The
+	# values offset of "s" follows the 64 byte header, 2 row entries,
+	# and the directory entry of "n".
+	binary scan $snap @192w values
+	set snap [string replace $snap [expr {$values + 8}] \
+		      [expr {$values + 15}] [binary format w 1000000]]
+	set t2 [blt::datatable create]
+	$t2 column create -label z
+	$t2 row extend 1
+	$t2 set 0 z keep
+	set before [$t2 dump]
+	set result [list [catch {$t2 restore -binary -data $snap} msg] $msg]
+	lappend result [string equal $before [$t2 dump]]
+	blt::datatable destroy $t1 $t2
+	set result
+    } msg] $msg
+} {0 {1 {bad datatable snapshot: string out of range} 1}}
+test datatable.720 {column timeformat round trip and copies} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label a -timeformat "%d/%m/%Y %H:%M"
+	$t1 column create -label b -timeformat "%T %D"
+	$t1 column timeformat a [$t1 column timeformat a]
+	$t1 column dup b
+	set t2 [$t1 duplicate]
+	set t3 [blt::datatable create]
+	$t3 copy $t1
+	set result [list [$t1 column timeformat a] [$t1 column timeformat @all] \
+			[$t2 column timeformat a] [$t3 column timeformat 2]]
+	$t1 row extend 1
+	$t1 set 0 a "05/03/2024 12:30"
+	$t1 column type a time
+	lappend result [$t1 get 0 a]
+	blt::datatable destroy $t1 $t2 $t3
+	set result
+    } msg] $msg
+} {0 {{%d/%m/%Y %H:%M} {{%d/%m/%Y %H:%M} {%T %D} {%T %D}} {%d/%m/%Y %H:%M} {%T %D} 1709641800.0}}
+test datatable.721 {row delete -where -emptyvalue (empty cells)} {
+    list [catch {
+	set t [blt::datatable create]
+	$t column create -label a -type long
+	$t row extend 5
+	$t set 0 a 10 3 a 1
+	set result [list [catch {$t row delete -where { $a > 5 }} msg] $msg]
+	$t row delete -where { $a > 5 } -emptyvalue 0
+	lappend result [$t numrows] [$t column values a]
+	$t row delete 0 2 -where { $a == 1 } -emptyvalue 0 -invert
+	lappend result [$t numrows] [$t column values a]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {1 {can't read "a": no such variable} 4 {{} {} 1 {}} 3 {{} 1 {}}}}
+
+test datatable.710 {export sqlite -batchsize -rowlabels} {
+    list [catch {
+	file delete tmpdata.db
+	set t1 [blt::datatable create]
+	$t1 column create -label n -type long
+	$t1 column create -label d -type double
+	$t1 column create -label s
+	for { set i 0 } { $i < 10 } { incr i } {
+	    $t1 row create -label row$i
+	    $t1 set row$i n $i row$i d $i.5 row$i s s$i
+	}
+	$t1 export sqlite -file tmpdata.db -table data -batchsize 3 -rowlabels
+	set t2 [blt::datatable create]
+	$t2 import sqlite -file tmpdata.db -query "SELECT * FROM data"
+	set out [list [$t2 column names] [$t2 numrows] \
+		     [$t2 column values _rowId] [$t2 column values n] \
+		     [$t2 column values d]]
+	blt::datatable destroy $t2
+	set out
+    } msg] $msg
+} {0 {{_rowId n d s} 10 {row0 row1 row2 row3 row4 row5 row6 row7 row8 row9} {0 1 2 3 4 5 6 7 8 9} {0.5 1.5 2.5 3.5 4.5 5.5 6.5 7.5 8.5 9.5}}}
+
+test datatable.711 {export and import sqlite NULL values} {
+    list [catch {
+	$t1 unset row3 d row4 s
+	$t1 export sqlite -file tmpdata.db -table data
+	set t2 [blt::datatable create]
+	$t2 import sqlite -file tmpdata.db -query "SELECT d, s FROM data"
+	set t3 [blt::datatable create]
+	$t3 import sqlite -file tmpdata.db \
+	    -query "SELECT count(*) AS c FROM data WHERE d IS NULL OR s IS NULL"
+	set out [list [$t2 column values d] [$t2 column values s] \
+		     [$t3 column values c]]
+	blt::datatable destroy $t2 $t3
+	set out
+    } msg] $msg
+} {0 {{0.5 1.5 2.5 {} 4.5 5.5 6.5 7.5 8.5 9.5} {s0 s1 s2 s3 {} s5 s6 s7 s8 s9} 2}}
+
+test datatable.712 {import sqlite -typed} {
+    list [catch {
+	set t2 [blt::datatable create]
+	$t2 import sqlite -file tmpdata.db -typed \
+	    -query "SELECT n, d, s FROM data WHERE n >= 3 ORDER BY n"
+	set out [list [$t2 numrows] [$t2 column type n] [$t2 column type d] \
+		     [$t2 column type s] [$t2 column values d] \
+		     [$t2 column values s]]
+	blt::datatable destroy $t2
+	set out
+    } msg] $msg
+} {0 {7 long double string {{} 4.5 5.5 6.5 7.5 8.5 9.5} {s3 {} s5 s6 s7 s8 s9}}}
+
+test datatable.713 {failed export sqlite keeps the old table} {
+    list [catch {
+	set t2 [blt::datatable create]
+	$t2 column create -label a
+	$t2 column create -label A
+	$t2 set 0 a x 0 A y
+	set out [catch {$t2 export sqlite -file tmpdata.db -table data}]
+	set t3 [blt::datatable create]
+	$t3 import sqlite -file tmpdata.db \
+	    -query "SELECT count(*) AS c FROM data"
+	lappend out [$t3 column values c]
+	blt::datatable destroy $t1 $t2 $t3
+	file delete tmpdata.db
+	set out
+    } msg] $msg
+} {0 {1 10}}
+
+# The psql and mysql tests need a server.  Set BLT_TEST_PSQL or
+# BLT_TEST_MYSQL to the connection switches, for example
+# "-host localhost -port 5432 -db test -user blt -password blt".  The
+# tests are skipped if the server can't be reached.
+proc SqlServerSwitches { format } {
+    global env
+    set name BLT_TEST_[string toupper $format]
+    if { ![info exists env($name)] } {
+	return ""
+    }
+    set t1 [blt::datatable create]
+    set code [catch {$t1 import $format {*}$env($name) -query "SELECT 1"}]
+    blt::datatable destroy $t1
+    if { $code != 0 } {
+	return ""
+    }
+    return $env($name)
+}
+
+set psqlSwitches [SqlServerSwitches psql]
+if { $psqlSwitches != "" } {
+
+test datatable.705 {import psql streams rows} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 import psql {*}$psqlSwitches -query {
+	    SELECT n, (n * 0.5)::float8 AS d, 
+	    CASE WHEN n % 2 = 0 THEN NULL ELSE 'x' || n END AS s
+	    FROM generate_series(1, 1000) AS n
+	}
+	set out [list [$t1 numrows] [$t1 column type n] [$t1 column type d] \
+		     [$t1 get 0 s] [$t1 get 999 n] [$t1 get 999 d] \
+		     [$t1 get 999 s]]
+	$t1 row create
+	lappend out [lindex [$t1 row names] end]
+	blt::datatable destroy $t1
+	set out
+    } msg] $msg
+} {0 {1000 long double x1 1000 500.0 {} r1001}}
+
+test datatable.706 {export psql and import back} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 column create -label n -type long
+	$t1 column create -label d -type double
+	$t1 column create -label s
+	$t1 column create -label b -type boolean
+	$t1 row extend 3
+	$t1 set 0 n 1 0 d 1.5 0 s "it's" 0 b 1
+	$t1 set 1 n 2 1 s "tab\there" 1 b 0
+	$t1 set 2 n 3 2 d -2.25 2 s "back\\slash"
+	$t1 export psql {*}$psqlSwitches -table blt_datatable_test
+	set t2 [blt::datatable create]
+	$t2 import psql {*}$psqlSwitches \
+	    -query "SELECT * FROM blt_datatable_test ORDER BY n"
+	set out [list [$t2 column names]]
+	foreach col {n d s b} {
+	    lappend out [$t2 column values $col]
+	}
+	blt::datatable destroy $t1 $t2
+	set out
+    } msg] $msg
+} "0 {{n d s b} {1 2 3} {1.5 {} -2.25} {it's {tab\there} {back\\slash}} {1 0 {}}}"
+
+test datatable.707 {import psql into existing rows} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 row extend 5
+	$t1 import psql {*}$psqlSwitches \
+	    -query "SELECT n FROM generate_series(1, 2) AS n"
+	set out [list [$t1 numrows] [$t1 column values n]]
+	blt::datatable destroy $t1
+	set out
+    } msg] $msg
+} {0 {5 {1 2 {} {} {}}}}
+
+}
+
+set mysqlSwitches [SqlServerSwitches mysql]
+if { $mysqlSwitches != "" } {
+
+test datatable.708 {import mysql streams rows} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 import mysql {*}$mysqlSwitches \
+	    -query "SELECT 1 AS n, 'a' AS s UNION ALL SELECT 2, NULL"
+	set out [list [$t1 numrows] [$t1 column values n] \
+		     [$t1 column values s]]
+	$t1 row create
+	lappend out [lindex [$t1 row names] end]
+	blt::datatable destroy $t1
+	set out
+    } msg] $msg
+} {0 {2 {1 2} {a {}} r3}}
+
+test datatable.709 {import mysql into existing rows} {
+    list [catch {
+	set t1 [blt::datatable create]
+	$t1 row extend 4
+	$t1 import mysql {*}$mysqlSwitches -query "SELECT 'x' AS s"
+	set out [list [$t1 numrows] [$t1 column values s]]
+	blt::datatable destroy $t1
+	set out
+    } msg] $msg
+} {0 {4 {x {} {} {}}}}
+
+}
+
+test datatable.714 {import ndjson (widen to int64, then double)} {
+    list [catch {
+	set t [blt::datatable create]
+	$t import ndjson -data "{\"a\":9223372036854775807,\"b\":1}
+{\"a\":-9223372036854775808,\"b\":1234567890123456789}
+{\"a\":9223372036854775808}"
+	set result [list [$t column type a] [$t column type b] \
+			[$t column values b]]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {double int64 {1 1234567890123456789 {}}}}
+
+test datatable.715 {import ndjson (int64 column)} {
+    list [catch {
+	set t [blt::datatable create]
+	$t import ndjson -data "{\"a\":9223372036854775807}
+{\"a\":-9223372036854775808}
+{\"a\":2}"
+	set result [list [$t column type a] [$t column values a] \
+			[$t export ndjson]]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {int64 {9223372036854775807 -9223372036854775808 2} {{"a":9223372036854775807}
+{"a":-9223372036854775808}
+{"a":2}
+}}}
+
+test datatable.716 {import ndjson (boolean widened to string)} {
+    list [catch {
+	set t [blt::datatable create]
+	$t import ndjson -data "{\"b\":true}\n{\"b\":false}\n{}\n{\"b\":\"x\"}"
+	set result [list [$t column type b] [$t column values b]]
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {string {true false {} x}}}
+
+test datatable.717 {column type (every type)} {
+    list [catch {
+	set t [blt::datatable create]
+	set result {}
+	foreach type {string double long int64 time boolean blob} {
+	    $t column create -label $type -type $type
+	    lappend result [$t column type $type]
+	}
+	blt::datatable destroy $t
+	set result
+    } msg] $msg
+} {0 {string double long int64 time boolean blob}}
+
+test datatable.718 {join (label already in table)} {
+    list [catch {
+	set t [blt::datatable create jointable]
+	$t column extend 2 -labels {k v}
+	$t row extend 1
+	$t set 0 k 1 0 v a
+	set t2 [blt::datatable create]
+	$t2 column extend 2 -labels {id v}
+	$t2 row extend 1
+	$t2 set 0 id 1 0 v b
+	set result [list [catch {$t join $t2 -on {k id}} msg] $msg \
+			[$t column names]]
+	$t join $t2 -on {k id} -columns id
+	lappend result [$t column names] [$t column values id]
+	blt::datatable destroy $t $t2
+	set result
+    } msg] $msg
+} {0 {1 {can't join column "v": label already exists in "::jointable"} {k v} {k v id} 1}}
+
 #----------------------
 
 foreach table [blt::datatable names] {
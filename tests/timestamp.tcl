@@ -16,18 +16,18 @@ test timestamp.1 {timestamp no args} {
 } {1 {wrong # args: should be one of...
   blt::timestamp format seconds ?switches ...?
   blt::timestamp parse timeStamp
-  blt::timestamp scan timeStamp}}
+  blt::timestamp scan timeStamp ?-format pattern?}}
 
 test timestamp.2 {timestamp bad arg} {
     list [catch {blt::timestamp badArg} msg] $msg
 } {1 {bad operation "badArg": should be one of...
   blt::timestamp format seconds ?switches ...?
   blt::timestamp parse timeStamp
-  blt::timestamp scan timeStamp}}
+  blt::timestamp scan timeStamp ?-format pattern?}}
 
 test timestamp.3 {timestamp scan no arg} {
     list [catch {blt::timestamp scan} msg] $msg
-} {1 {wrong # args: should be "blt::timestamp scan timeStamp"}}
+} {1 {wrong # args: should be "blt::timestamp scan timeStamp ?-format pattern?"}}
 
 test timestamp.4 {timestamp format no arg} {
     list [catch {blt::timestamp format} msg] $msg
@@ -2215,5 +2215,52 @@ test timestamp.151 {timestamp scan "Dec 25, 1960"} {
     } msg] $msg
 } {0 {Sun Dec 25 00:00:00 +0000 1960}}
 
+test timestamp.1000 {timestamp scan -format ISO} { 
+    list [catch {
+	blt::timestamp scan "2024-03-05T12:34:56.25+05:30" \
+	    -format "%Y-%m-%dT%H:%M:%S.%f%z"
+    } msg] $msg
+} {0 1709622296.25}
 
+test timestamp.1001 {timestamp scan -format log} { 
+    list [catch {
+	blt::timestamp scan "05/Mar/2024:12:34:56 -0700" \
+	    -format "%d/%b/%Y:%H:%M:%S %z"
+    } msg] $msg
+} {0 1709667296.0}
 
+test timestamp.1002 {timestamp scan -format %F %T} { 
+    list [catch {
+	blt::timestamp scan "1960-12-25  00:00:00" -format "%F %T"
+    } msg] $msg
+} {0 -284601600.0}
+
+test timestamp.1003 {timestamp scan -format %D %I %p} { 
+    list [catch {
+	blt::timestamp scan "03/05/24 01:02:03 PM" -format "%D %I:%M:%S %p"
+    } msg] $msg
+} {0 1709643723.0}
+
+test timestamp.1004 {timestamp scan -format %Y-%j} { 
+    list [catch {
+	blt::timestamp scan "2024-060" -format "%Y-%j"
+    } msg] $msg
+} {0 1709164800.0}
+
+test timestamp.1005 {timestamp scan -format (bad day)} { 
+    list [catch {
+	blt::timestamp scan "2023-02-29" -format "%F"
+    } msg] $msg
+} {1 {bad time "2023-02-29": doesn't match format "%F"}}
+
+test timestamp.1006 {timestamp scan -format (extra characters)} { 
+    list [catch {
+	blt::timestamp scan "2024-02-29x" -format "%F"
+    } msg] $msg
+} {1 {bad time "2024-02-29x": doesn't match format "%F"}}
+
+test timestamp.1007 {timestamp scan -format (bad field)} { 
+    list [catch {
+	blt::timestamp scan "2024" -format "%Q"
+    } msg] $msg
+} {1 {bad time format "%Q": unknown field "%Q"}}